@@ -48,12 +48,15 @@ struct user_table_entry {
   u8_t               auth_key[20];
   snmpv3_priv_algo_t priv_algo;
   u8_t               priv_key[20];
+  /* master keys (not localized), kept to localize the keys again when the engine ID changes */
+  u8_t               auth_master_key[20];
+  u8_t               priv_master_key[20];
 };
 
 static struct user_table_entry user_table[] = {
-  { "lwip", SNMP_V3_AUTH_ALGO_INVAL, "" , SNMP_V3_PRIV_ALGO_INVAL, "" },
-  { "piwl", SNMP_V3_AUTH_ALGO_INVAL, "" , SNMP_V3_PRIV_ALGO_INVAL, "" },
-  { "test", SNMP_V3_AUTH_ALGO_INVAL, "" , SNMP_V3_PRIV_ALGO_INVAL, "" }
+  { "lwip", SNMP_V3_AUTH_ALGO_INVAL, "" , SNMP_V3_PRIV_ALGO_INVAL, "", "", "" },
+  { "piwl", SNMP_V3_AUTH_ALGO_INVAL, "" , SNMP_V3_PRIV_ALGO_INVAL, "", "", "" },
+  { "test", SNMP_V3_AUTH_ALGO_INVAL, "" , SNMP_V3_PRIV_ALGO_INVAL, "", "", "" }
 };
 
 static char snmpv3_engineid[32];
@@ -89,6 +92,29 @@ get_user(const char *username)
   return NULL;
 }
 
+#if LWIP_SNMP_V3_CRYPTO
+/**
+ * @brief   Localize a master key with the current engine ID.
+ *
+ * @param[in] algo        hash algorithm used for the key
+ * @param[in] master_key  master key from snmpv3_password_to_master_key_md5/sha()
+ * @param[out] key        localized key
+ */
+static void
+localize_key(snmpv3_auth_algo_t algo, const u8_t *master_key, u8_t *key)
+{
+  const char *engineid;
+  u8_t engineid_len;
+
+  snmpv3_get_engine_id(&engineid, &engineid_len);
+  if (algo == SNMP_V3_AUTH_ALGO_MD5) {
+    snmpv3_localize_key_md5(master_key, (const u8_t*)engineid, engineid_len, key);
+  } else if (algo == SNMP_V3_AUTH_ALGO_SHA) {
+    snmpv3_localize_key_sha(master_key, (const u8_t*)engineid, engineid_len, key);
+  }
+}
+#endif /* LWIP_SNMP_V3_CRYPTO */
+
 u8_t
 snmpv3_get_amount_of_users(void)
 {
@@ -193,23 +219,23 @@ err_t
 snmpv3_set_user_auth_key(const char *username, const char *password)
 {
   struct user_table_entry *p = get_user(username);
-  const char *engineid;
-  u8_t engineid_len;
 
   if (p) {
     /* password should be at least 8 characters long */
     if (strlen(password) >= 8) {
       memset(p->auth_key, 0, sizeof(p->auth_key));
-      snmpv3_get_engine_id(&engineid, &engineid_len);
+      memset(p->auth_master_key, 0, sizeof(p->auth_master_key));
       switch (p->auth_algo) {
       case SNMP_V3_AUTH_ALGO_INVAL:
         return ERR_OK;
 #if LWIP_SNMP_V3_CRYPTO
       case SNMP_V3_AUTH_ALGO_MD5:
-        snmpv3_password_to_key_md5((const u8_t*)password, strlen(password), (const u8_t*)engineid, engineid_len, p->auth_key);
+        snmpv3_password_to_master_key_md5((const u8_t*)password, strlen(password), p->auth_master_key);
+        localize_key(p->auth_algo, p->auth_master_key, p->auth_key);
         return ERR_OK;
       case SNMP_V3_AUTH_ALGO_SHA:
-        snmpv3_password_to_key_sha((const u8_t*)password, strlen(password), (const u8_t*)engineid, engineid_len, p->auth_key);
+        snmpv3_password_to_master_key_sha((const u8_t*)password, strlen(password), p->auth_master_key);
+        localize_key(p->auth_algo, p->auth_master_key, p->auth_key);
         return ERR_OK;
 #endif
       default:
@@ -225,23 +251,23 @@ err_t
 snmpv3_set_user_priv_key(const char *username, const char *password)
 {
   struct user_table_entry *p = get_user(username);
-  const char *engineid;
-  u8_t engineid_len;
 
   if (p) {
     /* password should be at least 8 characters long */
     if (strlen(password) >= 8) {
       memset(p->priv_key, 0, sizeof(p->priv_key));
-      snmpv3_get_engine_id(&engineid, &engineid_len);
+      memset(p->priv_master_key, 0, sizeof(p->priv_master_key));
       switch (p->auth_algo) {
       case SNMP_V3_AUTH_ALGO_INVAL:
         return ERR_OK;
 #if LWIP_SNMP_V3_CRYPTO
       case SNMP_V3_AUTH_ALGO_MD5:
-        snmpv3_password_to_key_md5((const u8_t*)password, strlen(password), (const u8_t*)engineid, engineid_len, p->priv_key);
+        snmpv3_password_to_master_key_md5((const u8_t*)password, strlen(password), p->priv_master_key);
+        localize_key(p->auth_algo, p->priv_master_key, p->priv_key);
         return ERR_OK;
       case SNMP_V3_AUTH_ALGO_SHA:
-        snmpv3_password_to_key_sha((const u8_t*)password, strlen(password), (const u8_t*)engineid, engineid_len, p->priv_key);
+        snmpv3_password_to_master_key_sha((const u8_t*)password, strlen(password), p->priv_master_key);
+        localize_key(p->auth_algo, p->priv_master_key, p->priv_key);
         return ERR_OK;
 #endif
       default:
@@ -331,8 +357,21 @@ snmpv3_get_engine_id(const char **id, u8_t *len)
 err_t
 snmpv3_set_engine_id(const char *id, u8_t len)
 {
+  size_t i;
+
   MEMCPY(snmpv3_engineid, id, len);
   snmpv3_engineid_len = len;
+
+  /* Localized keys depend on the engine ID */
+  for (i = 0; i < LWIP_ARRAYSIZE(user_table); i++) {
+    struct user_table_entry *p = &user_table[i];
+    memset(p->auth_key, 0, sizeof(p->auth_key));
+    memset(p->priv_key, 0, sizeof(p->priv_key));
+#if LWIP_SNMP_V3_CRYPTO
+    localize_key(p->auth_algo, p->auth_master_key, p->auth_key);
+    localize_key(p->auth_algo, p->priv_master_key, p->priv_key);
+#endif
+  }
   return ERR_OK;
 }
 
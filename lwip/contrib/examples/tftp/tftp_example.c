@@ -86,9 +86,10 @@ static int
 tftp_read(void* handle, void* buf, int bytes)
 {
   int ret = fread(buf, 1, bytes, (FILE*)handle);
-  if (ret <= 0) {
+  if ((ret < bytes) && ferror((FILE*)handle)) {
     return -1;
   }
+  /* 0 at end of file: an empty block ends files of a multiple of the block size */
   return ret;
 }
 
@@ -119,12 +120,29 @@ tftp_error(void* handle, int err, const char* msg, int size)
   printf("TFTP error: %d (%s)", err, message);
 }
 
+static int
+tftp_size(void* handle)
+{
+  long size;
+  long pos = ftell((FILE*)handle);
+
+  if ((pos < 0) || (fseek((FILE*)handle, 0, SEEK_END) != 0)) {
+    return -1;
+  }
+  size = ftell((FILE*)handle);
+  if (fseek((FILE*)handle, pos, SEEK_SET) != 0) {
+    return -1;
+  }
+  return (int)size;
+}
+
 static const struct tftp_context tftp = {
   tftp_open,
   tftp_close,
   tftp_read,
   tftp_write,
-  tftp_error
+  tftp_error,
+  tftp_size
 };
 
 void
@@ -35,6 +35,7 @@ SYSARCH?=$(LWIPARCH)/sys_arch.c
 ARCHFILES=$(LWIPARCH)/perf.c \
   $(SYSARCH) \
 	$(LWIPARCH)/netif/tapif.c \
+	$(LWIPARCH)/netif/afpacketif.c \
 	$(LWIPARCH)/netif/list.c \
 	$(LWIPARCH)/netif/sio.c \
 	$(LWIPARCH)/netif/fifo.c
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2001-2003 Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the lwIP TCP/IP stack.
+ *
+ */
+#ifndef LWIP_LWIPOPTS_H
+#define LWIP_LWIPOPTS_H
+
+/* Options for the benchmarks: mainloop mode, everything runs on one
+ * in-memory link, so there is no locking and no threads. */
+#define NO_SYS                     1
+#define LWIP_SOCKET                0
+#define LWIP_NETCONN               0
+#define SYS_LIGHTWEIGHT_PROT       0
+
+#define LWIP_IPV4                  1
+#define LWIP_IPV6                  0
+#define LWIP_UDP                   1
+#define LWIP_TCP                   1
+
+#define MEM_ALIGNMENT              4
+#define MEM_SIZE                   (1024 * 1024)
+#define MEMP_NUM_PBUF              64
+#define PBUF_POOL_SIZE             128
+#define MEMP_NUM_SYS_TIMEOUT       (LWIP_NUM_SYS_TIMEOUT_INTERNAL + 4)
+
+/* MIB-II of the SNMP agent reads the MIB2 counters */
+#define LWIP_STATS                 1
+#define MIB2_STATS                 1
+#define LWIP_NETIF_LOOPBACK        0
+
+/* TFTP: allow the largest window the stand-in server may accept */
+#define TFTP_MAX_WINDOWSIZE        64
+
+/* SNMP: MIB-II with table and MIB indices, room for the table rows of
+ * snmp_bench. The caches can be disabled with BENCHFLAGS, see snmp_bench.c. */
+#define LWIP_SNMP                  1
+#define MEMP_NUM_UDP_PCB           80
+#define MEMP_NUM_TCP_PCB           8
+#define MEMP_NUM_TCP_PCB_LISTEN    80
+#define SNMP_LWIP_MIB2_TABLE_INDEX_SIZE 128
+#ifndef SNMP_LWIP_MIB_INDEX_SIZE
+#define SNMP_LWIP_MIB_INDEX_SIZE   256
+#endif
+/* SNMPv3 authPriv walks need mbedTLS */
+#if defined(LWIP_HAVE_MBEDTLS) && LWIP_HAVE_MBEDTLS
+#define LWIP_SNMP_V3               1
+#endif
+
+/* PPPoS: a client and a server on an in-memory serial line. The bytewise
+ * FCS can be selected with BENCHFLAGS, see pppos_bench.c. */
+#define PPP_SUPPORT                1
+#define PPPOS_SUPPORT              1
+#define PPP_SERVER                 1
+#define MEMP_NUM_PPP_PCB           2
+#ifndef PPP_FCS_TABLE
+#define PPP_FCS_TABLE              2
+#endif
+
+/* MQTT: the client and the stand-in broker of mqtt_bench share one TCP
+ * stack, the windows allow for the largest in-flight window of the runs */
+#define TCP_MSS                    1460
+#define TCP_WND                    (32 * TCP_MSS)
+#define TCP_SND_BUF                (32 * TCP_MSS)
+#define TCP_SND_QUEUELEN           128
+#define MEMP_NUM_TCP_SEG           TCP_SND_QUEUELEN
+#define MQTT_OUTPUT_RINGBUF_SIZE   (8 * 1024)
+#define MQTT_OUTPUT_PBUF_QUEUE_LEN 64
+
+/* keep debug output out of the measurements */
+#define LWIP_DBG_TYPES_ON          LWIP_DBG_OFF
+
+#endif /* LWIP_LWIPOPTS_H */
@@ -0,0 +1,601 @@
+/*
+ * Copyright (c) 2001-2003 Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the lwIP TCP/IP stack.
+ *
+ */
+
+/**
+ * @file
+ * MQTT client publish rate benchmark
+ *
+ * The lwIP MQTT client publishes to a minimal MQTT 3.1.1 stand-in broker (a
+ * raw tcp_pcb in this file) over an in-memory link, so a run measures the
+ * MQTT, TCP and IPv4 code paths only. The client keeps its in-flight window
+ * full for the whole run, i.e. a new message is published as soon as
+ * mqtt_publish() accepts it, and the run ends when every request callback
+ * has been called. The broker checks every message and counts duplicates.
+ * Besides the rate, a run reports the packets on the link per message, i.e.
+ * how well publishes and acknowledgements share TCP segments.
+ * Runs marked "session" connect with mqtt_client_set_session(keep_session=1).
+ * The broker can then drop the connection every n-th publish to measure
+ * session resumption: the client reconnects and resends what was not
+ * acknowledged.
+ *
+ * Usage: mqtt_bench [messages per run] [payload size] [drop connection every n-th publish]
+ */
+
+#include "lwip/init.h"
+#include "lwip/netif.h"
+#include "lwip/tcp.h"
+#include "lwip/sys.h"
+#include "lwip/timeouts.h"
+#include "lwip/apps/mqtt.h"
+#include "lwip/priv/tcp_priv.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#if LWIP_MQTT_V5
+#error "the stand-in broker of mqtt_bench speaks MQTT 3.1.1 only"
+#endif
+
+#define MQTT_CONNECT     1
+#define MQTT_CONNACK     2
+#define MQTT_PUBLISH     3
+#define MQTT_PUBACK      4
+#define MQTT_PUBREC      5
+#define MQTT_PUBREL      6
+#define MQTT_PUBCOMP     7
+#define MQTT_PINGREQ     12
+#define MQTT_PINGRESP    13
+#define MQTT_DISCONNECT  14
+
+#define BENCH_TOPIC         "bench/telemetry"
+#define BENCH_MAX_PAYLOAD   1024
+#define BENCH_LINK_QUEUE    256
+#define BENCH_RUN_TIMEOUT   10 /* seconds without progress */
+
+enum bench_client_state {
+  BENCH_DISCONNECTED,
+  BENCH_CONNECTING,
+  BENCH_CONNECTED
+};
+
+/* MQTT stand-in broker, accepts one client connection at a time */
+struct bench_broker {
+  struct tcp_pcb *listen_pcb;
+  struct tcp_pcb *pcb;
+  /* received data not parsed yet */
+  struct pbuf *rx;
+  u8_t session;
+  u8_t drop;
+  u32_t drop_every;
+  u32_t publishes;
+  u32_t errors;
+  u32_t messages;
+  /* number of deliveries per message */
+  u8_t *delivered;
+  /* packet ids of QoS 2 publishes waiting for PUBREL (bitmap) */
+  u8_t qos2_pending[0x10000 / 8];
+};
+
+static struct netif bench_netif;
+static struct bench_broker broker;
+
+static enum bench_client_state client_state;
+static u32_t client_done;
+static u32_t client_failed;
+static u32_t client_reconnects;
+
+/* in-memory link: packets sent on bench_netif are received on it again */
+static struct pbuf *link_queue[BENCH_LINK_QUEUE];
+static unsigned link_head, link_tail;
+static u32_t link_packets;
+static u32_t link_dropped;
+
+/* message seq: 4 bytes sequence number, then bytes generated from it */
+static void
+bench_payload(u8_t *buf, u32_t seq, u16_t len)
+{
+  u16_t i;
+  for (i = 0; i < len; i++) {
+    buf[i] = (i < 4) ? (u8_t)(seq >> (24 - 8 * i)) : (u8_t)(seq + i);
+  }
+}
+
+static double
+bench_time(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+/* Link functions */
+static err_t
+link_output(struct netif *netif, struct pbuf *p, const ip4_addr_t *ipaddr)
+{
+  struct pbuf *q;
+  LWIP_UNUSED_ARG(netif);
+  LWIP_UNUSED_ARG(ipaddr);
+
+  if ((u16_t)(link_head + 1) % BENCH_LINK_QUEUE == link_tail) {
+    link_dropped++;
+    return ERR_OK;
+  }
+  q = pbuf_clone(PBUF_RAW, PBUF_RAM, p);
+  if (q == NULL) {
+    link_dropped++;
+    return ERR_OK;
+  }
+  link_packets++;
+  link_queue[link_head] = q;
+  link_head = (link_head + 1) % BENCH_LINK_QUEUE;
+  return ERR_OK;
+}
+
+static err_t
+link_init(struct netif *netif)
+{
+  netif->name[0] = 'b';
+  netif->name[1] = 'n';
+  netif->output = link_output;
+  netif->mtu = 1500;
+  netif->flags = NETIF_FLAG_LINK_UP;
+  return ERR_OK;
+}
+
+/* deliver queued packets, returns 0 if the queue was empty */
+static int
+link_poll(void)
+{
+  int cnt = 0;
+  while (link_tail != link_head) {
+    struct pbuf *p = link_queue[link_tail];
+    link_tail = (link_tail + 1) % BENCH_LINK_QUEUE;
+    if (bench_netif.input(p, &bench_netif) != ERR_OK) {
+      pbuf_free(p);
+    }
+    cnt++;
+  }
+  return cnt;
+}
+
+/* Stand-in broker */
+static void
+broker_send(u8_t type, u8_t flags, u16_t pkt_id)
+{
+  u8_t msg[4];
+  msg[0] = (u8_t)((type << 4) | flags);
+  msg[1] = 2;
+  msg[2] = (u8_t)(pkt_id >> 8);
+  msg[3] = (u8_t)pkt_id;
+  if (tcp_write(broker.pcb, msg, sizeof(msg), TCP_WRITE_FLAG_COPY) != ERR_OK) {
+    broker.errors++;
+  }
+}
+
+static void
+broker_close(void)
+{
+  if (broker.pcb != NULL) {
+    tcp_arg(broker.pcb, NULL);
+    tcp_recv(broker.pcb, NULL);
+    tcp_err(broker.pcb, NULL);
+    if (tcp_close(broker.pcb) != ERR_OK) {
+      tcp_abort(broker.pcb);
+    }
+    broker.pcb = NULL;
+  }
+  if (broker.rx != NULL) {
+    pbuf_free(broker.rx);
+    broker.rx = NULL;
+  }
+}
+
+/* drop the connection without a DISCONNECT, the client sees a reset */
+static void
+broker_abort(void)
+{
+  struct tcp_pcb *pcb = broker.pcb;
+  broker.drop = 0;
+  if (pcb != NULL) {
+    tcp_err(pcb, NULL);
+    broker.pcb = NULL;
+    tcp_abort(pcb);
+  }
+  if (broker.rx != NULL) {
+    pbuf_free(broker.rx);
+    broker.rx = NULL;
+  }
+}
+
+static void
+broker_connect(u16_t offset)
+{
+  /* flags follow the protocol name and level */
+  u8_t clean = (u8_t)(pbuf_get_at(broker.rx, (u16_t)(offset + 7)) & 0x02);
+  u8_t msg[4];
+
+  msg[0] = MQTT_CONNACK << 4;
+  msg[1] = 2;
+  msg[2] = (u8_t)((!clean && broker.session) ? 1 : 0);
+  msg[3] = 0;
+  if (clean) {
+    memset(broker.qos2_pending, 0, sizeof(broker.qos2_pending));
+  }
+  broker.session = (u8_t)!clean;
+  if (tcp_write(broker.pcb, msg, sizeof(msg), TCP_WRITE_FLAG_COPY) != ERR_OK) {
+    broker.errors++;
+  }
+}
+
+static void
+broker_publish(u8_t flags, u16_t offset, u16_t len)
+{
+  u8_t payload[BENCH_MAX_PAYLOAD];
+  u8_t expected[BENCH_MAX_PAYLOAD];
+  u8_t qos = (u8_t)((flags >> 1) & 3);
+  u16_t topic_len = (u16_t)((pbuf_get_at(broker.rx, offset) << 8) | pbuf_get_at(broker.rx, (u16_t)(offset + 1)));
+  u16_t hdr_len = (u16_t)(2 + topic_len + ((qos > 0) ? 2 : 0));
+  u16_t pkt_id = 0;
+  u16_t payload_len;
+  u32_t seq;
+
+  if ((qos > 2) || (hdr_len + 4 > len) || (len - hdr_len > BENCH_MAX_PAYLOAD)) {
+    broker.errors++;
+    return;
+  }
+  if (qos > 0) {
+    pkt_id = (u16_t)((pbuf_get_at(broker.rx, (u16_t)(offset + hdr_len - 2)) << 8) |
+                     pbuf_get_at(broker.rx, (u16_t)(offset + hdr_len - 1)));
+  }
+  payload_len = (u16_t)(len - hdr_len);
+  pbuf_copy_partial(broker.rx, payload, payload_len, (u16_t)(offset + hdr_len));
+  seq = ((u32_t)payload[0] << 24) | ((u32_t)payload[1] << 16) | ((u32_t)payload[2] << 8) | payload[3];
+  bench_payload(expected, seq, payload_len);
+  if ((seq >= broker.messages) || memcmp(payload, expected, payload_len)) {
+    broker.errors++;
+    return;
+  }
+
+  if (qos == 2) {
+    /* exactly once: a resent publish with a pending packet id was delivered already */
+    u8_t bit = (u8_t)(1 << (pkt_id & 7));
+    if (!(broker.qos2_pending[pkt_id >> 3] & bit)) {
+      broker.qos2_pending[pkt_id >> 3] |= bit;
+      broker.delivered[seq]++;
+    }
+    broker_send(MQTT_PUBREC, 0, pkt_id);
+  } else {
+    broker.delivered[seq]++;
+    if (qos == 1) {
+      broker_send(MQTT_PUBACK, 0, pkt_id);
+    }
+  }
+  broker.publishes++;
+  if ((broker.drop_every != 0) && ((broker.publishes % broker.drop_every) == 0)) {
+    broker.drop = 1;
+  }
+}
+
+/* parse one complete packet from broker.rx, returns 0 if there is none */
+static int
+broker_parse(void)
+{
+  u32_t len = 0;
+  u16_t offset = 1;
+  u8_t type, flags, b;
+
+  if ((broker.rx == NULL) || (broker.pcb == NULL) || broker.drop) {
+    return 0;
+  }
+  /* remaining length, at most 4 bytes */
+  do {
+    if ((offset >= broker.rx->tot_len) || (offset > 4)) {
+      return 0;
+    }
+    b = pbuf_get_at(broker.rx, offset);
+    len |= (u32_t)(b & 0x7f) << (7 * (offset - 1));
+    offset++;
+  } while (b & 0x80);
+  if (offset + len > broker.rx->tot_len) {
+    return 0;
+  }
+
+  type = (u8_t)(pbuf_get_at(broker.rx, 0) >> 4);
+  flags = (u8_t)(pbuf_get_at(broker.rx, 0) & 0x0f);
+  switch (type) {
+    case MQTT_CONNECT:
+      broker_connect(offset);
+      break;
+    case MQTT_PUBLISH:
+      broker_publish(flags, offset, (u16_t)len);
+      break;
+    case MQTT_PUBREL: {
+      u16_t pkt_id = (u16_t)((pbuf_get_at(broker.rx, offset) << 8) | pbuf_get_at(broker.rx, (u16_t)(offset + 1)));
+      broker.qos2_pending[pkt_id >> 3] &= (u8_t)~(1 << (pkt_id & 7));
+      broker_send(MQTT_PUBCOMP, 0, pkt_id);
+      break;
+    }
+    case MQTT_PINGREQ: {
+      u8_t msg[2] = { MQTT_PINGRESP << 4, 0 };
+      tcp_write(broker.pcb, msg, sizeof(msg), TCP_WRITE_FLAG_COPY);
+      break;
+    }
+    case MQTT_DISCONNECT:
+      broker_close();
+      return 0;
+    default:
+      broker.errors++;
+      break;
+  }
+  broker.rx = pbuf_free_header(broker.rx, (u16_t)(offset + len));
+  return 1;
+}
+
+static err_t
+broker_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err)
+{
+  LWIP_UNUSED_ARG(arg);
+  LWIP_UNUSED_ARG(err);
+
+  if (p == NULL) {
+    broker_close();
+    return ERR_OK;
+  }
+  tcp_recved(pcb, p->tot_len);
+  if (broker.rx == NULL) {
+    broker.rx = p;
+  } else {
+    pbuf_cat(broker.rx, p);
+  }
+  while (broker_parse()) {
+  }
+  if (broker.pcb != NULL) {
+    /* acknowledge at once like most hosts do: QoS 0 publishes have no
+       response to carry the ACK, and the client waits for it (Nagle) */
+    tcp_ack_now(broker.pcb);
+    tcp_output(broker.pcb);
+  }
+  return ERR_OK;
+}
+
+static void
+broker_err(void *arg, err_t err)
+{
+  LWIP_UNUSED_ARG(arg);
+  LWIP_UNUSED_ARG(err);
+  broker.pcb = NULL;
+  if (broker.rx != NULL) {
+    pbuf_free(broker.rx);
+    broker.rx = NULL;
+  }
+}
+
+static err_t
+broker_accept(void *arg, struct tcp_pcb *pcb, err_t err)
+{
+  LWIP_UNUSED_ARG(arg);
+  LWIP_UNUSED_ARG(err);
+
+  broker_close();
+  broker.pcb = pcb;
+  tcp_nagle_disable(pcb);
+  tcp_recv(pcb, broker_recv);
+  tcp_err(pcb, broker_err);
+  return ERR_OK;
+}
+
+/* MQTT client callbacks */
+static void
+client_connection_cb(mqtt_client_t *client, void *arg, mqtt_connection_status_t status)
+{
+  LWIP_UNUSED_ARG(client);
+  LWIP_UNUSED_ARG(arg);
+  client_state = (status == MQTT_CONNECT_ACCEPTED) ? BENCH_CONNECTED : BENCH_DISCONNECTED;
+}
+
+static void
+client_pub_cb(void *arg, err_t err)
+{
+  LWIP_UNUSED_ARG(arg);
+  if (err == ERR_OK) {
+    client_done++;
+  } else {
+    client_failed++;
+  }
+}
+
+/* Run one series of publishes, returns 0 on success */
+static int
+bench_run(u8_t qos, u16_t window, u8_t keep_session, u32_t messages, u16_t payload_len, u32_t drop_every)
+{
+  static const struct mqtt_connect_client_info_t client_info = {
+    "bench", NULL, NULL, 0, NULL, NULL, 0, 0
+  };
+  u8_t payload[BENCH_MAX_PAYLOAD];
+  mqtt_client_t *client;
+  ip_addr_t broker_addr;
+  double start, secs, last_progress;
+  u32_t sent = 0, progress = 0, dups = 0, lost = 0, i;
+  int ret = 0;
+
+  client = mqtt_client_new();
+  LWIP_ASSERT("mqtt_client_new failed", client != NULL);
+  if (mqtt_client_set_session(client, window, keep_session) != ERR_OK) {
+    mqtt_client_free(client);
+    return -1;
+  }
+
+  broker.delivered = (u8_t *)calloc(messages, 1);
+  LWIP_ASSERT("calloc failed", broker.delivered != NULL);
+  broker.messages = messages;
+  broker.session = 0;
+  broker.publishes = 0;
+  broker.errors = 0;
+  /* only resumed sessions deliver everything after a dropped connection */
+  broker.drop_every = (keep_session && (qos > 0)) ? drop_every : 0;
+  client_state = BENCH_DISCONNECTED;
+  client_done = 0;
+  client_failed = 0;
+  client_reconnects = 0;
+  link_packets = 0;
+  link_dropped = 0;
+
+  ip_addr_copy_from_ip4(broker_addr, *netif_ip4_addr(&bench_netif));
+  start = bench_time();
+  last_progress = start;
+  while (client_done + client_failed < messages) {
+    if (broker.drop) {
+      broker_abort();
+    }
+    if (client_state == BENCH_DISCONNECTED) {
+      if (sent > 0) {
+        client_reconnects++;
+      }
+      if (mqtt_client_connect(client, &broker_addr, MQTT_PORT, client_connection_cb, NULL, &client_info) != ERR_OK) {
+        ret = -1;
+        break;
+      }
+      client_state = BENCH_CONNECTING;
+    }
+    /* keep the window full */
+    while ((client_state == BENCH_CONNECTED) && (sent < messages)) {
+      bench_payload(payload, sent, payload_len);
+      if (mqtt_publish(client, BENCH_TOPIC, payload, payload_len, qos, 0, client_pub_cb, NULL) != ERR_OK) {
+        break;
+      }
+      sent++;
+    }
+    if (!link_poll()) {
+      sys_check_timeouts();
+    }
+    if (client_done + client_failed != progress) {
+      progress = client_done + client_failed;
+      last_progress = bench_time();
+    } else if (bench_time() - last_progress > BENCH_RUN_TIMEOUT) {
+      printf("no progress, %u of %u messages done\n", (unsigned)progress, (unsigned)messages);
+      ret = -1;
+      break;
+    }
+  }
+  secs = bench_time() - start;
+
+  mqtt_disconnect(client);
+  while (link_poll() || (broker.pcb != NULL)) {
+    sys_check_timeouts();
+  }
+  mqtt_client_free(client);
+
+  for (i = 0; i < messages; i++) {
+    if (broker.delivered[i] == 0) {
+      lost++;
+    } else if (broker.delivered[i] > 1) {
+      dups += broker.delivered[i] - 1u;
+    }
+  }
+  free(broker.delivered);
+  broker.delivered = NULL;
+
+  if (ret || client_failed || broker.errors || lost || ((qos == 2) && dups)) {
+    printf("qos %u window %3u%s: run FAILED, %u failed, %u lost, %u dup, %u broker errors\n",
+           (unsigned)qos, (unsigned)window, keep_session ? " session" : "        ",
+           (unsigned)client_failed, (unsigned)lost, (unsigned)dups, (unsigned)broker.errors);
+    return -1;
+  }
+  printf("qos %u window %3u%s: %7u msgs in %7.3f s, %9.0f msgs/s, %6.2f MiB/s, %5.2f packets/msg, %5u dup, %3u reconnects, %u dropped\n",
+         (unsigned)qos, (unsigned)window, keep_session ? " session" : "        ",
+         (unsigned)messages, secs, (double)messages / secs,
+         (double)messages * payload_len / secs / (1024.0 * 1024.0),
+         (double)link_packets / messages, (unsigned)dups, (unsigned)client_reconnects,
+         (unsigned)link_dropped);
+  return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+  static const u16_t runs[][3] = {
+    /* qos, window, keep_session */
+    { 0,  4, 0 },
+    { 0, 64, 0 },
+    { 1,  1, 0 },
+    { 1,  4, 0 },
+    { 1, 16, 0 },
+    { 1, 64, 0 },
+    { 2,  1, 0 },
+    { 2,  4, 0 },
+    { 2, 16, 0 },
+    { 2, 64, 0 },
+    { 1, 16, 1 },
+    { 2, 16, 1 }
+  };
+  ip4_addr_t ipaddr, netmask, gw;
+  u32_t messages = 100000;
+  u16_t payload_len = 64;
+  u32_t drop_every = 0;
+  size_t i;
+  int ret = 0;
+
+  if (argc > 1) {
+    messages = (u32_t)strtoul(argv[1], NULL, 10);
+  }
+  if (argc > 2) {
+    payload_len = (u16_t)LWIP_MIN(strtoul(argv[2], NULL, 10), BENCH_MAX_PAYLOAD);
+  }
+  if (argc > 3) {
+    drop_every = (u32_t)strtoul(argv[3], NULL, 10);
+  }
+  /* the payload starts with the sequence number */
+  payload_len = LWIP_MAX(payload_len, 4);
+
+  lwip_init();
+
+  IP4_ADDR(&ipaddr, 10, 0, 0, 1);
+  IP4_ADDR(&netmask, 255, 255, 255, 0);
+  ip4_addr_set_zero(&gw);
+  netif_add(&bench_netif, &ipaddr, &netmask, &gw, NULL, link_init, netif_input);
+  netif_set_default(&bench_netif);
+  netif_set_up(&bench_netif);
+
+  broker.listen_pcb = tcp_new();
+  LWIP_ASSERT("tcp_new failed", broker.listen_pcb != NULL);
+  tcp_bind(broker.listen_pcb, IP_ADDR_ANY, MQTT_PORT);
+  broker.listen_pcb = tcp_listen(broker.listen_pcb);
+  LWIP_ASSERT("tcp_listen failed", broker.listen_pcb != NULL);
+  tcp_accept(broker.listen_pcb, broker_accept);
+
+  for (i = 0; i < LWIP_ARRAYSIZE(runs); i++) {
+    ret |= bench_run((u8_t)runs[i][0], runs[i][1], (u8_t)runs[i][2], messages, payload_len, drop_every);
+  }
+
+  tcp_close(broker.listen_pcb);
+  return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,302 @@
+/*
+ * Copyright (c) 2001-2003 Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the lwIP TCP/IP stack.
+ *
+ */
+
+/**
+ * @file
+ * PPPoS framing throughput benchmark
+ *
+ * Two PPPoS pcbs, a client and a server, are connected by an in-memory
+ * serial line: the output callback of each side queues the bytes, which are
+ * then fed to pppos_input() of the other side in chunks of the size a UART
+ * driver would deliver. After LCP and IPCP are up the client sends UDP
+ * packets of a full MTU to the server, which checks every packet, so a run
+ * measures the HDLC-like framing (FCS and ACCM escaping) on both the TX and
+ * RX side plus the IPv4 and UDP code paths.
+ * Every run negotiates a new session with the asyncmap of the run, payloads
+ * are either printable text (nothing to escape) or pseudo-random binary.
+ * Build with BENCHFLAGS="-DPPP_FCS_TABLE=1" to compare the bytewise FCS
+ * against slice-by-8.
+ *
+ * Usage: pppos_bench [packets per run] [serial chunk size]
+ */
+
+#include "lwip/init.h"
+#include "lwip/netif.h"
+#include "lwip/udp.h"
+#include "lwip/sys.h"
+#include "lwip/timeouts.h"
+#include "netif/ppp/pppos.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#if !PPP_SUPPORT || !PPPOS_SUPPORT || !PPP_SERVER
+#error "pppos_bench needs PPPoS with server support"
+#endif
+
+#define BENCH_PORT          7
+#define BENCH_PAYLOAD       1472 /* 1500 byte IP packets */
+#define BENCH_SERIAL_QUEUE  (64 * 1024)
+#define BENCH_SETUP_TIMEOUT 10000
+
+/* bytes one side wrote to the serial line, not yet read by the other side */
+struct bench_serial {
+  u8_t data[BENCH_SERIAL_QUEUE];
+  u32_t len;
+  u32_t total;
+  u32_t overrun;
+};
+
+/* [0] is the client, [1] the server */
+static struct bench_serial serial[2];
+static ppp_pcb *bench_pcb[2];
+static struct netif bench_netif[2];
+static u32_t serial_chunk = 64;
+
+static u8_t payload[BENCH_PAYLOAD];
+static u32_t rx_packets;
+static u32_t rx_errors;
+
+static double
+bench_time(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+static u32_t
+serial_output(ppp_pcb *pcb, u8_t *data, u32_t len, void *ctx)
+{
+  struct bench_serial *s = (struct bench_serial *)ctx;
+  LWIP_UNUSED_ARG(pcb);
+
+  if (s->len + len > sizeof(s->data)) {
+    s->overrun += len;
+    return len;
+  }
+  memcpy(&s->data[s->len], data, len);
+  s->len += len;
+  s->total += len;
+  return len;
+}
+
+static void
+ppp_status(ppp_pcb *pcb, int err_code, void *ctx)
+{
+  LWIP_UNUSED_ARG(pcb);
+  LWIP_UNUSED_ARG(err_code);
+  LWIP_UNUSED_ARG(ctx);
+}
+
+/* read the serial line of both directions */
+static void
+serial_pump(void)
+{
+  static u8_t buf[BENCH_SERIAL_QUEUE];
+  int side;
+
+  for (side = 0; side < 2; side++) {
+    struct bench_serial *s = &serial[side];
+    u32_t len = s->len;
+    u32_t off, n;
+    /* the receiver may answer, which appends to the other queue only */
+    memcpy(buf, s->data, len);
+    s->len = 0;
+    for (off = 0; off < len; off += n) {
+      n = LWIP_MIN(len - off, serial_chunk);
+      pppos_input(bench_pcb[!side], &buf[off], (int)n);
+    }
+  }
+}
+
+/* run the line and the timers until both sides reached 'phase' */
+static int
+bench_wait_phase(u8_t phase)
+{
+  u32_t start = sys_now();
+
+  while ((bench_pcb[0]->phase != phase) || (bench_pcb[1]->phase != phase)) {
+    if ((u32_t)(sys_now() - start) > BENCH_SETUP_TIMEOUT) {
+      printf("timeout waiting for phase %d: client %d, server %d\n",
+             phase, bench_pcb[0]->phase, bench_pcb[1]->phase);
+      return -1;
+    }
+    serial_pump();
+    sys_check_timeouts();
+  }
+  return 0;
+}
+
+static void
+server_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port)
+{
+  LWIP_UNUSED_ARG(arg);
+  LWIP_UNUSED_ARG(pcb);
+  LWIP_UNUSED_ARG(addr);
+  LWIP_UNUSED_ARG(port);
+
+  if ((p->tot_len == sizeof(payload)) && (pbuf_memcmp(p, 0, payload, sizeof(payload)) == 0)) {
+    rx_packets++;
+  } else {
+    rx_errors++;
+  }
+  pbuf_free(p);
+}
+
+static void
+bench_payload(int binary)
+{
+  u32_t x = 0x12345678;
+  size_t i;
+
+  for (i = 0; i < sizeof(payload); i++) {
+    if (binary) {
+      x = x * 1103515245UL + 12345UL;
+      payload[i] = (u8_t)(x >> 16);
+    } else {
+      payload[i] = (u8_t)('0' + (i % 64));
+    }
+  }
+}
+
+static int
+bench_run(struct udp_pcb *tx, u32_t accm, int binary, u32_t packets)
+{
+  ip4_addr_t client_ip, server_ip;
+  double start, elapsed;
+  u32_t wire, i;
+  int side;
+
+  /* the asyncmap each side asks for is the one its peer sends with */
+  for (side = 0; side < 2; side++) {
+    ppp_set_asyncmap(bench_pcb[side], accm);
+  }
+  IP4_ADDR(&client_ip, 10, 0, 0, 1);
+  IP4_ADDR(&server_ip, 10, 0, 0, 2);
+  ppp_set_ipcp_ouraddr(bench_pcb[1], &server_ip);
+  ppp_set_ipcp_hisaddr(bench_pcb[1], &client_ip);
+  if ((ppp_listen(bench_pcb[1]) != ERR_OK) || (ppp_connect(bench_pcb[0], 0) != ERR_OK) ||
+      (bench_wait_phase(PPP_PHASE_RUNNING) != 0)) {
+    return -1;
+  }
+
+  bench_payload(binary);
+  rx_packets = rx_errors = 0;
+  serial[0].total = 0;
+
+  start = bench_time();
+  for (i = 0; i < packets; i++) {
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, sizeof(payload), PBUF_RAM);
+    if (p == NULL) {
+      printf("out of memory\n");
+      return -1;
+    }
+    pbuf_take(p, payload, sizeof(payload));
+    udp_sendto_if(tx, p, &server_ip, BENCH_PORT, &bench_netif[0]);
+    pbuf_free(p);
+    serial_pump();
+    sys_check_timeouts();
+  }
+  elapsed = bench_time() - start;
+  wire = serial[0].total;
+
+  printf("accm %08"X32_F" %-6s: %7.1f MB/s, %.3f line bytes per payload byte, %"U32_F" lost, %"U32_F" errors\n",
+         accm, binary ? "binary" : "text",
+         (double)packets * sizeof(payload) / elapsed / 1e6,
+         (double)wire / ((double)packets * sizeof(payload)),
+         packets - rx_packets - rx_errors, rx_errors);
+
+  /* close both ends, the side receiving a Terminate-Request would otherwise
+   * wait for a restart timer before it goes down */
+  ppp_close(bench_pcb[0], 0);
+  ppp_close(bench_pcb[1], 0);
+  if (bench_wait_phase(PPP_PHASE_DEAD) != 0) {
+    return -1;
+  }
+  if ((rx_packets != packets) || (serial[0].overrun != 0) || (serial[1].overrun != 0)) {
+    return -1;
+  }
+  return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+  static const u32_t accms[] = {
+    0x00000000UL, /* nothing but flag and escape */
+    0x000a0000UL, /* XON/XOFF */
+    0xffffffffUL  /* all control characters, the LCP default */
+  };
+  struct udp_pcb *tx, *rx;
+  u32_t packets = 20000;
+  size_t i;
+  int side, binary, ret = 0;
+
+  if (argc > 1) {
+    packets = (u32_t)strtoul(argv[1], NULL, 10);
+  }
+  if ((argc > 2) && (strtoul(argv[2], NULL, 10) > 0)) {
+    serial_chunk = (u32_t)strtoul(argv[2], NULL, 10);
+  }
+
+  lwip_init();
+
+  for (side = 0; side < 2; side++) {
+    bench_pcb[side] = pppos_create(&bench_netif[side], serial_output, ppp_status, &serial[side]);
+    LWIP_ASSERT("pppos_create failed", bench_pcb[side] != NULL);
+  }
+
+  tx = udp_new();
+  rx = udp_new();
+  LWIP_ASSERT("udp_new failed", (tx != NULL) && (rx != NULL));
+  udp_bind(rx, IP_ADDR_ANY, BENCH_PORT);
+  udp_recv(rx, server_recv, NULL);
+
+  printf("PPPoS, %"U32_F" packets of %d bytes per run, %"U32_F" byte serial chunks, PPP_FCS_TABLE %d\n",
+         packets, BENCH_PAYLOAD, serial_chunk, PPP_FCS_TABLE);
+  for (i = 0; i < LWIP_ARRAYSIZE(accms); i++) {
+    for (binary = 0; binary < 2; binary++) {
+      if (bench_run(tx, accms[i], binary, packets) != 0) {
+        printf("run failed\n");
+        ret = 1;
+      }
+    }
+  }
+
+  udp_remove(tx);
+  udp_remove(rx);
+  for (side = 0; side < 2; side++) {
+    ppp_free(bench_pcb[side]);
+  }
+  return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}
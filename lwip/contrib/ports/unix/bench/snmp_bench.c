@@ -0,0 +1,906 @@
+/*
+ * Copyright (c) 2001-2003 Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the lwIP TCP/IP stack.
+ *
+ */
+
+/**
+ * @file
+ * SNMP agent MIB-II walk benchmark
+ *
+ * A minimal SNMPv2c manager (a raw udp_pcb in this file) walks MIB-II of the
+ * lwIP agent over an in-memory link, with GetNext and with GetBulk requests
+ * of several max-repetitions values, then walks the columns of tcpConnTable
+ * with one GetBulk repeater per column, the way a network management station
+ * reads a table. The tables are filled with listening TCP and bound UDP pcbs.
+ * Every GetBulk walk must return the OIDs of the GetNext walk. The time of the
+ * fastest walk of a run is reported.
+ * With LWIP_SNMP_V3 (enabled in lwipopts.h when mbedTLS is found), MIB-II is
+ * walked again with SNMPv3 authPriv requests (HMAC-SHA-96 and AES-128) of
+ * the user "lwip". The manager knows the engine ID, boots and time of the
+ * agent, it does not do discovery. Build with
+ * BENCHFLAGS="-DLWIP_SNMP_V3_CRYPTO_CTX_CACHE_SIZE=0" to measure without the
+ * HMAC and cipher context cache.
+ * Build with BENCHFLAGS="-DSNMP_LWIP_GETBULK_CURSORS=0 -DSNMP_LWIP_MIB_INDEX_SIZE=0"
+ * to measure without GetBulk cursors and MIB index.
+ *
+ * Usage: snmp_bench [number of TCP and UDP pcbs] [walks per run]
+ */
+
+#include "lwip/init.h"
+#include "lwip/netif.h"
+#include "lwip/udp.h"
+#include "lwip/tcp.h"
+#include "lwip/apps/snmp.h"
+#include "lwip/prot/iana.h"
+#if LWIP_SNMP_V3
+#include "lwip/apps/snmpv3.h"
+#include "mbedtls/md.h"
+#include "mbedtls/aes.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#define BER_INTEGER       0x02
+#define BER_OCTET_STRING  0x04
+#define BER_NULL          0x05
+#define BER_OID           0x06
+#define BER_SEQUENCE      0x30
+#define SNMP_GETNEXT_PDU  0xa1
+#define SNMP_RESPONSE_PDU 0xa2
+#define SNMP_GETBULK_PDU  0xa5
+#define SNMP_END_OF_MIB   0x82
+#define SNMP_V3_AUTHPRIV_REPORTABLE 0x07
+#define SNMP_V3_USM       3
+#define BENCH_SHA_LEN     20
+/* HMAC-SHA-96 */
+#define BENCH_AUTH_PARAM_LEN 12
+
+#define BENCH_MANAGER_PORT 1161
+#define BENCH_MSG_SIZE     1500
+#define BENCH_LINK_QUEUE   64
+#define BENCH_MAX_COLUMNS  8
+
+struct bench_oid {
+  u32_t id[SNMP_MAX_OBJ_ID_LEN];
+  u8_t len;
+};
+
+/* result of a walk */
+struct bench_walk {
+  u32_t requests;
+  u32_t varbinds;
+  /* FNV-1a hash of all OIDs received, in order */
+  u32_t hash;
+  int error;
+};
+
+static struct netif bench_netif;
+static struct udp_pcb *manager_pcb;
+static u32_t request_id;
+
+/* response received by the manager */
+static u8_t response[BENCH_MSG_SIZE];
+static u16_t response_len;
+
+#if LWIP_SNMP_V3
+/* walk with SNMPv3 authPriv messages instead of SNMPv2c */
+static int bench_v3;
+static const u8_t bench_engine_id[] = { 0x80, 0x00, 0x1f, 0x88, 0x04, 'b', 'e', 'n', 'c', 'h' };
+static const char bench_user[] = "lwip";
+/* keys of bench_user, localized with bench_engine_id */
+static u8_t bench_auth_key[BENCH_SHA_LEN];
+static u8_t bench_priv_key[BENCH_SHA_LEN];
+static u32_t bench_salt;
+
+/* position of the security parameters and the ScopedPDU of a v3 message */
+struct bench_v3_msg {
+  u32_t boots;
+  u32_t time;
+  u16_t auth_pos;
+  u8_t salt[8];
+  u16_t data_pos;
+  u16_t data_len;
+};
+#endif /* LWIP_SNMP_V3 */
+
+/* in-memory link: packets sent on bench_netif are received on it again */
+static struct pbuf *link_queue[BENCH_LINK_QUEUE];
+static unsigned link_head, link_tail;
+
+static double
+bench_time(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+/* Link functions */
+static err_t
+link_output(struct netif *netif, struct pbuf *p, const ip4_addr_t *ipaddr)
+{
+  struct pbuf *q;
+  LWIP_UNUSED_ARG(netif);
+  LWIP_UNUSED_ARG(ipaddr);
+
+  if ((u16_t)(link_head + 1) % BENCH_LINK_QUEUE == link_tail) {
+    return ERR_OK;
+  }
+  q = pbuf_clone(PBUF_RAW, PBUF_RAM, p);
+  if (q == NULL) {
+    return ERR_OK;
+  }
+  link_queue[link_head] = q;
+  link_head = (link_head + 1) % BENCH_LINK_QUEUE;
+  return ERR_OK;
+}
+
+static err_t
+link_init(struct netif *netif)
+{
+  netif->name[0] = 'b';
+  netif->name[1] = 'n';
+  netif->output = link_output;
+  netif->mtu = 1500;
+  netif->flags = NETIF_FLAG_LINK_UP;
+  return ERR_OK;
+}
+
+/* deliver queued packets, returns 0 if the queue was empty */
+static int
+link_poll(void)
+{
+  int cnt = 0;
+  while (link_tail != link_head) {
+    struct pbuf *p = link_queue[link_tail];
+    link_tail = (link_tail + 1) % BENCH_LINK_QUEUE;
+    if (bench_netif.input(p, &bench_netif) != ERR_OK) {
+      pbuf_free(p);
+    }
+    cnt++;
+  }
+  return cnt;
+}
+
+/* BER encoding and decoding, definite lengths up to 0xffff */
+static u16_t
+ber_put_tlv(u8_t *buf, u8_t type, const u8_t *value, u16_t len)
+{
+  u16_t hlen = 2;
+
+  buf[0] = type;
+  if (len < 0x80) {
+    buf[1] = (u8_t)len;
+  } else if (len < 0x100) {
+    buf[1] = 0x81;
+    buf[2] = (u8_t)len;
+    hlen = 3;
+  } else {
+    buf[1] = 0x82;
+    buf[2] = (u8_t)(len >> 8);
+    buf[3] = (u8_t)len;
+    hlen = 4;
+  }
+  memmove(&buf[hlen], value, len);
+  return (u16_t)(hlen + len);
+}
+
+static u16_t
+ber_put_int(u8_t *buf, u32_t value)
+{
+  u8_t v[5];
+  u16_t len = 0;
+  int shift;
+
+  for (shift = 24; shift > 0; shift -= 8) {
+    if ((len > 0) || ((value >> shift) != 0)) {
+      v[len++] = (u8_t)(value >> shift);
+    }
+  }
+  v[len++] = (u8_t)value;
+  if (v[0] & 0x80) {
+    memmove(&v[1], v, len);
+    v[0] = 0;
+    len++;
+  }
+  return ber_put_tlv(buf, BER_INTEGER, v, len);
+}
+
+static u16_t
+ber_put_oid(u8_t *buf, const struct bench_oid *oid)
+{
+  u8_t v[5 * SNMP_MAX_OBJ_ID_LEN];
+  u16_t len = 0;
+  u8_t i;
+
+  v[len++] = (u8_t)(oid->id[0] * 40 + oid->id[1]);
+  for (i = 2; i < oid->len; i++) {
+    u32_t subid = oid->id[i];
+    int shift;
+    for (shift = 28; shift > 0; shift -= 7) {
+      if ((subid >> shift) != 0) {
+        v[len++] = (u8_t)(0x80 | (subid >> shift));
+      }
+    }
+    v[len++] = (u8_t)(subid & 0x7f);
+  }
+  return ber_put_tlv(buf, BER_OID, v, (u16_t)LWIP_MIN(len, sizeof(v)));
+}
+
+/* reads a TLV header at *pos, returns 0 if it does not fit into len */
+static int
+ber_get_hdr(const u8_t *buf, u16_t len, u16_t *pos, u8_t *type, u16_t *vlen)
+{
+  u16_t p = *pos;
+
+  if (p + 2 > len) {
+    return 0;
+  }
+  *type = buf[p++];
+  if (buf[p] < 0x80) {
+    *vlen = buf[p++];
+  } else if ((buf[p] == 0x81) && (p + 2 <= len)) {
+    *vlen = buf[p + 1];
+    p += 2;
+  } else if ((buf[p] == 0x82) && (p + 3 <= len)) {
+    *vlen = (u16_t)((buf[p + 1] << 8) | buf[p + 2]);
+    p += 3;
+  } else {
+    return 0;
+  }
+  if (p + *vlen > len) {
+    return 0;
+  }
+  *pos = p;
+  return 1;
+}
+
+static int
+ber_get_int(const u8_t *buf, u16_t len, u16_t *pos, u32_t *value)
+{
+  u8_t type;
+  u16_t vlen, i;
+
+  if (!ber_get_hdr(buf, len, pos, &type, &vlen) || (type != BER_INTEGER)) {
+    return 0;
+  }
+  *value = 0;
+  for (i = 0; i < vlen; i++) {
+    *value = (*value << 8) | buf[*pos + i];
+  }
+  *pos = (u16_t)(*pos + vlen);
+  return 1;
+}
+
+static int
+ber_get_oid(const u8_t *buf, u16_t len, u16_t *pos, struct bench_oid *oid)
+{
+  u8_t type;
+  u16_t vlen, end;
+  u32_t subid = 0;
+
+  if (!ber_get_hdr(buf, len, pos, &type, &vlen) || (type != BER_OID) || (vlen == 0)) {
+    return 0;
+  }
+  end = (u16_t)(*pos + vlen);
+  oid->id[0] = buf[*pos] / 40;
+  oid->id[1] = buf[*pos] % 40;
+  oid->len = 2;
+  for ((*pos)++; *pos < end; (*pos)++) {
+    subid = (subid << 7) | (buf[*pos] & 0x7f);
+    if ((buf[*pos] & 0x80) == 0) {
+      if (oid->len >= SNMP_MAX_OBJ_ID_LEN) {
+        return 0;
+      }
+      oid->id[oid->len++] = subid;
+      subid = 0;
+    }
+  }
+  return 1;
+}
+
+static int
+oid_in_subtree(const struct bench_oid *oid, const struct bench_oid *prefix)
+{
+  return (oid->len > prefix->len) &&
+         (memcmp(oid->id, prefix->id, prefix->len * sizeof(u32_t)) == 0);
+}
+
+static void
+oid_hash(u32_t *hash, const struct bench_oid *oid)
+{
+  u8_t i;
+  for (i = 0; i < oid->len; i++) {
+    *hash = (*hash ^ oid->id[i]) * 16777619UL;
+  }
+}
+
+#if LWIP_SNMP_V3
+/* Agent: engine and user store of the SNMPv3 agent */
+void
+snmpv3_get_engine_id(const char **id, u8_t *len)
+{
+  *id = (const char *)bench_engine_id;
+  *len = (u8_t)sizeof(bench_engine_id);
+}
+
+err_t
+snmpv3_set_engine_id(const char *id, u8_t len)
+{
+  LWIP_UNUSED_ARG(id);
+  LWIP_UNUSED_ARG(len);
+  return ERR_VAL;
+}
+
+u32_t
+snmpv3_get_engine_boots(void)
+{
+  return 1;
+}
+
+void
+snmpv3_set_engine_boots(u32_t boots)
+{
+  LWIP_UNUSED_ARG(boots);
+}
+
+/* a walk is over long before the time window of 150 seconds */
+u32_t
+snmpv3_get_engine_time(void)
+{
+  return 0;
+}
+
+void
+snmpv3_reset_engine_time(void)
+{
+}
+
+err_t
+snmpv3_get_user(const char *username, snmpv3_auth_algo_t *auth_algo, u8_t *auth_key, snmpv3_priv_algo_t *priv_algo, u8_t *priv_key)
+{
+  if (strcmp(username, bench_user) != 0) {
+    return ERR_VAL;
+  }
+  if (auth_algo != NULL) {
+    *auth_algo = SNMP_V3_AUTH_ALGO_SHA;
+  }
+  if (auth_key != NULL) {
+    memcpy(auth_key, bench_auth_key, sizeof(bench_auth_key));
+  }
+  if (priv_algo != NULL) {
+    *priv_algo = SNMP_V3_PRIV_ALGO_AES;
+  }
+  if (priv_key != NULL) {
+    memcpy(priv_key, bench_priv_key, sizeof(bench_priv_key));
+  }
+  return ERR_OK;
+}
+
+u8_t
+snmpv3_get_amount_of_users(void)
+{
+  return 1;
+}
+
+err_t
+snmpv3_get_user_storagetype(const char *username, snmpv3_user_storagetype_t *storagetype)
+{
+  if (strcmp(username, bench_user) != 0) {
+    return ERR_VAL;
+  }
+  *storagetype = SNMP_V3_USER_STORAGETYPE_READONLY;
+  return ERR_OK;
+}
+
+err_t
+snmpv3_get_username(char *username, u8_t index)
+{
+  if (index != 0) {
+    return ERR_VAL;
+  }
+  strcpy(username, bench_user);
+  return ERR_OK;
+}
+
+/* Manager: USM of the manager, with mbedTLS */
+static int
+v3_parse(const u8_t *buf, u16_t len, struct bench_v3_msg *m)
+{
+  u16_t pos = 0;
+  u32_t value;
+  u8_t type;
+  u16_t vlen;
+
+  /* version, skip msgGlobalData */
+  if (!ber_get_hdr(buf, len, &pos, &type, &vlen) || (type != BER_SEQUENCE) ||
+      !ber_get_int(buf, len, &pos, &value) || (value != 3) ||
+      !ber_get_hdr(buf, len, &pos, &type, &vlen) || (type != BER_SEQUENCE)) {
+    return 0;
+  }
+  pos = (u16_t)(pos + vlen);
+  /* msgSecurityParameters, skip engine ID and user name */
+  if (!ber_get_hdr(buf, len, &pos, &type, &vlen) || (type != BER_OCTET_STRING) ||
+      !ber_get_hdr(buf, len, &pos, &type, &vlen) || (type != BER_SEQUENCE) ||
+      !ber_get_hdr(buf, len, &pos, &type, &vlen) || (type != BER_OCTET_STRING)) {
+    return 0;
+  }
+  pos = (u16_t)(pos + vlen);
+  if (!ber_get_int(buf, len, &pos, &m->boots) || !ber_get_int(buf, len, &pos, &m->time) ||
+      !ber_get_hdr(buf, len, &pos, &type, &vlen) || (type != BER_OCTET_STRING)) {
+    return 0;
+  }
+  pos = (u16_t)(pos + vlen);
+  if (!ber_get_hdr(buf, len, &pos, &type, &vlen) || (type != BER_OCTET_STRING) || (vlen != BENCH_AUTH_PARAM_LEN)) {
+    return 0;
+  }
+  m->auth_pos = pos;
+  pos = (u16_t)(pos + vlen);
+  if (!ber_get_hdr(buf, len, &pos, &type, &vlen) || (type != BER_OCTET_STRING) || (vlen != sizeof(m->salt))) {
+    return 0;
+  }
+  memcpy(m->salt, &buf[pos], sizeof(m->salt));
+  pos = (u16_t)(pos + vlen);
+  /* encryptedPDU */
+  if (!ber_get_hdr(buf, len, &pos, &type, &vlen) || (type != BER_OCTET_STRING)) {
+    return 0;
+  }
+  m->data_pos = pos;
+  m->data_len = vlen;
+  return 1;
+}
+
+/* HMAC-SHA-96 of buf with zero msgAuthenticationParameters */
+static int
+v3_auth(u8_t *buf, u16_t len, const struct bench_v3_msg *m, u8_t *digest)
+{
+  u8_t hmac[BENCH_SHA_LEN];
+
+  memset(&buf[m->auth_pos], 0, BENCH_AUTH_PARAM_LEN);
+  if (mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA1), bench_auth_key, sizeof(bench_auth_key),
+                      buf, len, hmac) != 0) {
+    return 0;
+  }
+  memcpy(digest, hmac, BENCH_AUTH_PARAM_LEN);
+  return 1;
+}
+
+/* AES-128-CFB en- or decryption of the ScopedPDU in place, RFC 3826 */
+static int
+v3_crypt(u8_t *buf, const struct bench_v3_msg *m, int mode)
+{
+  mbedtls_aes_context aes;
+  u8_t iv[16];
+  size_t iv_off = 0;
+  int ret;
+
+  iv[0] = (u8_t)(m->boots >> 24);
+  iv[1] = (u8_t)(m->boots >> 16);
+  iv[2] = (u8_t)(m->boots >> 8);
+  iv[3] = (u8_t)m->boots;
+  iv[4] = (u8_t)(m->time >> 24);
+  iv[5] = (u8_t)(m->time >> 16);
+  iv[6] = (u8_t)(m->time >> 8);
+  iv[7] = (u8_t)m->time;
+  memcpy(&iv[8], m->salt, sizeof(m->salt));
+
+  mbedtls_aes_init(&aes);
+  ret = (mbedtls_aes_setkey_enc(&aes, bench_priv_key, 128) == 0) &&
+        (mbedtls_aes_crypt_cfb128(&aes, mode, m->data_len, &iv_off, iv, &buf[m->data_pos], &buf[m->data_pos]) == 0);
+  mbedtls_aes_free(&aes);
+  return ret;
+}
+
+/* builds an authPriv message around the PDU into out, returns its length or 0 */
+static u16_t
+v3_wrap(u8_t *out, u8_t *msg, u8_t pdu_type, const u8_t *pdu, u16_t pdu_len)
+{
+  static u8_t scoped[BENCH_MSG_SIZE], scoped_seq[BENCH_MSG_SIZE];
+  static const u8_t no_auth[BENCH_AUTH_PARAM_LEN] = { 0 };
+  u8_t global[32], usm[80], usm_seq[84], salt[8];
+  u16_t scoped_len = 0, global_len = 0, usm_len = 0, msg_len = 0, out_len;
+  struct bench_v3_msg m;
+  u8_t flags = SNMP_V3_AUTHPRIV_REPORTABLE;
+
+  scoped_len = (u16_t)(scoped_len + ber_put_tlv(&scoped[scoped_len], BER_OCTET_STRING, bench_engine_id, sizeof(bench_engine_id)));
+  scoped_len = (u16_t)(scoped_len + ber_put_tlv(&scoped[scoped_len], BER_OCTET_STRING, (const u8_t *)"", 0));
+  scoped_len = (u16_t)(scoped_len + ber_put_tlv(&scoped[scoped_len], pdu_type, pdu, pdu_len));
+  scoped_len = ber_put_tlv(scoped_seq, BER_SEQUENCE, scoped, scoped_len);
+
+  global_len = (u16_t)(global_len + ber_put_int(&global[global_len], request_id));
+  global_len = (u16_t)(global_len + ber_put_int(&global[global_len], BENCH_MSG_SIZE));
+  global_len = (u16_t)(global_len + ber_put_tlv(&global[global_len], BER_OCTET_STRING, &flags, 1));
+  global_len = (u16_t)(global_len + ber_put_int(&global[global_len], SNMP_V3_USM));
+
+  /* the salt must not repeat for a key */
+  bench_salt++;
+  memset(salt, 0, sizeof(salt));
+  salt[4] = (u8_t)(bench_salt >> 24);
+  salt[5] = (u8_t)(bench_salt >> 16);
+  salt[6] = (u8_t)(bench_salt >> 8);
+  salt[7] = (u8_t)bench_salt;
+  usm_len = (u16_t)(usm_len + ber_put_tlv(&usm[usm_len], BER_OCTET_STRING, bench_engine_id, sizeof(bench_engine_id)));
+  usm_len = (u16_t)(usm_len + ber_put_int(&usm[usm_len], snmpv3_get_engine_boots()));
+  usm_len = (u16_t)(usm_len + ber_put_int(&usm[usm_len], snmpv3_get_engine_time()));
+  usm_len = (u16_t)(usm_len + ber_put_tlv(&usm[usm_len], BER_OCTET_STRING, (const u8_t *)bench_user, sizeof(bench_user) - 1));
+  usm_len = (u16_t)(usm_len + ber_put_tlv(&usm[usm_len], BER_OCTET_STRING, no_auth, sizeof(no_auth)));
+  usm_len = (u16_t)(usm_len + ber_put_tlv(&usm[usm_len], BER_OCTET_STRING, salt, sizeof(salt)));
+  usm_len = ber_put_tlv(usm_seq, BER_SEQUENCE, usm, usm_len);
+
+  msg_len = (u16_t)(msg_len + ber_put_int(&msg[msg_len], 3));
+  msg_len = (u16_t)(msg_len + ber_put_tlv(&msg[msg_len], BER_SEQUENCE, global, global_len));
+  msg_len = (u16_t)(msg_len + ber_put_tlv(&msg[msg_len], BER_OCTET_STRING, usm_seq, usm_len));
+  msg_len = (u16_t)(msg_len + ber_put_tlv(&msg[msg_len], BER_OCTET_STRING, scoped_seq, scoped_len));
+  out_len = ber_put_tlv(out, BER_SEQUENCE, msg, msg_len);
+
+  /* encrypt the ScopedPDU, then authenticate the whole message */
+  if (!v3_parse(out, out_len, &m) || !v3_crypt(out, &m, MBEDTLS_AES_ENCRYPT) ||
+      !v3_auth(out, out_len, &m, &out[m.auth_pos])) {
+    return 0;
+  }
+  return out_len;
+}
+
+/* authenticates and decrypts the response, returns the position of its PDU or 0 */
+static u16_t
+v3_unwrap(void)
+{
+  struct bench_v3_msg m;
+  u8_t digest[BENCH_AUTH_PARAM_LEN], hmac[BENCH_AUTH_PARAM_LEN];
+  u16_t pos;
+  u8_t type;
+  u16_t vlen;
+
+  if (!v3_parse(response, response_len, &m)) {
+    return 0;
+  }
+  memcpy(digest, &response[m.auth_pos], sizeof(digest));
+  if (!v3_auth(response, response_len, &m, hmac) || (memcmp(digest, hmac, sizeof(hmac)) != 0) ||
+      !v3_crypt(response, &m, MBEDTLS_AES_DECRYPT)) {
+    return 0;
+  }
+  /* ScopedPDU: skip contextEngineID and contextName */
+  pos = m.data_pos;
+  if (!ber_get_hdr(response, response_len, &pos, &type, &vlen) || (type != BER_SEQUENCE) ||
+      !ber_get_hdr(response, response_len, &pos, &type, &vlen) || (type != BER_OCTET_STRING)) {
+    return 0;
+  }
+  pos = (u16_t)(pos + vlen);
+  if (!ber_get_hdr(response, response_len, &pos, &type, &vlen) || (type != BER_OCTET_STRING)) {
+    return 0;
+  }
+  return (u16_t)(pos + vlen);
+}
+#endif /* LWIP_SNMP_V3 */
+
+/* Manager functions */
+static void
+manager_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port)
+{
+  LWIP_UNUSED_ARG(arg);
+  LWIP_UNUSED_ARG(pcb);
+  LWIP_UNUSED_ARG(addr);
+  LWIP_UNUSED_ARG(port);
+
+  response_len = pbuf_copy_partial(p, response, sizeof(response), 0);
+  pbuf_free(p);
+}
+
+/* sends a GetNext (max_repetitions == 0) or GetBulk request for oids and waits for the response */
+static int
+manager_request(const struct bench_oid *oids, int num_oids, u32_t max_repetitions)
+{
+  static u8_t vbs[BENCH_MSG_SIZE], pdu[BENCH_MSG_SIZE], msg[BENCH_MSG_SIZE], out[BENCH_MSG_SIZE];
+  static const u8_t null_value[] = { BER_NULL, 0 };
+  struct pbuf *p;
+  u16_t vbs_len = 0, pdu_len = 0, msg_len = 0, out_len;
+  int i;
+
+  for (i = 0; i < num_oids; i++) {
+    u8_t vb[8 + 5 * SNMP_MAX_OBJ_ID_LEN];
+    u16_t vb_len = ber_put_oid(vb, &oids[i]);
+    memcpy(&vb[vb_len], null_value, sizeof(null_value));
+    vb_len = (u16_t)(vb_len + sizeof(null_value));
+    vbs_len = (u16_t)(vbs_len + ber_put_tlv(&vbs[vbs_len], BER_SEQUENCE, vb, vb_len));
+  }
+
+  request_id++;
+  pdu_len = (u16_t)(pdu_len + ber_put_int(&pdu[pdu_len], request_id));
+  /* error-status and error-index, non-repeaters and max-repetitions for GetBulk */
+  pdu_len = (u16_t)(pdu_len + ber_put_int(&pdu[pdu_len], 0));
+  pdu_len = (u16_t)(pdu_len + ber_put_int(&pdu[pdu_len], max_repetitions));
+  pdu_len = (u16_t)(pdu_len + ber_put_tlv(&pdu[pdu_len], BER_SEQUENCE, vbs, vbs_len));
+
+#if LWIP_SNMP_V3
+  if (bench_v3) {
+    out_len = v3_wrap(out, msg, max_repetitions ? SNMP_GETBULK_PDU : SNMP_GETNEXT_PDU, pdu, pdu_len);
+    if (out_len == 0) {
+      return 0;
+    }
+  } else
+#endif /* LWIP_SNMP_V3 */
+  {
+    msg_len = (u16_t)(msg_len + ber_put_int(&msg[msg_len], 1)); /* SNMPv2c */
+    msg_len = (u16_t)(msg_len + ber_put_tlv(&msg[msg_len], BER_OCTET_STRING, (const u8_t *)"public", 6));
+    msg_len = (u16_t)(msg_len + ber_put_tlv(&msg[msg_len], max_repetitions ? SNMP_GETBULK_PDU : SNMP_GETNEXT_PDU, pdu, pdu_len));
+    out_len = ber_put_tlv(out, BER_SEQUENCE, msg, msg_len);
+  }
+
+  p = pbuf_alloc(PBUF_TRANSPORT, out_len, PBUF_RAM);
+  if (p == NULL) {
+    return 0;
+  }
+  pbuf_take(p, out, out_len);
+  response_len = 0;
+  udp_sendto(manager_pcb, p, netif_ip_addr4(&bench_netif), LWIP_IANA_PORT_SNMP);
+  pbuf_free(p);
+  while (link_poll() != 0) {
+  }
+  return response_len != 0;
+}
+
+/* position of the first varbind of the response, 0 on error */
+static u16_t
+response_varbinds(u16_t *end)
+{
+  u16_t pos = 0;
+  u32_t value;
+  u8_t type;
+  u16_t vlen;
+
+#if LWIP_SNMP_V3
+  if (bench_v3) {
+    if ((pos = v3_unwrap()) == 0) {
+      return 0;
+    }
+  } else
+#endif /* LWIP_SNMP_V3 */
+  {
+    /* version and community */
+    if (!ber_get_hdr(response, response_len, &pos, &type, &vlen) || (type != BER_SEQUENCE) ||
+        !ber_get_int(response, response_len, &pos, &value) ||
+        !ber_get_hdr(response, response_len, &pos, &type, &vlen) || (type != BER_OCTET_STRING)) {
+      return 0;
+    }
+    pos = (u16_t)(pos + vlen);
+  }
+  if (!ber_get_hdr(response, response_len, &pos, &type, &vlen) || (type != SNMP_RESPONSE_PDU) ||
+      !ber_get_int(response, response_len, &pos, &value) || (value != request_id) ||
+      !ber_get_int(response, response_len, &pos, &value) || (value != 0) ||
+      !ber_get_int(response, response_len, &pos, &value) ||
+      !ber_get_hdr(response, response_len, &pos, &type, &vlen) || (type != BER_SEQUENCE)) {
+    return 0;
+  }
+  *end = (u16_t)(pos + vlen);
+  return pos;
+}
+
+/* reads the next varbind OID, *end_of_mib is set for an endOfMibView value */
+static int
+response_next_varbind(u16_t *pos, u16_t end, struct bench_oid *oid, int *end_of_mib)
+{
+  u8_t type;
+  u16_t vlen;
+
+  if (!ber_get_hdr(response, end, pos, &type, &vlen) || (type != BER_SEQUENCE) ||
+      !ber_get_oid(response, end, pos, oid) ||
+      !ber_get_hdr(response, end, pos, &type, &vlen)) {
+    return 0;
+  }
+  *end_of_mib = (type == SNMP_END_OF_MIB);
+  *pos = (u16_t)(*pos + vlen);
+  return 1;
+}
+
+/**
+ * Walks the subtrees of columns with one repeater each (GetNext with
+ * max_repetitions == 0) until every repeater has left its subtree.
+ */
+static void
+bench_walk(const struct bench_oid *columns, int num_columns, u32_t max_repetitions, struct bench_walk *walk)
+{
+  struct bench_oid oids[BENCH_MAX_COLUMNS];
+  int active[BENCH_MAX_COLUMNS];
+  int num_active = num_columns;
+  int i;
+
+  memset(walk, 0, sizeof(*walk));
+  walk->hash = 2166136261UL;
+  for (i = 0; i < num_columns; i++) {
+    oids[i] = columns[i];
+    active[i] = i;
+  }
+
+  while (num_active > 0) {
+    struct bench_oid req[BENCH_MAX_COLUMNS];
+    int done[BENCH_MAX_COLUMNS];
+    u16_t pos, end;
+    int n = 0;
+
+    for (i = 0; i < num_active; i++) {
+      req[i] = oids[active[i]];
+      done[i] = 0;
+    }
+    if (!manager_request(req, num_active, max_repetitions) ||
+        ((pos = response_varbinds(&end)) == 0)) {
+      walk->error = 1;
+      return;
+    }
+    walk->requests++;
+
+    /* varbinds are ordered by repetition, then by repeater */
+    while (pos < end) {
+      struct bench_oid oid;
+      int end_of_mib;
+      int r = n++ % num_active;
+
+      if (!response_next_varbind(&pos, end, &oid, &end_of_mib)) {
+        walk->error = 1;
+        return;
+      }
+      if (done[r]) {
+        continue;
+      }
+      if (end_of_mib || !oid_in_subtree(&oid, &columns[active[r]])) {
+        done[r] = 1;
+        continue;
+      }
+      oid_hash(&walk->hash, &oid);
+      walk->varbinds++;
+      oids[active[r]] = oid;
+    }
+
+    /* repeaters that left their subtree are not asked again */
+    n = 0;
+    for (i = 0; i < num_active; i++) {
+      if (!done[i]) {
+        active[n++] = active[i];
+      }
+    }
+    num_active = n;
+  }
+}
+
+static int
+bench_run(const char *name, const struct bench_oid *columns, int num_columns, u32_t max_repetitions,
+          int walks, const struct bench_walk *expected, struct bench_walk *result)
+{
+  double t = 0;
+  int i;
+
+  /* the fastest walk is least disturbed by the rest of the system */
+  for (i = 0; i < walks; i++) {
+    double start = bench_time();
+    bench_walk(columns, num_columns, max_repetitions, result);
+    if (result->error) {
+      break;
+    }
+    if ((i == 0) || (bench_time() - start < t)) {
+      t = bench_time() - start;
+    }
+  }
+
+  if (result->error || (result->varbinds == 0) ||
+      ((expected != NULL) && ((result->varbinds != expected->varbinds) || (result->hash != expected->hash)))) {
+    printf("%-30s FAILED (%"U32_F" varbinds)\n", name, result->varbinds);
+    return 1;
+  }
+  printf("%-30s %6"U32_F" requests %6"U32_F" varbinds %8.3f ms/walk %10.0f varbinds/s\n",
+         name, result->requests, result->varbinds, t * 1000.0, result->varbinds / t);
+  return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+  static const u32_t max_repetitions[] = { 10, 25, 50 };
+  struct bench_oid mib2_oid = { { 1, 3, 6, 1, 2, 1 }, 6 };
+  struct bench_oid tcp_conn_columns[5];
+  struct bench_walk getnext, getbulk, table_getnext;
+  ip4_addr_t ipaddr, netmask, gw;
+  int pcbs = 32;
+  int walks = 20;
+  char name[32];
+  size_t j;
+  int i, ret = 0;
+
+  if (argc > 1) {
+    pcbs = atoi(argv[1]);
+  }
+  if (argc > 2) {
+    walks = LWIP_MAX(atoi(argv[2]), 1);
+  }
+
+  lwip_init();
+
+  IP4_ADDR(&ipaddr, 10, 0, 0, 1);
+  IP4_ADDR(&netmask, 255, 255, 255, 0);
+  ip4_addr_set_zero(&gw);
+  netif_add(&bench_netif, &ipaddr, &netmask, &gw, NULL, link_init, netif_input);
+  netif_set_default(&bench_netif);
+  netif_set_up(&bench_netif);
+
+#if LWIP_SNMP_V3
+  snmpv3_password_to_key_sha((const u8_t *)"authpassword", 12, bench_engine_id, sizeof(bench_engine_id), bench_auth_key);
+  snmpv3_password_to_key_sha((const u8_t *)"privpassword", 12, bench_engine_id, sizeof(bench_engine_id), bench_priv_key);
+#endif /* LWIP_SNMP_V3 */
+  snmp_init();
+
+  manager_pcb = udp_new();
+  LWIP_ASSERT("udp_new failed", manager_pcb != NULL);
+  udp_bind(manager_pcb, IP_ADDR_ANY, BENCH_MANAGER_PORT);
+  udp_recv(manager_pcb, manager_recv, NULL);
+
+  /* table rows: listening TCP pcbs (tcpConnTable) and bound UDP pcbs (udpTable) */
+  for (i = 0; i < pcbs; i++) {
+    struct tcp_pcb *tpcb = tcp_new();
+    struct udp_pcb *upcb = udp_new();
+    if ((tpcb == NULL) || (upcb == NULL) ||
+        (tcp_bind(tpcb, IP_ADDR_ANY, (u16_t)(2000 + i)) != ERR_OK) ||
+        ((tpcb = tcp_listen(tpcb)) == NULL) ||
+        (udp_bind(upcb, IP_ADDR_ANY, (u16_t)(2000 + i)) != ERR_OK)) {
+      printf("pcb %d: out of memory\n", i);
+      return EXIT_FAILURE;
+    }
+  }
+
+  printf("MIB-II walk, %d TCP and UDP pcbs, %d walks per run\n", pcbs, walks);
+  ret |= bench_run("GetNext", &mib2_oid, 1, 0, walks, NULL, &getnext);
+  for (j = 0; j < LWIP_ARRAYSIZE(max_repetitions); j++) {
+    snprintf(name, sizeof(name), "GetBulk max-repetitions %"U32_F, max_repetitions[j]);
+    ret |= bench_run(name, &mib2_oid, 1, max_repetitions[j], walks, &getnext, &getbulk);
+  }
+
+  /* tcpConnTable columns tcpConnState .. tcpConnRemPort */
+  for (i = 0; i < 5; i++) {
+    struct bench_oid column = { { 1, 3, 6, 1, 2, 1, 6, 13, 1, 0 }, 10 };
+    column.id[9] = (u32_t)(i + 1);
+    tcp_conn_columns[i] = column;
+  }
+  ret |= bench_run("tcpConnTable GetNext", tcp_conn_columns, 5, 0, walks, NULL, &table_getnext);
+  for (j = 0; j < LWIP_ARRAYSIZE(max_repetitions); j++) {
+    snprintf(name, sizeof(name), "tcpConnTable GetBulk %"U32_F, max_repetitions[j]);
+    ret |= bench_run(name, tcp_conn_columns, 5, max_repetitions[j], walks, &table_getnext, &getbulk);
+  }
+
+#if LWIP_SNMP_V3
+  /* every request and response is authenticated and encrypted */
+  bench_v3 = 1;
+  ret |= bench_run("v3 authPriv GetNext", &mib2_oid, 1, 0, walks, &getnext, &getbulk);
+  for (j = 0; j < LWIP_ARRAYSIZE(max_repetitions); j++) {
+    snprintf(name, sizeof(name), "v3 authPriv GetBulk %"U32_F, max_repetitions[j]);
+    ret |= bench_run(name, &mib2_oid, 1, max_repetitions[j], walks, &getnext, &getbulk);
+  }
+  bench_v3 = 0;
+#endif /* LWIP_SNMP_V3 */
+
+  return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,570 @@
+/*
+ * Copyright (c) 2001-2003 Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the lwIP TCP/IP stack.
+ *
+ */
+
+/**
+ * @file
+ * TFTP throughput benchmark
+ *
+ * The lwIP TFTP client (tftp_get()/tftp_put()) talks to a minimal TFTP
+ * stand-in server (a raw udp_pcb in this file) over an in-memory link, so
+ * a run measures the TFTP, UDP and IPv4 code paths only. Every transfer is
+ * checked byte by byte.
+ * The stand-in server accepts blksize, windowsize and tsize (RFC 2347-2349,
+ * RFC 7440) up to the values of the current run and retransmits after
+ * BENCH_SERVER_TIMEOUT milliseconds of silence, so the link can drop
+ * DATA packets to measure loss recovery.
+ *
+ * Usage: tftp_bench [file size in KiB] [drop every n-th DATA packet]
+ */
+
+#include "lwip/init.h"
+#include "lwip/netif.h"
+#include "lwip/udp.h"
+#include "lwip/sys.h"
+#include "lwip/timeouts.h"
+#include "lwip/apps/tftp_client.h"
+#include "lwip/prot/ip4.h"
+#include "lwip/prot/udp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#define TFTP_RRQ   1
+#define TFTP_WRQ   2
+#define TFTP_DATA  3
+#define TFTP_ACK   4
+#define TFTP_ERROR 5
+#define TFTP_OACK  6
+
+#define BENCH_SERVER_PORT    6969
+#define BENCH_SERVER_TIMEOUT 20
+#define BENCH_LINK_QUEUE     256
+
+/* in-memory file of the client, contents are generated from the offset */
+struct bench_file {
+  u32_t size;
+  u32_t pos;
+  int closed;
+  int error;
+};
+
+/* TFTP stand-in server, handles one transfer at a time */
+struct bench_server {
+  struct udp_pcb *pcb;
+  ip_addr_t peer;
+  u16_t peer_port;
+  u8_t active;
+  u8_t sending;
+  u8_t gap;
+  u16_t max_blksize;
+  u16_t max_windowsize;
+  u16_t blksize;
+  u16_t windowsize;
+  u32_t size;
+  /* sending: first unacknowledged block, receiving: next expected block */
+  u32_t blknum;
+  u32_t last_blknum;
+  u32_t window_rcvd;
+  u32_t last_rx;
+  u32_t timeouts;
+  u32_t errors;
+};
+
+static struct netif bench_netif;
+static struct bench_server server;
+static struct bench_file file;
+
+/* in-memory link: packets sent on bench_netif are received on it again */
+static struct pbuf *link_queue[BENCH_LINK_QUEUE];
+static unsigned link_head, link_tail;
+static u32_t link_drop_every;
+static u32_t link_data_cnt;
+static u32_t link_dropped;
+
+static u8_t
+bench_file_byte(u32_t offset)
+{
+  return (u8_t)(offset + (offset >> 8) + (offset >> 16));
+}
+
+static void
+bench_fill(u8_t *buf, u32_t offset, u16_t len)
+{
+  u16_t i;
+  for (i = 0; i < len; i++) {
+    buf[i] = bench_file_byte(offset + i);
+  }
+}
+
+/* returns the number of bytes not matching the file contents */
+static u32_t
+bench_verify(const struct pbuf *p, u16_t offset, u32_t file_offset)
+{
+  const struct pbuf *q;
+  u32_t errors = 0;
+
+  for (q = p; q != NULL; q = q->next) {
+    const u8_t *data = (const u8_t *)q->payload;
+    u16_t i;
+    if (offset >= q->len) {
+      offset = (u16_t)(offset - q->len);
+      continue;
+    }
+    for (i = offset; i < q->len; i++) {
+      if (data[i] != bench_file_byte(file_offset++)) {
+        errors++;
+      }
+    }
+    offset = 0;
+  }
+  return errors;
+}
+
+static double
+bench_time(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+/* Link functions */
+static err_t
+link_output(struct netif *netif, struct pbuf *p, const ip4_addr_t *ipaddr)
+{
+  struct pbuf *q;
+  u16_t hlen;
+  LWIP_UNUSED_ARG(netif);
+  LWIP_UNUSED_ARG(ipaddr);
+
+  hlen = (u16_t)((pbuf_get_at(p, 0) & 0x0f) * 4);
+  if ((pbuf_get_at(p, 9) == IP_PROTO_UDP) &&
+      (pbuf_get_at(p, (u16_t)(hlen + UDP_HLEN + 1)) == TFTP_DATA)) {
+    link_data_cnt++;
+    if ((link_drop_every != 0) && ((link_data_cnt % link_drop_every) == 0)) {
+      link_dropped++;
+      return ERR_OK;
+    }
+  }
+  if ((u16_t)(link_head + 1) % BENCH_LINK_QUEUE == link_tail) {
+    link_dropped++;
+    return ERR_OK;
+  }
+  q = pbuf_clone(PBUF_RAW, PBUF_RAM, p);
+  if (q == NULL) {
+    link_dropped++;
+    return ERR_OK;
+  }
+  link_queue[link_head] = q;
+  link_head = (link_head + 1) % BENCH_LINK_QUEUE;
+  return ERR_OK;
+}
+
+static err_t
+link_init(struct netif *netif)
+{
+  netif->name[0] = 'b';
+  netif->name[1] = 'n';
+  netif->output = link_output;
+  netif->mtu = 1500;
+  netif->flags = NETIF_FLAG_LINK_UP;
+  return ERR_OK;
+}
+
+/* deliver queued packets, returns 0 if the queue was empty */
+static int
+link_poll(void)
+{
+  int cnt = 0;
+  while (link_tail != link_head) {
+    struct pbuf *p = link_queue[link_tail];
+    link_tail = (link_tail + 1) % BENCH_LINK_QUEUE;
+    if (bench_netif.input(p, &bench_netif) != ERR_OK) {
+      pbuf_free(p);
+    }
+    cnt++;
+  }
+  return cnt;
+}
+
+/* TFTP client callbacks */
+static void
+client_close(void *handle)
+{
+  struct bench_file *f = (struct bench_file *)handle;
+  f->closed = 1;
+}
+
+static int
+client_read(void *handle, void *buf, int bytes)
+{
+  struct bench_file *f = (struct bench_file *)handle;
+  u16_t len = (u16_t)LWIP_MIN((u32_t)bytes, f->size - f->pos);
+  bench_fill((u8_t *)buf, f->pos, len);
+  f->pos += len;
+  return len;
+}
+
+static int
+client_write(void *handle, struct pbuf *p)
+{
+  struct bench_file *f = (struct bench_file *)handle;
+  if (bench_verify(p, 0, f->pos) != 0) {
+    f->error = 1;
+  }
+  f->pos += p->tot_len;
+  return 0;
+}
+
+static void
+client_error(void *handle, int err, const char *msg, int size)
+{
+  struct bench_file *f = (struct bench_file *)handle;
+  LWIP_UNUSED_ARG(msg);
+  LWIP_UNUSED_ARG(size);
+  printf("tftp error %d\n", err);
+  f->error = 1;
+}
+
+static int
+client_size(void *handle)
+{
+  struct bench_file *f = (struct bench_file *)handle;
+  return (int)f->size;
+}
+
+static const struct tftp_context client_ctx = {
+  NULL,
+  client_close,
+  client_read,
+  client_write,
+  client_error,
+  client_size
+};
+
+/* Stand-in server */
+static void
+server_send(struct pbuf *p)
+{
+  udp_sendto(server.pcb, p, &server.peer, server.peer_port);
+  pbuf_free(p);
+}
+
+static struct pbuf *
+server_packet(u16_t opcode, u16_t blknum, u16_t len)
+{
+  struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, (u16_t)(4 + len), PBUF_RAM);
+  if (p != NULL) {
+    u8_t *data = (u8_t *)p->payload;
+    data[0] = (u8_t)(opcode >> 8);
+    data[1] = (u8_t)opcode;
+    data[2] = (u8_t)(blknum >> 8);
+    data[3] = (u8_t)blknum;
+  }
+  return p;
+}
+
+static void
+server_ack(u32_t blknum)
+{
+  struct pbuf *p = server_packet(TFTP_ACK, (u16_t)blknum, 0);
+  if (p != NULL) {
+    server_send(p);
+  }
+}
+
+/* send the window starting at the first unacknowledged block */
+static void
+server_send_window(void)
+{
+  u32_t blk;
+  for (blk = server.blknum;
+       (blk < server.blknum + server.windowsize) && (blk <= server.last_blknum); blk++) {
+    u32_t offset = (blk - 1) * server.blksize;
+    u16_t len = (u16_t)LWIP_MIN(server.blksize, server.size - offset);
+    struct pbuf *p = server_packet(TFTP_DATA, (u16_t)blk, len);
+    if (p == NULL) {
+      break;
+    }
+    bench_fill((u8_t *)p->payload + 4, offset, len);
+    server_send(p);
+  }
+}
+
+/* parse the request options, answer with OACK or start the transfer */
+static void
+server_request(struct pbuf *p, u8_t sending)
+{
+  char opts[64];
+  char oack[128];
+  u16_t oack_len = 0;
+  u16_t len = (u16_t)LWIP_MIN((size_t)p->tot_len - 2, sizeof(opts) - 1);
+  u16_t i;
+  int field = 0;
+  const char *name = NULL;
+
+  pbuf_copy_partial(p, opts, len, 2);
+  opts[len] = 0;
+
+  server.active = 1;
+  server.sending = sending;
+  server.gap = 0;
+  server.blksize = 512;
+  server.windowsize = 1;
+  server.blknum = 1;
+  server.window_rcvd = 0;
+
+  /* filename, mode, then name/value pairs */
+  for (i = 0; i < len; i += (u16_t)(strlen(&opts[i]) + 1), field++) {
+    const char *s = &opts[i];
+    u32_t value;
+    if (field < 2) {
+      continue;
+    }
+    if ((field & 1) == 0) {
+      name = s;
+      continue;
+    }
+    value = (u32_t)strtoul(s, NULL, 10);
+    if (!strcmp(name, "blksize")) {
+      server.blksize = (u16_t)LWIP_MIN(value, server.max_blksize);
+      value = server.blksize;
+    } else if (!strcmp(name, "windowsize")) {
+      server.windowsize = (u16_t)LWIP_MIN(value, server.max_windowsize);
+      value = server.windowsize;
+    } else if (!strcmp(name, "tsize")) {
+      server.size = value;
+    } else {
+      continue;
+    }
+    oack_len = (u16_t)(oack_len + snprintf(&oack[oack_len], sizeof(oack) - oack_len, "%s%c%u%c",
+                                           name, 0, (unsigned)value, 0));
+  }
+  server.last_blknum = server.size / server.blksize + 1;
+
+  if (oack_len > 0) {
+    struct pbuf *q = pbuf_alloc(PBUF_TRANSPORT, (u16_t)(2 + oack_len), PBUF_RAM);
+    if (q != NULL) {
+      ((u8_t *)q->payload)[0] = 0;
+      ((u8_t *)q->payload)[1] = TFTP_OACK;
+      MEMCPY((u8_t *)q->payload + 2, oack, oack_len);
+      server_send(q);
+    }
+    /* OACK of a write request is acknowledged with DATA 1, of a read request with ACK 0 */
+  } else if (sending) {
+    server_send_window();
+  } else {
+    server_ack(0);
+  }
+}
+
+static void
+server_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port)
+{
+  u16_t opcode = (u16_t)((pbuf_get_at(p, 0) << 8) | pbuf_get_at(p, 1));
+  u16_t blknum = (u16_t)((pbuf_get_at(p, 2) << 8) | pbuf_get_at(p, 3));
+  LWIP_UNUSED_ARG(arg);
+  LWIP_UNUSED_ARG(pcb);
+
+  ip_addr_copy(server.peer, *addr);
+  server.peer_port = port;
+  server.last_rx = sys_now();
+
+  switch (opcode) {
+    case TFTP_RRQ:
+    case TFTP_WRQ:
+      server_request(p, opcode == TFTP_RRQ);
+      break;
+    case TFTP_ACK:
+      if (server.active && server.sending) {
+        /* blocks acknowledged by this ACK (casting to u16_t to care for overflow) */
+        u16_t acked = (u16_t)(blknum - (u16_t)(server.blknum - 1));
+        if (acked <= server.windowsize) {
+          server.blknum += acked;
+        }
+        if (server.blknum > server.last_blknum) {
+          server.active = 0;
+        } else {
+          server_send_window();
+        }
+      }
+      break;
+    case TFTP_DATA:
+      if (server.active && !server.sending) {
+        if (blknum == (u16_t)server.blknum) {
+          u16_t len = (u16_t)(p->tot_len - 4);
+          server.errors += bench_verify(p, 4, (server.blknum - 1) * server.blksize);
+          server.gap = 0;
+          server.window_rcvd++;
+          if ((len < server.blksize) || (server.window_rcvd >= server.windowsize)) {
+            server_ack(server.blknum);
+            server.window_rcvd = 0;
+          }
+          if (len < server.blksize) {
+            server.active = 0;
+          }
+          server.blknum++;
+        } else if (!server.gap) {
+          /* out of order, acknowledge the last block received in order once */
+          server_ack(server.blknum - 1);
+          server.window_rcvd = 0;
+          server.gap = 1;
+        }
+      }
+      break;
+    case TFTP_ERROR:
+      /* the client answers blocks retransmitted after its last ACK with an error */
+      if (server.active) {
+        server.active = 0;
+        server.errors++;
+      }
+      break;
+    default:
+      break;
+  }
+  pbuf_free(p);
+}
+
+/* retransmit after BENCH_SERVER_TIMEOUT ms without packets from the client */
+static void
+server_poll(void)
+{
+  if (server.active && ((u32_t)(sys_now() - server.last_rx) >= BENCH_SERVER_TIMEOUT)) {
+    server.last_rx = sys_now();
+    server.timeouts++;
+    server.gap = 0;
+    if (server.sending) {
+      server_send_window();
+    } else {
+      server_ack(server.blknum - 1);
+      server.window_rcvd = 0;
+    }
+  }
+}
+
+/* Run one transfer, returns 0 on success */
+static int
+bench_run(u8_t get, u16_t blksize, u16_t windowsize, u32_t size)
+{
+  ip_addr_t server_addr;
+  double start, secs;
+  err_t err;
+
+  memset(&file, 0, sizeof(file));
+  file.size = get ? 0 : size;
+  server.size = get ? size : 0;
+  server.max_blksize = blksize;
+  server.max_windowsize = windowsize;
+  server.timeouts = 0;
+  server.errors = 0;
+  link_data_cnt = 0;
+  link_dropped = 0;
+
+  ip_addr_copy_from_ip4(server_addr, *netif_ip4_addr(&bench_netif));
+  start = bench_time();
+  if (get) {
+    err = tftp_get(&file, &server_addr, BENCH_SERVER_PORT, "bench", TFTP_MODE_OCTET);
+  } else {
+    err = tftp_put(&file, &server_addr, BENCH_SERVER_PORT, "bench", TFTP_MODE_OCTET);
+  }
+  if (err != ERR_OK) {
+    printf("tftp request failed: %d\n", err);
+    return -1;
+  }
+  while (!file.closed || server.active) {
+    if (!link_poll()) {
+      server_poll();
+      sys_check_timeouts();
+    }
+  }
+  secs = bench_time() - start;
+
+  if (file.error || server.errors || (get && (file.pos != size))) {
+    printf("%s blksize %5u window %2u: transfer FAILED\n", get ? "get" : "put",
+           (unsigned)server.blksize, (unsigned)server.windowsize);
+    return -1;
+  }
+  printf("%s blksize %5u window %2u: %7u KiB in %7.3f s, %8.2f MiB/s, %5u DATA sent, %4u dropped, %4u timeouts\n",
+         get ? "get" : "put", (unsigned)server.blksize, (unsigned)server.windowsize,
+         (unsigned)(size / 1024), secs, (double)size / secs / (1024.0 * 1024.0),
+         (unsigned)link_data_cnt, (unsigned)link_dropped, (unsigned)server.timeouts);
+  return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+  static const u16_t runs[][2] = {
+    /* blksize, windowsize */
+    {  512,  1 },
+    { 1468,  1 },
+    { 1468,  4 },
+    { 1468, 16 },
+    { 1468, 64 }
+  };
+  ip4_addr_t ipaddr, netmask, gw;
+  u32_t size = 8 * 1024 * 1024;
+  size_t i;
+  int ret = 0;
+
+  if (argc > 1) {
+    size = (u32_t)strtoul(argv[1], NULL, 10) * 1024;
+  }
+  if (argc > 2) {
+    link_drop_every = (u32_t)strtoul(argv[2], NULL, 10);
+  }
+
+  lwip_init();
+
+  IP4_ADDR(&ipaddr, 10, 0, 0, 1);
+  IP4_ADDR(&netmask, 255, 255, 255, 0);
+  ip4_addr_set_zero(&gw);
+  netif_add(&bench_netif, &ipaddr, &netmask, &gw, NULL, link_init, netif_input);
+  netif_set_default(&bench_netif);
+  netif_set_up(&bench_netif);
+
+  server.pcb = udp_new();
+  LWIP_ASSERT("udp_new failed", server.pcb != NULL);
+  udp_bind(server.pcb, IP_ADDR_ANY, BENCH_SERVER_PORT);
+  udp_recv(server.pcb, server_recv, NULL);
+
+  tftp_init_client(&client_ctx);
+
+  for (i = 0; i < LWIP_ARRAYSIZE(runs); i++) {
+    ret |= bench_run(1, runs[i][0], runs[i][1], size);
+    ret |= bench_run(0, runs[i][0], runs[i][1], size);
+  }
+
+  tftp_cleanup();
+  udp_remove(server.pcb);
+  return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}
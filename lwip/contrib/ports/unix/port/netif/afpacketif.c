@@ -0,0 +1,632 @@
+/*
+ * Copyright (c) 2001-2003 Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the lwIP TCP/IP stack.
+ *
+ */
+
+/*
+ * Network interface attached to an existing Linux network interface (a veth
+ * pair, a dummy interface, or a real NIC) through an AF_PACKET socket.
+ *
+ * Frames are exchanged through memory mapped rings (PACKET_RX_RING and
+ * PACKET_TX_RING, TPACKET_V3). The kernel fills the RX ring a block at a
+ * time and hands over a block when it is full or has timed out, so a single
+ * wakeup passes many frames. Received frames are not copied: each is passed
+ * to the stack as a PBUF_REF custom pbuf pointing into the ring, and the
+ * block is given back to the kernel when the last pbuf referencing it is
+ * freed.
+ *
+ * Opening the socket needs CAP_NET_RAW. The Linux interface must exist and
+ * be up, its name is taken from the AFPACKETIF environment variable
+ * (AFPACKETIF_DEFAULT_IF if not set), e.g.:
+ *   ip link add veth0 type veth peer name veth1
+ *   ip addr add 192.168.1.1/24 dev veth0
+ *   ip link set veth0 up; ip link set veth1 up
+ *   ethtool -K veth0 tx off tso off gso off
+ *   AFPACKETIF=veth1 ./example_app
+ * Checksum and segmentation offload must be disabled on the peer: the
+ * ring carries frames as the kernel has them, without checksum and
+ * possibly larger than the MTU.
+ */
+
+#include "lwip/opt.h"
+
+#if defined(LWIP_UNIX_LINUX) /* AF_PACKET rings are only available on Linux */
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <net/if.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+
+#include "lwip/debug.h"
+#include "lwip/def.h"
+#include "lwip/mem.h"
+#include "lwip/memp.h"
+#include "lwip/stats.h"
+#include "lwip/snmp.h"
+#include "lwip/pbuf.h"
+#include "lwip/sys.h"
+#include "lwip/timeouts.h"
+#include "netif/etharp.h"
+#include "lwip/ethip6.h"
+
+#include "netif/afpacketif.h"
+
+/* Define those to better describe your network interface. */
+#define IFNAME0 'a'
+#define IFNAME1 'p'
+
+#ifndef AFPACKETIF_DEBUG
+#define AFPACKETIF_DEBUG LWIP_DBG_OFF
+#endif
+
+/* Linux interface used if the AFPACKETIF environment variable is not set. */
+#ifndef AFPACKETIF_DEFAULT_IF
+#define AFPACKETIF_DEFAULT_IF "veth1"
+#endif
+
+/*
+ * Size of a block of the RX ring, a multiple of the page size. A block is
+ * passed to lwIP when it is full or after AFPACKETIF_RX_TIMEOUT, smaller
+ * blocks give lower latency, larger ones fewer wakeups.
+ */
+#ifndef AFPACKETIF_RX_BLOCK_SIZE
+#define AFPACKETIF_RX_BLOCK_SIZE 16384
+#endif
+
+/*
+ * Number of blocks of the RX ring. Up to half of the ring may be held by
+ * the stack (see AFPACKETIF_RX_PBUFS), the other half must take at least a
+ * full TCP window or reception stalls until the held frames are freed.
+ */
+#ifndef AFPACKETIF_RX_BLOCKS
+#define AFPACKETIF_RX_BLOCKS 64
+#endif
+
+/* Time in milliseconds after which a partially filled RX block is retired. */
+#ifndef AFPACKETIF_RX_TIMEOUT
+#define AFPACKETIF_RX_TIMEOUT 1
+#endif
+
+/*
+ * Number of received frames that can be passed to the stack without
+ * copying. Frames are copied into PBUF_POOL pbufs if none is left, or if
+ * the stack holds on to more than half of the RX ring (e.g. out of sequence
+ * TCP segments), so that the kernel does not run out of blocks.
+ */
+#ifndef AFPACKETIF_RX_PBUFS
+#define AFPACKETIF_RX_PBUFS 256
+#endif
+
+/* Number of frames of the TX ring. */
+#ifndef AFPACKETIF_TX_FRAMES
+#define AFPACKETIF_TX_FRAMES 256
+#endif
+
+/* Size of a TX frame slot, header included. */
+#define AFPACKETIF_TX_FRAME_SIZE 2048
+/* without PACKET_TX_HAS_OFF, frames are sent from right behind the header */
+#define AFPACKETIF_TX_DATA (TPACKET3_HDRLEN - sizeof(struct sockaddr_ll))
+#define AFPACKETIF_TX_MAX (AFPACKETIF_TX_FRAME_SIZE - AFPACKETIF_TX_DATA)
+
+#define AFPACKETIF_RX_RING_SIZE ((size_t)AFPACKETIF_RX_BLOCK_SIZE * AFPACKETIF_RX_BLOCKS)
+#define AFPACKETIF_TX_RING_SIZE ((size_t)AFPACKETIF_TX_FRAME_SIZE * AFPACKETIF_TX_FRAMES)
+
+#define AFPACKETIF_RX_BLOCK(afp, i) \
+  ((struct tpacket_block_desc *)((afp)->ring + (size_t)(i) * AFPACKETIF_RX_BLOCK_SIZE))
+#define AFPACKETIF_TX_FRAME(afp, i) \
+  ((struct tpacket3_hdr *)((afp)->ring + AFPACKETIF_RX_RING_SIZE + (size_t)(i) * AFPACKETIF_TX_FRAME_SIZE))
+
+struct afpacketif {
+  struct netif *netif;
+  int fd;
+  /* RX ring followed by the TX ring */
+  u8_t *ring;
+  /* next RX block to process */
+  u32_t rx_block;
+  /* next TX frame slot to fill */
+  u32_t tx_frame;
+  /* number of RX blocks owned by lwIP */
+  u32_t rx_blocks_out;
+  /* references to each RX block owned by lwIP: pbufs, and the RX loop while it walks it */
+  u16_t rx_refs[AFPACKETIF_RX_BLOCKS];
+#if !NO_SYS
+  /* signalled when an RX block is given back to the kernel */
+  sys_sem_t rx_released;
+#endif /* !NO_SYS */
+};
+
+#if LWIP_SUPPORT_CUSTOM_PBUF
+/* A received frame passed to the stack without copying */
+struct afpacketif_rx_pbuf {
+  struct pbuf_custom pc;
+  struct afpacketif *afp;
+  u32_t block;
+};
+
+LWIP_MEMPOOL_DECLARE(AFPACKETIF_RX_PBUF, AFPACKETIF_RX_PBUFS, sizeof(struct afpacketif_rx_pbuf), "AFPACKETIF_RX_PBUF")
+#endif /* LWIP_SUPPORT_CUSTOM_PBUF */
+
+/* Forward declarations. */
+#if !NO_SYS
+static void afpacketif_thread(void *arg);
+#endif /* !NO_SYS */
+
+/*-----------------------------------------------------------------------------------*/
+static void
+low_level_init(struct netif *netif)
+{
+  struct afpacketif *afp;
+  struct tpacket_req3 req;
+  struct sockaddr_ll sll;
+  struct packet_mreq mreq;
+  int version = TPACKET_V3;
+  unsigned int ifindex;
+  const char *ifname = getenv("AFPACKETIF");
+  void *ring;
+
+  afp = (struct afpacketif *)netif->state;
+#if LWIP_TCP && TCP_QUEUE_OOSEQ
+  LWIP_ASSERT("afpacketif: RX ring must be at least 2 * TCP_WND",
+              AFPACKETIF_RX_RING_SIZE >= 2 * (size_t)TCP_WND);
+#endif /* LWIP_TCP && TCP_QUEUE_OOSEQ */
+  if (ifname == NULL) {
+    ifname = AFPACKETIF_DEFAULT_IF;
+  }
+
+  /* Obtain MAC address from network interface. */
+
+  /* (We just fake an address...) */
+  netif->hwaddr[0] = 0x02;
+  netif->hwaddr[1] = 0x12;
+  netif->hwaddr[2] = 0x34;
+  netif->hwaddr[3] = 0x56;
+  netif->hwaddr[4] = 0x78;
+  netif->hwaddr[5] = 0xac;
+  netif->hwaddr_len = 6;
+
+  /* device capabilities */
+  netif->flags = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP | NETIF_FLAG_IGMP;
+
+  ifindex = if_nametoindex(ifname);
+  if (ifindex == 0) {
+    fprintf(stderr, "afpacketif_init: no interface %s\n", ifname);
+    exit(1);
+  }
+
+  afp->fd = socket(AF_PACKET, SOCK_RAW, PP_HTONS(ETH_P_ALL));
+  LWIP_DEBUGF(AFPACKETIF_DEBUG, ("afpacketif_init: fd %d\n", afp->fd));
+  if (afp->fd == -1) {
+    perror("afpacketif_init: socket (needs CAP_NET_RAW)");
+    exit(1);
+  }
+  if (setsockopt(afp->fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0) {
+    perror("afpacketif_init: setsockopt PACKET_VERSION");
+    exit(1);
+  }
+
+  memset(&req, 0, sizeof(req));
+  req.tp_block_size = AFPACKETIF_RX_BLOCK_SIZE;
+  req.tp_block_nr = AFPACKETIF_RX_BLOCKS;
+  req.tp_frame_size = AFPACKETIF_TX_FRAME_SIZE;
+  req.tp_frame_nr = (AFPACKETIF_RX_BLOCK_SIZE / AFPACKETIF_TX_FRAME_SIZE) * AFPACKETIF_RX_BLOCKS;
+  req.tp_retire_blk_tov = AFPACKETIF_RX_TIMEOUT;
+  if (setsockopt(afp->fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0) {
+    perror("afpacketif_init: setsockopt PACKET_RX_RING");
+    exit(1);
+  }
+
+  /* the TX ring is a single block of frames */
+  memset(&req, 0, sizeof(req));
+  req.tp_block_size = (unsigned int)AFPACKETIF_TX_RING_SIZE;
+  req.tp_block_nr = 1;
+  req.tp_frame_size = AFPACKETIF_TX_FRAME_SIZE;
+  req.tp_frame_nr = AFPACKETIF_TX_FRAMES;
+  if (setsockopt(afp->fd, SOL_PACKET, PACKET_TX_RING, &req, sizeof(req)) < 0) {
+    perror("afpacketif_init: setsockopt PACKET_TX_RING");
+    exit(1);
+  }
+
+  ring = mmap(NULL, AFPACKETIF_RX_RING_SIZE + AFPACKETIF_TX_RING_SIZE,
+              PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, afp->fd, 0);
+  if (ring == MAP_FAILED) {
+    /* MAP_LOCKED may exceed RLIMIT_MEMLOCK */
+    ring = mmap(NULL, AFPACKETIF_RX_RING_SIZE + AFPACKETIF_TX_RING_SIZE,
+                PROT_READ | PROT_WRITE, MAP_SHARED, afp->fd, 0);
+    if (ring == MAP_FAILED) {
+      perror("afpacketif_init: mmap");
+      exit(1);
+    }
+  }
+  afp->ring = (u8_t *)ring;
+
+  memset(&sll, 0, sizeof(sll));
+  sll.sll_family = AF_PACKET;
+  sll.sll_protocol = PP_HTONS(ETH_P_ALL);
+  sll.sll_ifindex = (int)ifindex;
+  if (bind(afp->fd, (struct sockaddr *)&sll, sizeof(sll)) < 0) {
+    perror("afpacketif_init: bind");
+    exit(1);
+  }
+
+  /* our MAC address is not the one of the Linux interface */
+  memset(&mreq, 0, sizeof(mreq));
+  mreq.mr_ifindex = (int)ifindex;
+  mreq.mr_type = PACKET_MR_PROMISC;
+  if (setsockopt(afp->fd, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+    perror("afpacketif_init: setsockopt PACKET_ADD_MEMBERSHIP");
+  }
+
+  netif_set_link_up(netif);
+
+#if !NO_SYS
+  if (sys_sem_new(&afp->rx_released, 0) != ERR_OK) {
+    LWIP_ASSERT("afpacketif_init: failed to create semaphore", 0);
+  }
+  sys_thread_new("afpacketif_thread", afpacketif_thread, afp, DEFAULT_THREAD_STACKSIZE, DEFAULT_THREAD_PRIO);
+#endif /* !NO_SYS */
+}
+/*-----------------------------------------------------------------------------------*/
+/*
+ * low_level_output():
+ *
+ * Should do the actual transmission of the packet. The packet is
+ * contained in the pbuf that is passed to the function. This pbuf
+ * might be chained.
+ *
+ * The frame is copied into the next slot of the TX ring and the kernel
+ * is kicked to send all pending slots.
+ */
+/*-----------------------------------------------------------------------------------*/
+static err_t
+low_level_output(struct netif *netif, struct pbuf *p)
+{
+  struct afpacketif *afp = (struct afpacketif *)netif->state;
+  struct tpacket3_hdr *hdr = AFPACKETIF_TX_FRAME(afp, afp->tx_frame);
+  u16_t len = (u16_t)(p->tot_len - ETH_PAD_SIZE);
+
+  if (len > AFPACKETIF_TX_MAX) {
+    MIB2_STATS_NETIF_INC(netif, ifoutdiscards);
+    LWIP_DEBUGF(AFPACKETIF_DEBUG, ("afpacketif: packet too large\n"));
+    return ERR_IF;
+  }
+
+  if (__atomic_load_n(&hdr->tp_status, __ATOMIC_ACQUIRE) != TP_STATUS_AVAILABLE) {
+    /* ring full: wait for the kernel to send the pending frames */
+    if (send(afp->fd, NULL, 0, 0) < 0 ||
+        __atomic_load_n(&hdr->tp_status, __ATOMIC_ACQUIRE) != TP_STATUS_AVAILABLE) {
+      MIB2_STATS_NETIF_INC(netif, ifoutdiscards);
+      LWIP_DEBUGF(AFPACKETIF_DEBUG, ("afpacketif: TX ring full\n"));
+      return ERR_MEM;
+    }
+  }
+
+  pbuf_copy_partial(p, (u8_t *)hdr + AFPACKETIF_TX_DATA, len, ETH_PAD_SIZE);
+  hdr->tp_len = len;
+  __atomic_store_n(&hdr->tp_status, TP_STATUS_SEND_REQUEST, __ATOMIC_RELEASE);
+  afp->tx_frame = (afp->tx_frame + 1) % AFPACKETIF_TX_FRAMES;
+
+  if (send(afp->fd, NULL, 0, MSG_DONTWAIT) < 0 &&
+      errno != EAGAIN && errno != ENOBUFS) {
+    MIB2_STATS_NETIF_INC(netif, ifoutdiscards);
+    perror("afpacketif: send");
+    return ERR_IF;
+  }
+  MIB2_STATS_NETIF_ADD(netif, ifoutoctets, len);
+  return ERR_OK;
+}
+/*-----------------------------------------------------------------------------------*/
+/* Drop a reference to an RX block, give it back to the kernel on the last one. */
+static void
+afpacketif_block_unref(struct afpacketif *afp, u32_t block)
+{
+  int release;
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  SYS_ARCH_PROTECT(lev);
+  release = (--afp->rx_refs[block] == 0);
+  if (release) {
+    afp->rx_blocks_out--;
+  }
+  SYS_ARCH_UNPROTECT(lev);
+
+  if (release) {
+    __atomic_store_n(&AFPACKETIF_RX_BLOCK(afp, block)->hdr.bh1.block_status,
+                     TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+#if !NO_SYS
+    sys_sem_signal(&afp->rx_released);
+#endif /* !NO_SYS */
+  }
+}
+
+/* Check if an RX block is still referenced by pbufs held in the stack. */
+static int
+afpacketif_block_held(struct afpacketif *afp, u32_t block)
+{
+  int held;
+  SYS_ARCH_DECL_PROTECT(lev);
+
+  SYS_ARCH_PROTECT(lev);
+  held = (afp->rx_refs[block] != 0);
+  SYS_ARCH_UNPROTECT(lev);
+  return held;
+}
+
+#if LWIP_SUPPORT_CUSTOM_PBUF
+static void
+afpacketif_rx_pbuf_free(struct pbuf *p)
+{
+  struct afpacketif_rx_pbuf *rp = (struct afpacketif_rx_pbuf *)p;
+
+  afpacketif_block_unref(rp->afp, rp->block);
+  LWIP_MEMPOOL_FREE(AFPACKETIF_RX_PBUF, rp);
+}
+#endif /* LWIP_SUPPORT_CUSTOM_PBUF */
+/*-----------------------------------------------------------------------------------*/
+/*
+ * low_level_input():
+ *
+ * Wraps a frame of an RX block into a pbuf. The pbuf references the ring
+ * (and the block) unless copy is set or no custom pbuf is left.
+ */
+/*-----------------------------------------------------------------------------------*/
+static struct pbuf *
+low_level_input(struct afpacketif *afp, u32_t block, struct tpacket3_hdr *hdr, int copy)
+{
+  struct netif *netif = afp->netif;
+  const struct sockaddr_ll *sll = (const struct sockaddr_ll *)((u8_t *)hdr + TPACKET_ALIGN(sizeof(struct tpacket3_hdr)));
+  u8_t *frame = (u8_t *)hdr + hdr->tp_mac;
+  struct pbuf *p = NULL;
+  u16_t len;
+
+  LWIP_UNUSED_ARG(netif); /* only used for MIB2 stats */
+  if (sll->sll_pkttype == PACKET_OUTGOING) {
+    /* sent by the host on this interface, not for us */
+    return NULL;
+  }
+  if (hdr->tp_snaplen != hdr->tp_len || hdr->tp_snaplen > 0xffff - ETH_PAD_SIZE) {
+    MIB2_STATS_NETIF_INC(netif, ifindiscards);
+    return NULL;
+  }
+  len = (u16_t)(hdr->tp_snaplen + ETH_PAD_SIZE);
+  MIB2_STATS_NETIF_ADD(netif, ifinoctets, hdr->tp_snaplen);
+
+#if LWIP_SUPPORT_CUSTOM_PBUF
+  if (!copy) {
+    struct afpacketif_rx_pbuf *rp = (struct afpacketif_rx_pbuf *)LWIP_MEMPOOL_ALLOC(AFPACKETIF_RX_PBUF);
+    if (rp != NULL) {
+      SYS_ARCH_DECL_PROTECT(lev);
+
+      SYS_ARCH_PROTECT(lev);
+      afp->rx_refs[block]++;
+      SYS_ARCH_UNPROTECT(lev);
+      rp->pc.custom_free_function = afpacketif_rx_pbuf_free;
+      rp->afp = afp;
+      rp->block = block;
+      /* the kernel leaves room in front of the frame, ETH_PAD_SIZE fits there */
+      p = pbuf_alloced_custom(PBUF_RAW, len, PBUF_REF, &rp->pc, frame - ETH_PAD_SIZE, len);
+    }
+  }
+#else /* LWIP_SUPPORT_CUSTOM_PBUF */
+  LWIP_UNUSED_ARG(block);
+  LWIP_UNUSED_ARG(copy);
+#endif /* LWIP_SUPPORT_CUSTOM_PBUF */
+
+  if (p == NULL) {
+    p = pbuf_alloc(PBUF_RAW, len, PBUF_POOL);
+    if (p == NULL) {
+      /* drop packet(); */
+      MIB2_STATS_NETIF_INC(netif, ifindiscards);
+      LINK_STATS_INC(link.memerr);
+      LINK_STATS_INC(link.drop);
+      LWIP_DEBUGF(NETIF_DEBUG, ("afpacketif_input: could not allocate pbuf\n"));
+      return NULL;
+    }
+    pbuf_take_at(p, frame, (u16_t)hdr->tp_snaplen, ETH_PAD_SIZE);
+  }
+  LINK_STATS_INC(link.recv);
+  return p;
+}
+/*-----------------------------------------------------------------------------------*/
+/*
+ * afpacketif_input():
+ *
+ * Passes the frames of all RX blocks the kernel has handed over to the
+ * stack. Returns the number of blocks processed.
+ *
+ * Stops at a block that is still referenced by pbufs from the previous
+ * round of the ring: it keeps TP_STATUS_USER until they are freed and
+ * must not be mistaken for a new block.
+ */
+/*-----------------------------------------------------------------------------------*/
+static int
+afpacketif_input(struct afpacketif *afp)
+{
+  struct netif *netif = afp->netif;
+  int blocks = 0;
+
+  for (;;) {
+    u32_t block = afp->rx_block;
+    struct tpacket_block_desc *bd = AFPACKETIF_RX_BLOCK(afp, block);
+    struct tpacket3_hdr *hdr;
+    u32_t i, num;
+    int copy;
+    SYS_ARCH_DECL_PROTECT(lev);
+
+    if (afpacketif_block_held(afp, block) ||
+        (__atomic_load_n(&bd->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER) == 0) {
+      return blocks;
+    }
+
+    SYS_ARCH_PROTECT(lev);
+    /* held by us until all frames are passed on */
+    afp->rx_refs[block] = 1;
+    afp->rx_blocks_out++;
+    copy = afp->rx_blocks_out > AFPACKETIF_RX_BLOCKS / 2;
+    SYS_ARCH_UNPROTECT(lev);
+
+    num = bd->hdr.bh1.num_pkts;
+    hdr = (struct tpacket3_hdr *)((u8_t *)bd + bd->hdr.bh1.offset_to_first_pkt);
+    for (i = 0; i < num; i++) {
+      struct pbuf *p = low_level_input(afp, block, hdr, copy);
+
+      if ((p != NULL) && (netif->input(p, netif) != ERR_OK)) {
+        LWIP_DEBUGF(NETIF_DEBUG, ("afpacketif_input: netif input error\n"));
+        pbuf_free(p);
+      }
+      hdr = (struct tpacket3_hdr *)((u8_t *)hdr + hdr->tp_next_offset);
+    }
+
+    afp->rx_block = (block + 1) % AFPACKETIF_RX_BLOCKS;
+    afpacketif_block_unref(afp, block);
+    blocks++;
+  }
+}
+/*-----------------------------------------------------------------------------------*/
+/*
+ * afpacketif_init():
+ *
+ * Should be called at the beginning of the program to set up the
+ * network interface. It calls the function low_level_init() to do the
+ * actual setup of the hardware.
+ *
+ */
+/*-----------------------------------------------------------------------------------*/
+err_t
+afpacketif_init(struct netif *netif)
+{
+  struct afpacketif *afp = (struct afpacketif *)mem_malloc(sizeof(struct afpacketif));
+#if LWIP_SUPPORT_CUSTOM_PBUF
+  static int pool_initialized;
+
+  if (!pool_initialized) {
+    LWIP_MEMPOOL_INIT(AFPACKETIF_RX_PBUF);
+    pool_initialized = 1;
+  }
+#endif /* LWIP_SUPPORT_CUSTOM_PBUF */
+
+  if (afp == NULL) {
+    LWIP_DEBUGF(NETIF_DEBUG, ("afpacketif_init: out of memory for afpacketif\n"));
+    return ERR_MEM;
+  }
+  memset(afp, 0, sizeof(struct afpacketif));
+  afp->netif = netif;
+  netif->state = afp;
+  MIB2_INIT_NETIF(netif, snmp_ifType_ethernet_csmacd, 100000000);
+
+  netif->name[0] = IFNAME0;
+  netif->name[1] = IFNAME1;
+#if LWIP_IPV4
+  netif->output = etharp_output;
+#endif /* LWIP_IPV4 */
+#if LWIP_IPV6
+  netif->output_ip6 = ethip6_output;
+#endif /* LWIP_IPV6 */
+  netif->linkoutput = low_level_output;
+  netif->mtu = 1500;
+
+  low_level_init(netif);
+
+  return ERR_OK;
+}
+/*-----------------------------------------------------------------------------------*/
+void
+afpacketif_poll(struct netif *netif)
+{
+  afpacketif_input((struct afpacketif *)netif->state);
+}
+
+#if NO_SYS
+
+int
+afpacketif_select(struct netif *netif)
+{
+  struct afpacketif *afp = (struct afpacketif *)netif->state;
+  struct pollfd pfd;
+  int ret;
+  u32_t msecs = sys_timeouts_sleeptime();
+
+  pfd.fd = afp->fd;
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+
+  ret = poll(&pfd, 1, msecs == SYS_TIMEOUTS_SLEEPTIME_INFINITE ? -1 : (int)LWIP_MIN(msecs, 0x7fffffffUL));
+  if (ret > 0) {
+    afpacketif_input(afp);
+  }
+  return ret;
+}
+
+#else /* NO_SYS */
+
+static void
+afpacketif_thread(void *arg)
+{
+  struct afpacketif *afp = (struct afpacketif *)arg;
+  struct pollfd pfd;
+  int idle = 0;
+
+  while (1) {
+    if (afpacketif_input(afp) > 0) {
+      idle = 0;
+      continue;
+    }
+    if (afpacketif_block_held(afp, afp->rx_block)) {
+      /* the ring has wrapped around to a block the stack still holds */
+      sys_arch_sem_wait(&afp->rx_released, 0);
+      continue;
+    }
+    if (idle) {
+      /* poll() also reports the last block we processed while pbufs held
+         in the stack still reference it: wait for it to be released
+         instead of spinning */
+      sys_arch_sem_wait(&afp->rx_released, AFPACKETIF_RX_TIMEOUT);
+    }
+    idle = 1;
+
+    pfd.fd = afp->fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    /* Wait for a block to be retired. */
+    if (poll(&pfd, 1, -1) < 0 && errno != EINTR) {
+      perror("afpacketif_thread: poll");
+    }
+  }
+}
+
+#endif /* NO_SYS */
+
+#endif /* LWIP_UNIX_LINUX */
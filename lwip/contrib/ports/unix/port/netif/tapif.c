@@ -30,6 +30,7 @@
  *
  */
 
+#include <errno.h>
 #include <fcntl.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -46,6 +47,7 @@
 
 #include "lwip/debug.h"
 #include "lwip/def.h"
+#include "lwip/inet_chksum.h"
 #include "lwip/ip.h"
 #include "lwip/mem.h"
 #include "lwip/stats.h"
@@ -64,6 +66,7 @@
 #include <sys/ioctl.h>
 #include <linux/if.h>
 #include <linux/if_tun.h>
+#include <linux/virtio_net.h>
 /*
  * Creating a tap interface requires special privileges. If the interfaces
  * is created in advance with `tunctl -u <user>` it can be opened as a regular
@@ -98,27 +101,162 @@
 #define TAPIF_DEBUG LWIP_DBG_OFF
 #endif
 
+/*
+ * Linux only: exchange a virtio_net_hdr with every frame (IFF_VNET_HDR) so
+ * that the kernel can pass frames with an incomplete TCP/UDP checksum, and
+ * TCP frames up to 64 KByte (GSO) if TAPIF_GSO is enabled. Frames received
+ * with a partial checksum are completed here, frames sent by lwIP always
+ * have a valid checksum and no GSO.
+ */
+#ifndef TAPIF_VNET_HDR
+#define TAPIF_VNET_HDR 0
+#endif
+
+/*
+ * Accept GSO frames (TCP over IPv4 and IPv6) from the kernel. Each frame
+ * can then take up to 64 KByte from PBUF_POOL, so the pool must be sized
+ * for it.
+ */
+#ifndef TAPIF_GSO
+#define TAPIF_GSO TAPIF_VNET_HDR
+#endif
+
+/*
+ * Linux only: number of queues of the tap device (IFF_MULTI_QUEUE), each
+ * queue is served by its own RX thread.
+ */
+#ifndef TAPIF_NUM_QUEUES
+#define TAPIF_NUM_QUEUES 1
+#endif
+
+/* Maximum number of frames read per wakeup. */
+#ifndef TAPIF_RX_BATCH
+#define TAPIF_RX_BATCH 16
+#endif
+
+/* Maximum number of pbufs of a chain written with one writev(). */
+#ifndef TAPIF_TX_IOVS
+#define TAPIF_TX_IOVS 16
+#endif
+
+#if (TAPIF_VNET_HDR || TAPIF_NUM_QUEUES > 1) && !defined(LWIP_UNIX_LINUX)
+#error "TAPIF_VNET_HDR and TAPIF_NUM_QUEUES > 1 need Linux"
+#endif
+#if TAPIF_GSO && !TAPIF_VNET_HDR
+#error "TAPIF_GSO needs TAPIF_VNET_HDR"
+#endif
+#if TAPIF_NUM_QUEUES > 1 && NO_SYS
+#error "TAPIF_NUM_QUEUES > 1 needs NO_SYS==0"
+#endif
+
+#if TAPIF_VNET_HDR
+#define TAPIF_HDR_LEN sizeof(struct virtio_net_hdr)
+#else
+#define TAPIF_HDR_LEN 0
+#endif
+
+/* largest frame we receive, including VLAN excluding CRC */
+#if TAPIF_GSO
+#define TAPIF_RX_SIZE (SIZEOF_ETH_HDR + 4 + 0xffff)
+#else
+#define TAPIF_RX_SIZE 1518
+#endif
+#define TAPIF_TX_SIZE 1518
+
+/* number of pool pbufs a frame is read into */
+#define TAPIF_RX_PBUFS ((int)((TAPIF_RX_SIZE + PBUF_POOL_BUFSIZE - 1) / PBUF_POOL_BUFSIZE))
+
+struct tapif_queue {
+  struct netif *netif;
+  int fd;
+  /* pool pbufs the next frame is read into, refilled as they are used */
+  struct pbuf *rx_pbufs[TAPIF_RX_PBUFS];
+};
+
 struct tapif {
   /* Add whatever per-interface state that is needed here. */
-  int fd;
+  struct tapif_queue queues[TAPIF_NUM_QUEUES];
 };
 
 /* Forward declarations. */
-static void tapif_input(struct netif *netif);
+static void tapif_input(struct tapif_queue *queue);
 #if !NO_SYS
 static void tapif_thread(void *arg);
 #endif /* !NO_SYS */
 
+/*-----------------------------------------------------------------------------------*/
+static void
+low_level_open(struct tapif_queue *queue, const char *ifname)
+{
+  queue->fd = open(DEVTAP, O_RDWR);
+  LWIP_DEBUGF(TAPIF_DEBUG, ("tapif_init: fd %d\n", queue->fd));
+  if (queue->fd == -1) {
+#ifdef LWIP_UNIX_LINUX
+    perror("tapif_init: try running \"modprobe tun\" or rebuilding your kernel with CONFIG_TUN; cannot open "DEVTAP);
+#else /* LWIP_UNIX_LINUX */
+    perror("tapif_init: cannot open "DEVTAP);
+#endif /* LWIP_UNIX_LINUX */
+    exit(1);
+  }
+
+#ifdef LWIP_UNIX_LINUX
+  {
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+
+    strncpy(ifr.ifr_name, ifname, sizeof(ifr.ifr_name));
+    ifr.ifr_name[sizeof(ifr.ifr_name)-1] = 0; /* ensure \0 termination */
+
+    ifr.ifr_flags = IFF_TAP|IFF_NO_PI;
+#if TAPIF_VNET_HDR
+    ifr.ifr_flags |= IFF_VNET_HDR;
+#endif /* TAPIF_VNET_HDR */
+#if TAPIF_NUM_QUEUES > 1
+    ifr.ifr_flags |= IFF_MULTI_QUEUE;
+#endif /* TAPIF_NUM_QUEUES > 1 */
+    if (ioctl(queue->fd, TUNSETIFF, (void *) &ifr) < 0) {
+      perror("tapif_init: "DEVTAP" ioctl TUNSETIFF");
+      exit(1);
+    }
+#if TAPIF_VNET_HDR
+    {
+      unsigned int offload = TUN_F_CSUM;
+#if TAPIF_GSO
+      offload |= TUN_F_TSO4 | TUN_F_TSO6;
+#endif /* TAPIF_GSO */
+      if (ioctl(queue->fd, TUNSETOFFLOAD, offload) < 0) {
+        perror("tapif_init: "DEVTAP" ioctl TUNSETOFFLOAD");
+        exit(1);
+      }
+    }
+#endif /* TAPIF_VNET_HDR */
+  }
+#else /* LWIP_UNIX_LINUX */
+  LWIP_UNUSED_ARG(ifname);
+#endif /* LWIP_UNIX_LINUX */
+
+  /* frames are drained until read() would block */
+  if (fcntl(queue->fd, F_SETFL, fcntl(queue->fd, F_GETFL) | O_NONBLOCK) < 0) {
+    perror("tapif_init: fcntl O_NONBLOCK");
+    exit(1);
+  }
+}
 /*-----------------------------------------------------------------------------------*/
 static void
 low_level_init(struct netif *netif)
 {
   struct tapif *tapif;
+  int i;
 #if LWIP_IPV4
   int ret;
   char buf[1024];
 #endif /* LWIP_IPV4 */
   char *preconfigured_tapif = getenv("PRECONFIGURED_TAPIF");
+#ifdef LWIP_UNIX_LINUX
+  const char *ifname = preconfigured_tapif ? preconfigured_tapif : DEVTAP_DEFAULT_IF;
+#else /* LWIP_UNIX_LINUX */
+  const char *ifname = NULL;
+#endif /* LWIP_UNIX_LINUX */
 
   tapif = (struct tapif *)netif->state;
 
@@ -136,36 +274,10 @@ low_level_init(struct netif *netif)
   /* device capabilities */
   netif->flags = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP | NETIF_FLAG_IGMP;
 
-  tapif->fd = open(DEVTAP, O_RDWR);
-  LWIP_DEBUGF(TAPIF_DEBUG, ("tapif_init: fd %d\n", tapif->fd));
-  if (tapif->fd == -1) {
-#ifdef LWIP_UNIX_LINUX
-    perror("tapif_init: try running \"modprobe tun\" or rebuilding your kernel with CONFIG_TUN; cannot open "DEVTAP);
-#else /* LWIP_UNIX_LINUX */
-    perror("tapif_init: cannot open "DEVTAP);
-#endif /* LWIP_UNIX_LINUX */
-    exit(1);
-  }
-
-#ifdef LWIP_UNIX_LINUX
-  {
-    struct ifreq ifr;
-    memset(&ifr, 0, sizeof(ifr));
-
-    if (preconfigured_tapif) {
-      strncpy(ifr.ifr_name, preconfigured_tapif, sizeof(ifr.ifr_name));
-    } else {
-      strncpy(ifr.ifr_name, DEVTAP_DEFAULT_IF, sizeof(ifr.ifr_name));
-    }
-    ifr.ifr_name[sizeof(ifr.ifr_name)-1] = 0; /* ensure \0 termination */
-
-    ifr.ifr_flags = IFF_TAP|IFF_NO_PI;
-    if (ioctl(tapif->fd, TUNSETIFF, (void *) &ifr) < 0) {
-      perror("tapif_init: "DEVTAP" ioctl TUNSETIFF");
-      exit(1);
-    }
+  for (i = 0; i < TAPIF_NUM_QUEUES; i++) {
+    tapif->queues[i].netif = netif;
+    low_level_open(&tapif->queues[i], ifname);
   }
-#endif /* LWIP_UNIX_LINUX */
 
   netif_set_link_up(netif);
 
@@ -201,7 +313,9 @@ low_level_init(struct netif *netif)
   }
 
 #if !NO_SYS
-  sys_thread_new("tapif_thread", tapif_thread, netif, DEFAULT_THREAD_STACKSIZE, DEFAULT_THREAD_PRIO);
+  for (i = 0; i < TAPIF_NUM_QUEUES; i++) {
+    sys_thread_new("tapif_thread", tapif_thread, &tapif->queues[i], DEFAULT_THREAD_STACKSIZE, DEFAULT_THREAD_PRIO);
+  }
 #endif /* !NO_SYS */
 }
 /*-----------------------------------------------------------------------------------*/
@@ -219,8 +333,20 @@ static err_t
 low_level_output(struct netif *netif, struct pbuf *p)
 {
   struct tapif *tapif = (struct tapif *)netif->state;
-  char buf[1518]; /* max packet size including VLAN excluding CRC */
+  struct iovec iov[1 + TAPIF_TX_IOVS];
+  char buf[TAPIF_TX_SIZE]; /* used if the chain is longer than TAPIF_TX_IOVS */
+  struct pbuf *q;
+  int cnt = 0;
   ssize_t written;
+#if TAPIF_VNET_HDR
+  /* no offload: lwIP computes all checksums and never sends GSO frames */
+  struct virtio_net_hdr hdr;
+
+  memset(&hdr, 0, sizeof(hdr));
+  iov[cnt].iov_base = &hdr;
+  iov[cnt].iov_len = sizeof(hdr);
+  cnt++;
+#endif /* TAPIF_VNET_HDR */
 
 #if 0
   if (((double)rand()/(double)RAND_MAX) < 0.2) {
@@ -229,74 +355,184 @@ low_level_output(struct netif *netif, struct pbuf *p)
   }
 #endif
 
-  if (p->tot_len > sizeof(buf)) {
+  if (p->tot_len > TAPIF_TX_SIZE) {
     MIB2_STATS_NETIF_INC(netif, ifoutdiscards);
     perror("tapif: packet too large");
     return ERR_IF;
   }
 
   /* initiate transfer(); */
-  pbuf_copy_partial(p, buf, p->tot_len, 0);
+  if (pbuf_clen(p) <= TAPIF_TX_IOVS) {
+    /* write the chain as it is */
+    for (q = p; q != NULL; q = q->next) {
+      iov[cnt].iov_base = q->payload;
+      iov[cnt].iov_len = q->len;
+      cnt++;
+    }
+  } else {
+    pbuf_copy_partial(p, buf, p->tot_len, 0);
+    iov[cnt].iov_base = buf;
+    iov[cnt].iov_len = p->tot_len;
+    cnt++;
+  }
 
   /* signal that packet should be sent(); */
-  written = write(tapif->fd, buf, p->tot_len);
-  if (written < p->tot_len) {
+  written = writev(tapif->queues[0].fd, iov, cnt);
+  if (written < (ssize_t)(TAPIF_HDR_LEN + p->tot_len)) {
     MIB2_STATS_NETIF_INC(netif, ifoutdiscards);
     perror("tapif: write");
     return ERR_IF;
   } else {
-    MIB2_STATS_NETIF_ADD(netif, ifoutoctets, (u32_t)written);
+    MIB2_STATS_NETIF_ADD(netif, ifoutoctets, (u32_t)(written - TAPIF_HDR_LEN));
     return ERR_OK;
   }
 }
 /*-----------------------------------------------------------------------------------*/
+#if TAPIF_VNET_HDR
+/*
+ * Complete the checksum of a frame the kernel passed with
+ * VIRTIO_NET_HDR_F_NEEDS_CSUM: the checksum field already holds the
+ * pseudo header sum, the checksum over the rest of the frame is stored
+ * in it.
+ */
+static int
+tapif_complete_csum(struct pbuf *p, u16_t start, u16_t offset)
+{
+  struct pbuf *q;
+  u16_t skip, chksum;
+  u32_t acc = 0;
+  int swapped = 0;
+
+  if ((u32_t)start + offset + 2 > p->tot_len) {
+    return -1;
+  }
+  q = pbuf_skip(p, start, &skip);
+  for (; q != NULL; q = q->next, skip = 0) {
+    u16_t len = (u16_t)(q->len - skip);
+    acc += (u16_t)~inet_chksum((u8_t *)q->payload + skip, len);
+    acc = FOLD_U32T(acc);
+    if (len % 2 != 0) {
+      swapped = !swapped;
+      acc = SWAP_BYTES_IN_WORD(acc);
+    }
+  }
+  if (swapped) {
+    acc = SWAP_BYTES_IN_WORD(acc);
+  }
+  chksum = (u16_t)~(acc & 0xffffUL);
+  return pbuf_take_at(p, &chksum, sizeof(chksum), (u16_t)(start + offset)) == ERR_OK ? 0 : -1;
+}
+#endif /* TAPIF_VNET_HDR */
+/*-----------------------------------------------------------------------------------*/
 /*
  * low_level_input():
  *
  * Should allocate a pbuf and transfer the bytes of the incoming
  * packet from the interface into the pbuf.
  *
+ * The frame is read straight into pool pbufs, they are allocated in
+ * advance and only the ones used by a frame are replaced. If the pool
+ * runs low, the frame is read into the pbufs there are and only dropped
+ * if it does not fit.
+ * Returns 0 if no frame is waiting, 1 if a frame has been read (*pp is
+ * NULL if it has been dropped).
  */
 /*-----------------------------------------------------------------------------------*/
-static struct pbuf *
-low_level_input(struct netif *netif)
+static int
+low_level_input(struct tapif_queue *queue, struct pbuf **pp)
 {
+  struct netif *netif = queue->netif;
   struct pbuf *p;
-  u16_t len;
+  struct iovec iov[2 + TAPIF_RX_PBUFS];
+  char buf[1]; /* tells if the frame did not fit into the pbufs */
+  int cnt = 0, nbufs, used, i;
+  u16_t len, rem;
   ssize_t readlen;
-  char buf[1518]; /* max packet size including VLAN excluding CRC */
-  struct tapif *tapif = (struct tapif *)netif->state;
+#if TAPIF_VNET_HDR
+  struct virtio_net_hdr hdr;
+
+  iov[cnt].iov_base = &hdr;
+  iov[cnt].iov_len = sizeof(hdr);
+  cnt++;
+#endif /* TAPIF_VNET_HDR */
+  LWIP_UNUSED_ARG(netif); /* only used for MIB2 stats */
+
+  /* the pbufs are kept in order, so the ones there are come first */
+  for (nbufs = 0; nbufs < TAPIF_RX_PBUFS; nbufs++) {
+    if (queue->rx_pbufs[nbufs] == NULL) {
+      queue->rx_pbufs[nbufs] = pbuf_alloc(PBUF_RAW, PBUF_POOL_BUFSIZE, PBUF_POOL);
+      if (queue->rx_pbufs[nbufs] == NULL) {
+        break;
+      }
+    }
+    iov[cnt].iov_base = queue->rx_pbufs[nbufs]->payload;
+    iov[cnt].iov_len = PBUF_POOL_BUFSIZE;
+    cnt++;
+  }
+  iov[cnt].iov_base = buf;
+  iov[cnt].iov_len = sizeof(buf);
+  cnt++;
+  *pp = NULL;
 
   /* Obtain the size of the packet and put it into the "len"
      variable. */
-  readlen = read(tapif->fd, buf, sizeof(buf));
+  readlen = readv(queue->fd, iov, cnt);
   if (readlen < 0) {
+    if (errno == EAGAIN || errno == EINTR) {
+      return 0;
+    }
     perror("read returned -1");
     exit(1);
   }
-  len = (u16_t)readlen;
+  if (readlen <= (ssize_t)TAPIF_HDR_LEN || readlen - TAPIF_HDR_LEN > 0xffff) {
+    /* empty frame, or too large for a pbuf chain */
+    MIB2_STATS_NETIF_INC(netif, ifindiscards);
+    return 1;
+  }
+  len = (u16_t)(readlen - TAPIF_HDR_LEN);
 
   MIB2_STATS_NETIF_ADD(netif, ifinoctets, len);
 
+  if (len > nbufs * PBUF_POOL_BUFSIZE) {
+    /* drop packet(); */
+    MIB2_STATS_NETIF_INC(netif, ifindiscards);
+    LWIP_DEBUGF(NETIF_DEBUG, ("tapif_input: could not allocate pbuf\n"));
+    return 1;
+  }
+
 #if 0
   if (((double)rand()/(double)RAND_MAX) < 0.2) {
     printf("drop\n");
-    return NULL;
+    return 1;
   }
 #endif
 
-  /* We allocate a pbuf chain of pbufs from the pool. */
-  p = pbuf_alloc(PBUF_RAW, len, PBUF_POOL);
-  if (p != NULL) {
-    pbuf_take(p, buf, len);
-    /* acknowledge that packet has been read(); */
-  } else {
-    /* drop packet(); */
+  /* chain the pbufs holding the frame, the others are kept for the next one */
+  used = (len + PBUF_POOL_BUFSIZE - 1) / PBUF_POOL_BUFSIZE;
+  rem = len;
+  for (i = 0; i < used; i++) {
+    struct pbuf *q = queue->rx_pbufs[i];
+    q->tot_len = rem;
+    q->len = (u16_t)LWIP_MIN(rem, PBUF_POOL_BUFSIZE);
+    q->next = (i + 1 < used) ? queue->rx_pbufs[i + 1] : NULL;
+    rem = (u16_t)(rem - q->len);
+  }
+  p = queue->rx_pbufs[0];
+  memmove(&queue->rx_pbufs[0], &queue->rx_pbufs[used], (TAPIF_RX_PBUFS - used) * sizeof(struct pbuf *));
+  memset(&queue->rx_pbufs[TAPIF_RX_PBUFS - used], 0, used * sizeof(struct pbuf *));
+
+#if TAPIF_VNET_HDR
+  if ((hdr.flags & VIRTIO_NET_HDR_F_NEEDS_CSUM) &&
+      tapif_complete_csum(p, hdr.csum_start, hdr.csum_offset) != 0) {
     MIB2_STATS_NETIF_INC(netif, ifindiscards);
-    LWIP_DEBUGF(NETIF_DEBUG, ("tapif_input: could not allocate pbuf\n"));
+    LWIP_DEBUGF(TAPIF_DEBUG, ("tapif_input: bad checksum offsets\n"));
+    pbuf_free(p);
+    return 1;
   }
+#endif /* TAPIF_VNET_HDR */
 
-  return p;
+  *pp = p;
+  return 1;
 }
 
 /*-----------------------------------------------------------------------------------*/
@@ -308,24 +544,34 @@ low_level_input(struct netif *netif)
  * should handle the actual reception of bytes from the network
  * interface.
  *
+ * Up to TAPIF_RX_BATCH frames are passed on, until no frame is waiting.
+ *
  */
 /*-----------------------------------------------------------------------------------*/
 static void
-tapif_input(struct netif *netif)
+tapif_input(struct tapif_queue *queue)
 {
-  struct pbuf *p = low_level_input(netif);
+  struct netif *netif = queue->netif;
+  struct pbuf *p;
+  int i;
+
+  for (i = 0; i < TAPIF_RX_BATCH; i++) {
+    if (!low_level_input(queue, &p)) {
+      return;
+    }
 
-  if (p == NULL) {
+    if (p == NULL) {
 #if LINK_STATS
-    LINK_STATS_INC(link.recv);
+      LINK_STATS_INC(link.recv);
 #endif /* LINK_STATS */
-    LWIP_DEBUGF(TAPIF_DEBUG, ("tapif_input: low_level_input returned NULL\n"));
-    return;
-  }
+      LWIP_DEBUGF(TAPIF_DEBUG, ("tapif_input: low_level_input returned NULL\n"));
+      continue;
+    }
 
-  if (netif->input(p, netif) != ERR_OK) {
-    LWIP_DEBUGF(NETIF_DEBUG, ("tapif_input: netif input error\n"));
-    pbuf_free(p);
+    if (netif->input(p, netif) != ERR_OK) {
+      LWIP_DEBUGF(NETIF_DEBUG, ("tapif_input: netif input error\n"));
+      pbuf_free(p);
+    }
   }
 }
 /*-----------------------------------------------------------------------------------*/
@@ -347,6 +593,7 @@ tapif_init(struct netif *netif)
     LWIP_DEBUGF(NETIF_DEBUG, ("tapif_init: out of memory for tapif\n"));
     return ERR_MEM;
   }
+  memset(tapif, 0, sizeof(struct tapif));
   netif->state = tapif;
   MIB2_INIT_NETIF(netif, snmp_ifType_other, 100000000);
 
@@ -371,7 +618,8 @@ tapif_init(struct netif *netif)
 void
 tapif_poll(struct netif *netif)
 {
-  tapif_input(netif);
+  struct tapif *tapif = (struct tapif *)netif->state;
+  tapif_input(&tapif->queues[0]);
 }
 
 #if NO_SYS
@@ -391,11 +639,11 @@ tapif_select(struct netif *netif)
   tv.tv_usec = (msecs % 1000) * 1000;
 
   FD_ZERO(&fdset);
-  FD_SET(tapif->fd, &fdset);
+  FD_SET(tapif->queues[0].fd, &fdset);
 
-  ret = select(tapif->fd + 1, &fdset, NULL, NULL, &tv);
+  ret = select(tapif->queues[0].fd + 1, &fdset, NULL, NULL, &tv);
   if (ret > 0) {
-    tapif_input(netif);
+    tapif_input(&tapif->queues[0]);
   }
   return ret;
 }
@@ -405,24 +653,22 @@ tapif_select(struct netif *netif)
 static void
 tapif_thread(void *arg)
 {
-  struct netif *netif;
-  struct tapif *tapif;
+  struct tapif_queue *queue;
   fd_set fdset;
   int ret;
 
-  netif = (struct netif *)arg;
-  tapif = (struct tapif *)netif->state;
+  queue = (struct tapif_queue *)arg;
 
   while(1) {
     FD_ZERO(&fdset);
-    FD_SET(tapif->fd, &fdset);
+    FD_SET(queue->fd, &fdset);
 
     /* Wait for a packet to arrive. */
-    ret = select(tapif->fd + 1, &fdset, NULL, NULL, NULL);
+    ret = select(queue->fd + 1, &fdset, NULL, NULL, NULL);
 
     if(ret == 1) {
-      /* Handle incoming packet. */
-      tapif_input(netif);
+      /* Handle incoming packets. */
+      tapif_input(queue);
     } else if(ret == -1) {
       perror("tapif_thread: select");
     }
@@ -125,6 +125,7 @@ set(lwipppp_SRCS
     ${LWIP_DIR}/src/netif/ppp/ipv6cp.c
     ${LWIP_DIR}/src/netif/ppp/lcp.c
     ${LWIP_DIR}/src/netif/ppp/magic.c
+    ${LWIP_DIR}/src/netif/ppp/mlppp.c
     ${LWIP_DIR}/src/netif/ppp/mppe.c
     ${LWIP_DIR}/src/netif/ppp/multilink.c
     ${LWIP_DIR}/src/netif/ppp/ppp.c
@@ -174,6 +175,7 @@ set(lwiphttp_SRCS
     ${LWIP_DIR}/src/apps/http/fs.c
     ${LWIP_DIR}/src/apps/http/http_client.c
     ${LWIP_DIR}/src/apps/http/httpd.c
+    ${LWIP_DIR}/src/apps/http/httpd_ws.c
 )
 
 # MAKEFSDATA HTTP server host utility
@@ -201,6 +203,7 @@ set(lwipmdns_SRCS
     ${LWIP_DIR}/src/apps/mdns/mdns.c
     ${LWIP_DIR}/src/apps/mdns/mdns_out.c
     ${LWIP_DIR}/src/apps/mdns/mdns_domain.c
+    ${LWIP_DIR}/src/apps/mdns/mdns_query.c
 )
 
 # NetBIOS name server
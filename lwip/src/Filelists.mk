@@ -109,6 +109,7 @@ PPPFILES=$(LWIPDIR)/netif/ppp/auth.c \
 	$(LWIPDIR)/netif/ppp/ipv6cp.c \
 	$(LWIPDIR)/netif/ppp/lcp.c \
 	$(LWIPDIR)/netif/ppp/magic.c \
+	$(LWIPDIR)/netif/ppp/mlppp.c \
 	$(LWIPDIR)/netif/ppp/mppe.c \
 	$(LWIPDIR)/netif/ppp/multilink.c \
 	$(LWIPDIR)/netif/ppp/ppp.c \
@@ -162,7 +163,8 @@ SNMPFILES=$(LWIPDIR)/apps/snmp/snmp_asn1.c \
 HTTPFILES=$(LWIPDIR)/apps/http/altcp_proxyconnect.c \
 	$(LWIPDIR)/apps/http/fs.c \
 	$(LWIPDIR)/apps/http/http_client.c \
-	$(LWIPDIR)/apps/http/httpd.c
+	$(LWIPDIR)/apps/http/httpd.c \
+	$(LWIPDIR)/apps/http/httpd_ws.c
 
 # MAKEFSDATA: MAKEFSDATA HTTP server host utility
 MAKEFSDATAFILES=$(LWIPDIR)/apps/http/makefsdata/makefsdata.c
@@ -179,7 +181,8 @@ SNTPFILES=$(LWIPDIR)/apps/sntp/sntp.c
 # MDNSFILES: MDNS responder
 MDNSFILES=$(LWIPDIR)/apps/mdns/mdns.c \
 	$(LWIPDIR)/apps/mdns/mdns_out.c \
-	$(LWIPDIR)/apps/mdns/mdns_domain.c
+	$(LWIPDIR)/apps/mdns/mdns_domain.c \
+	$(LWIPDIR)/apps/mdns/mdns_query.c
 
 # NETBIOSNSFILES: NetBIOS name server
 NETBIOSNSFILES=$(LWIPDIR)/apps/netbiosns/netbiosns.c
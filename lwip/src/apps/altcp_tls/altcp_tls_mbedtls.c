@@ -60,6 +60,7 @@
 #include "lwip/altcp.h"
 #include "lwip/altcp_tls.h"
 #include "lwip/priv/altcp_priv.h"
+#include "lwip/sys.h"
 
 #include "altcp_tls_mbedtls_structs.h"
 #include "altcp_tls_mbedtls_mem.h"
@@ -93,6 +94,25 @@
    since it contains pointers to static functions declared here */
 extern const struct altcp_functions altcp_mbedtls_functions;
 
+#if ALTCP_MBEDTLS_USE_CLIENT_SESSION_CACHE
+/** Client session cache entry: session saved for one server */
+struct altcp_mbedtls_session_entry {
+  mbedtls_ssl_session session;
+  /** Server address, only compared if host_hash is 0 (no server name set) */
+  ip_addr_t addr;
+  /** Hash of the server name, compared before the name itself */
+  u32_t host_hash;
+  /** Server name in lower case */
+  char host[ALTCP_MBEDTLS_CLIENT_SESSION_HOST_LEN + 1];
+  /** Hash of the master secret, a resumed session keeps it */
+  u32_t master_hash;
+  /** sys_now() when the session was saved */
+  u32_t saved;
+  u16_t port;
+  u8_t used;
+};
+#endif /* ALTCP_MBEDTLS_USE_CLIENT_SESSION_CACHE */
+
 /** Our global mbedTLS configuration (server-specific, not connection-specific) */
 struct altcp_tls_config {
   mbedtls_ssl_config conf;
@@ -112,6 +132,15 @@ struct altcp_tls_config {
 #if defined(MBEDTLS_SSL_SESSION_TICKETS) && ALTCP_MBEDTLS_USE_SESSION_TICKETS
   mbedtls_ssl_ticket_context ticket_ctx;
 #endif
+#if ALTCP_MBEDTLS_USE_CLIENT_SESSION_CACHE
+  /** Sessions of servers connected to (NULL for server configurations) */
+  struct altcp_mbedtls_session_entry *session_cache;
+#if defined(MBEDTLS_SSL_EXPORT_KEYS)
+  /** Connection in mbedtls_ssl_handshake() (for the key export callback) */
+  altcp_mbedtls_state_t *handshake_state;
+#endif
+#endif
+  struct altcp_tls_handshake_stats stats;
 };
 
 static err_t altcp_mbedtls_lower_recv(void *arg, struct altcp_pcb *inner_conn, struct pbuf *p, err_t err);
@@ -119,6 +148,8 @@ static err_t altcp_mbedtls_setup(void *conf, struct altcp_pcb *conn, struct altc
 static err_t altcp_mbedtls_lower_recv_process(struct altcp_pcb *conn, altcp_mbedtls_state_t *state);
 static err_t altcp_mbedtls_handle_rx_appldata(struct altcp_pcb *conn, altcp_mbedtls_state_t *state);
 static int altcp_mbedtls_bio_send(void *ctx, const unsigned char *dataptr, size_t size);
+static void altcp_mbedtls_flush_tx(struct altcp_pcb *conn, altcp_mbedtls_state_t *state);
+static err_t altcp_mbedtls_close_inner(struct altcp_pcb *conn);
 
 
 /* callback functions from inner/lower connection: */
@@ -213,6 +244,14 @@ altcp_mbedtls_lower_recv(void *arg, struct altcp_pcb *inner_conn, struct pbuf *p
     altcp_close(inner_conn);
     return ERR_CLSD;
   }
+  if (state->flags & ALTCP_MBEDTLS_FLAGS_CLOSE_PENDING) {
+    /* closed by the application, waiting for tx data to be sent */
+    if (p != NULL) {
+      altcp_recved(inner_conn, p->tot_len);
+      pbuf_free(p);
+    }
+    return ERR_OK;
+  }
 
   /* handle NULL pbuf (inner connection closed) */
   if (p == NULL) {
@@ -252,12 +291,228 @@ altcp_mbedtls_lower_recv(void *arg, struct altcp_pcb *inner_conn, struct pbuf *p
   return altcp_mbedtls_lower_recv_process(conn, state);
 }
 
+#if ALTCP_MBEDTLS_USE_CLIENT_SESSION_CACHE
+/* Server name set with mbedtls_ssl_set_hostname() or NULL */
+static const char *
+altcp_mbedtls_session_host(altcp_mbedtls_state_t *state)
+{
+#if defined(MBEDTLS_X509_CRT_PARSE_C)
+  return state->ssl_context.hostname;
+#else
+  LWIP_UNUSED_ARG(state);
+  return NULL;
+#endif
+}
+
+/* Set the client session cache key of a connection */
+static void
+altcp_mbedtls_session_key(altcp_mbedtls_state_t *state, const ip_addr_t *ipaddr, u16_t port)
+{
+  u32_t hash = 0;
+  const char *name = altcp_mbedtls_session_host(state);
+  if (name != NULL) {
+    size_t len = 0;
+    /* FNV-1a */
+    hash = 2166136261UL;
+    for (; *name; name++, len++) {
+      hash = (hash ^ (u8_t)lwip_tolower(*name)) * 16777619UL;
+    }
+    if (hash == 0) {
+      hash = 1;
+    }
+    if (len > ALTCP_MBEDTLS_CLIENT_SESSION_HOST_LEN) {
+      /* name too long to be stored: don't use the cache */
+      port = 0;
+    }
+  }
+  state->host_hash = hash;
+  ip_addr_copy(state->remote_ip, *ipaddr);
+  state->remote_port = port;
+}
+
+/* Check if a cache entry belongs to the server a connection is connected to */
+static int
+altcp_mbedtls_session_match(const struct altcp_mbedtls_session_entry *entry, altcp_mbedtls_state_t *state)
+{
+  if (!entry->used || (entry->port != state->remote_port) || (entry->host_hash != state->host_hash)) {
+    return 0;
+  }
+  if (state->host_hash == 0) {
+    return ip_addr_cmp(&entry->addr, &state->remote_ip);
+  }
+  /* the hash only filters: names may collide */
+  return lwip_stricmp(entry->host, altcp_mbedtls_session_host(state)) == 0;
+}
+
+/* Find the cache entry of the server a connection is connected to */
+static struct altcp_mbedtls_session_entry *
+altcp_mbedtls_session_find(struct altcp_tls_config *conf, altcp_mbedtls_state_t *state)
+{
+  int i;
+  if ((conf->session_cache == NULL) || (state->remote_port == 0)) {
+    return NULL;
+  }
+  for (i = 0; i < ALTCP_MBEDTLS_CLIENT_SESSION_CACHE_SIZE; i++) {
+    struct altcp_mbedtls_session_entry *entry = &conf->session_cache[i];
+    if (altcp_mbedtls_session_match(entry, state)) {
+      if ((u32_t)(sys_now() - entry->saved) > ALTCP_MBEDTLS_SESSION_CACHE_TIMEOUT_SECONDS * 1000UL) {
+        /* expired */
+        mbedtls_ssl_session_free(&entry->session);
+        entry->used = 0;
+        return NULL;
+      }
+      return entry;
+    }
+  }
+  return NULL;
+}
+
+/* Offer the saved session of the server to connect to */
+static void
+altcp_mbedtls_session_restore(struct altcp_tls_config *conf, altcp_mbedtls_state_t *state,
+                              const ip_addr_t *ipaddr, u16_t port)
+{
+  struct altcp_mbedtls_session_entry *entry;
+
+  altcp_mbedtls_session_key(state, ipaddr, port);
+  entry = altcp_mbedtls_session_find(conf, state);
+  if (entry != NULL) {
+    int ret = mbedtls_ssl_set_session(&state->ssl_context, &entry->session);
+    if (ret != 0) {
+      LWIP_DEBUGF(ALTCP_MBEDTLS_DEBUG, ("mbedtls_ssl_set_session failed: %d\n", ret));
+    }
+  }
+}
+
+/* Save the session negotiated with the server.
+ * Returns 1 if the handshake resumed the session saved before. */
+static int
+altcp_mbedtls_session_save(struct altcp_tls_config *conf, altcp_mbedtls_state_t *state)
+{
+  int i;
+  int resumed = 0;
+  struct altcp_mbedtls_session_entry *entry = altcp_mbedtls_session_find(conf, state);
+
+  if (conf->session_cache == NULL) {
+    return 0;
+  }
+  if (entry != NULL) {
+    /* an abbreviated handshake keeps the master secret */
+    resumed = (state->master_hash != 0) && (state->master_hash == entry->master_hash);
+  } else {
+    /* take a free entry or the oldest one */
+    entry = &conf->session_cache[0];
+    for (i = 0; i < ALTCP_MBEDTLS_CLIENT_SESSION_CACHE_SIZE; i++) {
+      struct altcp_mbedtls_session_entry *e = &conf->session_cache[i];
+      if (!e->used) {
+        entry = e;
+        break;
+      }
+      if ((u32_t)(sys_now() - e->saved) > (u32_t)(sys_now() - entry->saved)) {
+        entry = e;
+      }
+    }
+  }
+
+  /* (re)save the session, a resumed session might come with a new ticket */
+  if (entry->used) {
+    mbedtls_ssl_session_free(&entry->session);
+  }
+  mbedtls_ssl_session_init(&entry->session);
+  entry->used = 0;
+  if (mbedtls_ssl_get_session(&state->ssl_context, &entry->session) == 0) {
+    const char *name = altcp_mbedtls_session_host(state);
+    ip_addr_copy(entry->addr, state->remote_ip);
+    entry->host_hash = state->host_hash;
+    for (i = 0; (name != NULL) && (name[i] != 0); i++) {
+      LWIP_ASSERT("name length checked on connect", i < ALTCP_MBEDTLS_CLIENT_SESSION_HOST_LEN);
+      entry->host[i] = (char)lwip_tolower(name[i]);
+    }
+    entry->host[i] = 0;
+    entry->master_hash = state->master_hash;
+    entry->port = state->remote_port;
+    entry->saved = sys_now();
+    entry->used = 1;
+  } else {
+    mbedtls_ssl_session_free(&entry->session);
+  }
+  return resumed;
+}
+
+#if defined(MBEDTLS_SSL_EXPORT_KEYS)
+/* Key export callback: store a hash of the master secret of the connection in
+ * mbedtls_ssl_handshake() to tell resumed sessions (same secret) from new ones */
+static int
+altcp_mbedtls_export_keys(void *p_expkey, const unsigned char *ms, const unsigned char *kb,
+                          size_t maclen, size_t keylen, size_t ivlen)
+{
+  struct altcp_tls_config *conf = (struct altcp_tls_config *)p_expkey;
+  LWIP_UNUSED_ARG(kb);
+  LWIP_UNUSED_ARG(maclen);
+  LWIP_UNUSED_ARG(keylen);
+  LWIP_UNUSED_ARG(ivlen);
+  if (conf->handshake_state != NULL) {
+    /* FNV-1a over the 48 bytes of the master secret */
+    u32_t hash = 2166136261UL;
+    int i;
+    for (i = 0; i < 48; i++) {
+      hash = (hash ^ ms[i]) * 16777619UL;
+    }
+    conf->handshake_state->master_hash = (hash != 0) ? hash : 1;
+  }
+  return 0;
+}
+#endif /* MBEDTLS_SSL_EXPORT_KEYS */
+
+/* Remove the session of a server (e.g. after a failed handshake) */
+static void
+altcp_mbedtls_session_remove(struct altcp_tls_config *conf, altcp_mbedtls_state_t *state)
+{
+  struct altcp_mbedtls_session_entry *entry = altcp_mbedtls_session_find(conf, state);
+  if (entry != NULL) {
+    mbedtls_ssl_session_free(&entry->session);
+    entry->used = 0;
+  }
+}
+#endif /* ALTCP_MBEDTLS_USE_CLIENT_SESSION_CACHE */
+
+/* Handshake succeeded: update the client session cache and statistics */
+static void
+altcp_mbedtls_handshake_done(struct altcp_tls_config *conf, altcp_mbedtls_state_t *state)
+{
+  int resumed = 0;
+#if ALTCP_MBEDTLS_USE_CLIENT_SESSION_CACHE
+  if (state->remote_port != 0) {
+    resumed = altcp_mbedtls_session_save(conf, state);
+  }
+#endif
+  if (resumed) {
+    conf->stats.resumed++;
+    conf->stats.resumed_ms += state->handshake_ms;
+  } else {
+    conf->stats.full++;
+    conf->stats.full_ms += state->handshake_ms;
+  }
+  LWIP_DEBUGF(ALTCP_MBEDTLS_DEBUG, ("altcp_tls: %s handshake done in %"U32_F" ms\n",
+                                    resumed ? "abbreviated" : "full", state->handshake_ms));
+}
+
 static err_t
 altcp_mbedtls_lower_recv_process(struct altcp_pcb *conn, altcp_mbedtls_state_t *state)
 {
   if (!(state->flags & ALTCP_MBEDTLS_FLAGS_HANDSHAKE_DONE)) {
     /* handle connection setup (handshake not done) */
-    int ret = mbedtls_ssl_handshake(&state->ssl_context);
+    u32_t start = sys_now();
+    int ret;
+#if ALTCP_MBEDTLS_USE_CLIENT_SESSION_CACHE && defined(MBEDTLS_SSL_EXPORT_KEYS)
+    struct altcp_tls_config *conf = (struct altcp_tls_config *)state->conf;
+    conf->handshake_state = state;
+#endif
+    ret = mbedtls_ssl_handshake(&state->ssl_context);
+#if ALTCP_MBEDTLS_USE_CLIENT_SESSION_CACHE && defined(MBEDTLS_SSL_EXPORT_KEYS)
+    conf->handshake_state = NULL;
+#endif
+    state->handshake_ms += sys_now() - start;
     /* try to send data... */
     altcp_output(conn->inner_conn);
     if (state->bio_bytes_read) {
@@ -273,6 +528,10 @@ altcp_mbedtls_lower_recv_process(struct altcp_pcb *conn, altcp_mbedtls_state_t *
     }
     if (ret != 0) {
       LWIP_DEBUGF(ALTCP_MBEDTLS_DEBUG, ("mbedtls_ssl_handshake failed: %d\n", ret));
+#if ALTCP_MBEDTLS_USE_CLIENT_SESSION_CACHE
+      /* don't offer a session the server might have refused again */
+      altcp_mbedtls_session_remove((struct altcp_tls_config *)state->conf, state);
+#endif
       /* handshake failed, connection has to be closed */
       if (conn->err) {
         conn->err(conn->arg, ERR_CLSD);
@@ -287,6 +546,7 @@ altcp_mbedtls_lower_recv_process(struct altcp_pcb *conn, altcp_mbedtls_state_t *
     LWIP_ASSERT("state", state->bio_bytes_read == 0);
     LWIP_ASSERT("state", state->bio_bytes_appl == 0);
     state->flags |= ALTCP_MBEDTLS_FLAGS_HANDSHAKE_DONE;
+    altcp_mbedtls_handshake_done((struct altcp_tls_config *)state->conf, state);
     /* issue "connect" callback" to upper connection (this can only happen for active open) */
     if (conn->connected) {
       err_t err;
@@ -353,6 +613,45 @@ altcp_mbedtls_pass_rx_data(struct altcp_pcb *conn, altcp_mbedtls_state_t *state)
   return ERR_OK;
 }
 
+/* Read the rest of the record decrypted by the last mbedtls_ssl_read() into a pbuf
+ * chain appended to 'buf', so that a record is passed to the application in one piece.
+ * Returns the number of bytes read.
+ */
+static int
+altcp_mbedtls_read_record_rest(altcp_mbedtls_state_t *state, struct pbuf *buf)
+{
+  struct pbuf *rest, *q;
+  int read = 0;
+  size_t avail = mbedtls_ssl_get_bytes_avail(&state->ssl_context);
+
+  avail = LWIP_MIN(avail, (size_t)(0xFFFF - buf->tot_len));
+  if (avail == 0) {
+    return 0;
+  }
+  rest = pbuf_alloc(PBUF_RAW, (u16_t)avail, PBUF_POOL);
+  if (rest == NULL) {
+    /* read the rest into the next pbuf */
+    return 0;
+  }
+  for (q = rest; q != NULL; q = q->next) {
+    /* the record is decrypted already, so this only copies */
+    int ret = mbedtls_ssl_read(&state->ssl_context, (unsigned char *)q->payload, q->len);
+    if (ret > 0) {
+      read += ret;
+    }
+    if (ret != q->len) {
+      break;
+    }
+  }
+  if (read == 0) {
+    pbuf_free(rest);
+    return 0;
+  }
+  pbuf_realloc(rest, (u16_t)read);
+  pbuf_cat(buf, rest);
+  return read;
+}
+
 /* Helper function that processes rx application data stored in rx pbuf chain */
 static err_t
 altcp_mbedtls_handle_rx_appldata(struct altcp_pcb *conn, altcp_mbedtls_state_t *state)
@@ -400,6 +699,7 @@ altcp_mbedtls_handle_rx_appldata(struct altcp_pcb *conn, altcp_mbedtls_state_t *
         LWIP_ASSERT("bogus receive length", ret <= PBUF_POOL_BUFSIZE);
         /* trim pool pbuf to actually decoded length */
         pbuf_realloc(buf, (u16_t)ret);
+        ret += altcp_mbedtls_read_record_rest(state, buf);
 
         state->bio_bytes_appl += ret;
         if (mbedtls_ssl_get_bytes_avail(&state->ssl_context) == 0) {
@@ -490,6 +790,29 @@ altcp_mbedtls_bio_recv(void *ctx, unsigned char *buf, size_t len)
   return ret;
 }
 
+/* Pass a record waiting in the mbedTLS output buffer on to the inner connection.
+ * Returns 1 if the record is still waiting.
+ */
+static int
+altcp_mbedtls_flush_output(altcp_mbedtls_state_t *state)
+{
+  if (state->flags & ALTCP_MBEDTLS_FLAGS_TX_PENDING) {
+    mbedtls_ssl_flush_output(&state->ssl_context);
+  }
+  return (state->flags & ALTCP_MBEDTLS_FLAGS_TX_PENDING) ? 1 : 0;
+}
+
+/* Close a connection closed by the application once its tx data is passed on
+ * to the inner connection */
+static void
+altcp_mbedtls_close_pending(struct altcp_pcb *conn, altcp_mbedtls_state_t *state)
+{
+  if ((state->tx == NULL) && !(state->flags & ALTCP_MBEDTLS_FLAGS_TX_PENDING)) {
+    /* if this fails, it is retried from the poll callback */
+    altcp_mbedtls_close_inner(conn);
+  }
+}
+
 /** Sent callback from lower connection (i.e. TCP)
  * This only informs the upper layer to try to send more, not about
  * the number of ACKed bytes.
@@ -508,7 +831,12 @@ altcp_mbedtls_lower_sent(void *arg, struct altcp_pcb *inner_conn, u16_t len)
       return ERR_OK;
     }
     /* try to send more if we failed before */
-    mbedtls_ssl_flush_output(&state->ssl_context);
+    altcp_mbedtls_flush_output(state);
+    altcp_mbedtls_flush_tx(conn, state);
+    if (state->flags & ALTCP_MBEDTLS_FLAGS_CLOSE_PENDING) {
+      altcp_mbedtls_close_pending(conn, state);
+      return ERR_OK;
+    }
     /* call upper sent with len==0 if the application already sent data */
     if ((state->flags & ALTCP_MBEDTLS_FLAGS_APPLDATA_SENT) && conn->sent) {
       return conn->sent(conn->arg, conn, 0);
@@ -532,7 +860,12 @@ altcp_mbedtls_lower_poll(void *arg, struct altcp_pcb *inner_conn)
     if (conn->state) {
       altcp_mbedtls_state_t *state = (altcp_mbedtls_state_t *)conn->state;
       /* try to send more if we failed before */
-      mbedtls_ssl_flush_output(&state->ssl_context);
+      altcp_mbedtls_flush_output(state);
+      altcp_mbedtls_flush_tx(conn, state);
+      if (state->flags & ALTCP_MBEDTLS_FLAGS_CLOSE_PENDING) {
+        altcp_mbedtls_close_pending(conn, state);
+        return ERR_OK;
+      }
       if (altcp_mbedtls_handle_rx_appldata(conn, state) == ERR_ABRT) {
         return ERR_ABRT;
       }
@@ -676,6 +1009,11 @@ altcp_tls_create_config(int is_server, u8_t cert_count, u8_t pkey_count, int hav
   altcp_mbedtls_mem_init();
 
   sz = sizeof(struct altcp_tls_config);
+#if ALTCP_MBEDTLS_USE_CLIENT_SESSION_CACHE
+  if (!is_server) {
+    sz += ALTCP_MBEDTLS_CLIENT_SESSION_CACHE_SIZE * sizeof(struct altcp_mbedtls_session_entry);
+  }
+#endif
   if (cert_count > 0) {
     sz += (cert_count * sizeof(mbedtls_x509_crt));
   }
@@ -692,6 +1030,16 @@ altcp_tls_create_config(int is_server, u8_t cert_count, u8_t pkey_count, int hav
   }
   conf->cert_max = cert_count;
   mem = (mbedtls_x509_crt *)(conf + 1);
+#if ALTCP_MBEDTLS_USE_CLIENT_SESSION_CACHE
+  if (!is_server) {
+    int i;
+    conf->session_cache = (struct altcp_mbedtls_session_entry *)mem;
+    for (i = 0; i < ALTCP_MBEDTLS_CLIENT_SESSION_CACHE_SIZE; i++) {
+      mbedtls_ssl_session_init(&conf->session_cache[i].session);
+    }
+    mem = (mbedtls_x509_crt *)(conf->session_cache + ALTCP_MBEDTLS_CLIENT_SESSION_CACHE_SIZE);
+  }
+#endif
   if (cert_count > 0) {
     conf->cert = mem;
     mem += cert_count;
@@ -728,6 +1076,11 @@ altcp_tls_create_config(int is_server, u8_t cert_count, u8_t pkey_count, int hav
   mbedtls_ssl_conf_authmode(&conf->conf, MBEDTLS_SSL_VERIFY_OPTIONAL);
 
   mbedtls_ssl_conf_rng(&conf->conf, mbedtls_ctr_drbg_random, &conf->ctr_drbg);
+#if ALTCP_MBEDTLS_USE_CLIENT_SESSION_CACHE && defined(MBEDTLS_SSL_EXPORT_KEYS)
+  if (!is_server) {
+    mbedtls_ssl_conf_export_keys_cb(&conf->conf, altcp_mbedtls_export_keys, conf);
+  }
+#endif
 #if ALTCP_MBEDTLS_LIB_DEBUG != LWIP_DBG_OFF
   mbedtls_ssl_conf_dbg(&conf->conf, altcp_mbedtls_debug, stdout);
 #endif
@@ -740,8 +1093,11 @@ altcp_tls_create_config(int is_server, u8_t cert_count, u8_t pkey_count, int hav
 #if defined(MBEDTLS_SSL_SESSION_TICKETS) && ALTCP_MBEDTLS_USE_SESSION_TICKETS
   mbedtls_ssl_ticket_init(&conf->ticket_ctx);
 
+  /* memory of the configuration is not taken from the pools of the connections */
+  altcp_mbedtls_mem_config_begin();
   ret = mbedtls_ssl_ticket_setup(&conf->ticket_ctx, mbedtls_ctr_drbg_random, &conf->ctr_drbg,
     ALTCP_MBEDTLS_SESSION_TICKET_CIPHER, ALTCP_MBEDTLS_SESSION_TICKET_TIMEOUT_SECONDS);
+  altcp_mbedtls_mem_config_end();
   if (ret) {
     LWIP_DEBUGF(ALTCP_MBEDTLS_DEBUG, ("mbedtls_ssl_ticket_setup failed: %d\n", ret));
     altcp_mbedtls_free_config(conf);
@@ -790,20 +1146,26 @@ err_t altcp_tls_config_server_add_privkey_cert(struct altcp_tls_config *config,
   mbedtls_pk_init(pkey);
 
   /* Load the certificates and private key */
+  altcp_mbedtls_mem_config_begin();
   ret = mbedtls_x509_crt_parse(srvcert, cert, cert_len);
+  altcp_mbedtls_mem_config_end();
   if (ret != 0) {
     LWIP_DEBUGF(ALTCP_MBEDTLS_DEBUG, ("mbedtls_x509_crt_parse failed: %d\n", ret));
     return ERR_VAL;
   }
 
+  altcp_mbedtls_mem_config_begin();
   ret = mbedtls_pk_parse_key(pkey, (const unsigned char *) privkey, privkey_len, privkey_pass, privkey_pass_len);
+  altcp_mbedtls_mem_config_end();
   if (ret != 0) {
     LWIP_DEBUGF(ALTCP_MBEDTLS_DEBUG, ("mbedtls_pk_parse_public_key failed: %d\n", ret));
     mbedtls_x509_crt_free(srvcert);
     return ERR_VAL;
   }
 
+  altcp_mbedtls_mem_config_begin();
   ret = mbedtls_ssl_conf_own_cert(&config->conf, srvcert, pkey);
+  altcp_mbedtls_mem_config_end();
   if (ret != 0) {
     LWIP_DEBUGF(ALTCP_MBEDTLS_DEBUG, ("mbedtls_ssl_conf_own_cert failed: %d\n", ret));
     mbedtls_x509_crt_free(srvcert);
@@ -853,7 +1215,9 @@ altcp_tls_create_config_client_common(const u8_t *ca, size_t ca_len, int is_2way
    * Without CA certificate, connection will be prone to man-in-the-middle attacks */
   if (ca) {
     mbedtls_x509_crt_init(conf->ca);
+    altcp_mbedtls_mem_config_begin();
     ret = mbedtls_x509_crt_parse(conf->ca, ca, ca_len);
+    altcp_mbedtls_mem_config_end();
     if (ret != 0) {
       LWIP_DEBUGF(ALTCP_MBEDTLS_DEBUG, ("mbedtls_x509_crt_parse ca failed: %d 0x%x", ret, -1*ret));
       altcp_mbedtls_free_config(conf);
@@ -891,7 +1255,9 @@ altcp_tls_create_config_client_2wayauth(const u8_t *ca, size_t ca_len, const u8_
 
   /* Initialize the client certificate and corresponding private key */
   mbedtls_x509_crt_init(conf->cert);
+  altcp_mbedtls_mem_config_begin();
   ret = mbedtls_x509_crt_parse(conf->cert, cert, cert_len);
+  altcp_mbedtls_mem_config_end();
   if (ret != 0) {
     LWIP_DEBUGF(ALTCP_MBEDTLS_DEBUG, ("mbedtls_x509_crt_parse cert failed: %d 0x%x", ret, -1*ret));
     altcp_mbedtls_free_config(conf->cert);
@@ -899,14 +1265,18 @@ altcp_tls_create_config_client_2wayauth(const u8_t *ca, size_t ca_len, const u8_
   }
 
   mbedtls_pk_init(conf->pkey);
+  altcp_mbedtls_mem_config_begin();
   ret = mbedtls_pk_parse_key(conf->pkey, privkey, privkey_len, privkey_pass, privkey_pass_len);
+  altcp_mbedtls_mem_config_end();
   if (ret != 0) {
     LWIP_DEBUGF(ALTCP_MBEDTLS_DEBUG, ("mbedtls_pk_parse_key failed: %d 0x%x", ret, -1*ret));
     altcp_mbedtls_free_config(conf);
     return NULL;
   }
 
+  altcp_mbedtls_mem_config_begin();
   ret = mbedtls_ssl_conf_own_cert(&conf->conf, conf->cert, conf->pkey);
+  altcp_mbedtls_mem_config_end();
   if (ret != 0) {
     LWIP_DEBUGF(ALTCP_MBEDTLS_DEBUG, ("mbedtls_ssl_conf_own_cert failed: %d 0x%x", ret, -1*ret));
     altcp_mbedtls_free_config(conf);
@@ -916,9 +1286,25 @@ altcp_tls_create_config_client_2wayauth(const u8_t *ca, size_t ca_len, const u8_
   return conf;
 }
 
+void
+altcp_tls_get_handshake_stats(struct altcp_tls_config *conf, struct altcp_tls_handshake_stats *stats)
+{
+  LWIP_ASSERT("conf != NULL", conf != NULL);
+  LWIP_ASSERT("stats != NULL", stats != NULL);
+  *stats = conf->stats;
+}
+
 void
 altcp_tls_free_config(struct altcp_tls_config *conf)
 {
+#if ALTCP_MBEDTLS_USE_CLIENT_SESSION_CACHE
+  if (conf->session_cache) {
+    int i;
+    for (i = 0; i < ALTCP_MBEDTLS_CLIENT_SESSION_CACHE_SIZE; i++) {
+      mbedtls_ssl_session_free(&conf->session_cache[i].session);
+    }
+  }
+#endif
   if (conf->pkey) {
     mbedtls_pk_free(conf->pkey);
   }
@@ -928,6 +1314,15 @@ altcp_tls_free_config(struct altcp_tls_config *conf)
   if (conf->ca) {
     mbedtls_x509_crt_free(conf->ca);
   }
+#if defined(MBEDTLS_SSL_CACHE_C) && ALTCP_MBEDTLS_USE_SESSION_CACHE
+  mbedtls_ssl_cache_free(&conf->cache);
+#endif
+#if defined(MBEDTLS_SSL_SESSION_TICKETS) && ALTCP_MBEDTLS_USE_SESSION_TICKETS
+  mbedtls_ssl_ticket_free(&conf->ticket_ctx);
+#endif
+  mbedtls_ssl_config_free(&conf->conf);
+  mbedtls_ctr_drbg_free(&conf->ctr_drbg);
+  mbedtls_entropy_free(&conf->entropy);
   altcp_mbedtls_free_config(conf);
 }
 
@@ -973,6 +1368,12 @@ altcp_mbedtls_connect(struct altcp_pcb *conn, const ip_addr_t *ipaddr, u16_t por
     return ERR_VAL;
   }
   conn->connected = connected;
+#if ALTCP_MBEDTLS_USE_CLIENT_SESSION_CACHE
+  if ((conn->state != NULL) && (ipaddr != NULL)) {
+    altcp_mbedtls_session_restore((struct altcp_tls_config *)((altcp_mbedtls_state_t *)conn->state)->conf,
+                                  (altcp_mbedtls_state_t *)conn->state, ipaddr, port);
+  }
+#endif
   return altcp_connect(conn->inner_conn, ipaddr, port, altcp_mbedtls_lower_connected);
 }
 
@@ -1005,14 +1406,11 @@ altcp_mbedtls_abort(struct altcp_pcb *conn)
   }
 }
 
+/* Close the inner connection and free the connection */
 static err_t
-altcp_mbedtls_close(struct altcp_pcb *conn)
+altcp_mbedtls_close_inner(struct altcp_pcb *conn)
 {
-  struct altcp_pcb *inner_conn;
-  if (conn == NULL) {
-    return ERR_VAL;
-  }
-  inner_conn = conn->inner_conn;
+  struct altcp_pcb *inner_conn = conn->inner_conn;
   if (inner_conn) {
     err_t err;
     altcp_poll_fn oldpoll = inner_conn->poll;
@@ -1031,6 +1429,36 @@ altcp_mbedtls_close(struct altcp_pcb *conn)
   return ERR_OK;
 }
 
+static err_t
+altcp_mbedtls_close(struct altcp_pcb *conn)
+{
+  if (conn == NULL) {
+    return ERR_VAL;
+  }
+  if ((conn->inner_conn != NULL) && (conn->state != NULL)) {
+    altcp_mbedtls_state_t *state = (altcp_mbedtls_state_t *)conn->state;
+    /* send coalesced data before closing */
+    altcp_mbedtls_flush_output(state);
+    altcp_mbedtls_flush_tx(conn, state);
+    if ((state->tx != NULL) || (state->flags & ALTCP_MBEDTLS_FLAGS_TX_PENDING)) {
+      /* inner connection is full: like tcp_close(), send the data before closing.
+         The application must not use the connection any more, so the sent/poll
+         callbacks send the rest and close the inner connection. */
+      state->flags |= ALTCP_MBEDTLS_FLAGS_CLOSE_PENDING;
+      conn->arg = NULL;
+      conn->recv = NULL;
+      conn->sent = NULL;
+      conn->err = NULL;
+      conn->connected = NULL;
+      /* poll every 2 seconds in case no ACK arrives */
+      altcp_poll(conn, NULL, 4);
+      altcp_output(conn->inner_conn);
+      return ERR_OK;
+    }
+  }
+  return altcp_mbedtls_close_inner(conn);
+}
+
 /** Allow caller of altcp_write() to limit to negotiated chunk size
  *  or remaining sndbuf space of inner_conn.
  */
@@ -1058,8 +1486,9 @@ altcp_mbedtls_sndbuf(struct altcp_pcb *conn)
           size_t max_frag_len = mbedtls_ssl_get_max_frag_len(&state->ssl_context);
           max_len = LWIP_MIN(max_frag_len, max_len);
 #endif
-          /* Adjust sndbuf of inner_conn with what added by SSL */
+          /* Adjust sndbuf of inner_conn with what added by SSL and not encrypted yet */
           ret = LWIP_MIN(sndbuf - ssl_added, max_len);
+          ret = (ret > state->tx_len) ? (ret - state->tx_len) : 0;
           LWIP_ASSERT("sndbuf overflow", ret <= 0xFFFF);
           return (u16_t)ret;
         }
@@ -1070,6 +1499,96 @@ altcp_mbedtls_sndbuf(struct altcp_pcb *conn)
   return altcp_default_sndbuf(conn);
 }
 
+/** Get the number of application bytes to encrypt into the next record.
+ * Data that does not fit into one record is split into records that fill whole
+ * segments of the inner connection (MSS sized) including the record expansion.
+ */
+static u16_t
+altcp_mbedtls_record_len(struct altcp_pcb *conn, altcp_mbedtls_state_t *state, u16_t len)
+{
+#if defined(MBEDTLS_SSL_OUT_CONTENT_LEN)
+  size_t max_len = MBEDTLS_SSL_OUT_CONTENT_LEN;
+#else
+  size_t max_len = MBEDTLS_SSL_MAX_CONTENT_LEN;
+#endif
+  int ssl_expan;
+  u16_t mss;
+  size_t segs;
+
+#if defined(MBEDTLS_SSL_MAX_FRAGMENT_LENGTH)
+  max_len = LWIP_MIN(max_len, mbedtls_ssl_get_max_frag_len(&state->ssl_context));
+#endif
+  if (len <= max_len) {
+    return len;
+  }
+  ssl_expan = mbedtls_ssl_get_record_expansion(&state->ssl_context);
+  mss = altcp_mss(conn->inner_conn);
+  if ((ssl_expan < 0) || (mss <= (u16_t)ssl_expan)) {
+    return (u16_t)max_len;
+  }
+  segs = (max_len + (size_t)ssl_expan) / mss;
+  if (segs == 0) {
+    return (u16_t)max_len;
+  }
+  return (u16_t)(segs * mss - (size_t)ssl_expan);
+}
+
+/** Encrypt application data into records and pass them to the inner connection.
+ * Stops when the inner connection cannot take a complete record, as mbedTLS
+ * has to flush that record before encrypting the next one.
+ * @return number of bytes encrypted or an mbedTLS error if nothing could be encrypted
+ */
+static int
+altcp_mbedtls_write_records(struct altcp_pcb *conn, altcp_mbedtls_state_t *state,
+                            const u8_t *data, u16_t len, u8_t apiflags)
+{
+  int written = 0;
+
+  while (written < len) {
+    int ret;
+    u16_t chunk = altcp_mbedtls_record_len(conn, state, (u16_t)(len - written));
+    /* let the inner connection coalesce all records of this write */
+    state->bio_apiflags = (u8_t)(((written + chunk < len) ? TCP_WRITE_FLAG_MORE : 0) | (apiflags & TCP_WRITE_FLAG_MORE));
+    ret = mbedtls_ssl_write(&state->ssl_context, data + written, chunk);
+    state->bio_apiflags = 0;
+    if (ret <= 0) {
+      return written ? written : ret;
+    }
+    /* the record is consumed even if it is waiting in the mbedTLS output buffer */
+    written += ret;
+    if (state->flags & ALTCP_MBEDTLS_FLAGS_TX_PENDING) {
+      /* record stays in the mbedTLS output buffer until TCP has space for it */
+      break;
+    }
+  }
+  return written;
+}
+
+/** Encrypt and send application data queued in state->tx */
+static void
+altcp_mbedtls_flush_tx(struct altcp_pcb *conn, altcp_mbedtls_state_t *state)
+{
+  int ret;
+
+  if ((state->tx == NULL) || !(state->flags & ALTCP_MBEDTLS_FLAGS_HANDSHAKE_DONE)) {
+    return;
+  }
+  if (altcp_mbedtls_flush_output(state)) {
+    return;
+  }
+  ret = altcp_mbedtls_write_records(conn, state, (const u8_t *)state->tx->payload, state->tx_len, 0);
+  if (ret > 0) {
+    state->flags |= ALTCP_MBEDTLS_FLAGS_APPLDATA_SENT;
+    state->tx_len = (u16_t)(state->tx_len - ret);
+    if (state->tx_len == 0) {
+      pbuf_free(state->tx);
+      state->tx = NULL;
+    } else {
+      pbuf_remove_header(state->tx, (u16_t)ret);
+    }
+  }
+}
+
 /** Write data to a TLS connection. Calls into mbedTLS, which in turn calls into
  * @ref altcp_mbedtls_bio_send() to send the encrypted data
  */
@@ -1077,10 +1596,10 @@ static err_t
 altcp_mbedtls_write(struct altcp_pcb *conn, const void *dataptr, u16_t len, u8_t apiflags)
 {
   int ret;
+  u16_t first_len;
+  struct pbuf *rest = NULL;
   altcp_mbedtls_state_t *state;
 
-  LWIP_UNUSED_ARG(apiflags);
-
   if (conn == NULL) {
     return ERR_VAL;
   }
@@ -1095,35 +1614,91 @@ altcp_mbedtls_write(struct altcp_pcb *conn, const void *dataptr, u16_t len, u8_t
     return ERR_VAL;
   }
 
+  if (state->tx != NULL) {
+    if (len <= state->tx->len - state->tx_len) {
+      /* append to coalesced data */
+      MEMCPY((u8_t *)state->tx->payload + state->tx_len, dataptr, len);
+      state->tx_len = (u16_t)(state->tx_len + len);
+      if (!(apiflags & TCP_WRITE_FLAG_MORE)) {
+        altcp_mbedtls_flush_tx(conn, state);
+        altcp_output(conn->inner_conn);
+      }
+      return ERR_OK;
+    }
+    altcp_mbedtls_flush_tx(conn, state);
+    if (state->tx != NULL) {
+      return ERR_MEM;
+    }
+  }
+
   /* HACK: if thre is something left to send, try to flush it and only
      allow sending more if this succeeded (this is a hack because neither
      returning 0 nor MBEDTLS_ERR_SSL_WANT_WRITE worked for me) */
-  if (state->ssl_context.out_left) {
-    mbedtls_ssl_flush_output(&state->ssl_context);
-    if (state->ssl_context.out_left) {
+  if (altcp_mbedtls_flush_output(state)) {
+    return ERR_MEM;
+  }
+
+#if ALTCP_MBEDTLS_TX_COALESCE_LEN > 0
+  if ((apiflags & TCP_WRITE_FLAG_MORE) && (len < ALTCP_MBEDTLS_TX_COALESCE_LEN)) {
+    /* more data follows: collect it into one record */
+    state->tx = pbuf_alloc(PBUF_RAW, ALTCP_MBEDTLS_TX_COALESCE_LEN, PBUF_RAM);
+    if (state->tx != NULL) {
+      MEMCPY(state->tx->payload, dataptr, len);
+      state->tx_len = len;
+      return ERR_OK;
+    }
+  }
+#endif /* ALTCP_MBEDTLS_TX_COALESCE_LEN > 0 */
+
+  first_len = altcp_mbedtls_record_len(conn, state, len);
+  if (first_len < len) {
+    /* Data is split into several records: if TCP cannot take all of them, the rest
+       is encrypted from the sent/poll callbacks. Allocate the buffer for that now
+       as the application is told that all data is written. */
+    rest = pbuf_alloc(PBUF_RAW, (u16_t)(len - first_len), PBUF_RAM);
+    if (rest == NULL) {
       return ERR_MEM;
     }
   }
-  ret = mbedtls_ssl_write(&state->ssl_context, (const unsigned char *)dataptr, len);
+
+  ret = altcp_mbedtls_write_records(conn, state, (const u8_t *)dataptr, len, apiflags);
   /* try to send data... */
   altcp_output(conn->inner_conn);
-  if (ret >= 0) {
-    if (ret == len) {
-      state->flags |= ALTCP_MBEDTLS_FLAGS_APPLDATA_SENT;
-      return ERR_OK;
-    } else {
-      /* @todo/@fixme: assumption: either everything sent or error */
-      LWIP_ASSERT("ret <= 0", 0);
-      return ERR_MEM;
+  if (ret > 0) {
+    state->flags |= ALTCP_MBEDTLS_FLAGS_APPLDATA_SENT;
+    if (ret < len) {
+      LWIP_ASSERT("rest != NULL", rest != NULL);
+      pbuf_realloc(rest, (u16_t)(len - ret));
+      MEMCPY(rest->payload, (const u8_t *)dataptr + ret, len - ret);
+      state->tx = rest;
+      state->tx_len = (u16_t)(len - ret);
+    } else if (rest != NULL) {
+      pbuf_free(rest);
     }
-  } else {
-    if (ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
-      /* @todo: convert error to err_t */
-      return ERR_MEM;
-    }
-    LWIP_ASSERT("unhandled error", 0);
+    return ERR_OK;
+  }
+  if (rest != NULL) {
+    pbuf_free(rest);
+  }
+  if (ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+    /* @todo: convert error to err_t */
+    return ERR_MEM;
+  }
+  LWIP_ASSERT("unhandled error", 0);
+  return ERR_VAL;
+}
+
+/** Encrypt coalesced data and send everything queued on the inner connection */
+static err_t
+altcp_mbedtls_output(struct altcp_pcb *conn)
+{
+  if (conn == NULL) {
     return ERR_VAL;
   }
+  if (conn->state != NULL) {
+    altcp_mbedtls_flush_tx(conn, (altcp_mbedtls_state_t *)conn->state);
+  }
+  return altcp_output(conn->inner_conn);
 }
 
 /** Send callback function called from mbedtls (set via mbedtls_ssl_set_bio)
@@ -1134,14 +1709,17 @@ static int
 altcp_mbedtls_bio_send(void *ctx, const unsigned char *dataptr, size_t size)
 {
   struct altcp_pcb *conn = (struct altcp_pcb *) ctx;
+  altcp_mbedtls_state_t *state;
   int written = 0;
   size_t size_left = size;
   u8_t apiflags = TCP_WRITE_FLAG_COPY;
 
   LWIP_ASSERT("conn != NULL", conn != NULL);
-  if ((conn == NULL) || (conn->inner_conn == NULL)) {
+  if ((conn == NULL) || (conn->inner_conn == NULL) || (conn->state == NULL)) {
     return MBEDTLS_ERR_NET_INVALID_CONTEXT;
   }
+  state = (altcp_mbedtls_state_t *)conn->state;
+  apiflags |= state->bio_apiflags;
 
   while (size_left) {
     u16_t write_len = (u16_t)LWIP_MIN(size_left, 0xFFFF);
@@ -1149,7 +1727,11 @@ altcp_mbedtls_bio_send(void *ctx, const unsigned char *dataptr, size_t size)
     if (err == ERR_OK) {
       written += write_len;
       size_left -= write_len;
+      dataptr += write_len;
     } else if (err == ERR_MEM) {
+      /* mbedTLS keeps the rest in its output buffer (returning 0 makes it
+         return from mbedtls_ssl_write() as if all was sent) */
+      state->flags |= ALTCP_MBEDTLS_FLAGS_TX_PENDING;
       if (written) {
         return written;
       }
@@ -1160,6 +1742,7 @@ altcp_mbedtls_bio_send(void *ctx, const unsigned char *dataptr, size_t size)
       return MBEDTLS_ERR_NET_SEND_FAILED;
     }
   }
+  state->flags = (u8_t)(state->flags & ~ALTCP_MBEDTLS_FLAGS_TX_PENDING);
   return written;
 }
 
@@ -1187,6 +1770,12 @@ altcp_mbedtls_dealloc(struct altcp_pcb *conn)
         pbuf_free(state->rx);
         state->rx = NULL;
       }
+      if (state->tx) {
+        /* free unsent tx data */
+        pbuf_free(state->tx);
+        state->tx = NULL;
+        state->tx_len = 0;
+      }
       altcp_mbedtls_free(state->conf, state);
       conn->state = NULL;
     }
@@ -1203,7 +1792,7 @@ const struct altcp_functions altcp_mbedtls_functions = {
   altcp_mbedtls_close,
   altcp_default_shutdown,
   altcp_mbedtls_write,
-  altcp_default_output,
+  altcp_mbedtls_output,
   altcp_mbedtls_mss,
   altcp_mbedtls_sndbuf,
   altcp_default_sndqueuelen,
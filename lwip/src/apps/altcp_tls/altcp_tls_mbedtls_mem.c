@@ -4,10 +4,10 @@
  *
  * This file contains memory management functions for a TLS layer using mbedTLS.
  *
- * ATTENTION: For production usage, you might want to override this file with
- *            your own implementation since this implementation simply uses the
- *            lwIP heap without caring for fragmentation or leaving heap for
- *            other parts of lwIP!
+ * ATTENTION: By default, this implementation simply uses the lwIP heap without
+ *            caring for fragmentation or leaving heap for other parts of lwIP!
+ *            For production usage, enable ALTCP_MBEDTLS_MEM_POOLS to use dedicated
+ *            size-class pools or override this file with your own implementation.
  */
 
 /*
@@ -76,51 +76,132 @@
 #define ALTCP_MBEDTLS_PLATFORM_ALLOC 0
 #endif
 
-#if ALTCP_MBEDTLS_PLATFORM_ALLOC
-
-#ifndef ALTCP_MBEDTLS_PLATFORM_ALLOC_STATS
-#define ALTCP_MBEDTLS_PLATFORM_ALLOC_STATS 0
+#if ALTCP_MBEDTLS_MEM_POOLS && !ALTCP_MBEDTLS_PLATFORM_ALLOC
+#error "ALTCP_MBEDTLS_MEM_POOLS needs MBEDTLS_PLATFORM_MEMORY"
 #endif
 
+#if ALTCP_MBEDTLS_PLATFORM_ALLOC
+
 /* This is an example/debug implementation of alloc/free functions only */
 typedef struct altcp_mbedtls_malloc_helper_s {
   size_t c;
   size_t len;
+#if ALTCP_MBEDTLS_MEM_POOLS
+  /* index into altcp_mbedtls_pools */
+  size_t pool;
+#endif
 } altcp_mbedtls_malloc_helper_t;
 
+#define ALTCP_MBEDTLS_MALLOC_HELPER_SIZE  LWIP_MEM_ALIGN_SIZE(sizeof(altcp_mbedtls_malloc_helper_t))
+
+#if ALTCP_MBEDTLS_MEM_POOLS
+#include "lwip/memp.h"
+
+LWIP_MEMPOOL_DECLARE(ALTCP_MBEDTLS_64, ALTCP_MBEDTLS_MEM_POOL_64_NUM,
+                     ALTCP_MBEDTLS_MALLOC_HELPER_SIZE + 64, "ALTCP_MBEDTLS_64")
+LWIP_MEMPOOL_DECLARE(ALTCP_MBEDTLS_256, ALTCP_MBEDTLS_MEM_POOL_256_NUM,
+                     ALTCP_MBEDTLS_MALLOC_HELPER_SIZE + 256, "ALTCP_MBEDTLS_256")
+LWIP_MEMPOOL_DECLARE(ALTCP_MBEDTLS_1K, ALTCP_MBEDTLS_MEM_POOL_1K_NUM,
+                     ALTCP_MBEDTLS_MALLOC_HELPER_SIZE + 1024, "ALTCP_MBEDTLS_1K")
+LWIP_MEMPOOL_DECLARE(ALTCP_MBEDTLS_4K, ALTCP_MBEDTLS_MEM_POOL_4K_NUM,
+                     ALTCP_MBEDTLS_MALLOC_HELPER_SIZE + 4096, "ALTCP_MBEDTLS_4K")
+LWIP_MEMPOOL_DECLARE(ALTCP_MBEDTLS_RECORD, ALTCP_MBEDTLS_MEM_POOL_RECORD_NUM,
+                     ALTCP_MBEDTLS_MALLOC_HELPER_SIZE + ALTCP_MBEDTLS_MEM_POOL_RECORD_SIZE, "ALTCP_MBEDTLS_RECORD")
+
+/** Size classes, smallest first */
+static const struct memp_desc *const altcp_mbedtls_pools[ALTCP_MBEDTLS_NUM_POOLS] = {
+  &memp_ALTCP_MBEDTLS_64,
+  &memp_ALTCP_MBEDTLS_256,
+  &memp_ALTCP_MBEDTLS_1K,
+  &memp_ALTCP_MBEDTLS_4K,
+  &memp_ALTCP_MBEDTLS_RECORD
+};
+/** 'pool' of allocations from the heap */
+#define ALTCP_MBEDTLS_HEAP  ALTCP_MBEDTLS_NUM_POOLS
+
+/** Nesting level of altcp_mbedtls_mem_config_begin(): allocations for configurations
+ * are long-lived and go to the heap instead of taking pool blocks from the connections */
+static u8_t altcp_mbedtls_mem_config_level;
+#endif /* ALTCP_MBEDTLS_MEM_POOLS */
+
 #if ALTCP_MBEDTLS_PLATFORM_ALLOC_STATS
-typedef struct altcp_mbedtls_malloc_stats_s {
-  size_t allocedBytes;
-  size_t allocCnt;
-  size_t maxBytes;
-  size_t totalBytes;
-} altcp_mbedtls_malloc_stats_t;
 altcp_mbedtls_malloc_stats_t altcp_mbedtls_malloc_stats;
 volatile int altcp_mbedtls_malloc_clear_stats;
 #endif
 
+#if ALTCP_MBEDTLS_MEM_POOLS
+/* Allocate from the smallest size class that fits, or the next larger one if it is exhausted */
+static altcp_mbedtls_malloc_helper_t *
+tls_malloc_pool(size_t size)
+{
+  size_t i;
+  for (i = 0; i < ALTCP_MBEDTLS_NUM_POOLS; i++) {
+    if (size <= (size_t)(altcp_mbedtls_pools[i]->size - ALTCP_MBEDTLS_MALLOC_HELPER_SIZE)) {
+      altcp_mbedtls_malloc_helper_t *hlpr = (altcp_mbedtls_malloc_helper_t *)memp_malloc_pool(altcp_mbedtls_pools[i]);
+      if (hlpr != NULL) {
+        hlpr->pool = i;
+#if ALTCP_MBEDTLS_PLATFORM_ALLOC_STATS
+        altcp_mbedtls_malloc_stats.poolUsed[i]++;
+        if (altcp_mbedtls_malloc_stats.poolUsed[i] > altcp_mbedtls_malloc_stats.poolMax[i]) {
+          altcp_mbedtls_malloc_stats.poolMax[i] = altcp_mbedtls_malloc_stats.poolUsed[i];
+        }
+#endif
+        return hlpr;
+      }
+    }
+  }
+  return NULL;
+}
+#endif /* ALTCP_MBEDTLS_MEM_POOLS */
+
 static void *
 tls_malloc(size_t c, size_t len)
 {
   altcp_mbedtls_malloc_helper_t *hlpr;
   void *ret;
-  size_t alloc_size;
 #if ALTCP_MBEDTLS_PLATFORM_ALLOC_STATS
   if (altcp_mbedtls_malloc_clear_stats) {
+    /* restart the counters and high-water marks, what is in use stays in use */
     altcp_mbedtls_malloc_clear_stats = 0;
-    memset(&altcp_mbedtls_malloc_stats, 0, sizeof(altcp_mbedtls_malloc_stats));
+    altcp_mbedtls_malloc_stats.allocCnt = 0;
+    altcp_mbedtls_malloc_stats.totalBytes = 0;
+    altcp_mbedtls_malloc_stats.failCnt = 0;
+    altcp_mbedtls_malloc_stats.maxBytes = altcp_mbedtls_malloc_stats.allocedBytes;
+#if ALTCP_MBEDTLS_MEM_POOLS
+    MEMCPY(altcp_mbedtls_malloc_stats.poolMax, altcp_mbedtls_malloc_stats.poolUsed,
+           sizeof(altcp_mbedtls_malloc_stats.poolMax));
+#endif
   }
 #endif
-  alloc_size = sizeof(altcp_mbedtls_malloc_helper_t) + (c * len);
-  /* check for maximum allocation size, mainly to prevent mem_size_t overflow */
-  if (alloc_size > MEM_SIZE) {
-    LWIP_DEBUGF(ALTCP_MBEDTLS_MEM_DEBUG, ("mbedtls allocation too big: %c * %d bytes vs MEM_SIZE=%d",
-                                          (int)c, (int)len, (int)MEM_SIZE));
+  if ((len != 0) && (c > (~(size_t)0 - ALTCP_MBEDTLS_MALLOC_HELPER_SIZE) / len)) {
+    /* c * len overflow */
     return NULL;
   }
-  hlpr = (altcp_mbedtls_malloc_helper_t *)mem_malloc((mem_size_t)alloc_size);
+#if ALTCP_MBEDTLS_MEM_POOLS
+  if (altcp_mbedtls_mem_config_level == 0) {
+    hlpr = tls_malloc_pool(c * len);
+  } else
+#endif
+  {
+    size_t alloc_size = ALTCP_MBEDTLS_MALLOC_HELPER_SIZE + (c * len);
+    /* check for maximum allocation size, mainly to prevent mem_size_t overflow */
+    if (alloc_size > MEM_SIZE) {
+      LWIP_DEBUGF(ALTCP_MBEDTLS_MEM_DEBUG, ("mbedtls allocation too big: %c * %d bytes vs MEM_SIZE=%d",
+                                            (int)c, (int)len, (int)MEM_SIZE));
+      return NULL;
+    }
+    hlpr = (altcp_mbedtls_malloc_helper_t *)mem_malloc((mem_size_t)alloc_size);
+#if ALTCP_MBEDTLS_MEM_POOLS
+    if (hlpr != NULL) {
+      hlpr->pool = ALTCP_MBEDTLS_HEAP;
+    }
+#endif
+  }
   if (hlpr == NULL) {
     LWIP_DEBUGF(ALTCP_MBEDTLS_MEM_DEBUG, ("mbedtls alloc callback failed for %c * %d bytes", (int)c, (int)len));
+#if ALTCP_MBEDTLS_PLATFORM_ALLOC_STATS
+    altcp_mbedtls_malloc_stats.failCnt++;
+#endif
     return NULL;
   }
 #if ALTCP_MBEDTLS_PLATFORM_ALLOC_STATS
@@ -133,7 +214,7 @@ tls_malloc(size_t c, size_t len)
 #endif
   hlpr->c = c;
   hlpr->len = len;
-  ret = hlpr + 1;
+  ret = (u8_t *)hlpr + ALTCP_MBEDTLS_MALLOC_HELPER_SIZE;
   /* zeroing the allocated chunk is required by mbedTLS! */
   memset(ret, 0, c * len);
   return ret;
@@ -147,10 +228,18 @@ tls_free(void *ptr)
     /* this obviously happened in mbedtls... */
     return;
   }
-  hlpr = ((altcp_mbedtls_malloc_helper_t *)ptr) - 1;
+  hlpr = (altcp_mbedtls_malloc_helper_t *)(void *)((u8_t *)ptr - ALTCP_MBEDTLS_MALLOC_HELPER_SIZE);
+#if ALTCP_MBEDTLS_PLATFORM_ALLOC_STATS
+  altcp_mbedtls_malloc_stats.allocedBytes -= hlpr->c * hlpr->len;
+#endif
+#if ALTCP_MBEDTLS_MEM_POOLS
+  LWIP_ASSERT("invalid pool", hlpr->pool <= ALTCP_MBEDTLS_HEAP);
+  if (hlpr->pool != ALTCP_MBEDTLS_HEAP) {
 #if ALTCP_MBEDTLS_PLATFORM_ALLOC_STATS
-  if (!altcp_mbedtls_malloc_clear_stats) {
-    altcp_mbedtls_malloc_stats.allocedBytes -= hlpr->c * hlpr->len;
+    altcp_mbedtls_malloc_stats.poolUsed[hlpr->pool]--;
+#endif
+    memp_free_pool(altcp_mbedtls_pools[hlpr->pool], hlpr);
+    return;
   }
 #endif
   mem_free(hlpr);
@@ -160,7 +249,17 @@ tls_free(void *ptr)
 void
 altcp_mbedtls_mem_init(void)
 {
-  /* not much to do here when using the heap */
+#if ALTCP_MBEDTLS_MEM_POOLS
+  /* called for every new config: only initialize the pools once */
+  static u8_t pools_initialized;
+  if (!pools_initialized) {
+    size_t i;
+    for (i = 0; i < ALTCP_MBEDTLS_NUM_POOLS; i++) {
+      memp_init_pool(altcp_mbedtls_pools[i]);
+    }
+    pools_initialized = 1;
+  }
+#endif /* ALTCP_MBEDTLS_MEM_POOLS */
 
 #if ALTCP_MBEDTLS_PLATFORM_ALLOC
   /* set mbedtls allocation methods */
@@ -168,10 +267,36 @@ altcp_mbedtls_mem_init(void)
 #endif
 }
 
+/** Allocations of mbedTLS until altcp_mbedtls_mem_config_end() belong to a
+ * configuration (certificates, keys, ...): they go to the heap, not to the pools.
+ * Calls may be nested.
+ */
+void
+altcp_mbedtls_mem_config_begin(void)
+{
+#if ALTCP_MBEDTLS_MEM_POOLS
+  LWIP_ASSERT("nesting too deep", altcp_mbedtls_mem_config_level < 0xff);
+  altcp_mbedtls_mem_config_level++;
+#endif
+}
+
+void
+altcp_mbedtls_mem_config_end(void)
+{
+#if ALTCP_MBEDTLS_MEM_POOLS
+  LWIP_ASSERT("not in a configuration", altcp_mbedtls_mem_config_level > 0);
+  altcp_mbedtls_mem_config_level--;
+#endif
+}
+
 altcp_mbedtls_state_t *
 altcp_mbedtls_alloc(void *conf)
 {
+#if ALTCP_MBEDTLS_MEM_POOLS
+  altcp_mbedtls_state_t *ret = (altcp_mbedtls_state_t *)tls_malloc(1, sizeof(altcp_mbedtls_state_t));
+#else
   altcp_mbedtls_state_t *ret = (altcp_mbedtls_state_t *)mem_calloc(1, sizeof(altcp_mbedtls_state_t));
+#endif
   if (ret != NULL) {
     ret->conf = conf;
   }
@@ -183,7 +308,11 @@ altcp_mbedtls_free(void *conf, altcp_mbedtls_state_t *state)
 {
   LWIP_UNUSED_ARG(conf);
   LWIP_ASSERT("state != NULL", state != NULL);
+#if ALTCP_MBEDTLS_MEM_POOLS
+  tls_free(state);
+#else
   mem_free(state);
+#endif
 }
 
 void *
@@ -195,6 +324,7 @@ altcp_mbedtls_alloc_config(size_t size)
     /* allocation too big (mem_size_t overflow) */
     return NULL;
   }
+  /* configurations are long-lived, so they stay on the heap even with ALTCP_MBEDTLS_MEM_POOLS */
   ret = (altcp_mbedtls_state_t *)mem_calloc(1, (mem_size_t)size);
   return ret;
 }
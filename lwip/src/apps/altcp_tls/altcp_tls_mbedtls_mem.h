@@ -57,7 +57,36 @@
 extern "C" {
 #endif
 
+#ifndef ALTCP_MBEDTLS_PLATFORM_ALLOC_STATS
+#define ALTCP_MBEDTLS_PLATFORM_ALLOC_STATS 0
+#endif
+
+#if ALTCP_MBEDTLS_MEM_POOLS
+/** Number of size classes: 64, 256, 1K, 4K and record buffers */
+#define ALTCP_MBEDTLS_NUM_POOLS  5
+#endif
+
+#if ALTCP_MBEDTLS_PLATFORM_ALLOC_STATS
+typedef struct altcp_mbedtls_malloc_stats_s {
+  size_t allocedBytes;
+  size_t allocCnt;
+  size_t maxBytes;
+  size_t totalBytes;
+  size_t failCnt;
+#if ALTCP_MBEDTLS_MEM_POOLS
+  /* blocks in use and high-water mark per size class */
+  u16_t poolUsed[ALTCP_MBEDTLS_NUM_POOLS];
+  u16_t poolMax[ALTCP_MBEDTLS_NUM_POOLS];
+#endif
+} altcp_mbedtls_malloc_stats_t;
+extern altcp_mbedtls_malloc_stats_t altcp_mbedtls_malloc_stats;
+/** Set to restart the counters and high-water marks with the next allocation */
+extern volatile int altcp_mbedtls_malloc_clear_stats;
+#endif
+
 void altcp_mbedtls_mem_init(void);
+void altcp_mbedtls_mem_config_begin(void);
+void altcp_mbedtls_mem_config_end(void);
 altcp_mbedtls_state_t *altcp_mbedtls_alloc(void *conf);
 void altcp_mbedtls_free(void *conf, altcp_mbedtls_state_t *state);
 void *altcp_mbedtls_alloc_config(size_t size);
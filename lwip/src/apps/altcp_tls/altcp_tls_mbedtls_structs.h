@@ -61,6 +61,10 @@ extern "C" {
 #define ALTCP_MBEDTLS_FLAGS_RX_CLOSE_QUEUED   0x04
 #define ALTCP_MBEDTLS_FLAGS_RX_CLOSED         0x08
 #define ALTCP_MBEDTLS_FLAGS_APPLDATA_SENT     0x10
+/* a record is waiting in the mbedTLS output buffer (inner connection was full) */
+#define ALTCP_MBEDTLS_FLAGS_TX_PENDING        0x20
+/* closed by the application, the inner connection is closed once tx is sent */
+#define ALTCP_MBEDTLS_FLAGS_CLOSE_PENDING     0x40
 
 typedef struct altcp_mbedtls_state_s {
   void *conf;
@@ -68,10 +72,27 @@ typedef struct altcp_mbedtls_state_s {
   /* chain of rx pbufs (before decryption) */
   struct pbuf *rx;
   struct pbuf *rx_app;
+  /* application data accepted but not encrypted yet (coalesced small writes or
+     the rest of a write that did not fit into the TCP send queue) */
+  struct pbuf *tx;
+  /* number of bytes in tx (starting at tx->payload) */
+  u16_t tx_len;
+  /* apiflags passed to the inner connection by altcp_mbedtls_bio_send */
+  u8_t bio_apiflags;
   u8_t flags;
   int rx_passed_unrecved;
   int bio_bytes_read;
   int bio_bytes_appl;
+  /* time spent in mbedtls_ssl_handshake() */
+  u32_t handshake_ms;
+#if ALTCP_MBEDTLS_USE_CLIENT_SESSION_CACHE
+  /* client session cache key of the server (set on connect) */
+  ip_addr_t remote_ip;
+  u32_t host_hash;
+  /* hash of the master secret (0 if not known) */
+  u32_t master_hash;
+  u16_t remote_port;
+#endif
 } altcp_mbedtls_state_t;
 
 #ifdef __cplusplus
@@ -38,7 +38,6 @@
  * @defgroup httpc HTTP client
  * @ingroup apps
  * @todo:
- * - persistent connections
  * - select outgoing http version
  * - optionally follow redirect
  * - check request uri for invalid characters? (e.g. encode spaces)
@@ -87,13 +86,23 @@
 #define HTTPC_POLL_INTERVAL     1
 #define HTTPC_POLL_TIMEOUT      30 /* 15 seconds */
 
+#if LWIP_HTTPC_KEEPALIVE
+#define HTTPC_IDLE_TIMEOUT      (LWIP_HTTPC_IDLE_TIMEOUT * 2) /* poll ticks of 500 ms */
+#endif /* LWIP_HTTPC_KEEPALIVE */
+
 #define HTTPC_CONTENT_LEN_INVALID 0xFFFFFFFF
 
+#if LWIP_HTTPC_KEEPALIVE
+#define HTTPC_REQ_CONNECTION "Connection: keep-alive\r\n"
+#else
+#define HTTPC_REQ_CONNECTION "Connection: Close\r\n" /* persistent connections disabled */
+#endif
+
 /* GET request basic */
 #define HTTPC_REQ_11 "GET %s HTTP/1.1\r\n" /* URI */\
     "User-Agent: %s\r\n" /* User-Agent */ \
     "Accept: */*\r\n" \
-    "Connection: Close\r\n" /* we don't support persistent connections, yet */ \
+    HTTPC_REQ_CONNECTION \
     "\r\n"
 #define HTTPC_REQ_11_FORMAT(uri) HTTPC_REQ_11, uri, HTTPC_CLIENT_AGENT
 
@@ -102,7 +111,7 @@
     "User-Agent: %s\r\n" /* User-Agent */ \
     "Accept: */*\r\n" \
     "Host: %s\r\n" /* server name */ \
-    "Connection: Close\r\n" /* we don't support persistent connections, yet */ \
+    HTTPC_REQ_CONNECTION \
     "\r\n"
 #define HTTPC_REQ_11_HOST_FORMAT(uri, srv_name) HTTPC_REQ_11_HOST, uri, HTTPC_CLIENT_AGENT, srv_name
 
@@ -111,7 +120,7 @@
     "User-Agent: %s\r\n" /* User-Agent */ \
     "Accept: */*\r\n" \
     "Host: %s\r\n" /* server name */ \
-    "Connection: Close\r\n" /* we don't support persistent connections, yet */ \
+    HTTPC_REQ_CONNECTION \
     "\r\n"
 #define HTTPC_REQ_11_PROXY_FORMAT(host, uri, srv_name) HTTPC_REQ_11_PROXY, host, uri, HTTPC_CLIENT_AGENT, srv_name
 
@@ -120,7 +129,7 @@
     "User-Agent: %s\r\n" /* User-Agent */ \
     "Accept: */*\r\n" \
     "Host: %s\r\n" /* server name */ \
-    "Connection: Close\r\n" /* we don't support persistent connections, yet */ \
+    HTTPC_REQ_CONNECTION \
     "\r\n"
 #define HTTPC_REQ_11_PROXY_PORT_FORMAT(host, host_port, uri, srv_name) HTTPC_REQ_11_PROXY_PORT, host, host_port, uri, HTTPC_CLIENT_AGENT, srv_name
 
@@ -128,8 +137,23 @@ typedef enum ehttpc_parse_state {
   HTTPC_PARSE_WAIT_FIRST_LINE = 0,
   HTTPC_PARSE_WAIT_HEADERS,
   HTTPC_PARSE_RX_DATA
+#if LWIP_HTTPC_KEEPALIVE
+  ,
+  /* chunked transfer encoding */
+  HTTPC_PARSE_RX_CHUNK_SIZE,
+  HTTPC_PARSE_RX_CHUNK_EXT,
+  HTTPC_PARSE_RX_CHUNK_DATA,
+  HTTPC_PARSE_RX_CHUNK_DATA_END,
+  HTTPC_PARSE_RX_TRAILER,
+  /* response completely received */
+  HTTPC_PARSE_DONE
+#endif /* LWIP_HTTPC_KEEPALIVE */
 } httpc_parse_state_t;
 
+#if LWIP_HTTPC_KEEPALIVE
+struct _httpc_pconn;
+#endif /* LWIP_HTTPC_KEEPALIVE */
+
 typedef struct _httpc_state
 {
   struct altcp_pcb* pcb;
@@ -146,12 +170,56 @@ typedef struct _httpc_state
   u32_t rx_content_len;
   u32_t hdr_content_len;
   httpc_parse_state_t parse_state;
+#if LWIP_HTTPC_KEEPALIVE
+  /* bytes left in the current chunk or length of the current trailer line */
+  u32_t chunk_len;
+  u8_t chunk_digits;
+  /* the server keeps the connection open after this response */
+  u8_t keepalive;
+  struct _httpc_pconn *pconn;
+  struct _httpc_state *next;
+  u8_t sent;
+#endif /* LWIP_HTTPC_KEEPALIVE */
 #if HTTPC_DEBUG_REQUEST
   char* server_name;
   char* uri;
 #endif
 } httpc_state_t;
 
+#if LWIP_HTTPC_KEEPALIVE
+typedef enum ehttpc_pconn_state {
+  HTTPC_PCONN_FREE = 0,
+  HTTPC_PCONN_RESOLVING,
+  HTTPC_PCONN_CONNECTING,
+  HTTPC_PCONN_CONNECTED
+} httpc_pconn_state_t;
+
+/** A connection in the keep-alive pool, identified by host, port (and allocator) */
+typedef struct _httpc_pconn
+{
+  struct altcp_pcb* pcb;
+  /* requests in the order they are sent, the first one receives the current response */
+  httpc_state_t *reqs;
+  char *host;
+  ip_addr_t remote_addr;
+  u16_t remote_port;
+#if LWIP_ALTCP
+  altcp_allocator_t *allocator;
+#endif
+  httpc_pconn_state_t state;
+  u8_t num_reqs;
+  /* number of responses completed on the current pcb (saturating) */
+  u8_t served;
+  /* cleared when the server closes the connection after the current response */
+  u8_t reusable;
+  u16_t idle_ticks;
+} httpc_pconn_t;
+
+static httpc_pconn_t httpc_pconns[LWIP_HTTPC_POOL_SIZE];
+/* connection currently receiving: must not be evicted from a result callback */
+static httpc_pconn_t *httpc_pconn_rx;
+#endif /* LWIP_HTTPC_KEEPALIVE */
+
 /** Free http client state and deallocate all resources within */
 static err_t
 httpc_free_state(httpc_state_t* req)
@@ -243,6 +311,67 @@ http_parse_response_status(struct pbuf *p, u16_t *http_version, u16_t *http_stat
   return ERR_VAL;
 }
 
+/** Case-insensitive compare of 'len' bytes at 'offset' in 'p' to 's' (which must be lower case) */
+static int
+httpc_pbuf_memicmp(const struct pbuf *p, u16_t offset, const char *s, u16_t len)
+{
+  u16_t i;
+  for (i = 0; i < len; i++) {
+    u8_t c = pbuf_get_at(p, (u16_t)(offset + i));
+    if ((c >= 'A') && (c <= 'Z')) {
+      c = (u8_t)(c + ('a' - 'A'));
+    }
+    if (c != (u8_t)s[i]) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/** Find the header 'name' (lower case) in the first 'hdr_len' bytes of 'p'.
+ * Returns the offset of its value (leading whitespace skipped) or 0xFFFF. */
+static u16_t
+httpc_find_header(const struct pbuf *p, u16_t hdr_len, const char *name, u16_t *value_len)
+{
+  u16_t name_len = (u16_t)strlen(name);
+  /* skip the status line */
+  u16_t line_end = pbuf_memfind(p, "\r\n", 2, 0);
+
+  while ((line_end != 0xFFFF) && (line_end + 2 < hdr_len)) {
+    u16_t start = (u16_t)(line_end + 2);
+    line_end = pbuf_memfind(p, "\r\n", 2, start);
+    if ((line_end == 0xFFFF) || (line_end > hdr_len)) {
+      break;
+    }
+    if ((line_end - start > name_len) && (pbuf_get_at(p, (u16_t)(start + name_len)) == ':') &&
+        (httpc_pbuf_memicmp(p, start, name, name_len) == 0)) {
+      u16_t value = (u16_t)(start + name_len + 1);
+      while ((value < line_end) && ((pbuf_get_at(p, value) == ' ') || (pbuf_get_at(p, value) == '\t'))) {
+        value++;
+      }
+      *value_len = (u16_t)(line_end - value);
+      return value;
+    }
+  }
+  return 0xFFFF;
+}
+
+#if LWIP_HTTPC_KEEPALIVE
+/** Check if a header value contains 'token' (lower case, case-insensitive compare) */
+static int
+httpc_header_has_token(const struct pbuf *p, u16_t value, u16_t value_len, const char *token)
+{
+  u16_t token_len = (u16_t)strlen(token);
+  u16_t i;
+  for (i = 0; i + token_len <= value_len; i++) {
+    if (httpc_pbuf_memicmp(p, (u16_t)(value + i), token, token_len) == 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+#endif /* LWIP_HTTPC_KEEPALIVE */
+
 /** Wait for all headers to be received, return its length and content-length (if available) */
 static err_t
 http_wait_headers(struct pbuf *p, u32_t *content_length, u16_t *total_header_len)
@@ -250,23 +379,19 @@ http_wait_headers(struct pbuf *p, u32_t *content_length, u16_t *total_header_len
   u16_t end1 = pbuf_memfind(p, "\r\n\r\n", 4, 0);
   if (end1 < (0xFFFF - 2)) {
     /* all headers received */
-    /* check if we have a content length (@todo: case insensitive?) */
-    u16_t content_len_hdr;
+    /* check if we have a content length */
+    u16_t content_len_hdr, content_len_num_len;
     *content_length = HTTPC_CONTENT_LEN_INVALID;
     *total_header_len = end1 + 4;
 
-    content_len_hdr = pbuf_memfind(p, "Content-Length: ", 16, 0);
-    if (content_len_hdr != 0xFFFF) {
-      u16_t content_len_line_end = pbuf_memfind(p, "\r\n", 2, content_len_hdr);
-      if (content_len_line_end != 0xFFFF) {
-        char content_len_num[16];
-        u16_t content_len_num_len = (u16_t)(content_len_line_end - content_len_hdr - 16);
-        memset(content_len_num, 0, sizeof(content_len_num));
-        if (pbuf_copy_partial(p, content_len_num, content_len_num_len, content_len_hdr + 16) == content_len_num_len) {
-          int len = atoi(content_len_num);
-          if ((len >= 0) && ((u32_t)len < HTTPC_CONTENT_LEN_INVALID)) {
-            *content_length = (u32_t)len;
-          }
+    content_len_hdr = httpc_find_header(p, *total_header_len, "content-length", &content_len_num_len);
+    if ((content_len_hdr != 0xFFFF) && (content_len_num_len < 16)) {
+      char content_len_num[16];
+      memset(content_len_num, 0, sizeof(content_len_num));
+      if (pbuf_copy_partial(p, content_len_num, content_len_num_len, content_len_hdr) == content_len_num_len) {
+        int len = atoi(content_len_num);
+        if ((len >= 0) && ((u32_t)len < HTTPC_CONTENT_LEN_INVALID)) {
+          *content_length = (u32_t)len;
         }
       }
     }
@@ -275,6 +400,332 @@ http_wait_headers(struct pbuf *p, u32_t *content_length, u16_t *total_header_len
   return ERR_VAL;
 }
 
+#if LWIP_HTTPC_KEEPALIVE
+/** Check how the body of the response is delimited and whether the connection is persistent */
+static void
+httpc_parse_body_mode(httpc_state_t *req, struct pbuf *hdrs, u16_t hdr_len)
+{
+  u16_t value, value_len;
+
+  /* persistent connections are the default for HTTP/1.1 */
+  req->keepalive = (req->rx_http_version >= 0x0101);
+  value = httpc_find_header(hdrs, hdr_len, "connection", &value_len);
+  if (value != 0xFFFF) {
+    if (httpc_header_has_token(hdrs, value, value_len, "close")) {
+      req->keepalive = 0;
+    } else if (httpc_header_has_token(hdrs, value, value_len, "keep-alive")) {
+      req->keepalive = 1;
+    }
+  }
+
+  if ((req->rx_status == 204) || (req->rx_status == 304)) {
+    /* no message body */
+    req->parse_state = HTTPC_PARSE_DONE;
+    return;
+  }
+  value = httpc_find_header(hdrs, hdr_len, "transfer-encoding", &value_len);
+  if ((value != 0xFFFF) && httpc_header_has_token(hdrs, value, value_len, "chunked")) {
+    req->chunk_len = 0;
+    req->chunk_digits = 0;
+    req->parse_state = HTTPC_PARSE_RX_CHUNK_SIZE;
+  } else if (req->hdr_content_len == HTTPC_CONTENT_LEN_INVALID) {
+    /* the body ends when the server closes the connection */
+    req->keepalive = 0;
+    req->parse_state = HTTPC_PARSE_RX_DATA;
+  } else if (req->hdr_content_len == 0) {
+    req->parse_state = HTTPC_PARSE_DONE;
+  } else {
+    req->parse_state = HTTPC_PARSE_RX_DATA;
+  }
+}
+
+/** Parse one byte of chunked transfer encoding (size line, data CRLF or trailer)
+ * @return 1 if chunk data or the end of the response follows, 0 to go on, -1 on error */
+static int
+httpc_parse_chunk_framing(httpc_state_t *req, u8_t c)
+{
+  switch (req->parse_state) {
+    case HTTPC_PARSE_RX_CHUNK_SIZE:
+      if (((c >= '0') && (c <= '9')) || ((c >= 'a') && (c <= 'f')) || ((c >= 'A') && (c <= 'F'))) {
+        u8_t digit = (u8_t)((c <= '9') ? (c - '0') : ((c | 0x20) - 'a' + 10));
+        if (req->chunk_len > 0x0FFFFFFF) {
+          return -1;
+        }
+        req->chunk_len = (req->chunk_len << 4) | digit;
+        req->chunk_digits = 1;
+        break;
+      } else if ((c == ';') || (c == ' ') || (c == '\t')) {
+        req->parse_state = HTTPC_PARSE_RX_CHUNK_EXT;
+        break;
+      } else if (c == '\r') {
+        break;
+      } else if (c != '\n') {
+        return -1;
+      }
+      /* fall through */
+    case HTTPC_PARSE_RX_CHUNK_EXT:
+      if (c == '\n') {
+        if (!req->chunk_digits) {
+          return -1;
+        }
+        if (req->chunk_len == 0) {
+          /* last chunk: the trailer follows */
+          req->parse_state = HTTPC_PARSE_RX_TRAILER;
+          return 0;
+        }
+        req->parse_state = HTTPC_PARSE_RX_CHUNK_DATA;
+        return 1;
+      }
+      break;
+    case HTTPC_PARSE_RX_CHUNK_DATA_END:
+      if (c == '\n') {
+        req->chunk_len = 0;
+        req->chunk_digits = 0;
+        req->parse_state = HTTPC_PARSE_RX_CHUNK_SIZE;
+      } else if (c != '\r') {
+        return -1;
+      }
+      break;
+    case HTTPC_PARSE_RX_TRAILER:
+      if (c == '\n') {
+        if (req->chunk_len == 0) {
+          /* empty line */
+          req->parse_state = HTTPC_PARSE_DONE;
+          return 1;
+        }
+        req->chunk_len = 0;
+      } else if (c != '\r') {
+        req->chunk_len++;
+      }
+      break;
+    default:
+      LWIP_ASSERT("invalid parse state", 0);
+      return -1;
+  }
+  return 0;
+}
+
+/** Split the pbuf chain '*p' after 'len' bytes, the remainder is returned in 'rest'.
+ * The smaller part of a pbuf divided by the split is copied. */
+static err_t
+httpc_pbuf_split(struct pbuf **p, u16_t len, struct pbuf **rest)
+{
+  struct pbuf *head = *p;
+  struct pbuf *q = head, *prev = NULL, *r;
+  u16_t off = len;
+  u16_t rest_len = (u16_t)(head->tot_len - len);
+
+  LWIP_ASSERT("invalid split", (len > 0) && (len < head->tot_len));
+  while (off >= q->len) {
+    off = (u16_t)(off - q->len);
+    prev = q;
+    q = q->next;
+  }
+  if (off == 0) {
+    /* at a pbuf boundary: just unlink */
+    prev->next = NULL;
+    *rest = q;
+  } else if (off <= q->len - off) {
+    /* copy the first part of q */
+    struct pbuf *h = pbuf_alloc(PBUF_RAW, off, PBUF_RAM);
+    if (h == NULL) {
+      return ERR_MEM;
+    }
+    MEMCPY(h->payload, q->payload, off);
+    if (prev == NULL) {
+      *p = h;
+    } else {
+      prev->next = NULL;
+      for (r = head; r != NULL; r = r->next) {
+        r->tot_len = (u16_t)(r->tot_len - q->tot_len);
+      }
+      pbuf_cat(head, h);
+    }
+    pbuf_remove_header(q, off);
+    *rest = q;
+    return ERR_OK;
+  } else {
+    /* copy the last part of q */
+    u16_t tail = (u16_t)(q->len - off);
+    struct pbuf *t = pbuf_alloc(PBUF_RAW, tail, PBUF_RAM);
+    if (t == NULL) {
+      return ERR_MEM;
+    }
+    MEMCPY(t->payload, (u8_t *)q->payload + off, tail);
+    if (q->next != NULL) {
+      pbuf_cat(t, q->next);
+      q->next = NULL;
+    }
+    q->len = off;
+    *rest = t;
+  }
+  for (r = head; r != NULL; r = r->next) {
+    r->tot_len = (u16_t)(r->tot_len - rest_len);
+  }
+  return ERR_OK;
+}
+
+/** Pass up to 'max_len' body bytes from '*pp' to the application, the rest is returned in '*pp'.
+ * On error, all data has been freed. ERR_ABRT means 'req' may have been freed. */
+static err_t
+httpc_rx_body(httpc_state_t *req, struct altcp_pcb *pcb, struct pbuf **pp, u32_t max_len, httpc_result_t *result)
+{
+  struct pbuf *p = *pp;
+  struct pbuf *rest = NULL;
+
+  *pp = NULL;
+  if (p->tot_len > max_len) {
+    err_t err = httpc_pbuf_split(&p, (u16_t)max_len, &rest);
+    if (err != ERR_OK) {
+      pbuf_free(p);
+      *result = HTTPC_RESULT_ERR_MEM;
+      return err;
+    }
+  }
+  req->rx_content_len += p->tot_len;
+  if (req->recv_fn != NULL) {
+    err_t err = req->recv_fn(req->callback_arg, pcb, p, ERR_OK);
+    if (err != ERR_OK) {
+      /* the connection might already be aborted from the callback! */
+      if (err != ERR_ABRT) {
+        pbuf_free(p);
+      }
+      if (rest != NULL) {
+        pbuf_free(rest);
+      }
+      *result = HTTPC_RESULT_LOCAL_ABORT;
+      return err;
+    }
+  } else {
+    altcp_recved(pcb, p->tot_len);
+    pbuf_free(p);
+  }
+  *pp = rest;
+  return ERR_OK;
+}
+
+/** Parse received data for the response to 'req'. The body (without transfer encoding)
+ * is passed to the recv callback. Once the response is complete, parse_state is
+ * HTTPC_PARSE_DONE and '*pp' holds the data following it (if any).
+ * On error, all data has been freed. ERR_ABRT means 'req' may have been freed. */
+static err_t
+httpc_rx_response(httpc_state_t *req, struct altcp_pcb *pcb, struct pbuf **pp, httpc_result_t *result)
+{
+  struct pbuf *p = *pp;
+  err_t err;
+
+  *pp = NULL;
+  if (req->parse_state < HTTPC_PARSE_RX_DATA) {
+    if (req->rx_hdrs == NULL) {
+      req->rx_hdrs = p;
+    } else {
+      pbuf_cat(req->rx_hdrs, p);
+    }
+    p = NULL;
+    if (req->parse_state == HTTPC_PARSE_WAIT_FIRST_LINE) {
+      u16_t status_str_off;
+      err = http_parse_response_status(req->rx_hdrs, &req->rx_http_version, &req->rx_status, &status_str_off);
+      if (err == ERR_OK) {
+        /* don't care status string */
+        req->parse_state = HTTPC_PARSE_WAIT_HEADERS;
+      }
+    }
+    if (req->parse_state == HTTPC_PARSE_WAIT_HEADERS) {
+      u16_t total_header_len;
+      err = http_wait_headers(req->rx_hdrs, &req->hdr_content_len, &total_header_len);
+      if (err == ERR_OK) {
+        /* full header received, send window update for header bytes and call into client callback */
+        altcp_recved(pcb, total_header_len);
+        httpc_parse_body_mode(req, req->rx_hdrs, total_header_len);
+        if (req->conn_settings) {
+          if (req->conn_settings->headers_done_fn) {
+            err = req->conn_settings->headers_done_fn(req, req->callback_arg, req->rx_hdrs, total_header_len, req->hdr_content_len);
+            if (err != ERR_OK) {
+              *result = HTTPC_RESULT_LOCAL_ABORT;
+              return err;
+            }
+          }
+        }
+        /* hide header bytes in pbuf */
+        p = pbuf_free_header(req->rx_hdrs, total_header_len);
+        req->rx_hdrs = NULL;
+      }
+    }
+  }
+  /* go on with data */
+  while ((p != NULL) && (req->parse_state != HTTPC_PARSE_DONE)) {
+    if (req->parse_state == HTTPC_PARSE_RX_DATA) {
+      u32_t max_len = p->tot_len;
+      if (req->hdr_content_len != HTTPC_CONTENT_LEN_INVALID) {
+        max_len = req->hdr_content_len - req->rx_content_len;
+      }
+      err = httpc_rx_body(req, pcb, &p, max_len, result);
+      if (err != ERR_OK) {
+        return err;
+      }
+      if (req->rx_content_len == req->hdr_content_len) {
+        req->parse_state = HTTPC_PARSE_DONE;
+      }
+    } else if (req->parse_state == HTTPC_PARSE_RX_CHUNK_DATA) {
+      u32_t rx_len = req->rx_content_len;
+      err = httpc_rx_body(req, pcb, &p, req->chunk_len, result);
+      if (err != ERR_OK) {
+        return err;
+      }
+      req->chunk_len -= req->rx_content_len - rx_len;
+      if (req->chunk_len == 0) {
+        req->parse_state = HTTPC_PARSE_RX_CHUNK_DATA_END;
+      }
+    } else {
+      /* chunk framing: consumed here */
+      struct pbuf *q;
+      u16_t used = 0;
+      int res = 0;
+      for (q = p; (q != NULL) && (res == 0); q = q->next) {
+        const u8_t *data = (const u8_t *)q->payload;
+        u16_t i;
+        for (i = 0; (i < q->len) && (res == 0); i++) {
+          res = httpc_parse_chunk_framing(req, data[i]);
+          used++;
+        }
+      }
+      altcp_recved(pcb, used);
+      p = pbuf_free_header(p, used);
+      if (res < 0) {
+        LWIP_DEBUGF(HTTPC_DEBUG_WARN_STATE, ("httpc_rx_response: invalid chunk encoding\n"));
+        if (p != NULL) {
+          pbuf_free(p);
+        }
+        *result = HTTPC_RESULT_ERR_SVR_RESP;
+        return ERR_VAL;
+      }
+    }
+  }
+  *pp = p;
+  return ERR_OK;
+}
+
+/** Result of a response when the server closes the connection */
+static httpc_result_t
+httpc_rx_closed_result(httpc_state_t *req)
+{
+  if (req->parse_state < HTTPC_PARSE_RX_DATA) {
+    /* did not get RX data yet */
+    return HTTPC_RESULT_ERR_CLOSED;
+  } else if (req->parse_state == HTTPC_PARSE_DONE) {
+    return HTTPC_RESULT_OK;
+  } else if ((req->parse_state != HTTPC_PARSE_RX_DATA) ||
+             (req->hdr_content_len != HTTPC_CONTENT_LEN_INVALID)) {
+    /* not all data received (content length or chunked encoding) */
+    return HTTPC_RESULT_ERR_CONTENT_LEN;
+  }
+  /* no content length header: all data received */
+  return HTTPC_RESULT_OK;
+}
+
+#endif /* LWIP_HTTPC_KEEPALIVE */
+
+#if !LWIP_HTTPC_KEEPALIVE
 /** http client tcp recv callback */
 static err_t
 httpc_tcp_recv(void *arg, struct altcp_pcb *pcb, struct pbuf *p, err_t r)
@@ -336,11 +787,17 @@ httpc_tcp_recv(void *arg, struct altcp_pcb *pcb, struct pbuf *p, err_t r)
     }
   }
   if ((p != NULL) && (req->parse_state == HTTPC_PARSE_RX_DATA)) {
-    req->rx_content_len += p->tot_len;
     if (req->recv_fn != NULL) {
+      u16_t len = p->tot_len;
+      err_t err = req->recv_fn(req->callback_arg, pcb, p, r);
+      if (err == ERR_OK) {
+        /* refused data is passed again by tcp and counted then */
+        req->rx_content_len += len;
+      }
       /* directly return here: the connection migth already be aborted from the callback! */
-      return req->recv_fn(req->callback_arg, pcb, p, r);
+      return err;
     } else {
+      req->rx_content_len += p->tot_len;
       altcp_recved(pcb, p->tot_len);
       pbuf_free(p);
     }
@@ -483,6 +940,496 @@ httpc_get_internal_dns(httpc_state_t* req, const char* server_name)
   return err;
 }
 
+#else /* !LWIP_HTTPC_KEEPALIVE */
+
+static err_t httpc_pconn_connect(httpc_pconn_t *pconn);
+
+/** Close the pcb of a pooled connection (without notifying its requests) */
+static err_t
+httpc_pconn_close_pcb(httpc_pconn_t *pconn)
+{
+  struct altcp_pcb *tpcb = pconn->pcb;
+  pconn->pcb = NULL;
+  if (tpcb != NULL) {
+    altcp_arg(tpcb, NULL);
+    altcp_recv(tpcb, NULL);
+    altcp_err(tpcb, NULL);
+    altcp_poll(tpcb, NULL, 0);
+    altcp_sent(tpcb, NULL);
+    if (altcp_close(tpcb) != ERR_OK) {
+      altcp_abort(tpcb);
+      return ERR_ABRT;
+    }
+  }
+  return ERR_OK;
+}
+
+/** Close a pooled connection without requests and release its slot */
+static err_t
+httpc_pconn_free(httpc_pconn_t *pconn)
+{
+  err_t err;
+  LWIP_ASSERT("pconn has requests", pconn->reqs == NULL);
+  err = httpc_pconn_close_pcb(pconn);
+  if (pconn->host != NULL) {
+    mem_free(pconn->host);
+  }
+  memset(pconn, 0, sizeof(httpc_pconn_t));
+  return err;
+}
+
+/** Remove the first request (the one receiving a response) from a pooled connection */
+static httpc_state_t *
+httpc_pconn_dequeue(httpc_pconn_t *pconn)
+{
+  httpc_state_t *req = pconn->reqs;
+  pconn->reqs = req->next;
+  pconn->num_reqs--;
+  req->next = NULL;
+  req->pconn = NULL;
+  return req;
+}
+
+/** The pcb of 'pconn' is gone or must be closed. If 'retry' is set, requests that
+ * have not received any response data are sent again on a new connection,
+ * otherwise they are failed with 'result'.
+ */
+static err_t
+httpc_pconn_restart(httpc_pconn_t *pconn, u8_t retry, httpc_result_t result, err_t err)
+{
+  err_t close_err = httpc_pconn_close_pcb(pconn);
+  httpc_state_t *reqs;
+
+  if ((pconn->reqs != NULL) && retry) {
+    httpc_state_t *req;
+    for (req = pconn->reqs; req != NULL; req = req->next) {
+      LWIP_ASSERT("response started", req->request != NULL);
+      req->sent = 0;
+    }
+    LWIP_DEBUGF(HTTPC_DEBUG_STATE, ("httpc: resending %d request(s) to %s\n", (int)pconn->num_reqs, pconn->host));
+    pconn->served = 0;
+    pconn->reusable = 1;
+    if (httpc_pconn_connect(pconn) == ERR_OK) {
+      return close_err;
+    }
+  }
+  /* release the slot before calling back (new requests may be started) */
+  reqs = pconn->reqs;
+  pconn->reqs = NULL;
+  httpc_pconn_free(pconn);
+  while (reqs != NULL) {
+    httpc_state_t *req = reqs;
+    reqs = req->next;
+    req->next = NULL;
+    req->pconn = NULL;
+    httpc_close(req, result, 0, err);
+  }
+  return close_err;
+}
+
+/** Write queued requests. Before the server has completed a persistent
+ * response on this connection, only the first request is sent. */
+static err_t
+httpc_pconn_send(httpc_pconn_t *pconn)
+{
+  httpc_state_t *req;
+  u8_t written = 0;
+
+  if (pconn->state != HTTPC_PCONN_CONNECTED) {
+    return ERR_OK;
+  }
+  for (req = pconn->reqs; req != NULL; req = req->next) {
+    if (!req->sent) {
+      err_t err;
+      if ((req != pconn->reqs) && (!pconn->served || !pconn->reusable)) {
+        break;
+      }
+      /* send request; last char is zero termination */
+      err = altcp_write(pconn->pcb, req->request->payload, req->request->len - 1, TCP_WRITE_FLAG_COPY);
+      if (err == ERR_MEM) {
+        /* try again from sent or poll callback */
+        break;
+      } else if (err != ERR_OK) {
+        return err;
+      }
+      req->sent = 1;
+      written = 1;
+    }
+  }
+  if (written) {
+    altcp_output(pconn->pcb);
+  }
+  return ERR_OK;
+}
+
+/** Like httpc_pconn_send but fail all requests on error */
+static err_t
+httpc_pconn_output(httpc_pconn_t *pconn)
+{
+  err_t err = httpc_pconn_send(pconn);
+  if (err != ERR_OK) {
+    return httpc_pconn_restart(pconn, 0, HTTPC_RESULT_ERR_MEM, err);
+  }
+  return ERR_OK;
+}
+
+/** pooled connection tcp recv callback (without reentrancy guard) */
+static err_t
+httpc_pconn_recv_internal(httpc_pconn_t *pconn, struct altcp_pcb *pcb, struct pbuf *p)
+{
+  if (p == NULL) {
+    httpc_state_t *req = pconn->reqs;
+    if ((req != NULL) && (req->request == NULL)) {
+      /* finish the response being received */
+      httpc_result_t result = httpc_rx_closed_result(req);
+      err_t err;
+      if ((result == HTTPC_RESULT_OK) && (pconn->served < 0xFF)) {
+        pconn->served++;
+      }
+      httpc_pconn_dequeue(pconn);
+      err = httpc_pconn_restart(pconn, pconn->served > 0, HTTPC_RESULT_ERR_CLOSED, ERR_OK);
+      httpc_close(req, result, req->rx_status, ERR_OK);
+      return err;
+    }
+    return httpc_pconn_restart(pconn, pconn->served > 0, HTTPC_RESULT_ERR_CLOSED, ERR_OK);
+  }
+
+  while (p != NULL) {
+    httpc_state_t *req = pconn->reqs;
+    httpc_result_t result;
+    err_t err;
+
+    if ((req == NULL) || !req->sent) {
+      LWIP_DEBUGF(HTTPC_DEBUG_WARN_STATE, ("httpc: unexpected data from %s\n", pconn->host));
+      altcp_recved(pcb, p->tot_len);
+      pbuf_free(p);
+      return httpc_pconn_restart(pconn, 0, HTTPC_RESULT_ERR_CLOSED, ERR_VAL);
+    }
+    if (req->request != NULL) {
+      /* response started: the request cannot be repeated any more */
+      pbuf_free(req->request);
+      req->request = NULL;
+    }
+    err = httpc_rx_response(req, pcb, &p, &result);
+    if (err == ERR_ABRT) {
+      return ERR_ABRT;
+    } else if (err != ERR_OK) {
+      /* the connection is out of sync: fail this request, resend the others */
+      err_t close_err;
+      httpc_pconn_dequeue(pconn);
+      close_err = httpc_pconn_restart(pconn, 1, HTTPC_RESULT_ERR_CLOSED, err);
+      httpc_close(req, result, req->rx_status, err);
+      return close_err;
+    }
+    if (req->parse_state != HTTPC_PARSE_DONE) {
+      LWIP_ASSERT("data left", p == NULL);
+      break;
+    }
+    /* response complete */
+    httpc_pconn_dequeue(pconn);
+    if (pconn->served < 0xFF) {
+      pconn->served++;
+    }
+    if (!req->keepalive) {
+      pconn->reusable = 0;
+    }
+    if (pconn->reqs == NULL) {
+      pconn->idle_ticks = HTTPC_IDLE_TIMEOUT;
+    }
+    httpc_close(req, HTTPC_RESULT_OK, req->rx_status, ERR_OK);
+    if (!pconn->reusable) {
+      if (p != NULL) {
+        altcp_recved(pcb, p->tot_len);
+        pbuf_free(p);
+      }
+      /* the server closes the connection: move on to a new one */
+      return httpc_pconn_restart(pconn, 1, HTTPC_RESULT_ERR_CLOSED, ERR_OK);
+    }
+  }
+  /* pipeline the next requests */
+  return httpc_pconn_output(pconn);
+}
+
+/** pooled connection tcp recv callback */
+static err_t
+httpc_pconn_recv(void *arg, struct altcp_pcb *pcb, struct pbuf *p, err_t r)
+{
+  httpc_pconn_t *pconn = (httpc_pconn_t *)arg;
+  err_t err;
+  LWIP_UNUSED_ARG(r);
+
+  httpc_pconn_rx = pconn;
+  err = httpc_pconn_recv_internal(pconn, pcb, p);
+  httpc_pconn_rx = NULL;
+  return err;
+}
+
+/** pooled connection tcp err callback */
+static void
+httpc_pconn_err(void *arg, err_t err)
+{
+  httpc_pconn_t *pconn = (httpc_pconn_t *)arg;
+  if (pconn != NULL) {
+    httpc_state_t *req = pconn->reqs;
+    /* pcb has already been deallocated */
+    pconn->pcb = NULL;
+    if ((req != NULL) && (req->request == NULL)) {
+      httpc_pconn_dequeue(pconn);
+    } else {
+      req = NULL;
+    }
+    httpc_pconn_restart(pconn, (err != ERR_ABRT) && pconn->served, HTTPC_RESULT_ERR_CLOSED, err);
+    httpc_close(req, HTTPC_RESULT_ERR_CLOSED, 0, err);
+  }
+}
+
+/** pooled connection tcp poll callback: request and idle timeout */
+static err_t
+httpc_pconn_poll(void *arg, struct altcp_pcb *pcb)
+{
+  httpc_pconn_t *pconn = (httpc_pconn_t *)arg;
+  LWIP_UNUSED_ARG(pcb);
+  if (pconn != NULL) {
+    httpc_state_t *req = pconn->reqs;
+    if (req == NULL) {
+      if (pconn->idle_ticks) {
+        pconn->idle_ticks--;
+      }
+      if (!pconn->idle_ticks) {
+        LWIP_DEBUGF(HTTPC_DEBUG_STATE, ("httpc: closing idle connection to %s\n", pconn->host));
+        return httpc_pconn_free(pconn);
+      }
+      return ERR_OK;
+    }
+    /* only the first request is timed, the others wait for it */
+    if (req->timeout_ticks) {
+      req->timeout_ticks--;
+    }
+    if (!req->timeout_ticks) {
+      err_t err;
+      httpc_pconn_dequeue(pconn);
+      err = httpc_pconn_restart(pconn, 0, HTTPC_RESULT_ERR_TIMEOUT, ERR_OK);
+      httpc_close(req, HTTPC_RESULT_ERR_TIMEOUT, 0, ERR_OK);
+      return err;
+    }
+    return httpc_pconn_output(pconn);
+  }
+  return ERR_OK;
+}
+
+/** pooled connection tcp sent callback */
+static err_t
+httpc_pconn_sent(void *arg, struct altcp_pcb *pcb, u16_t len)
+{
+  LWIP_UNUSED_ARG(pcb);
+  LWIP_UNUSED_ARG(len);
+  if (arg != NULL) {
+    return httpc_pconn_output((httpc_pconn_t *)arg);
+  }
+  return ERR_OK;
+}
+
+/** pooled connection tcp connected callback */
+static err_t
+httpc_pconn_connected(void *arg, struct altcp_pcb *pcb, err_t err)
+{
+  httpc_pconn_t *pconn = (httpc_pconn_t *)arg;
+  LWIP_UNUSED_ARG(pcb);
+  LWIP_UNUSED_ARG(err);
+
+  pconn->state = HTTPC_PCONN_CONNECTED;
+  return httpc_pconn_output(pconn);
+}
+
+/** Open a new pcb for a pooled connection to its remote address */
+static err_t
+httpc_pconn_connect(httpc_pconn_t *pconn)
+{
+  err_t err;
+
+  pconn->pcb = altcp_new(pconn->allocator);
+  if (pconn->pcb == NULL) {
+    return ERR_MEM;
+  }
+  altcp_arg(pconn->pcb, pconn);
+  altcp_recv(pconn->pcb, httpc_pconn_recv);
+  altcp_err(pconn->pcb, httpc_pconn_err);
+  altcp_poll(pconn->pcb, httpc_pconn_poll, HTTPC_POLL_INTERVAL);
+  altcp_sent(pconn->pcb, httpc_pconn_sent);
+  pconn->state = HTTPC_PCONN_CONNECTING;
+
+  err = altcp_connect(pconn->pcb, &pconn->remote_addr, pconn->remote_port, httpc_pconn_connected);
+  if (err != ERR_OK) {
+    LWIP_DEBUGF(HTTPC_DEBUG_WARN_STATE, ("tcp_connect failed: %d\n", (int)err));
+    httpc_pconn_close_pcb(pconn);
+  }
+  return err;
+}
+
+#if LWIP_DNS
+/** DNS callback for a pooled connection */
+static void
+httpc_pconn_dns_found(const char* hostname, const ip_addr_t *ipaddr, void *arg)
+{
+  httpc_pconn_t *pconn = (httpc_pconn_t *)arg;
+  err_t err;
+  httpc_result_t result;
+
+  LWIP_UNUSED_ARG(hostname);
+
+  if (ipaddr != NULL) {
+    pconn->remote_addr = *ipaddr;
+    err = httpc_pconn_connect(pconn);
+    if (err == ERR_OK) {
+      return;
+    }
+    result = HTTPC_RESULT_ERR_CONNECT;
+  } else {
+    LWIP_DEBUGF(HTTPC_DEBUG_WARN_STATE, ("httpc_dns_found: failed to resolve hostname: %s\n",
+      hostname));
+    result = HTTPC_RESULT_ERR_HOSTNAME;
+    err = ERR_ARG;
+  }
+  httpc_pconn_restart(pconn, 0, result, err);
+}
+#endif /* LWIP_DNS */
+
+/** Find the pooled connection for a request to 'host':'port'. In order of
+ * preference: an idle connection to the server, a busy one that pipelines,
+ * a new connection, one replacing an idle connection to another server and
+ * finally a busy connection where the request has to wait.
+ */
+static httpc_pconn_t *
+httpc_pconn_find(const char *host, u16_t port, const httpc_connection_t *settings)
+{
+  httpc_pconn_t *pipelined = NULL, *queued = NULL, *unused = NULL, *idle = NULL;
+  int i;
+
+#if !LWIP_ALTCP
+  LWIP_UNUSED_ARG(settings);
+#endif
+
+  for (i = 0; i < LWIP_HTTPC_POOL_SIZE; i++) {
+    httpc_pconn_t *pconn = &httpc_pconns[i];
+    if (pconn->state == HTTPC_PCONN_FREE) {
+      if (unused == NULL) {
+        unused = pconn;
+      }
+    } else if ((pconn->remote_port == port) && pconn->reusable &&
+#if LWIP_ALTCP
+               (pconn->allocator == settings->altcp_allocator) &&
+#endif
+               (pconn->num_reqs < LWIP_HTTPC_PIPELINE_MAX) && !strcmp(pconn->host, host)) {
+      if (pconn->num_reqs == 0) {
+        return pconn;
+      } else if ((pconn->state == HTTPC_PCONN_CONNECTED) && pconn->served) {
+        if ((pipelined == NULL) || (pconn->num_reqs < pipelined->num_reqs)) {
+          pipelined = pconn;
+        }
+      } else if ((queued == NULL) || (pconn->num_reqs < queued->num_reqs)) {
+        queued = pconn;
+      }
+    } else if ((pconn->reqs == NULL) && (pconn != httpc_pconn_rx)) {
+      idle = pconn;
+    }
+  }
+  if (pipelined != NULL) {
+    return pipelined;
+  } else if (unused != NULL) {
+    return unused;
+  } else if (idle != NULL) {
+    LWIP_DEBUGF(HTTPC_DEBUG_STATE, ("httpc: closing idle connection to %s\n", idle->host));
+    httpc_pconn_free(idle);
+    return idle;
+  }
+  return queued;
+}
+
+/** Queue a request on the pooled connection to 'host':'port', opening it if
+ * necessary. 'addr' is the server address or NULL to resolve 'host'. */
+static err_t
+httpc_pconn_enqueue(httpc_state_t *req, const httpc_connection_t *settings, const char *host,
+                    const ip_addr_t *addr, u16_t port)
+{
+  httpc_pconn_t *pconn = httpc_pconn_find(host, port, settings);
+  httpc_state_t **tail;
+  err_t err;
+
+  if (pconn == NULL) {
+    LWIP_DEBUGF(HTTPC_DEBUG_WARN_STATE, ("httpc: no connection available for %s\n", host));
+    return ERR_MEM;
+  }
+  req->pconn = pconn;
+  for (tail = &pconn->reqs; *tail != NULL; tail = &(*tail)->next);
+  *tail = req;
+  pconn->num_reqs++;
+  if (pconn->state != HTTPC_PCONN_FREE) {
+    /* errors are handled from the poll callback */
+    httpc_pconn_send(pconn);
+    return ERR_OK;
+  }
+
+  /* set up a new connection */
+  pconn->host = (char *)mem_malloc((mem_size_t)(strlen(host) + 1));
+  if (pconn->host == NULL) {
+    err = ERR_MEM;
+  } else {
+    MEMCPY(pconn->host, host, strlen(host) + 1);
+    pconn->remote_port = port;
+#if LWIP_ALTCP
+    pconn->allocator = settings->altcp_allocator;
+#endif
+    pconn->reusable = 1;
+    if (addr != NULL) {
+      pconn->remote_addr = *addr;
+      err = httpc_pconn_connect(pconn);
+    } else {
+      pconn->state = HTTPC_PCONN_RESOLVING;
+#if LWIP_DNS
+      err = dns_gethostbyname(host, &pconn->remote_addr, httpc_pconn_dns_found, pconn);
+#else
+      err = ipaddr_aton(host, &pconn->remote_addr) ? ERR_OK : ERR_ARG;
+#endif
+      if (err == ERR_OK) {
+        /* cached or IP-string */
+        err = httpc_pconn_connect(pconn);
+      } else if (err == ERR_INPROGRESS) {
+        err = ERR_OK;
+      }
+    }
+  }
+  if (err != ERR_OK) {
+    httpc_pconn_dequeue(pconn);
+    httpc_pconn_free(pconn);
+  }
+  return err;
+}
+#endif /* !LWIP_HTTPC_KEEPALIVE */
+
+/** Start the request: via a proxy, to 'server_addr' if given or to 'server_name' */
+static err_t
+httpc_start_request(httpc_state_t* req, const httpc_connection_t *settings, const char* server_name,
+                    const ip_addr_t *server_addr, u16_t server_port)
+{
+#if LWIP_HTTPC_KEEPALIVE
+  if (settings->use_proxy) {
+    return httpc_pconn_enqueue(req, settings, ipaddr_ntoa(&settings->proxy_addr), &settings->proxy_addr,
+      settings->proxy_port);
+  } else if (server_addr != NULL) {
+    return httpc_pconn_enqueue(req, settings, ipaddr_ntoa(server_addr), server_addr, server_port);
+  }
+  return httpc_pconn_enqueue(req, settings, server_name, NULL, server_port);
+#else /* LWIP_HTTPC_KEEPALIVE */
+  LWIP_UNUSED_ARG(server_port);
+  if (settings->use_proxy) {
+    return httpc_get_internal_addr(req, &settings->proxy_addr);
+  } else if (server_addr != NULL) {
+    return httpc_get_internal_addr(req, server_addr);
+  }
+  return httpc_get_internal_dns(req, server_name);
+#endif /* LWIP_HTTPC_KEEPALIVE */
+}
+
 static int
 httpc_create_request_string(const httpc_connection_t *settings, const char* server_name, int server_port, const char* uri,
                             int use_host, char *buffer, size_t buffer_size)
@@ -559,6 +1506,7 @@ httpc_init_connection_common(httpc_state_t **connection, const httpc_connection_
   req->uri = req->server_name + server_name_len + 1;
   memcpy(req->uri, uri, uri_len + 1);
 #endif
+#if !LWIP_HTTPC_KEEPALIVE
   req->pcb = altcp_new(settings->altcp_allocator);
   if(req->pcb == NULL) {
     httpc_free_state(req);
@@ -570,6 +1518,7 @@ httpc_init_connection_common(httpc_state_t **connection, const httpc_connection_
   altcp_err(req->pcb, httpc_tcp_err);
   altcp_poll(req->pcb, httpc_tcp_poll, HTTPC_POLL_INTERVAL);
   altcp_sent(req->pcb, httpc_tcp_sent);
+#endif /* !LWIP_HTTPC_KEEPALIVE */
 
   /* set up request buffer */
   req_len2 = httpc_create_request_string(settings, server_name, server_port, uri, use_host,
@@ -622,7 +1571,11 @@ httpc_init_connection_addr(httpc_state_t **connection, const httpc_connection_t
  * @param port tcp port of the server
  * @param uri uri to get from the server, remember leading "/"!
  * @param settings connection settings (callbacks, proxy, etc.)
- * @param recv_fn the http body (not the headers) are passed to this callback
+ * @param recv_fn the http body (not the headers) are passed to this callback.
+ *                With LWIP_HTTPC_KEEPALIVE, a chunked transfer encoding is
+ *                removed and the callback must return ERR_OK (or ERR_ABRT if
+ *                the pcb has been aborted), any other return value aborts
+ *                the request with HTTPC_RESULT_LOCAL_ABORT.
  * @param callback_arg argument passed to all the callbacks
  * @param connection retreives the connection handle (to match in callbacks)
  * @return ERR_OK if starting the request succeeds (callback_fn will be called later)
@@ -643,11 +1596,7 @@ httpc_get_file(const ip_addr_t* server_addr, u16_t port, const char* uri, const
     return err;
   }
 
-  if (settings->use_proxy) {
-    err = httpc_get_internal_addr(req, &settings->proxy_addr);
-  } else {
-    err = httpc_get_internal_addr(req, server_addr);
-  }
+  err = httpc_start_request(req, settings, NULL, server_addr, port);
   if(err != ERR_OK) {
     httpc_free_state(req);
     return err;
@@ -667,7 +1616,11 @@ httpc_get_file(const ip_addr_t* server_addr, u16_t port, const char* uri, const
  * @param port tcp port of the server
  * @param uri uri to get from the server, remember leading "/"!
  * @param settings connection settings (callbacks, proxy, etc.)
- * @param recv_fn the http body (not the headers) are passed to this callback
+ * @param recv_fn the http body (not the headers) are passed to this callback.
+ *                With LWIP_HTTPC_KEEPALIVE, a chunked transfer encoding is
+ *                removed and the callback must return ERR_OK (or ERR_ABRT if
+ *                the pcb has been aborted), any other return value aborts
+ *                the request with HTTPC_RESULT_LOCAL_ABORT.
  * @param callback_arg argument passed to all the callbacks
  * @param connection retreives the connection handle (to match in callbacks)
  * @return ERR_OK if starting the request succeeds (callback_fn will be called later)
@@ -687,11 +1640,7 @@ httpc_get_file_dns(const char* server_name, u16_t port, const char* uri, const h
     return err;
   }
 
-  if (settings->use_proxy) {
-    err = httpc_get_internal_addr(req, &settings->proxy_addr);
-  } else {
-    err = httpc_get_internal_dns(req, server_name);
-  }
+  err = httpc_start_request(req, settings, server_name, NULL, port);
   if(err != ERR_OK) {
     httpc_free_state(req);
     return err;
@@ -836,11 +1785,7 @@ httpc_get_file_to_disk(const ip_addr_t* server_addr, u16_t port, const char* uri
     return err;
   }
 
-  if (settings->use_proxy) {
-    err = httpc_get_internal_addr(req, &settings->proxy_addr);
-  } else {
-    err = httpc_get_internal_addr(req, server_addr);
-  }
+  err = httpc_start_request(req, settings, NULL, server_addr, port);
   if(err != ERR_OK) {
     httpc_fs_free(filestate);
     httpc_free_state(req);
@@ -888,11 +1833,7 @@ httpc_get_file_dns_to_disk(const char* server_name, u16_t port, const char* uri,
     return err;
   }
 
-  if (settings->use_proxy) {
-    err = httpc_get_internal_addr(req, &settings->proxy_addr);
-  } else {
-    err = httpc_get_internal_dns(req, server_name);
-  }
+  err = httpc_start_request(req, settings, server_name, NULL, port);
   if(err != ERR_OK) {
     httpc_fs_free(filestate);
     httpc_free_state(req);
@@ -95,6 +95,9 @@
 #include "lwip/apps/fs.h"
 #include "httpd_structs.h"
 #include "lwip/def.h"
+#if LWIP_HTTPD_WEBSOCKET
+#include "httpd_ws_priv.h"
+#endif /* LWIP_HTTPD_WEBSOCKET */
 
 #include "lwip/altcp.h"
 #include "lwip/altcp_tcp.h"
@@ -114,6 +117,10 @@
 
 #if LWIP_TCP && LWIP_CALLBACK_API
 
+#if LWIP_HTTPD_STREAMING_PARSER && LWIP_HTTPD_SUPPORT_REQUESTLIST
+#error "LWIP_HTTPD_STREAMING_PARSER never enqueues request pbufs, set LWIP_HTTPD_SUPPORT_REQUESTLIST to 0"
+#endif /* LWIP_HTTPD_STREAMING_PARSER && LWIP_HTTPD_SUPPORT_REQUESTLIST */
+
 /** Minimum length for a valid HTTP/0.9 request: "GET /\r\n" -> 7 bytes */
 #define MIN_REQ_LEN   7
 
@@ -204,6 +211,19 @@ static char http_uri_buf[LWIP_HTTPD_URI_BUF_LEN + 1];
 
 #define HTTPD_LAST_TAG_PART 0xFFFF
 
+#if LWIP_HTTPD_SSI_ASYNC
+/** A tag has been found and its insert is not completely sent yet: a pending
+ * insert at the end of the file must not end the response */
+#define HTTP_SSI_IS_SENDING_TAG(hs) (((hs)->ssi != NULL) && ((hs)->ssi->tag_state == TAG_SENDING))
+
+/* Values for struct http_ssi_state.async_state */
+#define HTTP_SSI_ASYNC_NONE     0 /* not waiting for the SSI handler */
+#define HTTP_SSI_ASYNC_PENDING  1 /* handler returned HTTPD_SSI_TAG_PENDING */
+#define HTTP_SSI_ASYNC_RESUME   2 /* httpd_ssi_continue() called, call the handler again */
+#else /* LWIP_HTTPD_SSI_ASYNC */
+#define HTTP_SSI_IS_SENDING_TAG(hs) 0
+#endif /* LWIP_HTTPD_SSI_ASYNC */
+
 enum tag_check_state {
   TAG_NONE,       /* Not processing an SSI tag */
   TAG_LEADIN,     /* Tag lead in "<!--#" being processed */
@@ -226,6 +246,10 @@ struct http_ssi_state {
 #endif /* LWIP_HTTPD_SSI_MULTIPART */
   u8_t tag_type; /* index into http_ssi_tag_desc array */
   u8_t tag_name_len; /* Length of the tag name in string tag_name */
+#if LWIP_HTTPD_SSI_ASYNC
+  u8_t async_state; /* HTTP_SSI_ASYNC_xxx */
+  struct http_state *next_pending; /* Entry in http_ssi_pending list */
+#endif /* LWIP_HTTPD_SSI_ASYNC */
   char tag_name[LWIP_HTTPD_MAX_TAG_NAME_LEN + 1]; /* Last tag name extracted */
   char tag_insert[LWIP_HTTPD_MAX_TAG_INSERT_LEN + 1]; /* Insert string for tag_name */
   enum tag_check_state tag_state; /* State of the tag processor */
@@ -236,8 +260,74 @@ struct http_ssi_tag_description {
   const char *lead_out;
 };
 
+#else /* LWIP_HTTPD_SSI */
+#define HTTP_SSI_IS_SENDING_TAG(hs) 0
 #endif /* LWIP_HTTPD_SSI */
 
+#if LWIP_HTTPD_STREAMING_PARSER
+
+enum http_parse_state {
+  HTTP_PARSE_METHOD = 0, /* Matching the request method */
+  HTTP_PARSE_URI,        /* Storing the URI */
+  HTTP_PARSE_VERSION,    /* Skipping the protocol version up to the end of the request line */
+  HTTP_PARSE_HDR_START,  /* At the start of a header line (or the empty line ending the headers) */
+  HTTP_PARSE_HDR_NAME,   /* Reading a header name up to ':' */
+  HTTP_PARSE_HDR_VALUE_WS, /* Skipping whitespace before a header value */
+  HTTP_PARSE_HDR_VALUE,  /* Reading a header value up to the end of the line */
+  HTTP_PARSE_HDR_EOL,    /* Skipping the line ending after a header value */
+  HTTP_PARSE_DONE,       /* Request line and headers are complete */
+  HTTP_PARSE_BAD_REQUEST,    /* Invalid request: respond with 400 */
+  HTTP_PARSE_NOT_IMPLEMENTED /* Unsupported method: respond with 501 */
+};
+
+#define HTTP_METHOD_GET   0
+#define HTTP_METHOD_POST  1
+
+/* Headers interpreted by httpd itself (bit index into hdr_match) */
+#define HTTP_PARSE_HDR_CONTENT_LEN  0
+#define HTTP_PARSE_HDR_CONNECTION   1
+#if LWIP_HTTPD_WEBSOCKET
+#define HTTP_PARSE_HDR_UPGRADE      2
+#define HTTP_PARSE_HDR_WS_KEY       3
+#define HTTP_PARSE_HDR_WS_VERSION   4
+#endif /* LWIP_HTTPD_WEBSOCKET */
+
+/* Flags for struct http_parser.flags */
+#define HTTP_PARSE_FLAG_IS_09           0x01U
+#define HTTP_PARSE_FLAG_CONTENT_LEN     0x02U /* valid Content-Length found */
+#define HTTP_PARSE_FLAG_CONTENT_LEN_BAD 0x04U /* invalid Content-Length found */
+#define HTTP_PARSE_FLAG_KEEPALIVE       0x08U /* "Connection: keep-alive" found */
+#define HTTP_PARSE_FLAG_CONN_UPGRADE    0x10U /* "Connection: Upgrade" found */
+#define HTTP_PARSE_FLAG_UPGRADE_WS      0x20U /* "Upgrade: websocket" found */
+#define HTTP_PARSE_FLAG_WS_VERSION      0x40U /* "Sec-WebSocket-Version: 13" found */
+
+/** State of the streaming request parser. Only the URI is stored, everything
+ * else is interpreted on the fly while scanning the received pbufs. */
+struct http_parser {
+  u32_t hdr_len;       /* Number of request bytes parsed up to now */
+  u32_t content_len;   /* Value of the Content-Length header */
+  u16_t uri_len;       /* Number of bytes stored in 'uri' */
+  u16_t pos;           /* Index into method/header name/value being matched */
+  u8_t state;          /* enum http_parse_state */
+  u8_t method;         /* HTTP_METHOD_xxx */
+  u8_t hdr_match;      /* Bitmask of known headers still matching the current name */
+  u8_t hdr;            /* Known header the current value belongs to (0xff: none) */
+  u8_t tok_match;      /* Bitmask of value tokens still matching the current token */
+  u8_t flags;          /* HTTP_PARSE_FLAG_xxx */
+  char uri[LWIP_HTTPD_STREAMING_MAX_URI_LEN + 1];
+#if LWIP_HTTPD_WEBSOCKET
+  u8_t ws_handler;     /* Index + 1 of the WebSocket handler to upgrade to (0: none) */
+  u8_t ws_key_len;
+  char ws_key[HTTPD_WS_KEY_LEN + 1];
+  u16_t ws_data_offset; /* Offset of the first frame byte in the last received pbuf */
+#endif /* LWIP_HTTPD_WEBSOCKET */
+#if LWIP_HTTPD_HEADER_CALLBACK
+  u8_t name_len;
+  char name[LWIP_HTTPD_MAX_HEADER_NAME_LEN + 1];
+#endif /* LWIP_HTTPD_HEADER_CALLBACK */
+};
+#endif /* LWIP_HTTPD_STREAMING_PARSER */
+
 struct http_state {
 #if LWIP_HTTPD_KILL_OLD_ON_CONNECTIONS_EXCEEDED
   struct http_state *next;
@@ -250,12 +340,18 @@ struct http_state {
 #if LWIP_HTTPD_SUPPORT_REQUESTLIST
   struct pbuf *req;
 #endif /* LWIP_HTTPD_SUPPORT_REQUESTLIST */
+#if LWIP_HTTPD_STREAMING_PARSER
+  struct http_parser parser;
+#endif /* LWIP_HTTPD_STREAMING_PARSER */
 
 #if LWIP_HTTPD_DYNAMIC_FILE_READ
   char *buf;        /* File read buffer. */
   int buf_len;      /* Size of file read buffer, buf. */
 #endif /* LWIP_HTTPD_DYNAMIC_FILE_READ */
   u32_t left;       /* Number of unsent bytes in buf. */
+#if LWIP_HTTPD_WEBSOCKET
+  u32_t unacked;    /* Number of written bytes not acknowledged yet */
+#endif /* LWIP_HTTPD_WEBSOCKET */
   u8_t retries;
 #if LWIP_HTTPD_SUPPORT_11_KEEPALIVE
   u8_t keepalive;
@@ -266,6 +362,11 @@ struct http_state {
 #if LWIP_HTTPD_CGI
   char *params[LWIP_HTTPD_MAX_CGI_PARAMETERS]; /* Params extracted from the request URI */
   char *param_vals[LWIP_HTTPD_MAX_CGI_PARAMETERS]; /* Values for each extracted param */
+#if LWIP_HTTPD_CGI_ASYNC
+  struct http_state *next_cgi_pending; /* Entry in http_cgi_waiting list */
+  u8_t cgi_pending; /* 1 while waiting for httpd_cgi_continue() */
+  u8_t cgi_is_09;   /* is_09 of the pending request */
+#endif /* LWIP_HTTPD_CGI_ASYNC */
 #endif /* LWIP_HTTPD_CGI */
 #if LWIP_HTTPD_DYNAMIC_HEADERS
   const char *hdrs[NUM_FILE_HDR_STRINGS]; /* HTTP headers to be sent. */
@@ -322,6 +423,12 @@ static tSSIHandler httpd_ssi_handler;
 static int httpd_num_tags;
 static const char **httpd_tags;
 #endif /* !LWIP_HTTPD_SSI_RAW */
+#if LWIP_HTTPD_SSI_ASYNC
+/** Connections waiting for httpd_ssi_continue() */
+static struct http_state *http_ssi_pending;
+/** Connection whose SSI handler is currently running */
+static struct http_state *http_ssi_calling;
+#endif /* LWIP_HTTPD_SSI_ASYNC */
 
 /* Define the available tag lead-ins and corresponding lead-outs.
  * ATTENTION: for the algorithm below using this array, it is essential
@@ -340,9 +447,21 @@ static int httpd_num_cgis;
 static int http_cgi_paramcount;
 #define http_cgi_params     hs->params
 #define http_cgi_param_vals hs->param_vals
+#if LWIP_HTTPD_CGI_ASYNC
+/** Returned by a CGI handler to defer the response (HTTPD_CGI_PENDING) */
+const char httpd_cgi_pending[] = "";
+/** Connections waiting for httpd_cgi_continue() */
+static struct http_state *http_cgi_waiting;
+#define HTTP_CGI_IS_PENDING(hs) ((hs)->cgi_pending)
+#else /* LWIP_HTTPD_CGI_ASYNC */
+#define HTTP_CGI_IS_PENDING(hs) 0
+#endif /* LWIP_HTTPD_CGI_ASYNC */
 #elif LWIP_HTTPD_CGI_SSI
 static char *http_cgi_params[LWIP_HTTPD_MAX_CGI_PARAMETERS]; /* Params extracted from the request URI */
 static char *http_cgi_param_vals[LWIP_HTTPD_MAX_CGI_PARAMETERS]; /* Values for each extracted param */
+#define HTTP_CGI_IS_PENDING(hs) 0
+#else /* LWIP_HTTPD_CGI */
+#define HTTP_CGI_IS_PENDING(hs) 0
 #endif /* LWIP_HTTPD_CGI */
 
 #if LWIP_HTTPD_KILL_OLD_ON_CONNECTIONS_EXCEEDED
@@ -438,8 +557,49 @@ http_ssi_state_free(struct http_ssi_state *ssi)
     HTTP_FREE_SSI_STATE(ssi);
   }
 }
+
+#if LWIP_HTTPD_SSI_ASYNC
+/** Remove a connection from the list of connections waiting for
+ * httpd_ssi_continue().
+ * @return 1 if the connection was found, 0 otherwise
+ */
+static u8_t
+http_ssi_remove_pending(struct http_state *hs)
+{
+  struct http_state **iter;
+  for (iter = &http_ssi_pending; *iter != NULL; iter = &(*iter)->ssi->next_pending) {
+    if (*iter == hs) {
+      *iter = hs->ssi->next_pending;
+      hs->ssi->next_pending = NULL;
+      return 1;
+    }
+  }
+  return 0;
+}
+#endif /* LWIP_HTTPD_SSI_ASYNC */
 #endif /* LWIP_HTTPD_SSI */
 
+#if LWIP_HTTPD_CGI && LWIP_HTTPD_CGI_ASYNC
+/** Remove a connection from the list of connections waiting for
+ * httpd_cgi_continue().
+ * @return 1 if the connection was found, 0 otherwise
+ */
+static u8_t
+http_cgi_remove_pending(struct http_state *hs)
+{
+  struct http_state **iter;
+  for (iter = &http_cgi_waiting; *iter != NULL; iter = &(*iter)->next_cgi_pending) {
+    if (*iter == hs) {
+      *iter = hs->next_cgi_pending;
+      hs->next_cgi_pending = NULL;
+      hs->cgi_pending = 0;
+      return 1;
+    }
+  }
+  return 0;
+}
+#endif /* LWIP_HTTPD_CGI && LWIP_HTTPD_CGI_ASYNC */
+
 /** Initialize a struct http_state.
  */
 static void
@@ -495,10 +655,20 @@ http_state_eof(struct http_state *hs)
 #endif /* LWIP_HTTPD_DYNAMIC_FILE_READ */
 #if LWIP_HTTPD_SSI
   if (hs->ssi) {
+#if LWIP_HTTPD_SSI_ASYNC
+    /* ignore httpd_ssi_continue() for this connection from now on */
+    http_ssi_remove_pending(hs);
+#endif /* LWIP_HTTPD_SSI_ASYNC */
     http_ssi_state_free(hs->ssi);
     hs->ssi = NULL;
   }
 #endif /* LWIP_HTTPD_SSI */
+#if LWIP_HTTPD_CGI && LWIP_HTTPD_CGI_ASYNC
+  if (hs->cgi_pending) {
+    /* ignore httpd_cgi_continue() for this connection from now on */
+    http_cgi_remove_pending(hs);
+  }
+#endif /* LWIP_HTTPD_CGI && LWIP_HTTPD_CGI_ASYNC */
 #if LWIP_HTTPD_SUPPORT_REQUESTLIST
   if (hs->req) {
     pbuf_free(hs->req);
@@ -522,6 +692,7 @@ http_state_free(struct http_state *hs)
 
 /** Call tcp_write() in a loop trying smaller and smaller length
  *
+ * @param hs connection state
  * @param pcb altcp_pcb to send
  * @param ptr Data to send
  * @param length Length of data to send (in/out: on return, contains the
@@ -530,10 +701,11 @@ http_state_free(struct http_state *hs)
  * @return the return value of tcp_write
  */
 static err_t
-http_write(struct altcp_pcb *pcb, const void *ptr, u16_t *length, u8_t apiflags)
+http_write(struct http_state *hs, struct altcp_pcb *pcb, const void *ptr, u16_t *length, u8_t apiflags)
 {
   u16_t len, max_len;
   err_t err;
+  LWIP_UNUSED_ARG(hs); /* used with LWIP_HTTPD_WEBSOCKET only */
   LWIP_ASSERT("length != NULL", length != NULL);
   len = *length;
   if (len == 0) {
@@ -570,6 +742,9 @@ http_write(struct altcp_pcb *pcb, const void *ptr, u16_t *length, u8_t apiflags)
   if (err == ERR_OK) {
     LWIP_DEBUGF(HTTPD_DEBUG | LWIP_DBG_TRACE, ("Sent %d bytes\n", len));
     *length = len;
+#if LWIP_HTTPD_WEBSOCKET
+    hs->unacked += len;
+#endif /* LWIP_HTTPD_WEBSOCKET */
   } else {
     LWIP_DEBUGF(HTTPD_DEBUG | LWIP_DBG_TRACE, ("Send failed with err %d (\"%s\")\n", err, lwip_strerr(err)));
     *length = 0;
@@ -657,6 +832,9 @@ http_eof(struct altcp_pcb *pcb, struct http_state *hs)
   /* HTTP/1.1 persistent connection? (Not supported for SSI) */
 #if LWIP_HTTPD_SUPPORT_11_KEEPALIVE
   if (hs->keepalive) {
+#if LWIP_HTTPD_WEBSOCKET
+    u32_t unacked = hs->unacked;
+#endif /* LWIP_HTTPD_WEBSOCKET */
     http_remove_connection(hs);
 
     http_state_eof(hs);
@@ -664,6 +842,9 @@ http_eof(struct altcp_pcb *pcb, struct http_state *hs)
     /* restore state: */
     hs->pcb = pcb;
     hs->keepalive = 1;
+#if LWIP_HTTPD_WEBSOCKET
+    hs->unacked = unacked;
+#endif /* LWIP_HTTPD_WEBSOCKET */
     http_add_connection(hs);
     /* ensure nagle doesn't interfere with sending all data as fast as possible: */
     altcp_nagle_disable(pcb);
@@ -785,6 +966,11 @@ get_tag_insert(struct http_state *hs)
       && httpd_tags && httpd_num_tags
 #endif /* !LWIP_HTTPD_SSI_RAW */
      ) {
+#if LWIP_HTTPD_SSI_ASYNC
+    /* the handler may call httpd_ssi_continue() before returning */
+    ssi->async_state = HTTP_SSI_ASYNC_NONE;
+    http_ssi_calling = hs;
+#endif /* LWIP_HTTPD_SSI_ASYNC */
 
     /* Find this tag in the list we have been provided. */
 #if LWIP_HTTPD_SSI_RAW
@@ -802,7 +988,29 @@ get_tag_insert(struct http_state *hs)
 #if LWIP_HTTPD_FILE_STATE
                                               , (hs->handle ? hs->handle->state : NULL)
 #endif /* LWIP_HTTPD_FILE_STATE */
+#if LWIP_HTTPD_SSI_ASYNC
+                                              , hs
+#endif /* LWIP_HTTPD_SSI_ASYNC */
                                              );
+#if LWIP_HTTPD_SSI_ASYNC
+        http_ssi_calling = NULL;
+        if (ssi->tag_insert_len == HTTPD_SSI_TAG_PENDING) {
+          /* no data yet: suspend sending until httpd_ssi_continue() is called,
+             then call the handler again for the same tag part */
+          ssi->tag_insert_len = 0;
+#if LWIP_HTTPD_SSI_MULTIPART
+          ssi->tag_part = current_tag_part;
+#endif /* LWIP_HTTPD_SSI_MULTIPART */
+          if (ssi->async_state != HTTP_SSI_ASYNC_RESUME) {
+            LWIP_DEBUGF(HTTPD_DEBUG, ("SSI tag %s pending\n", ssi->tag_name));
+            ssi->async_state = HTTP_SSI_ASYNC_PENDING;
+            ssi->next_pending = http_ssi_pending;
+            http_ssi_pending = hs;
+          }
+          return;
+        }
+        ssi->async_state = HTTP_SSI_ASYNC_NONE;
+#endif /* LWIP_HTTPD_SSI_ASYNC */
 #if LWIP_HTTPD_SSI_RAW
         if (ssi->tag_insert_len != HTTPD_SSI_TAG_UNKNOWN)
 #endif /* LWIP_HTTPD_SSI_RAW */
@@ -1033,7 +1241,7 @@ http_send_headers(struct altcp_pcb *pcb, struct http_state *hs)
     if (hs->hdr_index < NUM_FILE_HDR_STRINGS - 1) {
       apiflags |= TCP_WRITE_FLAG_MORE;
     }
-    err = http_write(pcb, ptr, &sendlen, apiflags);
+    err = http_write(hs, pcb, ptr, &sendlen, apiflags);
     if ((err == ERR_OK) && (old_sendlen != sendlen)) {
       /* Remember that we added some more data to be transmitted. */
       data_to_send = HTTP_DATA_TO_SEND_CONTINUE;
@@ -1199,7 +1407,7 @@ http_send_data_nonssi(struct altcp_pcb *pcb, struct http_state *hs)
    * Just send the data as we received it from the file. */
   len = (u16_t)LWIP_MIN(hs->left, 0xffff);
 
-  err = http_write(pcb, hs->file, &len, HTTP_IS_DATA_VOLATILE(hs));
+  err = http_write(hs, pcb, hs->file, &len, HTTP_IS_DATA_VOLATILE(hs));
   if (err == ERR_OK) {
     data_to_send = 1;
     hs->file += len;
@@ -1237,7 +1445,7 @@ http_send_data_ssi(struct altcp_pcb *pcb, struct http_state *hs)
   if (ssi->parsed > hs->file) {
     len = (u16_t)LWIP_MIN(ssi->parsed - hs->file, 0xffff);
 
-    err = http_write(pcb, hs->file, &len, HTTP_IS_DATA_VOLATILE(hs));
+    err = http_write(hs, pcb, hs->file, &len, HTTP_IS_DATA_VOLATILE(hs));
     if (err == ERR_OK) {
       data_to_send = 1;
       hs->file += len;
@@ -1413,7 +1621,7 @@ http_send_data_ssi(struct altcp_pcb *pcb, struct http_state *hs)
               len = (u16_t)LWIP_MIN(ssi->tag_started - hs->file, 0xffff);
 #endif /* LWIP_HTTPD_SSI_INCLUDE_TAG*/
 
-              err = http_write(pcb, hs->file, &len, HTTP_IS_DATA_VOLATILE(hs));
+              err = http_write(hs, pcb, hs->file, &len, HTTP_IS_DATA_VOLATILE(hs));
               if (err == ERR_OK) {
                 data_to_send = 1;
 #if !LWIP_HTTPD_SSI_INCLUDE_TAG
@@ -1454,7 +1662,7 @@ http_send_data_ssi(struct altcp_pcb *pcb, struct http_state *hs)
           len = (u16_t)LWIP_MIN(ssi->tag_started - hs->file, 0xffff);
 #endif /* LWIP_HTTPD_SSI_INCLUDE_TAG*/
           if (len != 0) {
-            err = http_write(pcb, hs->file, &len, HTTP_IS_DATA_VOLATILE(hs));
+            err = http_write(hs, pcb, hs->file, &len, HTTP_IS_DATA_VOLATILE(hs));
           } else {
             err = ERR_OK;
           }
@@ -1470,6 +1678,17 @@ http_send_data_ssi(struct altcp_pcb *pcb, struct http_state *hs)
             hs->left -= len;
           }
         } else {
+#if LWIP_HTTPD_SSI_ASYNC
+          if (ssi->async_state == HTTP_SSI_ASYNC_RESUME) {
+            /* data is available now, call the handler again */
+            ssi->tag_index = 0;
+            get_tag_insert(hs);
+          }
+          if (ssi->async_state == HTTP_SSI_ASYNC_PENDING) {
+            /* wait for httpd_ssi_continue() */
+            return data_to_send;
+          }
+#endif /* LWIP_HTTPD_SSI_ASYNC */
 #if LWIP_HTTPD_SSI_MULTIPART
           if (ssi->tag_index >= ssi->tag_insert_len) {
             /* Did the last SSIHandler have more to send? */
@@ -1491,7 +1710,7 @@ http_send_data_ssi(struct altcp_pcb *pcb, struct http_state *hs)
              * single tag insert buffer per connection. If we don't do
              * this, insert corruption can occur if more than one insert
              * is processed before we call tcp_output. */
-            err = http_write(pcb, &(ssi->tag_insert[ssi->tag_index]), &len,
+            err = http_write(hs, pcb, &(ssi->tag_insert[ssi->tag_index]), &len,
                              HTTP_IS_TAG_VOLATILE(hs));
             if (err == ERR_OK) {
               data_to_send = 1;
@@ -1538,7 +1757,7 @@ http_send_data_ssi(struct altcp_pcb *pcb, struct http_state *hs)
       len = (u16_t)LWIP_MIN(ssi->parsed - hs->file, 0xffff);
     }
 
-    err = http_write(pcb, hs->file, &len, HTTP_IS_DATA_VOLATILE(hs));
+    err = http_write(hs, pcb, hs->file, &len, HTTP_IS_DATA_VOLATILE(hs));
     if (err == ERR_OK) {
       data_to_send = 1;
       hs->file += len;
@@ -1574,6 +1793,11 @@ http_send(struct altcp_pcb *pcb, struct http_state *hs)
     return 0;
   }
 
+  /* Nothing to send while waiting for an async CGI handler */
+  if (HTTP_CGI_IS_PENDING(hs)) {
+    return 0;
+  }
+
 #if LWIP_HTTPD_FS_ASYNC_READ
   /* Check if we are allowed to read from this file.
      (e.g. SSI might want to delay sending until data is available) */
@@ -1595,8 +1819,8 @@ http_send(struct altcp_pcb *pcb, struct http_state *hs)
 #endif /* LWIP_HTTPD_DYNAMIC_HEADERS */
 
   /* Have we run out of file data to send? If so, we need to read the next
-   * block from the file. */
-  if (hs->left == 0) {
+   * block from the file (unless an async SSI insert is still pending). */
+  if ((hs->left == 0) && !HTTP_SSI_IS_SENDING_TAG(hs)) {
     if (!http_check_eof(pcb, hs)) {
       return 0;
     }
@@ -1611,7 +1835,7 @@ http_send(struct altcp_pcb *pcb, struct http_state *hs)
     data_to_send = http_send_data_nonssi(pcb, hs);
   }
 
-  if ((hs->left == 0) && (fs_bytes_left(hs->handle) <= 0)) {
+  if ((hs->left == 0) && (fs_bytes_left(hs->handle) <= 0) && !HTTP_SSI_IS_SENDING_TAG(hs)) {
     /* We reached the end of the file so this request is done.
      * This adds the FIN flag right into the last data segment. */
     LWIP_DEBUGF(HTTPD_DEBUG, ("End of file.\n"));
@@ -1767,6 +1991,68 @@ http_post_rxpbuf(struct http_state *hs, struct pbuf *p)
   return ERR_OK;
 }
 
+/** Sub-function of the request parser: let the application accept or deny
+ * the POST request and pass it the part of the body already received.
+ *
+ * @param p The input pbuf containing the start of the body (may also be the
+ *          end of the request header).
+ * @param start_offset Offset in 'p' where the body starts.
+ * @param hs The http connection state.
+ * @param uri The HTTP URI (NULL-terminated).
+ * @param http_request HTTP request header passed to httpd_post_begin (or NULL).
+ * @param http_request_len Size of 'http_request'.
+ * @param content_len Content-Length parsed from the header
+ * @return ERR_OK: POST accepted by the application (or response file found
+ *         after the application denied it); another err_t otherwise
+ */
+static err_t
+http_post_request_begin(struct pbuf *p, u16_t start_offset, struct http_state *hs,
+                        const char *uri, const char *http_request,
+                        u16_t http_request_len, u32_t content_len)
+{
+  err_t err;
+  u8_t post_auto_wnd = 1;
+  http_uri_buf[0] = 0;
+  err = httpd_post_begin(hs, uri, http_request, http_request_len, (int)content_len,
+                         http_uri_buf, LWIP_HTTPD_URI_BUF_LEN, &post_auto_wnd);
+  if (err == ERR_OK) {
+    /* try to pass in data of the first pbuf(s) */
+    struct pbuf *q = p;
+#if LWIP_HTTPD_POST_MANUAL_WND
+    hs->no_auto_wnd = !post_auto_wnd;
+#endif /* LWIP_HTTPD_POST_MANUAL_WND */
+    /* set the Content-Length to be received for this POST */
+    hs->post_content_len_left = content_len;
+
+    /* get to the pbuf where the body starts */
+    while ((q != NULL) && (q->len <= start_offset)) {
+      start_offset -= q->len;
+      q = q->next;
+    }
+    if (q != NULL) {
+      /* hide the remaining HTTP header */
+      pbuf_remove_header(q, start_offset);
+#if LWIP_HTTPD_POST_MANUAL_WND
+      if (!post_auto_wnd) {
+        /* already tcp_recved() this data... */
+        hs->unrecved_bytes = q->tot_len;
+      }
+#endif /* LWIP_HTTPD_POST_MANUAL_WND */
+      pbuf_ref(q);
+      return http_post_rxpbuf(hs, q);
+    } else if (hs->post_content_len_left == 0) {
+      q = pbuf_alloc(PBUF_RAW, 0, PBUF_REF);
+      return http_post_rxpbuf(hs, q);
+    } else {
+      return ERR_OK;
+    }
+  } else {
+    /* return file passed from application */
+    return http_find_file(hs, http_uri_buf, 0);
+  }
+}
+
+#if !LWIP_HTTPD_STREAMING_PARSER
 /** Handle a post request. Called from http_parse_request when method 'POST'
  * is found.
  *
@@ -1785,7 +2071,6 @@ static err_t
 http_post_request(struct pbuf *inp, struct http_state *hs,
                   char *data, u16_t data_len, char *uri, char *uri_end)
 {
-  err_t err;
   /* search for end-of-header (first double-CRLF) */
   char *crlfcrlf = lwip_strnstr(uri_end + 1, CRLF CRLF, data_len - (uri_end + 1 - data));
 
@@ -1812,48 +2097,10 @@ http_post_request(struct pbuf *inp, struct http_state *hs,
           const char *hdr_start_after_uri = uri_end + 1;
           u16_t hdr_len = (u16_t)LWIP_MIN(data_len, crlfcrlf + 4 - data);
           u16_t hdr_data_len = (u16_t)LWIP_MIN(data_len, crlfcrlf + 4 - hdr_start_after_uri);
-          u8_t post_auto_wnd = 1;
-          http_uri_buf[0] = 0;
           /* trim http header */
           *crlfcrlf = 0;
-          err = httpd_post_begin(hs, uri, hdr_start_after_uri, hdr_data_len, content_len,
-                                 http_uri_buf, LWIP_HTTPD_URI_BUF_LEN, &post_auto_wnd);
-          if (err == ERR_OK) {
-            /* try to pass in data of the first pbuf(s) */
-            struct pbuf *q = inp;
-            u16_t start_offset = hdr_len;
-#if LWIP_HTTPD_POST_MANUAL_WND
-            hs->no_auto_wnd = !post_auto_wnd;
-#endif /* LWIP_HTTPD_POST_MANUAL_WND */
-            /* set the Content-Length to be received for this POST */
-            hs->post_content_len_left = (u32_t)content_len;
-
-            /* get to the pbuf where the body starts */
-            while ((q != NULL) && (q->len <= start_offset)) {
-              start_offset -= q->len;
-              q = q->next;
-            }
-            if (q != NULL) {
-              /* hide the remaining HTTP header */
-              pbuf_remove_header(q, start_offset);
-#if LWIP_HTTPD_POST_MANUAL_WND
-              if (!post_auto_wnd) {
-                /* already tcp_recved() this data... */
-                hs->unrecved_bytes = q->tot_len;
-              }
-#endif /* LWIP_HTTPD_POST_MANUAL_WND */
-              pbuf_ref(q);
-              return http_post_rxpbuf(hs, q);
-            } else if (hs->post_content_len_left == 0) {
-              q = pbuf_alloc(PBUF_RAW, 0, PBUF_REF);
-              return http_post_rxpbuf(hs, q);
-            } else {
-              return ERR_OK;
-            }
-          } else {
-            /* return file passed from application */
-            return http_find_file(hs, http_uri_buf, 0);
-          }
+          return http_post_request_begin(inp, hdr_len, hs, uri, hdr_start_after_uri,
+                                         hdr_data_len, (u32_t)content_len);
         } else {
           LWIP_DEBUGF(HTTPD_DEBUG, ("POST received invalid Content-Length: %s\n",
                                     content_len_num));
@@ -1874,6 +2121,7 @@ http_post_request(struct pbuf *inp, struct http_state *hs,
   return ERR_ARG;
 #endif /* LWIP_HTTPD_SUPPORT_REQUESTLIST */
 }
+#endif /* !LWIP_HTTPD_STREAMING_PARSER */
 
 #if LWIP_HTTPD_POST_MANUAL_WND
 /**
@@ -1937,6 +2185,468 @@ http_continue(void *connection)
 }
 #endif /* LWIP_HTTPD_FS_ASYNC_READ */
 
+#if LWIP_HTTPD_STREAMING_PARSER
+/** Request methods accepted by the streaming parser (index is HTTP_METHOD_xxx) */
+static const char *const http_parse_methods[] = {
+  "GET",
+#if LWIP_HTTPD_SUPPORT_POST
+  "POST"
+#endif /* LWIP_HTTPD_SUPPORT_POST */
+};
+
+/** A string the parser matches character by character, with its length
+ * precomputed so matching does not need strlen() per input character */
+struct http_parse_str {
+  const char *name;    /* lower case string */
+  u8_t len;            /* strlen(name) */
+};
+#define HTTP_PARSE_STR(s) {s, (u8_t)(sizeof(s) - 1)}
+
+/** Headers interpreted by httpd (index is HTTP_PARSE_HDR_xxx) */
+static const struct http_parse_str http_parse_hdr_names[] = {
+  HTTP_PARSE_STR("content-length"),
+  HTTP_PARSE_STR("connection")
+#if LWIP_HTTPD_WEBSOCKET
+  , HTTP_PARSE_STR("upgrade"),
+  HTTP_PARSE_STR("sec-websocket-key"),
+  HTTP_PARSE_STR("sec-websocket-version")
+#endif /* LWIP_HTTPD_WEBSOCKET */
+};
+#define HTTP_PARSE_HDR_NONE       0xff
+#define HTTP_PARSE_HDR_MATCH_ALL  ((u8_t)((1U << LWIP_ARRAYSIZE(http_parse_hdr_names)) - 1))
+
+/** A comma separated token in the value of a header known to httpd */
+struct http_parse_token {
+  u8_t hdr;            /* HTTP_PARSE_HDR_xxx the token is valid for */
+  u8_t flag;           /* HTTP_PARSE_FLAG_xxx to set when the token is found */
+  struct http_parse_str str;
+};
+
+static const struct http_parse_token http_parse_tokens[] = {
+  {HTTP_PARSE_HDR_CONNECTION, HTTP_PARSE_FLAG_KEEPALIVE, HTTP_PARSE_STR("keep-alive")}
+#if LWIP_HTTPD_WEBSOCKET
+  , {HTTP_PARSE_HDR_CONNECTION, HTTP_PARSE_FLAG_CONN_UPGRADE, HTTP_PARSE_STR("upgrade")},
+  {HTTP_PARSE_HDR_UPGRADE, HTTP_PARSE_FLAG_UPGRADE_WS, HTTP_PARSE_STR("websocket")},
+  {HTTP_PARSE_HDR_WS_VERSION, HTTP_PARSE_FLAG_WS_VERSION, HTTP_PARSE_STR("13")}
+#endif /* LWIP_HTTPD_WEBSOCKET */
+};
+#define HTTP_PARSE_TOKEN_MATCH_ALL ((u8_t)((1U << LWIP_ARRAYSIZE(http_parse_tokens)) - 1))
+
+/* The largest Content-Length we can pass to httpd_post_begin (as int) */
+#define HTTP_PARSE_MAX_CONTENT_LEN_DIV10 ((0x7FFFFFFFUL - 9) / 10)
+
+/** Sub-function of http_parse_segment(): match one character of a header name
+ * against the headers interpreted by httpd. */
+static void
+http_parse_header_name(struct http_parser *parser, char c)
+{
+  u8_t i;
+  char lc = (char)lwip_tolower(c);
+  for (i = 0; i < LWIP_ARRAYSIZE(http_parse_hdr_names); i++) {
+    if ((parser->hdr_match & (1U << i)) &&
+        ((parser->pos >= http_parse_hdr_names[i].len) ||
+         (http_parse_hdr_names[i].name[parser->pos] != lc))) {
+      parser->hdr_match &= (u8_t)~(1U << i);
+    }
+  }
+  if (parser->pos < 0xFFFF) {
+    parser->pos++;
+  }
+#if LWIP_HTTPD_HEADER_CALLBACK
+  if (parser->name_len < LWIP_HTTPD_MAX_HEADER_NAME_LEN) {
+    parser->name[parser->name_len++] = c;
+  }
+#endif /* LWIP_HTTPD_HEADER_CALLBACK */
+}
+
+/** Sub-function of http_parse_header_value(): a token in a header value is
+ * complete, set the flag of the token that matched (if any). */
+static void
+http_parse_token_end(struct http_parser *parser)
+{
+  u8_t i;
+  if (parser->pos > 0) {
+    for (i = 0; i < LWIP_ARRAYSIZE(http_parse_tokens); i++) {
+      if ((parser->tok_match & (1U << i)) &&
+          (parser->pos == http_parse_tokens[i].str.len)) {
+        parser->flags |= http_parse_tokens[i].flag;
+      }
+    }
+  }
+  parser->pos = 0;
+  parser->tok_match = HTTP_PARSE_TOKEN_MATCH_ALL;
+}
+
+/** Sub-function of http_parse_header_value(): match one character of a
+ * comma separated header value against the tokens known to httpd. */
+static void
+http_parse_token(struct http_parser *parser, char c)
+{
+  u8_t i;
+  char lc;
+  if ((c == ',') || (c == ' ') || (c == '\t')) {
+    http_parse_token_end(parser);
+    return;
+  }
+  lc = (char)lwip_tolower(c);
+  for (i = 0; i < LWIP_ARRAYSIZE(http_parse_tokens); i++) {
+    if ((parser->tok_match & (1U << i)) &&
+        ((http_parse_tokens[i].hdr != parser->hdr) ||
+         (parser->pos >= http_parse_tokens[i].str.len) ||
+         (http_parse_tokens[i].str.name[parser->pos] != lc))) {
+      parser->tok_match &= (u8_t)~(1U << i);
+    }
+  }
+  if (parser->pos < 0xFFFF) {
+    parser->pos++;
+  }
+}
+
+/** Sub-function of http_parse_segment(): interpret one character of the value
+ * of a header known to httpd. */
+static void
+http_parse_header_value(struct http_parser *parser, char c)
+{
+  switch (parser->hdr) {
+    case HTTP_PARSE_HDR_CONTENT_LEN:
+      if (lwip_isdigit(c)) {
+        if (parser->content_len > HTTP_PARSE_MAX_CONTENT_LEN_DIV10) {
+          parser->flags |= HTTP_PARSE_FLAG_CONTENT_LEN_BAD;
+        } else {
+          parser->content_len = parser->content_len * 10 + (u32_t)(c - '0');
+          parser->pos++;
+        }
+      } else if ((c != ' ') && (c != '\t')) {
+        parser->flags |= HTTP_PARSE_FLAG_CONTENT_LEN_BAD;
+      }
+      break;
+#if LWIP_HTTPD_WEBSOCKET
+    case HTTP_PARSE_HDR_WS_KEY:
+      if ((c != ' ') && (c != '\t')) {
+        if (parser->ws_key_len < HTTPD_WS_KEY_LEN) {
+          parser->ws_key[parser->ws_key_len] = c;
+        }
+        if (parser->ws_key_len < 0xFF) {
+          /* too long (or duplicate) keys are detected by the length */
+          parser->ws_key_len++;
+        }
+      }
+      break;
+#endif /* LWIP_HTTPD_WEBSOCKET */
+    default:
+      http_parse_token(parser, c);
+      break;
+  }
+}
+
+/** Sub-function of http_parse_segment(): the value of a header is complete */
+static void
+http_parse_header_end(struct http_parser *parser)
+{
+  if (parser->hdr == HTTP_PARSE_HDR_CONTENT_LEN) {
+    if ((parser->pos == 0) || (parser->flags & HTTP_PARSE_FLAG_CONTENT_LEN)) {
+      /* empty or duplicate Content-Length */
+      parser->flags |= HTTP_PARSE_FLAG_CONTENT_LEN_BAD;
+    }
+    parser->flags |= HTTP_PARSE_FLAG_CONTENT_LEN;
+#if LWIP_HTTPD_WEBSOCKET
+  } else if (parser->hdr == HTTP_PARSE_HDR_WS_KEY) {
+    /* nothing to do, checked when the request is complete */
+#endif /* LWIP_HTTPD_WEBSOCKET */
+  } else {
+    http_parse_token_end(parser);
+  }
+}
+
+/** Sub-function of http_parse_request(): feed one contiguous block of received
+ * data to the request parser.
+ *
+ * @param hs the connection state
+ * @param data received data
+ * @param len length of 'data'
+ * @return number of bytes consumed: less than 'len' if the request is complete
+ *         (the rest belongs to the body) or an error has been detected
+ */
+static u16_t
+http_parse_segment(struct http_state *hs, const char *data, u16_t len)
+{
+  struct http_parser *parser = &hs->parser;
+  u16_t i = 0;
+
+  while (i < len) {
+    char c = data[i];
+    switch (parser->state) {
+      case HTTP_PARSE_METHOD:
+        if (parser->pos == 0) {
+          /* the first character selects the method to match */
+          for (parser->method = 0; parser->method < LWIP_ARRAYSIZE(http_parse_methods); parser->method++) {
+            if (c == http_parse_methods[parser->method][0]) {
+              break;
+            }
+          }
+          if (parser->method == LWIP_ARRAYSIZE(http_parse_methods)) {
+            parser->state = HTTP_PARSE_NOT_IMPLEMENTED;
+            return i;
+          }
+          parser->pos = 1;
+        } else if (http_parse_methods[parser->method][parser->pos] == 0) {
+          if (c != ' ') {
+            parser->state = HTTP_PARSE_NOT_IMPLEMENTED;
+            return i;
+          }
+          LWIP_DEBUGF(HTTPD_DEBUG | LWIP_DBG_TRACE, ("Received %s request\n", http_parse_methods[parser->method]));
+          parser->state = HTTP_PARSE_URI;
+        } else if (c == http_parse_methods[parser->method][parser->pos]) {
+          parser->pos++;
+        } else {
+          parser->state = HTTP_PARSE_NOT_IMPLEMENTED;
+          return i;
+        }
+        i++;
+        break;
+
+      case HTTP_PARSE_URI:
+        if ((c == ' ') || (c == '\n')) {
+          if (parser->uri_len == 0) {
+            LWIP_DEBUGF(HTTPD_DEBUG, ("invalid URI\n"));
+            parser->state = HTTP_PARSE_BAD_REQUEST;
+            return i;
+          }
+          parser->uri[parser->uri_len] = 0;
+          if (c == ' ') {
+            parser->state = HTTP_PARSE_VERSION;
+          } else {
+#if LWIP_HTTPD_SUPPORT_V09
+            /* HTTP/0.9: no version and no headers */
+            parser->flags |= HTTP_PARSE_FLAG_IS_09;
+#if LWIP_HTTPD_SUPPORT_POST
+            if (parser->method == HTTP_METHOD_POST) {
+              /* HTTP/0.9 does not support POST */
+              parser->state = HTTP_PARSE_BAD_REQUEST;
+              return i;
+            }
+#endif /* LWIP_HTTPD_SUPPORT_POST */
+            parser->state = HTTP_PARSE_DONE;
+            return (u16_t)(i + 1);
+#else /* LWIP_HTTPD_SUPPORT_V09 */
+            parser->state = HTTP_PARSE_BAD_REQUEST;
+            return i;
+#endif /* LWIP_HTTPD_SUPPORT_V09 */
+          }
+        } else if (c != '\r') {
+          if (parser->uri_len >= LWIP_HTTPD_STREAMING_MAX_URI_LEN) {
+            LWIP_DEBUGF(HTTPD_DEBUG, ("URI too long\n"));
+            parser->state = HTTP_PARSE_BAD_REQUEST;
+            return i;
+          }
+          parser->uri[parser->uri_len++] = c;
+        }
+        i++;
+        break;
+
+      case HTTP_PARSE_VERSION:
+        if (c == '\n') {
+          parser->state = HTTP_PARSE_HDR_START;
+        }
+        i++;
+        break;
+
+      case HTTP_PARSE_HDR_START:
+        if (c == '\n') {
+          /* empty line: end of headers */
+          parser->state = HTTP_PARSE_DONE;
+          return (u16_t)(i + 1);
+        } else if (c == '\r') {
+          i++;
+        } else {
+          parser->hdr_match = HTTP_PARSE_HDR_MATCH_ALL;
+          parser->pos = 0;
+#if LWIP_HTTPD_HEADER_CALLBACK
+          parser->name_len = 0;
+#endif /* LWIP_HTTPD_HEADER_CALLBACK */
+          parser->state = HTTP_PARSE_HDR_NAME;
+        }
+        break;
+
+      case HTTP_PARSE_HDR_NAME:
+        if (c == ':') {
+          u8_t j;
+          parser->hdr = HTTP_PARSE_HDR_NONE;
+          for (j = 0; j < LWIP_ARRAYSIZE(http_parse_hdr_names); j++) {
+            if ((parser->hdr_match & (1U << j)) &&
+                (parser->pos == http_parse_hdr_names[j].len)) {
+              parser->hdr = j;
+            }
+          }
+#if LWIP_HTTPD_HEADER_CALLBACK
+          parser->name[parser->name_len] = 0;
+#endif /* LWIP_HTTPD_HEADER_CALLBACK */
+          parser->pos = 0;
+          parser->tok_match = HTTP_PARSE_TOKEN_MATCH_ALL;
+          parser->state = HTTP_PARSE_HDR_VALUE_WS;
+        } else if (c == '\n') {
+          /* invalid header line without ':', ignore it */
+          parser->state = HTTP_PARSE_HDR_START;
+        } else if (c != '\r') {
+          http_parse_header_name(parser, c);
+        }
+        i++;
+        break;
+
+      case HTTP_PARSE_HDR_VALUE_WS:
+        if ((c == ' ') || (c == '\t')) {
+          i++;
+        } else {
+          parser->state = HTTP_PARSE_HDR_VALUE;
+        }
+        break;
+
+      case HTTP_PARSE_HDR_VALUE: {
+        /* handle the value up to the end of the line or segment at once */
+        u16_t start = i;
+        u8_t complete;
+        while ((i < len) && (data[i] != '\r') && (data[i] != '\n')) {
+          if (parser->hdr != HTTP_PARSE_HDR_NONE) {
+            http_parse_header_value(parser, data[i]);
+          }
+          i++;
+        }
+        complete = (u8_t)(i < len);
+#if LWIP_HTTPD_HEADER_CALLBACK
+        httpd_header_received(hs, parser->uri, parser->name, &data[start], (u16_t)(i - start), complete);
+#else /* LWIP_HTTPD_HEADER_CALLBACK */
+        LWIP_UNUSED_ARG(start);
+#endif /* LWIP_HTTPD_HEADER_CALLBACK */
+        if (complete) {
+          http_parse_header_end(parser);
+          parser->state = HTTP_PARSE_HDR_EOL;
+        }
+        break;
+      }
+
+      case HTTP_PARSE_HDR_EOL:
+        if (c == '\n') {
+          parser->state = HTTP_PARSE_HDR_START;
+        }
+        i++;
+        break;
+
+      default:
+        return i;
+    }
+  }
+  return i;
+}
+
+/**
+ * When data has been received in the correct state, feed it to the request
+ * parser. Every byte is parsed only once, the pbufs are not kept.
+ *
+ * @param inp the received pbuf
+ * @param hs the connection state
+ * @param pcb the altcp_pcb which received this packet
+ * @return ERR_OK if request was OK and hs has been initialized correctly
+ *         ERR_INPROGRESS if request was OK so far but not fully received
+ *         another err_t otherwise
+ */
+static err_t
+http_parse_request(struct pbuf *inp, struct http_state *hs, struct altcp_pcb *pcb)
+{
+  struct http_parser *parser = &hs->parser;
+  struct pbuf *q;
+  u16_t consumed = 0;
+#if LWIP_HTTPD_WEBSOCKET
+  u16_t offset = 0;
+#endif /* LWIP_HTTPD_WEBSOCKET */
+
+  LWIP_UNUSED_ARG(pcb);
+  LWIP_ASSERT("p != NULL", inp != NULL);
+  LWIP_ASSERT("hs != NULL", hs != NULL);
+
+  if ((hs->handle != NULL) || (hs->file != NULL)) {
+    LWIP_DEBUGF(HTTPD_DEBUG, ("Received data while sending a file\n"));
+    /* already sending a file */
+    /* @todo: abort? */
+    return ERR_USE;
+  }
+
+  LWIP_DEBUGF(HTTPD_DEBUG, ("Received %"U16_F" bytes\n", inp->tot_len));
+
+  for (q = inp; q != NULL; q = q->next) {
+    consumed = http_parse_segment(hs, (const char *)q->payload, q->len);
+    parser->hdr_len += consumed;
+#if LWIP_HTTPD_WEBSOCKET
+    offset = (u16_t)(offset + consumed);
+#endif /* LWIP_HTTPD_WEBSOCKET */
+    if (consumed < q->len) {
+      break;
+    }
+  }
+
+  switch (parser->state) {
+    case HTTP_PARSE_DONE: {
+      int is_09 = (parser->flags & HTTP_PARSE_FLAG_IS_09) ? 1 : 0;
+#if LWIP_HTTPD_SUPPORT_11_KEEPALIVE
+      /* This is HTTP/1.0 compatible: for strict 1.1, a connection
+         would always be persistent unless "close" was specified. */
+      hs->keepalive = (u8_t)((!is_09 && (parser->flags & HTTP_PARSE_FLAG_KEEPALIVE)) ? 1 : 0);
+#endif /* LWIP_HTTPD_SUPPORT_11_KEEPALIVE */
+      LWIP_DEBUGF(HTTPD_DEBUG, ("Received \"%s\" request for URI: \"%s\"\n",
+                                http_parse_methods[parser->method], parser->uri));
+#if LWIP_HTTPD_SUPPORT_POST
+      if (parser->method == HTTP_METHOD_POST) {
+        if ((parser->flags & (HTTP_PARSE_FLAG_CONTENT_LEN | HTTP_PARSE_FLAG_CONTENT_LEN_BAD)) !=
+            HTTP_PARSE_FLAG_CONTENT_LEN) {
+          LWIP_DEBUGF(HTTPD_DEBUG, ("Error when parsing Content-Length\n"));
+          break;
+        }
+        /* the body starts at 'consumed' in 'q' (if q != NULL) */
+        return http_post_request_begin(q, consumed, hs, parser->uri, NULL, 0, parser->content_len);
+      }
+#endif /* LWIP_HTTPD_SUPPORT_POST */
+#if LWIP_HTTPD_WEBSOCKET
+      if ((parser->flags & (HTTP_PARSE_FLAG_CONN_UPGRADE | HTTP_PARSE_FLAG_UPGRADE_WS)) ==
+          (HTTP_PARSE_FLAG_CONN_UPGRADE | HTTP_PARSE_FLAG_UPGRADE_WS)) {
+        int ws_idx = httpd_ws_find_handler(parser->uri);
+        if (ws_idx >= 0) {
+          if ((parser->ws_key_len != HTTPD_WS_KEY_LEN) ||
+              !(parser->flags & HTTP_PARSE_FLAG_WS_VERSION)) {
+            LWIP_DEBUGF(HTTPD_DEBUG, ("Invalid WebSocket handshake\n"));
+            break;
+          }
+          parser->ws_key[HTTPD_WS_KEY_LEN] = 0;
+          parser->ws_handler = (u8_t)(ws_idx + 1);
+          parser->ws_data_offset = offset;
+          /* the connection is handed over to httpd_ws.c by http_recv() */
+          return ERR_OK;
+        }
+      }
+#endif /* LWIP_HTTPD_WEBSOCKET */
+      return http_find_file(hs, parser->uri, is_09);
+    }
+    case HTTP_PARSE_NOT_IMPLEMENTED:
+      LWIP_DEBUGF(HTTPD_DEBUG, ("Unsupported request method (not implemented)\n"));
+      return http_find_error_file(hs, 501);
+    case HTTP_PARSE_BAD_REQUEST:
+      break;
+    default:
+#if LWIP_HTTPD_STREAMING_MAX_HDR_LEN
+      if (parser->hdr_len > LWIP_HTTPD_STREAMING_MAX_HDR_LEN) {
+        LWIP_DEBUGF(HTTPD_DEBUG, ("request header too long\n"));
+        break;
+      }
+#endif /* LWIP_HTTPD_STREAMING_MAX_HDR_LEN */
+      /* request not fully received */
+      return ERR_INPROGRESS;
+  }
+  LWIP_DEBUGF(HTTPD_DEBUG, ("bad request\n"));
+  /* could not parse request */
+  parser->state = HTTP_PARSE_BAD_REQUEST;
+  return http_find_error_file(hs, 400);
+}
+
+#else /* LWIP_HTTPD_STREAMING_PARSER */
+
 /**
  * When data has been received in the correct state, try to parse it
  * as a HTTP request.
@@ -2121,6 +2831,7 @@ badrequest:
     return http_find_error_file(hs, 400);
   }
 }
+#endif /* LWIP_HTTPD_STREAMING_PARSER */
 
 #if LWIP_HTTPD_SSI && (LWIP_HTTPD_SSI_BY_FILE_EXTENSION == 1)
 /* Check if SSI should be parsed for this file/URL
@@ -2255,7 +2966,22 @@ http_find_file(struct http_state *hs, const char *uri, int is_09)
            */
           http_cgi_paramcount = extract_uri_parameters(hs, params);
           uri = httpd_cgis[i].pfnCGIHandler(i, http_cgi_paramcount, hs->params,
-                                         hs->param_vals);
+                                         hs->param_vals
+#if LWIP_HTTPD_CGI_ASYNC
+                                         , hs
+#endif /* LWIP_HTTPD_CGI_ASYNC */
+                                         );
+#if LWIP_HTTPD_CGI_ASYNC
+          if (uri == HTTPD_CGI_PENDING) {
+            /* no response yet: wait for httpd_cgi_continue() */
+            LWIP_DEBUGF(HTTPD_DEBUG, ("CGI %s pending\n", httpd_cgis[i].pcCGIName));
+            hs->cgi_pending = 1;
+            hs->cgi_is_09 = (u8_t)is_09;
+            hs->next_cgi_pending = http_cgi_waiting;
+            http_cgi_waiting = hs;
+            return ERR_OK;
+          }
+#endif /* LWIP_HTTPD_CGI_ASYNC */
           break;
         }
       }
@@ -2450,6 +3176,9 @@ http_sent(void *arg, struct altcp_pcb *pcb, u16_t len)
     return ERR_OK;
   }
 
+#if LWIP_HTTPD_WEBSOCKET
+  hs->unacked -= LWIP_MIN(hs->unacked, len);
+#endif /* LWIP_HTTPD_WEBSOCKET */
   hs->retries = 0;
 
   http_send(pcb, hs);
@@ -2508,6 +3237,25 @@ http_poll(void *arg, struct altcp_pcb *pcb)
   return ERR_OK;
 }
 
+#if LWIP_HTTPD_WEBSOCKET
+/** A WebSocket handshake has been received: hand the connection over to
+ * httpd_ws.c, which sets its own callbacks, and free the http_state.
+ * Frames received behind the request ('p', may be NULL) are passed on.
+ */
+static err_t
+http_ws_upgrade(struct altcp_pcb *pcb, struct http_state *hs, struct pbuf *p)
+{
+  err_t err = httpd_ws_upgrade(pcb, (u8_t)(hs->parser.ws_handler - 1),
+                               hs->parser.uri, hs->parser.ws_key, hs->unacked, p);
+  if ((err == ERR_OK) || (err == ERR_ABRT)) {
+    http_state_free(hs);
+    return err;
+  }
+  LWIP_DEBUGF(HTTPD_DEBUG, ("WebSocket upgrade failed: %s\n", lwip_strerr(err)));
+  return http_close_conn(pcb, hs);
+}
+#endif /* LWIP_HTTPD_WEBSOCKET */
+
 /**
  * Data has been received on this pcb.
  * For HTTP 1.0, this should normally only happen once (if the request fits in one packet).
@@ -2559,7 +3307,7 @@ http_recv(void *arg, struct altcp_pcb *pcb, struct pbuf *p, err_t err)
   } else
 #endif /* LWIP_HTTPD_SUPPORT_POST */
   {
-    if (hs->handle == NULL) {
+    if ((hs->handle == NULL) && !HTTP_CGI_IS_PENDING(hs)) {
       err_t parsed = http_parse_request(p, hs, pcb);
       LWIP_ASSERT("http_parse_request: unexpected return value", parsed == ERR_OK
                   || parsed == ERR_INPROGRESS || parsed == ERR_ARG || parsed == ERR_USE);
@@ -2572,6 +3320,12 @@ http_recv(void *arg, struct altcp_pcb *pcb, struct pbuf *p, err_t err)
         }
       }
 #endif /* LWIP_HTTPD_SUPPORT_REQUESTLIST */
+#if LWIP_HTTPD_WEBSOCKET
+      if ((parsed == ERR_OK) && (hs->parser.ws_handler != 0)) {
+        /* the rest of 'p' holds frames sent right behind the request */
+        return http_ws_upgrade(pcb, hs, pbuf_free_header(p, hs->parser.ws_data_offset));
+      }
+#endif /* LWIP_HTTPD_WEBSOCKET */
       pbuf_free(p);
       if (parsed == ERR_OK) {
 #if LWIP_HTTPD_SUPPORT_POST
@@ -2722,6 +3476,42 @@ http_set_ssi_handler(tSSIHandler ssi_handler, const char **tags, int num_tags)
   httpd_num_tags = num_tags;
 #endif /* !LWIP_HTTPD_SSI_RAW */
 }
+
+#if LWIP_HTTPD_SSI_ASYNC
+/**
+ * @ingroup httpd
+ * Resume a connection after its SSI handler returned HTTPD_SSI_TAG_PENDING:
+ * the handler is called again for the same tag and sending continues.
+ * Calls for connections that have been closed in the meantime are ignored.
+ * May also be called from within the SSI handler itself.
+ *
+ * @param connection the 'connection' argument passed to the SSI handler
+ */
+void
+httpd_ssi_continue(void *connection)
+{
+  struct http_state *hs = (struct http_state *)connection;
+
+  LWIP_ASSERT_CORE_LOCKED();
+  if (hs == NULL) {
+    return;
+  }
+  if (hs == http_ssi_calling) {
+    /* called from the handler: call it again as soon as it returns */
+    hs->ssi->async_state = HTTP_SSI_ASYNC_RESUME;
+    return;
+  }
+  if (!http_ssi_remove_pending(hs)) {
+    LWIP_DEBUGF(HTTPD_DEBUG, ("httpd_ssi_continue: connection not pending (closed?)\n"));
+    return;
+  }
+  hs->ssi->async_state = HTTP_SSI_ASYNC_RESUME;
+  hs->retries = 0;
+  if (http_send(hs->pcb, hs)) {
+    altcp_output(hs->pcb);
+  }
+}
+#endif /* LWIP_HTTPD_SSI_ASYNC */
 #endif /* LWIP_HTTPD_SSI */
 
 #if LWIP_HTTPD_CGI
@@ -2741,6 +3531,62 @@ http_set_cgi_handlers(const tCGI *cgis, int num_handlers)
   httpd_cgis = cgis;
   httpd_num_cgis = num_handlers;
 }
+
+#if LWIP_HTTPD_CGI_ASYNC
+/**
+ * @ingroup httpd
+ * Send the response for a connection whose CGI handler returned
+ * HTTPD_CGI_PENDING. Calls for connections that have been closed in the
+ * meantime are ignored. Must not be called from within the CGI handler
+ * (return the URI directly instead).
+ *
+ * @param connection the 'connection' argument passed to the CGI handler
+ * @param uri path and filename of the response, like the return value of
+ *        a synchronous CGI handler (the 404 page is sent if not found)
+ */
+void
+httpd_cgi_continue(void *connection, const char *uri)
+{
+  struct http_state *hs = (struct http_state *)connection;
+  struct fs_file *file = NULL;
+#if !LWIP_HTTPD_SSI
+  const
+#endif /* !LWIP_HTTPD_SSI */
+  u8_t tag_check = 0;
+
+  LWIP_ASSERT_CORE_LOCKED();
+  LWIP_ASSERT("uri != NULL", uri != NULL);
+  if (hs == NULL) {
+    return;
+  }
+  if (!http_cgi_remove_pending(hs)) {
+    LWIP_DEBUGF(HTTPD_DEBUG, ("httpd_cgi_continue: connection not pending (closed?)\n"));
+    return;
+  }
+  LWIP_DEBUGF(HTTPD_DEBUG | LWIP_DBG_TRACE, ("Opening %s\n", uri));
+  if (fs_open(&hs->file_handle, uri) == ERR_OK) {
+    file = &hs->file_handle;
+  } else {
+    file = http_get_404_file(hs, &uri);
+  }
+#if LWIP_HTTPD_SSI
+  if (file != NULL) {
+    if (file->flags & FS_FILE_FLAGS_SSI) {
+      tag_check = 1;
+    } else {
+#if LWIP_HTTPD_SSI_BY_FILE_EXTENSION
+      tag_check = http_uri_is_ssi(file, uri);
+#endif /* LWIP_HTTPD_SSI_BY_FILE_EXTENSION */
+    }
+  }
+#endif /* LWIP_HTTPD_SSI */
+  /* the request parameters are gone, don't pass them to httpd_cgi_handler() */
+  http_init_file(hs, file, hs->cgi_is_09, uri, tag_check, NULL);
+  if (http_send(hs->pcb, hs)) {
+    altcp_output(hs->pcb);
+  }
+}
+#endif /* LWIP_HTTPD_CGI_ASYNC */
 #endif /* LWIP_HTTPD_CGI */
 
 #endif /* LWIP_TCP && LWIP_CALLBACK_API */
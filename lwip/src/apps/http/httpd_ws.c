@@ -0,0 +1,987 @@
+/**
+ * @file
+ * HTTP server WebSocket support (RFC 6455)
+ *
+ * A GET request for a URI registered via httpd_ws_set_handlers() that carries
+ * "Connection: Upgrade", "Upgrade: websocket", a Sec-WebSocket-Key and
+ * "Sec-WebSocket-Version: 13" is answered with "101 Switching Protocols" and
+ * the connection is taken over from httpd.c:
+ * - received frames are parsed incrementally (frame headers may be split
+ *   across segments) and unmasked in place: data is passed to the application
+ *   directly from the received pbufs
+ * - frames to send are queued per connection as pbufs and written to the
+ *   connection from the sent/poll callbacks as send buffer space is available
+ * - broadcasts build a frame only once and share it between the queues of
+ *   all connections, it is copied into each connection's send buffer when
+ *   written
+ */
+
+/*
+ * Copyright (c) 2001-2003 Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the lwIP TCP/IP stack.
+ *
+ */
+
+#include "lwip/apps/httpd_ws.h"
+#include "httpd_ws_priv.h"
+#include "lwip/altcp.h"
+#include "lwip/mem.h"
+#include "lwip/pbuf.h"
+#include "lwip/def.h"
+#include "lwip/debug.h"
+
+#include <string.h>
+
+#if LWIP_TCP && LWIP_CALLBACK_API && LWIP_HTTPD_WEBSOCKET
+
+/* Frame header bits */
+#define HTTPD_WS_HDR_FIN          0x80
+#define HTTPD_WS_HDR_RSV          0x70
+#define HTTPD_WS_HDR_OPCODE       0x0F
+#define HTTPD_WS_HDR_MASK         0x80
+#define HTTPD_WS_HDR_LEN          0x7F
+#define HTTPD_WS_OPCODE_CONTROL   0x08
+
+/** Maximum frame header size: 2 bytes + 8 bytes extended length + 4 bytes mask */
+#define HTTPD_WS_MAX_HDR_LEN      14
+/** Maximum payload of a control frame */
+#define HTTPD_WS_MAX_CTRL_LEN     125
+/** Length of a Sec-WebSocket-Accept value (base64 of a SHA-1 digest) */
+#define HTTPD_WS_ACCEPT_LEN       28
+#define HTTPD_WS_GUID             "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+#define HTTPD_WS_GUID_LEN         36
+
+/* Flags for struct httpd_ws_conn.flags */
+#define HTTPD_WS_CONN_CLOSE_SENT  0x01 /* close frame queued, nothing else is sent */
+#define HTTPD_WS_CONN_CLOSE_RCVD  0x02 /* close frame received (or connection failed) */
+#define HTTPD_WS_CONN_RX_FIRST    0x04 /* next data passed to recv starts a message */
+#define HTTPD_WS_CONN_RX_FIN      0x08 /* FIN bit of the current frame */
+#define HTTPD_WS_CONN_GONE        0x10 /* unlinked, the application has been told it is closed */
+
+struct httpd_ws_conn {
+  struct httpd_ws_conn *next;
+  struct altcp_pcb *pcb;
+  const struct httpd_ws_handler *handler;
+  void *arg;
+  /* receive state */
+  u32_t rx_left;          /* payload bytes left in the current frame */
+  u8_t rx_hdr[HTTPD_WS_MAX_HDR_LEN];
+  u8_t rx_hdr_len;        /* bytes received of the current frame header */
+  u8_t rx_hdr_need;       /* size of the current frame header (known after 2 bytes) */
+  u8_t rx_opcode;         /* opcode of the current frame */
+  u8_t rx_msg_opcode;     /* opcode of the current data message (0: none in progress) */
+  u8_t rx_mask_pos;
+  u8_t rx_mask[4];
+  u8_t ctrl_len;
+  u8_t ctrl_buf[HTTPD_WS_MAX_CTRL_LEN];
+  /* transmit queue (ring of frames), frames stay queued until acknowledged */
+  struct pbuf *txq[LWIP_HTTPD_WS_TX_QUEUE_LEN];
+  u32_t tx_other;         /* unacknowledged bytes written before the upgrade */
+  u16_t tx_offset;        /* bytes of the first unwritten frame already written */
+  u16_t tx_acked;         /* bytes of txq[tx_head] already acknowledged */
+  u8_t tx_head;
+  u8_t tx_count;          /* frames in the queue */
+  u8_t tx_written;        /* frames at the head of the queue written completely */
+  u8_t flags;             /* HTTPD_WS_CONN_xxx */
+  u8_t retries;
+  u16_t close_status;
+};
+
+static const struct httpd_ws_handler *httpd_ws_handlers;
+static int httpd_ws_num_handlers;
+/** List of all open WebSocket connections (for broadcasts) */
+static struct httpd_ws_conn *httpd_ws_conns;
+
+static const char httpd_ws_response[] = "HTTP/1.1 101 Switching Protocols\r\n"
+                                        "Upgrade: websocket\r\n"
+                                        "Connection: Upgrade\r\n"
+                                        "Sec-WebSocket-Accept: ";
+static const char httpd_ws_base64_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+#define HTTPD_WS_ROL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+/** Process one 64 byte block of SHA-1 input (16 word rolling message schedule) */
+static void
+httpd_ws_sha1_block(u32_t *h, const u8_t *block)
+{
+  u32_t w[16];
+  u32_t a, b, c, d, e, f, k, t;
+  u8_t i;
+
+  for (i = 0; i < 16; i++) {
+    w[i] = ((u32_t)block[4 * i] << 24) | ((u32_t)block[4 * i + 1] << 16) |
+           ((u32_t)block[4 * i + 2] << 8) | (u32_t)block[4 * i + 3];
+  }
+  a = h[0];
+  b = h[1];
+  c = h[2];
+  d = h[3];
+  e = h[4];
+  for (i = 0; i < 80; i++) {
+    if (i >= 16) {
+      t = w[(i + 13) & 15] ^ w[(i + 8) & 15] ^ w[(i + 2) & 15] ^ w[i & 15];
+      w[i & 15] = HTTPD_WS_ROL(t, 1);
+    }
+    if (i < 20) {
+      f = (b & c) | (~b & d);
+      k = 0x5A827999UL;
+    } else if (i < 40) {
+      f = b ^ c ^ d;
+      k = 0x6ED9EBA1UL;
+    } else if (i < 60) {
+      f = (b & c) | (b & d) | (c & d);
+      k = 0x8F1BBCDCUL;
+    } else {
+      f = b ^ c ^ d;
+      k = 0xCA62C1D6UL;
+    }
+    t = HTTPD_WS_ROL(a, 5) + f + e + k + w[i & 15];
+    e = d;
+    d = c;
+    c = HTTPD_WS_ROL(b, 30);
+    b = a;
+    a = t;
+  }
+  h[0] += a;
+  h[1] += b;
+  h[2] += c;
+  h[3] += d;
+  h[4] += e;
+}
+
+/** Minimal SHA-1, only used to calculate Sec-WebSocket-Accept */
+static void
+httpd_ws_sha1(const u8_t *data, u16_t len, u8_t *digest)
+{
+  u32_t h[5] = {0x67452301UL, 0xEFCDAB89UL, 0x98BADCFEUL, 0x10325476UL, 0xC3D2E1F0UL};
+  u8_t block[64];
+  u32_t bits = (u32_t)len * 8;
+  u8_t i;
+
+  while (len >= 64) {
+    httpd_ws_sha1_block(h, data);
+    data += 64;
+    len -= 64;
+  }
+  memset(block, 0, sizeof(block));
+  MEMCPY(block, data, len);
+  block[len] = 0x80;
+  if (len >= 56) {
+    httpd_ws_sha1_block(h, block);
+    memset(block, 0, sizeof(block));
+  }
+  block[60] = (u8_t)(bits >> 24);
+  block[61] = (u8_t)(bits >> 16);
+  block[62] = (u8_t)(bits >> 8);
+  block[63] = (u8_t)bits;
+  httpd_ws_sha1_block(h, block);
+
+  for (i = 0; i < 20; i++) {
+    digest[i] = (u8_t)(h[i >> 2] >> (24 - 8 * (i & 3)));
+  }
+}
+
+/** Encode 'len' bytes as base64 into 'out' (NULL-terminated) */
+static void
+httpd_ws_base64(const u8_t *in, u8_t len, char *out)
+{
+  u8_t i;
+  for (i = 0; i < len; i += 3) {
+    u32_t v = (u32_t)in[i] << 16;
+    if (i + 1 < len) {
+      v |= (u32_t)in[i + 1] << 8;
+    }
+    if (i + 2 < len) {
+      v |= in[i + 2];
+    }
+    *out++ = httpd_ws_base64_chars[(v >> 18) & 63];
+    *out++ = httpd_ws_base64_chars[(v >> 12) & 63];
+    *out++ = (i + 1 < len) ? httpd_ws_base64_chars[(v >> 6) & 63] : '=';
+    *out++ = (i + 2 < len) ? httpd_ws_base64_chars[v & 63] : '=';
+  }
+  *out = 0;
+}
+
+/** Calculate the Sec-WebSocket-Accept value for a Sec-WebSocket-Key */
+static void
+httpd_ws_accept_key(const char *key, char *accept)
+{
+  u8_t buf[HTTPD_WS_KEY_LEN + HTTPD_WS_GUID_LEN];
+  u8_t digest[20];
+
+  MEMCPY(buf, key, HTTPD_WS_KEY_LEN);
+  MEMCPY(&buf[HTTPD_WS_KEY_LEN], HTTPD_WS_GUID, HTTPD_WS_GUID_LEN);
+  httpd_ws_sha1(buf, sizeof(buf), digest);
+  httpd_ws_base64(digest, sizeof(digest), accept);
+}
+
+/** Allocate an unmasked frame (server to client) in one contiguous pbuf */
+static struct pbuf *
+httpd_ws_frame_alloc(u8_t opcode, const void *data, u16_t len)
+{
+  struct pbuf *p;
+  u8_t *hdr;
+  u16_t hdr_len = (len < 126) ? 2 : 4;
+
+  if (len > HTTPD_WS_MAX_PAYLOAD) {
+    return NULL;
+  }
+  p = pbuf_alloc(PBUF_RAW, (u16_t)(hdr_len + len), PBUF_RAM);
+  if (p == NULL) {
+    return NULL;
+  }
+  hdr = (u8_t *)p->payload;
+  hdr[0] = (u8_t)(HTTPD_WS_HDR_FIN | (opcode & HTTPD_WS_HDR_OPCODE));
+  if (len < 126) {
+    hdr[1] = (u8_t)len;
+  } else {
+    hdr[1] = 126;
+    hdr[2] = (u8_t)(len >> 8);
+    hdr[3] = (u8_t)len;
+  }
+  if (len > 0) {
+    MEMCPY(&hdr[hdr_len], data, len);
+  }
+  return p;
+}
+
+/** Append a pbuf to the transmit queue. On success, the queue owns the reference. */
+static err_t
+httpd_ws_enqueue(struct httpd_ws_conn *conn, struct pbuf *p)
+{
+  if (conn->tx_count >= LWIP_HTTPD_WS_TX_QUEUE_LEN) {
+    LWIP_DEBUGF(HTTPD_DEBUG, ("httpd_ws: tx queue full\n"));
+    return ERR_MEM;
+  }
+  conn->txq[(conn->tx_head + conn->tx_count) % LWIP_HTTPD_WS_TX_QUEUE_LEN] = p;
+  conn->tx_count++;
+  return ERR_OK;
+}
+
+/** Allocate a frame and append it to the transmit queue */
+static err_t
+httpd_ws_queue_frame(struct httpd_ws_conn *conn, u8_t opcode, const void *data, u16_t len)
+{
+  err_t err;
+  struct pbuf *p = httpd_ws_frame_alloc(opcode, data, len);
+  if (p == NULL) {
+    return ERR_MEM;
+  }
+  err = httpd_ws_enqueue(conn, p);
+  if (err != ERR_OK) {
+    pbuf_free(p);
+  }
+  return err;
+}
+
+/** Queue a close frame: nothing else is sent after it */
+static void
+httpd_ws_queue_close(struct httpd_ws_conn *conn, u16_t status)
+{
+  u8_t buf[2];
+  u16_t len = 0;
+
+  if (status != HTTPD_WS_CLOSE_NO_STATUS) {
+    buf[0] = (u8_t)(status >> 8);
+    buf[1] = (u8_t)status;
+    len = 2;
+  }
+  /* if this fails, the connection is closed without sending a close frame */
+  httpd_ws_queue_frame(conn, HTTPD_WS_OPCODE_CLOSE, buf, len);
+  conn->flags |= HTTPD_WS_CONN_CLOSE_SENT;
+  conn->retries = 0;
+}
+
+/** Fail the connection: send a close frame and close once it is written */
+static void
+httpd_ws_fail(struct httpd_ws_conn *conn, u16_t status)
+{
+  LWIP_DEBUGF(HTTPD_DEBUG, ("httpd_ws: failing connection with status %"U16_F"\n", status));
+  if (!(conn->flags & HTTPD_WS_CONN_CLOSE_SENT)) {
+    httpd_ws_queue_close(conn, status);
+  }
+  conn->flags |= HTTPD_WS_CONN_CLOSE_RCVD;
+  conn->close_status = status;
+}
+
+/** Write as much of the transmit queue as the send buffer can take.
+ * Frames are not copied into the send buffer: a frame stays in the queue until
+ * it has been acknowledged, so one broadcast frame is shared by all connections
+ * up to the TCP layer. */
+static void
+httpd_ws_write(struct httpd_ws_conn *conn)
+{
+  u8_t written = 0;
+
+  while (conn->tx_written < conn->tx_count) {
+    struct pbuf *p = conn->txq[(conn->tx_head + conn->tx_written) % LWIP_HTTPD_WS_TX_QUEUE_LEN];
+    u16_t len = (u16_t)(p->len - conn->tx_offset);
+    u16_t sndbuf = altcp_sndbuf(conn->pcb);
+    if (len > sndbuf) {
+      len = sndbuf;
+    }
+    if ((len == 0) ||
+        (altcp_write(conn->pcb, (const u8_t *)p->payload + conn->tx_offset, len, 0) != ERR_OK)) {
+      /* try again from sent or poll callback */
+      break;
+    }
+    written = 1;
+    conn->tx_offset = (u16_t)(conn->tx_offset + len);
+    if (conn->tx_offset == p->len) {
+      conn->tx_written++;
+      conn->tx_offset = 0;
+    }
+  }
+  if (written) {
+    altcp_output(conn->pcb);
+  }
+}
+
+/** 'len' bytes have been acknowledged: free the frames they complete */
+static void
+httpd_ws_acked(struct httpd_ws_conn *conn, u16_t len)
+{
+  if (conn->tx_other > 0) {
+    u16_t n = (u16_t)LWIP_MIN(conn->tx_other, len);
+    conn->tx_other -= n;
+    len = (u16_t)(len - n);
+  }
+  while ((len > 0) && (conn->tx_count > 0)) {
+    struct pbuf *p = conn->txq[conn->tx_head];
+    u16_t n = (u16_t)LWIP_MIN(len, p->len - conn->tx_acked);
+    conn->tx_acked = (u16_t)(conn->tx_acked + n);
+    len = (u16_t)(len - n);
+    if (conn->tx_acked == p->len) {
+      LWIP_ASSERT("acknowledged unwritten data", conn->tx_written > 0);
+      pbuf_free(p);
+      conn->txq[conn->tx_head] = NULL;
+      conn->tx_head = (u8_t)((conn->tx_head + 1) % LWIP_HTTPD_WS_TX_QUEUE_LEN);
+      conn->tx_count--;
+      conn->tx_written--;
+      conn->tx_acked = 0;
+    }
+  }
+}
+
+/** Free the frames that have not been passed to TCP (not even in parts) */
+static void
+httpd_ws_drop_unwritten(struct httpd_ws_conn *conn)
+{
+  u8_t keep = (u8_t)(conn->tx_written + ((conn->tx_offset > 0) ? 1 : 0));
+  while (conn->tx_count > keep) {
+    conn->tx_count--;
+    pbuf_free(conn->txq[(conn->tx_head + conn->tx_count) % LWIP_HTTPD_WS_TX_QUEUE_LEN]);
+  }
+}
+
+/** Unlink a connection and inform the application (once). The connection
+ * itself is freed by httpd_ws_release() once TCP does not reference its
+ * frames any more. */
+static void
+httpd_ws_gone(struct httpd_ws_conn *conn, u16_t status)
+{
+  if (conn->flags & HTTPD_WS_CONN_GONE) {
+    return;
+  }
+  if (httpd_ws_conns == conn) {
+    httpd_ws_conns = conn->next;
+  } else {
+    struct httpd_ws_conn *prev;
+    for (prev = httpd_ws_conns; prev != NULL; prev = prev->next) {
+      if (prev->next == conn) {
+        prev->next = conn->next;
+        break;
+      }
+    }
+  }
+  conn->flags |= HTTPD_WS_CONN_GONE | HTTPD_WS_CONN_CLOSE_SENT;
+  if (conn->handler->closed != NULL) {
+    conn->handler->closed(conn, status);
+  }
+}
+
+/** Reset the pcb callbacks and free a connection with all its frames.
+ * Only allowed when all frames have been acknowledged or the pcb is gone
+ * (or is about to be aborted). */
+static void
+httpd_ws_release(struct httpd_ws_conn *conn)
+{
+  if (conn->pcb != NULL) {
+    altcp_arg(conn->pcb, NULL);
+    altcp_recv(conn->pcb, NULL);
+    altcp_sent(conn->pcb, NULL);
+    altcp_poll(conn->pcb, NULL, 0);
+    altcp_err(conn->pcb, NULL);
+  }
+  while (conn->tx_count > 0) {
+    pbuf_free(conn->txq[conn->tx_head]);
+    conn->tx_head = (u8_t)((conn->tx_head + 1) % LWIP_HTTPD_WS_TX_QUEUE_LEN);
+    conn->tx_count--;
+  }
+  mem_free(conn);
+}
+
+/** Close the TCP connection once the close handshake is done and everything
+ * is written and acknowledged */
+static err_t
+httpd_ws_check_close(struct httpd_ws_conn *conn)
+{
+  struct altcp_pcb *pcb = conn->pcb;
+  if ((conn->tx_count == 0) &&
+      ((conn->flags & (HTTPD_WS_CONN_CLOSE_SENT | HTTPD_WS_CONN_CLOSE_RCVD)) ==
+       (HTTPD_WS_CONN_CLOSE_SENT | HTTPD_WS_CONN_CLOSE_RCVD))) {
+    httpd_ws_gone(conn, conn->close_status);
+    httpd_ws_release(conn);
+    if (altcp_close(pcb) != ERR_OK) {
+      altcp_abort(pcb);
+      return ERR_ABRT;
+    }
+  }
+  return ERR_OK;
+}
+
+/** A control frame has been received completely */
+static void
+httpd_ws_rx_control(struct httpd_ws_conn *conn)
+{
+  switch (conn->rx_opcode) {
+    case HTTPD_WS_OPCODE_PING:
+      if (!(conn->flags & HTTPD_WS_CONN_CLOSE_SENT)) {
+        /* a pong is not sent if the queue is full, the client will ping again */
+        httpd_ws_queue_frame(conn, HTTPD_WS_OPCODE_PONG, conn->ctrl_buf, conn->ctrl_len);
+      }
+      break;
+    case HTTPD_WS_OPCODE_CLOSE:
+      if (conn->ctrl_len == 1) {
+        httpd_ws_fail(conn, HTTPD_WS_CLOSE_PROTOCOL_ERROR);
+        break;
+      }
+      conn->close_status = (conn->ctrl_len >= 2) ?
+                           (u16_t)((conn->ctrl_buf[0] << 8) | conn->ctrl_buf[1]) : HTTPD_WS_CLOSE_NO_STATUS;
+      LWIP_DEBUGF(HTTPD_DEBUG, ("httpd_ws: close received, status %"U16_F"\n", conn->close_status));
+      if (!(conn->flags & HTTPD_WS_CONN_CLOSE_SENT)) {
+        /* echo the status code */
+        httpd_ws_queue_close(conn, conn->close_status);
+      }
+      conn->flags |= HTTPD_WS_CONN_CLOSE_RCVD;
+      break;
+    default:
+      /* unsolicited pong: ignore */
+      break;
+  }
+}
+
+/** Unmask and handle 'len' bytes of the payload of the current frame */
+static void
+httpd_ws_rx_payload(struct httpd_ws_conn *conn, u8_t *data, u16_t len)
+{
+  u16_t i;
+
+  for (i = 0; i < len; i++) {
+    data[i] ^= conn->rx_mask[conn->rx_mask_pos & 3];
+    conn->rx_mask_pos++;
+  }
+  conn->rx_left -= len;
+
+  if (conn->rx_opcode & HTTPD_WS_OPCODE_CONTROL) {
+    if (len > 0) {
+      MEMCPY(&conn->ctrl_buf[conn->ctrl_len], data, len);
+      conn->ctrl_len = (u8_t)(conn->ctrl_len + len);
+    }
+    if (conn->rx_left == 0) {
+      httpd_ws_rx_control(conn);
+    }
+  } else {
+    u8_t flags = 0;
+    if (conn->flags & HTTPD_WS_CONN_RX_FIRST) {
+      flags |= HTTPD_WS_FLAG_FIRST;
+    }
+    if ((conn->rx_left == 0) && (conn->flags & HTTPD_WS_CONN_RX_FIN)) {
+      flags |= HTTPD_WS_FLAG_LAST;
+    }
+    if (((len > 0) || (flags != 0)) && (conn->handler->recv != NULL) &&
+        !(conn->flags & HTTPD_WS_CONN_CLOSE_SENT)) {
+      conn->handler->recv(conn, conn->rx_msg_opcode, data, len, flags);
+    }
+    conn->flags &= (u8_t)~HTTPD_WS_CONN_RX_FIRST;
+    if (flags & HTTPD_WS_FLAG_LAST) {
+      conn->rx_msg_opcode = 0;
+    }
+  }
+  if (conn->rx_left == 0) {
+    /* frame done, the next byte starts a new frame header */
+    conn->rx_hdr_len = 0;
+    conn->rx_hdr_need = 2;
+  }
+}
+
+/** A frame header has been received completely: check it */
+static void
+httpd_ws_rx_header(struct httpd_ws_conn *conn)
+{
+  u8_t b0 = conn->rx_hdr[0];
+  u8_t b1 = conn->rx_hdr[1];
+  u8_t opcode = (u8_t)(b0 & HTTPD_WS_HDR_OPCODE);
+  u8_t len = (u8_t)(b1 & HTTPD_WS_HDR_LEN);
+  const u8_t *ext = &conn->rx_hdr[2];
+
+  if ((b0 & HTTPD_WS_HDR_RSV) || !(b1 & HTTPD_WS_HDR_MASK)) {
+    /* no extensions negotiated and client frames must be masked */
+    httpd_ws_fail(conn, HTTPD_WS_CLOSE_PROTOCOL_ERROR);
+    return;
+  }
+  if (len == 126) {
+    conn->rx_left = ((u32_t)ext[0] << 8) | ext[1];
+    ext += 2;
+  } else if (len == 127) {
+    if (ext[0] | ext[1] | ext[2] | ext[3]) {
+      httpd_ws_fail(conn, HTTPD_WS_CLOSE_TOO_BIG);
+      return;
+    }
+    conn->rx_left = ((u32_t)ext[4] << 24) | ((u32_t)ext[5] << 16) | ((u32_t)ext[6] << 8) | ext[7];
+    ext += 8;
+  } else {
+    conn->rx_left = len;
+  }
+  MEMCPY(conn->rx_mask, ext, 4);
+  conn->rx_mask_pos = 0;
+
+  if (opcode & HTTPD_WS_OPCODE_CONTROL) {
+    if (!(b0 & HTTPD_WS_HDR_FIN) || (len > HTTPD_WS_MAX_CTRL_LEN) ||
+        ((opcode != HTTPD_WS_OPCODE_CLOSE) && (opcode != HTTPD_WS_OPCODE_PING) &&
+         (opcode != HTTPD_WS_OPCODE_PONG))) {
+      httpd_ws_fail(conn, HTTPD_WS_CLOSE_PROTOCOL_ERROR);
+      return;
+    }
+    conn->ctrl_len = 0;
+  } else if (opcode == HTTPD_WS_OPCODE_CONTINUATION) {
+    if (conn->rx_msg_opcode == 0) {
+      httpd_ws_fail(conn, HTTPD_WS_CLOSE_PROTOCOL_ERROR);
+      return;
+    }
+  } else if ((opcode == HTTPD_WS_OPCODE_TEXT) || (opcode == HTTPD_WS_OPCODE_BINARY)) {
+    if (conn->rx_msg_opcode != 0) {
+      /* previous message not finished */
+      httpd_ws_fail(conn, HTTPD_WS_CLOSE_PROTOCOL_ERROR);
+      return;
+    }
+    conn->rx_msg_opcode = opcode;
+    conn->flags |= HTTPD_WS_CONN_RX_FIRST;
+  } else {
+    httpd_ws_fail(conn, HTTPD_WS_CLOSE_PROTOCOL_ERROR);
+    return;
+  }
+  conn->rx_opcode = opcode;
+  if (b0 & HTTPD_WS_HDR_FIN) {
+    conn->flags |= HTTPD_WS_CONN_RX_FIN;
+  } else {
+    conn->flags &= (u8_t)~HTTPD_WS_CONN_RX_FIN;
+  }
+  if (conn->rx_left == 0) {
+    httpd_ws_rx_payload(conn, NULL, 0);
+  }
+}
+
+/** Feed one contiguous block of received data to the frame parser */
+static void
+httpd_ws_rx(struct httpd_ws_conn *conn, u8_t *data, u16_t len)
+{
+  while ((len > 0) && !(conn->flags & HTTPD_WS_CONN_CLOSE_RCVD)) {
+    if (conn->rx_hdr_len < conn->rx_hdr_need) {
+      conn->rx_hdr[conn->rx_hdr_len++] = *data++;
+      len--;
+      if (conn->rx_hdr_len == 2) {
+        u8_t l = (u8_t)(conn->rx_hdr[1] & HTTPD_WS_HDR_LEN);
+        conn->rx_hdr_need = (u8_t)(2 + ((l == 126) ? 2 : ((l == 127) ? 8 : 0)) +
+                                   ((conn->rx_hdr[1] & HTTPD_WS_HDR_MASK) ? 4 : 0));
+      }
+      if (conn->rx_hdr_len == conn->rx_hdr_need) {
+        httpd_ws_rx_header(conn);
+      }
+    } else {
+      u16_t n = (len > conn->rx_left) ? (u16_t)conn->rx_left : len;
+      httpd_ws_rx_payload(conn, data, n);
+      data += n;
+      len = (u16_t)(len - n);
+    }
+  }
+}
+
+/** Process received frames (the window has already been updated) */
+static err_t
+httpd_ws_input(struct httpd_ws_conn *conn, struct pbuf *p)
+{
+  struct pbuf *q;
+
+  for (q = p; (q != NULL) && !(conn->flags & HTTPD_WS_CONN_CLOSE_RCVD); q = q->next) {
+    httpd_ws_rx(conn, (u8_t *)q->payload, q->len);
+  }
+  pbuf_free(p);
+
+  httpd_ws_write(conn);
+  return httpd_ws_check_close(conn);
+}
+
+static err_t
+httpd_ws_recv(void *arg, struct altcp_pcb *pcb, struct pbuf *p, err_t err)
+{
+  struct httpd_ws_conn *conn = (struct httpd_ws_conn *)arg;
+
+  if ((err != ERR_OK) || (p == NULL) || (conn == NULL)) {
+    /* closed by the client (or error) */
+    if (p != NULL) {
+      altcp_recved(pcb, p->tot_len);
+      pbuf_free(p);
+    }
+    if (conn != NULL) {
+      httpd_ws_gone(conn, (conn->flags & HTTPD_WS_CONN_CLOSE_RCVD) ?
+                    conn->close_status : HTTPD_WS_CLOSE_ABNORMAL);
+      /* close once the frames passed to TCP are acknowledged */
+      httpd_ws_drop_unwritten(conn);
+      conn->flags |= HTTPD_WS_CONN_CLOSE_RCVD;
+      return httpd_ws_check_close(conn);
+    }
+    if (altcp_close(pcb) != ERR_OK) {
+      altcp_abort(pcb);
+      return ERR_ABRT;
+    }
+    return ERR_OK;
+  }
+
+  altcp_recved(pcb, p->tot_len);
+  return httpd_ws_input(conn, p);
+}
+
+static err_t
+httpd_ws_sent(void *arg, struct altcp_pcb *pcb, u16_t len)
+{
+  struct httpd_ws_conn *conn = (struct httpd_ws_conn *)arg;
+  LWIP_UNUSED_ARG(pcb);
+
+  if (conn == NULL) {
+    return ERR_OK;
+  }
+  conn->retries = 0;
+  httpd_ws_acked(conn, len);
+  httpd_ws_write(conn);
+  return httpd_ws_check_close(conn);
+}
+
+static err_t
+httpd_ws_poll(void *arg, struct altcp_pcb *pcb)
+{
+  struct httpd_ws_conn *conn = (struct httpd_ws_conn *)arg;
+
+  if (conn == NULL) {
+    if (altcp_close(pcb) != ERR_OK) {
+      altcp_abort(pcb);
+      return ERR_ABRT;
+    }
+    return ERR_OK;
+  }
+  if (conn->flags & HTTPD_WS_CONN_CLOSE_SENT) {
+    /* don't wait forever for the client to finish the close handshake */
+    conn->retries++;
+    if (conn->retries >= HTTPD_MAX_RETRIES) {
+      LWIP_DEBUGF(HTTPD_DEBUG, ("httpd_ws_poll: close timeout\n"));
+      httpd_ws_gone(conn, (conn->flags & HTTPD_WS_CONN_CLOSE_RCVD) ?
+                    conn->close_status : HTTPD_WS_CLOSE_ABNORMAL);
+      /* aborting frees the segments referencing the frames */
+      httpd_ws_release(conn);
+      altcp_abort(pcb);
+      return ERR_ABRT;
+    }
+  }
+  httpd_ws_write(conn);
+  return httpd_ws_check_close(conn);
+}
+
+static void
+httpd_ws_err(void *arg, err_t err)
+{
+  struct httpd_ws_conn *conn = (struct httpd_ws_conn *)arg;
+  LWIP_UNUSED_ARG(err);
+
+  LWIP_DEBUGF(HTTPD_DEBUG, ("httpd_ws_err: %s\n", lwip_strerr(err)));
+  if (conn != NULL) {
+    /* the pcb is already freed */
+    conn->pcb = NULL;
+    httpd_ws_gone(conn, HTTPD_WS_CLOSE_ABNORMAL);
+    httpd_ws_release(conn);
+  }
+}
+
+/** Called by httpd.c to find the handler for a request URI (parameters are ignored).
+ * @return index into the handlers array or -1 if the URI is not a WebSocket endpoint
+ */
+int
+httpd_ws_find_handler(const char *uri)
+{
+  int i;
+  size_t len;
+  const char *params = strchr(uri, '?');
+
+  len = (params != NULL) ? (size_t)(params - uri) : strlen(uri);
+  for (i = 0; i < httpd_ws_num_handlers; i++) {
+    if ((strlen(httpd_ws_handlers[i].uri) == len) &&
+        (strncmp(httpd_ws_handlers[i].uri, uri, len) == 0)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/** Called by httpd.c for a valid upgrade request: answer the handshake and
+ * take over the connection. On error, httpd.c closes the connection.
+ *
+ * @param unacked bytes written by httpd.c that are not acknowledged yet
+ * @param p data received behind the request (frames sent by the client
+ *          without waiting for the handshake response) or NULL, always freed
+ * @return ERR_OK if the connection has been taken over, ERR_ABRT if it has
+ *         been taken over and aborted while processing 'p'
+ */
+err_t
+httpd_ws_upgrade(struct altcp_pcb *pcb, u8_t handler_idx, const char *uri, const char *key,
+                 u32_t unacked, struct pbuf *p)
+{
+  struct httpd_ws_conn *conn;
+  struct pbuf *hs;
+  char *resp;
+  err_t err;
+
+  LWIP_ASSERT("invalid handler index", handler_idx < httpd_ws_num_handlers);
+
+  conn = (struct httpd_ws_conn *)mem_malloc(sizeof(struct httpd_ws_conn));
+  if (conn == NULL) {
+    if (p != NULL) {
+      pbuf_free(p);
+    }
+    return ERR_MEM;
+  }
+  memset(conn, 0, sizeof(struct httpd_ws_conn));
+  conn->pcb = pcb;
+  conn->handler = &httpd_ws_handlers[handler_idx];
+  conn->rx_hdr_need = 2;
+  conn->tx_other = unacked;
+
+  /* the handshake response is the first entry in the transmit queue */
+  hs = pbuf_alloc(PBUF_RAW, (u16_t)(sizeof(httpd_ws_response) - 1 + HTTPD_WS_ACCEPT_LEN + 4), PBUF_RAM);
+  if (hs == NULL) {
+    mem_free(conn);
+    if (p != NULL) {
+      pbuf_free(p);
+    }
+    return ERR_MEM;
+  }
+  resp = (char *)hs->payload;
+  MEMCPY(resp, httpd_ws_response, sizeof(httpd_ws_response) - 1);
+  resp += sizeof(httpd_ws_response) - 1;
+  httpd_ws_accept_key(key, resp);
+  MEMCPY(resp + HTTPD_WS_ACCEPT_LEN, "\r\n\r\n", 4);
+  httpd_ws_enqueue(conn, hs);
+
+  if (conn->handler->connected != NULL) {
+    err = conn->handler->connected(conn, uri);
+    if (err != ERR_OK) {
+      LWIP_DEBUGF(HTTPD_DEBUG, ("httpd_ws: connection to %s rejected\n", uri));
+      /* nothing has been written yet and the pcb callbacks are still httpd's */
+      conn->pcb = NULL;
+      httpd_ws_release(conn);
+      if (p != NULL) {
+        pbuf_free(p);
+      }
+      return err;
+    }
+  }
+  LWIP_DEBUGF(HTTPD_DEBUG, ("httpd_ws: upgraded connection to %s\n", uri));
+
+  conn->next = httpd_ws_conns;
+  httpd_ws_conns = conn;
+
+  altcp_arg(pcb, conn);
+  altcp_recv(pcb, httpd_ws_recv);
+  altcp_sent(pcb, httpd_ws_sent);
+  altcp_poll(pcb, httpd_ws_poll, HTTPD_POLL_INTERVAL);
+  altcp_err(pcb, httpd_ws_err);
+
+  if (p != NULL) {
+    return httpd_ws_input(conn, p);
+  }
+  httpd_ws_write(conn);
+  return ERR_OK;
+}
+
+/**
+ * @ingroup httpd
+ * Set the array of URIs that can be upgraded to WebSocket connections.
+ * The array must stay valid while httpd is running.
+ */
+void
+httpd_ws_set_handlers(const struct httpd_ws_handler *handlers, int num_handlers)
+{
+  LWIP_ASSERT("no handlers given", handlers != NULL);
+  LWIP_ASSERT("invalid number of handlers", (num_handlers > 0) && (num_handlers < 0xFF));
+
+  httpd_ws_handlers = handlers;
+  httpd_ws_num_handlers = num_handlers;
+}
+
+/**
+ * @ingroup httpd
+ * Send a (single frame) message on a WebSocket connection.
+ * The data is copied, the frame is queued and written as send buffer space
+ * is available.
+ *
+ * @param conn WebSocket connection
+ * @param opcode HTTPD_WS_OPCODE_TEXT, HTTPD_WS_OPCODE_BINARY or HTTPD_WS_OPCODE_PING
+ * @param data message payload
+ * @param len length of 'data' (at most HTTPD_WS_MAX_PAYLOAD)
+ * @return ERR_OK if queued, ERR_MEM if the queue is full or out of memory,
+ *         ERR_CLSD if the connection is closing
+ */
+err_t
+httpd_ws_send(struct httpd_ws_conn *conn, u8_t opcode, const void *data, u16_t len)
+{
+  err_t err;
+
+  LWIP_ASSERT_CORE_LOCKED();
+  LWIP_ERROR("httpd_ws_send: invalid conn", conn != NULL, return ERR_ARG;);
+  LWIP_ERROR("httpd_ws_send: invalid opcode", (opcode == HTTPD_WS_OPCODE_TEXT) ||
+             (opcode == HTTPD_WS_OPCODE_BINARY) || (opcode == HTTPD_WS_OPCODE_PING), return ERR_ARG;);
+  LWIP_ERROR("httpd_ws_send: message too long", len <= HTTPD_WS_MAX_PAYLOAD, return ERR_VAL;);
+
+  if (conn->flags & HTTPD_WS_CONN_CLOSE_SENT) {
+    return ERR_CLSD;
+  }
+  err = httpd_ws_queue_frame(conn, opcode, data, len);
+  if (err == ERR_OK) {
+    httpd_ws_write(conn);
+  }
+  return err;
+}
+
+/**
+ * @ingroup httpd
+ * Send a (single frame) message to all WebSocket connections of one handler.
+ * The frame is built only once and shared by the queues of all connections,
+ * TCP references it without copying until each connection has acknowledged it.
+ *
+ * @param handler send to connections of this handler only (NULL: all connections)
+ * @param opcode HTTPD_WS_OPCODE_TEXT, HTTPD_WS_OPCODE_BINARY or HTTPD_WS_OPCODE_PING
+ * @param data message payload
+ * @param len length of 'data' (at most HTTPD_WS_MAX_PAYLOAD)
+ * @return number of connections the message was queued to (connections with
+ *         a full queue are skipped)
+ */
+u16_t
+httpd_ws_broadcast(const struct httpd_ws_handler *handler, u8_t opcode, const void *data, u16_t len)
+{
+  struct httpd_ws_conn *conn;
+  struct pbuf *p;
+  u16_t count = 0;
+
+  LWIP_ASSERT_CORE_LOCKED();
+  LWIP_ERROR("httpd_ws_broadcast: invalid opcode", (opcode == HTTPD_WS_OPCODE_TEXT) ||
+             (opcode == HTTPD_WS_OPCODE_BINARY) || (opcode == HTTPD_WS_OPCODE_PING), return 0;);
+
+  p = httpd_ws_frame_alloc(opcode, data, len);
+  if (p == NULL) {
+    return 0;
+  }
+  for (conn = httpd_ws_conns; conn != NULL; conn = conn->next) {
+    if (((handler == NULL) || (conn->handler == handler)) &&
+        !(conn->flags & HTTPD_WS_CONN_CLOSE_SENT)) {
+      pbuf_ref(p);
+      if (httpd_ws_enqueue(conn, p) == ERR_OK) {
+        count++;
+        httpd_ws_write(conn);
+      } else {
+        pbuf_free(p);
+      }
+    }
+  }
+  pbuf_free(p);
+  return count;
+}
+
+/**
+ * @ingroup httpd
+ * Start the close handshake of a WebSocket connection. The TCP connection is
+ * closed when the client has answered (or after a timeout), the 'closed'
+ * callback is called then.
+ *
+ * @param conn WebSocket connection
+ * @param status close status code sent to the client (e.g. HTTPD_WS_CLOSE_NORMAL)
+ */
+err_t
+httpd_ws_close(struct httpd_ws_conn *conn, u16_t status)
+{
+  LWIP_ASSERT_CORE_LOCKED();
+  LWIP_ERROR("httpd_ws_close: invalid conn", conn != NULL, return ERR_ARG;);
+
+  if (conn->flags & HTTPD_WS_CONN_CLOSE_SENT) {
+    return ERR_CLSD;
+  }
+  httpd_ws_queue_close(conn, status);
+  httpd_ws_write(conn);
+  return ERR_OK;
+}
+
+/**
+ * @ingroup httpd
+ * Set the application argument of a WebSocket connection.
+ */
+void
+httpd_ws_set_arg(struct httpd_ws_conn *conn, void *arg)
+{
+  LWIP_ASSERT("conn != NULL", conn != NULL);
+  conn->arg = arg;
+}
+
+/**
+ * @ingroup httpd
+ * Get the application argument of a WebSocket connection.
+ */
+void *
+httpd_ws_get_arg(struct httpd_ws_conn *conn)
+{
+  LWIP_ASSERT("conn != NULL", conn != NULL);
+  return conn->arg;
+}
+
+/**
+ * @ingroup httpd
+ * Get the handler a WebSocket connection was accepted for.
+ */
+const struct httpd_ws_handler *
+httpd_ws_get_handler(struct httpd_ws_conn *conn)
+{
+  LWIP_ASSERT("conn != NULL", conn != NULL);
+  return conn->handler;
+}
+
+#endif /* LWIP_TCP && LWIP_CALLBACK_API && LWIP_HTTPD_WEBSOCKET */
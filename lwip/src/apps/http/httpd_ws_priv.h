@@ -0,0 +1,66 @@
+/**
+ * @file
+ * HTTP server WebSocket support (interface between httpd.c and httpd_ws.c)
+ */
+
+/*
+ * Copyright (c) 2001-2003 Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the lwIP TCP/IP stack.
+ *
+ */
+
+#ifndef LWIP_HTTPD_WS_PRIV_H
+#define LWIP_HTTPD_WS_PRIV_H
+
+#include "lwip/apps/httpd_ws.h"
+#include "lwip/altcp.h"
+
+#if LWIP_HTTPD_WEBSOCKET
+
+#if !LWIP_HTTPD_STREAMING_PARSER
+#error "LWIP_HTTPD_WEBSOCKET requires LWIP_HTTPD_STREAMING_PARSER"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Length of a valid Sec-WebSocket-Key (base64 of 16 bytes) */
+#define HTTPD_WS_KEY_LEN  24
+
+/* Interface between httpd.c and httpd_ws.c */
+int   httpd_ws_find_handler(const char *uri);
+err_t httpd_ws_upgrade(struct altcp_pcb *pcb, u8_t handler_idx, const char *uri, const char *key,
+                       u32_t unacked, struct pbuf *p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LWIP_HTTPD_WEBSOCKET */
+
+#endif /* LWIP_HTTPD_WS_PRIV_H */
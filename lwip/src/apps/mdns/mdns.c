@@ -245,9 +245,9 @@ get_mdns_pcb(void)
 static int
 check_host(struct netif *netif, struct mdns_rr_info *rr, u8_t *reverse_v6_reply)
 {
-  err_t res;
   int replies = 0;
   struct mdns_domain mydomain;
+  struct mdns_domain *domain;
 
   LWIP_UNUSED_ARG(reverse_v6_reply); /* if ipv6 is disabled */
 
@@ -262,8 +262,8 @@ check_host(struct netif *netif, struct mdns_rr_info *rr, u8_t *reverse_v6_reply)
     int i;
     for (i = 0; i < LWIP_IPV6_NUM_ADDRESSES; i++) {
       if (ip6_addr_isvalid(netif_ip6_addr_state(netif, i))) {
-        res = mdns_build_reverse_v6_domain(&mydomain, netif_ip6_addr(netif, i));
-        if (res == ERR_OK && mdns_domain_eq(&rr->domain, &mydomain)) {
+        domain = mdns_reverse_v6_domain(NETIF_TO_HOST(netif), i, netif_ip6_addr(netif, i), &mydomain);
+        if (domain != NULL && mdns_domain_eq(&rr->domain, domain)) {
           replies |= REPLY_HOST_PTR_V6;
           /* Mark which addresses where requested */
           if (reverse_v6_reply) {
@@ -275,17 +275,17 @@ check_host(struct netif *netif, struct mdns_rr_info *rr, u8_t *reverse_v6_reply)
 #endif
 #if LWIP_IPV4
     if (!ip4_addr_isany_val(*netif_ip4_addr(netif))) {
-      res = mdns_build_reverse_v4_domain(&mydomain, netif_ip4_addr(netif));
-      if (res == ERR_OK && mdns_domain_eq(&rr->domain, &mydomain)) {
+      domain = mdns_reverse_v4_domain(NETIF_TO_HOST(netif), netif_ip4_addr(netif), &mydomain);
+      if (domain != NULL && mdns_domain_eq(&rr->domain, domain)) {
         replies |= REPLY_HOST_PTR_V4;
       }
     }
 #endif
   }
 
-  res = mdns_build_host_domain(&mydomain, NETIF_TO_HOST(netif));
+  domain = mdns_host_domain(NETIF_TO_HOST(netif), &mydomain);
   /* Handle requests for our hostname */
-  if (res == ERR_OK && mdns_domain_eq(&rr->domain, &mydomain)) {
+  if (domain != NULL && mdns_domain_eq(&rr->domain, domain)) {
     /* TODO return NSEC if unsupported protocol requested */
 #if LWIP_IPV4
     if (!ip4_addr_isany_val(*netif_ip4_addr(netif))
@@ -312,31 +312,31 @@ check_host(struct netif *netif, struct mdns_rr_info *rr, u8_t *reverse_v6_reply)
 static int
 check_service(struct mdns_service *service, struct mdns_rr_info *rr)
 {
-  err_t res;
   int replies = 0;
   struct mdns_domain mydomain;
+  struct mdns_domain *domain;
 
   if (rr->klass != DNS_RRCLASS_IN && rr->klass != DNS_RRCLASS_ANY) {
     /* Invalid class */
     return 0;
   }
 
-  res = mdns_build_dnssd_domain(&mydomain);
-  if (res == ERR_OK && mdns_domain_eq(&rr->domain, &mydomain) &&
+  domain = mdns_dnssd_domain(&mydomain);
+  if (domain != NULL && mdns_domain_eq(&rr->domain, domain) &&
       (rr->type == DNS_RRTYPE_PTR || rr->type == DNS_RRTYPE_ANY)) {
     /* Request for all service types */
     replies |= REPLY_SERVICE_TYPE_PTR;
   }
 
-  res = mdns_build_service_domain(&mydomain, service, 0);
-  if (res == ERR_OK && mdns_domain_eq(&rr->domain, &mydomain) &&
+  domain = mdns_service_domain(service, 0, &mydomain);
+  if (domain != NULL && mdns_domain_eq(&rr->domain, domain) &&
       (rr->type == DNS_RRTYPE_PTR || rr->type == DNS_RRTYPE_ANY)) {
     /* Request for the instance of my service */
     replies |= REPLY_SERVICE_NAME_PTR;
   }
 
-  res = mdns_build_service_domain(&mydomain, service, 1);
-  if (res == ERR_OK && mdns_domain_eq(&rr->domain, &mydomain)) {
+  domain = mdns_service_domain(service, 1, &mydomain);
+  if (domain != NULL && mdns_domain_eq(&rr->domain, domain)) {
     /* Request for info about my service */
     if (rr->type == DNS_RRTYPE_SRV || rr->type == DNS_RRTYPE_ANY) {
       replies |= REPLY_SERVICE_SRV;
@@ -1121,10 +1121,11 @@ mdns_parse_pkt_known_answers(struct netif *netif, struct mdns_packet *pkt,
       if (ans.info.type == DNS_RRTYPE_PTR) {
         /* Read domain and compare */
         struct mdns_domain known_ans, my_ans;
+        struct mdns_domain *my_domain;
         u16_t len;
         len = mdns_readname(pkt->pbuf, ans.rd_offset, &known_ans);
-        res = mdns_build_host_domain(&my_ans, mdns);
-        if (len != MDNS_READNAME_ERROR && res == ERR_OK && mdns_domain_eq(&known_ans, &my_ans)) {
+        my_domain = mdns_host_domain(mdns, &my_ans);
+        if (len != MDNS_READNAME_ERROR && my_domain != NULL && mdns_domain_eq(&known_ans, my_domain)) {
 #if LWIP_IPV4
           if (match & REPLY_HOST_PTR_V4) {
             LWIP_DEBUGF(MDNS_DEBUG, ("MDNS: Skipping known answer: v4 PTR\n"));
@@ -1178,19 +1179,20 @@ mdns_parse_pkt_known_answers(struct netif *netif, struct mdns_packet *pkt,
         if (ans.info.type == DNS_RRTYPE_PTR) {
           /* Read domain and compare */
           struct mdns_domain known_ans, my_ans;
+          struct mdns_domain *my_domain;
           u16_t len;
           len = mdns_readname(pkt->pbuf, ans.rd_offset, &known_ans);
           if (len != MDNS_READNAME_ERROR) {
             if (match & REPLY_SERVICE_TYPE_PTR) {
-              res = mdns_build_service_domain(&my_ans, service, 0);
-              if (res == ERR_OK && mdns_domain_eq(&known_ans, &my_ans)) {
+              my_domain = mdns_service_domain(service, 0, &my_ans);
+              if (my_domain != NULL && mdns_domain_eq(&known_ans, my_domain)) {
                 LWIP_DEBUGF(MDNS_DEBUG, ("MDNS: Skipping known answer: service type PTR\n"));
                 reply->serv_replies[i] &= ~REPLY_SERVICE_TYPE_PTR;
               }
             }
             if (match & REPLY_SERVICE_NAME_PTR) {
-              res = mdns_build_service_domain(&my_ans, service, 1);
-              if (res == ERR_OK && mdns_domain_eq(&known_ans, &my_ans)) {
+              my_domain = mdns_service_domain(service, 1, &my_ans);
+              if (my_domain != NULL && mdns_domain_eq(&known_ans, my_domain)) {
                 LWIP_DEBUGF(MDNS_DEBUG, ("MDNS: Skipping known answer: service name PTR\n"));
                 reply->serv_replies[i] &= ~REPLY_SERVICE_NAME_PTR;
               }
@@ -1200,6 +1202,7 @@ mdns_parse_pkt_known_answers(struct netif *netif, struct mdns_packet *pkt,
           /* Read and compare to my SRV record */
           u16_t field16, len, read_pos;
           struct mdns_domain known_ans, my_ans;
+          struct mdns_domain *my_domain;
           read_pos = ans.rd_offset;
           do {
             /* Check priority field */
@@ -1222,8 +1225,8 @@ mdns_parse_pkt_known_answers(struct netif *netif, struct mdns_packet *pkt,
             read_pos += len;
             /* Check host field */
             len = mdns_readname(pkt->pbuf, read_pos, &known_ans);
-            mdns_build_host_domain(&my_ans, mdns);
-            if (len == MDNS_READNAME_ERROR || !mdns_domain_eq(&known_ans, &my_ans)) {
+            my_domain = mdns_host_domain(mdns, &my_ans);
+            if (len == MDNS_READNAME_ERROR || my_domain == NULL || !mdns_domain_eq(&known_ans, my_domain)) {
               break;
             }
             LWIP_DEBUGF(MDNS_DEBUG, ("MDNS: Skipping known answer: SRV\n"));
@@ -1739,17 +1742,23 @@ mdns_handle_response(struct mdns_packet *pkt, struct netif *netif)
       continue;
     }
 
+#if LWIP_MDNS_QUERIER
+    mdns_query_cache_answer(netif, &ans.info.domain, ans.info.type, ans.cache_flush,
+                            ans.ttl, pkt->pbuf, ans.rd_offset, ans.rd_length);
+#endif /* LWIP_MDNS_QUERIER */
+
     /* "Conflicting Multicast DNS responses received *before* the first probe
      * packet is sent MUST be silently ignored" so drop answer if we haven't
      * started probing yet. */
     if ((mdns->state == MDNS_STATE_PROBING) ||
         (mdns->state == MDNS_STATE_ANNOUNCE_WAIT)) {
       struct mdns_domain domain;
+      struct mdns_domain *my_domain;
       u8_t i;
       u8_t conflict = 0;
 
-      res = mdns_build_host_domain(&domain, mdns);
-      if (res == ERR_OK && mdns_domain_eq(&ans.info.domain, &domain)) {
+      my_domain = mdns_host_domain(mdns, &domain);
+      if (my_domain != NULL && mdns_domain_eq(&ans.info.domain, my_domain)) {
         LWIP_DEBUGF(MDNS_DEBUG, ("MDNS: Probe response matches host domain!"));
         conflict = 1;
       }
@@ -1759,8 +1768,8 @@ mdns_handle_response(struct mdns_packet *pkt, struct netif *netif)
         if (!service) {
           continue;
         }
-        res = mdns_build_service_domain(&domain, service, 1);
-        if ((res == ERR_OK) && mdns_domain_eq(&ans.info.domain, &domain)) {
+        my_domain = mdns_service_domain(service, 1, &domain);
+        if ((my_domain != NULL) && mdns_domain_eq(&ans.info.domain, my_domain)) {
           LWIP_DEBUGF(MDNS_DEBUG, ("MDNS: Probe response matches service domain!"));
           conflict = 1;
         }
@@ -1782,12 +1791,13 @@ mdns_handle_response(struct mdns_packet *pkt, struct netif *netif)
     else if ((mdns->state == MDNS_STATE_ANNOUNCING) ||
              (mdns->state == MDNS_STATE_COMPLETE)) {
       struct mdns_domain domain;
+      struct mdns_domain *my_domain;
       u8_t i;
       u8_t conflict = 0;
 
       /* Evaluate unique hostname records -> A and AAAA */
-      res = mdns_build_host_domain(&domain, mdns);
-      if (res == ERR_OK && mdns_domain_eq(&ans.info.domain, &domain)) {
+      my_domain = mdns_host_domain(mdns, &domain);
+      if (my_domain != NULL && mdns_domain_eq(&ans.info.domain, my_domain)) {
         LWIP_DEBUGF(MDNS_DEBUG, ("mDNS: response matches host domain, assuming conflict\n"));
         /* This means a conflict has taken place, except when the packet contains
          * exactly the same rdata. */
@@ -1821,8 +1831,8 @@ mdns_handle_response(struct mdns_packet *pkt, struct netif *netif)
         if (!service) {
           continue;
         }
-        res = mdns_build_service_domain(&domain, service, 1);
-        if ((res == ERR_OK) && mdns_domain_eq(&ans.info.domain, &domain)) {
+        my_domain = mdns_service_domain(service, 1, &domain);
+        if ((my_domain != NULL) && mdns_domain_eq(&ans.info.domain, my_domain)) {
           LWIP_DEBUGF(MDNS_DEBUG, ("mDNS: response matches service domain, assuming conflict\n"));
           /* This means a conflict has taken place, except when the packet contains
            * exactly the same rdata. */
@@ -1854,8 +1864,8 @@ mdns_handle_response(struct mdns_packet *pkt, struct netif *netif)
               read_pos += len;
               /* Check host field */
               len = mdns_readname(pkt->pbuf, read_pos, &srv_ans);
-              mdns_build_host_domain(&my_ans, mdns);
-              if (len == MDNS_READNAME_ERROR || !mdns_domain_eq(&srv_ans, &my_ans)) {
+              my_domain = mdns_host_domain(mdns, &my_ans);
+              if (len == MDNS_READNAME_ERROR || my_domain == NULL || !mdns_domain_eq(&srv_ans, my_domain)) {
                 break;
               }
               LWIP_DEBUGF(MDNS_DEBUG, ("mDNS: response equals our own SRV record -> no conflict\n"));
@@ -2212,6 +2222,9 @@ mdns_resp_remove_netif(struct netif *netif)
   LWIP_ERROR("mdns_resp_remove_netif: Not an active netif", (mdns != NULL), return ERR_VAL);
 
   sys_untimeout(mdns_probe_and_announce, netif);
+#if LWIP_MDNS_QUERIER
+  mdns_query_netif_removed(netif);
+#endif /* LWIP_MDNS_QUERIER */
 
   for (i = 0; i < MDNS_MAX_SERVICES; i++) {
     struct mdns_service *service = mdns->services[i];
@@ -2257,6 +2270,7 @@ mdns_resp_rename_netif(struct netif *netif, const char *hostname)
 
   MEMCPY(&mdns->name, hostname, LWIP_MIN(MDNS_LABEL_MAXLEN, len));
   mdns->name[len] = '\0'; /* null termination in case new name is shorter than previous */
+  mdns_host_domain_changed(mdns);
 
   mdns_resp_restart(netif);
 
@@ -2371,6 +2385,7 @@ mdns_resp_rename_service(struct netif *netif, s8_t slot, const char *name)
 
   MEMCPY(&srv->name, name, LWIP_MIN(MDNS_LABEL_MAXLEN, len));
   srv->name[len] = '\0'; /* null termination in case new name is shorter than previous */
+  mdns_service_domain_changed(srv);
 
   mdns_resp_restart(netif);
 
@@ -418,21 +418,235 @@ mdns_build_dnssd_domain(struct mdns_domain *domain)
  */
 err_t
 mdns_build_service_domain(struct mdns_domain *domain, struct mdns_service *service, int include_name)
+{
+  return mdns_build_named_service_domain(domain, include_name ? service->name : NULL,
+                                         service->service, (enum mdns_sd_proto)service->proto);
+}
+
+/**
+ * Build a service domain from its names
+ * @param domain Where to write the domain name
+ * @param name Instance name, like 'myweb', NULL to build the service type domain
+ * @param service Type of service, like '_http'
+ * @param proto Protocol of the service
+ * @return ERR_OK if domain [\<name\>.]\<type\>.\<proto\>.local. was written, an err_t otherwise
+ */
+err_t
+mdns_build_named_service_domain(struct mdns_domain *domain, const char *name,
+                                const char *service, enum mdns_sd_proto proto)
 {
   err_t res;
   LWIP_UNUSED_ARG(res);
   memset(domain, 0, sizeof(struct mdns_domain));
-  if (include_name) {
-    res = mdns_domain_add_label(domain, service->name, (u8_t)strlen(service->name));
+  if (name != NULL) {
+    res = mdns_domain_add_label(domain, name, (u8_t)strlen(name));
     LWIP_ERROR("mdns_build_service_domain: Failed to add label", (res == ERR_OK), return res);
   }
-  res = mdns_domain_add_label(domain, service->service, (u8_t)strlen(service->service));
+  res = mdns_domain_add_label(domain, service, (u8_t)strlen(service));
   LWIP_ERROR("mdns_build_service_domain: Failed to add label", (res == ERR_OK), return res);
-  res = mdns_domain_add_label(domain, dnssd_protos[service->proto], (u8_t)strlen(dnssd_protos[service->proto]));
+  res = mdns_domain_add_label(domain, dnssd_protos[proto], (u8_t)strlen(dnssd_protos[proto]));
   LWIP_ERROR("mdns_build_service_domain: Failed to add label", (res == ERR_OK), return res);
   return mdns_add_dotlocal(domain);
 }
 
+#if LWIP_MDNS_QUERIER
+/**
+ * Build a domain from a dotted name, like 'myhost.local'
+ * @param domain Where to write the domain name
+ * @param name The name, a trailing dot is allowed
+ * @param namelen Length of name
+ * @return ERR_OK if domain was written, an err_t otherwise
+ */
+err_t
+mdns_build_name_domain(struct mdns_domain *domain, const char *name, size_t namelen)
+{
+  size_t start = 0;
+  size_t i;
+  err_t res;
+
+  memset(domain, 0, sizeof(struct mdns_domain));
+  for (i = 0; i <= namelen; i++) {
+    if ((i == namelen) || (name[i] == '.')) {
+      if (i == start) {
+        /* Only the root label may be empty */
+        if (i < namelen - 1) {
+          return ERR_VAL;
+        }
+      } else {
+        if (i - start > MDNS_LABEL_MAXLEN) {
+          return ERR_VAL;
+        }
+        res = mdns_domain_add_label(domain, &name[start], (u8_t)(i - start));
+        if (res != ERR_OK) {
+          return res;
+        }
+      }
+      start = i + 1;
+    }
+  }
+  return mdns_domain_add_label(domain, NULL, 0);
+}
+#endif /* LWIP_MDNS_QUERIER */
+
+#if LWIP_IPV4
+/**
+ * Get the domain for reverse lookup of an IPv4 address of a netif
+ * @param mdns TMDNS netif descriptor.
+ * @param addr The IPv4 address of the netif
+ * @param buf Where to build the domain name if it is not cached
+ * @return The (cached) domain name, NULL if it could not be built
+ */
+struct mdns_domain *
+mdns_reverse_v4_domain(struct mdns_host *mdns, const ip4_addr_t *addr, struct mdns_domain *buf)
+{
+#if MDNS_DOMAIN_CACHE
+  LWIP_UNUSED_ARG(buf);
+  if (mdns->reverse_v4_domain.length == 0 || !ip4_addr_cmp(&mdns->reverse_v4_addr, addr)) {
+    if (mdns_build_reverse_v4_domain(&mdns->reverse_v4_domain, addr) != ERR_OK) {
+      mdns->reverse_v4_domain.length = 0;
+      return NULL;
+    }
+    ip4_addr_copy(mdns->reverse_v4_addr, *addr);
+  }
+  return &mdns->reverse_v4_domain;
+#else /* MDNS_DOMAIN_CACHE */
+  LWIP_UNUSED_ARG(mdns);
+  return (mdns_build_reverse_v4_domain(buf, addr) == ERR_OK) ? buf : NULL;
+#endif /* MDNS_DOMAIN_CACHE */
+}
+#endif
+
+#if LWIP_IPV6
+/**
+ * Get the domain for reverse lookup of an IPv6 address of a netif
+ * @param mdns TMDNS netif descriptor.
+ * @param addrindex Index of the address in the netif
+ * @param addr The IPv6 address of the netif at addrindex
+ * @param buf Where to build the domain name if it is not cached
+ * @return The (cached) domain name, NULL if it could not be built
+ */
+struct mdns_domain *
+mdns_reverse_v6_domain(struct mdns_host *mdns, int addrindex, const ip6_addr_t *addr, struct mdns_domain *buf)
+{
+#if MDNS_DOMAIN_CACHE
+  struct mdns_domain *domain = &mdns->reverse_v6_domain[addrindex];
+  LWIP_UNUSED_ARG(buf);
+  if (domain->length == 0 || !ip6_addr_cmp_zoneless(&mdns->reverse_v6_addr[addrindex], addr)) {
+    if (mdns_build_reverse_v6_domain(domain, addr) != ERR_OK) {
+      domain->length = 0;
+      return NULL;
+    }
+    ip6_addr_copy(mdns->reverse_v6_addr[addrindex], *addr);
+  }
+  return domain;
+#else /* MDNS_DOMAIN_CACHE */
+  LWIP_UNUSED_ARG(mdns);
+  LWIP_UNUSED_ARG(addrindex);
+  return (mdns_build_reverse_v6_domain(buf, addr) == ERR_OK) ? buf : NULL;
+#endif /* MDNS_DOMAIN_CACHE */
+}
+#endif
+
+/**
+ * Get the \<hostname\>.local. domain name of a netif
+ * @param mdns TMDNS netif descriptor.
+ * @param buf Where to build the domain name if it is not cached
+ * @return The (cached) domain name, NULL if it could not be built
+ */
+struct mdns_domain *
+mdns_host_domain(struct mdns_host *mdns, struct mdns_domain *buf)
+{
+#if MDNS_DOMAIN_CACHE
+  LWIP_UNUSED_ARG(buf);
+  if (mdns->host_domain.length == 0) {
+    if (mdns_build_host_domain(&mdns->host_domain, mdns) != ERR_OK) {
+      mdns->host_domain.length = 0;
+      return NULL;
+    }
+  }
+  return &mdns->host_domain;
+#else /* MDNS_DOMAIN_CACHE */
+  return (mdns_build_host_domain(buf, mdns) == ERR_OK) ? buf : NULL;
+#endif /* MDNS_DOMAIN_CACHE */
+}
+
+/**
+ * Get the lookup-all-services special DNS-SD domain name
+ * @param buf Where to build the domain name if it is not cached
+ * @return The (cached) domain name, NULL if it could not be built
+ */
+struct mdns_domain *
+mdns_dnssd_domain(struct mdns_domain *buf)
+{
+#if MDNS_DOMAIN_CACHE
+  static struct mdns_domain dnssd_domain;
+  LWIP_UNUSED_ARG(buf);
+  if (dnssd_domain.length == 0) {
+    if (mdns_build_dnssd_domain(&dnssd_domain) != ERR_OK) {
+      dnssd_domain.length = 0;
+      return NULL;
+    }
+  }
+  return &dnssd_domain;
+#else /* MDNS_DOMAIN_CACHE */
+  return (mdns_build_dnssd_domain(buf) == ERR_OK) ? buf : NULL;
+#endif /* MDNS_DOMAIN_CACHE */
+}
+
+/**
+ * Get the domain name of a service
+ * @param service The service struct, containing service name, type and protocol
+ * @param include_name Whether to include the service name in the domain
+ * @param buf Where to build the domain name if it is not cached
+ * @return The (cached) domain name, NULL if it could not be built
+ */
+struct mdns_domain *
+mdns_service_domain(struct mdns_service *service, int include_name, struct mdns_domain *buf)
+{
+#if MDNS_DOMAIN_CACHE
+  struct mdns_domain *domain = include_name ? &service->instance_domain : &service->type_domain;
+  LWIP_UNUSED_ARG(buf);
+  if (domain->length == 0) {
+    if (mdns_build_service_domain(domain, service, include_name) != ERR_OK) {
+      domain->length = 0;
+      return NULL;
+    }
+  }
+  return domain;
+#else /* MDNS_DOMAIN_CACHE */
+  return (mdns_build_service_domain(buf, service, include_name) == ERR_OK) ? buf : NULL;
+#endif /* MDNS_DOMAIN_CACHE */
+}
+
+/**
+ * Invalidate the cached domain names built from the hostname of a netif
+ * @param mdns TMDNS netif descriptor.
+ */
+void
+mdns_host_domain_changed(struct mdns_host *mdns)
+{
+#if MDNS_DOMAIN_CACHE
+  mdns->host_domain.length = 0;
+#else
+  LWIP_UNUSED_ARG(mdns);
+#endif
+}
+
+/**
+ * Invalidate the cached domain names built from the name of a service
+ * @param service The service struct
+ */
+void
+mdns_service_domain_changed(struct mdns_service *service)
+{
+#if MDNS_DOMAIN_CACHE
+  service->type_domain.length = 0;
+  service->instance_domain.length = 0;
+#else
+  LWIP_UNUSED_ARG(service);
+#endif
+}
+
 /**
  * Return bytes needed to write before jump for best result of compressing supplied domain
  * against domain in outpacket starting at specified offset.
@@ -83,7 +83,7 @@ mdns_prepare_txtdata(struct mdns_service *service)
  *                reply with a unicast packet
  * @return ERR_OK on success, an err_t otherwise
  */
-static err_t
+err_t
 mdns_add_question(struct mdns_outpacket *outpkt, struct mdns_domain *domain,
                   u16_t type, u16_t klass, u16_t unicast)
 {
@@ -152,7 +152,7 @@ mdns_add_question(struct mdns_outpacket *outpkt, struct mdns_domain *domain,
  * @param answer_domain A domain to write after any buffer data as answer
  * @return ERR_OK on success, an err_t otherwise
  */
-static err_t
+err_t
 mdns_add_answer(struct mdns_outpacket *reply, struct mdns_domain *domain,
                 u16_t type, u16_t klass, u16_t cache_flush, u32_t ttl,
                 const u8_t *buf, size_t buf_length, struct mdns_domain *answer_domain)
@@ -232,10 +232,13 @@ mdns_add_any_host_question(struct mdns_outpacket *outpkt,
                            struct mdns_host *mdns,
                            u16_t request_unicast_reply)
 {
-  struct mdns_domain host;
-  mdns_build_host_domain(&host, mdns);
+  struct mdns_domain host_buf;
+  struct mdns_domain *host = mdns_host_domain(mdns, &host_buf);
+  if (host == NULL) {
+    return ERR_VAL;
+  }
   LWIP_DEBUGF(MDNS_DEBUG, ("MDNS: Adding host question for ANY type\n"));
-  return mdns_add_question(outpkt, &host, DNS_RRTYPE_ANY, DNS_RRCLASS_IN,
+  return mdns_add_question(outpkt, host, DNS_RRTYPE_ANY, DNS_RRCLASS_IN,
                            request_unicast_reply);
 }
 
@@ -245,10 +248,13 @@ mdns_add_any_service_question(struct mdns_outpacket *outpkt,
                               struct mdns_service *service,
                               u16_t request_unicast_reply)
 {
-  struct mdns_domain domain;
-  mdns_build_service_domain(&domain, service, 1);
+  struct mdns_domain domain_buf;
+  struct mdns_domain *domain = mdns_service_domain(service, 1, &domain_buf);
+  if (domain == NULL) {
+    return ERR_VAL;
+  }
   LWIP_DEBUGF(MDNS_DEBUG, ("MDNS: Adding service instance question for ANY type\n"));
-  return mdns_add_question(outpkt, &domain, DNS_RRTYPE_ANY, DNS_RRCLASS_IN,
+  return mdns_add_question(outpkt, domain, DNS_RRTYPE_ANY, DNS_RRCLASS_IN,
                            request_unicast_reply);
 }
 
@@ -260,8 +266,11 @@ mdns_add_a_answer(struct mdns_outpacket *reply, struct mdns_outmsg *msg,
 {
   err_t res;
   u32_t ttl = MDNS_TTL_120;
-  struct mdns_domain host;
-  mdns_build_host_domain(&host, netif_mdns_data(netif));
+  struct mdns_domain host_buf;
+  struct mdns_domain *host = mdns_host_domain(netif_mdns_data(netif), &host_buf);
+  if (host == NULL) {
+    return ERR_VAL;
+  }
   /* When answering to a legacy querier, we need to repeat the question and
    * limit the ttl to the short legacy ttl */
   if(msg->legacy_query) {
@@ -269,7 +278,7 @@ mdns_add_a_answer(struct mdns_outpacket *reply, struct mdns_outmsg *msg,
      * (max one question), not for the additional records. */
     if(reply->questions < 1) {
       LWIP_DEBUGF(MDNS_DEBUG, ("MDNS: Add question for legacy query\n"));
-      res = mdns_add_question(reply, &host, DNS_RRTYPE_A, DNS_RRCLASS_IN, 0);
+      res = mdns_add_question(reply, host, DNS_RRTYPE_A, DNS_RRCLASS_IN, 0);
       if (res != ERR_OK) {
         return res;
       }
@@ -279,7 +288,7 @@ mdns_add_a_answer(struct mdns_outpacket *reply, struct mdns_outmsg *msg,
     ttl = MDNS_TTL_10;
   }
   LWIP_DEBUGF(MDNS_DEBUG, ("MDNS: Responding with A record\n"));
-  return mdns_add_answer(reply, &host, DNS_RRTYPE_A, DNS_RRCLASS_IN, msg->cache_flush,
+  return mdns_add_answer(reply, host, DNS_RRTYPE_A, DNS_RRCLASS_IN, msg->cache_flush,
                          ttl, (const u8_t *) netif_ip4_addr(netif),
                          sizeof(ip4_addr_t), NULL);
 }
@@ -291,9 +300,12 @@ mdns_add_hostv4_ptr_answer(struct mdns_outpacket *reply, struct mdns_outmsg *msg
 {
   err_t res;
   u32_t ttl = MDNS_TTL_120;
-  struct mdns_domain host, revhost;
-  mdns_build_host_domain(&host, netif_mdns_data(netif));
-  mdns_build_reverse_v4_domain(&revhost, netif_ip4_addr(netif));
+  struct mdns_domain host_buf, revhost_buf;
+  struct mdns_domain *host = mdns_host_domain(netif_mdns_data(netif), &host_buf);
+  struct mdns_domain *revhost = mdns_reverse_v4_domain(netif_mdns_data(netif), netif_ip4_addr(netif), &revhost_buf);
+  if (host == NULL || revhost == NULL) {
+    return ERR_VAL;
+  }
   /* When answering to a legacy querier, we need to repeat the question and
    * limit the ttl to the short legacy ttl */
   if(msg->legacy_query) {
@@ -301,7 +313,7 @@ mdns_add_hostv4_ptr_answer(struct mdns_outpacket *reply, struct mdns_outmsg *msg
      * (max one question), not for the additional records. */
     if(reply->questions < 1) {
       LWIP_DEBUGF(MDNS_DEBUG, ("MDNS: Add question for legacy query\n"));
-      res = mdns_add_question(reply, &revhost, DNS_RRTYPE_PTR, DNS_RRCLASS_IN, 0);
+      res = mdns_add_question(reply, revhost, DNS_RRTYPE_PTR, DNS_RRCLASS_IN, 0);
       if (res != ERR_OK) {
         return res;
       }
@@ -311,8 +323,8 @@ mdns_add_hostv4_ptr_answer(struct mdns_outpacket *reply, struct mdns_outmsg *msg
     ttl = MDNS_TTL_10;
   }
   LWIP_DEBUGF(MDNS_DEBUG, ("MDNS: Responding with v4 PTR record\n"));
-  return mdns_add_answer(reply, &revhost, DNS_RRTYPE_PTR, DNS_RRCLASS_IN,
-                         msg->cache_flush, ttl, NULL, 0, &host);
+  return mdns_add_answer(reply, revhost, DNS_RRTYPE_PTR, DNS_RRCLASS_IN,
+                         msg->cache_flush, ttl, NULL, 0, host);
 }
 #endif
 
@@ -324,8 +336,11 @@ mdns_add_aaaa_answer(struct mdns_outpacket *reply, struct mdns_outmsg *msg,
 {
   err_t res;
   u32_t ttl = MDNS_TTL_120;
-  struct mdns_domain host;
-  mdns_build_host_domain(&host, netif_mdns_data(netif));
+  struct mdns_domain host_buf;
+  struct mdns_domain *host = mdns_host_domain(netif_mdns_data(netif), &host_buf);
+  if (host == NULL) {
+    return ERR_VAL;
+  }
   /* When answering to a legacy querier, we need to repeat the question and
    * limit the ttl to the short legacy ttl */
   if(msg->legacy_query) {
@@ -333,7 +348,7 @@ mdns_add_aaaa_answer(struct mdns_outpacket *reply, struct mdns_outmsg *msg,
      * (max one question), not for the additional records. */
     if(reply->questions < 1) {
       LWIP_DEBUGF(MDNS_DEBUG, ("MDNS: Add question for legacy query\n"));
-      res = mdns_add_question(reply, &host, DNS_RRTYPE_AAAA, DNS_RRCLASS_IN, 0);
+      res = mdns_add_question(reply, host, DNS_RRTYPE_AAAA, DNS_RRCLASS_IN, 0);
       if (res != ERR_OK) {
         return res;
       }
@@ -343,7 +358,7 @@ mdns_add_aaaa_answer(struct mdns_outpacket *reply, struct mdns_outmsg *msg,
     ttl = MDNS_TTL_10;
   }
   LWIP_DEBUGF(MDNS_DEBUG, ("MDNS: Responding with AAAA record\n"));
-  return mdns_add_answer(reply, &host, DNS_RRTYPE_AAAA, DNS_RRCLASS_IN, msg->cache_flush,
+  return mdns_add_answer(reply, host, DNS_RRTYPE_AAAA, DNS_RRCLASS_IN, msg->cache_flush,
                          ttl, (const u8_t *) netif_ip6_addr(netif, addrindex),
                          sizeof(ip6_addr_p_t), NULL);
 }
@@ -355,9 +370,13 @@ mdns_add_hostv6_ptr_answer(struct mdns_outpacket *reply, struct mdns_outmsg *msg
 {
   err_t res;
   u32_t ttl = MDNS_TTL_120;
-  struct mdns_domain host, revhost;
-  mdns_build_host_domain(&host, netif_mdns_data(netif));
-  mdns_build_reverse_v6_domain(&revhost, netif_ip6_addr(netif, addrindex));
+  struct mdns_domain host_buf, revhost_buf;
+  struct mdns_domain *host = mdns_host_domain(netif_mdns_data(netif), &host_buf);
+  struct mdns_domain *revhost = mdns_reverse_v6_domain(netif_mdns_data(netif), addrindex,
+                                                       netif_ip6_addr(netif, addrindex), &revhost_buf);
+  if (host == NULL || revhost == NULL) {
+    return ERR_VAL;
+  }
   /* When answering to a legacy querier, we need to repeat the question and
    * limit the ttl to the short legacy ttl */
   if(msg->legacy_query) {
@@ -365,7 +384,7 @@ mdns_add_hostv6_ptr_answer(struct mdns_outpacket *reply, struct mdns_outmsg *msg
      * (max one question), not for the additional records. */
     if(reply->questions < 1) {
       LWIP_DEBUGF(MDNS_DEBUG, ("MDNS: Add question for legacy query\n"));
-      res = mdns_add_question(reply, &revhost, DNS_RRTYPE_PTR, DNS_RRCLASS_IN, 0);
+      res = mdns_add_question(reply, revhost, DNS_RRTYPE_PTR, DNS_RRCLASS_IN, 0);
       if (res != ERR_OK) {
         return res;
       }
@@ -375,8 +394,8 @@ mdns_add_hostv6_ptr_answer(struct mdns_outpacket *reply, struct mdns_outmsg *msg
     ttl = MDNS_TTL_10;
   }
   LWIP_DEBUGF(MDNS_DEBUG, ("MDNS: Responding with v6 PTR record\n"));
-  return mdns_add_answer(reply, &revhost, DNS_RRTYPE_PTR, DNS_RRCLASS_IN,
-                         msg->cache_flush, ttl, NULL, 0, &host);
+  return mdns_add_answer(reply, revhost, DNS_RRTYPE_PTR, DNS_RRCLASS_IN,
+                         msg->cache_flush, ttl, NULL, 0, host);
 }
 #endif
 
@@ -387,9 +406,12 @@ mdns_add_servicetype_ptr_answer(struct mdns_outpacket *reply, struct mdns_outmsg
 {
   err_t res;
   u32_t ttl = MDNS_TTL_4500;
-  struct mdns_domain service_type, service_dnssd;
-  mdns_build_service_domain(&service_type, service, 0);
-  mdns_build_dnssd_domain(&service_dnssd);
+  struct mdns_domain service_type_buf, service_dnssd_buf;
+  struct mdns_domain *service_type = mdns_service_domain(service, 0, &service_type_buf);
+  struct mdns_domain *service_dnssd = mdns_dnssd_domain(&service_dnssd_buf);
+  if (service_type == NULL || service_dnssd == NULL) {
+    return ERR_VAL;
+  }
   /* When answering to a legacy querier, we need to repeat the question and
    * limit the ttl to the short legacy ttl */
   if(msg->legacy_query) {
@@ -397,7 +419,7 @@ mdns_add_servicetype_ptr_answer(struct mdns_outpacket *reply, struct mdns_outmsg
      * (max one question), not for the additional records. */
     if(reply->questions < 1) {
       LWIP_DEBUGF(MDNS_DEBUG, ("MDNS: Add question for legacy query\n"));
-      res = mdns_add_question(reply, &service_dnssd, DNS_RRTYPE_PTR, DNS_RRCLASS_IN, 0);
+      res = mdns_add_question(reply, service_dnssd, DNS_RRTYPE_PTR, DNS_RRCLASS_IN, 0);
       if (res != ERR_OK) {
         return res;
       }
@@ -407,8 +429,8 @@ mdns_add_servicetype_ptr_answer(struct mdns_outpacket *reply, struct mdns_outmsg
     ttl = MDNS_TTL_10;
   }
   LWIP_DEBUGF(MDNS_DEBUG, ("MDNS: Responding with service type PTR record\n"));
-  return mdns_add_answer(reply, &service_dnssd, DNS_RRTYPE_PTR, DNS_RRCLASS_IN,
-                         0, ttl, NULL, 0, &service_type);
+  return mdns_add_answer(reply, service_dnssd, DNS_RRTYPE_PTR, DNS_RRCLASS_IN,
+                         0, ttl, NULL, 0, service_type);
 }
 
 /** Write a servicetype -> servicename PTR RR to outpacket */
@@ -418,9 +440,12 @@ mdns_add_servicename_ptr_answer(struct mdns_outpacket *reply, struct mdns_outmsg
 {
   err_t res;
   u32_t ttl = MDNS_TTL_120;
-  struct mdns_domain service_type, service_instance;
-  mdns_build_service_domain(&service_type, service, 0);
-  mdns_build_service_domain(&service_instance, service, 1);
+  struct mdns_domain service_type_buf, service_instance_buf;
+  struct mdns_domain *service_type = mdns_service_domain(service, 0, &service_type_buf);
+  struct mdns_domain *service_instance = mdns_service_domain(service, 1, &service_instance_buf);
+  if (service_type == NULL || service_instance == NULL) {
+    return ERR_VAL;
+  }
   /* When answering to a legacy querier, we need to repeat the question and
    * limit the ttl to the short legacy ttl */
   if(msg->legacy_query) {
@@ -428,7 +453,7 @@ mdns_add_servicename_ptr_answer(struct mdns_outpacket *reply, struct mdns_outmsg
      * (max one question), not for the additional records. */
     if(reply->questions < 1) {
       LWIP_DEBUGF(MDNS_DEBUG, ("MDNS: Add question for legacy query\n"));
-      res = mdns_add_question(reply, &service_type, DNS_RRTYPE_PTR, DNS_RRCLASS_IN, 0);
+      res = mdns_add_question(reply, service_type, DNS_RRTYPE_PTR, DNS_RRCLASS_IN, 0);
       if (res != ERR_OK) {
         return res;
       }
@@ -438,8 +463,8 @@ mdns_add_servicename_ptr_answer(struct mdns_outpacket *reply, struct mdns_outmsg
     ttl = MDNS_TTL_10;
   }
   LWIP_DEBUGF(MDNS_DEBUG, ("MDNS: Responding with service name PTR record\n"));
-  return mdns_add_answer(reply, &service_type, DNS_RRTYPE_PTR, DNS_RRCLASS_IN,
-                         0, ttl, NULL, 0, &service_instance);
+  return mdns_add_answer(reply, service_type, DNS_RRTYPE_PTR, DNS_RRCLASS_IN,
+                         0, ttl, NULL, 0, service_instance);
 }
 
 /** Write a SRV RR to outpacket */
@@ -449,23 +474,31 @@ mdns_add_srv_answer(struct mdns_outpacket *reply, struct mdns_outmsg *msg,
 {
   err_t res;
   u32_t ttl = MDNS_TTL_120;
-  struct mdns_domain service_instance, srvhost;
+  struct mdns_domain service_instance_buf, srvhost_buf;
+  struct mdns_domain *service_instance = mdns_service_domain(service, 1, &service_instance_buf);
+  struct mdns_domain *srvhost = mdns_host_domain(mdns, &srvhost_buf);
   u16_t srvdata[3];
-  mdns_build_service_domain(&service_instance, service, 1);
-  mdns_build_host_domain(&srvhost, mdns);
+  if (service_instance == NULL || srvhost == NULL) {
+    return ERR_VAL;
+  }
   if (msg->legacy_query) {
     /* RFC 6762 section 18.14:
      * In legacy unicast responses generated to answer legacy queries,
      * name compression MUST NOT be performed on SRV records.
      */
-    srvhost.skip_compression = 1;
+    if (srvhost != &srvhost_buf) {
+      /* don't modify the cached domain */
+      SMEMCPY(&srvhost_buf, srvhost, sizeof(srvhost_buf));
+      srvhost = &srvhost_buf;
+    }
+    srvhost->skip_compression = 1;
     /* When answering to a legacy querier, we need to repeat the question and
      * limit the ttl to the short legacy ttl.
      * Repeating the question only needs to be done for the question asked
      * (max one question), not for the additional records. */
     if(reply->questions < 1) {
       LWIP_DEBUGF(MDNS_DEBUG, ("MDNS: Add question for legacy query\n"));
-      res = mdns_add_question(reply, &service_instance, DNS_RRTYPE_SRV, DNS_RRCLASS_IN, 0);
+      res = mdns_add_question(reply, service_instance, DNS_RRTYPE_SRV, DNS_RRCLASS_IN, 0);
       if (res != ERR_OK) {
         return res;
       }
@@ -478,9 +511,9 @@ mdns_add_srv_answer(struct mdns_outpacket *reply, struct mdns_outmsg *msg,
   srvdata[1] = lwip_htons(SRV_WEIGHT);
   srvdata[2] = lwip_htons(service->port);
   LWIP_DEBUGF(MDNS_DEBUG, ("MDNS: Responding with SRV record\n"));
-  return mdns_add_answer(reply, &service_instance, DNS_RRTYPE_SRV, DNS_RRCLASS_IN,
+  return mdns_add_answer(reply, service_instance, DNS_RRTYPE_SRV, DNS_RRCLASS_IN,
                          msg->cache_flush, ttl,
-                         (const u8_t *) &srvdata, sizeof(srvdata), &srvhost);
+                         (const u8_t *) &srvdata, sizeof(srvdata), srvhost);
 }
 
 /** Write a TXT RR to outpacket */
@@ -490,8 +523,11 @@ mdns_add_txt_answer(struct mdns_outpacket *reply, struct mdns_outmsg *msg,
 {
   err_t res;
   u32_t ttl = MDNS_TTL_120;
-  struct mdns_domain service_instance;
-  mdns_build_service_domain(&service_instance, service, 1);
+  struct mdns_domain service_instance_buf;
+  struct mdns_domain *service_instance = mdns_service_domain(service, 1, &service_instance_buf);
+  if (service_instance == NULL) {
+    return ERR_VAL;
+  }
   mdns_prepare_txtdata(service);
   /* When answering to a legacy querier, we need to repeat the question and
    * limit the ttl to the short legacy ttl */
@@ -500,7 +536,7 @@ mdns_add_txt_answer(struct mdns_outpacket *reply, struct mdns_outmsg *msg,
      * (max one question), not for the additional records. */
     if(reply->questions < 1) {
       LWIP_DEBUGF(MDNS_DEBUG, ("MDNS: Add question for legacy query\n"));
-      res = mdns_add_question(reply, &service_instance, DNS_RRTYPE_TXT, DNS_RRCLASS_IN, 0);
+      res = mdns_add_question(reply, service_instance, DNS_RRTYPE_TXT, DNS_RRCLASS_IN, 0);
       if (res != ERR_OK) {
         return res;
       }
@@ -510,7 +546,7 @@ mdns_add_txt_answer(struct mdns_outpacket *reply, struct mdns_outmsg *msg,
     ttl = MDNS_TTL_10;
   }
   LWIP_DEBUGF(MDNS_DEBUG, ("MDNS: Responding with TXT record\n"));
-  return mdns_add_answer(reply, &service_instance, DNS_RRTYPE_TXT, DNS_RRCLASS_IN,
+  return mdns_add_answer(reply, service_instance, DNS_RRTYPE_TXT, DNS_RRCLASS_IN,
                          msg->cache_flush, ttl, (u8_t *) &service->txtdata.name,
                          service->txtdata.length, NULL);
 }
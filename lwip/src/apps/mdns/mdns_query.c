@@ -0,0 +1,852 @@
+/**
+ * @file
+ * MDNS responder implementation - querier and record cache
+ *
+ * @defgroup mdns_query Querier
+ * @ingroup mdns
+ * Records received in mDNS responses (A, AAAA, PTR and SRV) are kept in a
+ * cache until their TTL runs out (RFC6762 section 10), flushed when a newer
+ * record with the cache-flush bit set says so (RFC6762 section 10.2).
+ * Service types can be browsed continuously: PTR queries are sent with
+ * exponentially increasing intervals (RFC6762 section 5.2) and known answers
+ * (RFC6762 section 7.1), the application is told when instances come and go.
+ * .local host names are resolved from the cache, a cache miss sends a one-shot
+ * A/AAAA query so the answer is cached for the lookup to complete, see
+ * @ref mdns_query_lookup.
+ *
+ * The querier shares the mDNS UDP pcb of the responder, so only responses
+ * received on netifs with the responder enabled end up in the cache.
+ */
+
+/*
+ * Copyright (c) 2026 agent
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the lwIP TCP/IP stack.
+ *
+ * Author: agent <agent@local>
+ *
+ */
+
+#include "lwip/apps/mdns.h"
+#include "lwip/apps/mdns_priv.h"
+#include "lwip/apps/mdns_domain.h"
+#include "lwip/apps/mdns_out.h"
+#include "lwip/dns.h"
+#include "lwip/netif.h"
+#include "lwip/udp.h"
+#include "lwip/prot/dns.h"
+#include "lwip/prot/iana.h"
+#include "lwip/timeouts.h"
+#include "lwip/sys.h"
+
+#include <string.h>
+
+#if LWIP_MDNS_RESPONDER && LWIP_MDNS_QUERIER
+
+#if LWIP_IPV4
+/* IPv4 multicast group 224.0.0.251 */
+static const ip_addr_t v4group = DNS_MQUERY_IPV4_GROUP_INIT;
+#endif
+
+#if LWIP_IPV6
+/* IPv6 multicast group FF02::FB */
+static const ip_addr_t v6group = DNS_MQUERY_IPV6_GROUP_INIT;
+#endif
+
+/** Period of the querier timer, running while a browse is active */
+#define MDNS_QUERY_TMR_INTERVAL     1000
+
+/* RFC6762 section 5.2: The interval between the first two queries MUST be at
+ * least one second, the intervals between successive queries MUST increase by
+ * at least a factor of two. When the interval reaches one hour, it MAY be
+ * capped at that.
+ */
+#define MDNS_QUERY_INTERVAL_MIN     1000
+#define MDNS_QUERY_INTERVAL_MAX     (60 * 60 * 1000)
+
+/* RFC6762 section 5.2: the first query is delayed by 20-120 ms */
+#define MDNS_QUERY_INITIAL_DELAY    (LWIP_RAND() % 100 + 20)
+
+/* RFC6762 section 5.2: refresh queries at 80%, 85%, 90% and 95% of the TTL */
+#define MDNS_QUERY_REFRESH_PERCENT  80
+#define MDNS_QUERY_REFRESH_STEP     5
+#define MDNS_QUERY_REFRESH_COUNT    4
+
+/* RFC6762 section 10.1 and 10.2: goodbye records and records flushed by a
+ * cache-flush record are deleted one second later */
+#define MDNS_QUERY_FLUSH_DELAY      1000
+
+/* Upper limit for cached TTLs (one day), keeps the expiry in u32_t milliseconds */
+#define MDNS_QUERY_TTL_MAX          (24 * 60 * 60)
+
+/** A cached resource record */
+struct mdns_cache_entry {
+  /** Name of the record */
+  struct mdns_domain name;
+  /** PTR target or SRV host name */
+  struct mdns_domain target;
+  /** A or AAAA address */
+  ip_addr_t addr;
+  /** sys_now() when the record was received */
+  u32_t received;
+  /** Validity in milliseconds from 'received', 0 if the entry is unused */
+  u32_t ttl_ms;
+  /** SRV port */
+  u16_t port;
+  /** DNS_RRTYPE_xxx */
+  u16_t type;
+  /** Index of the netif the record was received on */
+  u8_t netif_idx;
+  /** Number of refresh queries triggered by this record */
+  u8_t refresh;
+};
+
+/** A service type being browsed */
+struct mdns_browse {
+  /** \<type\>.\<proto\>.local. domain, queried for PTR records */
+  struct mdns_domain type_domain;
+  /** Result callback, NULL if the slot is unused */
+  mdns_browse_result_fn_t result_fn;
+  void *arg;
+  /** sys_now() when the next query is due */
+  u32_t next_query;
+  /** Current interval between queries */
+  u32_t interval;
+  /** Index of the netif to browse on */
+  u8_t netif_idx;
+  /** Set if a cached instance needs a refresh query */
+  u8_t refresh;
+};
+
+static struct mdns_cache_entry mdns_cache[MDNS_QUERY_CACHE_SIZE];
+static struct mdns_browse mdns_browses[MDNS_MAX_BROWSE];
+static u8_t mdns_query_tmr_active;
+/** Host name of the last one-shot host query and when it was sent */
+static struct mdns_domain mdns_host_query_name;
+static u32_t mdns_host_query_time;
+
+static void mdns_query_tmr(void *arg);
+
+/**
+ * Get the remaining validity of a cached record
+ * @param entry The cache entry
+ * @param now Current sys_now()
+ * @return Milliseconds left, 0 if the record expired or the entry is unused
+ */
+static u32_t
+mdns_cache_remaining(const struct mdns_cache_entry *entry, u32_t now)
+{
+  u32_t elapsed = now - entry->received;
+  if ((entry->ttl_ms == 0) || (elapsed >= entry->ttl_ms)) {
+    return 0;
+  }
+  return entry->ttl_ms - elapsed;
+}
+
+/** Find the browse a cached record is an answer for, NULL if none */
+static struct mdns_browse *
+mdns_cache_browse(struct mdns_cache_entry *entry)
+{
+  int i;
+
+  if (entry->type != DNS_RRTYPE_PTR) {
+    return NULL;
+  }
+  for (i = 0; i < MDNS_MAX_BROWSE; i++) {
+    struct mdns_browse *browse = &mdns_browses[i];
+    if ((browse->result_fn != NULL) && (browse->netif_idx == entry->netif_idx) &&
+        mdns_domain_eq(&entry->name, &browse->type_domain)) {
+      return browse;
+    }
+  }
+  return NULL;
+}
+
+/** Tell the browse matching a cached PTR record that an instance was added or removed */
+static void
+mdns_cache_notify(struct mdns_cache_entry *entry, u8_t event)
+{
+  struct mdns_browse *browse = mdns_cache_browse(entry);
+
+  if (browse != NULL) {
+    char instance[MDNS_LABEL_MAXLEN + 1];
+    u8_t len = (u8_t)LWIP_MIN(entry->target.name[0], MDNS_LABEL_MAXLEN);
+
+    MEMCPY(instance, &entry->target.name[1], len);
+    instance[len] = '\0';
+    browse->result_fn(netif_get_by_index(browse->netif_idx), instance, event, browse->arg);
+  }
+}
+
+/** Drop a record from the cache */
+static void
+mdns_cache_remove(struct mdns_cache_entry *entry)
+{
+  LWIP_DEBUGF(MDNS_DEBUG, ("MDNS: Removing cached record for domain "));
+  mdns_domain_debug_print(&entry->name);
+  LWIP_DEBUGF(MDNS_DEBUG, (" type %d\n", entry->type));
+
+  mdns_cache_notify(entry, MDNS_BROWSE_REMOVED);
+  entry->ttl_ms = 0;
+}
+
+/** Compare the data of two records of the same type */
+static int
+mdns_cache_rdata_eq(struct mdns_cache_entry *a, struct mdns_cache_entry *b)
+{
+  switch (a->type) {
+    case DNS_RRTYPE_A:
+    case DNS_RRTYPE_AAAA:
+      return ip_addr_cmp(&a->addr, &b->addr);
+    case DNS_RRTYPE_SRV:
+      return (a->port == b->port) && mdns_domain_eq(&a->target, &b->target);
+    default:
+      return mdns_domain_eq(&a->target, &b->target);
+  }
+}
+
+/**
+ * Read the data of a received record into a cache entry
+ * @return ERR_OK if the record type is cached and its data is valid
+ */
+static err_t
+mdns_cache_read_rdata(struct mdns_cache_entry *rr, struct netif *netif, struct pbuf *p,
+                      u16_t rd_offset, u16_t rd_length)
+{
+  u16_t field16;
+
+  switch (rr->type) {
+#if LWIP_IPV4
+    case DNS_RRTYPE_A:
+      if ((rd_length != sizeof(ip4_addr_t)) ||
+          (pbuf_copy_partial(p, ip_2_ip4(&rr->addr), sizeof(ip4_addr_t), rd_offset) != sizeof(ip4_addr_t))) {
+        return ERR_VAL;
+      }
+      IP_SET_TYPE_VAL(rr->addr, IPADDR_TYPE_V4);
+      return ERR_OK;
+#endif /* LWIP_IPV4 */
+#if LWIP_IPV6
+    case DNS_RRTYPE_AAAA: {
+      ip6_addr_p_t addr6;
+      if ((rd_length != sizeof(ip6_addr_p_t)) ||
+          (pbuf_copy_partial(p, &addr6, sizeof(ip6_addr_p_t), rd_offset) != sizeof(ip6_addr_p_t))) {
+        return ERR_VAL;
+      }
+      ip6_addr_copy_from_packed(*ip_2_ip6(&rr->addr), addr6);
+      ip6_addr_assign_zone(ip_2_ip6(&rr->addr), IP6_UNICAST, netif);
+      IP_SET_TYPE_VAL(rr->addr, IPADDR_TYPE_V6);
+      return ERR_OK;
+    }
+#endif /* LWIP_IPV6 */
+    case DNS_RRTYPE_SRV:
+      /* Skip priority and weight */
+      if ((rd_length < 3 * sizeof(field16)) ||
+          (pbuf_copy_partial(p, &field16, sizeof(field16), (u16_t)(rd_offset + 2 * sizeof(field16))) != sizeof(field16))) {
+        return ERR_VAL;
+      }
+      rr->port = lwip_ntohs(field16);
+      if (mdns_readname(p, (u16_t)(rd_offset + 3 * sizeof(field16)), &rr->target) == MDNS_READNAME_ERROR) {
+        return ERR_VAL;
+      }
+      return ERR_OK;
+    case DNS_RRTYPE_PTR:
+      if (mdns_readname(p, rd_offset, &rr->target) == MDNS_READNAME_ERROR) {
+        return ERR_VAL;
+      }
+      return ERR_OK;
+    default:
+      LWIP_UNUSED_ARG(netif);
+      return ERR_VAL;
+  }
+}
+
+/**
+ * Put a record received in a response into the cache.
+ * Called for all records of a response.
+ * @param netif The network interface the response was received on
+ * @param name Name of the record
+ * @param type DNS type of the record
+ * @param cache_flush Set if the cache-flush bit of the record was set
+ * @param ttl TTL of the record in seconds
+ * @param p The received packet
+ * @param rd_offset Offset of the record data in p
+ * @param rd_length Length of the record data
+ */
+void
+mdns_query_cache_answer(struct netif *netif, struct mdns_domain *name, u16_t type,
+                        u16_t cache_flush, u32_t ttl, struct pbuf *p,
+                        u16_t rd_offset, u16_t rd_length)
+{
+  struct mdns_cache_entry rr;
+  struct mdns_cache_entry *entry = NULL;
+  struct mdns_cache_entry *victim = NULL;
+  u32_t victim_remaining = 0xFFFFFFFFUL;
+  u32_t now = sys_now();
+  int i;
+
+  memset(&rr, 0, sizeof(rr));
+  rr.type = type;
+  if (mdns_cache_read_rdata(&rr, netif, p, rd_offset, rd_length) != ERR_OK) {
+    return;
+  }
+  SMEMCPY(&rr.name, name, sizeof(rr.name));
+  rr.netif_idx = netif_get_index(netif);
+  rr.received = now;
+  if (ttl == 0) {
+    /* Goodbye record (RFC6762 section 10.1) */
+    rr.ttl_ms = MDNS_QUERY_FLUSH_DELAY;
+  } else {
+    rr.ttl_ms = LWIP_MIN(ttl, MDNS_QUERY_TTL_MAX) * 1000;
+  }
+
+  for (i = 0; i < MDNS_QUERY_CACHE_SIZE; i++) {
+    struct mdns_cache_entry *e = &mdns_cache[i];
+    u32_t remaining = mdns_cache_remaining(e, now);
+
+    if (remaining < victim_remaining) {
+      victim = e;
+      victim_remaining = remaining;
+    }
+    if ((remaining == 0) || (e->netif_idx != rr.netif_idx) || (e->type != type) ||
+        !mdns_domain_eq(&e->name, &rr.name)) {
+      continue;
+    }
+    if (mdns_cache_rdata_eq(e, &rr)) {
+      entry = e;
+    } else if (cache_flush && (now - e->received > MDNS_QUERY_FLUSH_DELAY) &&
+               (remaining > MDNS_QUERY_FLUSH_DELAY)) {
+      /* RFC6762 section 10.2: records with the same name, type and class
+       * received more than one second ago are flushed one second from now */
+      e->received = now;
+      e->ttl_ms = MDNS_QUERY_FLUSH_DELAY;
+    }
+  }
+
+  if (entry != NULL) {
+    /* Known record: restart its TTL */
+    entry->received = now;
+    entry->ttl_ms = rr.ttl_ms;
+    entry->refresh = 0;
+    return;
+  }
+  if ((ttl == 0) || (victim == NULL)) {
+    return;
+  }
+
+  /* Replace a free or expired entry, or the one closest to expiry */
+  if (victim->ttl_ms != 0) {
+    mdns_cache_remove(victim);
+  }
+  SMEMCPY(victim, &rr, sizeof(rr));
+
+  LWIP_DEBUGF(MDNS_DEBUG, ("MDNS: Cached record for domain "));
+  mdns_domain_debug_print(&victim->name);
+  LWIP_DEBUGF(MDNS_DEBUG, (" type %d ttl %"U32_F"\n", type, ttl));
+
+  mdns_cache_notify(victim, MDNS_BROWSE_ADDED);
+}
+
+/**
+ * Send a browse query with the known answers from the cache
+ * @param browse The browse to query for
+ * @param netif The network interface to send on
+ * @param destination Multicast group to send to
+ * @return ERR_OK if the query was sent, an err_t otherwise
+ */
+static err_t
+mdns_browse_send_query(struct mdns_browse *browse, struct netif *netif, const ip_addr_t *destination)
+{
+  struct mdns_outpacket outpkt;
+  struct dns_hdr hdr;
+  u32_t now = sys_now();
+  err_t res;
+  int i;
+
+  memset(&outpkt, 0, sizeof(outpkt));
+  res = mdns_add_question(&outpkt, &browse->type_domain, DNS_RRTYPE_PTR, DNS_RRCLASS_IN, 0);
+  if (res == ERR_OK) {
+    /* Known answer suppression (RFC6762 section 7.1): list the instances
+     * with more than half of their TTL left, as many as fit */
+    for (i = 0; i < MDNS_QUERY_CACHE_SIZE; i++) {
+      struct mdns_cache_entry *e = &mdns_cache[i];
+      u32_t remaining = mdns_cache_remaining(e, now);
+
+      if ((remaining > e->ttl_ms / 2) && (mdns_cache_browse(e) == browse)) {
+        if (mdns_add_answer(&outpkt, &e->name, DNS_RRTYPE_PTR, DNS_RRCLASS_IN, 0,
+                            remaining / 1000, NULL, 0, &e->target) != ERR_OK) {
+          break;
+        }
+        outpkt.answers++;
+      }
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.numquestions = PP_HTONS(1);
+    hdr.numanswers = lwip_htons(outpkt.answers);
+    pbuf_take(outpkt.pbuf, &hdr, sizeof(hdr));
+    pbuf_realloc(outpkt.pbuf, outpkt.write_offset);
+
+    LWIP_DEBUGF(MDNS_DEBUG, ("MDNS: Sending browse query, %d known answers\n", outpkt.answers));
+    res = udp_sendto_if(get_mdns_pcb(), outpkt.pbuf, destination, LWIP_IANA_PORT_MDNS, netif);
+  }
+
+  if (outpkt.pbuf) {
+    pbuf_free(outpkt.pbuf);
+  }
+  return res;
+}
+
+/** Send a browse query to all multicast groups */
+static void
+mdns_browse_query(struct mdns_browse *browse)
+{
+  struct netif *netif = netif_get_by_index(browse->netif_idx);
+
+  if ((netif == NULL) || (netif_mdns_data(netif) == NULL)) {
+    return;
+  }
+#if LWIP_IPV4
+  if (!ip4_addr_isany_val(*netif_ip4_addr(netif))) {
+    mdns_browse_send_query(browse, netif, &v4group);
+  }
+#endif
+#if LWIP_IPV6
+  mdns_browse_send_query(browse, netif, &v6group);
+#endif
+}
+
+/** (Re)start the querier timer if a browse is active, stop it otherwise */
+static void
+mdns_query_tmr_start(u32_t msecs)
+{
+  int i;
+
+  if (mdns_query_tmr_active) {
+    sys_untimeout(mdns_query_tmr, NULL);
+    mdns_query_tmr_active = 0;
+  }
+  for (i = 0; i < MDNS_MAX_BROWSE; i++) {
+    if (mdns_browses[i].result_fn != NULL) {
+      sys_timeout(msecs, mdns_query_tmr, NULL);
+      mdns_query_tmr_active = 1;
+      return;
+    }
+  }
+}
+
+/**
+ * Querier timer: expire cached records and send browse queries when due
+ */
+static void
+mdns_query_tmr(void *arg)
+{
+  u32_t now = sys_now();
+  int i;
+
+  LWIP_UNUSED_ARG(arg);
+  mdns_query_tmr_active = 0;
+
+  for (i = 0; i < MDNS_QUERY_CACHE_SIZE; i++) {
+    struct mdns_cache_entry *e = &mdns_cache[i];
+    struct mdns_browse *browse;
+
+    if (e->ttl_ms == 0) {
+      continue;
+    }
+    if (mdns_cache_remaining(e, now) == 0) {
+      mdns_cache_remove(e);
+      continue;
+    }
+    browse = mdns_cache_browse(e);
+    if ((browse != NULL) && (e->refresh < MDNS_QUERY_REFRESH_COUNT) &&
+        (now - e->received >= e->ttl_ms / 100 * (MDNS_QUERY_REFRESH_PERCENT + MDNS_QUERY_REFRESH_STEP * e->refresh))) {
+      e->refresh++;
+      browse->refresh = 1;
+    }
+  }
+
+  for (i = 0; i < MDNS_MAX_BROWSE; i++) {
+    struct mdns_browse *browse = &mdns_browses[i];
+
+    if (browse->result_fn == NULL) {
+      continue;
+    }
+    if ((s32_t)(now - browse->next_query) >= 0) {
+      mdns_browse_query(browse);
+      browse->next_query = now + browse->interval;
+      browse->interval = LWIP_MIN(browse->interval * 2, MDNS_QUERY_INTERVAL_MAX);
+    } else if (browse->refresh) {
+      mdns_browse_query(browse);
+    }
+    browse->refresh = 0;
+  }
+
+  mdns_query_tmr_start(MDNS_QUERY_TMR_INTERVAL);
+}
+
+/**
+ * @ingroup mdns_query
+ * Start browsing for instances of a service type on a netif. Queries are sent
+ * until @ref mdns_query_browse_stop is called, with increasing intervals and
+ * when cached instances are about to expire.
+ * result_fn is called for all instances already in the cache, then whenever an
+ * instance is found, leaves or its record expires.
+ * @param netif The network interface to browse on, the responder must be enabled on it
+ * @param service Type of service, like '_http'
+ * @param proto Protocol of the service, DNSSD_PROTO_TCP or DNSSD_PROTO_UDP
+ * @param result_fn Function called with instances found and lost
+ * @param arg Argument passed to result_fn
+ * @return browse slot number (to stop browsing) or negative err_t on error
+ */
+s8_t
+mdns_query_browse_start(struct netif *netif, const char *service, enum mdns_sd_proto proto,
+                        mdns_browse_result_fn_t result_fn, void *arg)
+{
+  struct mdns_browse *browse;
+  u32_t delay;
+  s8_t slot;
+  int i;
+
+  LWIP_ASSERT_CORE_LOCKED();
+  LWIP_ASSERT("mdns_query_browse_start: netif != NULL", netif);
+  LWIP_ERROR("mdns_query_browse_start: Not an mdns netif", (netif_mdns_data(netif) != NULL), return ERR_VAL);
+  LWIP_ERROR("mdns_query_browse_start: No result function", (result_fn != NULL), return ERR_ARG);
+  LWIP_ERROR("mdns_query_browse_start: Service too long", (strlen(service) <= MDNS_LABEL_MAXLEN), return ERR_VAL);
+  LWIP_ERROR("mdns_query_browse_start: Bad proto (need TCP or UDP)", (proto == DNSSD_PROTO_TCP || proto == DNSSD_PROTO_UDP), return ERR_VAL);
+
+  for (slot = 0; slot < MDNS_MAX_BROWSE; slot++) {
+    if (mdns_browses[slot].result_fn == NULL) {
+      break;
+    }
+  }
+  LWIP_ERROR("mdns_query_browse_start: Browse list full (increase MDNS_MAX_BROWSE)", (slot < MDNS_MAX_BROWSE), return ERR_MEM);
+
+  browse = &mdns_browses[slot];
+  if (mdns_build_named_service_domain(&browse->type_domain, NULL, service, proto) != ERR_OK) {
+    return ERR_VAL;
+  }
+  delay = MDNS_QUERY_INITIAL_DELAY;
+  browse->arg = arg;
+  browse->netif_idx = netif_get_index(netif);
+  browse->interval = MDNS_QUERY_INTERVAL_MIN;
+  browse->next_query = sys_now() + delay;
+  browse->refresh = 0;
+  browse->result_fn = result_fn;
+
+  /* Report the instances we already know about */
+  for (i = 0; i < MDNS_QUERY_CACHE_SIZE; i++) {
+    struct mdns_cache_entry *e = &mdns_cache[i];
+    if ((mdns_cache_remaining(e, sys_now()) != 0) && (mdns_cache_browse(e) == browse)) {
+      mdns_cache_notify(e, MDNS_BROWSE_ADDED);
+    }
+  }
+
+  mdns_query_tmr_start(delay);
+  return slot;
+}
+
+/**
+ * @ingroup mdns_query
+ * Stop browsing for a service type
+ * @param slot The browse slot number returned by @ref mdns_query_browse_start
+ * @return ERR_OK if browse was stopped, an err_t otherwise
+ */
+err_t
+mdns_query_browse_stop(s8_t slot)
+{
+  LWIP_ASSERT_CORE_LOCKED();
+  LWIP_ERROR("mdns_query_browse_stop: Invalid Service index", (slot >= 0) && (slot < MDNS_MAX_BROWSE), return ERR_VAL);
+  LWIP_ERROR("mdns_query_browse_stop: Invalid Service index", (mdns_browses[slot].result_fn != NULL), return ERR_VAL);
+
+  mdns_browses[slot].result_fn = NULL;
+  mdns_query_tmr_start(MDNS_QUERY_TMR_INTERVAL);
+  return ERR_OK;
+}
+
+/**
+ * Stop all browses on a netif and drop the records received on it.
+ * Called when the responder is removed from the netif.
+ * @param netif The network interface
+ */
+void
+mdns_query_netif_removed(struct netif *netif)
+{
+  u8_t netif_idx = netif_get_index(netif);
+  int i;
+
+  for (i = 0; i < MDNS_MAX_BROWSE; i++) {
+    if (mdns_browses[i].netif_idx == netif_idx) {
+      mdns_browses[i].result_fn = NULL;
+    }
+  }
+  for (i = 0; i < MDNS_QUERY_CACHE_SIZE; i++) {
+    if (mdns_cache[i].netif_idx == netif_idx) {
+      mdns_cache[i].ttl_ms = 0;
+    }
+  }
+  mdns_query_tmr_start(MDNS_QUERY_TMR_INTERVAL);
+}
+
+/** Find the address of a cached A or AAAA record */
+static err_t
+mdns_cache_lookup_addr(struct mdns_domain *domain, u16_t type, ip_addr_t *addr)
+{
+  u32_t now = sys_now();
+  int i;
+
+  for (i = 0; i < MDNS_QUERY_CACHE_SIZE; i++) {
+    struct mdns_cache_entry *e = &mdns_cache[i];
+    if ((e->type == type) && (mdns_cache_remaining(e, now) != 0) &&
+        mdns_domain_eq(&e->name, domain)) {
+      ip_addr_copy(*addr, e->addr);
+      return ERR_OK;
+    }
+  }
+  return ERR_ARG;
+}
+
+/** Check if a host name ends in .local (a trailing dot is allowed) */
+static int
+mdns_name_is_local(const char *name, size_t namelen)
+{
+  if ((namelen > 0) && (name[namelen - 1] == '.')) {
+    namelen--;
+  }
+  return (namelen > 6) && (lwip_strnicmp(&name[namelen - 6], ".local", 6) == 0);
+}
+
+/**
+ * Send a one-shot query for the addresses of a host
+ * @param domain The host name
+ * @param types DNS_RRTYPE_A and/or DNS_RRTYPE_AAAA
+ * @param num_types Number of entries in types
+ * @param netif The network interface to send on
+ * @param destination Multicast group to send to
+ * @return ERR_OK if the query was sent, an err_t otherwise
+ */
+static err_t
+mdns_host_send_query(struct mdns_domain *domain, const u16_t *types, int num_types,
+                     struct netif *netif, const ip_addr_t *destination)
+{
+  struct mdns_outpacket outpkt;
+  struct dns_hdr hdr;
+  err_t res = ERR_OK;
+  int i;
+
+  memset(&outpkt, 0, sizeof(outpkt));
+  for (i = 0; (i < num_types) && (res == ERR_OK); i++) {
+    res = mdns_add_question(&outpkt, domain, types[i], DNS_RRCLASS_IN, 0);
+  }
+  if (res == ERR_OK) {
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.numquestions = lwip_htons((u16_t)num_types);
+    pbuf_take(outpkt.pbuf, &hdr, sizeof(hdr));
+    pbuf_realloc(outpkt.pbuf, outpkt.write_offset);
+
+    LWIP_DEBUGF(MDNS_DEBUG, ("MDNS: Sending host query\n"));
+    res = udp_sendto_if(get_mdns_pcb(), outpkt.pbuf, destination, LWIP_IANA_PORT_MDNS, netif);
+  }
+
+  if (outpkt.pbuf) {
+    pbuf_free(outpkt.pbuf);
+  }
+  return res;
+}
+
+/**
+ * Query for the addresses of a host on all netifs with the responder enabled.
+ * The answers are multicast (RFC6762 section 6) and end up in the cache.
+ * Repeated lookups of the same name send at most one query per
+ * MDNS_QUERY_INTERVAL_MIN (RFC6762 section 5.2).
+ * @return ERR_OK if a query for the host was sent (now or less than
+ *         MDNS_QUERY_INTERVAL_MIN ago), an err_t otherwise
+ */
+static err_t
+mdns_host_query(struct mdns_domain *domain, const u16_t *types, int num_types)
+{
+  struct netif *netif;
+  u32_t now = sys_now();
+  err_t res = ERR_CONN;
+
+  if (mdns_domain_eq(&mdns_host_query_name, domain) &&
+      (now - mdns_host_query_time < MDNS_QUERY_INTERVAL_MIN)) {
+    return ERR_OK;
+  }
+
+  NETIF_FOREACH(netif) {
+    if ((netif_mdns_data(netif) == NULL) || !netif_is_up(netif)) {
+      continue;
+    }
+#if LWIP_IPV4
+    if (!ip4_addr_isany_val(*netif_ip4_addr(netif)) &&
+        (mdns_host_send_query(domain, types, num_types, netif, &v4group) == ERR_OK)) {
+      res = ERR_OK;
+    }
+#endif
+#if LWIP_IPV6
+    if (mdns_host_send_query(domain, types, num_types, netif, &v6group) == ERR_OK) {
+      res = ERR_OK;
+    }
+#endif
+  }
+  if (res == ERR_OK) {
+    SMEMCPY(&mdns_host_query_name, domain, sizeof(struct mdns_domain));
+    mdns_host_query_time = now;
+  }
+  return res;
+}
+
+/**
+ * @ingroup mdns_query
+ * Resolve a .local host name from the records cached on any netif.
+ * If no address is cached, a one-shot A/AAAA query is multicast on all netifs
+ * with the responder enabled and ERR_INPROGRESS is returned; the answers are
+ * cached, so a later lookup of the same name succeeds.
+ * The signature matches DNS_LOOKUP_LOCAL_EXTERN, so .local names are resolved
+ * by @ref dns_gethostbyname with
+ * \#define DNS_LOOKUP_LOCAL_EXTERN(name, namelen, addr, dns_addrtype) mdns_query_lookup(name, namelen, addr, dns_addrtype)
+ * Names learned by the querier are then resolved instantly. On a cache miss,
+ * dns.c sends no query of its own and repeats the lookup until the answer is
+ * cached or the request times out.
+ * @param name Host name, like 'myhost.local'
+ * @param namelen Length of name
+ * @param addr Where to store the address
+ * @param dns_addrtype LWIP_DNS_ADDRTYPE_xxx, ignored without LWIP_DNS (IPv4 is tried first)
+ * @return ERR_OK if an address was found, ERR_INPROGRESS if a query was sent
+ *         for it, an err_t otherwise
+ */
+err_t
+mdns_query_lookup(const char *name, size_t namelen, ip_addr_t *addr, u8_t dns_addrtype)
+{
+  struct mdns_domain domain;
+  u16_t first, second;
+
+  LWIP_ASSERT_CORE_LOCKED();
+  if (mdns_build_name_domain(&domain, name, namelen) != ERR_OK) {
+    return ERR_ARG;
+  }
+
+#if LWIP_IPV4 && LWIP_IPV6 && LWIP_DNS
+  if ((dns_addrtype == LWIP_DNS_ADDRTYPE_IPV6) || (dns_addrtype == LWIP_DNS_ADDRTYPE_IPV6_IPV4)) {
+    first = DNS_RRTYPE_AAAA;
+    second = (dns_addrtype == LWIP_DNS_ADDRTYPE_IPV6_IPV4) ? DNS_RRTYPE_A : 0;
+  } else {
+    first = DNS_RRTYPE_A;
+    second = (dns_addrtype == LWIP_DNS_ADDRTYPE_IPV4_IPV6) ? DNS_RRTYPE_AAAA : 0;
+  }
+#elif LWIP_IPV4 && LWIP_IPV6
+  LWIP_UNUSED_ARG(dns_addrtype);
+  first = DNS_RRTYPE_A;
+  second = DNS_RRTYPE_AAAA;
+#else
+  LWIP_UNUSED_ARG(dns_addrtype);
+  first = LWIP_IPV4 ? DNS_RRTYPE_A : DNS_RRTYPE_AAAA;
+  second = 0;
+#endif
+
+  if (mdns_cache_lookup_addr(&domain, first, addr) == ERR_OK) {
+    return ERR_OK;
+  }
+  if ((second != 0) && (mdns_cache_lookup_addr(&domain, second, addr) == ERR_OK)) {
+    return ERR_OK;
+  }
+  if (mdns_name_is_local(name, namelen)) {
+    u16_t types[2];
+    types[0] = first;
+    types[1] = second;
+    if (mdns_host_query(&domain, types, (second != 0) ? 2 : 1) == ERR_OK) {
+      return ERR_INPROGRESS;
+    }
+  }
+  return ERR_ARG;
+}
+
+/**
+ * @ingroup mdns_query
+ * Get host name and port of a service instance from the cache, e.g. one reported
+ * by browsing. The address of the host can then be resolved with
+ * @ref mdns_query_lookup.
+ * @param netif The network interface the instance was seen on
+ * @param instance Instance name, like 'myweb'
+ * @param service Type of service, like '_http'
+ * @param proto Protocol of the service, DNSSD_PROTO_TCP or DNSSD_PROTO_UDP
+ * @param host Where to store the host name, like 'myhost.local'
+ * @param host_len Size of host
+ * @param port Where to store the port
+ * @return ERR_OK if the instance was found, ERR_ARG if not, ERR_MEM if host is too small
+ */
+err_t
+mdns_query_lookup_service(struct netif *netif, const char *instance, const char *service,
+                          enum mdns_sd_proto proto, char *host, size_t host_len, u16_t *port)
+{
+  struct mdns_domain domain;
+  u8_t netif_idx;
+  u32_t now = sys_now();
+  int i;
+
+  LWIP_ASSERT_CORE_LOCKED();
+  LWIP_ASSERT("mdns_query_lookup_service: netif != NULL", netif);
+  LWIP_ERROR("mdns_query_lookup_service: Name too long", (strlen(instance) <= MDNS_LABEL_MAXLEN), return ERR_VAL);
+  LWIP_ERROR("mdns_query_lookup_service: Service too long", (strlen(service) <= MDNS_LABEL_MAXLEN), return ERR_VAL);
+  LWIP_ERROR("mdns_query_lookup_service: Bad proto (need TCP or UDP)", (proto == DNSSD_PROTO_TCP || proto == DNSSD_PROTO_UDP), return ERR_VAL);
+
+  if (mdns_build_named_service_domain(&domain, instance, service, proto) != ERR_OK) {
+    return ERR_VAL;
+  }
+  netif_idx = netif_get_index(netif);
+
+  for (i = 0; i < MDNS_QUERY_CACHE_SIZE; i++) {
+    struct mdns_cache_entry *e = &mdns_cache[i];
+    if ((e->type == DNS_RRTYPE_SRV) && (e->netif_idx == netif_idx) &&
+        (mdns_cache_remaining(e, now) != 0) && mdns_domain_eq(&e->name, &domain)) {
+      u16_t pos = 0;
+      size_t len = 0;
+
+      /* Write target as dotted name */
+      while ((pos < e->target.length) && (e->target.name[pos] != 0)) {
+        u8_t label_len = e->target.name[pos];
+        if ((len != 0) + len + label_len + 1 > host_len) {
+          return ERR_MEM;
+        }
+        if (len != 0) {
+          host[len++] = '.';
+        }
+        MEMCPY(&host[len], &e->target.name[pos + 1], label_len);
+        len += label_len;
+        pos += label_len + 1;
+      }
+      if (host_len == 0) {
+        return ERR_MEM;
+      }
+      host[len] = '\0';
+      *port = e->port;
+      return ERR_OK;
+    }
+  }
+  return ERR_ARG;
+}
+
+#endif /* LWIP_MDNS_RESPONDER && LWIP_MDNS_QUERIER */
@@ -39,7 +39,6 @@
  *
  *
  * @todo:
- * - Handle large outgoing payloads for PUBLISH messages
  * - Fix restriction of a single topic in each (UN)SUBSCRIBE message (protocol has support for multiple topics)
  * - Add support for legacy MQTT protocol version
  *
@@ -225,46 +224,155 @@ mqtt_ringbuf_len(struct mqtt_ringbuf_t *rb)
 /** Return number of bytes possible to read without wrapping around */
 #define mqtt_ringbuf_linear_read_length(rb) LWIP_MIN(mqtt_ringbuf_len(rb), (MQTT_OUTPUT_RINGBUF_SIZE - (rb)->get))
 
+/** Return output queue entry at position 'idx' (counted from the oldest entry) */
+#define mqtt_out_pbuf_at(client, idx) (&(client)->out_pbuf[((client)->out_pbuf_first + (idx)) % MQTT_OUTPUT_PBUF_QUEUE_LEN])
+
 /**
- * Try send as many bytes as possible from output ring buffer
- * @param rb Output ring buffer
- * @param tpcb TCP connection handle
+ * Queue a payload pbuf for output after the data currently in the output ring buffer.
+ * The pbuf is referenced (not copied) until the data has been acknowledged.
+ * @param client MQTT client
+ * @param p Payload pbuf
  */
 static void
-mqtt_output_send(struct mqtt_ringbuf_t *rb, struct altcp_pcb *tpcb)
+mqtt_output_append_pbuf(mqtt_client_t *client, struct pbuf *p)
 {
-  err_t err;
-  u8_t wrap = 0;
-  u16_t ringbuf_lin_len = mqtt_ringbuf_linear_read_length(rb);
-  u16_t send_len = altcp_sndbuf(tpcb);
-  LWIP_ASSERT("mqtt_output_send: tpcb != NULL", tpcb != NULL);
+  struct mqtt_out_pbuf_t *op;
+  LWIP_ASSERT("mqtt_output_append_pbuf: queue full", client->out_pbuf_len < MQTT_OUTPUT_PBUF_QUEUE_LEN);
+
+  op = mqtt_out_pbuf_at(client, client->out_pbuf_len);
+  pbuf_ref(p);
+  op->p = p;
+  op->ring_mark = client->ring_sent + mqtt_ringbuf_len(&client->output);
+  op->end = 0;
+  op->offset = 0;
+  client->out_pbuf_len++;
+}
 
-  if (send_len == 0 || ringbuf_lin_len == 0) {
-    return;
+/**
+ * Free queued payload pbufs that have been acknowledged
+ * @param client MQTT client
+ * @param len Number of bytes acknowledged
+ */
+static void
+mqtt_output_acked(mqtt_client_t *client, u16_t len)
+{
+  client->tx_acked += len;
+  while (client->out_pbuf_unacked > 0) {
+    struct mqtt_out_pbuf_t *op = mqtt_out_pbuf_at(client, 0);
+    if ((s32_t)(client->tx_acked - op->end) < 0) {
+      break;
+    }
+    pbuf_free(op->p);
+    op->p = NULL;
+    client->out_pbuf_first = (u8_t)((client->out_pbuf_first + 1) % MQTT_OUTPUT_PBUF_QUEUE_LEN);
+    client->out_pbuf_unacked--;
+    client->out_pbuf_len--;
   }
+}
 
-  LWIP_DEBUGF(MQTT_DEBUG_TRACE, ("mqtt_output_send: tcp_sndbuf: %d bytes, ringbuf_linear_available: %d, get %d, put %d\n",
-                                 send_len, ringbuf_lin_len, rb->get, rb->put));
+/**
+ * Check if the connection still references payload pbufs (written but not acknowledged)
+ * @param client MQTT client
+ * @return 1 if payload data is referenced, 0 otherwise
+ */
+static u8_t
+mqtt_output_referenced(mqtt_client_t *client)
+{
+  if (client->out_pbuf_unacked > 0) {
+    return 1;
+  }
+  return (client->out_pbuf_len > 0) && (mqtt_out_pbuf_at(client, 0)->offset > 0);
+}
 
-  if (send_len > ringbuf_lin_len) {
-    /* Space in TCP output buffer is larger than available in ring buffer linear portion */
-    send_len = ringbuf_lin_len;
-    /* Wrap around if more data in ring buffer after linear portion */
-    wrap = (mqtt_ringbuf_len(rb) > ringbuf_lin_len);
+/**
+ * Free all queued payload pbufs
+ * @param client MQTT client
+ */
+static void
+mqtt_output_clear(mqtt_client_t *client)
+{
+  while (client->out_pbuf_len > 0) {
+    struct mqtt_out_pbuf_t *op = mqtt_out_pbuf_at(client, 0);
+    pbuf_free(op->p);
+    op->p = NULL;
+    client->out_pbuf_first = (u8_t)((client->out_pbuf_first + 1) % MQTT_OUTPUT_PBUF_QUEUE_LEN);
+    client->out_pbuf_len--;
   }
-  err = altcp_write(tpcb, mqtt_ringbuf_get_ptr(rb), send_len, TCP_WRITE_FLAG_COPY | (wrap ? TCP_WRITE_FLAG_MORE : 0));
-  if ((err == ERR_OK) && wrap) {
-    mqtt_ringbuf_advance_get_idx(rb, send_len);
-    /* Use the lesser one of ring buffer linear length and TCP send buffer size */
-    send_len = LWIP_MIN(altcp_sndbuf(tpcb), mqtt_ringbuf_linear_read_length(rb));
-    err = altcp_write(tpcb, mqtt_ringbuf_get_ptr(rb), send_len, TCP_WRITE_FLAG_COPY);
+  client->out_pbuf_unacked = 0;
+}
+
+/**
+ * Try send as many bytes as possible from output ring buffer and queued payload pbufs.
+ * Ring buffer data is copied, payload pbufs are written by reference.
+ * @param client MQTT client
+ */
+static void
+mqtt_output_send(mqtt_client_t *client)
+{
+  struct mqtt_ringbuf_t *rb = &client->output;
+  struct altcp_pcb *tpcb = client->conn;
+  err_t err = ERR_OK;
+  u8_t written = 0;
+  u8_t more;
+  LWIP_ASSERT("mqtt_output_send: tpcb != NULL", tpcb != NULL);
+
+  while (err == ERR_OK) {
+    struct mqtt_out_pbuf_t *op = NULL;
+    u32_t ring_len = mqtt_ringbuf_len(rb);
+    u16_t send_len = altcp_sndbuf(tpcb);
+
+    if (client->out_pbuf_unacked < client->out_pbuf_len) {
+      op = mqtt_out_pbuf_at(client, client->out_pbuf_unacked);
+      /* Ring buffer data queued before the payload goes first */
+      ring_len = LWIP_MIN(ring_len, op->ring_mark - client->ring_sent);
+    }
+    if (send_len == 0 || (ring_len == 0 && op == NULL)) {
+      break;
+    }
+
+    LWIP_DEBUGF(MQTT_DEBUG_TRACE, ("mqtt_output_send: tcp_sndbuf: %d bytes, ringbuf available: %d, get %d, put %d, pbufs %d\n",
+                                   send_len, (int)ring_len, rb->get, rb->put, client->out_pbuf_len - client->out_pbuf_unacked));
+
+    if (ring_len > 0) {
+      /* Use the lesser one of ring buffer linear length and TCP send buffer size */
+      send_len = (u16_t)LWIP_MIN(send_len, LWIP_MIN(ring_len, (u32_t)mqtt_ringbuf_linear_read_length(rb)));
+      more = (send_len < mqtt_ringbuf_len(rb)) || (op != NULL);
+      err = altcp_write(tpcb, mqtt_ringbuf_get_ptr(rb), send_len, TCP_WRITE_FLAG_COPY | (more ? TCP_WRITE_FLAG_MORE : 0));
+      if (err == ERR_OK) {
+        mqtt_ringbuf_advance_get_idx(rb, send_len);
+        client->ring_sent += send_len;
+      }
+    } else {
+      /* Write payload without copying, it is kept until acknowledged */
+      struct pbuf *q = op->p;
+      u16_t offset = op->offset;
+      while (offset >= q->len) {
+        offset = (u16_t)(offset - q->len);
+        q = q->next;
+      }
+      send_len = LWIP_MIN(send_len, (u16_t)(q->len - offset));
+      more = (op->offset + send_len < op->p->tot_len) || (mqtt_ringbuf_len(rb) > 0) ||
+             (client->out_pbuf_unacked + 1 < client->out_pbuf_len);
+      err = altcp_write(tpcb, (const u8_t *)q->payload + offset, send_len, more ? TCP_WRITE_FLAG_MORE : 0);
+      if (err == ERR_OK) {
+        op->offset = (u16_t)(op->offset + send_len);
+        if (op->offset == op->p->tot_len) {
+          op->end = client->tx_written + send_len;
+          client->out_pbuf_unacked++;
+        }
+      }
+    }
+    if (err == ERR_OK) {
+      client->tx_written += send_len;
+      written = 1;
+    }
   }
 
-  if (err == ERR_OK) {
-    mqtt_ringbuf_advance_get_idx(rb, send_len);
+  if (written) {
     /* Flush */
     altcp_output(tpcb);
-  } else {
+  }
+  if (err != ERR_OK) {
     LWIP_DEBUGF(MQTT_DEBUG_WARN, ("mqtt_output_send: Send failed with err %d (\"%s\")\n", err, lwip_strerr(err)));
   }
 }
@@ -275,61 +383,98 @@ mqtt_output_send(struct mqtt_ringbuf_t *rb, struct altcp_pcb *tpcb)
 /* Request queue */
 
 /**
- * Create request item
- * @param r_objs Pointer to request objects
- * @param r_objs_len Number of array entries
- * @param pkt_id Packet identifier of request
+ * Create request item.
+ * Requests with a packet identifier live in the slot selected by the identifier
+ * (modulo window size), so responses are matched without searching.
+ * @param client MQTT client
+ * @param need_id 1 to allocate a packet identifier (QoS 1 and 2), 0 to use the reserved value 0
  * @param cb Packet callback to call when requests lifetime ends
  * @param arg Parameter following callback
  * @return Request or NULL if failed to create
  */
 static struct mqtt_request_t *
-mqtt_create_request(struct mqtt_request_t *r_objs, size_t r_objs_len, u16_t pkt_id, mqtt_request_cb_t cb, void *arg)
+mqtt_create_request(mqtt_client_t *client, u8_t need_id, mqtt_request_cb_t cb, void *arg)
 {
   struct mqtt_request_t *r = NULL;
-  u8_t n;
-  LWIP_ASSERT("mqtt_create_request: r_objs != NULL", r_objs != NULL);
-  for (n = 0; n < r_objs_len; n++) {
-    /* Item point to itself if not in use */
-    if (r_objs[n].next == &r_objs[n]) {
-      r = &r_objs[n];
-      r->next = NULL;
-      r->cb = cb;
-      r->arg = arg;
-      r->pkt_id = pkt_id;
-      break;
+  u16_t n;
+  LWIP_ASSERT("mqtt_create_request: req_list != NULL", client->req_list != NULL);
+  if (need_id) {
+    /* Skip identifiers whose slot is in use, one more try for the skipped id 0 */
+    for (n = 0; n <= client->req_list_len; n++) {
+      u16_t pkt_id = msg_generate_packet_id(client);
+      struct mqtt_request_t *iter = &client->req_list[pkt_id % client->req_list_len];
+      /* Item point to itself if not in use */
+      if (iter->next == iter) {
+        r = iter;
+        r->pkt_id = pkt_id;
+        break;
+      }
+    }
+  } else {
+    for (n = 0; n < client->req_list_len; n++) {
+      if (client->req_list[n].next == &client->req_list[n]) {
+        r = &client->req_list[n];
+        r->pkt_id = 0;
+        break;
+      }
     }
   }
+  if (r != NULL) {
+    r->next = NULL;
+    r->prev = NULL;
+    r->cb = cb;
+    r->arg = arg;
+    r->p = NULL;
+    r->flags = 0;
+  }
   return r;
 }
 
 
 /**
  * Append request to pending request queue
- * @param tail Pointer to request queue tail pointer
+ * @param client MQTT client
  * @param r Request to append
  */
 static void
-mqtt_append_request(struct mqtt_request_t **tail, struct mqtt_request_t *r)
+mqtt_append_request(mqtt_client_t *client, struct mqtt_request_t *r)
 {
-  struct mqtt_request_t *head = NULL;
-  s16_t time_before = 0;
-  struct mqtt_request_t *iter;
-
-  LWIP_ASSERT("mqtt_append_request: tail != NULL", tail != NULL);
-
-  /* Iterate trough queue to find head, and count total timeout time */
-  for (iter = *tail; iter != NULL; iter = iter->next) {
-    time_before += iter->timeout_diff;
-    head = iter;
+  r->timeout = (u16_t)(client->req_time + MQTT_REQ_TIMEOUT);
+  r->next = NULL;
+  r->prev = client->pend_req_tail;
+  if (client->pend_req_tail == NULL) {
+    client->pend_req_queue = r;
+  } else {
+    client->pend_req_tail->next = r;
   }
+  client->pend_req_tail = r;
+  if (r->flags & MQTT_REQ_FLAG_QOS_PUB) {
+    client->qos_pub_inflight++;
+  }
+}
 
-  LWIP_ASSERT("mqtt_append_request: time_before <= MQTT_REQ_TIMEOUT", time_before <= MQTT_REQ_TIMEOUT);
-  r->timeout_diff = MQTT_REQ_TIMEOUT - time_before;
-  if (head == NULL) {
-    *tail = r;
+/**
+ * Remove request from pending request queue
+ * @param client MQTT client
+ * @param r Request to remove
+ */
+static void
+mqtt_unlink_request(mqtt_client_t *client, struct mqtt_request_t *r)
+{
+  if (r->prev == NULL) {
+    client->pend_req_queue = r->next;
   } else {
-    head->next = r;
+    r->prev->next = r->next;
+  }
+  if (r->next == NULL) {
+    client->pend_req_tail = r->prev;
+  } else {
+    r->next->prev = r->prev;
+  }
+  r->next = NULL;
+  r->prev = NULL;
+  if (r->flags & MQTT_REQ_FLAG_QOS_PUB) {
+    client->qos_pub_inflight--;
   }
 }
 
@@ -342,105 +487,151 @@ static void
 mqtt_delete_request(struct mqtt_request_t *r)
 {
   if (r != NULL) {
+    if (r->p != NULL) {
+      pbuf_free(r->p);
+      r->p = NULL;
+    }
     r->next = r;
   }
 }
 
+/**
+ * Find a pending request with a specific packet identifier
+ * @param client MQTT client
+ * @param pkt_id Packet identifier of request, 0 returns the oldest QoS 0 publish
+ * @return Request item if found, NULL if not
+ */
+static struct mqtt_request_t *
+mqtt_find_request(mqtt_client_t *client, u16_t pkt_id)
+{
+  struct mqtt_request_t *r;
+  if (pkt_id == 0) {
+    for (r = client->pend_req_queue; r != NULL; r = r->next) {
+      if (r->pkt_id == 0) {
+        return r;
+      }
+    }
+    return NULL;
+  }
+  if (client->req_list == NULL) {
+    return NULL;
+  }
+  r = &client->req_list[pkt_id % client->req_list_len];
+  if ((r->next == r) || (r->pkt_id != pkt_id)) {
+    return NULL;
+  }
+  return r;
+}
+
 /**
  * Remove a request item with a specific packet identifier from request queue
- * @param tail Pointer to request queue tail pointer
+ * @param client MQTT client
  * @param pkt_id Packet identifier of request to take
  * @return Request item if found, NULL if not
  */
 static struct mqtt_request_t *
-mqtt_take_request(struct mqtt_request_t **tail, u16_t pkt_id)
+mqtt_take_request(mqtt_client_t *client, u16_t pkt_id)
 {
-  struct mqtt_request_t *iter = NULL, *prev = NULL;
-  LWIP_ASSERT("mqtt_take_request: tail != NULL", tail != NULL);
-  /* Search all request for pkt_id */
-  for (iter = *tail; iter != NULL; iter = iter->next) {
-    if (iter->pkt_id == pkt_id) {
-      break;
-    }
-    prev = iter;
+  struct mqtt_request_t *r = mqtt_find_request(client, pkt_id);
+  if (r != NULL) {
+    mqtt_unlink_request(client, r);
   }
+  return r;
+}
 
-  /* If request was found */
-  if (iter != NULL) {
-    /* unchain */
-    if (prev == NULL) {
-      *tail = iter->next;
-    } else {
-      prev->next = iter->next;
-    }
-    /* If exists, add remaining timeout time for the request to next */
-    if (iter->next != NULL) {
-      iter->next->timeout_diff += iter->timeout_diff;
-    }
-    iter->next = NULL;
+/**
+ * Delete a request and notify upper layer.
+ * The request is deleted before calling back, so the callback may use the client.
+ * @param r Request item (not in queue)
+ * @param err Result passed to callback
+ */
+static void
+mqtt_complete_request(struct mqtt_request_t *r, err_t err)
+{
+  mqtt_request_cb_t cb = r->cb;
+  void *arg = r->arg;
+  mqtt_delete_request(r);
+  if (cb != NULL) {
+    cb(arg, err);
   }
-  return iter;
 }
 
 /**
  * Handle requests timeout
- * @param tail Pointer to request queue tail pointer
+ * @param client MQTT client
  * @param t Time since last call in seconds
  */
 static void
-mqtt_request_time_elapsed(struct mqtt_request_t **tail, u8_t t)
+mqtt_request_time_elapsed(mqtt_client_t *client, u8_t t)
 {
   struct mqtt_request_t *r;
-  LWIP_ASSERT("mqtt_request_time_elapsed: tail != NULL", tail != NULL);
-  r = *tail;
-  while (t > 0 && r != NULL) {
-    if (t >= r->timeout_diff) {
-      t -= (u8_t)r->timeout_diff;
-      /* Unchain */
-      *tail = r->next;
-      /* Notify upper layer about timeout */
-      if (r->cb != NULL) {
-        r->cb(r->arg, ERR_TIMEOUT);
-      }
-      mqtt_delete_request(r);
-      /* Tail might be be modified in callback, so re-read it in every iteration */
-      r = *(struct mqtt_request_t *const volatile *)tail;
-    } else {
-      r->timeout_diff -= t;
-      t = 0;
-    }
+  client->req_time = (u16_t)(client->req_time + t);
+  /* Requests are queued in creation order, so only the head has to be checked.
+     Queue might be modified in callback, so re-read it in every iteration */
+  while (((r = client->pend_req_queue) != NULL) && ((s16_t)(client->req_time - r->timeout) >= 0)) {
+    mqtt_unlink_request(client, r);
+    /* Notify upper layer about timeout */
+    mqtt_complete_request(r, ERR_TIMEOUT);
   }
 }
 
 /**
- * Free all request items
- * @param tail Pointer to request queue tail pointer
+ * Free request items
+ * @param client MQTT client
+ * @param keep_resumable 1 to keep requests that can be resumed in a later session
  */
 static void
-mqtt_clear_requests(struct mqtt_request_t **tail)
+mqtt_clear_requests(mqtt_client_t *client, u8_t keep_resumable)
 {
   struct mqtt_request_t *iter, *next;
-  LWIP_ASSERT("mqtt_clear_requests: tail != NULL", tail != NULL);
-  for (iter = *tail; iter != NULL; iter = next) {
+  for (iter = client->pend_req_queue; iter != NULL; iter = next) {
     next = iter->next;
-    mqtt_delete_request(iter);
+    if (keep_resumable && ((iter->p != NULL) || (iter->flags & MQTT_REQ_FLAG_PUBREL))) {
+      iter->flags |= MQTT_REQ_FLAG_RESUME;
+    } else {
+      mqtt_unlink_request(client, iter);
+      mqtt_delete_request(iter);
+    }
+  }
+}
+
+/**
+ * Allocate and initialize all request items
+ * @param client MQTT client
+ * @return ERR_OK or ERR_MEM
+ */
+static err_t
+mqtt_init_requests(mqtt_client_t *client)
+{
+  u16_t n;
+  if (client->req_list_len == 0) {
+    client->req_list_len = MQTT_REQ_MAX_IN_FLIGHT;
   }
-  *tail = NULL;
+  client->req_list = (struct mqtt_request_t *)mem_malloc((mem_size_t)(client->req_list_len * sizeof(struct mqtt_request_t)));
+  if (client->req_list == NULL) {
+    return ERR_MEM;
+  }
+  for (n = 0; n < client->req_list_len; n++) {
+    /* Item pointing to itself indicates unused */
+    client->req_list[n].next = &client->req_list[n];
+    client->req_list[n].p = NULL;
+  }
+  return ERR_OK;
 }
+
 /**
- * Initialize all request items
- * @param r_objs Pointer to request objects
- * @param r_objs_len Number of array entries
+ * Free all request items and the request list
+ * @param client MQTT client
  */
 static void
-mqtt_init_requests(struct mqtt_request_t *r_objs, size_t r_objs_len)
+mqtt_free_requests(mqtt_client_t *client)
 {
-  u8_t n;
-  LWIP_ASSERT("mqtt_init_requests: r_objs != NULL", r_objs != NULL);
-  for (n = 0; n < r_objs_len; n++) {
-    /* Item pointing to itself indicates unused */
-    r_objs[n].next = &r_objs[n];
+  mqtt_clear_requests(client, 0);
+  if (client->req_list != NULL) {
+    mem_free(client->req_list);
+    client->req_list = NULL;
   }
+  client->session_resume = 0;
 }
 
 /*--------------------------------------------------------------------------------------------------------------------- */
@@ -492,7 +683,7 @@ mqtt_output_append_string(struct mqtt_ringbuf_t *rb, const char *str, u16_t leng
 
 static void
 mqtt_output_append_fixed_header(struct mqtt_ringbuf_t *rb, u8_t msg_type, u8_t fdup,
-                                u8_t fqos, u8_t fretain, u16_t r_length)
+                                u8_t fqos, u8_t fretain, u32_t r_length)
 {
   /* Start with control byte */
   mqtt_output_append_u8(rb, (((msg_type & 0x0f) << 4) | ((fdup & 1) << 3) | ((fqos & 3) << 1) | (fretain & 1)));
@@ -504,6 +695,26 @@ mqtt_output_append_fixed_header(struct mqtt_ringbuf_t *rb, u8_t msg_type, u8_t f
 }
 
 
+/**
+ * Calculate length of fixed header
+ * @param r_length Remaining length after fixed header
+ * @return Number of bytes of type byte and remaining length field
+ */
+static u32_t
+mqtt_output_fixed_header_len(u32_t r_length)
+{
+  /* Start with length of type byte */
+  u32_t len = 1;
+
+  /* Add number of required bytes to contain the remaining bytes field */
+  do {
+    len++;
+    r_length >>= 7;
+  } while (r_length > 0);
+
+  return len;
+}
+
 /**
  * Check output buffer space
  * @param rb Output ring buffer
@@ -511,22 +722,464 @@ mqtt_output_append_fixed_header(struct mqtt_ringbuf_t *rb, u8_t msg_type, u8_t f
  * @return 1 if message will fit, 0 if not enough buffer space
  */
 static u8_t
-mqtt_output_check_space(struct mqtt_ringbuf_t *rb, u16_t r_length)
+mqtt_output_check_space(struct mqtt_ringbuf_t *rb, u32_t r_length)
 {
-  /* Start with length of type byte + remaining length */
-  u16_t total_len = 1 + r_length;
-
   LWIP_ASSERT("mqtt_output_check_space: rb != NULL", rb != NULL);
 
-  /* Calculate number of required bytes to contain the remaining bytes field and add to total*/
-  do {
-    total_len++;
-    r_length >>= 7;
-  } while (r_length > 0);
+  return (mqtt_output_fixed_header_len(r_length) + r_length <= (u32_t)mqtt_ringbuf_free(rb));
+}
+
+#if LWIP_MQTT_V5
+/*--------------------------------------------------------------------------------------------------------------------- */
+/* MQTT 5 properties and topic aliases */
+
+/** MQTT 5 property identifiers used by the client */
+#define MQTT_PROP_SERVER_KEEP_ALIVE   0x13
+#define MQTT_PROP_RECEIVE_MAXIMUM     0x21
+#define MQTT_PROP_TOPIC_ALIAS_MAXIMUM 0x22
+#define MQTT_PROP_TOPIC_ALIAS         0x23
+
+/** First reason code indicating failure */
+#define MQTT_REASON_FAILURE           0x80
+
+/** Properties of interest to the client, 0 if not present */
+struct mqtt_props {
+  u16_t receive_max;
+  u16_t topic_alias_max;
+  u16_t topic_alias;
+  u16_t server_keep_alive;
+  u8_t has_server_keep_alive;
+};
+
+/**
+ * Decode a variable byte integer
+ * @param buf Encoded data
+ * @param len Number of bytes available in buf
+ * @param value Returns the decoded value
+ * @return Number of bytes used, 0 if invalid or incomplete
+ */
+static u8_t
+mqtt_decode_varint(const u8_t *buf, u32_t len, u32_t *value)
+{
+  u8_t n;
+  *value = 0;
+  for (n = 0; (n < 4) && (n < len); n++) {
+    *value |= (u32_t)(buf[n] & 0x7f) << (7 * n);
+    if ((buf[n] & 0x80) == 0) {
+      return (u8_t)(n + 1);
+    }
+  }
+  return 0;
+}
+
+/**
+ * Parse a property block (length and properties), unknown properties are skipped
+ * @param buf Start of property length
+ * @param len Number of bytes available in buf
+ * @param props Returns the properties used by the client
+ * @return Number of bytes of the property block, -1 if invalid or not contained in buf
+ */
+static s32_t
+mqtt_parse_properties(const u8_t *buf, u32_t len, struct mqtt_props *props)
+{
+  u32_t props_len, idx, end, vlen, value32;
+  u8_t n = mqtt_decode_varint(buf, len, &props_len);
 
-  return (total_len <= mqtt_ringbuf_free(rb));
+  memset(props, 0, sizeof(struct mqtt_props));
+  if ((n == 0) || (props_len > len - n)) {
+    return -1;
+  }
+  end = n + props_len;
+  for (idx = n; idx < end; idx += vlen) {
+    u8_t id = buf[idx++];
+    switch (id) {
+      case 0x01: case 0x17: case 0x19: case 0x24: case 0x25: case 0x28: case 0x29: case 0x2A:
+        vlen = 1;
+        break;
+      case MQTT_PROP_SERVER_KEEP_ALIVE: case MQTT_PROP_RECEIVE_MAXIMUM:
+      case MQTT_PROP_TOPIC_ALIAS_MAXIMUM: case MQTT_PROP_TOPIC_ALIAS:
+        vlen = 2;
+        break;
+      case 0x02: case 0x11: case 0x18: case 0x27:
+        vlen = 4;
+        break;
+      case 0x0B:
+        /* Subscription identifier */
+        vlen = mqtt_decode_varint(buf + idx, end - idx, &value32);
+        if (vlen == 0) {
+          return -1;
+        }
+        break;
+      case 0x03: case 0x08: case 0x09: case 0x12: case 0x15: case 0x16: case 0x1A: case 0x1C: case 0x1F:
+        /* UTF-8 string or binary data */
+        if (end - idx < 2) {
+          return -1;
+        }
+        vlen = 2 + (((u32_t)buf[idx] << 8) | buf[idx + 1]);
+        break;
+      case 0x26:
+        /* User property: string pair */
+        if (end - idx < 2) {
+          return -1;
+        }
+        vlen = 2 + (((u32_t)buf[idx] << 8) | buf[idx + 1]);
+        if ((vlen > end - idx) || (end - idx - vlen < 2)) {
+          return -1;
+        }
+        vlen += 2 + (((u32_t)buf[idx + vlen] << 8) | buf[idx + vlen + 1]);
+        break;
+      default:
+        LWIP_DEBUGF(MQTT_DEBUG_WARN, ("mqtt_parse_properties: Unknown property 0x%02x\n", id));
+        return -1;
+    }
+    if (vlen > end - idx) {
+      return -1;
+    }
+    if (vlen == 2) {
+      u16_t value = (u16_t)(((u16_t)buf[idx] << 8) | buf[idx + 1]);
+      if (id == MQTT_PROP_RECEIVE_MAXIMUM) {
+        props->receive_max = value;
+      } else if (id == MQTT_PROP_TOPIC_ALIAS_MAXIMUM) {
+        props->topic_alias_max = value;
+      } else if (id == MQTT_PROP_TOPIC_ALIAS) {
+        props->topic_alias = value;
+      } else if (id == MQTT_PROP_SERVER_KEEP_ALIVE) {
+        props->server_keep_alive = value;
+        props->has_server_keep_alive = 1;
+      }
+    }
+  }
+  return (s32_t)end;
 }
 
+/**
+ * Free all topic aliases, they are only valid for one connection
+ * @param client MQTT client
+ */
+static void
+mqtt_topic_alias_clear(mqtt_client_t *client)
+{
+  u16_t n;
+#if MQTT_TOPIC_ALIAS_OUT_MAX > 0
+  for (n = 0; n < MQTT_TOPIC_ALIAS_OUT_MAX; n++) {
+    if (client->topic_alias_out[n] != NULL) {
+      mem_free(client->topic_alias_out[n]);
+      client->topic_alias_out[n] = NULL;
+    }
+  }
+  client->topic_alias_out_max = 0;
+  client->topic_alias_out_next = 0;
+#endif /* MQTT_TOPIC_ALIAS_OUT_MAX > 0 */
+#if MQTT_TOPIC_ALIAS_IN_MAX > 0
+  for (n = 0; n < MQTT_TOPIC_ALIAS_IN_MAX; n++) {
+    if (client->topic_alias_in[n] != NULL) {
+      mem_free(client->topic_alias_in[n]);
+      client->topic_alias_in[n] = NULL;
+    }
+  }
+#endif /* MQTT_TOPIC_ALIAS_IN_MAX > 0 */
+  LWIP_UNUSED_ARG(n);
+  LWIP_UNUSED_ARG(client);
+}
+
+/**
+ * Copy a topic to heap memory for an alias table
+ * @param topic Topic
+ * @param topic_len Length of topic
+ * @return Zero terminated copy or NULL if out of memory
+ */
+static char *
+mqtt_topic_alias_dup(const char *topic, u16_t topic_len)
+{
+  char *copy = (char *)mem_malloc((mem_size_t)(topic_len + 1));
+  if (copy != NULL) {
+    MEMCPY(copy, topic, topic_len);
+    copy[topic_len] = 0;
+  }
+  return copy;
+}
+
+/**
+ * Select the outbound topic alias of a publish message. A topic without alias
+ * gets a new one (replacing the oldest if all are in use), which is installed
+ * by @ref mqtt_topic_alias_commit once the message has been queued.
+ * @param client MQTT client
+ * @param topic Publish topic
+ * @param topic_len Length of topic
+ * @param alias Returns the alias to send, 0 for none
+ * @return 1 if the topic has to be sent, 0 if the alias replaces it
+ */
+static u8_t
+mqtt_topic_alias_select(mqtt_client_t *client, const char *topic, u16_t topic_len, u16_t *alias)
+{
+#if MQTT_TOPIC_ALIAS_OUT_MAX > 0
+  u16_t n;
+  *alias = 0;
+  if ((client->topic_alias_out_max == 0) || (topic_len == 0)) {
+    return 1;
+  }
+  for (n = 0; n < client->topic_alias_out_max; n++) {
+    const char *t = client->topic_alias_out[n];
+    if ((t != NULL) && (strncmp(t, topic, topic_len) == 0) && (t[topic_len] == 0)) {
+      *alias = (u16_t)(n + 1);
+      return 0;
+    }
+  }
+  /* New alias, sent along with the topic this time */
+  *alias = (u16_t)(client->topic_alias_out_next + 1);
+#else /* MQTT_TOPIC_ALIAS_OUT_MAX > 0 */
+  LWIP_UNUSED_ARG(client);
+  LWIP_UNUSED_ARG(topic);
+  LWIP_UNUSED_ARG(topic_len);
+  *alias = 0;
+#endif /* MQTT_TOPIC_ALIAS_OUT_MAX > 0 */
+  return 1;
+}
+
+/**
+ * Install a new outbound topic alias selected by @ref mqtt_topic_alias_select
+ * after the message has been queued. If the topic can not be stored, the alias
+ * is left unused (the server knows it, but it is not sent again).
+ * @param client MQTT client
+ * @param alias Alias sent, 0 for none
+ * @param topic Publish topic
+ * @param topic_len Length of topic
+ * @param send_topic 1 if the topic has been sent (i.e. the alias is new)
+ */
+static void
+mqtt_topic_alias_commit(mqtt_client_t *client, u16_t alias, const char *topic, u16_t topic_len, u8_t send_topic)
+{
+#if MQTT_TOPIC_ALIAS_OUT_MAX > 0
+  if ((alias != 0) && send_topic) {
+    char **slot = &client->topic_alias_out[alias - 1];
+    if (*slot != NULL) {
+      mem_free(*slot);
+    }
+    *slot = mqtt_topic_alias_dup(topic, topic_len);
+    client->topic_alias_out_next = (u16_t)(alias % client->topic_alias_out_max);
+  }
+#else /* MQTT_TOPIC_ALIAS_OUT_MAX > 0 */
+  LWIP_UNUSED_ARG(client);
+  LWIP_UNUSED_ARG(alias);
+  LWIP_UNUSED_ARG(topic);
+  LWIP_UNUSED_ARG(topic_len);
+  LWIP_UNUSED_ARG(send_topic);
+#endif /* MQTT_TOPIC_ALIAS_OUT_MAX > 0 */
+}
+
+/**
+ * Check the server's receive maximum before sending a publish
+ * @param client MQTT client
+ * @param qos Quality of service of the publish
+ * @return 1 if no more QoS 1 and 2 publishes may be sent, 0 otherwise
+ */
+static u8_t
+mqtt_receive_max_reached(mqtt_client_t *client, u8_t qos)
+{
+  if ((qos > 0) && (client->server_receive_max != 0) && (client->qos_pub_inflight >= client->server_receive_max)) {
+    LWIP_DEBUGF(MQTT_DEBUG_TRACE, ("mqtt_receive_max_reached: %d publishes unacknowledged\n", client->qos_pub_inflight));
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * Resolve the inbound topic alias of a publish message: an empty topic is
+ * replaced by the topic of the alias, otherwise the topic is stored for the alias.
+ * @param client MQTT client
+ * @param alias Topic alias received, 0 for none
+ * @param topic Topic received (zero terminated), returns the topic to use
+ * @param topic_len Length of topic received
+ * @return ERR_OK, ERR_VAL on protocol error (unknown alias), ERR_MEM if the topic could not be stored
+ */
+static err_t
+mqtt_topic_alias_in(mqtt_client_t *client, u16_t alias, const char **topic, u16_t topic_len)
+{
+  if (alias == 0) {
+    return (topic_len > 0) ? ERR_OK : ERR_VAL;
+  }
+#if MQTT_TOPIC_ALIAS_IN_MAX > 0
+  if (alias <= MQTT_TOPIC_ALIAS_IN_MAX) {
+    char **slot = &client->topic_alias_in[alias - 1];
+    if (topic_len == 0) {
+      if (*slot == NULL) {
+        return ERR_VAL;
+      }
+      *topic = *slot;
+    } else {
+      char *copy = mqtt_topic_alias_dup(*topic, topic_len);
+      if (copy == NULL) {
+        return ERR_MEM;
+      }
+      if (*slot != NULL) {
+        mem_free(*slot);
+      }
+      *slot = copy;
+    }
+    return ERR_OK;
+  }
+#else /* MQTT_TOPIC_ALIAS_IN_MAX > 0 */
+  LWIP_UNUSED_ARG(client);
+  LWIP_UNUSED_ARG(topic);
+#endif /* MQTT_TOPIC_ALIAS_IN_MAX > 0 */
+  return ERR_VAL;
+}
+
+/**
+ * Append PUBLISH properties
+ * @param rb Output ring buffer
+ * @param alias Topic alias, 0 for none
+ */
+static void
+mqtt_output_append_publish_props(struct mqtt_ringbuf_t *rb, u16_t alias)
+{
+  if (alias != 0) {
+    mqtt_output_append_u8(rb, 3);
+    mqtt_output_append_u8(rb, MQTT_PROP_TOPIC_ALIAS);
+    mqtt_output_append_u16(rb, alias);
+  } else {
+    mqtt_output_append_u8(rb, 0);
+  }
+}
+
+/** Length of PUBLISH properties appended by mqtt_output_append_publish_props */
+#define MQTT_PUBLISH_PROPS_LEN(alias) ((alias) ? 4U : 1U)
+#endif /* LWIP_MQTT_V5 */
+
+
+/**
+ * Abort a closed connection that still references payload pbufs and free them
+ * @param client MQTT client
+ */
+static void
+mqtt_closing_abort(mqtt_client_t *client)
+{
+  if (client->closing_conn != NULL) {
+    struct altcp_pcb *conn = client->closing_conn;
+    client->closing_conn = NULL;
+    altcp_arg(conn, NULL);
+    altcp_recv(conn, NULL);
+    altcp_sent(conn, NULL);
+    altcp_err(conn, NULL);
+    altcp_poll(conn, NULL, 0);
+    altcp_abort(conn);
+    mqtt_output_clear(client);
+  }
+}
+
+/**
+ * Close a connection after all payload pbufs it references have been acknowledged
+ * @param client MQTT client
+ * @return ERR_OK, or ERR_ABRT if the connection had to be aborted
+ */
+static err_t
+mqtt_closing_try_close(mqtt_client_t *client)
+{
+  struct altcp_pcb *conn = client->closing_conn;
+  if (mqtt_output_referenced(client)) {
+    return ERR_OK;
+  }
+  altcp_arg(conn, NULL);
+  altcp_recv(conn, NULL);
+  altcp_sent(conn, NULL);
+  altcp_err(conn, NULL);
+  altcp_poll(conn, NULL, 0);
+  client->closing_conn = NULL;
+  mqtt_output_clear(client);
+  if (altcp_close(conn) != ERR_OK) {
+    altcp_abort(conn);
+    return ERR_ABRT;
+  }
+  return ERR_OK;
+}
+
+/** Receive callback of a closing connection: data is discarded */
+static err_t
+mqtt_closing_recv_cb(void *arg, struct altcp_pcb *pcb, struct pbuf *p, err_t err)
+{
+  LWIP_UNUSED_ARG(arg);
+  LWIP_UNUSED_ARG(err);
+  if (p != NULL) {
+    altcp_recved(pcb, p->tot_len);
+    pbuf_free(p);
+  }
+  return ERR_OK;
+}
+
+/** Sent callback of a closing connection: release acknowledged payloads */
+static err_t
+mqtt_closing_sent_cb(void *arg, struct altcp_pcb *tpcb, u16_t len)
+{
+  mqtt_client_t *client = (mqtt_client_t *)arg;
+  LWIP_UNUSED_ARG(tpcb);
+  mqtt_output_acked(client, len);
+  return mqtt_closing_try_close(client);
+}
+
+/** Error callback of a closing connection: pcb is gone, free the payloads */
+static void
+mqtt_closing_err_cb(void *arg, err_t err)
+{
+  mqtt_client_t *client = (mqtt_client_t *)arg;
+  LWIP_UNUSED_ARG(err);
+  client->closing_conn = NULL;
+  mqtt_output_clear(client);
+}
+
+/** Poll callback of a closing connection: give up after MQTT_REQ_TIMEOUT */
+static err_t
+mqtt_closing_poll_cb(void *arg, struct altcp_pcb *tpcb)
+{
+  mqtt_client_t *client = (mqtt_client_t *)arg;
+  LWIP_UNUSED_ARG(tpcb);
+  client->cyclic_tick++;
+  if (client->cyclic_tick >= MQTT_REQ_TIMEOUT) {
+    LWIP_DEBUGF(MQTT_DEBUG_TRACE, ("mqtt_closing_poll_cb: payload not acknowledged, abort\n"));
+    mqtt_closing_abort(client);
+    return ERR_ABRT;
+  }
+  return ERR_OK;
+}
+
+/**
+ * Shut down sending on a connection that references payload pbufs not acknowledged
+ * yet: the FIN is sent after the data and the pbufs are kept until the server has
+ * acknowledged them, then the connection is closed.
+ * @param client MQTT client
+ * @return ERR_OK if the connection is closing, another err_t if it must be aborted
+ */
+static err_t
+mqtt_closing_start(mqtt_client_t *client)
+{
+  u8_t i;
+  err_t err = altcp_shutdown(client->conn, 0, 1);
+  if (err != ERR_OK) {
+    return err;
+  }
+  /* A partially written payload ends with the data written so far */
+  if (client->out_pbuf_unacked < client->out_pbuf_len) {
+    struct mqtt_out_pbuf_t *op = mqtt_out_pbuf_at(client, client->out_pbuf_unacked);
+    if (op->offset > 0) {
+      op->end = client->tx_written;
+      client->out_pbuf_unacked++;
+    }
+  }
+  /* Payloads not written at all are not needed anymore */
+  for (i = client->out_pbuf_unacked; i < client->out_pbuf_len; i++) {
+    struct mqtt_out_pbuf_t *op = mqtt_out_pbuf_at(client, i);
+    pbuf_free(op->p);
+    op->p = NULL;
+  }
+  client->out_pbuf_len = client->out_pbuf_unacked;
+
+  client->closing_conn = client->conn;
+  client->cyclic_tick = 0;
+  altcp_recv(client->conn, mqtt_closing_recv_cb);
+  altcp_sent(client->conn, mqtt_closing_sent_cb);
+  altcp_err(client->conn, mqtt_closing_err_cb);
+  altcp_poll(client->conn, mqtt_closing_poll_cb, 2);
+  return ERR_OK;
+}
 
 /**
  * Close connection to server
@@ -544,16 +1197,40 @@ mqtt_close(mqtt_client_t *client, mqtt_connection_status_t reason)
     altcp_recv(client->conn, NULL);
     altcp_err(client->conn,  NULL);
     altcp_sent(client->conn, NULL);
-    res = altcp_close(client->conn);
+    if (mqtt_output_referenced(client)) {
+      /* Unacknowledged payload data is written by reference: close when acked */
+      res = mqtt_closing_start(client);
+    } else {
+      res = altcp_close(client->conn);
+    }
     if (res != ERR_OK) {
       altcp_abort(client->conn);
+      client->conn_aborted = 1;
       LWIP_DEBUGF(MQTT_DEBUG_TRACE, ("mqtt_close: Close err=%s\n", lwip_strerr(res)));
     }
     client->conn = NULL;
   }
 
-  /* Remove all pending requests */
-  mqtt_clear_requests(&client->pend_req_queue);
+  /* Free queued payload pbufs unless a closing connection still references them */
+  if (client->closing_conn == NULL) {
+    mqtt_output_clear(client);
+  }
+#if LWIP_MQTT_V5
+  /* Topic aliases are only valid for one connection */
+  mqtt_topic_alias_clear(client);
+  if (client->inpub_hdr != NULL) {
+    mem_free(client->inpub_hdr);
+    client->inpub_hdr = NULL;
+  }
+#endif /* LWIP_MQTT_V5 */
+
+  /* Remove all pending requests, or keep those that can be resumed in a later session */
+  if (client->keep_session) {
+    mqtt_clear_requests(client, 1);
+    client->session_resume = 0;
+  } else {
+    mqtt_free_requests(client);
+  }
   /* Stop cyclic timer */
   sys_untimeout(mqtt_cyclic_timer, client);
 
@@ -589,7 +1266,7 @@ mqtt_cyclic_timer(void *arg)
     }
   } else if (client->conn_state == MQTT_CONNECTED) {
     /* Handle timeout for pending requests */
-    mqtt_request_time_elapsed(&client->pend_req_queue, MQTT_CYCLIC_TIMER_INTERVAL);
+    mqtt_request_time_elapsed(client, MQTT_CYCLIC_TIMER_INTERVAL);
 
     /* keep_alive > 0 means keep alive functionality shall be used */
     if (client->keep_alive > 0) {
@@ -638,7 +1315,7 @@ pub_ack_rec_rel_response(mqtt_client_t *client, u8_t msg, u16_t pkt_id, u8_t qos
   if (mqtt_output_check_space(&client->output, 2)) {
     mqtt_output_append_fixed_header(&client->output, msg, 0, qos, 0, 2);
     mqtt_output_append_u16(&client->output, pkt_id);
-    mqtt_output_send(&client->output, client->conn);
+    mqtt_output_send(client);
   } else {
     LWIP_DEBUGF(MQTT_DEBUG_TRACE, ("pub_ack_rec_rel_response: OOM creating response: %s with pkt_id: %d\n",
                                    mqtt_msg_type_to_str(msg), pkt_id));
@@ -655,8 +1332,66 @@ pub_ack_rec_rel_response(mqtt_client_t *client, u8_t msg, u16_t pkt_id, u8_t qos
 static void
 mqtt_incomming_suback(struct mqtt_request_t *r, u8_t result)
 {
-  if (r->cb != NULL) {
-    r->cb(r->arg, result < 3 ? ERR_OK : ERR_ABRT);
+  mqtt_complete_request(r, result < 3 ? ERR_OK : ERR_ABRT);
+}
+
+
+/**
+ * Resend requests kept from a previous connection (as far as output space allows),
+ * called until all have been resent
+ * @param client MQTT client
+ */
+static void
+mqtt_session_resume(mqtt_client_t *client)
+{
+  struct mqtt_request_t *r, *next;
+  for (r = client->pend_req_queue; r != NULL; r = next) {
+    next = r->next;
+    if (r->flags & MQTT_REQ_FLAG_RESUME) {
+      if (r->flags & MQTT_REQ_FLAG_PUBREL) {
+        if (mqtt_output_check_space(&client->output, 2) == 0) {
+          return;
+        }
+        mqtt_output_append_fixed_header(&client->output, MQTT_MSG_TYPE_PUBREL, 0, 1, 0, 2);
+        mqtt_output_append_u16(&client->output, r->pkt_id);
+      } else {
+        if (client->out_pbuf_len >= MQTT_OUTPUT_PBUF_QUEUE_LEN) {
+          return;
+        }
+        /* Set DUP flag in fixed header */
+        ((u8_t *)r->p->payload)[0] |= 0x08;
+        mqtt_output_append_pbuf(client, r->p);
+      }
+      LWIP_DEBUGF(MQTT_DEBUG_TRACE, ("mqtt_session_resume: Resending %s with pkt_id: %d\n",
+                                     (r->flags & MQTT_REQ_FLAG_PUBREL) ? "PUBREL" : "PUBLISH", r->pkt_id));
+      r->flags &= (u8_t)~MQTT_REQ_FLAG_RESUME;
+      /* Restart timeout, moving to the end keeps the queue ordered by timeout */
+      mqtt_unlink_request(client, r);
+      mqtt_append_request(client, r);
+    }
+  }
+  client->session_resume = 0;
+}
+
+/**
+ * Complete requests kept from a previous connection with ERR_ABRT,
+ * called when the server did not resume the session
+ * @param client MQTT client
+ */
+static void
+mqtt_session_discard(mqtt_client_t *client)
+{
+  struct mqtt_request_t *r = client->pend_req_queue;
+  client->session_resume = 0;
+  while (r != NULL) {
+    if (r->flags & MQTT_REQ_FLAG_RESUME) {
+      mqtt_unlink_request(client, r);
+      mqtt_complete_request(r, ERR_ABRT);
+      /* Queue might be modified in callback, restart from head */
+      r = client->pend_req_queue;
+    } else {
+      r = r->next;
+    }
   }
 }
 
@@ -694,10 +1429,36 @@ mqtt_message_received(mqtt_client_t *client, u8_t fixed_hdr_idx, u16_t length, u
       /* Get result code from CONNACK */
       res = (mqtt_connection_status_t)var_hdr_payload[1];
       LWIP_DEBUGF(MQTT_DEBUG_TRACE, ("mqtt_message_received: Connect response code %d\n", res));
+#if LWIP_MQTT_V5
+      if ((res == MQTT_CONNECT_ACCEPTED) && (length > 2)) {
+        /* Properties that do not fit into the receive buffer are ignored */
+        struct mqtt_props props;
+        if (mqtt_parse_properties(var_hdr_payload + 2, (u32_t)length - 2, &props) >= 0) {
+          client->server_receive_max = props.receive_max;
+#if MQTT_TOPIC_ALIAS_OUT_MAX > 0
+          client->topic_alias_out_max = LWIP_MIN(props.topic_alias_max, MQTT_TOPIC_ALIAS_OUT_MAX);
+#endif /* MQTT_TOPIC_ALIAS_OUT_MAX > 0 */
+          if (props.has_server_keep_alive) {
+            client->keep_alive = props.server_keep_alive;
+          }
+          LWIP_DEBUGF(MQTT_DEBUG_TRACE, ("mqtt_message_received: Server receive maximum %d, topic alias maximum %d\n",
+                                         props.receive_max, props.topic_alias_max));
+        }
+      }
+#endif /* LWIP_MQTT_V5 */
       if (res == MQTT_CONNECT_ACCEPTED) {
         /* Reset cyclic_tick when changing to connected state */
         client->cyclic_tick = 0;
         client->conn_state = MQTT_CONNECTED;
+        if (client->session_resume) {
+          /* Resend pending requests if server has kept the session (session present flag) */
+          if (var_hdr_payload[0] & 1) {
+            mqtt_session_resume(client);
+            mqtt_output_send(client);
+          } else {
+            mqtt_session_discard(client);
+          }
+        }
         /* Notify upper layer */
         if (client->connect_cb != 0) {
           client->connect_cb(client, client->connect_arg, res);
@@ -717,6 +1478,7 @@ mqtt_message_received(mqtt_client_t *client, u8_t fixed_hdr_idx, u16_t length, u
     if (client->msg_idx <= MQTT_VAR_HEADER_BUFFER_LEN) {
       /* Should have topic and pkt id*/
       u8_t *topic;
+      const char *topic_str;
       u16_t after_topic;
       u8_t bkp;
       u16_t topic_len;
@@ -752,6 +1514,23 @@ mqtt_message_received(mqtt_client_t *client, u8_t fixed_hdr_idx, u16_t length, u
       } else {
         client->inpub_pkt_id = 0;
       }
+      topic_str = (const char *)topic;
+#if LWIP_MQTT_V5
+      {
+        /* Properties have to fit into the receive buffer */
+        struct mqtt_props props;
+        s32_t props_len = mqtt_parse_properties(var_hdr_payload + after_topic, (u32_t)length - after_topic, &props);
+        if (props_len < 0) {
+          LWIP_DEBUGF(MQTT_DEBUG_WARN,( "mqtt_message_received: Received PUBLISH with invalid properties\n"));
+          goto out_disconnect;
+        }
+        if (mqtt_topic_alias_in(client, props.topic_alias, &topic_str, topic_len) != ERR_OK) {
+          LWIP_DEBUGF(MQTT_DEBUG_WARN,( "mqtt_message_received: Can not resolve topic alias %d\n", props.topic_alias));
+          goto out_disconnect;
+        }
+        after_topic = (u16_t)(after_topic + props_len);
+      }
+#endif /* LWIP_MQTT_V5 */
       /* Take backup of byte after topic */
       bkp = topic[topic_len];
       /* Zero terminate string */
@@ -761,9 +1540,9 @@ mqtt_message_received(mqtt_client_t *client, u8_t fixed_hdr_idx, u16_t length, u
       payload_offset = after_topic;
 
       LWIP_DEBUGF(MQTT_DEBUG_TRACE, ("mqtt_incomming_publish: Received message with QoS %d at topic: %s, payload length %"U32_F"\n",
-                                     qos, topic, remaining_length + payload_length));
+                                     qos, topic_str, remaining_length + payload_length));
       if (client->pub_cb != NULL) {
-        client->pub_cb(client->inpub_arg, (const char *)topic, remaining_length + payload_length);
+        client->pub_cb(client->inpub_arg, topic_str, remaining_length + payload_length);
       }
       /* Restore byte after topic */
       topic[topic_len] = bkp;
@@ -783,7 +1562,18 @@ mqtt_message_received(mqtt_client_t *client, u8_t fixed_hdr_idx, u16_t length, u
         pub_ack_rec_rel_response(client, resp_msg, client->inpub_pkt_id, 0);
       }
     }
+#if LWIP_MQTT_V5
+  } else if (pkt_type == MQTT_MSG_TYPE_DISCONNECT) {
+    LWIP_DEBUGF(MQTT_DEBUG_WARN, ("mqtt_message_received: Disconnected by server, reason code 0x%02x\n",
+                                  (length > 0) ? var_hdr_payload[0] : 0));
+    goto out_disconnect;
+#endif /* LWIP_MQTT_V5 */
   } else {
+#if LWIP_MQTT_V5
+    /* Reason code follows the packet identifier (and properties for SUBACK and UNSUBACK),
+       it may be omitted for success */
+    u8_t reason = 0;
+#endif /* LWIP_MQTT_V5 */
     /* Get packet identifier */
     pkt_id = (u16_t)var_hdr_payload[0] << 8;
     pkt_id |= (u16_t)var_hdr_payload[1];
@@ -791,8 +1581,41 @@ mqtt_message_received(mqtt_client_t *client, u8_t fixed_hdr_idx, u16_t length, u
       LWIP_DEBUGF(MQTT_DEBUG_WARN, ("mqtt_message_received: Got message with illegal packet identifier: 0\n"));
       goto out_disconnect;
     }
+#if LWIP_MQTT_V5
+    if (pkt_type == MQTT_MSG_TYPE_SUBACK || pkt_type == MQTT_MSG_TYPE_UNSUBACK) {
+      struct mqtt_props props;
+      s32_t props_len = mqtt_parse_properties(var_hdr_payload + 2, (length > 2) ? (u32_t)length - 2 : 0, &props);
+      if ((props_len < 0) || (length < 2 + props_len + 1)) {
+        LWIP_DEBUGF(MQTT_DEBUG_WARN, ("mqtt_message_received: Invalid %s packet\n", mqtt_msg_type_to_str(pkt_type)));
+        goto out_disconnect;
+      }
+      reason = var_hdr_payload[2 + props_len];
+    } else if (length > 2) {
+      reason = var_hdr_payload[2];
+    }
+#endif /* LWIP_MQTT_V5 */
     if (pkt_type == MQTT_MSG_TYPE_PUBREC) {
+      struct mqtt_request_t *r = mqtt_find_request(client, pkt_id);
+#if LWIP_MQTT_V5
+      if (reason >= MQTT_REASON_FAILURE) {
+        /* Publish refused, QoS 2 flow ends here */
+        LWIP_DEBUGF(MQTT_DEBUG_WARN, ("mqtt_message_received: PUBREC with reason code 0x%02x, pkt_id: %d\n", reason, pkt_id));
+        if (r != NULL) {
+          mqtt_unlink_request(client, r);
+          mqtt_complete_request(r, ERR_ABRT);
+        }
+        return res;
+      }
+#endif /* LWIP_MQTT_V5 */
       LWIP_DEBUGF(MQTT_DEBUG_TRACE, ("mqtt_message_received: PUBREC, sending PUBREL with pkt_id: %d\n", pkt_id));
+      if (r != NULL) {
+        /* Publish has been received by server, only PUBREL has to be resent from now on */
+        r->flags |= MQTT_REQ_FLAG_PUBREL;
+        if (r->p != NULL) {
+          pbuf_free(r->p);
+          r->p = NULL;
+        }
+      }
       pub_ack_rec_rel_response(client, MQTT_MSG_TYPE_PUBREL, pkt_id, 1);
 
     } else if (pkt_type == MQTT_MSG_TYPE_PUBREL) {
@@ -801,20 +1624,31 @@ mqtt_message_received(mqtt_client_t *client, u8_t fixed_hdr_idx, u16_t length, u
 
     } else if (pkt_type == MQTT_MSG_TYPE_SUBACK || pkt_type == MQTT_MSG_TYPE_UNSUBACK ||
                pkt_type == MQTT_MSG_TYPE_PUBCOMP || pkt_type == MQTT_MSG_TYPE_PUBACK) {
-      struct mqtt_request_t *r = mqtt_take_request(&client->pend_req_queue, pkt_id);
+      struct mqtt_request_t *r = mqtt_take_request(client, pkt_id);
       if (r != NULL) {
         LWIP_DEBUGF(MQTT_DEBUG_TRACE, ("mqtt_message_received: %s response with id %d\n", mqtt_msg_type_to_str(pkt_type), pkt_id));
+#if LWIP_MQTT_V5
+        if (pkt_type == MQTT_MSG_TYPE_SUBACK) {
+          mqtt_incomming_suback(r, reason);
+        } else {
+          if (reason >= MQTT_REASON_FAILURE) {
+            LWIP_DEBUGF(MQTT_DEBUG_WARN, ("mqtt_message_received: %s with reason code 0x%02x\n", mqtt_msg_type_to_str(pkt_type), reason));
+          }
+          mqtt_complete_request(r, (reason >= MQTT_REASON_FAILURE) ? ERR_ABRT : ERR_OK);
+        }
+#else /* LWIP_MQTT_V5 */
         if (pkt_type == MQTT_MSG_TYPE_SUBACK) {
           if (length < 3) {
             LWIP_DEBUGF(MQTT_DEBUG_WARN, ("mqtt_message_received: To small SUBACK packet\n"));
+            mqtt_delete_request(r);
             goto out_disconnect;
           } else {
             mqtt_incomming_suback(r, var_hdr_payload[2]);
           }
-        } else if (r->cb != NULL) {
-          r->cb(r->arg, ERR_OK);
+        } else {
+          mqtt_complete_request(r, ERR_OK);
         }
-        mqtt_delete_request(r);
+#endif /* LWIP_MQTT_V5 */
       } else {
         LWIP_DEBUGF(MQTT_DEBUG_WARN, ( "mqtt_message_received: Received %s reply, with wrong pkt_id: %d\n", mqtt_msg_type_to_str(pkt_type), pkt_id));
       }
@@ -829,10 +1663,301 @@ out_disconnect:
 }
 
 
+/**
+ * Split the pbuf chain '*p' after 'len' bytes, the remainder is returned in 'rest'.
+ * The smaller part of a pbuf divided by the split is copied.
+ * @param p Pbuf chain to split, might be replaced
+ * @param len Number of bytes to keep in '*p', must be less than tot_len
+ * @param rest Returns the remaining data
+ * @return ERR_OK or ERR_MEM (chain unchanged)
+ */
+static err_t
+mqtt_pbuf_split(struct pbuf **p, u16_t len, struct pbuf **rest)
+{
+  struct pbuf *head = *p;
+  struct pbuf *q = head, *prev = NULL, *r;
+  u16_t off = len;
+  u16_t rest_len = (u16_t)(head->tot_len - len);
+
+  LWIP_ASSERT("invalid split", (len > 0) && (len < head->tot_len));
+  while (off >= q->len) {
+    off = (u16_t)(off - q->len);
+    prev = q;
+    q = q->next;
+  }
+  if (off == 0) {
+    /* At a pbuf boundary: just unlink */
+    prev->next = NULL;
+    *rest = q;
+  } else if (off <= q->len - off) {
+    /* Copy the first part of q */
+    struct pbuf *h = pbuf_alloc(PBUF_RAW, off, PBUF_RAM);
+    if (h == NULL) {
+      return ERR_MEM;
+    }
+    MEMCPY(h->payload, q->payload, off);
+    if (prev == NULL) {
+      *p = h;
+    } else {
+      prev->next = NULL;
+      for (r = head; r != NULL; r = r->next) {
+        r->tot_len = (u16_t)(r->tot_len - q->tot_len);
+      }
+      pbuf_cat(head, h);
+    }
+    pbuf_remove_header(q, off);
+    *rest = q;
+    return ERR_OK;
+  } else {
+    /* Copy the last part of q */
+    u16_t tail = (u16_t)(q->len - off);
+    struct pbuf *t = pbuf_alloc(PBUF_RAW, tail, PBUF_RAM);
+    if (t == NULL) {
+      return ERR_MEM;
+    }
+    MEMCPY(t->payload, (u8_t *)q->payload + off, tail);
+    if (q->next != NULL) {
+      pbuf_cat(t, q->next);
+      q->next = NULL;
+    }
+    q->len = off;
+    *rest = t;
+  }
+  for (r = head; r != NULL; r = r->next) {
+    r->tot_len = (u16_t)(r->tot_len - rest_len);
+  }
+  return ERR_OK;
+}
+
+#if LWIP_MQTT_V5
+/**
+ * Pass the topic of a streamed PUBLISH message buffered in client->inpub_hdr
+ * to the topic callback once its properties are complete: the topic alias is
+ * resolved (or stored) first.
+ * @param client MQTT client
+ * @param topic_len Length of topic received
+ * @param props_len Length of property block (property length and properties)
+ * @param payload_len Length of payload
+ * @return MQTT_CONNECT_ACCEPTED or MQTT_CONNECT_DISCONNECTED on error
+ */
+static mqtt_connection_status_t
+mqtt_stream_publish_topic(mqtt_client_t *client, u16_t topic_len, u32_t props_len, u32_t payload_len)
+{
+  u8_t *buf = client->inpub_hdr;
+  const char *topic = (const char *)buf;
+  struct mqtt_props props;
+
+  if (mqtt_parse_properties(buf + topic_len + 1, props_len, &props) < 0) {
+    LWIP_DEBUGF(MQTT_DEBUG_WARN,( "mqtt_stream_publish: Received PUBLISH with invalid properties\n"));
+    return MQTT_CONNECT_DISCONNECTED;
+  }
+  if (mqtt_topic_alias_in(client, props.topic_alias, &topic, topic_len) != ERR_OK) {
+    LWIP_DEBUGF(MQTT_DEBUG_WARN,( "mqtt_stream_publish: Can not resolve topic alias %d\n", props.topic_alias));
+    return MQTT_CONNECT_DISCONNECTED;
+  }
+  /* Detach the buffer, the callback may close the connection */
+  client->inpub_hdr = NULL;
+  if (client->topic_cb != NULL) {
+    client->topic_cb(client->inpub_arg, (const u8_t *)topic, (u16_t)strlen(topic), payload_len, MQTT_DATA_FLAG_LAST);
+  }
+  mem_free(buf);
+  return MQTT_CONNECT_ACCEPTED;
+}
+#endif /* LWIP_MQTT_V5 */
+
+/**
+ * Parse the next part of an incoming PUBLISH message without buffering it:
+ * the topic is passed to the topic callback in parts as it arrives, payload
+ * is taken out of the received pbuf chain and passed to the pbuf callback.
+ * Only topic length and packet identifier (and with MQTT 5 the property length)
+ * are kept in client->rx_buffer, the position in the message is tracked by
+ * client->msg_idx.
+ * With MQTT 5, topic and properties are copied to client->inpub_hdr instead,
+ * the topic is passed in one part once the properties are complete, so that
+ * its topic alias can be resolved.
+ * @param client MQTT client
+ * @param pp Received data, payload passed to the application is removed (NULL if no data left)
+ * @param in_offset Parse offset in '*pp'
+ * @param msg_rem_len Remaining length of message
+ * @param fixed_hdr_idx Length of fixed header
+ * @return MQTT_CONNECT_ACCEPTED or MQTT_CONNECT_DISCONNECTED on error
+ */
+static mqtt_connection_status_t
+mqtt_stream_publish(mqtt_client_t *client, struct pbuf **pp, u16_t *in_offset, u32_t *msg_rem_len, u8_t fixed_hdr_idx)
+{
+  struct pbuf *p = *pp;
+  u8_t *hdr = client->rx_buffer + fixed_hdr_idx;
+  u32_t pos = client->msg_idx - fixed_hdr_idx;
+  u32_t total = pos + *msg_rem_len;
+  u8_t qos = MQTT_CTL_PACKET_QOS(client->rx_buffer[0]);
+  u16_t qos_len = (qos ? 2U : 0U);
+  u16_t topic_len = 0;
+  /* End of topic and packet identifier */
+  u32_t props_start = 2;
+  /* Start of payload, unknown (0xFFFFFFFF) until the property length has been received */
+  u32_t payload_start = 2;
+  u16_t n;
+
+  if (pos >= 2) {
+    topic_len = (u16_t)(((u16_t)hdr[0] << 8) | hdr[1]);
+    props_start = 2 + (u32_t)topic_len + qos_len;
+    payload_start = props_start;
+#if LWIP_MQTT_V5
+    payload_start = 0xFFFFFFFF;
+    if (pos > props_start) {
+      /* Property length is stored after topic length and packet identifier */
+      u32_t props_len;
+      u8_t vlen = mqtt_decode_varint(hdr + 4, LWIP_MIN(pos - props_start, 4), &props_len);
+      if (vlen > 0) {
+        payload_start = props_start + vlen + props_len;
+      }
+    }
+#endif /* LWIP_MQTT_V5 */
+  }
+
+  if (pos >= payload_start) {
+    /* Payload: pass data up to the end of message without copying */
+    struct pbuf *rest = NULL;
+    n = (u16_t)LWIP_MIN((u32_t)(p->tot_len - *in_offset), *msg_rem_len);
+    p = pbuf_free_header(p, *in_offset);
+    *in_offset = 0;
+    if (n < p->tot_len) {
+      if (mqtt_pbuf_split(&p, n, &rest) != ERR_OK) {
+        LWIP_DEBUGF(MQTT_DEBUG_WARN, ("mqtt_stream_publish: OOM splitting payload\n"));
+        *pp = p;
+        return MQTT_CONNECT_DISCONNECTED;
+      }
+    }
+    *pp = rest;
+    client->msg_idx += n;
+    *msg_rem_len -= n;
+    client->pbuf_cb(client->inpub_arg, p, (*msg_rem_len == 0) ? MQTT_DATA_FLAG_LAST : 0);
+#if LWIP_MQTT_V5
+  } else if ((pos >= 2) && (pos >= props_start)) {
+    /* Property block: topic, its zero termination, property length and properties */
+    u8_t *props = client->inpub_hdr + topic_len + 1;
+    if (payload_start == 0xFFFFFFFF) {
+      /* Property length */
+      if (pos - props_start >= 4) {
+        LWIP_DEBUGF(MQTT_DEBUG_WARN,( "mqtt_stream_publish: Invalid property length\n"));
+        return MQTT_CONNECT_DISCONNECTED;
+      }
+      hdr[4 + pos - props_start] = pbuf_get_at(p, *in_offset);
+      n = 1;
+    } else {
+      /* Properties */
+      n = (u16_t)LWIP_MIN((u32_t)(p->tot_len - *in_offset), payload_start - pos);
+      pbuf_copy_partial(p, props + (pos - props_start), n, *in_offset);
+    }
+    client->msg_idx += n;
+    *in_offset = (u16_t)(*in_offset + n);
+    *msg_rem_len -= n;
+    pos += n;
+    if ((payload_start == 0xFFFFFFFF) && ((hdr[3 + pos - props_start] & 0x80) == 0)) {
+      /* Property length complete: make room for the properties */
+      u32_t props_len, alloc_len;
+      u8_t vlen = mqtt_decode_varint(hdr + 4, pos - props_start, &props_len);
+      u8_t *buf;
+      payload_start = props_start + vlen + props_len;
+      if (payload_start > total) {
+        LWIP_DEBUGF(MQTT_DEBUG_WARN,( "mqtt_stream_publish: Received short PUBLISH packet (properties)\n"));
+        return MQTT_CONNECT_DISCONNECTED;
+      }
+      alloc_len = (u32_t)topic_len + 1 + vlen + props_len;
+      buf = ((u32_t)(mem_size_t)alloc_len == alloc_len) ? (u8_t *)mem_malloc((mem_size_t)alloc_len) : NULL;
+      if (buf == NULL) {
+        LWIP_DEBUGF(MQTT_DEBUG_WARN, ("mqtt_stream_publish: OOM buffering properties\n"));
+        return MQTT_CONNECT_DISCONNECTED;
+      }
+      MEMCPY(buf, client->inpub_hdr, topic_len + 1);
+      MEMCPY(buf + topic_len + 1, hdr + 4, vlen);
+      mem_free(client->inpub_hdr);
+      client->inpub_hdr = buf;
+    }
+    if (pos == payload_start) {
+      mqtt_connection_status_t res = mqtt_stream_publish_topic(client, topic_len, payload_start - props_start, total - payload_start);
+      if (res != MQTT_CONNECT_ACCEPTED) {
+        return res;
+      }
+    }
+#endif /* LWIP_MQTT_V5 */
+  } else if ((pos < 2) || (pos >= 2 + (u32_t)topic_len)) {
+    /* Topic length and packet identifier are stored in receive buffer */
+    hdr[(pos < 2) ? pos : (2 + pos - (2 + topic_len))] = pbuf_get_at(p, *in_offset);
+    n = 1;
+    client->msg_idx += n;
+    *in_offset = (u16_t)(*in_offset + n);
+    *msg_rem_len -= n;
+    pos += n;
+    if (pos == 2) {
+      topic_len = (u16_t)(((u16_t)hdr[0] << 8) | hdr[1]);
+      props_start = 2 + (u32_t)topic_len + qos_len;
+      if (props_start > total) {
+        LWIP_DEBUGF(MQTT_DEBUG_WARN,( "mqtt_stream_publish: Received short PUBLISH packet (topic)\n"));
+        return MQTT_CONNECT_DISCONNECTED;
+      }
+      LWIP_DEBUGF(MQTT_DEBUG_TRACE, ("mqtt_stream_publish: Received message with QoS %d, topic length %d, remaining length %"U32_F"\n",
+                                     qos, topic_len, total - props_start));
+#if LWIP_MQTT_V5
+      /* Topic is buffered until its alias is known */
+      client->inpub_hdr = (u8_t *)mem_malloc((mem_size_t)(topic_len + 1));
+      if (client->inpub_hdr == NULL) {
+        LWIP_DEBUGF(MQTT_DEBUG_WARN, ("mqtt_stream_publish: OOM buffering topic\n"));
+        return MQTT_CONNECT_DISCONNECTED;
+      }
+      client->inpub_hdr[topic_len] = 0;
+#else /* LWIP_MQTT_V5 */
+      if ((topic_len == 0) && (client->topic_cb != NULL)) {
+        client->topic_cb(client->inpub_arg, (const u8_t *)"", 0, total - props_start, MQTT_DATA_FLAG_LAST);
+      }
+#endif /* LWIP_MQTT_V5 */
+    }
+    if (pos == props_start) {
+      client->inpub_pkt_id = qos ? (u16_t)(((u16_t)hdr[2] << 8) | hdr[3]) : 0;
+    }
+  } else {
+    /* Topic: pass (with MQTT 5 buffer) the part contained in the current pbuf */
+    u16_t off;
+    struct pbuf *q = pbuf_skip(p, *in_offset, &off);
+    n = (u16_t)LWIP_MIN((u32_t)(q->len - off), 2 + (u32_t)topic_len - pos);
+#if LWIP_MQTT_V5
+    MEMCPY(client->inpub_hdr + (pos - 2), (const u8_t *)q->payload + off, n);
+#endif /* LWIP_MQTT_V5 */
+    client->msg_idx += n;
+    *in_offset = (u16_t)(*in_offset + n);
+    *msg_rem_len -= n;
+    pos += n;
+    if ((pos == props_start) && (qos == 0)) {
+      client->inpub_pkt_id = 0;
+    }
+#if !LWIP_MQTT_V5
+    if (client->topic_cb != NULL) {
+      u8_t flags = (pos == 2 + (u32_t)topic_len) ? MQTT_DATA_FLAG_LAST : 0;
+      client->topic_cb(client->inpub_arg, (const u8_t *)q->payload + off, n, total - props_start, flags);
+    }
+#endif /* !LWIP_MQTT_V5 */
+  }
+
+  if (client->conn_state == TCP_DISCONNECTED) {
+    /* Closed from callback */
+    return MQTT_CONNECT_DISCONNECTED;
+  }
+  /* Reply if QoS > 0 */
+  if ((*msg_rem_len == 0) && (qos > 0)) {
+    /* Send PUBACK for QoS 1 or PUBREC for QoS 2 */
+    u8_t resp_msg = (qos == 1) ? MQTT_MSG_TYPE_PUBACK : MQTT_MSG_TYPE_PUBREC;
+    LWIP_DEBUGF(MQTT_DEBUG_TRACE, ("mqtt_stream_publish: Sending publish response: %s with pkt_id: %d\n",
+                                   mqtt_msg_type_to_str(resp_msg), client->inpub_pkt_id));
+    pub_ack_rec_rel_response(client, resp_msg, client->inpub_pkt_id, 0);
+  }
+  return MQTT_CONNECT_ACCEPTED;
+}
+
+
 /**
  * MQTT incoming message parser
  * @param client MQTT client
- * @param p PBUF chain of received data
+ * @param p PBUF chain of received data, freed here
  * @return Connection status
  */
 static mqtt_connection_status_t
@@ -843,7 +1968,7 @@ mqtt_parse_incoming(mqtt_client_t *client, struct pbuf *p)
   u8_t fixed_hdr_idx = 0;
   u8_t b = 0;
 
-  while (p->tot_len > in_offset) {
+  while ((p != NULL) && (p->tot_len > in_offset)) {
     /* We ALWAYS parse the header here first. Even if the header was not
        included in this segment, we re-parse it here by buffering it in
        client->rx_buffer. client->msg_idx keeps track of this. */
@@ -880,6 +2005,20 @@ mqtt_parse_incoming(mqtt_client_t *client, struct pbuf *p)
           }
         }
       }
+    } else if ((client->pbuf_cb != NULL) && (MQTT_CTL_PACKET_TYPE(client->rx_buffer[0]) == MQTT_MSG_TYPE_PUBLISH)) {
+      /* Fixed header has been parsed, stream publish to application */
+      mqtt_connection_status_t res = mqtt_stream_publish(client, &p, &in_offset, &msg_rem_len, fixed_hdr_idx);
+      if (res != MQTT_CONNECT_ACCEPTED) {
+        if (p != NULL) {
+          pbuf_free(p);
+        }
+        return res;
+      }
+      if (msg_rem_len == 0) {
+        /* Reset parser state */
+        client->msg_idx = 0;
+        fixed_hdr_idx = 0;
+      }
     } else {
       /* Fixed header has been parsed, parse variable header */
       u16_t cpy_len, cpy_start, buffer_space;
@@ -906,6 +2045,7 @@ mqtt_parse_incoming(mqtt_client_t *client, struct pbuf *p)
         /* Whole message received or buffer is full */
         mqtt_connection_status_t res = mqtt_message_received(client, fixed_hdr_idx, (cpy_start + cpy_len) - fixed_hdr_idx, msg_rem_len);
         if (res != MQTT_CONNECT_ACCEPTED) {
+          pbuf_free(p);
           return res;
         }
         if (msg_rem_len == 0) {
@@ -917,6 +2057,9 @@ mqtt_parse_incoming(mqtt_client_t *client, struct pbuf *p)
       }
     }
   }
+  if (p != NULL) {
+    pbuf_free(p);
+  }
   return MQTT_CONNECT_ACCEPTED;
 }
 
@@ -948,8 +2091,8 @@ mqtt_tcp_recv_cb(void *arg, struct altcp_pcb *pcb, struct pbuf *p, err_t err)
 
     /* Tell remote that data has been received */
     altcp_recved(pcb, p->tot_len);
+    client->conn_aborted = 0;
     res = mqtt_parse_incoming(client, p);
-    pbuf_free(p);
 
     if (res != MQTT_CONNECT_ACCEPTED) {
       mqtt_close(client, res);
@@ -959,7 +2102,9 @@ mqtt_tcp_recv_cb(void *arg, struct altcp_pcb *pcb, struct pbuf *p, err_t err)
       /* Reset server alive watchdog */
       client->server_watchdog = 0;
     }
-
+    if (client->conn_aborted) {
+      return ERR_ABRT;
+    }
   }
   return ERR_OK;
 }
@@ -978,7 +2123,10 @@ mqtt_tcp_sent_cb(void *arg, struct altcp_pcb *tpcb, u16_t len)
   mqtt_client_t *client = (mqtt_client_t *)arg;
 
   LWIP_UNUSED_ARG(tpcb);
-  LWIP_UNUSED_ARG(len);
+
+  /* Release acknowledged payload pbufs */
+  mqtt_output_acked(client, len);
+  client->conn_aborted = 0;
 
   if (client->conn_state == MQTT_CONNECTED) {
     struct mqtt_request_t *r;
@@ -987,15 +2135,22 @@ mqtt_tcp_sent_cb(void *arg, struct altcp_pcb *tpcb, u16_t len)
     client->cyclic_tick = 0;
     client->server_watchdog = 0;
     /* QoS 0 publish has no response from server, so call its callbacks here */
-    while ((r = mqtt_take_request(&client->pend_req_queue, 0)) != NULL) {
+    while ((r = mqtt_take_request(client, 0)) != NULL) {
       LWIP_DEBUGF(MQTT_DEBUG_TRACE, ("mqtt_tcp_sent_cb: Calling QoS 0 publish complete callback\n"));
-      if (r->cb != NULL) {
-        r->cb(r->arg, ERR_OK);
+      mqtt_complete_request(r, ERR_OK);
+    }
+    /* Callback might have closed the connection */
+    if (client->conn != NULL) {
+      /* Continue resending a resumed session */
+      if (client->session_resume) {
+        mqtt_session_resume(client);
       }
-      mqtt_delete_request(r);
+      /* Try send any remaining buffers from output queue */
+      mqtt_output_send(client);
     }
-    /* Try send any remaining buffers from output queue */
-    mqtt_output_send(&client->output, client->conn);
+  }
+  if (client->conn_aborted) {
+    return ERR_ABRT;
   }
   return ERR_OK;
 }
@@ -1027,9 +2182,10 @@ static err_t
 mqtt_tcp_poll_cb(void *arg, struct altcp_pcb *tpcb)
 {
   mqtt_client_t *client = (mqtt_client_t *)arg;
+  LWIP_UNUSED_ARG(tpcb);
   if (client->conn_state == MQTT_CONNECTED) {
     /* Try send any remaining buffers from output queue */
-    mqtt_output_send(&client->output, tpcb);
+    mqtt_output_send(client);
   }
   return ERR_OK;
 }
@@ -1067,13 +2223,98 @@ mqtt_tcp_connect_cb(void *arg, struct altcp_pcb *tpcb, err_t err)
   client->cyclic_tick = 0;
 
   /* Start transmission from output queue, connect message is the first one out*/
-  mqtt_output_send(&client->output, client->conn);
+  mqtt_output_send(client);
 
   return ERR_OK;
 }
 
 
 
+/**
+ * Publish with the complete packet kept in the request until acknowledged,
+ * so it can be resent when the session is resumed after a reconnect.
+ * The packet is sent by reference from the output pbuf queue.
+ * @param client MQTT client
+ * @param topic Publish topic string
+ * @param topic_len Length of topic
+ * @param payload Data to publish (copied), NULL if payload_p is used
+ * @param payload_length Length of payload
+ * @param payload_p Data to publish (referenced), NULL if payload is used
+ * @param qos Quality of service, 1 or 2
+ * @param retain MQTT retain flag
+ * @param cb Callback to call when publish is complete or has timed out
+ * @param arg User supplied argument to publish callback
+ * @return ERR_OK if successful, ERR_MEM if short on memory, ERR_ARG if packet is too long
+ */
+static err_t
+mqtt_publish_retained(mqtt_client_t *client, const char *topic, u16_t topic_len, const void *payload, u16_t payload_length,
+                      struct pbuf *payload_p, u8_t qos, u8_t retain, mqtt_request_cb_t cb, void *arg)
+{
+  struct mqtt_request_t *r;
+  struct pbuf *p;
+  u8_t *buf;
+  u16_t idx;
+  /* Topic, packet id (and empty property block, topic aliases are not resumable) */
+#if LWIP_MQTT_V5
+  u32_t var_header_len = 2 + (u32_t)topic_len + 2 + 1;
+#else /* LWIP_MQTT_V5 */
+  u32_t var_header_len = 2 + (u32_t)topic_len + 2;
+#endif /* LWIP_MQTT_V5 */
+  u32_t remaining_length = var_header_len + payload_length;
+  u32_t header_len = mqtt_output_fixed_header_len(remaining_length) + var_header_len;
+  u16_t copy_len = (payload_p == NULL) ? payload_length : 0;
+
+  LWIP_ERROR("mqtt_publish_retained: packet length overflow", (header_len + payload_length <= 0xFFFF), return ERR_ARG);
+  if (client->out_pbuf_len >= MQTT_OUTPUT_PBUF_QUEUE_LEN) {
+    return ERR_MEM;
+  }
+  p = pbuf_alloc(PBUF_RAW, (u16_t)(header_len + copy_len), PBUF_RAM);
+  if (p == NULL) {
+    return ERR_MEM;
+  }
+  r = mqtt_create_request(client, 1, cb, arg);
+  if (r == NULL) {
+    pbuf_free(p);
+    return ERR_MEM;
+  }
+
+  LWIP_DEBUGF(MQTT_DEBUG_TRACE, ("mqtt_publish_retained: Publish with payload length %d to topic \"%s\", id: %d\n",
+                                 payload_length, topic, r->pkt_id));
+
+  /* Fixed header */
+  buf = (u8_t *)p->payload;
+  idx = 0;
+  buf[idx++] = (u8_t)((MQTT_MSG_TYPE_PUBLISH << 4) | ((qos & 3) << 1) | (retain & 1));
+  do {
+    buf[idx++] = (u8_t)((remaining_length & 0x7f) | (remaining_length >= 128 ? 0x80 : 0));
+    remaining_length >>= 7;
+  } while (remaining_length > 0);
+  /* Topic and packet id */
+  buf[idx++] = (u8_t)(topic_len >> 8);
+  buf[idx++] = (u8_t)(topic_len & 0xff);
+  MEMCPY(&buf[idx], topic, topic_len);
+  idx = (u16_t)(idx + topic_len);
+  buf[idx++] = (u8_t)(r->pkt_id >> 8);
+  buf[idx++] = (u8_t)(r->pkt_id & 0xff);
+#if LWIP_MQTT_V5
+  buf[idx++] = 0;
+#endif /* LWIP_MQTT_V5 */
+  /* Payload */
+  if (copy_len > 0) {
+    MEMCPY(&buf[idx], payload, copy_len);
+  } else if ((payload_p != NULL) && (payload_length > 0)) {
+    pbuf_chain(p, payload_p);
+  }
+
+  r->p = p;
+  r->flags |= MQTT_REQ_FLAG_QOS_PUB;
+  mqtt_output_append_pbuf(client, p);
+  mqtt_append_request(client, r);
+  mqtt_output_send(client);
+  return ERR_OK;
+}
+
+
 /*---------------------------------------------------------------------------------------------------- */
 /* Public API */
 
@@ -1081,6 +2322,8 @@ mqtt_tcp_connect_cb(void *arg, struct altcp_pcb *tpcb, err_t err)
 /**
  * @ingroup mqtt
  * MQTT publish function.
+ * Payloads that do not fit into the output ring buffer are copied into a pbuf
+ * and sent like @ref mqtt_publish_pbuf does.
  * @param client MQTT client
  * @param topic Publish topic string
  * @param payload Data to publish (NULL is allowed)
@@ -1100,9 +2343,12 @@ mqtt_publish(mqtt_client_t *client, const char *topic, const void *payload, u16_
   struct mqtt_request_t *r;
   u16_t pkt_id;
   size_t topic_strlen;
-  size_t total_len;
   u16_t topic_len;
-  u16_t remaining_length;
+  u32_t remaining_length;
+#if LWIP_MQTT_V5
+  u16_t alias;
+  u8_t send_topic;
+#endif /* LWIP_MQTT_V5 */
 
   LWIP_ASSERT_CORE_LOCKED();
   LWIP_ASSERT("mqtt_publish: client != NULL", client);
@@ -1112,25 +2358,46 @@ mqtt_publish(mqtt_client_t *client, const char *topic, const void *payload, u16_
   topic_strlen = strlen(topic);
   LWIP_ERROR("mqtt_publish: topic length overflow", (topic_strlen <= (0xFFFF - 2)), return ERR_ARG);
   topic_len = (u16_t)topic_strlen;
-  total_len = 2 + topic_len + payload_length;
 
-  if (qos > 0) {
-    total_len += 2;
-    /* Generate pkt_id id for QoS1 and 2 */
-    pkt_id = msg_generate_packet_id(client);
-  } else {
-    /* Use reserved value pkt_id 0 for QoS 0 in request handle */
-    pkt_id = 0;
+#if LWIP_MQTT_V5
+  if (mqtt_receive_max_reached(client, qos)) {
+    return ERR_MEM;
+  }
+#endif /* LWIP_MQTT_V5 */
+  if (client->keep_session && (qos > 0)) {
+    return mqtt_publish_retained(client, topic, topic_len, payload, (payload != NULL) ? payload_length : 0, NULL,
+                                 qos, retain, cb, arg);
+  }
+#if LWIP_MQTT_V5
+  send_topic = mqtt_topic_alias_select(client, topic, topic_len, &alias);
+  remaining_length = 2 + (send_topic ? (u32_t)topic_len : 0) + MQTT_PUBLISH_PROPS_LEN(alias) + payload_length + (qos > 0 ? 2 : 0);
+#else /* LWIP_MQTT_V5 */
+  remaining_length = 2 + (u32_t)topic_len + payload_length + (qos > 0 ? 2 : 0);
+#endif /* LWIP_MQTT_V5 */
+
+  if ((payload != NULL) && (payload_length > 0) &&
+      (mqtt_output_check_space(&client->output, remaining_length) == 0)) {
+    /* Payload does not fit into the output ring buffer, send it from a pbuf */
+    struct pbuf *p;
+    err_t err;
+    p = pbuf_alloc(PBUF_RAW, payload_length, PBUF_RAM);
+    if (p == NULL) {
+      return ERR_MEM;
+    }
+    pbuf_take(p, payload, payload_length);
+    err = mqtt_publish_pbuf(client, topic, p, qos, retain, cb, arg);
+    pbuf_free(p);
+    return err;
   }
-  LWIP_ERROR("mqtt_publish: total length overflow", (total_len <= 0xFFFF), return ERR_ARG);
-  remaining_length = (u16_t)total_len;
 
   LWIP_DEBUGF(MQTT_DEBUG_TRACE, ("mqtt_publish: Publish with payload length %d to topic \"%s\"\n", payload_length, topic));
 
-  r = mqtt_create_request(client->req_list, LWIP_ARRAYSIZE(client->req_list), pkt_id, cb, arg);
+  /* Generate pkt_id id for QoS1 and 2, reserved value pkt_id 0 is used for QoS 0 in request handle */
+  r = mqtt_create_request(client, qos > 0, cb, arg);
   if (r == NULL) {
     return ERR_MEM;
   }
+  pkt_id = r->pkt_id;
 
   if (mqtt_output_check_space(&client->output, remaining_length) == 0) {
     mqtt_delete_request(r);
@@ -1139,21 +2406,142 @@ mqtt_publish(mqtt_client_t *client, const char *topic, const void *payload, u16_
   /* Append fixed header */
   mqtt_output_append_fixed_header(&client->output, MQTT_MSG_TYPE_PUBLISH, 0, qos, retain, remaining_length);
 
+#if LWIP_MQTT_V5
+  /* Append Topic, empty if replaced by alias */
+  mqtt_output_append_string(&client->output, topic, send_topic ? topic_len : 0);
+#else /* LWIP_MQTT_V5 */
   /* Append Topic */
   mqtt_output_append_string(&client->output, topic, topic_len);
+#endif /* LWIP_MQTT_V5 */
 
   /* Append packet if for QoS 1 and 2*/
   if (qos > 0) {
     mqtt_output_append_u16(&client->output, pkt_id);
+    r->flags |= MQTT_REQ_FLAG_QOS_PUB;
   }
+#if LWIP_MQTT_V5
+  mqtt_output_append_publish_props(&client->output, alias);
+  mqtt_topic_alias_commit(client, alias, topic, topic_len, send_topic);
+#endif /* LWIP_MQTT_V5 */
 
   /* Append optional publish payload */
   if ((payload != NULL) && (payload_length > 0)) {
     mqtt_output_append_buf(&client->output, payload, payload_length);
   }
 
-  mqtt_append_request(&client->pend_req_queue, r);
-  mqtt_output_send(&client->output, client->conn);
+  mqtt_append_request(client, r);
+  mqtt_output_send(client);
+  return ERR_OK;
+}
+
+/**
+ * @ingroup mqtt
+ * MQTT publish function for payloads in pbufs.
+ * Only the message header is copied into the output ring buffer, the payload is
+ * sent by reference: the client takes its own reference on 'payload' and frees
+ * it when the data has been acknowledged by the server. When disconnecting with
+ * payload data written but not acknowledged, the connection is shut down and
+ * only closed (and the payload freed) after that data has been acknowledged.
+ * The caller may free its reference after this function returns but must not
+ * change the payload data.
+ * This allows sending payloads larger than MQTT_OUTPUT_RINGBUF_SIZE. Up to
+ * MQTT_OUTPUT_PBUF_QUEUE_LEN payloads can be queued.
+ * @param client MQTT client
+ * @param topic Publish topic string
+ * @param payload Data to publish (NULL is allowed)
+ * @param qos Quality of service, 0 1 or 2
+ * @param retain MQTT retain flag
+ * @param cb Callback to call when publish is complete or has timed out
+ * @param arg User supplied argument to publish callback
+ * @return ERR_OK if successful
+ *         ERR_CONN if client is disconnected
+ *         ERR_MEM if short on memory or the payload queue is full
+ */
+err_t
+mqtt_publish_pbuf(mqtt_client_t *client, const char *topic, struct pbuf *payload, u8_t qos, u8_t retain,
+                  mqtt_request_cb_t cb, void *arg)
+{
+  struct mqtt_request_t *r;
+  u16_t pkt_id;
+  size_t topic_strlen;
+  u16_t topic_len;
+  u16_t header_len;
+  u16_t payload_length;
+  u32_t remaining_length;
+#if LWIP_MQTT_V5
+  u16_t alias;
+  u8_t send_topic;
+#endif /* LWIP_MQTT_V5 */
+
+  LWIP_ASSERT_CORE_LOCKED();
+  LWIP_ASSERT("mqtt_publish_pbuf: client != NULL", client);
+  LWIP_ASSERT("mqtt_publish_pbuf: topic != NULL", topic);
+  LWIP_ERROR("mqtt_publish_pbuf: TCP disconnected", (client->conn_state != TCP_DISCONNECTED), return ERR_CONN);
+
+  topic_strlen = strlen(topic);
+  LWIP_ERROR("mqtt_publish_pbuf: topic length overflow", (topic_strlen <= (0xFFFF - 8)), return ERR_ARG);
+  topic_len = (u16_t)topic_strlen;
+  payload_length = (payload != NULL) ? payload->tot_len : 0;
+
+#if LWIP_MQTT_V5
+  if (mqtt_receive_max_reached(client, qos)) {
+    return ERR_MEM;
+  }
+#endif /* LWIP_MQTT_V5 */
+  if (client->keep_session && (qos > 0)) {
+    return mqtt_publish_retained(client, topic, topic_len, NULL, payload_length, payload, qos, retain, cb, arg);
+  }
+#if LWIP_MQTT_V5
+  send_topic = mqtt_topic_alias_select(client, topic, topic_len, &alias);
+  header_len = (u16_t)(2 + (send_topic ? topic_len : 0) + MQTT_PUBLISH_PROPS_LEN(alias) + (qos > 0 ? 2 : 0));
+#else /* LWIP_MQTT_V5 */
+  header_len = (u16_t)(2 + topic_len + (qos > 0 ? 2 : 0));
+#endif /* LWIP_MQTT_V5 */
+  remaining_length = (u32_t)header_len + payload_length;
+
+  /* Only the header goes into the output ring buffer */
+  if ((client->out_pbuf_len >= MQTT_OUTPUT_PBUF_QUEUE_LEN) ||
+      (mqtt_output_fixed_header_len(remaining_length) + header_len > (u32_t)mqtt_ringbuf_free(&client->output))) {
+    return ERR_MEM;
+  }
+
+  LWIP_DEBUGF(MQTT_DEBUG_TRACE, ("mqtt_publish_pbuf: Publish with payload length %d to topic \"%s\"\n", payload_length, topic));
+
+  /* Generate pkt_id id for QoS1 and 2, reserved value pkt_id 0 is used for QoS 0 in request handle */
+  r = mqtt_create_request(client, qos > 0, cb, arg);
+  if (r == NULL) {
+    return ERR_MEM;
+  }
+  pkt_id = r->pkt_id;
+
+  /* Append fixed header */
+  mqtt_output_append_fixed_header(&client->output, MQTT_MSG_TYPE_PUBLISH, 0, qos, retain, remaining_length);
+
+#if LWIP_MQTT_V5
+  /* Append Topic, empty if replaced by alias */
+  mqtt_output_append_string(&client->output, topic, send_topic ? topic_len : 0);
+#else /* LWIP_MQTT_V5 */
+  /* Append Topic */
+  mqtt_output_append_string(&client->output, topic, topic_len);
+#endif /* LWIP_MQTT_V5 */
+
+  /* Append packet if for QoS 1 and 2*/
+  if (qos > 0) {
+    mqtt_output_append_u16(&client->output, pkt_id);
+    r->flags |= MQTT_REQ_FLAG_QOS_PUB;
+  }
+#if LWIP_MQTT_V5
+  mqtt_output_append_publish_props(&client->output, alias);
+  mqtt_topic_alias_commit(client, alias, topic, topic_len, send_topic);
+#endif /* LWIP_MQTT_V5 */
+
+  /* Queue payload by reference */
+  if (payload_length > 0) {
+    mqtt_output_append_pbuf(client, payload);
+  }
+
+  mqtt_append_request(client, r);
+  mqtt_output_send(client);
   return ERR_OK;
 }
 
@@ -1188,6 +2576,10 @@ mqtt_sub_unsub(mqtt_client_t *client, const char *topic, u8_t qos, mqtt_request_
   topic_len = (u16_t)topic_strlen;
   /* Topic string, pkt_id, qos for subscribe */
   total_len =  topic_len + 2 + 2 + (sub != 0);
+#if LWIP_MQTT_V5
+  /* Empty property block */
+  total_len++;
+#endif /* LWIP_MQTT_V5 */
   LWIP_ERROR("mqtt_sub_unsub: total length overflow", (total_len <= 0xFFFF), return ERR_ARG);
   remaining_length = (u16_t)total_len;
 
@@ -1197,11 +2589,11 @@ mqtt_sub_unsub(mqtt_client_t *client, const char *topic, u8_t qos, mqtt_request_
     return ERR_CONN;
   }
 
-  pkt_id = msg_generate_packet_id(client);
-  r = mqtt_create_request(client->req_list, LWIP_ARRAYSIZE(client->req_list), pkt_id, cb, arg);
+  r = mqtt_create_request(client, 1, cb, arg);
   if (r == NULL) {
     return ERR_MEM;
   }
+  pkt_id = r->pkt_id;
 
   if (mqtt_output_check_space(&client->output, remaining_length) == 0) {
     mqtt_delete_request(r);
@@ -1213,6 +2605,10 @@ mqtt_sub_unsub(mqtt_client_t *client, const char *topic, u8_t qos, mqtt_request_
   mqtt_output_append_fixed_header(&client->output, sub ? MQTT_MSG_TYPE_SUBSCRIBE : MQTT_MSG_TYPE_UNSUBSCRIBE, 0, 1, 0, remaining_length);
   /* Packet id */
   mqtt_output_append_u16(&client->output, pkt_id);
+#if LWIP_MQTT_V5
+  /* Properties */
+  mqtt_output_append_u8(&client->output, 0);
+#endif /* LWIP_MQTT_V5 */
   /* Topic */
   mqtt_output_append_string(&client->output, topic, topic_len);
   /* QoS */
@@ -1220,8 +2616,8 @@ mqtt_sub_unsub(mqtt_client_t *client, const char *topic, u8_t qos, mqtt_request_
     mqtt_output_append_u8(&client->output, LWIP_MIN(qos, 2));
   }
 
-  mqtt_append_request(&client->pend_req_queue, r);
-  mqtt_output_send(&client->output, client->conn);
+  mqtt_append_request(client, r);
+  mqtt_output_send(client);
   return ERR_OK;
 }
 
@@ -1245,6 +2641,29 @@ mqtt_set_inpub_callback(mqtt_client_t *client, mqtt_incoming_publish_cb_t pub_cb
   client->inpub_arg = arg;
 }
 
+/**
+ * @ingroup mqtt
+ * Set callbacks to stream incoming publish requests from server: the topic is
+ * passed in parts (so topics are not limited by MQTT_VAR_HEADER_BUFFER_LEN)
+ * and payload is passed in pbufs taken from the received data without copying.
+ * If pbuf_cb is set, it is used instead of the callbacks set by
+ * @ref mqtt_set_inpub_callback.
+ * @param client MQTT client
+ * @param topic_cb Callback for each part of the topic, contains total length of payload (may be NULL)
+ * @param pbuf_cb Callback for each part of payload that arrives, NULL to disable streaming
+ * @param arg User supplied argument to both callbacks
+ */
+void
+mqtt_set_inpub_stream_callback(mqtt_client_t *client, mqtt_incoming_topic_cb_t topic_cb,
+                               mqtt_incoming_pbuf_cb_t pbuf_cb, void *arg)
+{
+  LWIP_ASSERT_CORE_LOCKED();
+  LWIP_ASSERT("mqtt_set_inpub_stream_callback: client != NULL", client != NULL);
+  client->topic_cb = topic_cb;
+  client->pbuf_cb = pbuf_cb;
+  client->inpub_arg = arg;
+}
+
 /**
  * @ingroup mqtt
  * Create a new MQTT client instance
@@ -1265,9 +2684,45 @@ mqtt_client_new(void)
 void
 mqtt_client_free(mqtt_client_t *client)
 {
+  mqtt_closing_abort(client);
+  mqtt_free_requests(client);
   mem_free(client);
 }
 
+/**
+ * @ingroup mqtt
+ * Configure in-flight window and session persistence, call before @ref mqtt_client_connect.
+ * @param client MQTT client
+ * @param inflight_window Maximum number of pending requests (QoS 1 and 2 publishes,
+ *        (un)subscribes and unsent QoS 0 publishes), 0 for MQTT_REQ_MAX_IN_FLIGHT
+ * @param keep_session 1 to connect without the clean session flag and keep unacknowledged
+ *        QoS 1 and 2 publishes across connections: they are resent if the server resumes
+ *        the session, or completed with ERR_ABRT if it does not.
+ *        QoS 1 and 2 publishes then keep a copy of the complete packet until acknowledged
+ *        (payload pbufs are referenced) and the session state is released by
+ *        @ref mqtt_client_free only.
+ * @return ERR_OK if successful, ERR_ISCONN if not disconnected
+ */
+err_t
+mqtt_client_set_session(mqtt_client_t *client, u16_t inflight_window, u8_t keep_session)
+{
+  LWIP_ASSERT_CORE_LOCKED();
+  LWIP_ASSERT("mqtt_client_set_session: client != NULL", client != NULL);
+  if (client->conn_state != TCP_DISCONNECTED) {
+    return ERR_ISCONN;
+  }
+  if (inflight_window == 0) {
+    inflight_window = MQTT_REQ_MAX_IN_FLIGHT;
+  }
+  if ((inflight_window != client->req_list_len) || !keep_session) {
+    /* Kept session state does not fit the new settings */
+    mqtt_free_requests(client);
+  }
+  client->req_list_len = inflight_window;
+  client->keep_session = keep_session ? 1 : 0;
+  return ERR_OK;
+}
+
 /**
  * @ingroup mqtt
  * Connect to MQTT server
@@ -1286,10 +2741,18 @@ mqtt_client_connect(mqtt_client_t *client, const ip_addr_t *ip_addr, u16_t port,
   err_t err;
   size_t len;
   u16_t client_id_length;
+#if LWIP_MQTT_V5
+  /* Length is the sum of 2+"MQTT", protocol level, flags, keep alive and properties */
+  u16_t remaining_length = 2 + 4 + 1 + 1 + 2 + 1 + (MQTT_TOPIC_ALIAS_IN_MAX > 0 ? 3 : 0);
+#else /* LWIP_MQTT_V5 */
   /* Length is the sum of 2+"MQTT", protocol level, flags and keep alive */
   u16_t remaining_length = 2 + 4 + 1 + 1 + 2;
+#endif /* LWIP_MQTT_V5 */
   u8_t flags = 0, will_topic_len = 0, will_msg_len = 0;
   u16_t client_user_len = 0, client_pass_len = 0;
+  struct mqtt_request_t *req_list, *pend_req_queue, *pend_req_tail;
+  u16_t req_list_len, pkt_id_seq, req_time, qos_pub_inflight;
+  u8_t keep_session;
 
   LWIP_ASSERT_CORE_LOCKED();
   LWIP_ASSERT("mqtt_client_connect: client != NULL", client != NULL);
@@ -1301,13 +2764,33 @@ mqtt_client_connect(mqtt_client_t *client, const ip_addr_t *ip_addr, u16_t port,
     LWIP_DEBUGF(MQTT_DEBUG_WARN, ("mqtt_client_connect: Already connected\n"));
     return ERR_ISCONN;
   }
-
-  /* Wipe clean */
+  /* Previous connection still waiting for payload acknowledgement */
+  mqtt_closing_abort(client);
+
+  /* Wipe clean, keeping settings and session state */
+  req_list = client->req_list;
+  req_list_len = client->req_list_len;
+  keep_session = client->keep_session;
+  pend_req_queue = client->pend_req_queue;
+  pend_req_tail = client->pend_req_tail;
+  pkt_id_seq = client->pkt_id_seq;
+  req_time = client->req_time;
+  qos_pub_inflight = client->qos_pub_inflight;
   memset(client, 0, sizeof(mqtt_client_t));
   client->connect_arg = arg;
   client->connect_cb = cb;
   client->keep_alive = client_info->keep_alive;
-  mqtt_init_requests(client->req_list, LWIP_ARRAYSIZE(client->req_list));
+  client->req_list = req_list;
+  client->req_list_len = req_list_len;
+  client->keep_session = keep_session;
+  if (keep_session) {
+    client->pend_req_queue = pend_req_queue;
+    client->pend_req_tail = pend_req_tail;
+    client->pkt_id_seq = pkt_id_seq;
+    client->req_time = req_time;
+    client->qos_pub_inflight = qos_pub_inflight;
+    client->session_resume = (pend_req_queue != NULL);
+  }
 
   /* Build connect message */
   if (client_info->will_topic != NULL && client_info->will_msg != NULL) {
@@ -1323,6 +2806,10 @@ mqtt_client_connect(mqtt_client_t *client, const ip_addr_t *ip_addr, u16_t port,
     len = strlen(client_info->will_msg);
     LWIP_ERROR("mqtt_client_connect: client_info->will_msg length overflow", len <= 0xFF, return ERR_VAL);
     will_msg_len = (u8_t)len;
+#if LWIP_MQTT_V5
+    /* Empty will property block */
+    remaining_length++;
+#endif /* LWIP_MQTT_V5 */
     len = remaining_length + 2 + will_topic_len + 2 + will_msg_len;
     LWIP_ERROR("mqtt_client_connect: remaining_length overflow", len <= 0xFFFF, return ERR_VAL);
     remaining_length = (u16_t)len;
@@ -1348,8 +2835,10 @@ mqtt_client_connect(mqtt_client_t *client, const ip_addr_t *ip_addr, u16_t port,
     remaining_length = (u16_t)len;
   }
 
-  /* Don't complicate things, always connect using clean session */
-  flags |= MQTT_CONNECT_FLAG_CLEAN_SESSION;
+  /* Connect using clean session unless session state is kept */
+  if (!client->keep_session) {
+    flags |= MQTT_CONNECT_FLAG_CLEAN_SESSION;
+  }
 
   len = strlen(client_info->client_id);
   LWIP_ERROR("mqtt_client_connect: client_info->client_id length overflow", len <= 0xFFFF, return ERR_VAL);
@@ -1361,6 +2850,9 @@ mqtt_client_connect(mqtt_client_t *client, const ip_addr_t *ip_addr, u16_t port,
   if (mqtt_output_check_space(&client->output, remaining_length) == 0) {
     return ERR_MEM;
   }
+  if ((client->req_list == NULL) && (mqtt_init_requests(client) != ERR_OK)) {
+    return ERR_MEM;
+  }
 
 #if LWIP_ALTCP && LWIP_ALTCP_TLS
   if (client_info->tls_config) {
@@ -1371,7 +2863,8 @@ mqtt_client_connect(mqtt_client_t *client, const ip_addr_t *ip_addr, u16_t port,
     client->conn = altcp_tcp_new_ip_type(IP_GET_TYPE(ip_addr));
   }
   if (client->conn == NULL) {
-    return ERR_MEM;
+    err = ERR_MEM;
+    goto req_fail;
   }
 
   /* Set arg pointer for callbacks */
@@ -1398,16 +2891,34 @@ mqtt_client_connect(mqtt_client_t *client, const ip_addr_t *ip_addr, u16_t port,
   mqtt_output_append_fixed_header(&client->output, MQTT_MSG_TYPE_CONNECT, 0, 0, 0, remaining_length);
   /* Append Protocol string */
   mqtt_output_append_string(&client->output, "MQTT", 4);
+#if LWIP_MQTT_V5
+  /* Append Protocol level */
+  mqtt_output_append_u8(&client->output, 5);
+#else /* LWIP_MQTT_V5 */
   /* Append Protocol level */
   mqtt_output_append_u8(&client->output, 4);
+#endif /* LWIP_MQTT_V5 */
   /* Append connect flags */
   mqtt_output_append_u8(&client->output, flags);
   /* Append keep-alive */
   mqtt_output_append_u16(&client->output, client_info->keep_alive);
+#if LWIP_MQTT_V5
+  /* Append properties */
+#if MQTT_TOPIC_ALIAS_IN_MAX > 0
+  mqtt_output_append_u8(&client->output, 3);
+  mqtt_output_append_u8(&client->output, MQTT_PROP_TOPIC_ALIAS_MAXIMUM);
+  mqtt_output_append_u16(&client->output, MQTT_TOPIC_ALIAS_IN_MAX);
+#else /* MQTT_TOPIC_ALIAS_IN_MAX > 0 */
+  mqtt_output_append_u8(&client->output, 0);
+#endif /* MQTT_TOPIC_ALIAS_IN_MAX > 0 */
+#endif /* LWIP_MQTT_V5 */
   /* Append client id */
   mqtt_output_append_string(&client->output, client_info->client_id, client_id_length);
   /* Append will message if used */
   if ((flags & MQTT_CONNECT_FLAG_WILL) != 0) {
+#if LWIP_MQTT_V5
+    mqtt_output_append_u8(&client->output, 0);
+#endif /* LWIP_MQTT_V5 */
     mqtt_output_append_string(&client->output, client_info->will_topic, will_topic_len);
     mqtt_output_append_string(&client->output, client_info->will_msg, will_msg_len);
   }
@@ -1424,6 +2935,10 @@ mqtt_client_connect(mqtt_client_t *client, const ip_addr_t *ip_addr, u16_t port,
 tcp_fail:
   altcp_abort(client->conn);
   client->conn = NULL;
+req_fail:
+  if (!client->keep_session) {
+    mqtt_free_requests(client);
+  }
   return err;
 }
 
@@ -222,6 +222,28 @@ static u8_t snmp_num_mibs                          = 0;
 /* List of known mibs */
 static struct snmp_mib const *const *snmp_mibs = default_mibs;
 
+#if SNMP_LWIP_MIB_INDEX_SIZE > 0
+/** Flattened MIB index entry: leaf node and its OID below the MIB base OID.
+ * Entries of a MIB are contiguous and sorted by OID. */
+struct snmp_mib_index_entry
+{
+  const struct snmp_node *node;
+  u32_t oid[SNMP_LWIP_MIB_INDEX_DEPTH];
+  u8_t oid_len;
+  /** Position of the MIB in snmp_mibs */
+  u8_t mib_idx;
+};
+
+#define SNMP_MIB_INDEX_INVALID  0
+#define SNMP_MIB_INDEX_VALID    1
+/** MIB trees do not fit into the index, trees are walked */
+#define SNMP_MIB_INDEX_OVERFLOW 2
+
+static struct snmp_mib_index_entry snmp_mib_index[SNMP_LWIP_MIB_INDEX_SIZE];
+static u16_t snmp_mib_index_len;
+static u8_t snmp_mib_index_state;
+#endif /* SNMP_LWIP_MIB_INDEX_SIZE > 0 */
+
 /**
  * @ingroup snmp_core
  * Sets the MIBs to use.
@@ -240,6 +262,10 @@ snmp_set_mibs(const struct snmp_mib **mibs, u8_t num_mibs)
   LWIP_ASSERT("num_mibs pointer must be != 0", (num_mibs != 0));
   snmp_mibs     = mibs;
   snmp_num_mibs = num_mibs;
+#if SNMP_LWIP_MIB_INDEX_SIZE > 0
+  /* rebuild index on next use */
+  snmp_mib_index_state = SNMP_MIB_INDEX_INVALID;
+#endif
 }
 
 /**
@@ -807,16 +833,29 @@ snmp_get_node_instance_from_oid(const u32_t *oid, u8_t oid_len, struct snmp_node
   return result;
 }
 
+/**
+ * Searches the next node instance following the supplied OID.
+ * @param cursor NULL or resolution cursor; if it holds the result of a previous call and
+ *        oid is that result OID, the search continues at its node instead of resolving oid
+ *        from the MIB root. Updated with the result.
+ */
 u8_t
-snmp_get_next_node_instance_from_oid(const u32_t *oid, u8_t oid_len, snmp_validate_node_instance_method validate_node_instance_method, void *validate_node_instance_arg, struct snmp_obj_id *node_oid, struct snmp_node_instance *node_instance)
+snmp_get_next_node_instance_from_oid(const u32_t *oid, u8_t oid_len, snmp_validate_node_instance_method validate_node_instance_method, void *validate_node_instance_arg, struct snmp_obj_id *node_oid, struct snmp_node_instance *node_instance, struct snmp_next_cursor *cursor)
 {
   const struct snmp_mib      *mib;
   const struct snmp_node *mn = NULL;
+  const struct snmp_node *resume_node = NULL;
   const u32_t *start_oid     = NULL;
   u8_t         start_oid_len = 0;
 
   /* resolve target MIB from passed OID */
   mib = snmp_get_mib_from_oid(oid, oid_len);
+  if ((mib != NULL) && (cursor != NULL) && (cursor->node != NULL) && (cursor->mib == mib) &&
+      (cursor->node_oid_len > mib->base_oid_len) && (cursor->node_oid_len <= oid_len) &&
+      (memcmp(&oid[mib->base_oid_len], cursor->node_subids, (cursor->node_oid_len - mib->base_oid_len) * sizeof(u32_t)) == 0)) {
+    /* continue at node of previous result (mib matched oid, so the base OID is equal, too) */
+    resume_node = cursor->node;
+  }
   if (mib == NULL) {
     /* passed OID does not reference any known MIB, start at the next closest MIB */
     mib = snmp_get_next_mib(oid, oid_len);
@@ -835,7 +874,13 @@ snmp_get_next_node_instance_from_oid(const u32_t *oid, u8_t oid_len, snmp_valida
     u8_t oid_instance_len;
 
     /* check if OID directly references a node inside current MIB, in this case we have to ask this node for the next instance */
-    mn = snmp_mib_tree_resolve_exact(mib, start_oid, start_oid_len, &oid_instance_len);
+    if (resume_node != NULL) {
+      mn = resume_node;
+      oid_instance_len = (u8_t)(start_oid_len - cursor->node_oid_len);
+      resume_node = NULL;
+    } else {
+      mn = snmp_mib_tree_resolve_exact(mib, start_oid, start_oid_len, &oid_instance_len);
+    }
     if (mn != NULL) {
       snmp_oid_assign(node_oid, start_oid, start_oid_len - oid_instance_len); /* set oid to node */
       snmp_oid_assign(&node_instance->instance_oid, start_oid + (start_oid_len - oid_instance_len), oid_instance_len); /* set (relative) instance oid */
@@ -969,9 +1014,24 @@ snmp_get_next_node_instance_from_oid(const u32_t *oid, u8_t oid_len, snmp_valida
 
   if (mib == NULL) {
     /* loop is only left when mib == null (error) or mib_node != NULL (success) */
+    if (cursor != NULL) {
+      cursor->node = NULL;
+    }
     return SNMP_ERR_ENDOFMIBVIEW;
   }
 
+  if (cursor != NULL) {
+    u8_t node_oid_len = (u8_t)(node_oid->len - node_instance->instance_oid.len);
+
+    cursor->node = NULL;
+    if ((node_oid_len > mib->base_oid_len) && (node_oid_len - mib->base_oid_len <= SNMP_LWIP_MIB_INDEX_DEPTH)) {
+      cursor->mib          = mib;
+      cursor->node         = mn;
+      cursor->node_oid_len = node_oid_len;
+      MEMCPY(cursor->node_subids, &node_oid->id[mib->base_oid_len], (node_oid_len - mib->base_oid_len) * sizeof(u32_t));
+    }
+  }
+
   return SNMP_ERR_NOERROR;
 }
 
@@ -979,8 +1039,8 @@ snmp_get_next_node_instance_from_oid(const u32_t *oid, u8_t oid_len, snmp_valida
  * Searches tree for the supplied object identifier.
  *
  */
-const struct snmp_node *
-snmp_mib_tree_resolve_exact(const struct snmp_mib *mib, const u32_t *oid, u8_t oid_len, u8_t *oid_instance_len)
+static const struct snmp_node *
+snmp_mib_tree_walk_exact(const struct snmp_mib *mib, const u32_t *oid, u8_t oid_len, u8_t *oid_instance_len)
 {
   const struct snmp_node *const *node = &mib->root_node;
   u8_t oid_offset = mib->base_oid_len;
@@ -1013,8 +1073,8 @@ snmp_mib_tree_resolve_exact(const struct snmp_mib *mib, const u32_t *oid, u8_t o
   return NULL;
 }
 
-const struct snmp_node *
-snmp_mib_tree_resolve_next(const struct snmp_mib *mib, const u32_t *oid, u8_t oid_len, struct snmp_obj_id *oidret)
+static const struct snmp_node *
+snmp_mib_tree_walk_next(const struct snmp_mib *mib, const u32_t *oid, u8_t oid_len, struct snmp_obj_id *oidret)
 {
   u8_t  oid_offset = mib->base_oid_len;
   const struct snmp_node *const *node;
@@ -1108,6 +1168,185 @@ snmp_mib_tree_resolve_next(const struct snmp_mib *mib, const u32_t *oid, u8_t oi
   return NULL;
 }
 
+#if SNMP_LWIP_MIB_INDEX_SIZE > 0
+/** Fills the MIB index with the leaf nodes of all MIBs, in OID order per MIB */
+static void
+snmp_mib_index_build(void)
+{
+  struct snmp_obj_id oid;
+  u16_t n = 0;
+  u8_t i;
+
+  snmp_mib_index_state = SNMP_MIB_INDEX_OVERFLOW;
+
+  for (i = 0; i < snmp_num_mibs; i++) {
+    const struct snmp_mib *mib = snmp_mibs[i];
+    const struct snmp_node *node;
+
+    if (mib->root_node->node_type != SNMP_NODE_TREE) {
+      /* MIB consists of a single leaf node at its base OID */
+      if (n >= SNMP_LWIP_MIB_INDEX_SIZE) {
+        return;
+      }
+      snmp_mib_index[n].node    = mib->root_node;
+      snmp_mib_index[n].oid_len = 0;
+      snmp_mib_index[n].mib_idx = i;
+      n++;
+      continue;
+    }
+
+    snmp_oid_assign(&oid, mib->base_oid, mib->base_oid_len);
+    /* the walk has read the passed OID before writing the result, so oid may be used for both */
+    while ((node = snmp_mib_tree_walk_next(mib, oid.id, oid.len, &oid)) != NULL) {
+      u8_t len = (u8_t)(oid.len - mib->base_oid_len);
+
+      if ((n >= SNMP_LWIP_MIB_INDEX_SIZE) || (len > SNMP_LWIP_MIB_INDEX_DEPTH)) {
+        LWIP_DEBUGF(SNMP_DEBUG, ("SNMP MIB index too small, walking MIB trees\n"));
+        return;
+      }
+      snmp_mib_index[n].node    = node;
+      snmp_mib_index[n].oid_len = len;
+      snmp_mib_index[n].mib_idx = i;
+      MEMCPY(snmp_mib_index[n].oid, &oid.id[mib->base_oid_len], len * sizeof(u32_t));
+      n++;
+    }
+  }
+
+  snmp_mib_index_len   = n;
+  snmp_mib_index_state = SNMP_MIB_INDEX_VALID;
+}
+
+/**
+ * Determines the index entries of a MIB and returns the first of them whose OID is
+ * greater than the OID below the MIB base OID in 'oid'.
+ * @return 0 if the index is not usable
+ */
+static u8_t
+snmp_mib_index_upper_bound(const struct snmp_mib *mib, const u32_t *oid, u8_t oid_len, u16_t *first, u16_t *upper, u16_t *end)
+{
+  u8_t mib_idx;
+  u16_t lo, hi;
+
+  if (snmp_mib_index_state == SNMP_MIB_INDEX_INVALID) {
+    snmp_mib_index_build();
+  }
+  if (snmp_mib_index_state != SNMP_MIB_INDEX_VALID) {
+    return 0;
+  }
+
+  for (mib_idx = 0; mib_idx < snmp_num_mibs; mib_idx++) {
+    if (snmp_mibs[mib_idx] == mib) {
+      break;
+    }
+  }
+  if (mib_idx == snmp_num_mibs) {
+    return 0;
+  }
+
+  /* entries of this MIB */
+  lo = 0;
+  hi = snmp_mib_index_len;
+  while (lo < hi) {
+    u16_t mid = (u16_t)((lo + hi) / 2);
+    if (snmp_mib_index[mid].mib_idx < mib_idx) {
+      lo = (u16_t)(mid + 1);
+    } else {
+      hi = mid;
+    }
+  }
+  *first = lo;
+  hi = snmp_mib_index_len;
+  while (lo < hi) {
+    u16_t mid = (u16_t)((lo + hi) / 2);
+    if (snmp_mib_index[mid].mib_idx <= mib_idx) {
+      lo = (u16_t)(mid + 1);
+    } else {
+      hi = mid;
+    }
+  }
+  *end = lo;
+
+  /* first entry greater than oid */
+  oid     += mib->base_oid_len;
+  oid_len -= mib->base_oid_len;
+  lo = *first;
+  hi = *end;
+  while (lo < hi) {
+    u16_t mid = (u16_t)((lo + hi) / 2);
+    if (snmp_oid_compare(snmp_mib_index[mid].oid, snmp_mib_index[mid].oid_len, oid, oid_len) <= 0) {
+      lo = (u16_t)(mid + 1);
+    } else {
+      hi = mid;
+    }
+  }
+  *upper = lo;
+
+  return 1;
+}
+#endif /* SNMP_LWIP_MIB_INDEX_SIZE > 0 */
+
+/**
+ * Searches the MIB for the leaf node referenced by the supplied object identifier.
+ * @param mib MIB containing the OID (OID starts with MIB base OID)
+ * @param oid OID to resolve
+ * @param oid_len length of oid
+ * @param oid_instance_len returns the length of the instance part of oid
+ * @return the leaf node or NULL if oid does not reference a leaf node
+ */
+const struct snmp_node *
+snmp_mib_tree_resolve_exact(const struct snmp_mib *mib, const u32_t *oid, u8_t oid_len, u8_t *oid_instance_len)
+{
+#if SNMP_LWIP_MIB_INDEX_SIZE > 0
+  u16_t first, upper, end;
+
+  if (snmp_mib_index_upper_bound(mib, oid, oid_len, &first, &upper, &end)) {
+    /* the leaf node containing oid is the last entry not greater than oid */
+    if (upper > first) {
+      const struct snmp_mib_index_entry *entry = &snmp_mib_index[upper - 1];
+      u8_t len = (u8_t)(oid_len - mib->base_oid_len);
+
+      if ((entry->oid_len <= len) &&
+          snmp_oid_equal(entry->oid, entry->oid_len, oid + mib->base_oid_len, entry->oid_len)) {
+        *oid_instance_len = (u8_t)(len - entry->oid_len);
+        return entry->node;
+      }
+    }
+    return NULL;
+  }
+#endif /* SNMP_LWIP_MIB_INDEX_SIZE > 0 */
+
+  return snmp_mib_tree_walk_exact(mib, oid, oid_len, oid_instance_len);
+}
+
+/**
+ * Searches the MIB for the first leaf node following the supplied object identifier.
+ * @param mib MIB to search (OID starts with MIB base OID)
+ * @param oid OID to start at
+ * @param oid_len length of oid
+ * @param oidret returns the OID of the leaf node found
+ * @return the leaf node or NULL if there is no further leaf node in the MIB
+ */
+const struct snmp_node *
+snmp_mib_tree_resolve_next(const struct snmp_mib *mib, const u32_t *oid, u8_t oid_len, struct snmp_obj_id *oidret)
+{
+#if SNMP_LWIP_MIB_INDEX_SIZE > 0
+  u16_t first, upper, end;
+
+  if (snmp_mib_index_upper_bound(mib, oid, oid_len, &first, &upper, &end)) {
+    if (upper < end) {
+      const struct snmp_mib_index_entry *entry = &snmp_mib_index[upper];
+
+      snmp_oid_assign(oidret, mib->base_oid, mib->base_oid_len);
+      snmp_oid_append(oidret, entry->oid, entry->oid_len);
+      return entry->node;
+    }
+    return NULL;
+  }
+#endif /* SNMP_LWIP_MIB_INDEX_SIZE > 0 */
+
+  return snmp_mib_tree_walk_next(mib, oid, oid_len, oidret);
+}
+
 /** initialize struct next_oid_state using this function before passing it to next_oid_check */
 void
 snmp_next_oid_init(struct snmp_next_oid_state *state,
@@ -1171,6 +1410,113 @@ snmp_next_oid_check(struct snmp_next_oid_state *state, const u32_t *oid, u8_t oi
   return 0;
 }
 
+/**
+ * Prepares a row index for use with the rows described by 'generation' (a counter the
+ * rows' owner changes whenever rows are added, removed or change their OID).
+ * @return 1 if the index has been reset and all rows have to be added with
+ *         snmp_row_index_add(), 0 if the index is up to date
+ */
+u8_t
+snmp_row_index_update(struct snmp_row_index *index, u32_t generation)
+{
+  if ((index->state != SNMP_ROW_INDEX_EMPTY) && (index->generation == generation)) {
+    return 0;
+  }
+
+  index->generation = generation;
+  index->num_rows   = 0;
+  index->state      = SNMP_ROW_INDEX_VALID;
+  return 1;
+}
+
+/** adds a row to a row index (keeping rows in OID order); returns 0 if the index is full and can not be used */
+u8_t
+snmp_row_index_add(struct snmp_row_index *index, const void *row)
+{
+  u32_t row_oid[SNMP_MAX_OBJ_ID_LEN];
+  u32_t test_oid[SNMP_MAX_OBJ_ID_LEN];
+  u8_t row_oid_len;
+  u16_t lo, hi;
+
+  if (index->state != SNMP_ROW_INDEX_VALID) {
+    return 0;
+  }
+
+  row_oid_len = index->row_oid(row, row_oid);
+  if (row_oid_len == 0) {
+    /* row is not part of this table */
+    return 1;
+  }
+
+  if (index->num_rows >= index->max_rows) {
+    index->state = SNMP_ROW_INDEX_OVERFLOW;
+    return 0;
+  }
+
+  /* insert behind rows with equal OID, so the first added row wins (as with snmp_next_oid_check()) */
+  lo = 0;
+  hi = index->num_rows;
+  while (lo < hi) {
+    u16_t mid = (u16_t)((lo + hi) / 2);
+    u8_t test_oid_len = index->row_oid(index->rows[mid], test_oid);
+
+    if (snmp_oid_compare(test_oid, test_oid_len, row_oid, row_oid_len) <= 0) {
+      lo = (u16_t)(mid + 1);
+    } else {
+      hi = mid;
+    }
+  }
+
+  if (lo < index->num_rows) {
+    MEMMOVE(&index->rows[lo + 1], &index->rows[lo], (index->num_rows - lo) * sizeof(index->rows[0]));
+  }
+  index->rows[lo] = row;
+  index->num_rows++;
+
+  return 1;
+}
+
+/**
+ * Searches the row following 'row_oid' in a row index (get_next).
+ * @param index row index
+ * @param row_oid start OID, replaced by the OID of the row found
+ * @param row returns the row found or NULL if there is no further row
+ * @return 0 if the index can not be used (rows have to be checked with snmp_next_oid_check()), 1 otherwise
+ */
+u8_t
+snmp_row_index_next(const struct snmp_row_index *index, struct snmp_obj_id *row_oid, const void **row)
+{
+  u32_t test_oid[SNMP_MAX_OBJ_ID_LEN];
+  u16_t lo, hi;
+
+  if (index->state != SNMP_ROW_INDEX_VALID) {
+    return 0;
+  }
+
+  /* first row greater than row_oid */
+  lo = 0;
+  hi = index->num_rows;
+  while (lo < hi) {
+    u16_t mid = (u16_t)((lo + hi) / 2);
+    u8_t test_oid_len = index->row_oid(index->rows[mid], test_oid);
+
+    if (snmp_oid_compare(test_oid, test_oid_len, row_oid->id, row_oid->len) <= 0) {
+      lo = (u16_t)(mid + 1);
+    } else {
+      hi = mid;
+    }
+  }
+
+  if (lo < index->num_rows) {
+    *row = index->rows[lo];
+    row_oid->len = index->row_oid(*row, row_oid->id);
+  } else {
+    *row = NULL;
+  }
+
+  return 1;
+}
+
 u8_t
 snmp_oid_in_range(const u32_t *oid_in, u8_t oid_len, const struct snmp_oid_range *oid_ranges, u8_t oid_ranges_len)
 {
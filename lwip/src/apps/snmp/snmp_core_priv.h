@@ -71,8 +71,20 @@ const struct snmp_node *snmp_mib_tree_resolve_next(const struct snmp_mib *mib, c
 
 typedef u8_t (*snmp_validate_node_instance_method)(struct snmp_node_instance *, void *);
 
+/** Resolution cursor: MIB node of the last result of snmp_get_next_node_instance_from_oid().
+ * A lookup continuing from that result OID starts at this node instead of resolving the OID from the MIB root. */
+struct snmp_next_cursor
+{
+  const struct snmp_mib *mib;
+  const struct snmp_node *node;
+  /** Length of the node OID (result OID without instance part) */
+  u8_t node_oid_len;
+  /** Node OID below the MIB base OID */
+  u32_t node_subids[SNMP_LWIP_MIB_INDEX_DEPTH];
+};
+
 u8_t snmp_get_node_instance_from_oid(const u32_t *oid, u8_t oid_len, struct snmp_node_instance *node_instance);
-u8_t snmp_get_next_node_instance_from_oid(const u32_t *oid, u8_t oid_len, snmp_validate_node_instance_method validate_node_instance_method, void *validate_node_instance_arg, struct snmp_obj_id *node_oid, struct snmp_node_instance *node_instance);
+u8_t snmp_get_next_node_instance_from_oid(const u32_t *oid, u8_t oid_len, snmp_validate_node_instance_method validate_node_instance_method, void *validate_node_instance_arg, struct snmp_obj_id *node_oid, struct snmp_node_instance *node_instance, struct snmp_next_cursor *cursor);
 
 #ifdef __cplusplus
 }
@@ -252,6 +252,39 @@ tcp_ConnTable_get_cell_value(const u32_t *column, const u32_t *row_oid, u8_t row
   return SNMP_ERR_NOSUCHINSTANCE;
 }
 
+/* row OID: tcpConnLocalAddress + tcpConnLocalPort + tcpConnRemAddress + tcpConnRemPort */
+static u8_t
+tcp_ConnTable_row_oid(const void *row, u32_t *oid)
+{
+  const struct tcp_pcb *pcb = (const struct tcp_pcb *)row;
+
+  if (!IP_IS_V4_VAL(pcb->local_ip)) {
+    return 0;
+  }
+
+  snmp_ip4_to_oid(ip_2_ip4(&pcb->local_ip), &oid[0]);
+  oid[4] = pcb->local_port;
+
+  /* PCBs in state LISTEN are not connected and have no remote_ip or remote_port */
+  if (pcb->state == LISTEN) {
+    snmp_ip4_to_oid(IP4_ADDR_ANY4, &oid[5]);
+    oid[9] = 0;
+  } else {
+    if (IP_IS_V6_VAL(pcb->remote_ip)) { /* should never happen */
+      return 0;
+    }
+    snmp_ip4_to_oid(ip_2_ip4(&pcb->remote_ip), &oid[5]);
+    oid[9] = pcb->remote_port;
+  }
+
+  return LWIP_ARRAYSIZE(tcp_ConnTable_oid_ranges);
+}
+
+#if SNMP_LWIP_MIB2_TABLE_INDEX_SIZE > 0
+static const void *tcp_ConnTable_rows[SNMP_LWIP_MIB2_TABLE_INDEX_SIZE];
+static struct snmp_row_index tcp_ConnTable_index = SNMP_ROW_INDEX_CREATE(tcp_ConnTable_rows, tcp_ConnTable_row_oid);
+#endif /* SNMP_LWIP_MIB2_TABLE_INDEX_SIZE > 0 */
+
 static snmp_err_t
 tcp_ConnTable_get_next_cell_instance_and_value(const u32_t *column, struct snmp_obj_id *row_oid, union snmp_variant_value *value, u32_t *value_len)
 {
@@ -259,6 +292,23 @@ tcp_ConnTable_get_next_cell_instance_and_value(const u32_t *column, struct snmp_
   struct tcp_pcb *pcb;
   struct snmp_next_oid_state state;
   u32_t result_temp[LWIP_ARRAYSIZE(tcp_ConnTable_oid_ranges)];
+#if SNMP_LWIP_MIB2_TABLE_INDEX_SIZE > 0
+  const void *row;
+
+  if (snmp_row_index_update(&tcp_ConnTable_index, tcp_pcb_lists_generation)) {
+    for (i = 0; i < LWIP_ARRAYSIZE(tcp_pcb_lists); i++) {
+      for (pcb = *tcp_pcb_lists[i]; pcb != NULL; pcb = pcb->next) {
+        snmp_row_index_add(&tcp_ConnTable_index, pcb);
+      }
+    }
+  }
+  if (snmp_row_index_next(&tcp_ConnTable_index, row_oid, &row)) {
+    if (row == NULL) {
+      return SNMP_ERR_NOSUCHINSTANCE;
+    }
+    return tcp_ConnTable_get_cell_value_core(LWIP_CONST_CAST(struct tcp_pcb *, row), column, value, value_len);
+  }
+#endif /* SNMP_LWIP_MIB2_TABLE_INDEX_SIZE > 0 */
 
   /* init struct to search next oid */
   snmp_next_oid_init(&state, row_oid->id, row_oid->len, result_temp, LWIP_ARRAYSIZE(tcp_ConnTable_oid_ranges));
@@ -268,25 +318,11 @@ tcp_ConnTable_get_next_cell_instance_and_value(const u32_t *column, struct snmp_
     pcb = *tcp_pcb_lists[i];
     while (pcb != NULL) {
       u32_t test_oid[LWIP_ARRAYSIZE(tcp_ConnTable_oid_ranges)];
+      u8_t test_oid_len = tcp_ConnTable_row_oid(pcb, test_oid);
 
-      if (IP_IS_V4_VAL(pcb->local_ip)) {
-        snmp_ip4_to_oid(ip_2_ip4(&pcb->local_ip), &test_oid[0]);
-        test_oid[4] = pcb->local_port;
-
-        /* PCBs in state LISTEN are not connected and have no remote_ip or remote_port */
-        if (pcb->state == LISTEN) {
-          snmp_ip4_to_oid(IP4_ADDR_ANY4, &test_oid[5]);
-          test_oid[9] = 0;
-        } else {
-          if (IP_IS_V6_VAL(pcb->remote_ip)) { /* should never happen */
-            continue;
-          }
-          snmp_ip4_to_oid(ip_2_ip4(&pcb->remote_ip), &test_oid[5]);
-          test_oid[9] = pcb->remote_port;
-        }
-
+      if (test_oid_len > 0) {
         /* check generated OID: is it a candidate for the next one? */
-        snmp_next_oid_check(&state, test_oid, LWIP_ARRAYSIZE(tcp_ConnTable_oid_ranges), pcb);
+        snmp_next_oid_check(&state, test_oid, test_oid_len, pcb);
       }
 
       pcb = pcb->next;
@@ -370,6 +406,25 @@ tcp_ConnectionTable_get_cell_value(const u32_t *column, const u32_t *row_oid, u8
   return SNMP_ERR_NOSUCHINSTANCE;
 }
 
+/* row OID: tcpConnectionLocalAddressType + tcpConnectionLocalAddress + tcpConnectionLocalPort +
+ *          tcpConnectionRemAddressType + tcpConnectionRemAddress + tcpConnectionRemPort */
+static u8_t
+tcp_ConnectionTable_row_oid(const void *row, u32_t *oid)
+{
+  const struct tcp_pcb *pcb = (const struct tcp_pcb *)row;
+  u8_t idx = 0;
+
+  idx += snmp_ip_port_to_oid(&pcb->local_ip, pcb->local_port, &oid[idx]);
+  idx += snmp_ip_port_to_oid(&pcb->remote_ip, pcb->remote_port, &oid[idx]);
+
+  return idx;
+}
+
+#if SNMP_LWIP_MIB2_TABLE_INDEX_SIZE > 0
+static const void *tcp_ConnectionTable_rows[SNMP_LWIP_MIB2_TABLE_INDEX_SIZE];
+static struct snmp_row_index tcp_ConnectionTable_index = SNMP_ROW_INDEX_CREATE(tcp_ConnectionTable_rows, tcp_ConnectionTable_row_oid);
+#endif /* SNMP_LWIP_MIB2_TABLE_INDEX_SIZE > 0 */
+
 static snmp_err_t
 tcp_ConnectionTable_get_next_cell_instance_and_value(const u32_t *column, struct snmp_obj_id *row_oid, union snmp_variant_value *value, u32_t *value_len)
 {
@@ -380,9 +435,28 @@ tcp_ConnectionTable_get_next_cell_instance_and_value(const u32_t *column, struct
   u32_t  result_temp[38];
   u8_t i;
   struct tcp_pcb **const tcp_pcb_nonlisten_lists[] = {&tcp_bound_pcbs, &tcp_active_pcbs, &tcp_tw_pcbs};
+#if SNMP_LWIP_MIB2_TABLE_INDEX_SIZE > 0
+  const void *row;
+#endif /* SNMP_LWIP_MIB2_TABLE_INDEX_SIZE > 0 */
 
   LWIP_UNUSED_ARG(value_len);
 
+#if SNMP_LWIP_MIB2_TABLE_INDEX_SIZE > 0
+  if (snmp_row_index_update(&tcp_ConnectionTable_index, tcp_pcb_lists_generation)) {
+    for (i = 0; i < LWIP_ARRAYSIZE(tcp_pcb_nonlisten_lists); i++) {
+      for (pcb = *tcp_pcb_nonlisten_lists[i]; pcb != NULL; pcb = pcb->next) {
+        snmp_row_index_add(&tcp_ConnectionTable_index, pcb);
+      }
+    }
+  }
+  if (snmp_row_index_next(&tcp_ConnectionTable_index, row_oid, &row)) {
+    if (row == NULL) {
+      return SNMP_ERR_NOSUCHINSTANCE;
+    }
+    return tcp_ConnectionTable_get_cell_value_core(column, LWIP_CONST_CAST(struct tcp_pcb *, row), value);
+  }
+#endif /* SNMP_LWIP_MIB2_TABLE_INDEX_SIZE > 0 */
+
   /* init struct to search next oid */
   snmp_next_oid_init(&state, row_oid->id, row_oid->len, result_temp, LWIP_ARRAYSIZE(result_temp));
 
@@ -391,17 +465,11 @@ tcp_ConnectionTable_get_next_cell_instance_and_value(const u32_t *column, struct
     pcb = *tcp_pcb_nonlisten_lists[i];
 
     while (pcb != NULL) {
-      u8_t idx = 0;
       u32_t test_oid[LWIP_ARRAYSIZE(result_temp)];
-
-      /* tcpConnectionLocalAddressType + tcpConnectionLocalAddress + tcpConnectionLocalPort */
-      idx += snmp_ip_port_to_oid(&pcb->local_ip, pcb->local_port, &test_oid[idx]);
-
-      /* tcpConnectionRemAddressType + tcpConnectionRemAddress + tcpConnectionRemPort */
-      idx += snmp_ip_port_to_oid(&pcb->remote_ip, pcb->remote_port, &test_oid[idx]);
+      u8_t test_oid_len = tcp_ConnectionTable_row_oid(pcb, test_oid);
 
       /* check generated OID: is it a candidate for the next one? */
-      snmp_next_oid_check(&state, test_oid, idx, pcb);
+      snmp_next_oid_check(&state, test_oid, test_oid_len, pcb);
 
       pcb = pcb->next;
     }
@@ -466,6 +534,20 @@ tcp_ListenerTable_get_cell_value(const u32_t *column, const u32_t *row_oid, u8_t
   return SNMP_ERR_NOSUCHINSTANCE;
 }
 
+/* row OID: tcpListenerLocalAddressType + tcpListenerLocalAddress + tcpListenerLocalPort */
+static u8_t
+tcp_ListenerTable_row_oid(const void *row, u32_t *oid)
+{
+  const struct tcp_pcb_listen *pcb = (const struct tcp_pcb_listen *)row;
+
+  return snmp_ip_port_to_oid(&pcb->local_ip, pcb->local_port, oid);
+}
+
+#if SNMP_LWIP_MIB2_TABLE_INDEX_SIZE > 0
+static const void *tcp_ListenerTable_rows[SNMP_LWIP_MIB2_TABLE_INDEX_SIZE];
+static struct snmp_row_index tcp_ListenerTable_index = SNMP_ROW_INDEX_CREATE(tcp_ListenerTable_rows, tcp_ListenerTable_row_oid);
+#endif /* SNMP_LWIP_MIB2_TABLE_INDEX_SIZE > 0 */
+
 static snmp_err_t
 tcp_ListenerTable_get_next_cell_instance_and_value(const u32_t *column, struct snmp_obj_id *row_oid, union snmp_variant_value *value, u32_t *value_len)
 {
@@ -473,23 +555,37 @@ tcp_ListenerTable_get_next_cell_instance_and_value(const u32_t *column, struct s
   struct snmp_next_oid_state state;
   /* 1x tcpListenerLocalAddressType + 1x OID len + 16x tcpListenerLocalAddress  + 1x tcpListenerLocalPort */
   u32_t  result_temp[19];
+#if SNMP_LWIP_MIB2_TABLE_INDEX_SIZE > 0
+  const void *row;
+#endif /* SNMP_LWIP_MIB2_TABLE_INDEX_SIZE > 0 */
 
   LWIP_UNUSED_ARG(value_len);
 
+#if SNMP_LWIP_MIB2_TABLE_INDEX_SIZE > 0
+  if (snmp_row_index_update(&tcp_ListenerTable_index, tcp_pcb_lists_generation)) {
+    for (pcb = tcp_listen_pcbs.listen_pcbs; pcb != NULL; pcb = pcb->next) {
+      snmp_row_index_add(&tcp_ListenerTable_index, pcb);
+    }
+  }
+  if (snmp_row_index_next(&tcp_ListenerTable_index, row_oid, &row)) {
+    if (row == NULL) {
+      return SNMP_ERR_NOSUCHINSTANCE;
+    }
+    return tcp_ListenerTable_get_cell_value_core(column, value);
+  }
+#endif /* SNMP_LWIP_MIB2_TABLE_INDEX_SIZE > 0 */
+
   /* init struct to search next oid */
   snmp_next_oid_init(&state, row_oid->id, row_oid->len, result_temp, LWIP_ARRAYSIZE(result_temp));
 
   /* iterate over all possible OIDs to find the next one */
   pcb = tcp_listen_pcbs.listen_pcbs;
   while (pcb != NULL) {
-    u8_t idx = 0;
     u32_t test_oid[LWIP_ARRAYSIZE(result_temp)];
-
-    /* tcpListenerLocalAddressType + tcpListenerLocalAddress + tcpListenerLocalPort */
-    idx += snmp_ip_port_to_oid(&pcb->local_ip, pcb->local_port, &test_oid[idx]);
+    u8_t test_oid_len = tcp_ListenerTable_row_oid(pcb, test_oid);
 
     /* check generated OID: is it a candidate for the next one? */
-    snmp_next_oid_check(&state, test_oid, idx, NULL);
+    snmp_next_oid_check(&state, test_oid, test_oid_len, NULL);
 
     pcb = pcb->next;
   }
@@ -161,6 +161,28 @@ udp_endpointTable_get_cell_value(const u32_t *column, const u32_t *row_oid, u8_t
   return SNMP_ERR_NOSUCHINSTANCE;
 }
 
+/* row OID: udpEndpointLocalAddressType + udpEndpointLocalAddress + udpEndpointLocalPort +
+ *          udpEndpointRemoteAddressType + udpEndpointRemoteAddress + udpEndpointRemotePort + udpEndpointInstance */
+static u8_t
+udp_endpointTable_row_oid(const void *row, u32_t *oid)
+{
+  const struct udp_pcb *pcb = (const struct udp_pcb *)row;
+  u8_t idx = 0;
+
+  idx += snmp_ip_port_to_oid(&pcb->local_ip, pcb->local_port, &oid[idx]);
+  idx += snmp_ip_port_to_oid(&pcb->remote_ip, pcb->remote_port, &oid[idx]);
+
+  oid[idx] = 0; /* udpEndpointInstance */
+  idx++;
+
+  return idx;
+}
+
+#if SNMP_LWIP_MIB2_TABLE_INDEX_SIZE > 0
+static const void *udp_endpointTable_rows[SNMP_LWIP_MIB2_TABLE_INDEX_SIZE];
+static struct snmp_row_index udp_endpointTable_index = SNMP_ROW_INDEX_CREATE(udp_endpointTable_rows, udp_endpointTable_row_oid);
+#endif /* SNMP_LWIP_MIB2_TABLE_INDEX_SIZE > 0 */
+
 static snmp_err_t
 udp_endpointTable_get_next_cell_instance_and_value(const u32_t *column, struct snmp_obj_id *row_oid, union snmp_variant_value *value, u32_t *value_len)
 {
@@ -171,9 +193,26 @@ udp_endpointTable_get_next_cell_instance_and_value(const u32_t *column, struct s
    * 1x udpEndpointInstance = 39
    */
   u32_t  result_temp[39];
+#if SNMP_LWIP_MIB2_TABLE_INDEX_SIZE > 0
+  const void *row;
+#endif /* SNMP_LWIP_MIB2_TABLE_INDEX_SIZE > 0 */
 
   LWIP_UNUSED_ARG(value_len);
 
+#if SNMP_LWIP_MIB2_TABLE_INDEX_SIZE > 0
+  if (snmp_row_index_update(&udp_endpointTable_index, udp_pcbs_generation)) {
+    for (pcb = udp_pcbs; pcb != NULL; pcb = pcb->next) {
+      snmp_row_index_add(&udp_endpointTable_index, pcb);
+    }
+  }
+  if (snmp_row_index_next(&udp_endpointTable_index, row_oid, &row)) {
+    if (row == NULL) {
+      return SNMP_ERR_NOSUCHINSTANCE;
+    }
+    return udp_endpointTable_get_cell_value_core(column, value);
+  }
+#endif /* SNMP_LWIP_MIB2_TABLE_INDEX_SIZE > 0 */
+
   /* init struct to search next oid */
   snmp_next_oid_init(&state, row_oid->id, row_oid->len, result_temp, LWIP_ARRAYSIZE(result_temp));
 
@@ -181,19 +220,10 @@ udp_endpointTable_get_next_cell_instance_and_value(const u32_t *column, struct s
   pcb = udp_pcbs;
   while (pcb != NULL) {
     u32_t test_oid[LWIP_ARRAYSIZE(result_temp)];
-    u8_t idx = 0;
-
-    /* udpEndpointLocalAddressType + udpEndpointLocalAddress + udpEndpointLocalPort */
-    idx += snmp_ip_port_to_oid(&pcb->local_ip, pcb->local_port, &test_oid[idx]);
-
-    /* udpEndpointRemoteAddressType + udpEndpointRemoteAddress + udpEndpointRemotePort */
-    idx += snmp_ip_port_to_oid(&pcb->remote_ip, pcb->remote_port, &test_oid[idx]);
-
-    test_oid[idx] = 0; /* udpEndpointInstance */
-    idx++;
+    u8_t test_oid_len = udp_endpointTable_row_oid(pcb, test_oid);
 
     /* check generated OID: is it a candidate for the next one? */
-    snmp_next_oid_check(&state, test_oid, idx, NULL);
+    snmp_next_oid_check(&state, test_oid, test_oid_len, NULL);
 
     pcb = pcb->next;
   }
@@ -275,12 +305,48 @@ udp_Table_get_cell_value(const u32_t *column, const u32_t *row_oid, u8_t row_oid
   return SNMP_ERR_NOSUCHINSTANCE;
 }
 
+/* row OID: udpLocalAddress + udpLocalPort */
+static u8_t
+udp_Table_row_oid(const void *row, u32_t *oid)
+{
+  const struct udp_pcb *pcb = (const struct udp_pcb *)row;
+
+  if (!IP_IS_V4_VAL(pcb->local_ip)) {
+    return 0;
+  }
+
+  snmp_ip4_to_oid(ip_2_ip4(&pcb->local_ip), &oid[0]);
+  oid[4] = pcb->local_port;
+
+  return LWIP_ARRAYSIZE(udp_Table_oid_ranges);
+}
+
+#if SNMP_LWIP_MIB2_TABLE_INDEX_SIZE > 0
+static const void *udp_Table_rows[SNMP_LWIP_MIB2_TABLE_INDEX_SIZE];
+static struct snmp_row_index udp_Table_index = SNMP_ROW_INDEX_CREATE(udp_Table_rows, udp_Table_row_oid);
+#endif /* SNMP_LWIP_MIB2_TABLE_INDEX_SIZE > 0 */
+
 static snmp_err_t
 udp_Table_get_next_cell_instance_and_value(const u32_t *column, struct snmp_obj_id *row_oid, union snmp_variant_value *value, u32_t *value_len)
 {
   struct udp_pcb *pcb;
   struct snmp_next_oid_state state;
   u32_t  result_temp[LWIP_ARRAYSIZE(udp_Table_oid_ranges)];
+#if SNMP_LWIP_MIB2_TABLE_INDEX_SIZE > 0
+  const void *row;
+
+  if (snmp_row_index_update(&udp_Table_index, udp_pcbs_generation)) {
+    for (pcb = udp_pcbs; pcb != NULL; pcb = pcb->next) {
+      snmp_row_index_add(&udp_Table_index, pcb);
+    }
+  }
+  if (snmp_row_index_next(&udp_Table_index, row_oid, &row)) {
+    if (row == NULL) {
+      return SNMP_ERR_NOSUCHINSTANCE;
+    }
+    return udp_Table_get_cell_value_core(LWIP_CONST_CAST(struct udp_pcb *, row), column, value, value_len);
+  }
+#endif /* SNMP_LWIP_MIB2_TABLE_INDEX_SIZE > 0 */
 
   /* init struct to search next oid */
   snmp_next_oid_init(&state, row_oid->id, row_oid->len, result_temp, LWIP_ARRAYSIZE(udp_Table_oid_ranges));
@@ -289,13 +355,11 @@ udp_Table_get_next_cell_instance_and_value(const u32_t *column, struct snmp_obj_
   pcb = udp_pcbs;
   while (pcb != NULL) {
     u32_t test_oid[LWIP_ARRAYSIZE(udp_Table_oid_ranges)];
+    u8_t test_oid_len = udp_Table_row_oid(pcb, test_oid);
 
-    if (IP_IS_V4_VAL(pcb->local_ip)) {
-      snmp_ip4_to_oid(ip_2_ip4(&pcb->local_ip), &test_oid[0]);
-      test_oid[4] = pcb->local_port;
-
+    if (test_oid_len > 0) {
       /* check generated OID: is it a candidate for the next one? */
-      snmp_next_oid_check(&state, test_oid, LWIP_ARRAYSIZE(udp_Table_oid_ranges), pcb);
+      snmp_next_oid_check(&state, test_oid, test_oid_len, pcb);
     }
 
     pcb = pcb->next;
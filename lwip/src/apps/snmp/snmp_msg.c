@@ -318,7 +318,9 @@ snmp_receive(void *handle, struct pbuf *p, const ip_addr_t *source_ip, u16_t por
         } else if (request.request_type == SNMP_ASN1_CONTEXT_PDU_GET_NEXT_REQ) {
           err = snmp_process_getnext_request(&request);
         } else if (request.request_type == SNMP_ASN1_CONTEXT_PDU_GET_BULK_REQ) {
+          PERF_START;
           err = snmp_process_getbulk_request(&request);
+          PERF_STOP("snmp_getbulk");
         } else if (request.request_type == SNMP_ASN1_CONTEXT_PDU_SET_REQ) {
           err = snmp_process_set_request(&request);
         }
@@ -424,7 +426,7 @@ snmp_msg_getnext_validate_node_inst(struct snmp_node_instance *node_instance, vo
 }
 
 static void
-snmp_process_varbind(struct snmp_request *request, struct snmp_varbind *vb, u8_t get_next)
+snmp_process_varbind(struct snmp_request *request, struct snmp_varbind *vb, u8_t get_next, struct snmp_next_cursor *cursor)
 {
   err_t err;
   struct snmp_node_instance node_instance;
@@ -432,7 +434,7 @@ snmp_process_varbind(struct snmp_request *request, struct snmp_varbind *vb, u8_t
 
   if (get_next) {
     struct snmp_obj_id result_oid;
-    request->error_status = snmp_get_next_node_instance_from_oid(vb->oid.id, vb->oid.len, snmp_msg_getnext_validate_node_inst, request,  &result_oid, &node_instance);
+    request->error_status = snmp_get_next_node_instance_from_oid(vb->oid.id, vb->oid.len, snmp_msg_getnext_validate_node_inst, request,  &result_oid, &node_instance, cursor);
 
     if (request->error_status == SNMP_ERR_NOERROR) {
       snmp_oid_assign(&vb->oid, result_oid.id, result_oid.len);
@@ -517,7 +519,7 @@ snmp_process_get_request(struct snmp_request *request)
     err = snmp_vb_enumerator_get_next(&request->inbound_varbind_enumerator, &vb);
     if (err == SNMP_VB_ENUMERATOR_ERR_OK) {
       if ((vb.type == SNMP_ASN1_TYPE_NULL) && (vb.value_len == 0)) {
-        snmp_process_varbind(request, &vb, 0);
+        snmp_process_varbind(request, &vb, 0, NULL);
       } else {
         request->error_status = SNMP_ERR_GENERROR;
       }
@@ -553,7 +555,7 @@ snmp_process_getnext_request(struct snmp_request *request)
     err = snmp_vb_enumerator_get_next(&request->inbound_varbind_enumerator, &vb);
     if (err == SNMP_VB_ENUMERATOR_ERR_OK) {
       if ((vb.type == SNMP_ASN1_TYPE_NULL) && (vb.value_len == 0)) {
-        snmp_process_varbind(request, &vb, 1);
+        snmp_process_varbind(request, &vb, 1, NULL);
       } else {
         request->error_status = SNMP_ERR_GENERROR;
       }
@@ -585,6 +587,12 @@ snmp_process_getbulk_request(struct snmp_request *request)
   u16_t repetition_offset = 0;
   struct snmp_varbind_enumerator repetition_varbind_enumerator;
   struct snmp_varbind vb;
+#if SNMP_LWIP_GETBULK_CURSORS > 0
+  /* resolution cursors of the first repeaters, repetitions continue at the node of the previous result */
+  struct snmp_next_cursor cursors[SNMP_LWIP_GETBULK_CURSORS];
+
+  memset(cursors, 0, sizeof(cursors));
+#endif /* SNMP_LWIP_GETBULK_CURSORS > 0 */
   vb.value = request->value_buffer;
 
   if (SNMP_LWIP_GETBULK_MAX_REPETITIONS > 0) {
@@ -617,7 +625,15 @@ snmp_process_getbulk_request(struct snmp_request *request)
     } else if ((err != SNMP_VB_ENUMERATOR_ERR_OK) || (vb.type != SNMP_ASN1_TYPE_NULL) || (vb.value_len != 0)) {
       request->error_status = SNMP_ERR_GENERROR;
     } else {
-      snmp_process_varbind(request, &vb, 1);
+#if SNMP_LWIP_GETBULK_CURSORS > 0
+      /* non_repeaters counts down below 0 for the repeaters */
+      if ((non_repeaters <= 0) && (-non_repeaters < SNMP_LWIP_GETBULK_CURSORS)) {
+        snmp_process_varbind(request, &vb, 1, &cursors[-non_repeaters]);
+      } else
+#endif /* SNMP_LWIP_GETBULK_CURSORS > 0 */
+      {
+        snmp_process_varbind(request, &vb, 1, NULL);
+      }
       non_repeaters--;
     }
   }
@@ -635,7 +651,14 @@ snmp_process_getbulk_request(struct snmp_request *request)
       err = snmp_vb_enumerator_get_next(&repetition_varbind_enumerator, &vb);
       if (err == SNMP_VB_ENUMERATOR_ERR_OK) {
         vb.value = request->value_buffer;
-        snmp_process_varbind(request, &vb, 1);
+#if SNMP_LWIP_GETBULK_CURSORS > 0
+        if (repetition_varbind_enumerator.varbind_count <= SNMP_LWIP_GETBULK_CURSORS) {
+          snmp_process_varbind(request, &vb, 1, &cursors[repetition_varbind_enumerator.varbind_count - 1]);
+        } else
+#endif /* SNMP_LWIP_GETBULK_CURSORS > 0 */
+        {
+          snmp_process_varbind(request, &vb, 1, NULL);
+        }
 
         if (request->error_status != SNMP_ERR_NOERROR) {
           /* already set correct error-index (here it cannot be taken from inbound varbind enumerator) */
@@ -50,6 +50,10 @@ void
 snmpv3_engine_id_changed(void)
 {
   snmpv3_set_engine_boots(0);
+#if LWIP_SNMP_V3_MBEDTLS
+  /* the keys of the cached crypto contexts were localized with the old engine ID */
+  snmpv3_crypto_ctx_clear();
+#endif
 }
 
 /** According to RFC3414 2.2.2.
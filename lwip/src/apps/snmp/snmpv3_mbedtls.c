@@ -47,17 +47,40 @@
 
 #include "mbedtls/md5.h"
 #include "mbedtls/sha1.h"
+#include "mbedtls/platform_util.h"
 
-err_t
-snmpv3_auth(struct snmp_pbuf_stream *stream, u16_t length,
-            const u8_t *key, snmpv3_auth_algo_t algo, u8_t *hmac_out)
+#define SNMPV3_CTX_CACHE_COUNT LWIP_MAX(LWIP_SNMP_V3_CRYPTO_CTX_CACHE_SIZE, 1)
+
+/** HMAC context, set up and started with one authentication key */
+struct snmpv3_auth_ctx {
+  /** NULL if unused */
+  const mbedtls_md_info_t *md_info;
+  u8_t key[SNMP_V3_SHA_LEN];
+  mbedtls_md_context_t ctx;
+};
+
+static struct snmpv3_auth_ctx snmpv3_auth_ctxs[SNMPV3_CTX_CACHE_COUNT];
+static u8_t snmpv3_auth_ctx_next;
+
+/** Free an HMAC context and wipe its key */
+static void
+snmpv3_auth_ctx_free(struct snmpv3_auth_ctx *entry)
 {
-  u32_t i;
+  mbedtls_md_free(&entry->ctx);
+  mbedtls_platform_zeroize(entry, sizeof(*entry));
+}
+
+/**
+ * Get an HMAC context for 'key', ready to process a new message.
+ * The HMAC key setup (inner and outer padded keys) is done once per key and cached.
+ */
+static struct snmpv3_auth_ctx *
+snmpv3_auth_ctx_get(const u8_t *key, snmpv3_auth_algo_t algo)
+{
+  u8_t i;
   u8_t key_len;
   const mbedtls_md_info_t *md_info;
-  mbedtls_md_context_t ctx;
-  struct snmp_pbuf_stream read_stream;
-  snmp_pbuf_stream_init(&read_stream, stream->pbuf, stream->offset, stream->length);
+  struct snmpv3_auth_ctx *entry;
 
   if (algo == SNMP_V3_AUTH_ALGO_MD5) {
     md_info = mbedtls_md_info_from_type(MBEDTLS_MD_MD5);
@@ -66,85 +89,216 @@ snmpv3_auth(struct snmp_pbuf_stream *stream, u16_t length,
     md_info = mbedtls_md_info_from_type(MBEDTLS_MD_SHA1);
     key_len = SNMP_V3_SHA_LEN;
   } else {
-    return ERR_ARG;
+    return NULL;
   }
 
-  mbedtls_md_init(&ctx);
-  if (mbedtls_md_setup(&ctx, md_info, 1) != 0) {
-    return ERR_ARG;
+  for (i = 0; i < SNMPV3_CTX_CACHE_COUNT; i++) {
+    entry = &snmpv3_auth_ctxs[i];
+    if ((entry->md_info == md_info) && (memcmp(entry->key, key, key_len) == 0)) {
+      if (mbedtls_md_hmac_reset(&entry->ctx) != 0) {
+        return NULL;
+      }
+      return entry;
+    }
+  }
+
+  /* not cached: replace the oldest entry */
+  entry = &snmpv3_auth_ctxs[snmpv3_auth_ctx_next];
+  snmpv3_auth_ctx_next = (u8_t)((snmpv3_auth_ctx_next + 1) % SNMPV3_CTX_CACHE_COUNT);
+  if (entry->md_info != NULL) {
+    snmpv3_auth_ctx_free(entry);
   }
 
-  if (mbedtls_md_hmac_starts(&ctx, key, key_len) != 0) {
-    goto free_md;
+  mbedtls_md_init(&entry->ctx);
+  if ((mbedtls_md_setup(&entry->ctx, md_info, 1) != 0) ||
+      (mbedtls_md_hmac_starts(&entry->ctx, key, key_len) != 0)) {
+    snmpv3_auth_ctx_free(entry);
+    return NULL;
   }
+  entry->md_info = md_info;
+  MEMCPY(entry->key, key, key_len);
+  return entry;
+}
 
-  for (i = 0; i < length; i++) {
-    u8_t byte;
+static void
+snmpv3_auth_ctx_release(struct snmpv3_auth_ctx *entry)
+{
+#if LWIP_SNMP_V3_CRYPTO_CTX_CACHE_SIZE == 0
+  snmpv3_auth_ctx_free(entry);
+#else
+  LWIP_UNUSED_ARG(entry);
+#endif
+}
 
-    if (snmp_pbuf_stream_read(&read_stream, &byte)) {
-      goto free_md;
-    }
+err_t
+snmpv3_auth(struct snmp_pbuf_stream *stream, u16_t length,
+            const u8_t *key, snmpv3_auth_algo_t algo, u8_t *hmac_out)
+{
+  struct pbuf *q;
+  u16_t q_offset;
+  struct snmpv3_auth_ctx *entry;
+
+  if (length > stream->length) {
+    return ERR_ARG;
+  }
 
-    if (mbedtls_md_hmac_update(&ctx, &byte, 1) != 0) {
-      goto free_md;
+  entry = snmpv3_auth_ctx_get(key, algo);
+  if (entry == NULL) {
+    return ERR_ARG;
+  }
+
+  /* hash the pbuf payloads directly */
+  for (q = pbuf_skip(stream->pbuf, stream->offset, &q_offset); length > 0; q = q->next) {
+    u16_t chunk;
+    if (q == NULL) {
+      goto error;
+    }
+    chunk = (u16_t)LWIP_MIN(length, q->len - q_offset);
+    if (mbedtls_md_hmac_update(&entry->ctx, (const u8_t *)q->payload + q_offset, chunk) != 0) {
+      goto error;
     }
+    length = (u16_t)(length - chunk);
+    q_offset = 0;
   }
 
-  if (mbedtls_md_hmac_finish(&ctx, hmac_out) != 0) {
-    goto free_md;
+  if (mbedtls_md_hmac_finish(&entry->ctx, hmac_out) != 0) {
+    goto error;
   }
 
-  mbedtls_md_free(&ctx);
+  snmpv3_auth_ctx_release(entry);
   return ERR_OK;
 
-free_md:
-  mbedtls_md_free(&ctx);
+error:
+  snmpv3_auth_ctx_release(entry);
   return ERR_ARG;
 }
 
 #if LWIP_SNMP_V3_CRYPTO
 
+/** Cipher context, set up with one privacy key for encryption or decryption */
+struct snmpv3_priv_ctx {
+  /** SNMP_V3_PRIV_ALGO_INVAL if unused */
+  snmpv3_priv_algo_t algo;
+  snmpv3_priv_mode_t mode;
+  u8_t key[16];
+  mbedtls_cipher_context_t ctx;
+};
+
+static struct snmpv3_priv_ctx snmpv3_priv_ctxs[SNMPV3_CTX_CACHE_COUNT];
+static u8_t snmpv3_priv_ctx_next;
+
+/** Free a cipher context and wipe its key */
+static void
+snmpv3_priv_ctx_free(struct snmpv3_priv_ctx *entry)
+{
+  mbedtls_cipher_free(&entry->ctx);
+  mbedtls_platform_zeroize(entry, sizeof(*entry));
+}
+
+/**
+ * Get a cipher context for 'key' and 'mode'.
+ * The key schedule is done once per key and cached, callers have to set the IV.
+ */
+static struct snmpv3_priv_ctx *
+snmpv3_priv_ctx_get(const u8_t *key, snmpv3_priv_algo_t algo, snmpv3_priv_mode_t mode)
+{
+  u8_t i;
+  u8_t key_len;
+  const mbedtls_cipher_info_t *cipher_info;
+  struct snmpv3_priv_ctx *entry;
+
+  if (algo == SNMP_V3_PRIV_ALGO_DES) {
+    cipher_info = mbedtls_cipher_info_from_type(MBEDTLS_CIPHER_DES_CBC);
+    key_len = 8;
+  } else if (algo == SNMP_V3_PRIV_ALGO_AES) {
+    cipher_info = mbedtls_cipher_info_from_type(MBEDTLS_CIPHER_AES_128_CFB128);
+    key_len = 16;
+  } else {
+    return NULL;
+  }
+
+  for (i = 0; i < SNMPV3_CTX_CACHE_COUNT; i++) {
+    entry = &snmpv3_priv_ctxs[i];
+    if ((entry->algo == algo) && (entry->mode == mode) && (memcmp(entry->key, key, key_len) == 0)) {
+      return entry;
+    }
+  }
+
+  /* not cached: replace the oldest entry */
+  entry = &snmpv3_priv_ctxs[snmpv3_priv_ctx_next];
+  snmpv3_priv_ctx_next = (u8_t)((snmpv3_priv_ctx_next + 1) % SNMPV3_CTX_CACHE_COUNT);
+  if (entry->algo != SNMP_V3_PRIV_ALGO_INVAL) {
+    snmpv3_priv_ctx_free(entry);
+  }
+
+  mbedtls_cipher_init(&entry->ctx);
+  if (mbedtls_cipher_setup(&entry->ctx, cipher_info) != 0) {
+    goto error;
+  }
+  /* RFC 3414 mandates padding for DES, done by the message encoder */
+  if ((algo == SNMP_V3_PRIV_ALGO_DES) &&
+      (mbedtls_cipher_set_padding_mode(&entry->ctx, MBEDTLS_PADDING_NONE) != 0)) {
+    goto error;
+  }
+  if (mbedtls_cipher_setkey(&entry->ctx, key, key_len * 8, (mode == SNMP_V3_PRIV_MODE_ENCRYPT) ? MBEDTLS_ENCRYPT : MBEDTLS_DECRYPT) != 0) {
+    goto error;
+  }
+  entry->algo = algo;
+  entry->mode = mode;
+  MEMCPY(entry->key, key, key_len);
+  return entry;
+
+error:
+  snmpv3_priv_ctx_free(entry);
+  return NULL;
+}
+
+static void
+snmpv3_priv_ctx_release(struct snmpv3_priv_ctx *entry)
+{
+#if LWIP_SNMP_V3_CRYPTO_CTX_CACHE_SIZE == 0
+  snmpv3_priv_ctx_free(entry);
+#else
+  LWIP_UNUSED_ARG(entry);
+#endif
+}
+
 err_t
 snmpv3_crypt(struct snmp_pbuf_stream *stream, u16_t length,
              const u8_t *key, const u8_t *priv_param, const u32_t engine_boots,
              const u32_t engine_time, snmpv3_priv_algo_t algo, snmpv3_priv_mode_t mode)
 {
   size_t i;
-  mbedtls_cipher_context_t ctx;
-  const mbedtls_cipher_info_t *cipher_info;
+  struct snmpv3_priv_ctx *entry;
+
+  if (length > stream->length) {
+    return ERR_ARG;
+  }
+  /* RFC 3414 mandates padding for DES */
+  if ((algo == SNMP_V3_PRIV_ALGO_DES) && ((length & 0x07) != 0)) {
+    return ERR_ARG;
+  }
 
-  struct snmp_pbuf_stream read_stream;
-  struct snmp_pbuf_stream write_stream;
-  snmp_pbuf_stream_init(&read_stream, stream->pbuf, stream->offset, stream->length);
-  snmp_pbuf_stream_init(&write_stream, stream->pbuf, stream->offset, stream->length);
-  mbedtls_cipher_init(&ctx);
+  entry = snmpv3_priv_ctx_get(key, algo, mode);
+  if (entry == NULL) {
+    return ERR_ARG;
+  }
 
   if (algo == SNMP_V3_PRIV_ALGO_DES) {
     u8_t iv_local[8];
     u8_t out_bytes[8];
     size_t out_len;
-
-    /* RFC 3414 mandates padding for DES */
-    if ((length & 0x07) != 0) {
-      return ERR_ARG;
-    }
-
-    cipher_info = mbedtls_cipher_info_from_type(MBEDTLS_CIPHER_DES_CBC);
-    if (mbedtls_cipher_setup(&ctx, cipher_info) != 0) {
-      return ERR_ARG;
-    }
-    if (mbedtls_cipher_set_padding_mode(&ctx, MBEDTLS_PADDING_NONE) != 0) {
-      return ERR_ARG;
-    }
-    if (mbedtls_cipher_setkey(&ctx, key, 8 * 8, (mode == SNMP_V3_PRIV_MODE_ENCRYPT) ? MBEDTLS_ENCRYPT : MBEDTLS_DECRYPT) != 0) {
-      goto error;
-    }
+    struct snmp_pbuf_stream read_stream;
+    struct snmp_pbuf_stream write_stream;
+    snmp_pbuf_stream_init(&read_stream, stream->pbuf, stream->offset, stream->length);
+    snmp_pbuf_stream_init(&write_stream, stream->pbuf, stream->offset, stream->length);
 
     /* Prepare IV */
     for (i = 0; i < LWIP_ARRAYSIZE(iv_local); i++) {
       iv_local[i] = priv_param[i] ^ key[i + 8];
     }
-    if (mbedtls_cipher_set_iv(&ctx, iv_local, LWIP_ARRAYSIZE(iv_local)) != 0) {
+    if ((mbedtls_cipher_set_iv(&entry->ctx, iv_local, LWIP_ARRAYSIZE(iv_local)) != 0) ||
+        (mbedtls_cipher_reset(&entry->ctx) != 0)) {
       goto error;
     }
 
@@ -159,7 +313,7 @@ snmpv3_crypt(struct snmp_pbuf_stream *stream, u16_t length,
         }
       }
 
-      if (mbedtls_cipher_update(&ctx, in_bytes, LWIP_ARRAYSIZE(in_bytes), out_bytes, &out_len) != 0) {
+      if (mbedtls_cipher_update(&entry->ctx, in_bytes, LWIP_ARRAYSIZE(in_bytes), out_bytes, &out_len) != 0) {
         goto error;
       }
 
@@ -169,23 +323,20 @@ snmpv3_crypt(struct snmp_pbuf_stream *stream, u16_t length,
     }
 
     out_len = LWIP_ARRAYSIZE(out_bytes);
-    if (mbedtls_cipher_finish(&ctx, out_bytes, &out_len) != 0) {
+    if (mbedtls_cipher_finish(&entry->ctx, out_bytes, &out_len) != 0) {
       goto error;
     }
 
-    if (snmp_pbuf_stream_writebuf(&write_stream, out_bytes, (u16_t)out_len) != ERR_OK) {
+    /* nothing is left without padding, and the stream may end with the pbuf */
+    if ((out_len > 0) &&
+        (snmp_pbuf_stream_writebuf(&write_stream, out_bytes, (u16_t)out_len) != ERR_OK)) {
       goto error;
     }
-  } else if (algo == SNMP_V3_PRIV_ALGO_AES) {
+  } else {
     u8_t iv_local[16];
-
-    cipher_info = mbedtls_cipher_info_from_type(MBEDTLS_CIPHER_AES_128_CFB128);
-    if (mbedtls_cipher_setup(&ctx, cipher_info) != 0) {
-      return ERR_ARG;
-    }
-    if (mbedtls_cipher_setkey(&ctx, key, 16 * 8, (mode == SNMP_V3_PRIV_MODE_ENCRYPT) ? MBEDTLS_ENCRYPT : MBEDTLS_DECRYPT) != 0) {
-      goto error;
-    }
+    u8_t out_bytes[16];
+    struct pbuf *q;
+    u16_t q_offset;
 
     /*
      * IV is the big endian concatenation of boots,
@@ -200,46 +351,75 @@ snmpv3_crypt(struct snmp_pbuf_stream *stream, u16_t length,
     iv_local[4 + 2] = (engine_time  >>  8) & 0xFF;
     iv_local[4 + 3] = (engine_time  >>  0) & 0xFF;
     SMEMCPY(iv_local + 8, priv_param, 8);
-    if (mbedtls_cipher_set_iv(&ctx, iv_local, LWIP_ARRAYSIZE(iv_local)) != 0) {
+    if ((mbedtls_cipher_set_iv(&entry->ctx, iv_local, LWIP_ARRAYSIZE(iv_local)) != 0) ||
+        (mbedtls_cipher_reset(&entry->ctx) != 0)) {
       goto error;
     }
 
-    for (i = 0; i < length; i++) {
-      u8_t in_byte;
-      u8_t out_byte;
-      size_t out_len = sizeof(out_byte);
-
-      if (snmp_pbuf_stream_read(&read_stream, &in_byte) != ERR_OK) {
-        goto error;
-      }
-      if (mbedtls_cipher_update(&ctx, &in_byte, sizeof(in_byte), &out_byte, &out_len) != 0) {
+    /* CFB is a stream mode: en-/decrypt the pbuf payloads directly. mbedTLS
+       only allows in-place updates of whole blocks, so go through out_bytes. */
+    for (q = pbuf_skip(stream->pbuf, stream->offset, &q_offset); length > 0; q = q->next) {
+      u8_t *data;
+      size_t out_len;
+      u16_t chunk;
+      if (q == NULL) {
         goto error;
       }
-      if (snmp_pbuf_stream_write(&write_stream, out_byte) != ERR_OK) {
-        goto error;
+      data = (u8_t *)q->payload + q_offset;
+      chunk = (u16_t)LWIP_MIN(length, q->len - q_offset);
+      length = (u16_t)(length - chunk);
+      q_offset = 0;
+      while (chunk > 0) {
+        u16_t n = (u16_t)LWIP_MIN(chunk, sizeof(out_bytes));
+        out_len = n;
+        if ((mbedtls_cipher_update(&entry->ctx, data, n, out_bytes, &out_len) != 0) || (out_len != n)) {
+          goto error;
+        }
+        MEMCPY(data, out_bytes, n);
+        data += n;
+        chunk = (u16_t)(chunk - n);
       }
     }
-  } else {
-    return ERR_ARG;
   }
 
-  mbedtls_cipher_free(&ctx);
+  snmpv3_priv_ctx_release(entry);
   return ERR_OK;
 
 error:
-  mbedtls_cipher_free(&ctx);
-  return ERR_OK;
+  snmpv3_priv_ctx_release(entry);
+  return ERR_ARG;
 }
 
 #endif /* LWIP_SNMP_V3_CRYPTO */
 
-/* A.2.1. Password to Key Sample Code for MD5 */
+/** Free all cached HMAC and cipher contexts and wipe their keys.
+ * Called when the engine ID changes: all localized keys change with it.
+ */
 void
-snmpv3_password_to_key_md5(
+snmpv3_crypto_ctx_clear(void)
+{
+  u8_t i;
+  for (i = 0; i < SNMPV3_CTX_CACHE_COUNT; i++) {
+    if (snmpv3_auth_ctxs[i].md_info != NULL) {
+      snmpv3_auth_ctx_free(&snmpv3_auth_ctxs[i]);
+    }
+#if LWIP_SNMP_V3_CRYPTO
+    if (snmpv3_priv_ctxs[i].algo != SNMP_V3_PRIV_ALGO_INVAL) {
+      snmpv3_priv_ctx_free(&snmpv3_priv_ctxs[i]);
+    }
+#endif /* LWIP_SNMP_V3_CRYPTO */
+  }
+  snmpv3_auth_ctx_next = 0;
+#if LWIP_SNMP_V3_CRYPTO
+  snmpv3_priv_ctx_next = 0;
+#endif /* LWIP_SNMP_V3_CRYPTO */
+}
+
+/* A.2.1. Password to Key Sample Code for MD5, first part: password to master key */
+void
+snmpv3_password_to_master_key_md5(
   const u8_t *password,    /* IN */
   size_t      passwordlen, /* IN */
-  const u8_t *engineID,    /* IN  - pointer to snmpEngineID  */
-  u8_t        engineLength,/* IN  - length of snmpEngineID */
   u8_t       *key)         /* OUT - pointer to caller 16-octet buffer */
 {
   mbedtls_md5_context MD;
@@ -268,35 +448,64 @@ snmpv3_password_to_key_md5(
   }
   mbedtls_md5_finish(&MD, key); /* tell MD5 we're done */
 
+  mbedtls_md5_free(&MD);
+  mbedtls_platform_zeroize(password_buf, sizeof(password_buf));
+  return;
+}
+
+/* A.2.1. Password to Key Sample Code for MD5, second part: key localization */
+void
+snmpv3_localize_key_md5(
+  const u8_t *master_key,  /* IN  - pointer to 16-octet master key */
+  const u8_t *engineID,    /* IN  - pointer to snmpEngineID  */
+  u8_t        engineLength,/* IN  - length of snmpEngineID */
+  u8_t       *key)         /* OUT - pointer to caller 16-octet buffer, may be master_key */
+{
+  mbedtls_md5_context MD;
+  u8_t password_buf[64];
+
   /*****************************************************/
   /* Now localize the key with the engineID and pass   */
   /* through MD5 to produce final key                  */
   /* May want to ensure that engineLength <= 32,       */
   /* otherwise need to use a buffer larger than 64     */
   /*****************************************************/
-  SMEMCPY(password_buf, key, 16);
+  SMEMCPY(password_buf, master_key, 16);
   MEMCPY(password_buf + 16, engineID, engineLength);
-  SMEMCPY(password_buf + 16 + engineLength, key, 16);
+  SMEMCPY(password_buf + 16 + engineLength, master_key, 16);
 
+  mbedtls_md5_init(&MD);
   mbedtls_md5_starts(&MD);
   mbedtls_md5_update(&MD, password_buf, 32 + engineLength);
   mbedtls_md5_finish(&MD, key);
 
   mbedtls_md5_free(&MD);
+  mbedtls_platform_zeroize(password_buf, sizeof(password_buf));
   return;
 }
 
-/* A.2.2. Password to Key Sample Code for SHA */
+/* A.2.1. Password to Key Sample Code for MD5 */
 void
-snmpv3_password_to_key_sha(
+snmpv3_password_to_key_md5(
   const u8_t *password,    /* IN */
   size_t      passwordlen, /* IN */
   const u8_t *engineID,    /* IN  - pointer to snmpEngineID  */
   u8_t        engineLength,/* IN  - length of snmpEngineID */
+  u8_t       *key)         /* OUT - pointer to caller 16-octet buffer */
+{
+  snmpv3_password_to_master_key_md5(password, passwordlen, key);
+  snmpv3_localize_key_md5(key, engineID, engineLength, key);
+}
+
+/* A.2.2. Password to Key Sample Code for SHA, first part: password to master key */
+void
+snmpv3_password_to_master_key_sha(
+  const u8_t *password,    /* IN */
+  size_t      passwordlen, /* IN */
   u8_t       *key)         /* OUT - pointer to caller 20-octet buffer */
 {
   mbedtls_sha1_context SH;
-  u8_t *cp, password_buf[72];
+  u8_t *cp, password_buf[64];
   u32_t password_index = 0;
   u8_t i;
   u32_t count = 0;
@@ -321,22 +530,53 @@ snmpv3_password_to_key_sha(
   }
   mbedtls_sha1_finish(&SH, key); /* tell SHA we're done */
 
+  mbedtls_sha1_free(&SH);
+  mbedtls_platform_zeroize(password_buf, sizeof(password_buf));
+  return;
+}
+
+/* A.2.2. Password to Key Sample Code for SHA, second part: key localization */
+void
+snmpv3_localize_key_sha(
+  const u8_t *master_key,  /* IN  - pointer to 20-octet master key */
+  const u8_t *engineID,    /* IN  - pointer to snmpEngineID  */
+  u8_t        engineLength,/* IN  - length of snmpEngineID */
+  u8_t       *key)         /* OUT - pointer to caller 20-octet buffer, may be master_key */
+{
+  mbedtls_sha1_context SH;
+  u8_t password_buf[72];
+
   /*****************************************************/
   /* Now localize the key with the engineID and pass   */
   /* through SHA to produce final key                  */
   /* May want to ensure that engineLength <= 32,       */
   /* otherwise need to use a buffer larger than 72     */
   /*****************************************************/
-  SMEMCPY(password_buf, key, 20);
+  SMEMCPY(password_buf, master_key, 20);
   MEMCPY(password_buf + 20, engineID, engineLength);
-  SMEMCPY(password_buf + 20 + engineLength, key, 20);
+  SMEMCPY(password_buf + 20 + engineLength, master_key, 20);
 
+  mbedtls_sha1_init(&SH);
   mbedtls_sha1_starts(&SH);
   mbedtls_sha1_update(&SH, password_buf, 40 + engineLength);
   mbedtls_sha1_finish(&SH, key);
 
   mbedtls_sha1_free(&SH);
+  mbedtls_platform_zeroize(password_buf, sizeof(password_buf));
   return;
 }
 
+/* A.2.2. Password to Key Sample Code for SHA */
+void
+snmpv3_password_to_key_sha(
+  const u8_t *password,    /* IN */
+  size_t      passwordlen, /* IN */
+  const u8_t *engineID,    /* IN  - pointer to snmpEngineID  */
+  u8_t        engineLength,/* IN  - length of snmpEngineID */
+  u8_t       *key)         /* OUT - pointer to caller 20-octet buffer */
+{
+  snmpv3_password_to_master_key_sha(password, passwordlen, key);
+  snmpv3_localize_key_sha(key, engineID, engineLength, key);
+}
+
 #endif /* LWIP_SNMP && LWIP_SNMP_V3 && LWIP_SNMP_V3_MBEDTLS */
@@ -63,6 +63,9 @@ err_t snmpv3_crypt(struct snmp_pbuf_stream *stream, u16_t length, const u8_t *ke
                    const u8_t *priv_param, const u32_t engine_boots, const u32_t engine_time, snmpv3_priv_algo_t algo, snmpv3_priv_mode_t mode);
 err_t snmpv3_build_priv_param(u8_t *priv_param);
 void snmpv3_enginetime_timer(void *arg);
+#if LWIP_SNMP_V3_MBEDTLS
+void snmpv3_crypto_ctx_clear(void);
+#endif
 
 #endif
 
@@ -40,11 +40,20 @@
  *
  */
 
+
 /**
  * @defgroup tftp TFTP client/server
  * @ingroup apps
  *
  * This is simple TFTP client/server for the lwIP raw API.
+ *
+ * The block size (RFC 2348), window size (RFC 7440) and transfer size
+ * (RFC 2349) options are negotiated (see @ref TFTP_MAX_BLKSIZE and
+ * @ref TFTP_MAX_WINDOWSIZE). With a window size &gt; 1, the sender sends
+ * that many blocks before waiting for an ACK, the receiver acknowledges
+ * each window and the last block received in order when blocks are lost.
+ * Peers not supporting the options fall back to 512 byte blocks sent
+ * in lock-step.
  */
 
 #include "lwip/apps/tftp_client.h"
@@ -53,10 +62,15 @@
 #if LWIP_UDP
 
 #include "lwip/udp.h"
+#include "lwip/ip.h"
+#include "lwip/prot/ip4.h"
+#include "lwip/prot/ip6.h"
+#include "lwip/prot/udp.h"
 #include "lwip/timeouts.h"
 #include "lwip/debug.h"
 
 #define TFTP_MAX_PAYLOAD_SIZE 512
+#define TFTP_MIN_BLKSIZE      8
 #define TFTP_HEADER_LENGTH    4
 
 #define TFTP_RRQ   1
@@ -64,6 +78,13 @@
 #define TFTP_DATA  3
 #define TFTP_ACK   4
 #define TFTP_ERROR 5
+#define TFTP_OACK  6
+
+/* Max. length of the options of a request or OACK:
+   "blksize" "65464" "windowsize" "65535" "tsize" "2147483647" */
+#define TFTP_OPTIONS_LEN      64
+/* Max. length of an option name we know */
+#define TFTP_OPTION_NAME_LEN  10
 
 enum tftp_error {
   TFTP_ERROR_FILE_NOT_FOUND    = 1,
@@ -72,7 +93,8 @@ enum tftp_error {
   TFTP_ERROR_ILLEGAL_OPERATION = 4,
   TFTP_ERROR_UNKNOWN_TRFR_ID   = 5,
   TFTP_ERROR_FILE_EXISTS       = 6,
-  TFTP_ERROR_NO_SUCH_USER      = 7
+  TFTP_ERROR_NO_SUCH_USER      = 7,
+  TFTP_ERROR_OPTION_REFUSED    = 8
 };
 
 #include <string.h>
@@ -80,16 +102,34 @@ enum tftp_error {
 struct tftp_state {
   const struct tftp_context *ctx;
   void *handle;
-  struct pbuf *last_data;
+  /** Sending: blocks sent and not acknowledged yet, starting with blknum */
+  struct pbuf *window[TFTP_MAX_WINDOWSIZE];
+  /** Request (client) or OACK (server) sent, resent on timeout until it is answered */
+  struct pbuf *last_ctrl;
   struct udp_pcb *upcb;
   ip_addr_t addr;
   u16_t port;
   int timer;
   int last_pkt;
+  /** Sending: first block not acknowledged, receiving: next block expected */
   u16_t blknum;
+  /** Negotiated block size */
+  u16_t blksize;
+  /** Negotiated window size */
+  u16_t windowsize;
+  /** Sending: number of blocks in window */
+  u16_t window_len;
+  /** Receiving: blocks received in order since the last ACK */
+  u16_t window_rcvd;
+  /** Receiving: blocks received out of order since the last ACK sent for them */
+  u16_t window_gap;
   u8_t retries;
   u8_t mode_write;
   u8_t tftp_mode;
+  /** Sending: the last (short) block has been read */
+  u8_t last_read;
+  /** Client: request sent, the server replies from its transfer port */
+  u8_t request_sent;
 };
 
 static struct tftp_state tftp_state;
@@ -99,13 +139,21 @@ static void tftp_tmr(void *arg);
 static void
 close_handle(void)
 {
+  u16_t i;
+
   tftp_state.port = 0;
   ip_addr_set_any(0, &tftp_state.addr);
 
-  if (tftp_state.last_data != NULL) {
-    pbuf_free(tftp_state.last_data);
-    tftp_state.last_data = NULL;
+  for (i = 0; i < tftp_state.window_len; i++) {
+    pbuf_free(tftp_state.window[i]);
+    tftp_state.window[i] = NULL;
+  }
+  tftp_state.window_len = 0;
+  if (tftp_state.last_ctrl != NULL) {
+    pbuf_free(tftp_state.last_ctrl);
+    tftp_state.last_ctrl = NULL;
   }
+  tftp_state.request_sent = 0;
 
   sys_untimeout(tftp_tmr, NULL);
 
@@ -131,15 +179,133 @@ init_packet(u16_t opcode, u16_t extra, size_t size)
   return p;
 }
 
+/**
+ * Send a packet kept for retransmission (data block, request or OACK).
+ * It is sent behind a header pbuf, so its payload stays unchanged and
+ * it can be sent again without copying.
+ */
+static err_t
+send_stored(struct pbuf *p)
+{
+  err_t ret;
+  struct pbuf *q = pbuf_alloc(PBUF_TRANSPORT, 0, PBUF_RAM);
+  if (q == NULL) {
+    return ERR_MEM;
+  }
+
+  pbuf_chain(q, p);
+  ret = udp_sendto(tftp_state.upcb, q, &tftp_state.addr, tftp_state.port);
+  pbuf_free(q);
+  return ret;
+}
+
+/** Largest block size that fits into the MTU of the netif used to reach addr */
+static u16_t
+max_blksize(const ip_addr_t *addr)
+{
+  u16_t blksize = TFTP_MAX_BLKSIZE;
+  struct netif *netif = ip_route(&tftp_state.upcb->local_ip, addr);
+
+  if ((netif != NULL) && (netif->mtu != 0)) {
+    u16_t hdr_len = (u16_t)((IP_IS_V6(addr) ? IP6_HLEN : IP_HLEN) + UDP_HLEN + TFTP_HEADER_LENGTH);
+    if (netif->mtu > hdr_len) {
+      blksize = LWIP_MIN(blksize, (u16_t)(netif->mtu - hdr_len));
+    }
+  }
+  return LWIP_MAX(blksize, TFTP_MAX_PAYLOAD_SIZE);
+}
+
+/** Append an option (name and decimal value) to an option buffer, returns the new length */
+static u16_t
+add_option(char *buf, u16_t len, const char *name, u32_t value)
+{
+  size_t name_len = strlen(name) + 1;
+  char value_str[11];
+  size_t value_len;
+
+  lwip_itoa(value_str, sizeof(value_str), (int)value);
+  value_len = strlen(value_str) + 1;
+  if (len + name_len + value_len > TFTP_OPTIONS_LEN) {
+    return len;
+  }
+  MEMCPY(&buf[len], name, name_len);
+  MEMCPY(&buf[len + name_len], value_str, value_len);
+  return (u16_t)(len + name_len + value_len);
+}
+
+/**
+ * Read an option of a request or OACK
+ * @param p The packet
+ * @param offset Offset of the option name in p
+ * @param name Where to store the option name, empty if it is too long to be one we know
+ * @param value Where to store the option value, 0xFFFFFFFF if it is not a number
+ * @return Offset of the next option, 0 if there is no (complete) option at offset
+ */
+static u16_t
+read_option(struct pbuf *p, u16_t offset, char *name, u32_t *value)
+{
+  const char tftp_null = 0;
+  u16_t name_end;
+  u16_t value_end;
+  u16_t i;
+
+  if (offset >= p->tot_len) {
+    return 0;
+  }
+  name_end = pbuf_memfind(p, &tftp_null, sizeof(tftp_null), offset);
+  if (name_end == 0xFFFF) {
+    return 0;
+  }
+  value_end = pbuf_memfind(p, &tftp_null, sizeof(tftp_null), (u16_t)(name_end + 1));
+  if (value_end == 0xFFFF) {
+    return 0;
+  }
+
+  name[0] = 0;
+  if (name_end - offset <= TFTP_OPTION_NAME_LEN) {
+    pbuf_copy_partial(p, name, (u16_t)(name_end - offset + 1), offset);
+  }
+
+  *value = (value_end > name_end + 1) ? 0 : 0xFFFFFFFFUL;
+  for (i = (u16_t)(name_end + 1); i < value_end; i++) {
+    u8_t c = pbuf_get_at(p, i);
+    if ((c < '0') || (c > '9') || (*value > 0x7FFFFFFFUL / 10)) {
+      *value = 0xFFFFFFFFUL;
+      break;
+    }
+    *value = *value * 10 + (u32_t)(c - '0');
+  }
+
+  return (u16_t)(value_end + 1);
+}
+
 static err_t
 send_request(const ip_addr_t *addr, u16_t port, u16_t opcode, const char* fname, const char* mode)
 {
   size_t fname_length = strlen(fname)+1;
   size_t mode_length = strlen(mode)+1;
-  struct pbuf* p = init_packet(opcode, 0, fname_length + mode_length - 2);
+  char options[TFTP_OPTIONS_LEN];
+  u16_t options_length = 0;
+  struct pbuf* p;
   char* payload;
-  err_t ret;
 
+  if (TFTP_MAX_BLKSIZE > TFTP_MAX_PAYLOAD_SIZE) {
+    u16_t blksize = max_blksize(addr);
+    if (blksize > TFTP_MAX_PAYLOAD_SIZE) {
+      options_length = add_option(options, options_length, "blksize", blksize);
+    }
+  }
+  if (TFTP_MAX_WINDOWSIZE > 1) {
+    options_length = add_option(options, options_length, "windowsize", TFTP_MAX_WINDOWSIZE);
+  }
+  if ((opcode == TFTP_WRQ) && (tftp_state.ctx->size != NULL)) {
+    int size = tftp_state.ctx->size(tftp_state.handle);
+    if (size >= 0) {
+      options_length = add_option(options, options_length, "tsize", (u32_t)size);
+    }
+  }
+
+  p = init_packet(opcode, 0, fname_length + mode_length + options_length - 2);
   if (p == NULL) {
     return ERR_MEM;
   }
@@ -147,10 +313,13 @@ send_request(const ip_addr_t *addr, u16_t port, u16_t opcode, const char* fname,
   payload = (char*) p->payload;
   MEMCPY(payload+2,              fname, fname_length);
   MEMCPY(payload+2+fname_length, mode,  mode_length);
+  MEMCPY(payload+2+fname_length+mode_length, options, options_length);
 
-  ret = udp_sendto(tftp_state.upcb, p, addr, port);
-  pbuf_free(p);
-  return ret;
+  ip_addr_copy(tftp_state.addr, *addr);
+  tftp_state.port = port;
+  tftp_state.last_ctrl = p;
+  tftp_state.request_sent = 1;
+  return send_stored(p);
 }
 
 static err_t
@@ -191,51 +360,151 @@ send_ack(const ip_addr_t *addr, u16_t port, u16_t blknum)
 }
 
 static err_t
-resend_data(const ip_addr_t *addr, u16_t port)
+send_oack(const char *options, u16_t options_length)
 {
-  err_t ret;
-  struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, tftp_state.last_data->len, PBUF_RAM);
+  u16_t *payload;
+  struct pbuf *p = init_packet(TFTP_OACK, 0, options_length - 2);
   if (p == NULL) {
     return ERR_MEM;
   }
 
-  ret = pbuf_copy(p, tftp_state.last_data);
-  if (ret != ERR_OK) {
-    pbuf_free(p);
-    return ret;
+  payload = (u16_t *) p->payload;
+  MEMCPY(&payload[1], options, options_length);
+
+  tftp_state.last_ctrl = p;
+  return send_stored(p);
+}
+
+/** Free the request or OACK once it has been answered */
+static void
+ctrl_answered(void)
+{
+  if (tftp_state.last_ctrl != NULL) {
+    pbuf_free(tftp_state.last_ctrl);
+    tftp_state.last_ctrl = NULL;
   }
+  tftp_state.request_sent = 0;
+}
 
-  ret = udp_sendto(tftp_state.upcb, p, addr, port);
-  pbuf_free(p);
-  return ret;
+/** Send the blocks of the window again (after a timeout or a lost block) */
+static void
+resend_data(void)
+{
+  u16_t i;
+
+  for (i = 0; i < tftp_state.window_len; i++) {
+    send_stored(tftp_state.window[i]);
+  }
 }
 
+/** Read and send new blocks until the window is full or the file has been read */
 static void
 send_data(const ip_addr_t *addr, u16_t port)
 {
-  u16_t *payload;
-  int ret;
+  while (!tftp_state.last_read && (tftp_state.window_len < tftp_state.windowsize)) {
+    u16_t *payload;
+    int ret;
+    struct pbuf *p = pbuf_alloc(PBUF_RAW, (u16_t)(TFTP_HEADER_LENGTH + tftp_state.blksize), PBUF_RAM);
+    if (p == NULL) {
+      /* sent again from the timer */
+      return;
+    }
 
-  if (tftp_state.last_data != NULL) {
-    pbuf_free(tftp_state.last_data);
-  }
+    payload = (u16_t *) p->payload;
+    payload[0] = PP_HTONS(TFTP_DATA);
+    payload[1] = lwip_htons((u16_t)(tftp_state.blknum + tftp_state.window_len));
 
-  tftp_state.last_data = init_packet(TFTP_DATA, tftp_state.blknum, TFTP_MAX_PAYLOAD_SIZE);
-  if (tftp_state.last_data == NULL) {
-    return;
+    ret = tftp_state.ctx->read(tftp_state.handle, &payload[2], tftp_state.blksize);
+    if (ret < 0) {
+      pbuf_free(p);
+      send_error(addr, port, TFTP_ERROR_ACCESS_VIOLATION, "Error occured while reading the file.");
+      close_handle();
+      return;
+    }
+
+    pbuf_realloc(p, (u16_t)(TFTP_HEADER_LENGTH + ret));
+    if (ret < tftp_state.blksize) {
+      tftp_state.last_read = 1;
+    }
+    tftp_state.window[tftp_state.window_len++] = p;
+    send_stored(p);
   }
+}
 
-  payload = (u16_t *) tftp_state.last_data->payload;
+/** Reset the transfer state for a new request */
+static void
+start_transfer(u8_t mode_write)
+{
+  tftp_state.blknum = 1;
+  tftp_state.mode_write = mode_write;
+  tftp_state.blksize = TFTP_MAX_PAYLOAD_SIZE;
+  tftp_state.windowsize = 1;
+  tftp_state.window_rcvd = 0;
+  tftp_state.window_gap = 0;
+  tftp_state.last_read = 0;
+  tftp_state.retries = 0;
+  tftp_state.last_pkt = tftp_state.timer;
+}
 
-  ret = tftp_state.ctx->read(tftp_state.handle, &payload[2], TFTP_MAX_PAYLOAD_SIZE);
-  if (ret < 0) {
-    send_error(addr, port, TFTP_ERROR_ACCESS_VIOLATION, "Error occured while reading the file.");
-    close_handle();
-    return;
+/**
+ * Server: accept the options of a request
+ * @return length of the options to send in an OACK, 0 to send none
+ */
+static u16_t
+accept_options(struct pbuf *p, u16_t offset, const ip_addr_t *addr, char *options)
+{
+  char name[TFTP_OPTION_NAME_LEN + 1];
+  u32_t value;
+  u16_t options_length = 0;
+
+  while ((offset = read_option(p, offset, name, &value)) != 0) {
+    if ((lwip_stricmp(name, "blksize") == 0) && (value >= TFTP_MIN_BLKSIZE) && (value != 0xFFFFFFFFUL)) {
+      tftp_state.blksize = (u16_t)LWIP_MIN(value, max_blksize(addr));
+      options_length = add_option(options, options_length, "blksize", tftp_state.blksize);
+    } else if ((lwip_stricmp(name, "windowsize") == 0) && (value >= 1) && (value != 0xFFFFFFFFUL)) {
+      tftp_state.windowsize = (u16_t)LWIP_MIN(value, TFTP_MAX_WINDOWSIZE);
+      options_length = add_option(options, options_length, "windowsize", tftp_state.windowsize);
+    } else if ((lwip_stricmp(name, "tsize") == 0) && (value != 0xFFFFFFFFUL)) {
+      if (tftp_state.mode_write) {
+        options_length = add_option(options, options_length, "tsize", value);
+      } else if (tftp_state.ctx->size != NULL) {
+        int size = tftp_state.ctx->size(tftp_state.handle);
+        if (size >= 0) {
+          options_length = add_option(options, options_length, "tsize", (u32_t)size);
+        }
+      }
+    }
   }
+  return options_length;
+}
 
-  pbuf_realloc(tftp_state.last_data, (u16_t)(TFTP_HEADER_LENGTH + ret));
-  resend_data(addr, port);
+/**
+ * Client: take over the options acknowledged by the server
+ * @return ERR_OK if all options are valid
+ */
+static err_t
+apply_options(struct pbuf *p, const ip_addr_t *addr)
+{
+  char name[TFTP_OPTION_NAME_LEN + 1];
+  u32_t value;
+  u16_t offset = 2;
+
+  while ((offset = read_option(p, offset, name, &value)) != 0) {
+    if (lwip_stricmp(name, "blksize") == 0) {
+      if ((value < TFTP_MIN_BLKSIZE) || (value > max_blksize(addr))) {
+        return ERR_VAL;
+      }
+      tftp_state.blksize = (u16_t)value;
+    } else if (lwip_stricmp(name, "windowsize") == 0) {
+      if ((value < 1) || (value > TFTP_MAX_WINDOWSIZE)) {
+        return ERR_VAL;
+      }
+      tftp_state.windowsize = (u16_t)value;
+    } else if (lwip_stricmp(name, "tsize") != 0) {
+      return ERR_VAL;
+    }
+  }
+  return ERR_OK;
 }
 
 static void
@@ -247,6 +516,11 @@ recv(void *arg, struct udp_pcb *upcb, struct pbuf *p, const ip_addr_t *addr, u16
   LWIP_UNUSED_ARG(arg);
   LWIP_UNUSED_ARG(upcb);
 
+  if (tftp_state.request_sent && ip_addr_cmp(&tftp_state.addr, addr)) {
+    /* First reply to our request comes from the transfer port of the server */
+    tftp_state.port = port;
+  }
+
   if (((tftp_state.port != 0) && (port != tftp_state.port)) ||
       (!ip_addr_isany_val(tftp_state.addr) && !ip_addr_cmp(&tftp_state.addr, addr))) {
     send_error(addr, port, TFTP_ERROR_ACCESS_VIOLATION, "Only one connection at a time is supported");
@@ -265,6 +539,8 @@ recv(void *arg, struct udp_pcb *upcb, struct pbuf *p, const ip_addr_t *addr, u16
       const char tftp_null = 0;
       char filename[TFTP_MAX_FILENAME_LEN + 1];
       char mode[TFTP_MAX_MODE_LEN + 1];
+      char options[TFTP_OPTIONS_LEN];
+      u16_t options_length;
       u16_t filename_end_offset;
       u16_t mode_end_offset;
 
@@ -297,7 +573,7 @@ recv(void *arg, struct udp_pcb *upcb, struct pbuf *p, const ip_addr_t *addr, u16
       pbuf_copy_partial(p, mode, mode_end_offset - filename_end_offset, filename_end_offset + 1);
 
       tftp_state.handle = tftp_state.ctx->open(filename, mode, opcode == PP_HTONS(TFTP_WRQ));
-      tftp_state.blknum = 1;
+      start_transfer(opcode == PP_HTONS(TFTP_WRQ));
 
       if (!tftp_state.handle) {
         send_error(addr, port, TFTP_ERROR_FILE_NOT_FOUND, "Unable to open requested file.");
@@ -311,17 +587,52 @@ recv(void *arg, struct udp_pcb *upcb, struct pbuf *p, const ip_addr_t *addr, u16
       ip_addr_copy(tftp_state.addr, *addr);
       tftp_state.port = port;
 
-      if (opcode == PP_HTONS(TFTP_WRQ)) {
-        tftp_state.mode_write = 1;
+      options_length = accept_options(p, (u16_t)(mode_end_offset + 1), addr, options);
+      if (options_length > 0) {
+        /* Answered with ACK 0 (read) or DATA 1 (write) */
+        LWIP_DEBUGF(TFTP_DEBUG | LWIP_DBG_STATE, ("tftp: blksize %"U16_F" windowsize %"U16_F"\n",
+                    tftp_state.blksize, tftp_state.windowsize));
+        send_oack(options, options_length);
+      } else if (tftp_state.mode_write) {
         send_ack(addr, port, 0);
       } else {
-        tftp_state.mode_write = 0;
         send_data(addr, port);
       }
 
       break;
     }
 
+    case PP_HTONS(TFTP_OACK): {
+      if (tftp_state.handle == NULL) {
+        send_error(addr, port, TFTP_ERROR_ACCESS_VIOLATION, "No connection");
+        break;
+      }
+
+      if (!tftp_state.request_sent) {
+        /* OACK sent again by the server, our ACK 0 got lost */
+        if (tftp_state.mode_write && (tftp_state.blknum == 1)) {
+          send_ack(addr, port, 0);
+        }
+        break;
+      }
+
+      if (apply_options(p, addr) != ERR_OK) {
+        send_error(addr, port, TFTP_ERROR_OPTION_REFUSED, "Invalid option");
+        close_handle();
+        break;
+      }
+      ctrl_answered();
+
+      LWIP_DEBUGF(TFTP_DEBUG | LWIP_DBG_STATE, ("tftp: blksize %"U16_F" windowsize %"U16_F"\n",
+                  tftp_state.blksize, tftp_state.windowsize));
+      if (tftp_state.mode_write) {
+        send_ack(addr, port, 0);
+      } else {
+        send_data(addr, port);
+      }
+      break;
+    }
+
     case PP_HTONS(TFTP_DATA): {
       int ret;
       u16_t blknum;
@@ -336,35 +647,52 @@ recv(void *arg, struct udp_pcb *upcb, struct pbuf *p, const ip_addr_t *addr, u16
         break;
       }
 
+      /* Data answers our request (without options) or OACK */
+      ctrl_answered();
+
       blknum = lwip_ntohs(sbuf[1]);
       if (blknum == tftp_state.blknum) {
+        u8_t lastpkt;
+
         pbuf_remove_header(p, TFTP_HEADER_LENGTH);
+        lastpkt = p->tot_len < tftp_state.blksize;
 
         ret = tftp_state.ctx->write(tftp_state.handle, p);
         if (ret < 0) {
           send_error(addr, port, TFTP_ERROR_ACCESS_VIOLATION, "error writing file");
           close_handle();
-        } else {
-          send_ack(addr, port, blknum);
+          break;
         }
 
-        if (p->tot_len < TFTP_MAX_PAYLOAD_SIZE) {
+        tftp_state.blknum++;
+        tftp_state.window_rcvd++;
+        tftp_state.window_gap = 0;
+        if (lastpkt || (tftp_state.window_rcvd >= tftp_state.windowsize)) {
+          send_ack(addr, port, blknum);
+          tftp_state.window_rcvd = 0;
+        }
+        if (lastpkt) {
           close_handle();
-        } else {
-          tftp_state.blknum++;
         }
-      } else if ((u16_t)(blknum + 1) == tftp_state.blknum) {
-        /* retransmit of previous block, ack again (casting to u16_t to care for overflow) */
-        send_ack(addr, port, blknum);
       } else {
-        send_error(addr, port, TFTP_ERROR_UNKNOWN_TRFR_ID, "Wrong block number");
+        /* Retransmitted or out of order block: acknowledge the last block received
+           in order, once per window (RFC 7440) (casting to u16_t to care for overflow) */
+        if (tftp_state.window_gap == 0) {
+          send_ack(addr, port, (u16_t)(tftp_state.blknum - 1));
+          tftp_state.window_rcvd = 0;
+        }
+        tftp_state.window_gap++;
+        if (tftp_state.window_gap >= tftp_state.windowsize) {
+          tftp_state.window_gap = 0;
+        }
       }
       break;
     }
 
     case PP_HTONS(TFTP_ACK): {
       u16_t blknum;
-      int lastpkt;
+      u16_t acked;
+      u16_t i;
 
       if (tftp_state.handle == NULL) {
         send_error(addr, port, TFTP_ERROR_ACCESS_VIOLATION, "No connection");
@@ -377,22 +705,49 @@ recv(void *arg, struct udp_pcb *upcb, struct pbuf *p, const ip_addr_t *addr, u16
       }
 
       blknum = lwip_ntohs(sbuf[1]);
-      if (blknum != tftp_state.blknum) {
-        send_error(addr, port, TFTP_ERROR_UNKNOWN_TRFR_ID, "Wrong block number");
+      if (tftp_state.last_ctrl != NULL) {
+        /* ACK 0 answers our write request (without options) or OACK */
+        if (blknum != 0) {
+          send_error(addr, port, TFTP_ERROR_UNKNOWN_TRFR_ID, "Wrong block number");
+          break;
+        }
+        ctrl_answered();
+        send_data(addr, port);
         break;
       }
 
-      lastpkt = 0;
+      /* Number of blocks acknowledged (casting to u16_t to care for overflow) */
+      acked = (u16_t)(blknum - tftp_state.blknum + 1);
+      if (acked > tftp_state.window_len) {
+        if ((u16_t)(tftp_state.blknum - blknum) <= TFTP_MAX_WINDOWSIZE) {
+          /* Duplicate ACK for an earlier block */
+          break;
+        }
+        send_error(addr, port, TFTP_ERROR_UNKNOWN_TRFR_ID, "Wrong block number");
+        break;
+      }
+      if (acked == 0) {
+        /* The first block of the window got lost */
+        resend_data();
+        break;
+      }
 
-      if (tftp_state.last_data != NULL) {
-        lastpkt = tftp_state.last_data->tot_len != (TFTP_MAX_PAYLOAD_SIZE + TFTP_HEADER_LENGTH);
+      for (i = 0; i < acked; i++) {
+        pbuf_free(tftp_state.window[i]);
       }
+      for (i = acked; i < tftp_state.window_len; i++) {
+        tftp_state.window[i - acked] = tftp_state.window[i];
+        tftp_state.window[i] = NULL;
+      }
+      tftp_state.window_len = (u16_t)(tftp_state.window_len - acked);
+      tftp_state.blknum = (u16_t)(tftp_state.blknum + acked);
 
-      if (!lastpkt) {
-        tftp_state.blknum++;
-        send_data(addr, port);
-      } else {
+      if (tftp_state.last_read && (tftp_state.window_len == 0)) {
         close_handle();
+      } else {
+        /* Blocks after the one acknowledged were lost, start again from there */
+        resend_data();
+        send_data(addr, port);
       }
 
       break;
@@ -426,10 +781,20 @@ tftp_tmr(void *arg)
   sys_timeout(TFTP_TIMER_MSECS, tftp_tmr, NULL);
 
   if ((tftp_state.timer - tftp_state.last_pkt) > (TFTP_TIMEOUT_MSECS / TFTP_TIMER_MSECS)) {
-    if ((tftp_state.last_data != NULL) && (tftp_state.retries < TFTP_MAX_RETRIES)) {
+    if (tftp_state.retries < TFTP_MAX_RETRIES) {
       LWIP_DEBUGF(TFTP_DEBUG | LWIP_DBG_STATE, ("tftp: timeout, retrying\n"));
-      resend_data(&tftp_state.addr, tftp_state.port);
+      if (tftp_state.last_ctrl != NULL) {
+        send_stored(tftp_state.last_ctrl);
+      } else if (tftp_state.mode_write) {
+        /* Receiving: acknowledge the last block received in order */
+        send_ack(&tftp_state.addr, tftp_state.port, (u16_t)(tftp_state.blknum - 1));
+        tftp_state.window_rcvd = 0;
+      } else {
+        resend_data();
+        send_data(&tftp_state.addr, tftp_state.port);
+      }
       tftp_state.retries++;
+      tftp_state.last_pkt = tftp_state.timer;
     } else {
       LWIP_DEBUGF(TFTP_DEBUG | LWIP_DBG_STATE, ("tftp: timeout\n"));
       close_handle();
@@ -463,7 +828,8 @@ tftp_init_common(u8_t mode, const struct tftp_context *ctx)
   tftp_state.port      = 0;
   tftp_state.ctx       = ctx;
   tftp_state.timer     = 0;
-  tftp_state.last_data = NULL;
+  tftp_state.last_ctrl = NULL;
+  tftp_state.window_len = 0;
   tftp_state.upcb      = pcb;
   tftp_state.tftp_mode = mode;
 
@@ -518,30 +884,67 @@ mode_to_string(enum tftp_transfer_mode mode)
   return NULL;
 }
 
+/** Start a client transfer */
+static err_t
+tftp_request(void* handle, const ip_addr_t *addr, u16_t port, u16_t opcode, const char* fname, enum tftp_transfer_mode mode)
+{
+  err_t ret;
+
+  tftp_state.handle = handle;
+  start_transfer(opcode == TFTP_RRQ); /* we want to receive data for a read request */
+  ret = send_request(addr, port, opcode, fname, mode_to_string(mode));
+  if (tftp_state.last_ctrl == NULL) {
+    /* Could not allocate the request */
+    tftp_state.handle = NULL;
+    return ret;
+  }
+
+  /* request is sent again on timeout */
+  sys_timeout(TFTP_TIMER_MSECS, tftp_tmr, NULL);
+  return ERR_OK;
+}
+
+/** @ingroup tftp
+ * Read a file from a TFTP server.
+ * The block size and window size options are requested from the server.
+ * @param handle File handle passed to the write/close/error callbacks
+ * @param addr Server address
+ * @param port Server port, usually TFTP_PORT
+ * @param fname File name
+ * @param mode Transfer mode
+ * @return ERR_OK if the request could be sent, an err_t otherwise
+ */
 err_t
 tftp_get(void* handle, const ip_addr_t *addr, u16_t port, const char* fname, enum tftp_transfer_mode mode)
 {
   LWIP_ERROR("TFTP client is not enabled (tftp_init)", (tftp_state.tftp_mode & LWIP_TFTP_MODE_CLIENT) != 0, return ERR_VAL);
   LWIP_ERROR("tftp_get: invalid file name", fname != NULL, return ERR_VAL);
   LWIP_ERROR("tftp_get: invalid mode", mode <= TFTP_MODE_BINARY, return ERR_VAL);
+  LWIP_ERROR("tftp_get: transfer in progress", tftp_state.handle == NULL, return ERR_INPROGRESS);
 
-  tftp_state.handle = handle;
-  tftp_state.blknum = 1;
-  tftp_state.mode_write = 1; /* We want to receive data */
-  return send_request(addr, port, TFTP_RRQ, fname, mode_to_string(mode));
+  return tftp_request(handle, addr, port, TFTP_RRQ, fname, mode);
 }
 
+/** @ingroup tftp
+ * Write a file to a TFTP server.
+ * The block size and window size options are requested from the server,
+ * as well as the transfer size option if the size callback is set.
+ * @param handle File handle passed to the read/close/error/size callbacks
+ * @param addr Server address
+ * @param port Server port, usually TFTP_PORT
+ * @param fname File name
+ * @param mode Transfer mode
+ * @return ERR_OK if the request could be sent, an err_t otherwise
+ */
 err_t
 tftp_put(void* handle, const ip_addr_t *addr, u16_t port, const char* fname, enum tftp_transfer_mode mode)
 {
   LWIP_ERROR("TFTP client is not enabled (tftp_init)", (tftp_state.tftp_mode & LWIP_TFTP_MODE_CLIENT) != 0, return ERR_VAL);
   LWIP_ERROR("tftp_put: invalid file name", fname != NULL, return ERR_VAL);
   LWIP_ERROR("tftp_put: invalid mode", mode <= TFTP_MODE_BINARY, return ERR_VAL);
+  LWIP_ERROR("tftp_put: transfer in progress", tftp_state.handle == NULL, return ERR_INPROGRESS);
 
-  tftp_state.handle = handle;
-  tftp_state.blknum = 1;
-  tftp_state.mode_write = 0; /* We want to send data */
-  return send_request(addr, port, TFTP_WRQ, fname, mode_to_string(mode));
+  return tftp_request(handle, addr, port, TFTP_WRQ, fname, mode);
 }
 
 #endif /* LWIP_UDP */
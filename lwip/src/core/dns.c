@@ -184,6 +184,12 @@ static u16_t dns_txid;
 #define LWIP_DNS_ISMDNS_ARG(x)
 #endif
 
+#ifdef DNS_LOOKUP_LOCAL_EXTERN
+#define LWIP_DNS_ISLOCAL_ARG(x) , x
+#else
+#define LWIP_DNS_ISLOCAL_ARG(x)
+#endif
+
 /** DNS query message structure.
     No packing needed: only used locally on the stack. */
 struct dns_query {
@@ -236,6 +242,10 @@ struct dns_table_entry {
 #if LWIP_DNS_SUPPORT_MDNS_QUERIES
   u8_t is_mdns;
 #endif
+#ifdef DNS_LOOKUP_LOCAL_EXTERN
+  /* resolved by DNS_LOOKUP_LOCAL_EXTERN, no query is sent */
+  u8_t is_local;
+#endif
 };
 
 /** DNS request table entry: used when dns_gehostbyname cannot answer the
@@ -285,6 +295,7 @@ static err_t dns_lookup_local(const char *hostname, size_t hostnamelen, ip_addr_
 static void dns_recv(void *s, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port);
 static void dns_check_entries(void);
 static void dns_call_found(u8_t idx, ip_addr_t *addr);
+static void dns_correct_response(u8_t idx, u32_t ttl);
 
 /*-----------------------------------------------------------------------------
  * Globals
@@ -612,20 +623,25 @@ dns_local_addhost(const char *hostname, const ip_addr_t *addr)
  * @param addr the hostname's IP address, as u32_t (instead of ip_addr_t to
  *         better check for failure: != IPADDR_NONE) or IPADDR_NONE if the hostname
  *         was not found in the cached dns_table.
- * @return ERR_OK if found, ERR_ARG if not found
+ * @return ERR_OK if found, ERR_ARG if not found, ERR_INPROGRESS if not found
+ *         but DNS_LOOKUP_LOCAL_EXTERN has sent a query for it
  */
 static err_t
 dns_lookup(const char *name, size_t hostnamelen, ip_addr_t *addr LWIP_DNS_ADDRTYPE_ARG(u8_t dns_addrtype))
 {
   size_t namelen;
   u8_t i;
+#ifdef DNS_LOOKUP_LOCAL_EXTERN
+  err_t err;
+#endif /* DNS_LOOKUP_LOCAL_EXTERN */
 #if DNS_LOCAL_HOSTLIST
   if (dns_lookup_local(name, hostnamelen, addr LWIP_DNS_ADDRTYPE_ARG(dns_addrtype)) == ERR_OK) {
     return ERR_OK;
   }
 #endif /* DNS_LOCAL_HOSTLIST */
 #ifdef DNS_LOOKUP_LOCAL_EXTERN
-  if (DNS_LOOKUP_LOCAL_EXTERN(name, hostnamelen, addr, LWIP_DNS_ADDRTYPE_ARG_OR_ZERO(dns_addrtype)) == ERR_OK) {
+  err = DNS_LOOKUP_LOCAL_EXTERN(name, hostnamelen, addr, LWIP_DNS_ADDRTYPE_ARG_OR_ZERO(dns_addrtype));
+  if (err == ERR_OK) {
     return ERR_OK;
   }
 #endif /* DNS_LOOKUP_LOCAL_EXTERN */
@@ -647,6 +663,11 @@ dns_lookup(const char *name, size_t hostnamelen, ip_addr_t *addr LWIP_DNS_ADDRTY
     }
   }
 
+#ifdef DNS_LOOKUP_LOCAL_EXTERN
+  if (err == ERR_INPROGRESS) {
+    return ERR_INPROGRESS;
+  }
+#endif /* DNS_LOOKUP_LOCAL_EXTERN */
   return ERR_ARG;
 }
 
@@ -1053,6 +1074,48 @@ dns_backupserver_available(struct dns_table_entry *pentry)
   return ret;
 }
 
+#ifdef DNS_LOOKUP_LOCAL_EXTERN
+/**
+ * Repeat the lookup of an entry that DNS_LOOKUP_LOCAL_EXTERN is resolving
+ * (every DNS_TMR_INTERVAL, with the timeout of a query sent by this module).
+ * The address is cached by DNS_LOOKUP_LOCAL_EXTERN, so the entry is only used
+ * to call the callbacks.
+ *
+ * @param idx the index of the entry in dns_table
+ */
+static void
+dns_check_local_entry(u8_t idx)
+{
+  struct dns_table_entry *entry = &dns_table[idx];
+  ip_addr_t addr;
+  err_t err;
+
+  err = DNS_LOOKUP_LOCAL_EXTERN(entry->name, strlen(entry->name), &addr,
+                                LWIP_DNS_ADDRTYPE_ARG_OR_ZERO(entry->reqaddrtype));
+  if (err == ERR_OK) {
+#if LWIP_IPV4 && LWIP_IPV6
+    /* the fallback address type may have been found */
+    entry->reqaddrtype = IP_IS_V6_VAL(addr) ? LWIP_DNS_ADDRTYPE_IPV6 : LWIP_DNS_ADDRTYPE_IPV4;
+#endif /* LWIP_IPV4 && LWIP_IPV6 */
+    ip_addr_copy(entry->ipaddr, addr);
+    dns_correct_response(idx, 0);
+    return;
+  }
+  if (err == ERR_INPROGRESS) {
+    if (--entry->tmr != 0) {
+      return;
+    }
+    if (++entry->retries < DNS_MAX_RETRIES) {
+      entry->tmr = entry->retries;
+      return;
+    }
+  }
+  LWIP_DEBUGF(DNS_DEBUG, ("dns_check_local_entry: \"%s\": timeout\n", entry->name));
+  dns_call_found(idx, NULL);
+  entry->state = DNS_STATE_UNUSED;
+}
+#endif /* DNS_LOOKUP_LOCAL_EXTERN */
+
 /**
  * dns_check_entry() - see if entry has not yet been queried and, if so, sends out a query.
  * Check an entry in the dns_table:
@@ -1079,6 +1142,12 @@ dns_check_entry(u8_t i)
       entry->tmr = 1;
       entry->retries = 0;
 
+#ifdef DNS_LOOKUP_LOCAL_EXTERN
+      if (entry->is_local) {
+        /* DNS_LOOKUP_LOCAL_EXTERN has sent its own query */
+        break;
+      }
+#endif /* DNS_LOOKUP_LOCAL_EXTERN */
       /* send DNS packet for this entry */
       err = dns_send(i);
       if (err != ERR_OK) {
@@ -1087,6 +1156,12 @@ dns_check_entry(u8_t i)
       }
       break;
     case DNS_STATE_ASKING:
+#ifdef DNS_LOOKUP_LOCAL_EXTERN
+      if (entry->is_local) {
+        dns_check_local_entry(i);
+        break;
+      }
+#endif /* DNS_LOOKUP_LOCAL_EXTERN */
       if (--entry->tmr == 0) {
         if (++entry->retries == DNS_MAX_RETRIES) {
           if (dns_backupserver_available(entry)
@@ -1392,7 +1467,8 @@ ignore_packet:
  */
 static err_t
 dns_enqueue(const char *name, size_t hostnamelen, dns_found_callback found,
-            void *callback_arg LWIP_DNS_ADDRTYPE_ARG(u8_t dns_addrtype) LWIP_DNS_ISMDNS_ARG(u8_t is_mdns))
+            void *callback_arg LWIP_DNS_ADDRTYPE_ARG(u8_t dns_addrtype) LWIP_DNS_ISMDNS_ARG(u8_t is_mdns)
+            LWIP_DNS_ISLOCAL_ARG(u8_t is_local))
 {
   u8_t i;
   u8_t lseq, lseqi;
@@ -1515,6 +1591,9 @@ dns_enqueue(const char *name, size_t hostnamelen, dns_found_callback found,
 #if LWIP_DNS_SUPPORT_MDNS_QUERIES
   entry->is_mdns = is_mdns;
 #endif
+#ifdef DNS_LOOKUP_LOCAL_EXTERN
+  entry->is_local = is_local;
+#endif
 
   dns_seqno++;
 
@@ -1571,8 +1650,12 @@ dns_gethostbyname_addrtype(const char *hostname, ip_addr_t *addr, dns_found_call
                            void *callback_arg, u8_t dns_addrtype)
 {
   size_t hostnamelen;
+  err_t err;
 #if LWIP_DNS_SUPPORT_MDNS_QUERIES
   u8_t is_mdns;
+#endif
+#ifdef DNS_LOOKUP_LOCAL_EXTERN
+  u8_t is_local = 0;
 #endif
   /* not initialized or no valid server yet, or invalid addr pointer
    * or invalid hostname or invalid hostname length */
@@ -1613,9 +1696,14 @@ dns_gethostbyname_addrtype(const char *hostname, ip_addr_t *addr, dns_found_call
     }
   }
   /* already have this address cached? */
-  if (dns_lookup(hostname, hostnamelen, addr LWIP_DNS_ADDRTYPE_ARG(dns_addrtype)) == ERR_OK) {
+  err = dns_lookup(hostname, hostnamelen, addr LWIP_DNS_ADDRTYPE_ARG(dns_addrtype));
+  if (err == ERR_OK) {
     return ERR_OK;
   }
+#ifdef DNS_LOOKUP_LOCAL_EXTERN
+  /* DNS_LOOKUP_LOCAL_EXTERN is resolving it, don't send a second query */
+  is_local = (err == ERR_INPROGRESS);
+#endif
 #if LWIP_IPV4 && LWIP_IPV6
   if ((dns_addrtype == LWIP_DNS_ADDRTYPE_IPV4_IPV6) || (dns_addrtype == LWIP_DNS_ADDRTYPE_IPV6_IPV4)) {
     /* fallback to 2nd IP type and try again to lookup */
@@ -1625,9 +1713,13 @@ dns_gethostbyname_addrtype(const char *hostname, ip_addr_t *addr, dns_found_call
     } else {
       fallback = LWIP_DNS_ADDRTYPE_IPV4;
     }
-    if (dns_lookup(hostname, hostnamelen, addr LWIP_DNS_ADDRTYPE_ARG(fallback)) == ERR_OK) {
+    err = dns_lookup(hostname, hostnamelen, addr LWIP_DNS_ADDRTYPE_ARG(fallback));
+    if (err == ERR_OK) {
       return ERR_OK;
     }
+#ifdef DNS_LOOKUP_LOCAL_EXTERN
+    is_local = (u8_t)(is_local || (err == ERR_INPROGRESS));
+#endif
   }
 #else /* LWIP_IPV4 && LWIP_IPV6 */
   LWIP_UNUSED_ARG(dns_addrtype);
@@ -1642,6 +1734,9 @@ dns_gethostbyname_addrtype(const char *hostname, ip_addr_t *addr, dns_found_call
 
   if (!is_mdns)
 #endif /* LWIP_DNS_SUPPORT_MDNS_QUERIES */
+#ifdef DNS_LOOKUP_LOCAL_EXTERN
+    if (!is_local)
+#endif /* DNS_LOOKUP_LOCAL_EXTERN */
   {
     /* prevent calling found callback if no server is set, return error instead */
     if (ip_addr_isany_val(dns_servers[0])) {
@@ -1651,7 +1746,7 @@ dns_gethostbyname_addrtype(const char *hostname, ip_addr_t *addr, dns_found_call
 
   /* queue query with specified callback */
   return dns_enqueue(hostname, hostnamelen, found, callback_arg LWIP_DNS_ADDRTYPE_ARG(dns_addrtype)
-                     LWIP_DNS_ISMDNS_ARG(is_mdns));
+                     LWIP_DNS_ISMDNS_ARG(is_mdns) LWIP_DNS_ISLOCAL_ARG(is_local));
 }
 
 #endif /* LWIP_DNS */
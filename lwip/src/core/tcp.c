@@ -183,6 +183,9 @@ struct tcp_pcb **const tcp_pcb_lists[] = {&tcp_listen_pcbs.pcbs, &tcp_bound_pcbs
 };
 
 u8_t tcp_active_pcbs_changed;
+#if LWIP_PCB_LISTS_GENERATION
+u32_t tcp_pcb_lists_generation;
+#endif /* LWIP_PCB_LISTS_GENERATION */
 
 /** Timer counter to handle calling slow-timer from tcp_tmr() */
 static u8_t tcp_timer;
@@ -1396,6 +1399,7 @@ tcp_slowtmr_start:
         LWIP_ASSERT("tcp_slowtmr: first pcb == tcp_active_pcbs", tcp_active_pcbs == pcb);
         tcp_active_pcbs = pcb->next;
       }
+      TCP_PCB_LISTS_CHANGED();
 
       if (pcb_reset) {
         tcp_rst(pcb, pcb->snd_nxt, pcb->rcv_nxt, &pcb->local_ip, &pcb->remote_ip,
@@ -1462,6 +1466,7 @@ tcp_slowtmr_start:
         LWIP_ASSERT("tcp_slowtmr: first pcb == tcp_tw_pcbs", tcp_tw_pcbs == pcb);
         tcp_tw_pcbs = pcb->next;
       }
+      TCP_PCB_LISTS_CHANGED();
       pcb2 = pcb;
       pcb = pcb->next;
       tcp_free(pcb2);
@@ -2347,6 +2352,7 @@ tcp_netif_ip_addr_changed(const ip_addr_t *old_addr, const ip_addr_t *new_addr)
           /* The PCB is listening to the old ipaddr and
             * is set to listen to the new one instead */
           ip_addr_copy(lpcb->local_ip, *new_addr);
+          TCP_PCB_LISTS_CHANGED();
         }
       }
     }
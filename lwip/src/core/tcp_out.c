@@ -1299,6 +1299,7 @@ tcp_output(struct tcp_pcb *pcb)
       return ERR_RTE;
     }
     ip_addr_copy(pcb->local_ip, *local_ip);
+    TCP_PCB_LISTS_CHANGED();
   }
 
   /* Handle the current segment not fitting within the window */
@@ -79,6 +79,13 @@ static u16_t udp_port = UDP_LOCAL_PORT_RANGE_START;
 /* The list of UDP PCBs */
 /* exported in udp.h (was static) */
 struct udp_pcb *udp_pcbs;
+#if LWIP_PCB_LISTS_GENERATION
+/* exported in udp.h */
+u32_t udp_pcbs_generation;
+#define UDP_PCBS_CHANGED() udp_pcbs_generation++
+#else /* LWIP_PCB_LISTS_GENERATION */
+#define UDP_PCBS_CHANGED()
+#endif /* LWIP_PCB_LISTS_GENERATION */
 
 /**
  * Initialize this module.
@@ -1015,6 +1022,7 @@ udp_bind(struct udp_pcb *pcb, const ip_addr_t *ipaddr, u16_t port)
   ip_addr_set_ipaddr(&pcb->local_ip, ipaddr);
 
   pcb->local_port = port;
+  UDP_PCBS_CHANGED();
   mib2_udp_bind(pcb);
   /* pcb not active yet? */
   if (rebind == 0) {
@@ -1098,6 +1106,7 @@ udp_connect(struct udp_pcb *pcb, const ip_addr_t *ipaddr, u16_t port)
 
   pcb->remote_port = port;
   pcb->flags |= UDP_FLAGS_CONNECTED;
+  UDP_PCBS_CHANGED();
 
   LWIP_DEBUGF(UDP_DEBUG | LWIP_DBG_TRACE | LWIP_DBG_STATE, ("udp_connect: connected to "));
   ip_addr_debug_print_val(UDP_DEBUG | LWIP_DBG_TRACE | LWIP_DBG_STATE,
@@ -1143,6 +1152,7 @@ udp_disconnect(struct udp_pcb *pcb)
 #endif
   pcb->remote_port = 0;
   pcb->netif_idx = NETIF_NO_INDEX;
+  UDP_PCBS_CHANGED();
   /* mark PCB as unconnected */
   udp_clear_flags(pcb, UDP_FLAGS_CONNECTED);
 }
@@ -1187,6 +1197,7 @@ udp_remove(struct udp_pcb *pcb)
   LWIP_ERROR("udp_remove: invalid pcb", pcb != NULL, return);
 
   mib2_udp_unbind(pcb);
+  UDP_PCBS_CHANGED();
   /* pcb to be removed is first in list? */
   if (udp_pcbs == pcb) {
     /* make list start at 2nd pcb */
@@ -1288,6 +1299,7 @@ void udp_netif_ip_addr_changed(const ip_addr_t *old_addr, const ip_addr_t *new_a
         /* The PCB is bound to the old ipaddr and
          * is set to bound to the new one instead */
         ip_addr_copy(upcb->local_ip, *new_addr);
+        UDP_PCBS_CHANGED();
       }
     }
   }
@@ -99,6 +99,25 @@ struct altcp_tls_config *altcp_tls_create_config_client_2wayauth(const u8_t *ca,
  */
 void altcp_tls_free_config(struct altcp_tls_config *conf);
 
+/** @ingroup altcp_tls
+ * Handshake statistics of an ALTCP_TLS configuration handle
+ */
+struct altcp_tls_handshake_stats {
+  /** Number of full handshakes completed */
+  u32_t full;
+  /** Number of abbreviated handshakes completed (client session resumed) */
+  u32_t resumed;
+  /** Milliseconds spent processing full handshakes (not counting waiting for the peer) */
+  u32_t full_ms;
+  /** Milliseconds spent processing abbreviated handshakes */
+  u32_t resumed_ms;
+};
+
+/** @ingroup altcp_tls
+ * Get handshake statistics of all connections created with an ALTCP_TLS configuration handle
+ */
+void altcp_tls_get_handshake_stats(struct altcp_tls_config *conf, struct altcp_tls_handshake_stats *stats);
+
 /** @ingroup altcp_tls
  * Create new ALTCP_TLS layer wrapping an existing pcb as inner connection (e.g. TLS over TCP)
  */
@@ -82,6 +82,29 @@
 #define ALTCP_MBEDTLS_SESSION_CACHE_TIMEOUT_SECONDS   (60 * 60)
 #endif
 
+/** Enable the client session cache: sessions (including session tickets) of
+ * client connections are saved per configuration, keyed by server name (as set
+ * with mbedtls_ssl_set_hostname() before connecting) or server IP address, and
+ * port. Connecting to the same server again offers the saved session to resume
+ * it with an abbreviated handshake.
+ * ATTENTION: Using a session cache can lower security by reusing keys!
+ */
+#ifndef ALTCP_MBEDTLS_USE_CLIENT_SESSION_CACHE
+#define ALTCP_MBEDTLS_USE_CLIENT_SESSION_CACHE        0
+#endif
+
+/** Number of servers of the client session cache (per client configuration) */
+#ifndef ALTCP_MBEDTLS_CLIENT_SESSION_CACHE_SIZE
+#define ALTCP_MBEDTLS_CLIENT_SESSION_CACHE_SIZE       4
+#endif
+
+/** Maximum length of a server name stored in the client session cache.
+ * Sessions of servers with longer names are not cached.
+ */
+#ifndef ALTCP_MBEDTLS_CLIENT_SESSION_HOST_LEN
+#define ALTCP_MBEDTLS_CLIENT_SESSION_HOST_LEN         64
+#endif
+
 /** Use session tickets to speed up connection setup (needs
  * MBEDTLS_SSL_SESSION_TICKETS enabled in mbedTLS config).
  * ATTENTION: Using session tickets can lower security by reusing keys!
@@ -100,6 +123,67 @@
 #define ALTCP_MBEDTLS_SESSION_TICKET_TIMEOUT_SECONDS  (60 * 60 * 24)
 #endif
 
+/** Coalesce application data written with TCP_WRITE_FLAG_MORE into one TLS record
+ * of up to this many bytes instead of encrypting each write into its own record.
+ * The buffer is allocated from the heap per connection while data is pending and
+ * is sent on a write without TCP_WRITE_FLAG_MORE, on altcp_output() or from the
+ * sent/poll callbacks. TCP_MSS is a good value when enabling this.
+ * 0 (default) disables coalescing.
+ */
+#ifndef ALTCP_MBEDTLS_TX_COALESCE_LEN
+#define ALTCP_MBEDTLS_TX_COALESCE_LEN                 0
+#endif
+
+/** ALTCP_MBEDTLS_MEM_POOLS==1: allocate the mbedTLS memory of connections (and the
+ * altcp_tls connection state) from dedicated size-class pools (memp) instead of the
+ * lwIP heap, so that TLS cannot fragment the heap or take heap space used by TCP and
+ * pbufs. An allocation is taken from the smallest class it fits in, or from the next
+ * larger class if that one is exhausted. Needs MBEDTLS_PLATFORM_MEMORY.
+ * Configurations are long-lived: altcp_tls_create_config_*() and their certificates
+ * and keys still use the heap. mbedTLS memory allocation functions are global, so
+ * other users of mbedTLS in the application allocate from the pools, too.
+ * The number of blocks of each class has to be at least 1. Pool usage and high-water
+ * marks are available via MEMP_STATS and ALTCP_MBEDTLS_PLATFORM_ALLOC_STATS.
+ */
+#ifndef ALTCP_MBEDTLS_MEM_POOLS
+#define ALTCP_MBEDTLS_MEM_POOLS                       0
+#endif
+
+/** Number of 64 byte blocks (ALTCP_MBEDTLS_MEM_POOLS==1) */
+#ifndef ALTCP_MBEDTLS_MEM_POOL_64_NUM
+#define ALTCP_MBEDTLS_MEM_POOL_64_NUM                 64
+#endif
+
+/** Number of 256 byte blocks (ALTCP_MBEDTLS_MEM_POOLS==1) */
+#ifndef ALTCP_MBEDTLS_MEM_POOL_256_NUM
+#define ALTCP_MBEDTLS_MEM_POOL_256_NUM                32
+#endif
+
+/** Number of 1024 byte blocks (ALTCP_MBEDTLS_MEM_POOLS==1) */
+#ifndef ALTCP_MBEDTLS_MEM_POOL_1K_NUM
+#define ALTCP_MBEDTLS_MEM_POOL_1K_NUM                 12
+#endif
+
+/** Number of 4096 byte blocks (ALTCP_MBEDTLS_MEM_POOLS==1) */
+#ifndef ALTCP_MBEDTLS_MEM_POOL_4K_NUM
+#define ALTCP_MBEDTLS_MEM_POOL_4K_NUM                 4
+#endif
+
+/** Size of the largest blocks, used for the TLS record input/output buffers of each
+ * connection: must fit MBEDTLS_SSL_IN_BUFFER_LEN and MBEDTLS_SSL_OUT_BUFFER_LEN
+ * (ALTCP_MBEDTLS_MEM_POOLS==1)
+ */
+#ifndef ALTCP_MBEDTLS_MEM_POOL_RECORD_SIZE
+#define ALTCP_MBEDTLS_MEM_POOL_RECORD_SIZE            (17 * 1024)
+#endif
+
+/** Number of record buffer blocks: 2 per concurrent TLS connection
+ * (ALTCP_MBEDTLS_MEM_POOLS==1)
+ */
+#ifndef ALTCP_MBEDTLS_MEM_POOL_RECORD_NUM
+#define ALTCP_MBEDTLS_MEM_POOL_RECORD_NUM             2
+#endif
+
 #endif /* LWIP_ALTCP */
 
 #endif /* LWIP_HDR_ALTCP_TLS_OPTS_H */
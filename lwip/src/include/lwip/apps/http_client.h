@@ -61,6 +61,45 @@ extern "C" {
 #define LWIP_HTTPC_HAVE_FILE_IO   0
 #endif
 
+/**
+ * @ingroup httpc
+ * LWIP_HTTPC_KEEPALIVE==1: use HTTP/1.1 persistent connections. Connections
+ * are kept open in a pool and reused for further requests to the same server
+ * (host:port). Requests to a busy connection are queued and pipelined once the
+ * server has kept the connection open after a response.
+ * The response body is delimited by Content-Length or chunked transfer
+ * encoding, which is decoded. As data following a response belongs to the
+ * next one, the body cannot be refused: recv_fn must return ERR_OK (or
+ * ERR_ABRT), other errors abort the request.
+ */
+#ifndef LWIP_HTTPC_KEEPALIVE
+#define LWIP_HTTPC_KEEPALIVE      0
+#endif
+
+/**
+ * @ingroup httpc
+ * Number of connections in the keep-alive pool
+ */
+#ifndef LWIP_HTTPC_POOL_SIZE
+#define LWIP_HTTPC_POOL_SIZE      2
+#endif
+
+/**
+ * @ingroup httpc
+ * Maximum number of requests queued on one pooled connection
+ */
+#ifndef LWIP_HTTPC_PIPELINE_MAX
+#define LWIP_HTTPC_PIPELINE_MAX   4
+#endif
+
+/**
+ * @ingroup httpc
+ * Seconds an unused pooled connection is kept open
+ */
+#ifndef LWIP_HTTPC_IDLE_TIMEOUT
+#define LWIP_HTTPC_IDLE_TIMEOUT   10
+#endif
+
 /**
  * @ingroup httpc
  * The default TCP port used for HTTP
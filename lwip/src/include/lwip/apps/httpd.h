@@ -80,9 +80,17 @@ extern "C" {
  * later in the request). Attempts to use the POST method will result in the
  * request being ignored.
  *
+ * If LWIP_HTTPD_CGI_ASYNC is enabled, the handler gets the additional
+ * argument 'connection' and may return HTTPD_CGI_PENDING if the response is
+ * not known yet: it must then call httpd_cgi_continue(connection, uri) later.
+ * pcParam and pcValue are only valid during the call, copy what is needed.
  */
 typedef const char *(*tCGIHandler)(int iIndex, int iNumParams, char *pcParam[],
-                             char *pcValue[]);
+                             char *pcValue[]
+#if LWIP_HTTPD_CGI_ASYNC
+                             , void *connection
+#endif /* LWIP_HTTPD_CGI_ASYNC */
+                             );
 
 /**
  * @ingroup httpd
@@ -97,6 +105,17 @@ typedef struct
 
 void http_set_cgi_handlers(const tCGI *pCGIs, int iNumHandlers);
 
+#if LWIP_HTTPD_CGI_ASYNC
+extern const char httpd_cgi_pending[];
+/** For LWIP_HTTPD_CGI_ASYNC==1, return this from the CGI handler if the
+ * response URI is not known yet: nothing is sent on the connection until the
+ * application calls httpd_cgi_continue(connection, uri).
+ */
+#define HTTPD_CGI_PENDING httpd_cgi_pending
+
+void httpd_cgi_continue(void *connection, const char *uri);
+#endif /* LWIP_HTTPD_CGI_ASYNC */
+
 #endif /* LWIP_HTTPD_CGI */
 
 #if LWIP_HTTPD_CGI || LWIP_HTTPD_CGI_SSI
@@ -166,6 +185,9 @@ typedef u16_t (*tSSIHandler)(
 #if defined(LWIP_HTTPD_FILE_STATE) && LWIP_HTTPD_FILE_STATE
                              , void *connection_state
 #endif /* LWIP_HTTPD_FILE_STATE */
+#if LWIP_HTTPD_SSI_ASYNC
+                             , void *connection
+#endif /* LWIP_HTTPD_SSI_ASYNC */
                              );
 
 /** Set the SSI handler function
@@ -180,6 +202,16 @@ void http_set_ssi_handler(tSSIHandler pfnSSIHandler,
  */
 #define HTTPD_SSI_TAG_UNKNOWN 0xFFFF
 
+#if LWIP_HTTPD_SSI_ASYNC
+/** For LWIP_HTTPD_SSI_ASYNC==1, return this if the insert data is not
+ * available yet: the handler is called again for the same tag (and tag part)
+ * after the application has called httpd_ssi_continue(connection).
+ */
+#define HTTPD_SSI_TAG_PENDING 0xFFFE
+
+void httpd_ssi_continue(void *connection);
+#endif /* LWIP_HTTPD_SSI_ASYNC */
+
 #endif /* LWIP_HTTPD_SSI */
 
 #if LWIP_HTTPD_SUPPORT_POST
@@ -195,7 +227,9 @@ void http_set_ssi_handler(tSSIHandler pfnSSIHandler,
  *        is called.
  * @param uri The HTTP header URI receiving the POST request.
  * @param http_request The raw HTTP request (the first packet, normally).
- * @param http_request_len Size of 'http_request'.
+ *        NULL with LWIP_HTTPD_STREAMING_PARSER, which does not keep the
+ *        request in memory (see httpd_header_received()).
+ * @param http_request_len Size of 'http_request' (0 if it is NULL).
  * @param content_len Content-Length from HTTP header.
  * @param response_uri Filename of response file, to be filled when denying the
  *        request
@@ -241,6 +275,27 @@ void httpd_post_data_recved(void *connection, u16_t recved_len);
 
 #endif /* LWIP_HTTPD_SUPPORT_POST */
 
+#if LWIP_HTTPD_STREAMING_PARSER && LWIP_HTTPD_HEADER_CALLBACK
+/**
+ * @ingroup httpd
+ * Called for every header of a request (must be implemented by the application).
+ * The value is passed as it is found in the received pbufs, so one header may
+ * result in multiple calls: 'value_complete' is set for the last fragment
+ * (which may be empty).
+ * All headers are passed before httpd_post_begin() (or the CGI handler for
+ * GET requests) is called for the same connection.
+ *
+ * @param connection Unique connection identifier (same as for httpd_post_begin).
+ * @param uri The request URI (including parameters).
+ * @param name Header name (NULL-terminated, truncated to LWIP_HTTPD_MAX_HEADER_NAME_LEN).
+ * @param value Fragment of the header value (not NULL-terminated).
+ * @param value_len Length of 'value'.
+ * @param value_complete 1 if this is the last fragment of this header's value.
+ */
+void httpd_header_received(void *connection, const char *uri, const char *name,
+                           const char *value, u16_t value_len, u8_t value_complete);
+#endif /* LWIP_HTTPD_STREAMING_PARSER && LWIP_HTTPD_HEADER_CALLBACK */
+
 void httpd_init(void);
 
 #if HTTPD_ENABLE_HTTPS
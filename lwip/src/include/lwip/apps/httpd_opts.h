@@ -65,6 +65,17 @@
 #define LWIP_HTTPD_CGI            0
 #endif
 
+/** LWIP_HTTPD_CGI_ASYNC==1: CGI handler function (old style) is called with
+ * one more argument ('connection') and may return HTTPD_CGI_PENDING if the
+ * response URI is not known yet (instead of blocking). The connection then
+ * waits until the application calls httpd_cgi_continue(connection, uri)
+ * (it is closed by the idle poll timeout if that takes too long).
+ * Requires LWIP_HTTPD_CGI.
+ */
+#if !defined LWIP_HTTPD_CGI_ASYNC || defined __DOXYGEN__
+#define LWIP_HTTPD_CGI_ASYNC      0
+#endif
+
 /** Set this to 1 to support CGI (new style).
  *
  * This new style CGI support works by calling a global function
@@ -149,6 +160,19 @@
 #define LWIP_HTTPD_SSI_MULTIPART    0
 #endif
 
+/** LWIP_HTTPD_SSI_ASYNC==1: SSI handler function is called with one more
+ * argument ('connection') and may return HTTPD_SSI_TAG_PENDING if the insert
+ * data is not available yet (instead of blocking). Sending this connection is
+ * then suspended until the application calls httpd_ssi_continue(connection),
+ * which calls the SSI handler again for the same tag (and tag part).
+ * Combined with LWIP_HTTPD_SSI_MULTIPART, this allows streaming inserts of any
+ * size chunk by chunk as the data becomes available: the handler is only called
+ * for the next chunk when the previous one has been passed to tcp.
+ */
+#if !defined LWIP_HTTPD_SSI_ASYNC || defined __DOXYGEN__
+#define LWIP_HTTPD_SSI_ASYNC        0
+#endif
+
 /* The maximum length of the string comprising the SSI tag name
  * ATTENTION: tags longer than this are ignored, not truncated!
  */
@@ -258,9 +282,23 @@
 #define LWIP_HTTPD_SUPPORT_11_KEEPALIVE     0
 #endif
 
+/** Set this to 1 to parse requests with a resumable state machine instead of
+ * collecting them in pbuf queues and searching the copied data.
+ * Every received byte is looked at exactly once, no matter how the request is
+ * split into segments. Only the URI (@see LWIP_HTTPD_STREAMING_MAX_URI_LEN) is
+ * stored in the connection state, headers are never copied, so the request
+ * size is not limited by LWIP_HTTPD_REQ_BUFSIZE or LWIP_HTTPD_REQ_QUEUELEN
+ * (LWIP_HTTPD_SUPPORT_REQUESTLIST must be 0, which is its default then).
+ * ATTENTION: httpd_post_begin() is called with http_request == NULL in this
+ * mode (use @ref LWIP_HTTPD_HEADER_CALLBACK to inspect request headers).
+ */
+#if !defined LWIP_HTTPD_STREAMING_PARSER || defined __DOXYGEN__
+#define LWIP_HTTPD_STREAMING_PARSER         0
+#endif
+
 /** Set this to 1 to support HTTP request coming in in multiple packets/pbufs */
 #if !defined LWIP_HTTPD_SUPPORT_REQUESTLIST || defined __DOXYGEN__
-#define LWIP_HTTPD_SUPPORT_REQUESTLIST      1
+#define LWIP_HTTPD_SUPPORT_REQUESTLIST      (!LWIP_HTTPD_STREAMING_PARSER)
 #endif
 
 #if LWIP_HTTPD_SUPPORT_REQUESTLIST
@@ -284,6 +322,55 @@
 #endif
 #endif /* LWIP_HTTPD_SUPPORT_REQUESTLIST */
 
+
+#if LWIP_HTTPD_STREAMING_PARSER
+/** Maximum length of the request URI (including parameters) accepted by the
+ * streaming parser. Longer URIs are answered with 'bad request'. */
+#if !defined LWIP_HTTPD_STREAMING_MAX_URI_LEN || defined __DOXYGEN__
+#define LWIP_HTTPD_STREAMING_MAX_URI_LEN    127
+#endif
+
+/** Maximum number of bytes (request line plus all headers) accepted by the
+ * streaming parser before the request is rejected as 'bad request'.
+ * This does not cost memory, it only limits the time a client can occupy
+ * a connection with headers. Set to 0 for no limit. */
+#if !defined LWIP_HTTPD_STREAMING_MAX_HDR_LEN || defined __DOXYGEN__
+#define LWIP_HTTPD_STREAMING_MAX_HDR_LEN    8192
+#endif
+
+/** Set this to 1 to get every request header passed to the application via
+ * httpd_header_received() (which must then be implemented by the application).
+ * Header values are passed in fragments as they are found in the received
+ * pbufs, so they are not copied either. */
+#if !defined LWIP_HTTPD_HEADER_CALLBACK || defined __DOXYGEN__
+#define LWIP_HTTPD_HEADER_CALLBACK          0
+#endif
+
+/** Maximum length of a header name passed to httpd_header_received().
+ * Longer names are truncated. */
+#if !defined LWIP_HTTPD_MAX_HEADER_NAME_LEN || defined __DOXYGEN__
+#define LWIP_HTTPD_MAX_HEADER_NAME_LEN      31
+#endif
+#endif /* LWIP_HTTPD_STREAMING_PARSER */
+
+/** Set this to 1 to support upgrading connections to WebSockets (RFC 6455).
+ * URIs are registered with httpd_ws_set_handlers() (see httpd_ws.h).
+ * Requires LWIP_HTTPD_STREAMING_PARSER.
+ */
+#if !defined LWIP_HTTPD_WEBSOCKET || defined __DOXYGEN__
+#define LWIP_HTTPD_WEBSOCKET                0
+#endif
+
+#if LWIP_HTTPD_WEBSOCKET
+/** Number of frames that can be queued for sending per WebSocket connection.
+ * Frames are queued as pbufs (a broadcast frame is shared by all queues) and
+ * passed to TCP without copying, so a frame occupies its queue entry until
+ * it has been acknowledged. */
+#if !defined LWIP_HTTPD_WS_TX_QUEUE_LEN || defined __DOXYGEN__
+#define LWIP_HTTPD_WS_TX_QUEUE_LEN          8
+#endif
+#endif /* LWIP_HTTPD_WEBSOCKET */
+
 /** This is the size of a static buffer used when URIs end with '/'.
  * In this buffer, the directory requested is concatenated with all the
  * configured default file names.
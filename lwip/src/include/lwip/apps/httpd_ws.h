@@ -0,0 +1,113 @@
+/**
+ * @file
+ * HTTP server WebSocket support
+ */
+
+/*
+ * Copyright (c) 2001-2003 Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the lwIP TCP/IP stack.
+ *
+ */
+
+#ifndef LWIP_HDR_APPS_HTTPD_WS_H
+#define LWIP_HDR_APPS_HTTPD_WS_H
+
+#include "httpd_opts.h"
+#include "lwip/err.h"
+
+#if LWIP_HTTPD_WEBSOCKET
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** WebSocket frame opcodes */
+#define HTTPD_WS_OPCODE_CONTINUATION  0x0
+#define HTTPD_WS_OPCODE_TEXT          0x1
+#define HTTPD_WS_OPCODE_BINARY        0x2
+#define HTTPD_WS_OPCODE_CLOSE         0x8
+#define HTTPD_WS_OPCODE_PING          0x9
+#define HTTPD_WS_OPCODE_PONG          0xA
+
+/** Flags passed to the receive callback */
+/** The data is the start of a new message */
+#define HTTPD_WS_FLAG_FIRST           0x01
+/** The data is the end of the current message */
+#define HTTPD_WS_FLAG_LAST            0x02
+
+/** WebSocket close status codes (RFC 6455 section 7.4.1) */
+#define HTTPD_WS_CLOSE_NORMAL         1000
+#define HTTPD_WS_CLOSE_GOING_AWAY     1001
+#define HTTPD_WS_CLOSE_PROTOCOL_ERROR 1002
+#define HTTPD_WS_CLOSE_NO_STATUS      1005
+#define HTTPD_WS_CLOSE_ABNORMAL       1006
+#define HTTPD_WS_CLOSE_TOO_BIG        1009
+
+/** Maximum payload that can be passed to httpd_ws_send() and httpd_ws_broadcast() */
+#define HTTPD_WS_MAX_PAYLOAD          (0xFFFF - 4)
+
+struct httpd_ws_conn;
+
+/**
+ * @ingroup httpd
+ * Callbacks for a URI that can be upgraded to a WebSocket connection.
+ */
+struct httpd_ws_handler {
+  /** URI (without parameters) of the WebSocket endpoint, e.g. "/ws" */
+  const char *uri;
+  /** Called when a client requests an upgrade for 'uri'. 'request_uri' is the
+   * complete request URI (including parameters).
+   * Return ERR_OK to accept the connection, any other value closes it. */
+  err_t (*connected)(struct httpd_ws_conn *conn, const char *request_uri);
+  /** Called for received data. Fragmented messages and messages larger than one
+   * pbuf are passed in parts: HTTPD_WS_FLAG_FIRST is set for the first part,
+   * HTTPD_WS_FLAG_LAST for the last part of a message (both may be set).
+   * 'opcode' is the opcode of the message (TEXT or BINARY), also for
+   * continuation frames. 'data' points into the (unmasked) received pbuf and
+   * is only valid during the callback. */
+  void (*recv)(struct httpd_ws_conn *conn, u8_t opcode, const u8_t *data, u16_t len, u8_t flags);
+  /** Called when the connection is closed (by either side or on error).
+   * 'status' is the close status received from the client or
+   * HTTPD_WS_CLOSE_ABNORMAL. 'conn' must not be used after this returns. */
+  void (*closed)(struct httpd_ws_conn *conn, u16_t status);
+};
+
+void  httpd_ws_set_handlers(const struct httpd_ws_handler *handlers, int num_handlers);
+err_t httpd_ws_send(struct httpd_ws_conn *conn, u8_t opcode, const void *data, u16_t len);
+u16_t httpd_ws_broadcast(const struct httpd_ws_handler *handler, u8_t opcode, const void *data, u16_t len);
+err_t httpd_ws_close(struct httpd_ws_conn *conn, u16_t status);
+void  httpd_ws_set_arg(struct httpd_ws_conn *conn, void *arg);
+void *httpd_ws_get_arg(struct httpd_ws_conn *conn);
+const struct httpd_ws_handler *httpd_ws_get_handler(struct httpd_ws_conn *conn);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LWIP_HTTPD_WEBSOCKET */
+
+#endif /* LWIP_HDR_APPS_HTTPD_WS_H */
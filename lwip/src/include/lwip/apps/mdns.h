@@ -97,6 +97,26 @@ void mdns_resp_announce(struct netif *netif);
  */
 #define mdns_resp_netif_settings_changed(netif) mdns_resp_announce(netif)
 
+#if LWIP_MDNS_QUERIER
+
+/** Browse event: a service instance was found */
+#define MDNS_BROWSE_ADDED    1
+/** Browse event: a service instance left or its record expired */
+#define MDNS_BROWSE_REMOVED  0
+
+/** Callback function to let application know about service instances found or lost
+ * while browsing, called with the instance name (like 'myweb') and MDNS_BROWSE_ADDED
+ * or MDNS_BROWSE_REMOVED */
+typedef void (*mdns_browse_result_fn_t)(struct netif *netif, const char *instance, u8_t event, void *arg);
+
+s8_t  mdns_query_browse_start(struct netif *netif, const char *service, enum mdns_sd_proto proto, mdns_browse_result_fn_t result_fn, void *arg);
+err_t mdns_query_browse_stop(s8_t slot);
+
+err_t mdns_query_lookup(const char *name, size_t namelen, ip_addr_t *addr, u8_t dns_addrtype);
+err_t mdns_query_lookup_service(struct netif *netif, const char *instance, const char *service, enum mdns_sd_proto proto, char *host, size_t host_len, u16_t *port);
+
+#endif /* LWIP_MDNS_QUERIER */
+
 #endif /* LWIP_MDNS_RESPONDER */
 
 #ifdef __cplusplus
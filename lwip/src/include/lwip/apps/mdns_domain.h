@@ -63,6 +63,22 @@ err_t mdns_build_reverse_v6_domain(struct mdns_domain *domain, const ip6_addr_t
 err_t mdns_build_host_domain(struct mdns_domain *domain, struct mdns_host *mdns);
 err_t mdns_build_dnssd_domain(struct mdns_domain *domain);
 err_t mdns_build_service_domain(struct mdns_domain *domain, struct mdns_service *service, int include_name);
+err_t mdns_build_named_service_domain(struct mdns_domain *domain, const char *name,
+                                      const char *service, enum mdns_sd_proto proto);
+#if LWIP_MDNS_QUERIER
+err_t mdns_build_name_domain(struct mdns_domain *domain, const char *name, size_t namelen);
+#endif
+#if LWIP_IPV4
+struct mdns_domain *mdns_reverse_v4_domain(struct mdns_host *mdns, const ip4_addr_t *addr, struct mdns_domain *buf);
+#endif
+#if LWIP_IPV6
+struct mdns_domain *mdns_reverse_v6_domain(struct mdns_host *mdns, int addrindex, const ip6_addr_t *addr, struct mdns_domain *buf);
+#endif
+struct mdns_domain *mdns_host_domain(struct mdns_host *mdns, struct mdns_domain *buf);
+struct mdns_domain *mdns_dnssd_domain(struct mdns_domain *buf);
+struct mdns_domain *mdns_service_domain(struct mdns_service *service, int include_name, struct mdns_domain *buf);
+void mdns_host_domain_changed(struct mdns_host *mdns);
+void mdns_service_domain_changed(struct mdns_service *service);
 u16_t mdns_compress_domain(struct pbuf *pbuf, u16_t *offset, struct mdns_domain *domain);
 err_t mdns_write_domain(struct mdns_outpacket *outpkt, struct mdns_domain *domain);
 
@@ -67,6 +67,39 @@
 #define MDNS_RESP_USENETIF_EXTCALLBACK  LWIP_NETIF_EXT_STATUS_CALLBACK
 #endif
 
+/** MDNS_DOMAIN_CACHE==1: keep the encoded domain names of each netif (hostname,
+ * reverse address lookup names) and service (type and instance names). They are
+ * then not encoded again from the names and addresses for every question, known
+ * answer and answer record processed.
+ * Cached names are rebuilt when a netif or service is renamed or an address changes.
+ * Costs about 260 bytes of RAM per name (see struct mdns_domain).
+ */
+#ifndef MDNS_DOMAIN_CACHE
+#define MDNS_DOMAIN_CACHE               0
+#endif
+
+/** LWIP_MDNS_QUERIER==1: Add an mDNS querier to the responder: all A, AAAA, PTR
+ * and SRV records received in responses are kept in a cache until their TTL runs
+ * out, service types can be browsed continuously (see @ref mdns_query_browse_start)
+ * and .local host names can be resolved from the cache, a cache miss sends a
+ * one-shot A/AAAA query whose answer is cached (see @ref mdns_query_lookup).
+ */
+#ifndef LWIP_MDNS_QUERIER
+#define LWIP_MDNS_QUERIER               0
+#endif
+
+/** Number of records in the mDNS querier cache. When the cache is full, the
+ * record closest to expiry is replaced. Costs about 540 bytes of RAM per record.
+ */
+#ifndef MDNS_QUERY_CACHE_SIZE
+#define MDNS_QUERY_CACHE_SIZE           8
+#endif
+
+/** The maximum number of service types browsed at the same time */
+#ifndef MDNS_MAX_BROWSE
+#define MDNS_MAX_BROWSE                 2
+#endif
+
 /**
  * MDNS_DEBUG: Enable debugging for multicast DNS.
  */
@@ -103,6 +103,11 @@ extern "C" {
  */
 #define MDNS_MULTICAST_TIMEOUT_25TTL  30000
 
+err_t mdns_add_question(struct mdns_outpacket *outpkt, struct mdns_domain *domain,
+                        u16_t type, u16_t klass, u16_t unicast);
+err_t mdns_add_answer(struct mdns_outpacket *reply, struct mdns_domain *domain,
+                      u16_t type, u16_t klass, u16_t cache_flush, u32_t ttl,
+                      const u8_t *buf, size_t buf_length, struct mdns_domain *answer_domain);
 err_t mdns_create_outpacket(struct netif *netif, struct mdns_outmsg *msg,
                             struct mdns_outpacket *outpkt);
 err_t mdns_send_outpacket(struct mdns_outmsg *msg, struct netif *netif);
@@ -99,6 +99,12 @@ struct mdns_service {
   u16_t proto;
   /** Port of the service */
   u16_t port;
+#if MDNS_DOMAIN_CACHE
+  /** Cached \<type\>.\<proto\>.local. domain, invalid if length is 0 */
+  struct mdns_domain type_domain;
+  /** Cached \<name\>.\<type\>.\<proto\>.local. domain, invalid if length is 0 */
+  struct mdns_domain instance_domain;
+#endif /* MDNS_DOMAIN_CACHE */
 };
 
 /** mDNS output packet */
@@ -212,11 +218,32 @@ struct mdns_host {
   u8_t index;
   /** number of conflicts since startup */
   u8_t num_conflicts;
+#if MDNS_DOMAIN_CACHE
+  /** Cached \<hostname\>.local. domain, invalid if length is 0 */
+  struct mdns_domain host_domain;
+#if LWIP_IPV4
+  /** Cached reverse lookup domain of reverse_v4_addr, invalid if length is 0 */
+  struct mdns_domain reverse_v4_domain;
+  ip4_addr_t reverse_v4_addr;
+#endif
+#if LWIP_IPV6
+  /** Cached reverse lookup domains of reverse_v6_addr, invalid if length is 0 */
+  struct mdns_domain reverse_v6_domain[LWIP_IPV6_NUM_ADDRESSES];
+  ip6_addr_t reverse_v6_addr[LWIP_IPV6_NUM_ADDRESSES];
+#endif
+#endif /* MDNS_DOMAIN_CACHE */
 };
 
 struct mdns_host* netif_mdns_data(struct netif *netif);
 struct udp_pcb* get_mdns_pcb(void);
 
+#if LWIP_MDNS_QUERIER
+void mdns_query_cache_answer(struct netif *netif, struct mdns_domain *name, u16_t type,
+                             u16_t cache_flush, u32_t ttl, struct pbuf *p,
+                             u16_t rd_offset, u16_t rd_length);
+void mdns_query_netif_removed(struct netif *netif);
+#endif /* LWIP_MDNS_QUERIER */
+
 #endif /* LWIP_MDNS_RESPONDER */
 
 #ifdef __cplusplus
@@ -48,6 +48,8 @@ extern "C" {
 
 typedef struct mqtt_client_s mqtt_client_t;
 
+struct pbuf;
+
 #if LWIP_ALTCP && LWIP_ALTCP_TLS
 struct altcp_tls_config;
 #endif
@@ -91,7 +93,9 @@ struct mqtt_connect_client_info_t {
 
 /**
  * @ingroup mqtt
- * Connection status codes */
+ * Connection status codes.
+ * With MQTT 5 (LWIP_MQTT_V5), a refused connection reports the CONNACK reason code
+ * (0x80 and above) instead of the MQTT_CONNECT_REFUSED_xxx values. */
 typedef enum
 {
   /** Accepted */
@@ -160,15 +164,46 @@ typedef void (*mqtt_incoming_data_cb_t)(void *arg, const u8_t *data, u16_t len,
  */
 typedef void (*mqtt_incoming_publish_cb_t)(void *arg, const char *topic, u32_t tot_len);
 
+/**
+ * @ingroup mqtt
+ * Function prototype for streamed incoming publish topic. Called one or more times with
+ * consecutive parts of the topic when a publish arrives, before any payload data.
+ * Topics are not limited by MQTT_VAR_HEADER_BUFFER_LEN. @see mqtt_set_inpub_stream_callback
+ * With MQTT 5 (LWIP_MQTT_V5) the topic is buffered in heap memory until the publish
+ * properties have been received, it is then passed in one call with its topic alias resolved.
+ *
+ * @param arg Additional argument to pass to the callback function
+ * @param topic Part of topic (not zero terminated), may not be referenced after callback return
+ * @param len Length of topic part
+ * @param tot_len Total length of publish payload, if set to 0 (no publish payload) pbuf callback will not be invoked.
+ * @param flags MQTT_DATA_FLAG_LAST set when this call contains the last part of the topic
+ */
+typedef void (*mqtt_incoming_topic_cb_t)(void *arg, const u8_t *topic, u16_t len, u32_t tot_len, u8_t flags);
+
+/**
+ * @ingroup mqtt
+ * Function prototype for incoming publish payload in pbufs. The pbuf (chain) contains the
+ * next part of the payload and is taken from the received data without copying.
+ * @see mqtt_set_inpub_stream_callback
+ *
+ * @param arg Additional argument to pass to the callback function
+ * @param p Payload data, the callback takes ownership and has to free it with pbuf_free()
+ * @param flags MQTT_DATA_FLAG_LAST set when this call contains the last part of data from publish message
+ */
+typedef void (*mqtt_incoming_pbuf_cb_t)(void *arg, struct pbuf *p, u8_t flags);
+
 
 /**
  * @ingroup mqtt
  * Function prototype for mqtt request callback. Called when a subscribe, unsubscribe
- * or publish request has completed
+ * or publish request has completed.
+ * The request has already been removed from the in-flight window when the callback
+ * is called, so the callback may start new requests or call @ref mqtt_disconnect.
  * @param arg Pointer to user data supplied when invoking request
  * @param err ERR_OK on success
  *            ERR_TIMEOUT if no response was received within timeout,
- *            ERR_ABRT if (un)subscribe was denied
+ *            ERR_ABRT if (un)subscribe was denied or a kept session was not resumed
+ *            by the server (see @ref mqtt_client_set_session)
  */
 typedef void (*mqtt_request_cb_t)(void *arg, err_t err);
 
@@ -180,11 +215,14 @@ void mqtt_disconnect(mqtt_client_t *client);
 
 mqtt_client_t *mqtt_client_new(void);
 void mqtt_client_free(mqtt_client_t* client);
+err_t mqtt_client_set_session(mqtt_client_t *client, u16_t inflight_window, u8_t keep_session);
 
 u8_t mqtt_client_is_connected(mqtt_client_t *client);
 
 void mqtt_set_inpub_callback(mqtt_client_t *client, mqtt_incoming_publish_cb_t,
                              mqtt_incoming_data_cb_t data_cb, void *arg);
+void mqtt_set_inpub_stream_callback(mqtt_client_t *client, mqtt_incoming_topic_cb_t topic_cb,
+                                    mqtt_incoming_pbuf_cb_t pbuf_cb, void *arg);
 
 err_t mqtt_sub_unsub(mqtt_client_t *client, const char *topic, u8_t qos, mqtt_request_cb_t cb, void *arg, u8_t sub);
 
@@ -197,6 +235,8 @@ err_t mqtt_sub_unsub(mqtt_client_t *client, const char *topic, u8_t qos, mqtt_re
 
 err_t mqtt_publish(mqtt_client_t *client, const char *topic, const void *payload, u16_t payload_length, u8_t qos, u8_t retain,
                                     mqtt_request_cb_t cb, void *arg);
+err_t mqtt_publish_pbuf(mqtt_client_t *client, const char *topic, struct pbuf *payload, u8_t qos, u8_t retain,
+                        mqtt_request_cb_t cb, void *arg);
 
 #ifdef __cplusplus
 }
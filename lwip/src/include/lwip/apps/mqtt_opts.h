@@ -50,22 +50,36 @@ extern "C" {
  */
 
 /**
- * Output ring-buffer size, must be able to fit largest outgoing publish message topic+payloads
+ * Output ring-buffer size, must be able to fit the largest outgoing message
+ * header (e.g. publish topic). Publish payloads that do not fit are sent from
+ * pbufs instead (see @ref mqtt_publish_pbuf).
  */
 #ifndef MQTT_OUTPUT_RINGBUF_SIZE
 #define MQTT_OUTPUT_RINGBUF_SIZE 256
 #endif
 
+/**
+ * Number of publish payload pbufs that can be queued for output (sent by
+ * reference, without copying into the output ring-buffer).
+ */
+#ifndef MQTT_OUTPUT_PBUF_QUEUE_LEN
+#define MQTT_OUTPUT_PBUF_QUEUE_LEN 4
+#endif
+
 /**
  * Number of bytes in receive buffer, must be at least the size of the longest incoming topic + 8
+ * (with MQTT 5, plus the size of the publish properties)
  * If one wants to avoid fragmented incoming publish, set length to max incoming topic length + max payload length + 8
+ * Incoming publish messages do not use this buffer when streaming callbacks are set
+ * (see @ref mqtt_set_inpub_stream_callback), it must then be at least 16 bytes.
  */
 #ifndef MQTT_VAR_HEADER_BUFFER_LEN
 #define MQTT_VAR_HEADER_BUFFER_LEN 128
 #endif
 
 /**
- * Maximum number of pending subscribe, unsubscribe and publish requests to server .
+ * Default number of pending subscribe, unsubscribe and publish requests to server
+ * (in-flight window), can be changed per client with @ref mqtt_client_set_session.
  */
 #ifndef MQTT_REQ_MAX_IN_FLIGHT
 #define MQTT_REQ_MAX_IN_FLIGHT 4
@@ -92,6 +106,35 @@ extern "C" {
 #define MQTT_CONNECT_TIMOUT 100
 #endif
 
+/**
+ * LWIP_MQTT_V5==1: Speak MQTT 5.0 instead of MQTT 3.1.1: properties, topic aliases,
+ * receive maximum flow control and reason codes.
+ */
+#ifndef LWIP_MQTT_V5
+#define LWIP_MQTT_V5 0
+#endif
+
+/**
+ * MQTT 5: maximum number of outbound topic aliases used per connection (limited by
+ * the Topic Alias Maximum announced by the server). Topics of published messages are
+ * replaced by a 2 byte alias after they have been sent once. 0 disables outbound aliases.
+ * Each alias in use keeps a copy of its topic in heap memory.
+ */
+#ifndef MQTT_TOPIC_ALIAS_OUT_MAX
+#define MQTT_TOPIC_ALIAS_OUT_MAX 8
+#endif
+
+/**
+ * MQTT 5: Topic Alias Maximum announced to the server, i.e. number of inbound topic
+ * aliases resolved by the client. 0 disables inbound aliases. Each alias in use keeps a
+ * copy of its topic in heap memory.
+ * Inbound aliases are resolved for streaming callbacks as well (see
+ * @ref mqtt_set_inpub_stream_callback).
+ */
+#ifndef MQTT_TOPIC_ALIAS_IN_MAX
+#define MQTT_TOPIC_ALIAS_IN_MAX 4
+#endif
+
 /**
  * @}
  */
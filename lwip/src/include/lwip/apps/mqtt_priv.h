@@ -39,6 +39,7 @@
 
 #include "lwip/apps/mqtt.h"
 #include "lwip/altcp.h"
+#include "lwip/pbuf.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -50,15 +51,28 @@ struct mqtt_request_t
   /** Next item in list, NULL means this is the last in chain,
       next pointing at itself means request is unallocated */
   struct mqtt_request_t *next;
+  /** Previous item in list, NULL means this is the first in chain */
+  struct mqtt_request_t *prev;
   /** Callback to upper layer */
   mqtt_request_cb_t cb;
   void *arg;
+  /** Complete PUBLISH packet kept for retransmission when resuming a session */
+  struct pbuf *p;
   /** MQTT packet identifier */
   u16_t pkt_id;
-  /** Expire time relative to element before this  */
-  u16_t timeout_diff;
+  /** Expire time, compared to mqtt_client_s::req_time */
+  u16_t timeout;
+  /** MQTT_REQ_FLAG_xxx */
+  u8_t flags;
 };
 
+/** PUBREC received, PUBREL has to be sent when resuming a session */
+#define MQTT_REQ_FLAG_PUBREL  0x01
+/** Request kept from a previous connection, to be resent when resuming a session */
+#define MQTT_REQ_FLAG_RESUME  0x02
+/** QoS 1 or 2 publish, counted against the server's receive maximum */
+#define MQTT_REQ_FLAG_QOS_PUB 0x04
+
 /** Ring buffer */
 struct mqtt_ringbuf_t {
   u16_t put;
@@ -66,6 +80,18 @@ struct mqtt_ringbuf_t {
   u8_t buf[MQTT_OUTPUT_RINGBUF_SIZE];
 };
 
+/** Publish payload queued for output, sent without copying */
+struct mqtt_out_pbuf_t {
+  struct pbuf *p;
+  /** Number of bytes taken from the output ring-buffer (see mqtt_client_s::ring_sent)
+      before this payload is sent */
+  u32_t ring_mark;
+  /** Value of mqtt_client_s::tx_written after the last byte has been written */
+  u32_t end;
+  /** Number of bytes of p written */
+  u16_t offset;
+};
+
 /** MQTT client */
 struct mqtt_client_s
 {
@@ -80,21 +106,66 @@ struct mqtt_client_s
   /** Connection state */
   u8_t conn_state;
   struct altcp_pcb *conn;
+  /** Closed connection waiting for payload pbufs to be acknowledged */
+  struct altcp_pcb *closing_conn;
   /** Connection callback */
   void *connect_arg;
   mqtt_connection_cb_t connect_cb;
-  /** Pending requests to server */
+  /** Pending requests to server, ordered by creation time */
   struct mqtt_request_t *pend_req_queue;
-  struct mqtt_request_t req_list[MQTT_REQ_MAX_IN_FLIGHT];
+  struct mqtt_request_t *pend_req_tail;
+  /** In-flight window: request slots, indexed by packet identifier modulo req_list_len */
+  struct mqtt_request_t *req_list;
+  u16_t req_list_len;
+  /** Request timer in seconds */
+  u16_t req_time;
+  /** Keep session state across connections (clean session flag cleared) */
+  u8_t keep_session;
+  /** Requests from a previous connection are waiting to be resent */
+  u8_t session_resume;
+  /** Number of QoS 1 and 2 publish requests in pend_req_queue */
+  u16_t qos_pub_inflight;
+#if LWIP_MQTT_V5
+  /** Receive Maximum announced by the server, 0 if not limited */
+  u16_t server_receive_max;
+#if MQTT_TOPIC_ALIAS_OUT_MAX > 0
+  /** Number of outbound topic aliases usable on this connection */
+  u16_t topic_alias_out_max;
+  /** Next outbound alias slot to (re)assign */
+  u16_t topic_alias_out_next;
+  /** Topics of outbound aliases, alias is index + 1 */
+  char *topic_alias_out[MQTT_TOPIC_ALIAS_OUT_MAX];
+#endif /* MQTT_TOPIC_ALIAS_OUT_MAX > 0 */
+#if MQTT_TOPIC_ALIAS_IN_MAX > 0
+  /** Topics of inbound aliases, alias is index + 1 */
+  char *topic_alias_in[MQTT_TOPIC_ALIAS_IN_MAX];
+#endif /* MQTT_TOPIC_ALIAS_IN_MAX > 0 */
+  /** Topic and properties of a streamed incoming publish, until its topic alias is known */
+  u8_t *inpub_hdr;
+#endif /* LWIP_MQTT_V5 */
   void *inpub_arg;
   /** Incoming data callback */
   mqtt_incoming_data_cb_t data_cb;
   mqtt_incoming_publish_cb_t pub_cb;
+  /** Streaming incoming publish callbacks, used instead of the above if pbuf_cb is set */
+  mqtt_incoming_topic_cb_t topic_cb;
+  mqtt_incoming_pbuf_cb_t pbuf_cb;
+  /** Connection has been aborted while processing a TCP callback */
+  u8_t conn_aborted;
   /** Input */
   u32_t msg_idx;
   u8_t rx_buffer[MQTT_VAR_HEADER_BUFFER_LEN];
   /** Output ring-buffer */
   struct mqtt_ringbuf_t output;
+  /** Output payload queue: the first 'out_pbuf_unacked' entries are written and wait to be acknowledged */
+  struct mqtt_out_pbuf_t out_pbuf[MQTT_OUTPUT_PBUF_QUEUE_LEN];
+  u8_t out_pbuf_first;
+  u8_t out_pbuf_unacked;
+  u8_t out_pbuf_len;
+  /** Output byte counters */
+  u32_t ring_sent;
+  u32_t tx_written;
+  u32_t tx_acked;
 };
 
 #ifdef __cplusplus
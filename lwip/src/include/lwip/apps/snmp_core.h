@@ -294,6 +294,33 @@ void snmp_next_oid_init(struct snmp_next_oid_state *state,
 u8_t snmp_next_oid_precheck(struct snmp_next_oid_state *state, const u32_t *oid, u8_t oid_len);
 u8_t snmp_next_oid_check(struct snmp_next_oid_state *state, const u32_t *oid, u8_t oid_len, void* reference);
 
+/** Builds the OID of a table row, returns its length or 0 if the row is not part of the table */
+typedef u8_t (*snmp_row_index_oid_method)(const void *row, u32_t *oid);
+
+#define SNMP_ROW_INDEX_EMPTY    0
+#define SNMP_ROW_INDEX_VALID    1
+#define SNMP_ROW_INDEX_OVERFLOW 2
+
+/** Rows of a table sorted by OID, replaces checking all rows with snmp_next_oid_check() on every get_next by a binary search */
+struct snmp_row_index
+{
+  /** storage for row references */
+  const void **rows;
+  u16_t max_rows;
+  u16_t num_rows;
+  snmp_row_index_oid_method row_oid;
+  /** generation of the rows the index was built for */
+  u32_t generation;
+  u8_t state;
+};
+
+/** Creates a row index using the array 'rows' as storage */
+#define SNMP_ROW_INDEX_CREATE(rows, row_oid) { rows, LWIP_ARRAYSIZE(rows), 0, row_oid, 0, SNMP_ROW_INDEX_EMPTY }
+
+u8_t snmp_row_index_update(struct snmp_row_index *index, u32_t generation);
+u8_t snmp_row_index_add(struct snmp_row_index *index, const void *row);
+u8_t snmp_row_index_next(const struct snmp_row_index *index, struct snmp_obj_id *row_oid, const void **row);
+
 void snmp_oid_assign(struct snmp_obj_id* target, const u32_t *oid, u8_t oid_len);
 void snmp_oid_combine(struct snmp_obj_id* target, const u32_t *oid1, u8_t oid1_len, const u32_t *oid2, u8_t oid2_len);
 void snmp_oid_prefix(struct snmp_obj_id* target, const u32_t *oid, u8_t oid_len);
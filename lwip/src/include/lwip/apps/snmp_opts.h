@@ -263,6 +263,49 @@
 #define SNMP_LWIP_GETBULK_MAX_REPETITIONS 0
 #endif
 
+/**
+ * Number of repeating variable bindings of a GetBulk request that keep a resolution cursor:
+ * repetitions continue at the MIB node of the previous result instead of resolving
+ * the OID from the MIB root. Costs SNMP_LWIP_MIB_INDEX_DEPTH + 3 words of stack per cursor.
+ */
+#if !defined SNMP_LWIP_GETBULK_CURSORS || defined __DOXYGEN__
+#define SNMP_LWIP_GETBULK_CURSORS 8
+#endif
+
+/**
+ * Number of entries of the flattened MIB index (0 disables it).
+ * The index lists the leaf nodes of all MIBs set by snmp_set_mibs() in OID order and
+ * is built on first use; lookups and GetNext/GetBulk walks then use binary search
+ * instead of walking the MIB trees. If the MIBs have more leaf nodes, the trees are walked.
+ * Requires MIB trees that do not change at runtime (other than by snmp_set_mibs()).
+ */
+#if !defined SNMP_LWIP_MIB_INDEX_SIZE || defined __DOXYGEN__
+#define SNMP_LWIP_MIB_INDEX_SIZE 0
+#endif
+
+/**
+ * Maximum number of sub-identifiers of a leaf node OID below its MIB base OID in the
+ * flattened MIB index (see SNMP_LWIP_MIB_INDEX_SIZE) and in GetBulk resolution cursors
+ * (see SNMP_LWIP_GETBULK_CURSORS). Deeper nodes are resolved by walking the MIB tree.
+ */
+#if !defined SNMP_LWIP_MIB_INDEX_DEPTH || defined __DOXYGEN__
+#define SNMP_LWIP_MIB_INDEX_DEPTH 6
+#endif
+
+/**
+ * Number of rows of each MIB2 TCP and UDP connection/endpoint table kept in a sorted
+ * row index (0 disables the indices). GetNext/GetBulk on these tables then use binary
+ * search instead of checking all PCBs. An index is rebuilt when the PCB lists change;
+ * if a table has more rows, all PCBs are checked. Costs one pointer per row and table.
+ */
+#if !defined SNMP_LWIP_MIB2_TABLE_INDEX_SIZE || defined __DOXYGEN__
+#define SNMP_LWIP_MIB2_TABLE_INDEX_SIZE 0
+#endif
+
+#if LWIP_SNMP && (SNMP_LWIP_MIB2_TABLE_INDEX_SIZE > 0) && !LWIP_PCB_LISTS_GENERATION
+#error "SNMP_LWIP_MIB2_TABLE_INDEX_SIZE needs LWIP_PCB_LISTS_GENERATION"
+#endif
+
 /**
  * @}
  */
@@ -290,6 +333,18 @@
 #define LWIP_SNMP_V3_CRYPTO        LWIP_SNMP_V3_MBEDTLS
 #endif
 
+/**
+ * LWIP_SNMP_V3_CRYPTO_CTX_CACHE_SIZE: Number of authentication (HMAC) and of
+ * privacy (cipher) contexts the mbedTLS backend keeps set up with their key
+ * between messages, so the HMAC key padding and the cipher key schedule are
+ * not recomputed per message. A user with privacy needs one authentication
+ * context and two privacy contexts (one per direction).
+ * 0 sets up and frees the contexts for every message.
+ */
+#if !defined LWIP_SNMP_V3_CRYPTO_CTX_CACHE_SIZE || defined __DOXYGEN__
+#define LWIP_SNMP_V3_CRYPTO_CTX_CACHE_SIZE 2
+#endif
+
 #ifndef LWIP_SNMP_CONFIGURE_VERSIONS
 #define LWIP_SNMP_CONFIGURE_VERSIONS 0
 #endif
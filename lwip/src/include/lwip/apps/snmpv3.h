@@ -105,6 +105,32 @@ void snmpv3_password_to_key_sha(
     u8_t        engineLength, /* IN  - length of snmpEngineID */
     u8_t       *key);         /* OUT - pointer to caller 20-octet buffer */
 
+/* The password to key conversion split in two steps (RFC 3414 2.6):
+ * The master key only depends on the password and is expensive to compute (1 MByte hashed).
+ * Applications can keep it to localize the key cheaply when the engine ID changes.
+ */
+void snmpv3_password_to_master_key_md5(
+    const u8_t *password,     /* IN */
+    size_t      passwordlen,  /* IN */
+    u8_t       *key);         /* OUT - pointer to caller 16-octet buffer */
+
+void snmpv3_localize_key_md5(
+    const u8_t *master_key,   /* IN  - pointer to 16-octet master key */
+    const u8_t *engineID,     /* IN  - pointer to snmpEngineID  */
+    u8_t        engineLength, /* IN  - length of snmpEngineID */
+    u8_t       *key);         /* OUT - pointer to caller 16-octet buffer, may be master_key */
+
+void snmpv3_password_to_master_key_sha(
+    const u8_t *password,     /* IN */
+    size_t      passwordlen,  /* IN */
+    u8_t       *key);         /* OUT - pointer to caller 20-octet buffer */
+
+void snmpv3_localize_key_sha(
+    const u8_t *master_key,   /* IN  - pointer to 20-octet master key */
+    const u8_t *engineID,     /* IN  - pointer to snmpEngineID  */
+    u8_t        engineLength, /* IN  - length of snmpEngineID */
+    u8_t       *key);         /* OUT - pointer to caller 20-octet buffer, may be master_key */
+
 #endif
 
 #ifdef __cplusplus
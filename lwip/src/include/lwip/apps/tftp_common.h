@@ -92,6 +92,14 @@ struct tftp_context {
    * @param size size of msg
    */
   void (*error)(void* handle, int err, const char* msg, int size);
+  /**
+   * Get file size for the tsize option (RFC 2349), may be NULL.
+   * Called when the server answers a read request asking for the size
+   * and when the client sends a write request.
+   * @param handle File handle returned by open()/tftp_put()
+   * @returns File size in bytes; &lt; 0: Unknown
+   */
+  int (*size)(void* handle);
 };
 
 #define LWIP_TFTP_MODE_SERVER       0x01
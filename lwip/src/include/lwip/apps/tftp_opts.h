@@ -99,6 +99,25 @@
 #define TFTP_MAX_MODE_LEN     10
 #endif
 
+/**
+ * Max. block size negotiated with the blksize option (RFC 2348).
+ * It is further limited to what fits into the MTU of the netif used to
+ * reach the peer. Values up to 512 disable requesting the option.
+ * Each block in flight is kept in one pbuf of this size (plus 4 bytes).
+ */
+#if !defined TFTP_MAX_BLKSIZE || defined __DOXYGEN__
+#define TFTP_MAX_BLKSIZE      1468
+#endif
+
+/**
+ * Max. window size negotiated with the windowsize option (RFC 7440),
+ * i.e. number of blocks sent before waiting for an ACK.
+ * 1 disables requesting the option (lock-step transfers as in RFC 1350).
+ */
+#if !defined TFTP_MAX_WINDOWSIZE || defined __DOXYGEN__
+#define TFTP_MAX_WINDOWSIZE   4
+#endif
+
 /**
  * @}
  */
@@ -1064,6 +1064,20 @@
 #if !defined LWIP_MIB2_CALLBACKS || defined __DOXYGEN__
 #define LWIP_MIB2_CALLBACKS             0
 #endif
+
+/**
+ * LWIP_PCB_LISTS_GENERATION==1: Count changes of the UDP and TCP pcb lists in
+ * udp_pcbs_generation and tcp_pcb_lists_generation. Needed by the SNMP MIB2
+ * TCP/UDP table indices, enabled by default if those are configured
+ * (LWIP_SNMP and SNMP_LWIP_MIB2_TABLE_INDEX_SIZE > 0 in lwipopts.h).
+ */
+#if !defined LWIP_PCB_LISTS_GENERATION || defined __DOXYGEN__
+#if defined LWIP_SNMP && defined SNMP_LWIP_MIB2_TABLE_INDEX_SIZE
+#define LWIP_PCB_LISTS_GENERATION       (LWIP_SNMP && (SNMP_LWIP_MIB2_TABLE_INDEX_SIZE > 0))
+#else
+#define LWIP_PCB_LISTS_GENERATION       0
+#endif
+#endif
 /**
  * @}
  */
@@ -1182,6 +1196,9 @@
  *  with function signature:
  *  extern err_t my_lookup_function(const char *name, size_t namelen, ip_addr_t *addr, u8_t dns_addrtype)
  *  that looks up the IP address and returns ERR_OK if found (LWIP_DNS_ADDRTYPE_xxx is passed in dns_addrtype).
+ *  If it returns ERR_INPROGRESS (it has sent a query of its own, like mdns_query_lookup()),
+ *  no DNS query is sent: the lookup is repeated every DNS_TMR_INTERVAL until it succeeds
+ *  or the request times out.
  */
 #if !defined DNS_LOCAL_HOSTLIST || defined __DOXYGEN__
 #define DNS_LOCAL_HOSTLIST              0
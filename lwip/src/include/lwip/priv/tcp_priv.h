@@ -326,6 +326,14 @@ struct tcp_seg {
 extern struct tcp_pcb *tcp_input_pcb;
 extern u32_t tcp_ticks;
 extern u8_t tcp_active_pcbs_changed;
+#if LWIP_PCB_LISTS_GENERATION
+/* Incremented when a pcb is added to or removed from one of the tcp_pcb_lists or
+   its addresses/ports change (allows caching information derived from the lists) */
+extern u32_t tcp_pcb_lists_generation;
+#define TCP_PCB_LISTS_CHANGED() tcp_pcb_lists_generation++
+#else /* LWIP_PCB_LISTS_GENERATION */
+#define TCP_PCB_LISTS_CHANGED()
+#endif /* LWIP_PCB_LISTS_GENERATION */
 
 /* The TCP PCB lists. */
 union tcp_listen_pcbs_t { /* List of all TCP PCBs in LISTEN state. */
@@ -367,6 +375,7 @@ extern struct tcp_pcb ** const tcp_pcb_lists[NUM_TCP_PCB_LISTS];
                             (npcb)->next = *(pcbs); \
                             LWIP_ASSERT("TCP_REG: npcb->next != npcb", (npcb)->next != (npcb)); \
                             *(pcbs) = (npcb); \
+                            TCP_PCB_LISTS_CHANGED(); \
                             LWIP_ASSERT("TCP_REG: tcp_pcbs sane", tcp_pcbs_sane()); \
               tcp_timer_needed(); \
                             } while(0)
@@ -383,6 +392,7 @@ extern struct tcp_pcb ** const tcp_pcb_lists[NUM_TCP_PCB_LISTS];
                                } \
                             } \
                             (npcb)->next = NULL; \
+                            TCP_PCB_LISTS_CHANGED(); \
                             LWIP_ASSERT("TCP_RMV: tcp_pcbs sane", tcp_pcbs_sane()); \
                             LWIP_DEBUGF(TCP_DEBUG, ("TCP_RMV: removed %p from %p\n", (void *)(npcb), (void *)(*(pcbs)))); \
                             } while(0)
@@ -393,6 +403,7 @@ extern struct tcp_pcb ** const tcp_pcb_lists[NUM_TCP_PCB_LISTS];
   do {                                             \
     (npcb)->next = *pcbs;                          \
     *(pcbs) = (npcb);                              \
+    TCP_PCB_LISTS_CHANGED();                       \
     tcp_timer_needed();                            \
   } while (0)
 
@@ -413,6 +424,7 @@ extern struct tcp_pcb ** const tcp_pcb_lists[NUM_TCP_PCB_LISTS];
       }                                            \
     }                                              \
     (npcb)->next = NULL;                           \
+    TCP_PCB_LISTS_CHANGED();                       \
   } while(0)
 
 #endif /* LWIP_DEBUG */
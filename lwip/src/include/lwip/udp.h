@@ -113,6 +113,11 @@ struct udp_pcb {
 };
 /* udp_pcbs export for external reference (e.g. SNMP agent) */
 extern struct udp_pcb *udp_pcbs;
+#if LWIP_PCB_LISTS_GENERATION
+/* incremented when a pcb is added to or removed from udp_pcbs or its addresses/ports change
+   (allows external references to cache information derived from udp_pcbs) */
+extern u32_t udp_pcbs_generation;
+#endif /* LWIP_PCB_LISTS_GENERATION */
 
 /* The following functions is the application layer interface to the
    UDP code. */
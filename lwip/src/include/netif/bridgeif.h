@@ -95,10 +95,23 @@ err_t bridgeif_init(struct netif *netif);
 err_t bridgeif_add_port(struct netif *bridgeif, struct netif *portif);
 err_t bridgeif_fdb_add(struct netif *bridgeif, const struct eth_addr *addr, bridgeif_portmask_t ports);
 err_t bridgeif_fdb_remove(struct netif *bridgeif, const struct eth_addr *addr);
+#if BRIDGEIF_TX_BATCH_LEN
+void  bridgeif_flush(struct netif *bridgeif);
+#endif /* BRIDGEIF_TX_BATCH_LEN */
+#if BRIDGEIF_VLAN
+err_t bridgeif_vlan_set_pvid(struct netif *bridgeif, struct netif *portif, u16_t pvid);
+err_t bridgeif_vlan_add(struct netif *bridgeif, struct netif *portif, u16_t vid);
+err_t bridgeif_vlan_remove(struct netif *bridgeif, struct netif *portif, u16_t vid);
+#endif /* BRIDGEIF_VLAN */
 
 /* FDB interface, can be replaced by own implementation */
+#if BRIDGEIF_VLAN
+void                bridgeif_fdb_update_src(void *fdb_ptr, struct eth_addr *src_addr, u16_t vid, u8_t port_idx);
+bridgeif_portmask_t bridgeif_fdb_get_dst_ports(void *fdb_ptr, struct eth_addr *dst_addr, u16_t vid);
+#else /* BRIDGEIF_VLAN */
 void                bridgeif_fdb_update_src(void *fdb_ptr, struct eth_addr *src_addr, u8_t port_idx);
 bridgeif_portmask_t bridgeif_fdb_get_dst_ports(void *fdb_ptr, struct eth_addr *dst_addr);
+#endif /* BRIDGEIF_VLAN */
 void*               bridgeif_fdb_init(u16_t max_fdb_entries);
 
 #if BRIDGEIF_PORT_NETIFS_OUTPUT_DIRECT
@@ -113,11 +126,14 @@ void*               bridgeif_fdb_init(u16_t max_fdb_entries);
 #endif
 #else /* BRIDGEIF_PORT_NETIFS_OUTPUT_DIRECT */
 #include "lwip/tcpip.h"
+#ifndef BRIDGEIF_DECL_PROTECT
+/* everything runs in the tcpip thread: no protection needed */
 #define BRIDGEIF_DECL_PROTECT(lev)
 #define BRIDGEIF_READ_PROTECT(lev)
 #define BRIDGEIF_READ_UNPROTECT(lev)
 #define BRIDGEIF_WRITE_PROTECT(lev)
 #define BRIDGEIF_WRITE_UNPROTECT(lev)
+#endif
 #endif /* BRIDGEIF_PORT_NETIFS_OUTPUT_DIRECT */
 
 #ifdef __cplusplus
@@ -68,6 +68,51 @@
 #define BRIDGEIF_MAX_PORTS                  7
 #endif
 
+/** BRIDGEIF_TX_BATCH_LEN > 0: frames forwarded between ports are not sent from
+ * the receive path directly but queued per egress port (up to this many frames
+ * per port). Queued ports are then sent out back to back, which allows drivers to
+ * batch their TX work.
+ * A flooded frame is queued on all its egress ports by reference (@ref pbuf_ref),
+ * so it is never copied (except for pbufs with volatile data, see PBUF_NEEDS_COPY).
+ * As always, port drivers must treat pbufs passed to linkoutput as read-only.
+ * A port's queue is sent when it is full, before the bridge sends any other frame
+ * on that port and when @ref bridgeif_flush is called.
+ * With BRIDGEIF_PORT_NETIFS_OUTPUT_DIRECT==0, flushing is scheduled automatically
+ * (after the input packets already pending for tcpip_thread are processed).
+ * ATTENTION: with BRIDGEIF_PORT_NETIFS_OUTPUT_DIRECT==1, port drivers (or the
+ * application) must call @ref bridgeif_flush after passing a burst of received
+ * frames to the bridge!
+ */
+#ifndef BRIDGEIF_TX_BATCH_LEN
+#define BRIDGEIF_TX_BATCH_LEN               0
+#endif
+
+/** BRIDGEIF_VLAN==1: IEEE 802.1Q VLAN aware bridging.
+ * Every port (and the cpu port, i.e. the bridge netif) has a PVID and a set of
+ * member VLANs (see @ref bridgeif_vlan_set_pvid, @ref bridgeif_vlan_add).
+ * Untagged frames received on a port belong to its PVID, tagged frames to the VLAN
+ * in their tag. Frames are only forwarded to member ports of their VLAN and the
+ * dynamic FDB learns (VLAN, MAC) pairs. Frames are sent untagged on ports whose
+ * PVID is the frame's VLAN and tagged on all other member ports. Tags of forwarded
+ * frames are pushed or popped in place (using pbuf header space) unless the pbuf is
+ * still referenced. Frames sent by the stack on the bridge netif are never changed,
+ * their tags are pushed or popped on a copy.
+ * By default, all ports are untagged members of VLAN 1 only.
+ * ATTENTION: this changes the FDB interface (bridgeif_fdb_update_src and
+ * bridgeif_fdb_get_dst_ports get a VLAN ID parameter)!
+ */
+#ifndef BRIDGEIF_VLAN
+#define BRIDGEIF_VLAN                       0
+#endif
+
+/** BRIDGEIF_VLAN_MAX_VID: highest VLAN ID that can be configured with
+ * BRIDGEIF_VLAN==1. The VLAN membership bitmap of every port takes
+ * (BRIDGEIF_VLAN_MAX_VID / 8 + 1) bytes, so reduce this to save memory.
+ */
+#ifndef BRIDGEIF_VLAN_MAX_VID
+#define BRIDGEIF_VLAN_MAX_VID               4094
+#endif
+
 /** BRIDGEIF_DEBUG: Enable generic debugging in bridgeif.c. */
 #ifndef BRIDGEIF_DEBUG
 #define BRIDGEIF_DEBUG                      LWIP_DBG_OFF
@@ -135,16 +135,16 @@ typedef struct lcp_options {
     unsigned int neg_lqr           :1; /* Negotiate use of Link Quality Reports */
 #endif /* LQR_SUPPORT */
     unsigned int neg_cbcp          :1; /* Negotiate use of CBCP */
-#ifdef HAVE_MULTILINK
+#if PPP_MULTILINK_SUPPORT
     unsigned int neg_mrru          :1; /* negotiate multilink MRRU */
-#endif /* HAVE_MULTILINK */
+#endif /* PPP_MULTILINK_SUPPORT */
     unsigned int neg_ssnhf         :1; /* negotiate short sequence numbers */
     unsigned int neg_endpoint      :1; /* negotiate endpoint discriminator */
 
     u16_t mru;			/* Value of MRU */
-#ifdef HAVE_MULTILINK
+#if PPP_MULTILINK_SUPPORT
     u16_t mrru;			/* Value of MRRU, and multilink enable */
-#endif /* MULTILINK */
+#endif /* PPP_MULTILINK_SUPPORT */
 #if CHAP_SUPPORT
     u8_t chap_mdtype;		/* which MD types (hashing algorithm) */
 #endif /* CHAP_SUPPORT */
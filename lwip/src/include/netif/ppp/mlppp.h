@@ -0,0 +1,105 @@
+/**
+ * @file
+ * PPP Multilink Protocol (MLPPP, RFC 1990)
+ */
+
+/*
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the lwIP TCP/IP stack.
+ *
+ */
+
+#include "netif/ppp/ppp_opts.h"
+#if PPP_SUPPORT && PPP_MULTILINK_SUPPORT /* don't build if not configured for use in lwipopts.h */
+
+#ifndef MLPPP_H
+#define MLPPP_H
+
+#include "lwip/pbuf.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if (PPP_MP_REORDER_WINDOW & (PPP_MP_REORDER_WINDOW - 1)) != 0
+#error "PPP_MP_REORDER_WINDOW must be a power of 2"
+#endif
+
+/* Multilink header, long sequence number format */
+#define PPP_MP_HDRLEN     4
+#define PPP_MP_FLAG_B     0x80   /* Beginning fragment */
+#define PPP_MP_FLAG_E     0x40   /* Ending fragment */
+#define PPP_MP_SEQ_MASK   0x00ffffffUL
+
+/*
+ * A member link of a bundle, as seen from the bundle.
+ */
+typedef struct ppp_mp_link_s {
+  ppp_pcb *pcb;       /* member link, NULL if this slot is free */
+  u32_t tx_time;      /* virtual time at which the link has sent its queue, 1/256 us */
+  u32_t cost;         /* time to send one byte, 1/256 us */
+  u32_t weight;       /* share of a fragmented packet, link speed in kbit/s */
+  u32_t last_seq;     /* most recent sequence number received on this link */
+  unsigned int joined    :1; /* link is up and part of the bundle */
+  unsigned int seq_valid :1; /* last_seq is valid */
+} ppp_mp_link;
+
+/*
+ * Multilink state of a bundle. The bundle is the PPP link the member
+ * links are added to, it owns the netif and runs the network protocols.
+ */
+typedef struct ppp_mp_state_s {
+  ppp_mp_link links[PPP_MP_MAX_LINKS]; /* links[0] is the bundle link itself */
+  u32_t tx_seq;                        /* sequence number of the next fragment sent */
+  u32_t rx_seq;                        /* sequence number of the next fragment expected */
+  struct pbuf *rx_frag[PPP_MP_REORDER_WINDOW]; /* fragments waiting for reassembly */
+  u8_t rx_flags[PPP_MP_REORDER_WINDOW];        /* B and E flags of rx_frag[] */
+  u16_t rx_count;                      /* number of fragments in rx_frag[] */
+  u32_t magic;                         /* endpoint discriminator shared by all member links */
+  unsigned int active        :1;       /* multilink negotiated on the bundle link */
+  unsigned int rx_started    :1;       /* rx_seq is valid */
+  unsigned int timer_running :1;       /* reassembly timer running */
+} ppp_mp_state;
+
+/*
+ * Public functions.
+ */
+err_t ppp_mp_add_link(ppp_pcb *bundle, ppp_pcb *pcb);
+err_t ppp_mp_remove_link(ppp_pcb *pcb);
+err_t ppp_mp_set_link_speed(ppp_pcb *pcb, u32_t speed);
+
+/*
+ * Functions called by PPP core.
+ */
+int ppp_mp_join(ppp_pcb *pcb);
+void ppp_mp_leave(ppp_pcb *pcb);
+err_t ppp_mp_output(ppp_pcb *pcb, struct pbuf *pb, u16_t protocol);
+void ppp_mp_input(ppp_pcb *pcb, struct pbuf *pb);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MLPPP_H */
+#endif /* PPP_SUPPORT && PPP_MULTILINK_SUPPORT */
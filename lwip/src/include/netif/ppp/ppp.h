@@ -191,6 +191,9 @@ typedef unsigned char  u_char;
 #if VJ_SUPPORT
 #include "vj.h"
 #endif /* VJ_SUPPORT */
+#if PPP_MULTILINK_SUPPORT
+#include "mlppp.h"
+#endif /* PPP_MULTILINK_SUPPORT */
 
 /* Link status callback function prototype */
 typedef void (*ppp_link_status_cb_fn)(ppp_pcb *pcb, int err_code, void *ctx);
@@ -421,6 +424,11 @@ struct ppp_pcb_s {
   ipv6cp_options ipv6cp_allowoptions; /* Options we allow peer to request */
   ipv6cp_options ipv6cp_hisoptions;   /* Options that we ack'd */
 #endif /* PPP_IPV6_SUPPORT */
+
+#if PPP_MULTILINK_SUPPORT
+  ppp_pcb *mp_bundle;            /* Bundle we are a member link of, NULL if none */
+  ppp_mp_state mp;               /* Multilink state, if we are a bundle link */
+#endif /* PPP_MULTILINK_SUPPORT */
 };
 
 /************************
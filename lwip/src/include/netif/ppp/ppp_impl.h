@@ -99,6 +99,9 @@ extern "C" {
 #define	PPP_VJC_COMP	0x2d	/* VJ compressed TCP */
 #define	PPP_VJC_UNCOMP	0x2f	/* VJ uncompressed TCP */
 #endif /* VJ_SUPPORT */
+#if PPP_MULTILINK_SUPPORT
+#define PPP_MP		0x3d	/* Multilink protocol */
+#endif /* PPP_MULTILINK_SUPPORT */
 #if PPP_IPV6_SUPPORT
 #define PPP_IPV6	0x57	/* Internet Protocol Version 6 */
 #endif /* PPP_IPV6_SUPPORT */
@@ -95,7 +95,7 @@
  * timers analysis.
  */
 #ifndef PPP_NUM_TIMEOUTS_PER_PCB
-#define PPP_NUM_TIMEOUTS_PER_PCB        (1 + PPP_IPV4_SUPPORT + PPP_IPV6_SUPPORT + CCP_SUPPORT)
+#define PPP_NUM_TIMEOUTS_PER_PCB        (1 + PPP_IPV4_SUPPORT + PPP_IPV6_SUPPORT + CCP_SUPPORT + PPP_MULTILINK_SUPPORT)
 #endif
 
 /* The number of sys_timeouts required for the PPP module */
@@ -200,6 +200,8 @@
 
 /**
  * PPP_FCS_TABLE: Keep a 256*2 byte table to speed up FCS calculation for PPPoS
+ * PPP_FCS_TABLE==2: Keep 8 tables (8*256*2 bytes) and compute the FCS 8 bytes
+ * at a time (slice-by-8), several times faster for large frames
  */
 #ifndef PPP_FCS_TABLE
 #define PPP_FCS_TABLE                   1
@@ -321,6 +323,56 @@
 #define VJ_SUPPORT                      0
 #endif /* !PPPOS_SUPPORT */
 
+/**
+ * PPP_MULTILINK_SUPPORT==1: Support PPP Multilink (MLPPP, RFC 1990), bonding
+ * several PPP links to the same peer into one bundle, see ppp_mp_add_link().
+ */
+#ifndef PPP_MULTILINK_SUPPORT
+#define PPP_MULTILINK_SUPPORT           0
+#endif
+
+#if PPP_MULTILINK_SUPPORT
+/**
+ * PPP_MP_MAX_LINKS: Maximum number of links in a bundle, including the
+ * bundle link itself.
+ */
+#ifndef PPP_MP_MAX_LINKS
+#define PPP_MP_MAX_LINKS                3
+#endif
+
+/**
+ * PPP_MP_MRRU: Maximum Reconstructed Receive Unit we ask for, the largest
+ * packet the peer may send on a bundle.
+ */
+#ifndef PPP_MP_MRRU
+#define PPP_MP_MRRU                     1500
+#endif
+
+/**
+ * PPP_MP_REORDER_WINDOW: Number of received fragments held for reordering
+ * and reassembly per bundle, must be a power of 2.
+ */
+#ifndef PPP_MP_REORDER_WINDOW
+#define PPP_MP_REORDER_WINDOW           16
+#endif
+
+/**
+ * PPP_MP_MIN_FRAG: Smallest fragment size in bytes. Packets shorter than
+ * twice this are not fragmented but sent whole on one link.
+ */
+#ifndef PPP_MP_MIN_FRAG
+#define PPP_MP_MIN_FRAG                 64
+#endif
+
+/**
+ * PPP_MP_REASM_TIMEOUT: Time in milliseconds to wait for a missing fragment
+ * before giving up on the packet.
+ */
+#ifndef PPP_MP_REASM_TIMEOUT
+#define PPP_MP_REASM_TIMEOUT            500
+#endif
+#endif /* PPP_MULTILINK_SUPPORT */
+
 /**
  * PPP_MD5_RANDM==1: Use MD5 for better randomness.
  * Enabled by default if CHAP, EAP, or L2TP AUTH support is enabled.
@@ -67,6 +67,13 @@
 #define SLIP_RX_QUEUE SLIP_RX_FROM_ISR
 #endif
 
+/** Maximum number of bytes read from the serial line at once by
+ * slipif_poll() and the RX thread (buffer on the stack).
+ */
+#ifndef SLIP_RX_BLOCK_SIZE
+#define SLIP_RX_BLOCK_SIZE 64
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -76,7 +83,7 @@ void slipif_poll(struct netif *netif);
 #if SLIP_RX_FROM_ISR
 void slipif_process_rxqueue(struct netif *netif);
 void slipif_received_byte(struct netif *netif, u8_t data);
-void slipif_received_bytes(struct netif *netif, u8_t *data, u8_t len);
+void slipif_received_bytes(struct netif *netif, u8_t *data, u16_t len);
 #endif /* SLIP_RX_FROM_ISR */
 
 #ifdef __cplusplus
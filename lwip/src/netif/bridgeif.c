@@ -49,6 +49,10 @@
  *   - only NETIF_FLAG_ETHARP/NETIF_FLAG_ETHERNET netifs are supported as bridge ports
  *   - add the bridge port netifs without IPv4 addresses (i.e. pass 'NULL, NULL, NULL')
  *   - don't add IPv6 addresses to the port netifs!
+ *   - port netif drivers must not modify pbufs passed to their linkoutput function:
+ *     flooded frames are passed to all egress ports without copying
+ * - with BRIDGEIF_VLAN enabled, configure port VLANs with bridgeif_vlan_set_pvid() and
+ *   bridgeif_vlan_add() (pass the bridge netif as 'portif' to configure the cpu port)
  * - set up the bridge configuration in a global variable of type 'bridgeif_initdata_t' that contains
  *   - the MAC address of the bridge
  *   - some configuration options controlling the memory consumption (maximum number of ports
@@ -75,7 +79,6 @@
  * - multicast snooping? (and only forward group addresses to interested ports)
  * - support removing ports
  * - check SNMP integration
- * - VLAN handling / trunk ports
  * - priority handling? (although that largely depends on TX queue limitations and lwIP doesn't provide tx-done handling)
  */
 
@@ -94,11 +97,40 @@
 #define IFNAME0 'b'
 #define IFNAME1 'r'
 
+#if BRIDGEIF_VLAN
+#if (BRIDGEIF_VLAN_MAX_VID < 1) || (BRIDGEIF_VLAN_MAX_VID > 4094)
+#error BRIDGEIF_VLAN_MAX_VID must be [1..4094]
+#endif
+
+#define BRIDGEIF_VLAN_VID_MASK    0x0FFF
+#define BRIDGEIF_VLAN_DEFAULT_VID 1
+/* length of dst + src address, the part of the header moved when pushing/popping a tag */
+#define BRIDGEIF_ETH_ADDRS_LEN    (2 * ETH_HWADDR_LEN)
+
+/* VLAN configuration of a port */
+typedef struct bridgeif_vlan_port_s {
+  u16_t pvid;
+  /* bitmap of member VLANs */
+  u8_t member[(BRIDGEIF_VLAN_MAX_VID / 8) + 1];
+} bridgeif_vlan_port_t;
+
+#define BRIDGEIF_VLAN_IS_MEMBER(vp, vid) (((vid) <= BRIDGEIF_VLAN_MAX_VID) && \
+                                          ((vp)->member[(vid) >> 3] & (1 << ((vid) & 7))))
+#endif /* BRIDGEIF_VLAN */
+
 struct bridgeif_private_s;
 typedef struct bridgeif_port_private_s {
   struct bridgeif_private_s *bridge;
   struct netif *port_netif;
   u8_t port_num;
+#if BRIDGEIF_VLAN
+  bridgeif_vlan_port_t vlan;
+#endif /* BRIDGEIF_VLAN */
+#if BRIDGEIF_TX_BATCH_LEN
+  /* frames queued for output on this port (one reference each) */
+  u16_t txq_len;
+  struct pbuf *txq[BRIDGEIF_TX_BATCH_LEN];
+#endif /* BRIDGEIF_TX_BATCH_LEN */
 } bridgeif_port_t;
 
 typedef struct bridgeif_fdb_static_entry_s {
@@ -117,6 +149,13 @@ typedef struct bridgeif_private_s {
   bridgeif_fdb_static_entry_t *fdbs;
   u16_t             max_fdbd_entries;
   void             *fdbd;
+#if BRIDGEIF_TX_BATCH_LEN && !BRIDGEIF_PORT_NETIFS_OUTPUT_DIRECT
+  u8_t              flush_pending;
+#endif /* BRIDGEIF_TX_BATCH_LEN && !BRIDGEIF_PORT_NETIFS_OUTPUT_DIRECT */
+#if BRIDGEIF_VLAN
+  /* VLAN configuration of the cpu port */
+  bridgeif_vlan_port_t cpu_vlan;
+#endif /* BRIDGEIF_VLAN */
 } bridgeif_private_t;
 
 /* netif data index to get the bridge on input */
@@ -191,31 +230,78 @@ bridgeif_fdb_remove(struct netif *bridgeif, const struct eth_addr *addr)
   return ERR_VAL;
 }
 
-/** Get the forwarding port(s) (as bit mask) for the specified destination mac address */
+#if BRIDGEIF_VLAN
+/** Get the member ports (including the cpu port) of a VLAN as bit mask.
+ * The ports that are untagged members (i.e. the PVID is 'vid') are returned
+ * in 'untagged' if not NULL.
+ */
 static bridgeif_portmask_t
-bridgeif_find_dst_ports(bridgeif_private_t *br, struct eth_addr *dst_addr)
+bridgeif_vlan_ports(bridgeif_private_t *br, u16_t vid, bridgeif_portmask_t *untagged)
+{
+  u8_t i;
+  bridgeif_portmask_t members = 0, untagged_ports = 0;
+  for (i = 0; i < br->num_ports; i++) {
+    if (BRIDGEIF_VLAN_IS_MEMBER(&br->ports[i].vlan, vid)) {
+      members |= (bridgeif_portmask_t)(1 << i);
+      if (br->ports[i].vlan.pvid == vid) {
+        untagged_ports |= (bridgeif_portmask_t)(1 << i);
+      }
+    }
+  }
+  if (BRIDGEIF_VLAN_IS_MEMBER(&br->cpu_vlan, vid)) {
+    members |= (bridgeif_portmask_t)(1 << BRIDGEIF_MAX_PORTS);
+    if (br->cpu_vlan.pvid == vid) {
+      untagged_ports |= (bridgeif_portmask_t)(1 << BRIDGEIF_MAX_PORTS);
+    }
+  }
+  if (untagged != NULL) {
+    *untagged = untagged_ports;
+  }
+  return members;
+}
+#endif /* BRIDGEIF_VLAN */
+
+/** Get the forwarding port(s) (as bit mask) for the specified destination mac address
+ * (with BRIDGEIF_VLAN enabled, limited to the member ports of VLAN 'vid')
+ */
+static bridgeif_portmask_t
+bridgeif_find_dst_ports(bridgeif_private_t *br, struct eth_addr *dst_addr, u16_t vid)
 {
   int i;
+  bridgeif_portmask_t ret;
   BRIDGEIF_DECL_PROTECT(lev);
   BRIDGEIF_READ_PROTECT(lev);
   /* first check for static entries */
   for (i = 0; i < br->max_fdbs_entries; i++) {
     if (br->fdbs[i].used) {
       if (!memcmp(&br->fdbs[i].addr, dst_addr, sizeof(struct eth_addr))) {
-        bridgeif_portmask_t ret = br->fdbs[i].dst_ports;
-        BRIDGEIF_READ_UNPROTECT(lev);
-        return ret;
+        break;
       }
     }
   }
-  if (dst_addr->addr[0] & 1) {
+  if (i < br->max_fdbs_entries) {
+    ret = br->fdbs[i].dst_ports;
+    BRIDGEIF_READ_UNPROTECT(lev);
+  } else if (dst_addr->addr[0] & 1) {
     /* no match found: flood remaining group address */
     BRIDGEIF_READ_UNPROTECT(lev);
-    return BR_FLOOD;
+    ret = BR_FLOOD;
+  } else {
+    BRIDGEIF_READ_UNPROTECT(lev);
+    /* no match found: check dynamic fdb for port or fall back to flooding */
+#if BRIDGEIF_VLAN
+    ret = bridgeif_fdb_get_dst_ports(br->fdbd, dst_addr, vid);
+#else /* BRIDGEIF_VLAN */
+    ret = bridgeif_fdb_get_dst_ports(br->fdbd, dst_addr);
+#endif /* BRIDGEIF_VLAN */
   }
-  BRIDGEIF_READ_UNPROTECT(lev);
-  /* no match found: check dynamic fdb for port or fall back to flooding */
-  return bridgeif_fdb_get_dst_ports(br->fdbd, dst_addr);
+#if BRIDGEIF_VLAN
+  /* only forward to member ports of the VLAN */
+  ret &= bridgeif_vlan_ports(br, vid, NULL);
+#else /* BRIDGEIF_VLAN */
+  LWIP_UNUSED_ARG(vid);
+#endif /* BRIDGEIF_VLAN */
+  return ret;
 }
 
 /** Helper function to see if a destination mac belongs to the bridge
@@ -244,9 +330,101 @@ bridgeif_is_local_mac(bridgeif_private_t *br, struct eth_addr *addr)
   return 0;
 }
 
+#if BRIDGEIF_TX_BATCH_LEN
+/** Send all frames queued on a port back to back */
+static void
+bridgeif_flush_port(bridgeif_port_t *port)
+{
+  struct pbuf *txq[BRIDGEIF_TX_BATCH_LEN];
+  u16_t i, len;
+  BRIDGEIF_DECL_PROTECT(lev);
+  BRIDGEIF_READ_PROTECT(lev);
+  BRIDGEIF_WRITE_PROTECT(lev);
+  len = port->txq_len;
+  memcpy(txq, port->txq, len * sizeof(struct pbuf *));
+  port->txq_len = 0;
+  BRIDGEIF_WRITE_UNPROTECT(lev);
+  for (i = 0; i < len; i++) {
+    struct netif *portif = port->port_netif;
+    if (netif_is_link_up(portif)) {
+      LWIP_DEBUGF(BRIDGEIF_FW_DEBUG, ("br -> flush(%p:%d) -> %d\n", (void *)txq[i], txq[i]->if_idx, netif_get_index(portif)));
+      portif->linkoutput(portif, txq[i]);
+    }
+    pbuf_free(txq[i]);
+  }
+  BRIDGEIF_READ_UNPROTECT(lev);
+}
+
+#if !BRIDGEIF_PORT_NETIFS_OUTPUT_DIRECT
+/** Callback in tcpip_thread to flush all ports' queues */
+static void
+bridgeif_flush_cb(void *arg)
+{
+  struct netif *bridgeif = (struct netif *)arg;
+  bridgeif_private_t *br = (bridgeif_private_t *)bridgeif->state;
+  br->flush_pending = 0;
+  bridgeif_flush(bridgeif);
+}
+#endif /* !BRIDGEIF_PORT_NETIFS_OUTPUT_DIRECT */
+
+/** Queue a frame for output on a port, flushing the queue when it is full */
+static void
+bridgeif_queue_to_port(bridgeif_private_t *br, bridgeif_port_t *port, struct pbuf *p)
+{
+  u8_t queued = 0;
+  BRIDGEIF_DECL_PROTECT(lev);
+  pbuf_ref(p);
+  while (!queued) {
+    BRIDGEIF_WRITE_PROTECT(lev);
+    if (port->txq_len < BRIDGEIF_TX_BATCH_LEN) {
+      port->txq[port->txq_len++] = p;
+      queued = 1;
+    }
+    BRIDGEIF_WRITE_UNPROTECT(lev);
+    if (!queued || (port->txq_len == BRIDGEIF_TX_BATCH_LEN)) {
+      bridgeif_flush_port(port);
+    }
+  }
+#if !BRIDGEIF_PORT_NETIFS_OUTPUT_DIRECT
+  if (!br->flush_pending) {
+    /* flush after the input packets already pending for tcpip_thread */
+    if (tcpip_try_callback(bridgeif_flush_cb, br->netif) == ERR_OK) {
+      br->flush_pending = 1;
+    } else {
+      bridgeif_flush_port(port);
+    }
+  }
+#else
+  LWIP_UNUSED_ARG(br);
+#endif /* !BRIDGEIF_PORT_NETIFS_OUTPUT_DIRECT */
+}
+
+/**
+ * @ingroup bridgeif
+ * Send out all frames queued on the bridge's ports (see BRIDGEIF_TX_BATCH_LEN).
+ * With BRIDGEIF_PORT_NETIFS_OUTPUT_DIRECT==1, this must be called after passing
+ * a burst of received frames to the bridge.
+ */
+void
+bridgeif_flush(struct netif *bridgeif)
+{
+  u8_t i;
+  bridgeif_private_t *br;
+  LWIP_ASSERT("bridgeif != NULL", bridgeif != NULL);
+  br = (bridgeif_private_t *)bridgeif->state;
+  LWIP_ASSERT("bridgeif->state != NULL", br != NULL);
+
+  for (i = 0; i < br->num_ports; i++) {
+    if (br->ports[i].txq_len) {
+      bridgeif_flush_port(&br->ports[i]);
+    }
+  }
+}
+#endif /* BRIDGEIF_TX_BATCH_LEN */
+
 /* Output helper function */
 static err_t
-bridgeif_send_to_port(bridgeif_private_t *br, struct pbuf *p, u8_t dstport_idx)
+bridgeif_send_to_port(bridgeif_private_t *br, struct pbuf *p, u8_t dstport_idx, u8_t queue)
 {
   if (dstport_idx < BRIDGEIF_MAX_PORTS) {
     /* possibly an external port */
@@ -256,6 +434,19 @@ bridgeif_send_to_port(bridgeif_private_t *br, struct pbuf *p, u8_t dstport_idx)
         /* prevent sending out to rx port */
         if (netif_get_index(portif) != p->if_idx) {
           if (netif_is_link_up(portif)) {
+#if BRIDGEIF_TX_BATCH_LEN
+            if (queue) {
+              LWIP_DEBUGF(BRIDGEIF_FW_DEBUG, ("br -> queue(%p:%d) -> %d\n", (void *)p, p->if_idx, netif_get_index(portif)));
+              bridgeif_queue_to_port(br, &br->ports[dstport_idx], p);
+              return ERR_OK;
+            }
+            /* keep the frame order on this port */
+            if (br->ports[dstport_idx].txq_len) {
+              bridgeif_flush_port(&br->ports[dstport_idx]);
+            }
+#else /* BRIDGEIF_TX_BATCH_LEN */
+            LWIP_UNUSED_ARG(queue);
+#endif /* BRIDGEIF_TX_BATCH_LEN */
             LWIP_DEBUGF(BRIDGEIF_FW_DEBUG, ("br -> flood(%p:%d) -> %d\n", (void *)p, p->if_idx, netif_get_index(portif)));
             return portif->linkoutput(portif, p);
           }
@@ -268,28 +459,328 @@ bridgeif_send_to_port(bridgeif_private_t *br, struct pbuf *p, u8_t dstport_idx)
   return ERR_OK;
 }
 
-/** Helper function to pass a pbuf to all ports marked in 'dstports'
+/** Helper function to pass a pbuf to all ports marked in 'dstports'.
+ * All ports get the same pbuf. If 'queue' is set (and BRIDGEIF_TX_BATCH_LEN > 0),
+ * the pbuf is queued by reference on every port instead of being sent directly.
  */
 static err_t
-bridgeif_send_to_ports(bridgeif_private_t *br, struct pbuf *p, bridgeif_portmask_t dstports)
+bridgeif_send_to_ports(bridgeif_private_t *br, struct pbuf *p, bridgeif_portmask_t dstports, u8_t queue)
 {
   err_t err, ret_err = ERR_OK;
   u8_t i;
   bridgeif_portmask_t mask = 1;
+#if BRIDGEIF_TX_BATCH_LEN
+  struct pbuf *q = NULL;
+#endif /* BRIDGEIF_TX_BATCH_LEN */
   BRIDGEIF_DECL_PROTECT(lev);
+#if BRIDGEIF_TX_BATCH_LEN
+  if (queue && PBUF_NEEDS_COPY(p)) {
+    /* queued frames outlive this call: copy volatile data (once for all ports) */
+    q = pbuf_clone(PBUF_RAW, PBUF_RAM, p);
+    if (q == NULL) {
+      return ERR_MEM;
+    }
+    q->if_idx = p->if_idx;
+    p = q;
+  }
+#endif /* BRIDGEIF_TX_BATCH_LEN */
   BRIDGEIF_READ_PROTECT(lev);
   for (i = 0; i < BRIDGEIF_MAX_PORTS; i++, mask = (bridgeif_portmask_t)(mask << 1)) {
     if (dstports & mask) {
-      err = bridgeif_send_to_port(br, p, i);
+      err = bridgeif_send_to_port(br, p, i, queue);
       if (err != ERR_OK) {
         ret_err = err;
       }
     }
   }
   BRIDGEIF_READ_UNPROTECT(lev);
+#if BRIDGEIF_TX_BATCH_LEN
+  if (q != NULL) {
+    pbuf_free(q);
+  }
+#endif /* BRIDGEIF_TX_BATCH_LEN */
   return ret_err;
 }
 
+#if BRIDGEIF_VLAN
+/** Check if a frame carries a VLAN tag */
+static u8_t
+bridgeif_vlan_is_tagged(struct pbuf *p)
+{
+  return ((struct eth_hdr *)p->payload)->type == PP_HTONS(ETHTYPE_VLAN);
+}
+
+/** Write the VLAN tag of a frame (the addresses must already be in place) */
+static void
+bridgeif_vlan_write_tag(u8_t *hdr, u16_t tci)
+{
+  struct eth_vlan_hdr *vlan = (struct eth_vlan_hdr *)(hdr + SIZEOF_ETH_HDR);
+  ((struct eth_hdr *)hdr)->type = PP_HTONS(ETHTYPE_VLAN);
+  vlan->prio_vid = lwip_htons(tci);
+}
+
+/** Read the VLAN tag of a tagged frame */
+static u16_t
+bridgeif_vlan_get_tci(struct pbuf *p)
+{
+  struct eth_vlan_hdr *vlan = (struct eth_vlan_hdr *)(((u8_t *)p->payload) + SIZEOF_ETH_HDR);
+  return lwip_ntohs(vlan->prio_vid);
+}
+
+/** Get the VLAN of a frame received on a port with VLAN config 'vp'
+ * (untagged and priority tagged frames belong to the PVID). The frame is not
+ * changed, i.e. priority tagged frames still carry VLAN ID 0.
+ * @return the TCI (priority and VLAN ID) or -1 if the port is no member of the VLAN
+ */
+static s32_t
+bridgeif_vlan_classify(const bridgeif_vlan_port_t *vp, struct pbuf *p)
+{
+  u16_t tci;
+  if (bridgeif_vlan_is_tagged(p)) {
+    if (p->len < SIZEOF_ETH_HDR + SIZEOF_VLAN_HDR) {
+      return -1;
+    }
+    tci = bridgeif_vlan_get_tci(p);
+    if ((tci & BRIDGEIF_VLAN_VID_MASK) == 0) {
+      /* priority tagged frame */
+      tci = (u16_t)(tci | vp->pvid);
+    }
+  } else {
+    tci = vp->pvid;
+  }
+  if (!BRIDGEIF_VLAN_IS_MEMBER(vp, tci & BRIDGEIF_VLAN_VID_MASK)) {
+    return -1;
+  }
+  return tci;
+}
+
+/** Push (tci >= 0) or pop (tci < 0) the VLAN tag of a frame in place.
+ * This is only possible if the pbuf is not referenced by anyone else, owns its
+ * data and (to push) has enough header space.
+ */
+static u8_t
+bridgeif_vlan_retag_inplace(struct pbuf *p, s32_t tci)
+{
+  u8_t *hdr;
+  if ((p->ref != 1) || !(p->type_internal & PBUF_TYPE_FLAG_STRUCT_DATA_CONTIGUOUS)) {
+    return 0;
+  }
+  if (tci >= 0) {
+    if ((p->len < SIZEOF_ETH_HDR) || pbuf_add_header(p, SIZEOF_VLAN_HDR)) {
+      return 0;
+    }
+    hdr = (u8_t *)p->payload;
+    memmove(hdr, hdr + SIZEOF_VLAN_HDR, BRIDGEIF_ETH_ADDRS_LEN);
+    bridgeif_vlan_write_tag(hdr, (u16_t)tci);
+  } else {
+    if (p->len < SIZEOF_ETH_HDR + SIZEOF_VLAN_HDR) {
+      return 0;
+    }
+    hdr = (u8_t *)p->payload;
+    memmove(hdr + SIZEOF_VLAN_HDR, hdr, BRIDGEIF_ETH_ADDRS_LEN);
+    pbuf_remove_header(p, SIZEOF_VLAN_HDR);
+  }
+  return 1;
+}
+
+/** Push (tci >= 0) or pop (tci < 0) the VLAN tag of a frame on a copy.
+ * @return a new pbuf ('p' is unchanged) or NULL on error
+ */
+static struct pbuf *
+bridgeif_vlan_retag_copy(struct pbuf *p, s32_t tci)
+{
+  struct pbuf *q;
+  u8_t *hdr;
+  if (tci >= 0) {
+    q = pbuf_alloc(PBUF_RAW, (u16_t)(p->tot_len + SIZEOF_VLAN_HDR), PBUF_RAM);
+    if (q == NULL) {
+      return NULL;
+    }
+    hdr = (u8_t *)q->payload;
+    pbuf_copy_partial(p, hdr, BRIDGEIF_ETH_ADDRS_LEN, 0);
+    bridgeif_vlan_write_tag(hdr, (u16_t)tci);
+    pbuf_copy_partial(p, hdr + BRIDGEIF_ETH_ADDRS_LEN + SIZEOF_VLAN_HDR,
+                      (u16_t)(p->tot_len - BRIDGEIF_ETH_ADDRS_LEN), BRIDGEIF_ETH_ADDRS_LEN);
+  } else {
+    if (p->tot_len < SIZEOF_ETH_HDR + SIZEOF_VLAN_HDR) {
+      return NULL;
+    }
+    q = pbuf_alloc(PBUF_RAW, (u16_t)(p->tot_len - SIZEOF_VLAN_HDR), PBUF_RAM);
+    if (q == NULL) {
+      return NULL;
+    }
+    hdr = (u8_t *)q->payload;
+    pbuf_copy_partial(p, hdr, BRIDGEIF_ETH_ADDRS_LEN, 0);
+    pbuf_copy_partial(p, hdr + BRIDGEIF_ETH_ADDRS_LEN, (u16_t)(q->tot_len - BRIDGEIF_ETH_ADDRS_LEN),
+                      BRIDGEIF_ETH_ADDRS_LEN + SIZEOF_VLAN_HDR);
+  }
+  q->if_idx = p->if_idx;
+  return q;
+}
+
+/** Push (tci >= 0) or pop (tci < 0) the VLAN tag of a frame, in place if possible,
+ * else on a copy.
+ * @return 'p' (changed in place), a new pbuf ('p' is unchanged) or NULL on error
+ */
+static struct pbuf *
+bridgeif_vlan_retag(struct pbuf *p, s32_t tci)
+{
+  if (bridgeif_vlan_retag_inplace(p, tci)) {
+    return p;
+  }
+  return bridgeif_vlan_retag_copy(p, tci);
+}
+
+/** Pass a frame of VLAN 'tci' to all ports marked in 'dstports': untagged to ports
+ * with this PVID, tagged to all others. Ports needing the frame as it is are served
+ * first, then the tag is pushed/popped (in place if 'inplace' is set and no port
+ * kept a reference, else on a copy).
+ */
+static err_t
+bridgeif_vlan_send_to_ports(bridgeif_private_t *br, struct pbuf *p, bridgeif_portmask_t dstports,
+                            u16_t tci, u8_t queue, u8_t inplace)
+{
+  err_t err = ERR_OK, err2;
+  bridgeif_portmask_t untagged, first, second;
+  u8_t tagged = bridgeif_vlan_is_tagged(p);
+
+  bridgeif_vlan_ports(br, (u16_t)(tci & BRIDGEIF_VLAN_VID_MASK), &untagged);
+  first = dstports & (tagged ? (bridgeif_portmask_t)~untagged : untagged);
+  second = dstports & (tagged ? untagged : (bridgeif_portmask_t)~untagged);
+  if (first) {
+    err = bridgeif_send_to_ports(br, p, first, queue);
+  }
+  if (second & (bridgeif_portmask_t)~(1 << BRIDGEIF_MAX_PORTS)) {
+    s32_t new_tci = tagged ? -1 : (s32_t)tci;
+    struct pbuf *q = inplace ? bridgeif_vlan_retag(p, new_tci) : bridgeif_vlan_retag_copy(p, new_tci);
+    if (q == NULL) {
+      return ERR_MEM;
+    }
+    err2 = bridgeif_send_to_ports(br, q, second, queue);
+    if (err2 != ERR_OK) {
+      err = err2;
+    }
+    if (q != p) {
+      pbuf_free(q);
+    }
+  }
+  return err;
+}
+
+/** Bring a frame of VLAN 'tci' into the form the cpu port needs (untagged if
+ * this is its PVID, tagged otherwise). Takes over the reference to 'p'.
+ * @return the frame to pass to netif->input or NULL if it has been dropped
+ */
+static struct pbuf *
+bridgeif_vlan_to_cpu(bridgeif_private_t *br, struct pbuf *p, u16_t tci)
+{
+  u8_t tagged = (br->cpu_vlan.pvid != (tci & BRIDGEIF_VLAN_VID_MASK));
+  if (tagged != bridgeif_vlan_is_tagged(p)) {
+    struct pbuf *q = bridgeif_vlan_retag(p, tagged ? (s32_t)tci : -1);
+    if (q != p) {
+      pbuf_free(p);
+    }
+    return q;
+  }
+  return p;
+}
+
+/** Get the VLAN configuration of a port (the bridge netif is the cpu port) */
+static bridgeif_vlan_port_t *
+bridgeif_vlan_get_port(struct netif *bridgeif, struct netif *portif)
+{
+  u8_t i;
+  bridgeif_private_t *br;
+  LWIP_ASSERT("bridgeif != NULL", bridgeif != NULL);
+  br = (bridgeif_private_t *)bridgeif->state;
+  LWIP_ASSERT("bridgeif->state != NULL", br != NULL);
+
+  if (portif == bridgeif) {
+    return &br->cpu_vlan;
+  }
+  for (i = 0; i < br->num_ports; i++) {
+    if (br->ports[i].port_netif == portif) {
+      return &br->ports[i].vlan;
+    }
+  }
+  return NULL;
+}
+
+/** Add or remove a VLAN to/from a port's member set */
+static err_t
+bridgeif_vlan_set_member(struct netif *bridgeif, struct netif *portif, u16_t vid, u8_t member)
+{
+  bridgeif_vlan_port_t *vp;
+  BRIDGEIF_DECL_PROTECT(lev);
+
+  vp = bridgeif_vlan_get_port(bridgeif, portif);
+  if ((vp == NULL) || (vid == 0) || (vid > BRIDGEIF_VLAN_MAX_VID)) {
+    return ERR_VAL;
+  }
+  BRIDGEIF_READ_PROTECT(lev);
+  BRIDGEIF_WRITE_PROTECT(lev);
+  if (member) {
+    vp->member[vid >> 3] = (u8_t)(vp->member[vid >> 3] | (1 << (vid & 7)));
+  } else {
+    vp->member[vid >> 3] = (u8_t)(vp->member[vid >> 3] & ~(1 << (vid & 7)));
+  }
+  BRIDGEIF_WRITE_UNPROTECT(lev);
+  BRIDGEIF_READ_UNPROTECT(lev);
+  return ERR_OK;
+}
+
+/**
+ * @ingroup bridgeif
+ * Set the PVID of a port: untagged frames received on the port belong to this
+ * VLAN and frames of this VLAN are sent untagged on the port. The port is made a
+ * member of this VLAN.
+ * Pass the bridge netif as 'portif' to configure the cpu port.
+ */
+err_t
+bridgeif_vlan_set_pvid(struct netif *bridgeif, struct netif *portif, u16_t pvid)
+{
+  bridgeif_vlan_port_t *vp;
+  err_t err = bridgeif_vlan_set_member(bridgeif, portif, pvid, 1);
+  if (err == ERR_OK) {
+    vp = bridgeif_vlan_get_port(bridgeif, portif);
+    vp->pvid = pvid;
+  }
+  return err;
+}
+
+/**
+ * @ingroup bridgeif
+ * Make a port a member of a VLAN. Frames of this VLAN are forwarded to and
+ * accepted from this port (tagged, unless 'vid' is the port's PVID).
+ * Pass the bridge netif as 'portif' to configure the cpu port.
+ */
+err_t
+bridgeif_vlan_add(struct netif *bridgeif, struct netif *portif, u16_t vid)
+{
+  return bridgeif_vlan_set_member(bridgeif, portif, vid, 1);
+}
+
+/**
+ * @ingroup bridgeif
+ * Remove a port from a VLAN.
+ * Pass the bridge netif as 'portif' to configure the cpu port.
+ */
+err_t
+bridgeif_vlan_remove(struct netif *bridgeif, struct netif *portif, u16_t vid)
+{
+  return bridgeif_vlan_set_member(bridgeif, portif, vid, 0);
+}
+
+/** Default VLAN configuration: untagged member of the default VLAN only */
+static void
+bridgeif_vlan_init_port(bridgeif_vlan_port_t *vp)
+{
+  memset(vp->member, 0, sizeof(vp->member));
+  vp->pvid = BRIDGEIF_VLAN_DEFAULT_VID;
+  vp->member[BRIDGEIF_VLAN_DEFAULT_VID >> 3] = (u8_t)(1 << (BRIDGEIF_VLAN_DEFAULT_VID & 7));
+}
+#endif /* BRIDGEIF_VLAN */
+
 /** Output function of the application port of the bridge (the one with an ip address).
  * The forwarding port(s) where this pbuf is sent on is/are automatically selected
  * from the FDB.
@@ -300,9 +791,34 @@ bridgeif_output(struct netif *netif, struct pbuf *p)
   err_t err;
   bridgeif_private_t *br = (bridgeif_private_t *)netif->state;
   struct eth_addr *dst = (struct eth_addr *)(p->payload);
+  bridgeif_portmask_t dstports;
+#if BRIDGEIF_VLAN
+  struct pbuf *q = NULL;
+  s32_t tci = bridgeif_vlan_classify(&br->cpu_vlan, p);
+  if (tci < 0) {
+    return ERR_VAL;
+  }
+  if (bridgeif_vlan_is_tagged(p) && (bridgeif_vlan_get_tci(p) != tci)) {
+    /* priority tagged: the caller's frame must not be changed, tag a copy */
+    q = pbuf_clone(PBUF_RAW, PBUF_RAM, p);
+    if (q == NULL) {
+      return ERR_MEM;
+    }
+    bridgeif_vlan_write_tag((u8_t *)q->payload, (u16_t)tci);
+  }
 
-  bridgeif_portmask_t dstports = bridgeif_find_dst_ports(br, dst);
-  err = bridgeif_send_to_ports(br, p, dstports);
+  dstports = bridgeif_find_dst_ports(br, dst, (u16_t)(tci & BRIDGEIF_VLAN_VID_MASK));
+  if (q != NULL) {
+    err = bridgeif_vlan_send_to_ports(br, q, dstports, (u16_t)tci, 0, 1);
+    pbuf_free(q);
+  } else {
+    /* tags are pushed/popped on a copy */
+    err = bridgeif_vlan_send_to_ports(br, p, dstports, (u16_t)tci, 0, 0);
+  }
+#else /* BRIDGEIF_VLAN */
+  dstports = bridgeif_find_dst_ports(br, dst, 0);
+  err = bridgeif_send_to_ports(br, p, dstports, 0);
+#endif /* BRIDGEIF_VLAN */
 
   MIB2_STATS_NETIF_ADD(netif, ifoutoctets, p->tot_len);
   if (((u8_t *)p->payload)[0] & 1) {
@@ -330,6 +846,12 @@ bridgeif_input(struct pbuf *p, struct netif *netif)
   struct eth_addr *src, *dst;
   bridgeif_private_t *br;
   bridgeif_port_t *port;
+#if BRIDGEIF_VLAN
+  s32_t tci;
+  u16_t vid;
+#else /* BRIDGEIF_VLAN */
+  const u16_t vid = 0;
+#endif /* BRIDGEIF_VLAN */
   if (p == NULL || netif == NULL) {
     return ERR_VAL;
   }
@@ -343,20 +865,51 @@ bridgeif_input(struct pbuf *p, struct netif *netif)
   /* store receive index in pbuf */
   p->if_idx = rx_idx;
 
+#if BRIDGEIF_VLAN
+  tci = bridgeif_vlan_classify(&port->vlan, p);
+  if (tci < 0) {
+    /* ingress filtering: the port is no member of this VLAN */
+    LWIP_DEBUGF(BRIDGEIF_FW_DEBUG, ("br -> drop(%p): vlan\n", (void *)p));
+    pbuf_free(p);
+    return ERR_OK;
+  }
+  vid = (u16_t)(tci & BRIDGEIF_VLAN_VID_MASK);
+  if (bridgeif_vlan_is_tagged(p) && (bridgeif_vlan_get_tci(p) != tci)) {
+    /* forward priority tagged frames with the PVID */
+    bridgeif_vlan_write_tag((u8_t *)p->payload, (u16_t)tci);
+  }
+#endif /* BRIDGEIF_VLAN */
+
   dst = (struct eth_addr *)p->payload;
   src = (struct eth_addr *)(((u8_t *)p->payload) + sizeof(struct eth_addr));
 
   if ((src->addr[0] & 1) == 0) {
     /* update src for all non-group addresses */
+#if BRIDGEIF_VLAN
+    bridgeif_fdb_update_src(br->fdbd, src, vid, port->port_num);
+#else /* BRIDGEIF_VLAN */
     bridgeif_fdb_update_src(br->fdbd, src, port->port_num);
+#endif /* BRIDGEIF_VLAN */
   }
 
   if (dst->addr[0] & 1) {
     /* group address -> flood + cpu? */
-    dstports = bridgeif_find_dst_ports(br, dst);
-    bridgeif_send_to_ports(br, p, dstports);
+    dstports = bridgeif_find_dst_ports(br, dst, vid);
+    /* frames passed to ->input may be changed (and sent on) by the stack, so they
+       must be sent out before, not queued */
+#if BRIDGEIF_VLAN
+    bridgeif_vlan_send_to_ports(br, p, dstports, (u16_t)tci, (dstports & (1 << BRIDGEIF_MAX_PORTS)) == 0, 1);
+#else /* BRIDGEIF_VLAN */
+    bridgeif_send_to_ports(br, p, dstports, (dstports & (1 << BRIDGEIF_MAX_PORTS)) == 0);
+#endif /* BRIDGEIF_VLAN */
     if (dstports & (1 << BRIDGEIF_MAX_PORTS)) {
       /* we pass the reference to ->input or have to free it */
+#if BRIDGEIF_VLAN
+      p = bridgeif_vlan_to_cpu(br, p, (u16_t)tci);
+      if (p == NULL) {
+        return ERR_OK;
+      }
+#endif /* BRIDGEIF_VLAN */
       LWIP_DEBUGF(BRIDGEIF_FW_DEBUG, ("br -> input(%p)\n", (void *)p));
       if (br->netif->input(p, br->netif) != ERR_OK) {
         pbuf_free(p);
@@ -371,13 +924,33 @@ bridgeif_input(struct pbuf *p, struct netif *netif)
     /* is this for one of the local ports? */
     if (bridgeif_is_local_mac(br, dst)) {
       /* yes, send to cpu port only */
+#if BRIDGEIF_VLAN
+      if (!BRIDGEIF_VLAN_IS_MEMBER(&br->cpu_vlan, vid)) {
+        pbuf_free(p);
+        return ERR_OK;
+      }
+      p = bridgeif_vlan_to_cpu(br, p, (u16_t)tci);
+      if (p == NULL) {
+        return ERR_OK;
+      }
+      LWIP_DEBUGF(BRIDGEIF_FW_DEBUG, ("br -> input(%p)\n", (void *)p));
+      if (br->netif->input(p, br->netif) != ERR_OK) {
+        pbuf_free(p);
+      }
+      return ERR_OK;
+#else /* BRIDGEIF_VLAN */
       LWIP_DEBUGF(BRIDGEIF_FW_DEBUG, ("br -> input(%p)\n", (void *)p));
       return br->netif->input(p, br->netif);
+#endif /* BRIDGEIF_VLAN */
     }
 
     /* get dst port */
-    dstports = bridgeif_find_dst_ports(br, dst);
-    bridgeif_send_to_ports(br, p, dstports);
+    dstports = bridgeif_find_dst_ports(br, dst, vid);
+#if BRIDGEIF_VLAN
+    bridgeif_vlan_send_to_ports(br, p, dstports, (u16_t)tci, 1, 1);
+#else /* BRIDGEIF_VLAN */
+    bridgeif_send_to_ports(br, p, dstports, 1);
+#endif /* BRIDGEIF_VLAN */
     /* no need to send to cpu, flooding is for external ports only */
     /* by  this, we consumed the pbuf */
     pbuf_free(p);
@@ -448,6 +1021,9 @@ bridgeif_init(struct netif *netif)
 
   br->max_ports = init_data->max_ports;
   br->ports = (bridgeif_port_t *)(br + 1);
+#if BRIDGEIF_VLAN
+  bridgeif_vlan_init_port(&br->cpu_vlan);
+#endif /* BRIDGEIF_VLAN */
 
   br->max_fdbs_entries = init_data->max_fdb_static_entries;
   br->fdbs = (bridgeif_fdb_static_entry_t *)(((u8_t *)(br + 1)) + (init_data->max_ports * sizeof(bridgeif_port_t)));
@@ -544,6 +1120,9 @@ bridgeif_add_port(struct netif *bridgeif, struct netif *portif)
   port->port_netif = portif;
   port->port_num = br->num_ports;
   port->bridge = br;
+#if BRIDGEIF_VLAN
+  bridgeif_vlan_init_port(&port->vlan);
+#endif /* BRIDGEIF_VLAN */
   br->num_ports++;
 
   /* let the port call us on input */
@@ -51,127 +51,232 @@
 
 #define BR_FDB_TIMEOUT_SEC  (60*5) /* 5 minutes FDB timeout */
 
+/* Number of slots in the aging wheel: every entry is checked once per wheel
+   revolution (i.e. every BR_FDB_AGE_WHEEL_SLOTS seconds) instead of every second */
+#define BR_FDB_AGE_WHEEL_SLOTS  32
+
+/* Known source addresses seen again on the same port within this number of
+   seconds are not written again (saves writes/locking on the hot path) */
+#define BR_FDB_REFRESH_SEC  1
+
+/* Index used as end-of-list marker in hash, free and aging lists */
+#define BR_FDB_IDX_NONE     0xFFFF
+
 typedef struct bridgeif_dfdb_entry_s {
   u8_t used;
   u8_t port;
+  /** next entry in hash bucket list or free list */
+  u16_t next;
+  /** next entry in aging wheel slot list */
+  u16_t age_next;
+  /** time (bridgeif_dfdb_t::now) this entry was last learnt */
   u32_t ts;
   struct eth_addr addr;
+  /** VLAN ID (always 0 if BRIDGEIF_VLAN is disabled) */
+  u16_t vid;
 } bridgeif_dfdb_entry_t;
 
 typedef struct bridgeif_dfdb_s {
   u16_t max_fdb_entries;
+  /** number of hash buckets - 1 (number of buckets is a power of 2) */
+  u16_t bucket_mask;
+  /** head of the list of unused entries */
+  u16_t free_idx;
+  /** seconds since init, incremented by the aging timer */
+  u32_t now;
   bridgeif_dfdb_entry_t *fdb;
+  u16_t *buckets;
+  u16_t age_wheel[BR_FDB_AGE_WHEEL_SLOTS];
 } bridgeif_dfdb_t;
 
+/** Hash a (VLAN, mac address) pair to a bucket index */
+static u16_t
+bridgeif_fdb_hash(const bridgeif_dfdb_t *fdb, const struct eth_addr *addr, u16_t vid)
+{
+  /* the vendor part (first 3 bytes) is mostly the same on a network,
+     so mix in the last 4 bytes and only fold the first 2 bytes */
+  u32_t h = ((u32_t)addr->addr[2] << 24) | ((u32_t)addr->addr[3] << 16) |
+            ((u32_t)addr->addr[4] << 8) | addr->addr[5];
+  h ^= ((u32_t)addr->addr[0] << 8) | addr->addr[1] | ((u32_t)vid << 16);
+  h *= 0x9E3779B1UL;
+  return (u16_t)((h >> 16) & fdb->bucket_mask);
+}
+
+/** Look up an entry in the hash table, returns its index or BR_FDB_IDX_NONE */
+static u16_t
+bridgeif_fdb_find(const bridgeif_dfdb_t *fdb, const struct eth_addr *addr, u16_t vid)
+{
+  u16_t i = fdb->buckets[bridgeif_fdb_hash(fdb, addr, vid)];
+  while (i != BR_FDB_IDX_NONE) {
+    const bridgeif_dfdb_entry_t *e = &fdb->fdb[i];
+    if (e->used && (e->vid == vid) && !memcmp(&e->addr, addr, sizeof(struct eth_addr))) {
+      return i;
+    }
+    i = e->next;
+  }
+  return BR_FDB_IDX_NONE;
+}
+
+/** Put an entry into the aging wheel slot of the second it expires in */
+static void
+bridgeif_fdb_age_insert(bridgeif_dfdb_t *fdb, u16_t idx)
+{
+  bridgeif_dfdb_entry_t *e = &fdb->fdb[idx];
+  u16_t slot = (u16_t)((e->ts + BR_FDB_TIMEOUT_SEC) % BR_FDB_AGE_WHEEL_SLOTS);
+  e->age_next = fdb->age_wheel[slot];
+  fdb->age_wheel[slot] = idx;
+}
+
 /**
  * @ingroup bridgeif_fdb
- * A real simple and slow implementation of an auto-learning forwarding database that
- * remembers known src mac addresses to know which port to send frames destined for that
- * mac address.
+ * A simple auto-learning forwarding database that remembers known src mac
+ * addresses to know which port to send frames destined for that mac address.
  *
- * ATTENTION: This is meant as an example only, in real-world use, you should
- * provide a better implementation :-)
+ * Entries are kept in a hash table. An entry that is seen again on the same
+ * port within BR_FDB_REFRESH_SEC is not written at all, so in the common case,
+ * learning a source address is a read-only lookup.
+ * With BRIDGEIF_VLAN enabled, addresses are learnt per VLAN.
  */
 void
+#if BRIDGEIF_VLAN
+bridgeif_fdb_update_src(void *fdb_ptr, struct eth_addr *src_addr, u16_t vid, u8_t port_idx)
+#else /* BRIDGEIF_VLAN */
 bridgeif_fdb_update_src(void *fdb_ptr, struct eth_addr *src_addr, u8_t port_idx)
+#endif /* BRIDGEIF_VLAN */
 {
-  int i;
+  u16_t i;
   bridgeif_dfdb_t *fdb = (bridgeif_dfdb_t *)fdb_ptr;
+#if !BRIDGEIF_VLAN
+  const u16_t vid = 0;
+#endif /* !BRIDGEIF_VLAN */
   BRIDGEIF_DECL_PROTECT(lev);
   BRIDGEIF_READ_PROTECT(lev);
-  for (i = 0; i < fdb->max_fdb_entries; i++) {
+  i = bridgeif_fdb_find(fdb, src_addr, vid);
+  if (i != BR_FDB_IDX_NONE) {
     bridgeif_dfdb_entry_t *e = &fdb->fdb[i];
-    if (e->used && e->ts) {
-      if (!memcmp(&e->addr, src_addr, sizeof(struct eth_addr))) {
-        LWIP_DEBUGF(BRIDGEIF_FDB_DEBUG, ("br: update src %02x:%02x:%02x:%02x:%02x:%02x (from %d) @ idx %d\n",
-                                         src_addr->addr[0], src_addr->addr[1], src_addr->addr[2], src_addr->addr[3], src_addr->addr[4], src_addr->addr[5],
-                                         port_idx, i));
-        BRIDGEIF_WRITE_PROTECT(lev);
-        e->ts = BR_FDB_TIMEOUT_SEC;
-        e->port = port_idx;
-        BRIDGEIF_WRITE_UNPROTECT(lev);
-        BRIDGEIF_READ_UNPROTECT(lev);
-        return;
-      }
+    if ((e->port == port_idx) && ((u32_t)(fdb->now - e->ts) < BR_FDB_REFRESH_SEC)) {
+      /* refreshed recently, nothing to do */
+      BRIDGEIF_READ_UNPROTECT(lev);
+      return;
     }
   }
-  /* not found, allocate new entry from free */
-  for (i = 0; i < fdb->max_fdb_entries; i++) {
+  BRIDGEIF_WRITE_PROTECT(lev);
+  /* look up again when protected: the entry may have been aged out (and
+     its slot reused for another address) since the lookup above */
+  i = bridgeif_fdb_find(fdb, src_addr, vid);
+  if (i != BR_FDB_IDX_NONE) {
     bridgeif_dfdb_entry_t *e = &fdb->fdb[i];
-    if (!e->used || !e->ts) {
-      BRIDGEIF_WRITE_PROTECT(lev);
-      /* check again when protected */
-      if (!e->used || !e->ts) {
-        LWIP_DEBUGF(BRIDGEIF_FDB_DEBUG, ("br: create src %02x:%02x:%02x:%02x:%02x:%02x (from %d) @ idx %d\n",
-                                         src_addr->addr[0], src_addr->addr[1], src_addr->addr[2], src_addr->addr[3], src_addr->addr[4], src_addr->addr[5],
-                                         port_idx, i));
-        memcpy(&e->addr, src_addr, sizeof(struct eth_addr));
-        e->ts = BR_FDB_TIMEOUT_SEC;
-        e->port = port_idx;
-        e->used = 1;
-        BRIDGEIF_WRITE_UNPROTECT(lev);
-        BRIDGEIF_READ_UNPROTECT(lev);
-        return;
-      }
-      BRIDGEIF_WRITE_UNPROTECT(lev);
+    LWIP_DEBUGF(BRIDGEIF_FDB_DEBUG, ("br: update src %02x:%02x:%02x:%02x:%02x:%02x (from %d) @ idx %d\n",
+                                     src_addr->addr[0], src_addr->addr[1], src_addr->addr[2], src_addr->addr[3], src_addr->addr[4], src_addr->addr[5],
+                                     port_idx, i));
+    /* the aging wheel slot is corrected lazily when the entry's old slot comes up */
+    e->ts = fdb->now;
+    e->port = port_idx;
+  } else {
+    i = fdb->free_idx;
+    if (i != BR_FDB_IDX_NONE) {
+      bridgeif_dfdb_entry_t *e = &fdb->fdb[i];
+      u16_t bucket = bridgeif_fdb_hash(fdb, src_addr, vid);
+      LWIP_DEBUGF(BRIDGEIF_FDB_DEBUG, ("br: create src %02x:%02x:%02x:%02x:%02x:%02x (from %d) @ idx %d\n",
+                                       src_addr->addr[0], src_addr->addr[1], src_addr->addr[2], src_addr->addr[3], src_addr->addr[4], src_addr->addr[5],
+                                       port_idx, i));
+      fdb->free_idx = e->next;
+      /* fill the entry completely before linking it into the bucket */
+      memcpy(&e->addr, src_addr, sizeof(struct eth_addr));
+      e->vid = vid;
+      e->ts = fdb->now;
+      e->port = port_idx;
+      e->used = 1;
+      e->next = fdb->buckets[bucket];
+      fdb->buckets[bucket] = i;
+      bridgeif_fdb_age_insert(fdb, i);
     }
+    /* else: no free entry -> flood */
   }
+  BRIDGEIF_WRITE_UNPROTECT(lev);
   BRIDGEIF_READ_UNPROTECT(lev);
-  /* not found, no free entry -> flood */
 }
 
 /**
  * @ingroup bridgeif_fdb
- * Walk our list of auto-learnt fdb entries and return a port to forward or BR_FLOOD if unknown
+ * Look up our auto-learnt fdb entries and return a port to forward or BR_FLOOD if unknown
  */
 bridgeif_portmask_t
+#if BRIDGEIF_VLAN
+bridgeif_fdb_get_dst_ports(void *fdb_ptr, struct eth_addr *dst_addr, u16_t vid)
+#else /* BRIDGEIF_VLAN */
 bridgeif_fdb_get_dst_ports(void *fdb_ptr, struct eth_addr *dst_addr)
+#endif /* BRIDGEIF_VLAN */
 {
-  int i;
+  u16_t i;
+  bridgeif_portmask_t ret = BR_FLOOD;
   bridgeif_dfdb_t *fdb = (bridgeif_dfdb_t *)fdb_ptr;
+#if !BRIDGEIF_VLAN
+  const u16_t vid = 0;
+#endif /* !BRIDGEIF_VLAN */
   BRIDGEIF_DECL_PROTECT(lev);
   BRIDGEIF_READ_PROTECT(lev);
-  for (i = 0; i < fdb->max_fdb_entries; i++) {
-    bridgeif_dfdb_entry_t *e = &fdb->fdb[i];
-    if (e->used && e->ts) {
-      if (!memcmp(&e->addr, dst_addr, sizeof(struct eth_addr))) {
-        bridgeif_portmask_t ret = (bridgeif_portmask_t)(1 << e->port);
-        BRIDGEIF_READ_UNPROTECT(lev);
-        return ret;
-      }
-    }
+  i = bridgeif_fdb_find(fdb, dst_addr, vid);
+  if (i != BR_FDB_IDX_NONE) {
+    ret = (bridgeif_portmask_t)(1 << fdb->fdb[i].port);
   }
   BRIDGEIF_READ_UNPROTECT(lev);
-  return BR_FLOOD;
+  return ret;
+}
+
+/** Unlink an entry from its hash bucket and put it onto the free list */
+static void
+bridgeif_fdb_remove_entry(bridgeif_dfdb_t *fdb, u16_t idx)
+{
+  bridgeif_dfdb_entry_t *e = &fdb->fdb[idx];
+  u16_t *pidx = &fdb->buckets[bridgeif_fdb_hash(fdb, &e->addr, e->vid)];
+  while (*pidx != BR_FDB_IDX_NONE) {
+    if (*pidx == idx) {
+      *pidx = e->next;
+      break;
+    }
+    pidx = &fdb->fdb[*pidx].next;
+  }
+  e->used = 0;
+  e->next = fdb->free_idx;
+  fdb->free_idx = idx;
 }
 
 /**
  * @ingroup bridgeif_fdb
- * Aging implementation of our simple fdb
+ * Aging implementation of our simple fdb: only the entries in the current
+ * aging wheel slot are checked. Entries that have been refreshed since they
+ * were put into this slot are moved to the slot they expire in now.
  */
 static void
 bridgeif_fdb_age_one_second(void *fdb_ptr)
 {
-  int i;
+  u16_t i, slot;
   bridgeif_dfdb_t *fdb;
   BRIDGEIF_DECL_PROTECT(lev);
 
   fdb = (bridgeif_dfdb_t *)fdb_ptr;
   BRIDGEIF_READ_PROTECT(lev);
+  BRIDGEIF_WRITE_PROTECT(lev);
 
-  for (i = 0; i < fdb->max_fdb_entries; i++) {
+  fdb->now++;
+  slot = (u16_t)(fdb->now % BR_FDB_AGE_WHEEL_SLOTS);
+  i = fdb->age_wheel[slot];
+  fdb->age_wheel[slot] = BR_FDB_IDX_NONE;
+  while (i != BR_FDB_IDX_NONE) {
     bridgeif_dfdb_entry_t *e = &fdb->fdb[i];
-    if (e->used && e->ts) {
-      BRIDGEIF_WRITE_PROTECT(lev);
-      /* check again when protected */
-      if (e->used && e->ts) {
-        if (--e->ts == 0) {
-          e->used = 0;
-        }
-      }
-      BRIDGEIF_WRITE_UNPROTECT(lev);
+    u16_t next = e->age_next;
+    if ((u32_t)(fdb->now - e->ts) >= BR_FDB_TIMEOUT_SEC) {
+      LWIP_DEBUGF(BRIDGEIF_FDB_DEBUG, ("br: age out src %02x:%02x:%02x:%02x:%02x:%02x @ idx %d\n",
+                                       e->addr.addr[0], e->addr.addr[1], e->addr.addr[2], e->addr.addr[3], e->addr.addr[4], e->addr.addr[5], i));
+      bridgeif_fdb_remove_entry(fdb, i);
+    } else {
+      bridgeif_fdb_age_insert(fdb, i);
     }
+    i = next;
   }
+
+  BRIDGEIF_WRITE_UNPROTECT(lev);
   BRIDGEIF_READ_UNPROTECT(lev);
 }
 
@@ -189,14 +294,24 @@ bridgeif_age_tmr(void *arg)
 
 /**
  * @ingroup bridgeif_fdb
- * Init our simple fdb list
+ * Init our simple fdb hash table
  */
 void *
 bridgeif_fdb_init(u16_t max_fdb_entries)
 {
   bridgeif_dfdb_t *fdb;
-  size_t alloc_len_sizet = sizeof(bridgeif_dfdb_t) + (max_fdb_entries * sizeof(bridgeif_dfdb_entry_t));
-  mem_size_t alloc_len = (mem_size_t)alloc_len_sizet;
+  u16_t i, num_buckets = 1;
+  size_t alloc_len_sizet;
+  mem_size_t alloc_len;
+
+  LWIP_ASSERT("max_fdb_entries < BR_FDB_IDX_NONE", max_fdb_entries < BR_FDB_IDX_NONE);
+  /* one bucket per entry, rounded up to a power of 2 */
+  while ((num_buckets < max_fdb_entries) && (num_buckets < 0x8000)) {
+    num_buckets = (u16_t)(num_buckets << 1);
+  }
+  alloc_len_sizet = sizeof(bridgeif_dfdb_t) + (max_fdb_entries * sizeof(bridgeif_dfdb_entry_t)) +
+                    (num_buckets * sizeof(u16_t));
+  alloc_len = (mem_size_t)alloc_len_sizet;
   LWIP_ASSERT("alloc_len == alloc_len_sizet", alloc_len == alloc_len_sizet);
   LWIP_DEBUGF(BRIDGEIF_DEBUG, ("bridgeif_fdb_init: allocating %d bytes for private FDB data\n", (int)alloc_len));
   fdb = (bridgeif_dfdb_t *)mem_calloc(1, alloc_len);
@@ -204,7 +319,21 @@ bridgeif_fdb_init(u16_t max_fdb_entries)
     return NULL;
   }
   fdb->max_fdb_entries = max_fdb_entries;
+  fdb->bucket_mask = (u16_t)(num_buckets - 1);
   fdb->fdb = (bridgeif_dfdb_entry_t *)(fdb + 1);
+  fdb->buckets = (u16_t *)(fdb->fdb + max_fdb_entries);
+  for (i = 0; i < num_buckets; i++) {
+    fdb->buckets[i] = BR_FDB_IDX_NONE;
+  }
+  for (i = 0; i < BR_FDB_AGE_WHEEL_SLOTS; i++) {
+    fdb->age_wheel[i] = BR_FDB_IDX_NONE;
+  }
+  /* chain all entries into the free list */
+  fdb->free_idx = BR_FDB_IDX_NONE;
+  for (i = max_fdb_entries; i > 0; i--) {
+    fdb->fdb[i - 1].next = fdb->free_idx;
+    fdb->free_idx = (u16_t)(i - 1);
+  }
 
   sys_timeout(BRIDGEIF_AGE_TIMER_MS, bridgeif_age_tmr, fdb);
 
@@ -700,6 +700,10 @@ void link_down(ppp_pcb *pcb) {
     notify(link_down_notifier, 0);
 #endif /* PPP_NOTIFY */
 
+#if PPP_MULTILINK_SUPPORT
+    ppp_mp_leave(pcb);
+#endif /* PPP_MULTILINK_SUPPORT */
+
     if (!doing_multilink) {
 	upper_layers_down(pcb);
 	if (pcb->phase != PPP_PHASE_DEAD
@@ -922,6 +926,12 @@ void start_networks(ppp_pcb *pcb) {
 
     new_phase(pcb, PPP_PHASE_NETWORK);
 
+#if PPP_MULTILINK_SUPPORT
+    /* Member links of a bundle don't run the network control protocols */
+    if (ppp_mp_join(pcb))
+	return;
+#endif /* PPP_MULTILINK_SUPPORT */
+
 #ifdef HAVE_MULTILINK
     if (multilink) {
 	if (mp_join_bundle()) {
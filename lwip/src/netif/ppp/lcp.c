@@ -746,15 +746,15 @@ static void lcp_resetci(fsm *f) {
     wo->magicnumber = magic();
     wo->numloops = 0;
     *go = *wo;
-#ifdef HAVE_MULTILINK
-    if (!multilink) {
-	go->neg_mrru = 0;
-#endif /* HAVE_MULTILINK */
+#if PPP_MULTILINK_SUPPORT
+    if (!wo->neg_mrru) {
 	go->neg_ssnhf = 0;
 	go->neg_endpoint = 0;
-#ifdef HAVE_MULTILINK
     }
-#endif /* HAVE_MULTILINK */
+#else /* PPP_MULTILINK_SUPPORT */
+    go->neg_ssnhf = 0;
+    go->neg_endpoint = 0;
+#endif /* PPP_MULTILINK_SUPPORT */
     if (pcb->settings.noendpoint)
 	ao->neg_endpoint = 0;
     pcb->peer_mru = PPP_MRU;
@@ -820,9 +820,9 @@ static int lcp_cilen(fsm *f) {
 	    LENCILONG(go->neg_magicnumber) +
 	    LENCIVOID(go->neg_pcompression) +
 	    LENCIVOID(go->neg_accompression) +
-#ifdef HAVE_MULTILINK
+#if PPP_MULTILINK_SUPPORT
 	    LENCISHORT(go->neg_mrru) +
-#endif /* HAVE_MULTILINK */
+#endif /* PPP_MULTILINK_SUPPORT */
 	    LENCIVOID(go->neg_ssnhf) +
 	    (go->neg_endpoint? CILEN_CHAR + go->endpoint.length: 0));
 }
@@ -922,9 +922,9 @@ static void lcp_addci(fsm *f, u_char *ucp, int *lenp) {
     ADDCILONG(CI_MAGICNUMBER, go->neg_magicnumber, go->magicnumber);
     ADDCIVOID(CI_PCOMPRESSION, go->neg_pcompression);
     ADDCIVOID(CI_ACCOMPRESSION, go->neg_accompression);
-#ifdef HAVE_MULTILINK
+#if PPP_MULTILINK_SUPPORT
     ADDCISHORT(CI_MRRU, go->neg_mrru, go->mrru);
-#endif
+#endif /* PPP_MULTILINK_SUPPORT */
     ADDCIVOID(CI_SSNHF, go->neg_ssnhf);
     ADDCIENDP(CI_EPDISC, go->neg_endpoint, go->endpoint.class_,
 	      go->endpoint.value, go->endpoint.length);
@@ -1096,9 +1096,9 @@ static int lcp_ackci(fsm *f, u_char *p, int len) {
     ACKCILONG(CI_MAGICNUMBER, go->neg_magicnumber, go->magicnumber);
     ACKCIVOID(CI_PCOMPRESSION, go->neg_pcompression);
     ACKCIVOID(CI_ACCOMPRESSION, go->neg_accompression);
-#ifdef HAVE_MULTILINK
+#if PPP_MULTILINK_SUPPORT
     ACKCISHORT(CI_MRRU, go->neg_mrru, go->mrru);
-#endif /* HAVE_MULTILINK */
+#endif /* PPP_MULTILINK_SUPPORT */
     ACKCIVOID(CI_SSNHF, go->neg_ssnhf);
     ACKCIENDP(CI_EPDISC, go->neg_endpoint, go->endpoint.class_,
 	      go->endpoint.value, go->endpoint.length);
@@ -1429,7 +1429,7 @@ static int lcp_nakci(fsm *f, u_char *p, int len, int treat_as_reject) {
     NAKCIVOID(CI_PCOMPRESSION, neg_pcompression);
     NAKCIVOID(CI_ACCOMPRESSION, neg_accompression);
 
-#ifdef HAVE_MULTILINK
+#if PPP_MULTILINK_SUPPORT
     /*
      * Nak for MRRU option - accept their value if it is smaller
      * than the one we want.
@@ -1442,9 +1442,9 @@ static int lcp_nakci(fsm *f, u_char *p, int len, int treat_as_reject) {
 		       try_.mrru = cishort;
 		   );
     }
-#else /* HAVE_MULTILINK */
+#else /* PPP_MULTILINK_SUPPORT */
     LWIP_UNUSED_ARG(treat_as_reject);
-#endif /* HAVE_MULTILINK */
+#endif /* PPP_MULTILINK_SUPPORT */
 
     /*
      * Nak for short sequence numbers shouldn't be sent, treat it
@@ -1532,12 +1532,12 @@ static int lcp_nakci(fsm *f, u_char *p, int len, int treat_as_reject) {
 		goto bad;
 	    break;
 #endif /* LQR_SUPPORT */
-#ifdef HAVE_MULTILINK
+#if PPP_MULTILINK_SUPPORT
 	case CI_MRRU:
 	    if (go->neg_mrru || no.neg_mrru || cilen != CILEN_SHORT)
 		goto bad;
 	    break;
-#endif /* HAVE_MULTILINK */
+#endif /* PPP_MULTILINK_SUPPORT */
 	case CI_SSNHF:
 	    if (go->neg_ssnhf || no.neg_ssnhf || cilen != CILEN_VOID)
 		goto bad;
@@ -1782,9 +1782,9 @@ static int lcp_rejci(fsm *f, u_char *p, int len) {
     REJCILONG(CI_MAGICNUMBER, neg_magicnumber, go->magicnumber);
     REJCIVOID(CI_PCOMPRESSION, neg_pcompression);
     REJCIVOID(CI_ACCOMPRESSION, neg_accompression);
-#ifdef HAVE_MULTILINK
+#if PPP_MULTILINK_SUPPORT
     REJCISHORT(CI_MRRU, neg_mrru, go->mrru);
-#endif /* HAVE_MULTILINK */
+#endif /* PPP_MULTILINK_SUPPORT */
     REJCIVOID(CI_SSNHF, neg_ssnhf);
     REJCIENDP(CI_EPDISC, neg_endpoint, go->endpoint.class_,
 	      go->endpoint.value, go->endpoint.length);
@@ -2180,10 +2180,9 @@ static int lcp_reqci(fsm *f, u_char *inp, int *lenp, int reject_if_disagree) {
 	    ho->neg_accompression = 1;
 	    break;
 
-#ifdef HAVE_MULTILINK
+#if PPP_MULTILINK_SUPPORT
 	case CI_MRRU:
 	    if (!ao->neg_mrru
-		|| !multilink
 		|| cilen != CILEN_SHORT) {
 		orc = CONFREJ;
 		break;
@@ -2194,7 +2193,7 @@ static int lcp_reqci(fsm *f, u_char *inp, int *lenp, int reject_if_disagree) {
 	    ho->neg_mrru = 1;
 	    ho->mrru = cishort;
 	    break;
-#endif /* HAVE_MULTILINK */
+#endif /* PPP_MULTILINK_SUPPORT */
 
 	case CI_SSNHF:
 	    if (!ao->neg_ssnhf
@@ -2311,9 +2310,12 @@ static void lcp_up(fsm *f) {
      */
     mtu = ho->neg_mru? ho->mru: PPP_MRU;
     mru = go->neg_mru? LWIP_MAX(wo->mru, go->mru): PPP_MRU;
-#ifdef HAVE_MULTILINK
-    if (!(multilink && go->neg_mrru && ho->neg_mrru))
-#endif /* HAVE_MULTILINK */
+#if PPP_MULTILINK_SUPPORT
+    /* The interface of a bundle sends packets up to the peer MRRU */
+    if (go->neg_mrru && ho->neg_mrru)
+	netif_set_mtu(pcb, LWIP_MIN(ho->mrru, go->mrru));
+    else
+#endif /* PPP_MULTILINK_SUPPORT */
 	netif_set_mtu(pcb, LWIP_MIN(LWIP_MIN(mtu, mru), ao->mru));
     ppp_send_config(pcb, mtu,
 		    (ho->neg_asyncmap? ho->asyncmap: 0xffffffff),
@@ -0,0 +1,675 @@
+/**
+ * @file
+ * PPP Multilink Protocol (MLPPP, RFC 1990)
+ *
+ * Several PPP links to the same peer are bonded into a bundle. The bundle
+ * is one of the PPP links (the one the others are added to with
+ * ppp_mp_add_link()), it owns the netif and runs the network control
+ * protocols. Every link runs LCP and authentication on its own, links
+ * negotiating the MRRU option and the same endpoint discriminator as the
+ * bundle link join the bundle once they are up.
+ *
+ * Packets sent on the bundle are split into fragments carrying a multilink
+ * header (long sequence number format), fragment sizes are weighted by the
+ * link speeds and each fragment is sent on the link which would have sent
+ * its queue first. Received fragments are put back in order in a reorder
+ * window of PPP_MP_REORDER_WINDOW fragments, fragments known to be lost
+ * (RFC 1990 section 4.1) or missing for PPP_MP_REASM_TIMEOUT ms are skipped.
+ */
+
+/*
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ *
+ * This file is part of the lwIP TCP/IP stack.
+ *
+ */
+
+#include "netif/ppp/ppp_opts.h"
+#if PPP_SUPPORT && PPP_MULTILINK_SUPPORT /* don't build if not configured for use in lwipopts.h */
+
+#include <string.h>
+
+#include "lwip/pbuf.h"
+#include "lwip/snmp.h"
+
+#include "netif/ppp/ppp_impl.h"
+#include "netif/ppp/lcp.h"
+#include "netif/ppp/magic.h"
+#include "netif/ppp/mlppp.h"
+
+/* 24 bits sequence number arithmetic */
+#define MP_SEQ(s)             ((u32_t)(s) & PPP_MP_SEQ_MASK)
+#define MP_SEQ_BEFORE(a, b)   ((MP_SEQ((a) - (b)) & 0x00800000UL) != 0)
+#define MP_SLOT(s)            ((u16_t)((s) & (PPP_MP_REORDER_WINDOW - 1)))
+
+/* Speed assumed for links until ppp_mp_set_link_speed() is called, bit/s */
+#define MP_DEFAULT_SPEED      1000000UL
+
+static void ppp_mp_reassemble(ppp_pcb *bundle);
+static void ppp_mp_reasm_timeout(void *arg);
+
+/* Bundle a link belongs to, the link itself for the bundle link */
+static ppp_pcb *ppp_mp_bundle(ppp_pcb *pcb) {
+  return pcb->mp_bundle != NULL ? pcb->mp_bundle : pcb;
+}
+
+static ppp_mp_link *ppp_mp_find_link(ppp_pcb *bundle, ppp_pcb *pcb) {
+  int i;
+  for (i = 0; i < PPP_MP_MAX_LINKS; i++) {
+    if (bundle->mp.links[i].pcb == pcb) {
+      return &bundle->mp.links[i];
+    }
+  }
+  return NULL;
+}
+
+static void ppp_mp_link_speed(ppp_mp_link *link, u32_t speed) {
+  link->weight = LWIP_MAX(speed / 1000, 1);
+  /* 8 bits * 1000000 us * 256 per second, 1/256 us per byte */
+  link->cost = LWIP_MAX(2048000000UL / LWIP_MAX(speed, 1), 1);
+}
+
+/* Negotiate MRRU and our bundle endpoint discriminator on a link */
+static void ppp_mp_lcp_setup(ppp_pcb *pcb, u32_t magic) {
+  lcp_options *wo = &pcb->lcp_wantoptions;
+  lcp_options *ao = &pcb->lcp_allowoptions;
+  u_char *p = wo->endpoint.value;
+
+  wo->neg_mrru = 1;
+  wo->mrru = PPP_MP_MRRU;
+  ao->neg_mrru = 1;
+  ao->mrru = PPP_MP_MRRU;
+  wo->neg_endpoint = 1;
+  wo->endpoint.class_ = EPD_MAGIC;
+  wo->endpoint.length = 4;
+  PUTLONG(magic, p);
+}
+
+static void ppp_mp_lcp_clear(ppp_pcb *pcb) {
+  pcb->lcp_wantoptions.neg_mrru = 0;
+  pcb->lcp_allowoptions.neg_mrru = 0;
+  pcb->lcp_wantoptions.neg_endpoint = 0;
+}
+
+/*
+ * Add a PPP link to a bundle.
+ *
+ * The bundle is an existing PPP link, which becomes the bundle link the
+ * first time a link is added to it. Both links must be in the dead phase.
+ * Links are then connected as usual, with ppp_connect() or ppp_listen().
+ *
+ * Return ERR_OK on success, ERR_MEM if the bundle already has
+ * PPP_MP_MAX_LINKS links.
+ */
+err_t ppp_mp_add_link(ppp_pcb *bundle, ppp_pcb *pcb) {
+  ppp_mp_link *link;
+  LWIP_ASSERT_CORE_LOCKED();
+
+  if (bundle == NULL || pcb == NULL || bundle == pcb
+      || bundle->mp_bundle != NULL || pcb->mp_bundle != NULL
+      || pcb->mp.links[0].pcb != NULL) {
+    return ERR_VAL;
+  }
+  if (bundle->phase != PPP_PHASE_DEAD || pcb->phase != PPP_PHASE_DEAD) {
+    return ERR_CONN;
+  }
+
+  link = ppp_mp_find_link(bundle, NULL);
+  if (link == &bundle->mp.links[0]) {
+    /* First member link, set up the bundle link */
+    memset(&bundle->mp, 0, sizeof(bundle->mp));
+    bundle->mp.links[0].pcb = bundle;
+    ppp_mp_link_speed(&bundle->mp.links[0], MP_DEFAULT_SPEED);
+    bundle->mp.magic = magic();
+    ppp_mp_lcp_setup(bundle, bundle->mp.magic);
+    link = &bundle->mp.links[1];
+  }
+  if (link == NULL) {
+    return ERR_MEM;
+  }
+
+  PPPDEBUG(LOG_DEBUG, ("ppp_mp_add_link[%d]: link %d\n", bundle->netif->num, pcb->netif->num));
+  memset(link, 0, sizeof(*link));
+  link->pcb = pcb;
+  ppp_mp_link_speed(link, MP_DEFAULT_SPEED);
+  pcb->mp_bundle = bundle;
+  ppp_mp_lcp_setup(pcb, bundle->mp.magic);
+  return ERR_OK;
+}
+
+/*
+ * Remove a link from its bundle, or dissolve a bundle if called for the
+ * bundle link. All the links involved must be in the dead phase.
+ */
+err_t ppp_mp_remove_link(ppp_pcb *pcb) {
+  ppp_pcb *bundle = ppp_mp_bundle(pcb);
+  ppp_mp_link *link;
+  int i;
+  LWIP_ASSERT_CORE_LOCKED();
+
+  link = ppp_mp_find_link(bundle, pcb);
+  if (link == NULL) {
+    return ERR_VAL;
+  }
+  if (pcb->phase != PPP_PHASE_DEAD) {
+    return ERR_CONN;
+  }
+
+  if (pcb == bundle) {
+    for (i = 1; i < PPP_MP_MAX_LINKS; i++) {
+      if (bundle->mp.links[i].pcb != NULL && bundle->mp.links[i].pcb->phase != PPP_PHASE_DEAD) {
+        return ERR_CONN;
+      }
+    }
+    for (i = 1; i < PPP_MP_MAX_LINKS; i++) {
+      if (bundle->mp.links[i].pcb != NULL) {
+        bundle->mp.links[i].pcb->mp_bundle = NULL;
+        ppp_mp_lcp_clear(bundle->mp.links[i].pcb);
+      }
+    }
+    ppp_mp_lcp_clear(bundle);
+    memset(&bundle->mp, 0, sizeof(bundle->mp));
+    return ERR_OK;
+  }
+
+  memset(link, 0, sizeof(*link));
+  pcb->mp_bundle = NULL;
+  ppp_mp_lcp_clear(pcb);
+  return ERR_OK;
+}
+
+/*
+ * Set the transmit speed of a link of a bundle in bit/s, e.g. the rate
+ * reported by the modem on connect or the xDSL sync rate. Packets sent on
+ * the bundle are shared between links proportionally to their speed.
+ *
+ * Links are assumed to run at 1 Mbit/s until this is called.
+ */
+err_t ppp_mp_set_link_speed(ppp_pcb *pcb, u32_t speed) {
+  ppp_mp_link *link;
+  LWIP_ASSERT_CORE_LOCKED();
+
+  link = ppp_mp_find_link(ppp_mp_bundle(pcb), pcb);
+  if (link == NULL || speed == 0) {
+    return ERR_VAL;
+  }
+  ppp_mp_link_speed(link, speed);
+  return ERR_OK;
+}
+
+/* Joined link which will have sent its queue first */
+static ppp_mp_link *ppp_mp_next_link(ppp_pcb *bundle) {
+  ppp_mp_link *best = NULL;
+  int i;
+
+  for (i = 0; i < PPP_MP_MAX_LINKS; i++) {
+    ppp_mp_link *link = &bundle->mp.links[i];
+    if (link->joined && (best == NULL || (s32_t)(link->tx_time - best->tx_time) < 0)) {
+      best = link;
+    }
+  }
+  return best;
+}
+
+static void ppp_mp_join_link(ppp_pcb *bundle, ppp_mp_link *link) {
+  ppp_pcb *pcb = link->pcb;
+  lcp_options *ho = &pcb->lcp_hisoptions;
+  lcp_options *bho = &bundle->lcp_hisoptions;
+  ppp_mp_link *next;
+
+  /*
+   * Both ends must have agreed to multilink on this link, and the
+   * peer must be the same system as on the bundle link.
+   */
+  if (!pcb->lcp_gotoptions.neg_mrru || !ho->neg_mrru
+      || ho->neg_endpoint != bho->neg_endpoint
+      || (ho->neg_endpoint
+          && (ho->endpoint.class_ != bho->endpoint.class_
+              || ho->endpoint.length != bho->endpoint.length
+              || memcmp(ho->endpoint.value, bho->endpoint.value, ho->endpoint.length)))) {
+    ppp_warn("link does not belong to the bundle");
+    pcb->err_code = PPPERR_PROTOCOL;
+    lcp_close(pcb, "Not in bundle");
+    return;
+  }
+
+  PPPDEBUG(LOG_INFO, ("ppp_mp_join[%d]: link %d joined\n", bundle->netif->num, pcb->netif->num));
+  next = ppp_mp_next_link(bundle);
+  link->tx_time = next != NULL ? next->tx_time : 0;
+  link->seq_valid = 0;
+  link->joined = 1;
+  new_phase(pcb, PPP_PHASE_RUNNING);
+  pcb->link_status_cb(pcb, PPPERR_NONE, pcb->ctx_cb);
+}
+
+/*
+ * Called when a link enters the network phase.
+ *
+ * Member links join their bundle, or wait for the bundle link to come up.
+ * Return 1 if the network control protocols must not be started on this link.
+ */
+int ppp_mp_join(ppp_pcb *pcb) {
+  ppp_pcb *bundle = pcb->mp_bundle;
+  ppp_mp_state *mp = &pcb->mp;
+  int i;
+
+  if (bundle != NULL) {
+    if (bundle->mp.active) {
+      ppp_mp_join_link(bundle, ppp_mp_find_link(bundle, pcb));
+    } else if (bundle->phase == PPP_PHASE_NETWORK || bundle->phase == PPP_PHASE_RUNNING) {
+      /* The bundle link is up without multilink */
+      pcb->err_code = PPPERR_PROTOCOL;
+      lcp_close(pcb, "Multilink refused");
+    }
+    /* else wait for the bundle link */
+    return 1;
+  }
+
+  /* Single link */
+  if (mp->links[0].pcb != pcb) {
+    return 0;
+  }
+
+  if (!pcb->lcp_gotoptions.neg_mrru || !pcb->lcp_hisoptions.neg_mrru) {
+    ppp_warn("peer refused multilink");
+    for (i = 1; i < PPP_MP_MAX_LINKS; i++) {
+      if (mp->links[i].pcb != NULL && mp->links[i].pcb->phase == PPP_PHASE_NETWORK) {
+        mp->links[i].pcb->err_code = PPPERR_PROTOCOL;
+        lcp_close(mp->links[i].pcb, "Multilink refused");
+      }
+    }
+    return 0;
+  }
+
+  PPPDEBUG(LOG_INFO, ("ppp_mp_join[%d]: bundle up\n", pcb->netif->num));
+  mp->tx_seq = 0;
+  mp->rx_started = 0;
+  mp->active = 1;
+  mp->links[0].tx_time = 0;
+  mp->links[0].seq_valid = 0;
+  mp->links[0].joined = 1;
+
+  /* Member links which came up before the bundle link */
+  for (i = 1; i < PPP_MP_MAX_LINKS; i++) {
+    if (mp->links[i].pcb != NULL && mp->links[i].pcb->phase == PPP_PHASE_NETWORK) {
+      ppp_mp_join_link(pcb, &mp->links[i]);
+    }
+  }
+  return 0;
+}
+
+/* Free the fragments from rx_seq to rx_seq + count - 1 and move past them */
+static void ppp_mp_drop_frags(ppp_mp_state *mp, u16_t count) {
+  while (count--) {
+    u16_t i = MP_SLOT(mp->rx_seq);
+    if (mp->rx_frag[i] != NULL) {
+      pbuf_free(mp->rx_frag[i]);
+      mp->rx_frag[i] = NULL;
+      mp->rx_count--;
+      LINK_STATS_INC(link.drop);
+    }
+    mp->rx_seq = MP_SEQ(mp->rx_seq + 1);
+  }
+}
+
+/*
+ * Called when a link leaves the running phase.
+ *
+ * The bundle goes down with the bundle link, and takes its member links
+ * down with it.
+ */
+void ppp_mp_leave(ppp_pcb *pcb) {
+  ppp_pcb *bundle = ppp_mp_bundle(pcb);
+  ppp_mp_state *mp = &bundle->mp;
+  ppp_mp_link *link;
+  int i;
+
+  link = ppp_mp_find_link(bundle, pcb);
+  if (link == NULL || !link->joined) {
+    return;
+  }
+  link->joined = 0;
+
+  if (pcb != bundle) {
+    PPPDEBUG(LOG_INFO, ("ppp_mp_leave[%d]: link %d left\n", bundle->netif->num, pcb->netif->num));
+    /* Fragments might be waiting for this link */
+    ppp_mp_reassemble(bundle);
+    return;
+  }
+
+  PPPDEBUG(LOG_INFO, ("ppp_mp_leave[%d]: bundle down\n", bundle->netif->num));
+  mp->active = 0;
+  if (mp->timer_running) {
+    UNTIMEOUT(ppp_mp_reasm_timeout, bundle);
+    mp->timer_running = 0;
+  }
+  ppp_mp_drop_frags(mp, PPP_MP_REORDER_WINDOW);
+
+  for (i = 1; i < PPP_MP_MAX_LINKS; i++) {
+    ppp_pcb *member = mp->links[i].pcb;
+    if (member != NULL && (mp->links[i].joined || member->phase == PPP_PHASE_NETWORK)) {
+      mp->links[i].joined = 0;
+      member->err_code = PPPERR_CONNECT;
+      lcp_close(member, "Bundle down");
+    }
+  }
+}
+
+/* Send one fragment of pb, offset and len include the 2 bytes protocol field */
+static err_t ppp_mp_send_frag(ppp_pcb *bundle, ppp_mp_link *link, struct pbuf *pb, u16_t protocol,
+                              u16_t offset, u16_t len, u8_t flags) {
+  ppp_pcb *pcb = link->pcb;
+  struct pbuf *fpb;
+  u8_t *s;
+  u32_t seq;
+  err_t err;
+
+  fpb = pbuf_alloc(PBUF_RAW, PPP_MP_HDRLEN + len, PBUF_RAM);
+  if (fpb == NULL) {
+    LINK_STATS_INC(link.memerr);
+    LINK_STATS_INC(link.drop);
+    MIB2_STATS_NETIF_INC(bundle->netif, ifoutdiscards);
+    return ERR_MEM;
+  }
+
+  seq = bundle->mp.tx_seq;
+  bundle->mp.tx_seq = MP_SEQ(seq + 1);
+
+  s = (u8_t*)fpb->payload;
+  PUTCHAR(flags, s);
+  PUTCHAR(seq >> 16, s);
+  PUTSHORT(seq, s);
+  if (offset == 0) {
+    PUTSHORT(protocol, s);
+    len -= 2;
+  } else {
+    offset -= 2;
+  }
+  pbuf_copy_partial(pb, s, len, offset);
+
+  link->tx_time += fpb->tot_len * link->cost;
+  err = pcb->link_cb->netif_output(pcb, pcb->link_ctx_cb, fpb, PPP_MP);
+  pbuf_free(fpb);
+  return err;
+}
+
+/*
+ * Send a packet on the bundle.
+ *
+ * Packets are split into fragments weighted by the link speeds, fragments
+ * of at least PPP_MP_MIN_FRAG bytes which fit in the link MRU. Each
+ * fragment goes to the link which will have sent its queue first.
+ */
+err_t ppp_mp_output(ppp_pcb *pcb, struct pbuf *pb, u16_t protocol) {
+  ppp_mp_state *mp = &pcb->mp;
+  ppp_mp_link *link;
+  u32_t weight_sum = 0;
+  u16_t len, offset, frag_len;
+  u8_t shift = 0;
+  int nlinks = 0;
+  int i;
+  err_t err;
+
+  for (i = 0; i < PPP_MP_MAX_LINKS; i++) {
+    if (mp->links[i].joined) {
+      weight_sum += mp->links[i].weight;
+      nlinks++;
+    }
+  }
+  /* Only the ratio of the weights matters, keep len * weight within 32 bits */
+  while ((weight_sum >> shift) > 0xffff) {
+    shift++;
+  }
+
+  link = ppp_mp_next_link(pcb);
+  if (link == NULL) {
+    return ERR_RTE;
+  }
+
+  /* A single link carries packets which fit as they are */
+  if (nlinks == 1 && pb->tot_len <= link->pcb->peer_mru) {
+    link->tx_time += pb->tot_len * link->cost;
+    return link->pcb->link_cb->netif_output(link->pcb, link->pcb->link_ctx_cb, pb, protocol);
+  }
+
+  len = pb->tot_len + 2;
+  offset = 0;
+  while (offset < len) {
+    frag_len = len - offset;
+    if (nlinks > 1 && len >= 2 * PPP_MP_MIN_FRAG) {
+      u16_t share = (u16_t)(((u32_t)len * (link->weight >> shift)) / (weight_sum >> shift));
+      share = LWIP_MAX(share, PPP_MP_MIN_FRAG);
+      if (frag_len >= share + PPP_MP_MIN_FRAG) {
+        frag_len = share;
+      }
+    }
+    frag_len = LWIP_MIN(frag_len, link->pcb->peer_mru - PPP_MP_HDRLEN);
+
+    err = ppp_mp_send_frag(pcb, link, pb, protocol, offset, frag_len,
+                           (offset == 0 ? PPP_MP_FLAG_B : 0) | (offset + frag_len == len ? PPP_MP_FLAG_E : 0));
+    if (err != ERR_OK) {
+      /* The peer drops the fragments already sent */
+      return err;
+    }
+    offset += frag_len;
+    link = ppp_mp_next_link(pcb);
+  }
+  return ERR_OK;
+}
+
+/*
+ * Number of fragments after rx_seq which are either received or lost: every
+ * link has received a later sequence number (M in RFC 1990 section 4.1).
+ */
+static u32_t ppp_mp_known(ppp_mp_state *mp) {
+  u32_t known = PPP_MP_SEQ_MASK;
+  int i;
+
+  for (i = 0; i < PPP_MP_MAX_LINKS; i++) {
+    ppp_mp_link *link = &mp->links[i];
+    if (link->joined) {
+      if (!link->seq_valid || MP_SEQ_BEFORE(link->last_seq, mp->rx_seq)) {
+        return 0;
+      }
+      known = LWIP_MIN(known, MP_SEQ(link->last_seq - mp->rx_seq));
+    }
+  }
+  return known;
+}
+
+/* Pass the count fragments from rx_seq, a complete packet, to PPP input */
+static void ppp_mp_deliver(ppp_pcb *bundle, u16_t count) {
+  ppp_mp_state *mp = &bundle->mp;
+  struct pbuf *p = NULL;
+  u8_t *pl;
+
+  while (count--) {
+    u16_t i = MP_SLOT(mp->rx_seq);
+    if (p == NULL) {
+      p = mp->rx_frag[i];
+    } else {
+      pbuf_cat(p, mp->rx_frag[i]);
+    }
+    mp->rx_frag[i] = NULL;
+    mp->rx_count--;
+    mp->rx_seq = MP_SEQ(mp->rx_seq + 1);
+  }
+
+  if (p->tot_len > PPP_MP_MRRU + 2 || p->len < 1) {
+    goto drop;
+  }
+  /* Protocol field may be compressed, PPP input wants it in 2 bytes */
+  if (((u8_t*)p->payload)[0] & 0x01) {
+    if (pbuf_add_header(p, 1)) {
+      goto drop;
+    }
+    ((u8_t*)p->payload)[0] = 0;
+  }
+  pl = (u8_t*)p->payload;
+  if (p->len < 2 || ((pl[0] << 8) | pl[1]) == PPP_MP) {
+    goto drop;
+  }
+  ppp_input(bundle, p);
+  return;
+
+drop:
+  PPPDEBUG(LOG_WARNING, ("ppp_mp_deliver[%d]: dropping bad packet\n", bundle->netif->num));
+  LINK_STATS_INC(link.drop);
+  MIB2_STATS_NETIF_INC(bundle->netif, ifindiscards);
+  pbuf_free(p);
+}
+
+static void ppp_mp_reasm_timeout(void *arg) {
+  ppp_pcb *bundle = (ppp_pcb*)arg;
+  ppp_mp_state *mp = &bundle->mp;
+
+  mp->timer_running = 0;
+  /* Give up on the packet at the head, resume at the next beginning fragment */
+  PPPDEBUG(LOG_INFO, ("ppp_mp_reasm_timeout[%d]: seq %"U32_F" lost\n", bundle->netif->num, mp->rx_seq));
+  do {
+    ppp_mp_drop_frags(mp, 1);
+  } while (mp->rx_count > 0
+           && !(mp->rx_frag[MP_SLOT(mp->rx_seq)] != NULL && (mp->rx_flags[MP_SLOT(mp->rx_seq)] & PPP_MP_FLAG_B)));
+  ppp_mp_reassemble(bundle);
+}
+
+/*
+ * Deliver the complete packets at the head of the reorder window and
+ * skip the fragments which are lost.
+ */
+static void ppp_mp_reassemble(ppp_pcb *bundle) {
+  ppp_mp_state *mp = &bundle->mp;
+  u32_t start = mp->rx_seq;
+  u32_t known;
+  u16_t n;
+
+  while (mp->active && mp->rx_count > 0) {
+    known = ppp_mp_known(mp);
+
+    /* Find the end of the packet at the head */
+    for (n = 0; n < PPP_MP_REORDER_WINDOW; n++) {
+      u16_t i = MP_SLOT(mp->rx_seq + n);
+      if (mp->rx_frag[i] == NULL
+          || (n == 0 && !(mp->rx_flags[i] & PPP_MP_FLAG_B))
+          || (n > 0 && (mp->rx_flags[i] & PPP_MP_FLAG_B))
+          || (mp->rx_flags[i] & PPP_MP_FLAG_E)) {
+        break;
+      }
+    }
+    if (n == PPP_MP_REORDER_WINDOW) {
+      /* No ending fragment fits in the window */
+      ppp_mp_drop_frags(mp, 1);
+      continue;
+    }
+
+    if (mp->rx_frag[MP_SLOT(mp->rx_seq + n)] == NULL) {
+      /* Missing fragment: wait for it, unless it is lost */
+      if (n >= known) {
+        break;
+      }
+      ppp_mp_drop_frags(mp, n + 1);
+    } else if (n == 0 && !(mp->rx_flags[MP_SLOT(mp->rx_seq)] & PPP_MP_FLAG_B)) {
+      /* Rest of a packet whose beginning is lost */
+      ppp_mp_drop_frags(mp, 1);
+    } else if (n > 0 && (mp->rx_flags[MP_SLOT(mp->rx_seq + n)] & PPP_MP_FLAG_B)) {
+      /* Next packet begins before this one ended */
+      ppp_mp_drop_frags(mp, n);
+    } else {
+      ppp_mp_deliver(bundle, n + 1);
+    }
+  }
+
+  if (!mp->active) {
+    return;
+  }
+  if (mp->rx_count == 0) {
+    if (mp->timer_running) {
+      UNTIMEOUT(ppp_mp_reasm_timeout, bundle);
+      mp->timer_running = 0;
+    }
+  } else if (!mp->timer_running || mp->rx_seq != start) {
+    TIMEOUTMS(ppp_mp_reasm_timeout, bundle, PPP_MP_REASM_TIMEOUT);
+    mp->timer_running = 1;
+  }
+}
+
+/*
+ * Process a multilink fragment received on a link of the bundle.
+ */
+void ppp_mp_input(ppp_pcb *pcb, struct pbuf *pb) {
+  ppp_pcb *bundle = ppp_mp_bundle(pcb);
+  ppp_mp_state *mp = &bundle->mp;
+  ppp_mp_link *link;
+  u8_t *hdr;
+  u8_t flags;
+  u32_t seq;
+  u16_t i;
+
+  link = ppp_mp_find_link(bundle, pcb);
+  if (!mp->active || link == NULL || !link->joined || pb->len < PPP_MP_HDRLEN) {
+    PPPDEBUG(LOG_WARNING, ("ppp_mp_input[%d]: dropping fragment\n", pcb->netif->num));
+    goto drop;
+  }
+
+  hdr = (u8_t*)pb->payload;
+  flags = hdr[0] & (PPP_MP_FLAG_B | PPP_MP_FLAG_E);
+  seq = ((u32_t)hdr[1] << 16) | ((u32_t)hdr[2] << 8) | hdr[3];
+  pbuf_remove_header(pb, PPP_MP_HDRLEN);
+
+  link->last_seq = seq;
+  link->seq_valid = 1;
+
+  if (!mp->rx_started) {
+    mp->rx_seq = seq;
+    mp->rx_started = 1;
+  }
+  if (MP_SEQ_BEFORE(seq, mp->rx_seq)) {
+    /* Already given up on */
+    goto drop;
+  }
+  if (MP_SEQ(seq - mp->rx_seq) >= PPP_MP_REORDER_WINDOW) {
+    /* Window full, give up on the oldest fragments */
+    u32_t skip = MP_SEQ(seq - mp->rx_seq) - (PPP_MP_REORDER_WINDOW - 1);
+    ppp_mp_drop_frags(mp, (u16_t)LWIP_MIN(skip, PPP_MP_REORDER_WINDOW));
+    mp->rx_seq = MP_SEQ(seq - (PPP_MP_REORDER_WINDOW - 1));
+  }
+
+  i = MP_SLOT(seq);
+  if (mp->rx_frag[i] != NULL) {
+    /* Duplicate */
+    goto drop;
+  }
+  mp->rx_frag[i] = pb;
+  mp->rx_flags[i] = flags;
+  mp->rx_count++;
+
+  ppp_mp_reassemble(bundle);
+  return;
+
+drop:
+  LINK_STATS_INC(link.drop);
+  MIB2_STATS_NETIF_INC(pcb->netif, ifindiscards);
+  pbuf_free(pb);
+}
+
+#endif /* PPP_SUPPORT && PPP_MULTILINK_SUPPORT */
@@ -397,6 +397,14 @@ err_t ppp_free(ppp_pcb *pcb) {
     return ERR_CONN;
   }
 
+#if PPP_MULTILINK_SUPPORT
+  /* Leave the bundle, a bundle can only be freed after its member links */
+  if ((pcb->mp_bundle != NULL || pcb->mp.links[0].pcb != NULL)
+      && ppp_mp_remove_link(pcb) != ERR_OK) {
+    return ERR_CONN;
+  }
+#endif /* PPP_MULTILINK_SUPPORT */
+
   PPPDEBUG(LOG_DEBUG, ("ppp_free[%d]\n", pcb->netif->num));
 
   netif_remove(pcb->netif);
@@ -588,6 +596,13 @@ static err_t ppp_netif_output(struct netif *netif, struct pbuf *pb, u16_t protoc
   }
 #endif /* CCP_SUPPORT */
 
+#if PPP_MULTILINK_SUPPORT
+  if (pcb->mp.active) {
+    err = ppp_mp_output(pcb, pb, protocol);
+    goto err;
+  }
+#endif /* PPP_MULTILINK_SUPPORT */
+
   err = pcb->link_cb->netif_output(pcb, pcb->link_ctx_cb, pb, protocol);
   goto err;
 
@@ -825,6 +840,21 @@ void ppp_input(ppp_pcb *pcb, struct pbuf *pb) {
     goto drop;
   }
 
+#if PPP_MULTILINK_SUPPORT
+  if (protocol == PPP_MP) {
+    ppp_mp_input(pcb, pb);
+    return;
+  }
+
+  /* Network packets received on a member link belong to the bundle */
+  if (pcb->mp_bundle != NULL && protocol < 0xC000) {
+    if (!pcb->mp_bundle->mp.active) {
+      goto drop;
+    }
+    pcb = pcb->mp_bundle;
+  }
+#endif /* PPP_MULTILINK_SUPPORT */
+
 #if CCP_SUPPORT
 #if MPPE_SUPPORT
   /*
@@ -57,6 +57,11 @@
  *           the stack from the main loop (needs SYS_LIGHTWEIGHT_PROT for
  *           pbuf_alloc to work on ISR level!).
  *
+ * Received bytes are decoded a block at a time: for 1) and 2), up to
+ * SLIP_RX_BLOCK_SIZE bytes are read from the serial line at once, for 3)
+ * slipif_received_bytes() should be preferred, e.g. called with the bytes
+ * a DMA transfer has written to an RX ring buffer.
+ *
  */
 
 #include "netif/slipif.h"
@@ -69,6 +74,8 @@
 #include "lwip/sys.h"
 #include "lwip/sio.h"
 
+#include <string.h>
+
 #define SLIP_END     0xC0 /* 0300: start and end of every packet */
 #define SLIP_ESC     0xDB /* 0333: escape start (one byte escaped data follows) */
 #define SLIP_ESC_END 0xDC /* 0334: following escape: original byte is 0xC0 (END) */
@@ -195,53 +202,134 @@ slipif_output_v6(struct netif *netif, struct pbuf *p, const ip6_addr_t *ipaddr)
 }
 #endif /* LWIP_IPV6 */
 
+/*
+ * Word-at-a-time test for SLIP_END and SLIP_ESC, the only bytes that
+ * interrupt a run of packet data.
+ */
+#define SLIP_ONES             0x01010101UL
+#define SLIP_HAS_ZERO(v)      (((v) - SLIP_ONES) & ~(v) & 0x80808080UL)
+#define SLIP_MAY_SPECIAL(v)   (SLIP_HAS_ZERO((v) ^ (SLIP_ONES * SLIP_END)) || \
+                               SLIP_HAS_ZERO((v) ^ (SLIP_ONES * SLIP_ESC)))
+
+/**
+ * Return the number of bytes at the start of 's' that are neither
+ * SLIP_END nor SLIP_ESC.
+ */
+static u16_t
+slipif_scan(const u8_t *s, u16_t len)
+{
+  u16_t i = 0;
+
+  while (len - i >= 4) {
+    u32_t v;
+    MEMCPY(&v, s + i, sizeof(v));
+    if (SLIP_MAY_SPECIAL(v)) {
+      break;
+    }
+    i += 4;
+  }
+  for (; i < len; i++) {
+    if (s[i] == SLIP_END || s[i] == SLIP_ESC) {
+      break;
+    }
+  }
+  return i;
+}
+
+/**
+ * Append decoded bytes to the packet being received, allocating
+ * PBUF_POOL pbufs as needed.
+ *
+ * @param priv the slipif private data
+ * @param data decoded bytes
+ * @param len number of decoded bytes
+ */
+static void
+slipif_rxstore(struct slipif_priv *priv, const u8_t *data, u16_t len)
+{
+  /* this automatically drops bytes if > SLIP_MAX_SIZE */
+  if (priv->recved >= SLIP_MAX_SIZE) {
+    return;
+  }
+  len = (u16_t)LWIP_MIN(len, SLIP_MAX_SIZE - priv->recved);
+
+  while (len > 0) {
+    u16_t chunk;
+
+    if (priv->p == NULL) {
+      /* allocate a new pbuf */
+      LWIP_DEBUGF(SLIP_DEBUG, ("slipif_input: alloc\n"));
+      priv->p = pbuf_alloc(PBUF_LINK, (PBUF_POOL_BUFSIZE - PBUF_LINK_HLEN - PBUF_LINK_ENCAPSULATION_HLEN), PBUF_POOL);
+
+      if (priv->p == NULL) {
+        LINK_STATS_INC(link.drop);
+        LWIP_DEBUGF(SLIP_DEBUG, ("slipif_input: no new pbuf! (DROP)\n"));
+        /* don't process any further since we got no pbuf to receive to */
+        return;
+      }
+
+      if (priv->q != NULL) {
+        /* 'chain' the pbuf to the existing chain */
+        pbuf_cat(priv->q, priv->p);
+      } else {
+        /* p is the first pbuf in the chain */
+        priv->q = priv->p;
+      }
+    }
+
+    chunk = (u16_t)LWIP_MIN(len, priv->p->len - priv->i);
+    MEMCPY((u8_t *)priv->p->payload + priv->i, data, chunk);
+    priv->recved = (u16_t)(priv->recved + chunk);
+    priv->i = (u16_t)(priv->i + chunk);
+    data += chunk;
+    len = (u16_t)(len - chunk);
+    if (priv->i >= priv->p->len) {
+      /* on to the next pbuf */
+      priv->i = 0;
+      if (priv->p->next != NULL && priv->p->next->len > 0) {
+        /* p is a chain, on to the next in the chain */
+        priv->p = priv->p->next;
+      } else {
+        /* p is a single pbuf, set it to NULL so next time a new
+         * pbuf is allocated */
+        priv->p = NULL;
+      }
+    }
+  }
+}
+
 /**
- * Handle the incoming SLIP stream character by character
+ * Handle a block of the incoming SLIP stream
+ *
+ * Runs of bytes that need no decoding are copied to the packet at once,
+ * only SLIP_END, SLIP_ESC and the byte following SLIP_ESC are handled
+ * one by one.
  *
  * @param netif the lwip network interface structure for this slipif
- * @param c received character (multiple calls to this function will
- *        return a complete packet, NULL is returned before - used for polling)
- * @return The IP packet when SLIP_END is received
+ * @param data received bytes
+ * @param len number of received bytes
+ * @param p set to the IP packet when SLIP_END is received, to NULL otherwise
+ * @return the number of bytes processed, processing stops after the
+ *         SLIP_END of a complete packet
  */
-static struct pbuf *
-slipif_rxbyte(struct netif *netif, u8_t c)
+static u16_t
+slipif_rxblock(struct netif *netif, const u8_t *data, u16_t len, struct pbuf **p)
 {
   struct slipif_priv *priv;
-  struct pbuf *t;
+  u16_t i = 0, n;
+  u8_t c;
 
   LWIP_ASSERT("netif != NULL", (netif != NULL));
   LWIP_ASSERT("netif->state != NULL", (netif->state != NULL));
 
   priv = (struct slipif_priv *)netif->state;
+  *p = NULL;
 
-  switch (priv->state) {
-    case SLIP_RECV_NORMAL:
-      switch (c) {
-        case SLIP_END:
-          if (priv->recved > 0) {
-            /* Received whole packet. */
-            /* Trim the pbuf to the size of the received packet. */
-            pbuf_realloc(priv->q, priv->recved);
-
-            LINK_STATS_INC(link.recv);
-
-            LWIP_DEBUGF(SLIP_DEBUG, ("slipif: Got packet (%"U16_F" bytes)\n", priv->recved));
-            t = priv->q;
-            priv->p = priv->q = NULL;
-            priv->i = priv->recved = 0;
-            return t;
-          }
-          return NULL;
-        case SLIP_ESC:
-          priv->state = SLIP_RECV_ESCAPE;
-          return NULL;
-        default:
-          break;
-      } /* end switch (c) */
-      break;
-    case SLIP_RECV_ESCAPE:
+  while (i < len) {
+    if (priv->state == SLIP_RECV_ESCAPE) {
       /* un-escape END or ESC bytes, leave other bytes
          (although that would be a protocol error) */
+      c = data[i++];
       switch (c) {
         case SLIP_ESC_END:
           c = SLIP_END;
@@ -253,67 +341,56 @@ slipif_rxbyte(struct netif *netif, u8_t c)
           break;
       }
       priv->state = SLIP_RECV_NORMAL;
-      break;
-    default:
-      break;
-  } /* end switch (priv->state) */
-
-  /* byte received, packet not yet completely received */
-  if (priv->p == NULL) {
-    /* allocate a new pbuf */
-    LWIP_DEBUGF(SLIP_DEBUG, ("slipif_input: alloc\n"));
-    priv->p = pbuf_alloc(PBUF_LINK, (PBUF_POOL_BUFSIZE - PBUF_LINK_HLEN - PBUF_LINK_ENCAPSULATION_HLEN), PBUF_POOL);
-
-    if (priv->p == NULL) {
-      LINK_STATS_INC(link.drop);
-      LWIP_DEBUGF(SLIP_DEBUG, ("slipif_input: no new pbuf! (DROP)\n"));
-      /* don't process any further since we got no pbuf to receive to */
-      return NULL;
+      slipif_rxstore(priv, &c, 1);
+      continue;
     }
 
-    if (priv->q != NULL) {
-      /* 'chain' the pbuf to the existing chain */
-      pbuf_cat(priv->q, priv->p);
-    } else {
-      /* p is the first pbuf in the chain */
-      priv->q = priv->p;
+    n = slipif_scan(data + i, (u16_t)(len - i));
+    slipif_rxstore(priv, data + i, n);
+    i = (u16_t)(i + n);
+    if (i >= len) {
+      break;
     }
-  }
 
-  /* this automatically drops bytes if > SLIP_MAX_SIZE */
-  if ((priv->p != NULL) && (priv->recved <= SLIP_MAX_SIZE)) {
-    ((u8_t *)priv->p->payload)[priv->i] = c;
-    priv->recved++;
-    priv->i++;
-    if (priv->i >= priv->p->len) {
-      /* on to the next pbuf */
-      priv->i = 0;
-      if (priv->p->next != NULL && priv->p->next->len > 0) {
-        /* p is a chain, on to the next in the chain */
-        priv->p = priv->p->next;
-      } else {
-        /* p is a single pbuf, set it to NULL so next time a new
-         * pbuf is allocated */
-        priv->p = NULL;
-      }
+    if (data[i++] == SLIP_ESC) {
+      priv->state = SLIP_RECV_ESCAPE;
+    } else if (priv->recved > 0) {
+      /* SLIP_END: received whole packet. */
+      /* Trim the pbuf to the size of the received packet. */
+      pbuf_realloc(priv->q, priv->recved);
+
+      LINK_STATS_INC(link.recv);
+
+      LWIP_DEBUGF(SLIP_DEBUG, ("slipif: Got packet (%"U16_F" bytes)\n", priv->recved));
+      *p = priv->q;
+      priv->p = priv->q = NULL;
+      priv->i = priv->recved = 0;
+      break;
     }
   }
-  return NULL;
+  return i;
 }
 
-/** Like slipif_rxbyte, but passes completed packets to netif->input
+/** Like slipif_rxblock, but passes completed packets to netif->input
  *
  * @param netif The lwip network interface structure for this slipif
- * @param c received character
+ * @param data received bytes
+ * @param len number of received bytes
  */
 static void
-slipif_rxbyte_input(struct netif *netif, u8_t c)
+slipif_rxblock_input(struct netif *netif, const u8_t *data, u16_t len)
 {
   struct pbuf *p;
-  p = slipif_rxbyte(netif, c);
-  if (p != NULL) {
-    if (netif->input(p, netif) != ERR_OK) {
-      pbuf_free(p);
+  u16_t n;
+
+  while (len > 0) {
+    n = slipif_rxblock(netif, data, len, &p);
+    data += n;
+    len = (u16_t)(len - n);
+    if (p != NULL) {
+      if (netif->input(p, netif) != ERR_OK) {
+        pbuf_free(p);
+      }
     }
   }
 }
@@ -329,13 +406,15 @@ slipif_rxbyte_input(struct netif *netif, u8_t c)
 static void
 slipif_loop_thread(void *nf)
 {
-  u8_t c;
+  u8_t buf[SLIP_RX_BLOCK_SIZE];
+  u32_t len;
   struct netif *netif = (struct netif *)nf;
   struct slipif_priv *priv = (struct slipif_priv *)netif->state;
 
   while (1) {
-    if (sio_read(priv->sd, &c, 1) > 0) {
-      slipif_rxbyte_input(netif, c);
+    len = sio_read(priv->sd, buf, sizeof(buf));
+    if (len > 0) {
+      slipif_rxblock_input(netif, buf, (u16_t)len);
     }
   }
 }
@@ -425,7 +504,8 @@ slipif_init(struct netif *netif)
 void
 slipif_poll(struct netif *netif)
 {
-  u8_t c;
+  u8_t buf[SLIP_RX_BLOCK_SIZE];
+  u32_t len;
   struct slipif_priv *priv;
 
   LWIP_ASSERT("netif != NULL", (netif != NULL));
@@ -433,8 +513,8 @@ slipif_poll(struct netif *netif)
 
   priv = (struct slipif_priv *)netif->state;
 
-  while (sio_tryread(priv->sd, &c, 1) > 0) {
-    slipif_rxbyte_input(netif, c);
+  while ((len = sio_tryread(priv->sd, buf, sizeof(buf))) > 0) {
+    slipif_rxblock_input(netif, buf, (u16_t)len);
   }
 }
 
@@ -479,39 +559,35 @@ slipif_process_rxqueue(struct netif *netif)
   SYS_ARCH_UNPROTECT(old_level);
 }
 
-/** Like slipif_rxbyte, but queues completed packets.
+/** Queue a completed packet.
  *
  * @param netif The lwip network interface structure for this slipif
- * @param data Received serial byte
+ * @param p Received packet
  */
 static void
-slipif_rxbyte_enqueue(struct netif *netif, u8_t data)
+slipif_rxpacket_enqueue(struct netif *netif, struct pbuf *p)
 {
-  struct pbuf *p;
   struct slipif_priv *priv = (struct slipif_priv *)netif->state;
   SYS_ARCH_DECL_PROTECT(old_level);
 
-  p = slipif_rxbyte(netif, data);
-  if (p != NULL) {
-    SYS_ARCH_PROTECT(old_level);
-    if (priv->rxpackets != NULL) {
+  SYS_ARCH_PROTECT(old_level);
+  if (priv->rxpackets != NULL) {
 #if SLIP_RX_QUEUE
-      /* queue multiple pbufs */
-      struct pbuf *q = p;
-      while (q->next != NULL) {
-        q = q->next;
-      }
-      q->next = p;
-    } else {
-#else /* SLIP_RX_QUEUE */
-      pbuf_free(priv->rxpackets);
+    /* queue multiple pbufs */
+    struct pbuf *q = priv->rxpackets;
+    while (q->next != NULL) {
+      q = q->next;
     }
-    {
+    q->next = p;
+  } else {
+#else /* SLIP_RX_QUEUE */
+    pbuf_free(priv->rxpackets);
+  }
+  {
 #endif /* SLIP_RX_QUEUE */
-      priv->rxpackets = p;
-    }
-    SYS_ARCH_UNPROTECT(old_level);
+    priv->rxpackets = p;
   }
+  SYS_ARCH_UNPROTECT(old_level);
 }
 
 /**
@@ -527,9 +603,7 @@ slipif_rxbyte_enqueue(struct netif *netif, u8_t data)
 void
 slipif_received_byte(struct netif *netif, u8_t data)
 {
-  LWIP_ASSERT("netif != NULL", (netif != NULL));
-  LWIP_ASSERT("netif->state != NULL", (netif->state != NULL));
-  slipif_rxbyte_enqueue(netif, data);
+  slipif_received_bytes(netif, &data, 1);
 }
 
 /**
@@ -540,19 +614,24 @@ slipif_received_byte(struct netif *netif, u8_t data)
  * This function can be called from ISR if SYS_LIGHTWEIGHT_PROT is enabled.
  *
  * @param netif The lwip network interface structure for this slipif
- * @param data received character
+ * @param data received characters
  * @param len Number of received characters
+ *
+ * @note len is an u16_t since lwIP 2.2.0, it was an u8_t before.
  */
 void
-slipif_received_bytes(struct netif *netif, u8_t *data, u8_t len)
+slipif_received_bytes(struct netif *netif, u8_t *data, u16_t len)
 {
-  u8_t i;
-  u8_t *rxdata = data;
-  LWIP_ASSERT("netif != NULL", (netif != NULL));
-  LWIP_ASSERT("netif->state != NULL", (netif->state != NULL));
-
-  for (i = 0; i < len; i++, rxdata++) {
-    slipif_rxbyte_enqueue(netif, *rxdata);
+  struct pbuf *p;
+  u16_t n;
+
+  while (len > 0) {
+    n = slipif_rxblock(netif, data, len, &p);
+    data += n;
+    len = (u16_t)(len - n);
+    if (p != NULL) {
+      slipif_rxpacket_enqueue(netif, p);
+    }
   }
 }
 #endif /* SLIP_RX_FROM_ISR */
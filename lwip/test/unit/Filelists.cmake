@@ -15,8 +15,12 @@ endif()
 set(LWIP_TESTDIR ${LWIP_DIR}/test/unit)
 set(LWIP_TESTFILES
 	${LWIP_TESTDIR}/lwip_unittests.c
+	${LWIP_TESTDIR}/altcp_tls/test_altcp_tls.c
+	${LWIP_TESTDIR}/altcp_tls/test_altcp_tls_mem.c
 	${LWIP_TESTDIR}/api/test_sockets.c
 	${LWIP_TESTDIR}/arch/sys_arch.c
+	${LWIP_TESTDIR}/bridgeif/test_bridgeif.c
+	${LWIP_TESTDIR}/bridgeif/test_bridgeif_fdb.c
 	${LWIP_TESTDIR}/core/test_def.c
 	${LWIP_TESTDIR}/core/test_mem.c
 	${LWIP_TESTDIR}/core/test_netif.c
@@ -26,10 +30,17 @@ set(LWIP_TESTFILES
 	${LWIP_TESTDIR}/etharp/test_etharp.c
 	${LWIP_TESTDIR}/ip4/test_ip4.c
 	${LWIP_TESTDIR}/ip6/test_ip6.c
+	${LWIP_TESTDIR}/http/test_http_client.c
+	${LWIP_TESTDIR}/http/test_httpd.c
 	${LWIP_TESTDIR}/mdns/test_mdns.c
 	${LWIP_TESTDIR}/mqtt/test_mqtt.c
+	${LWIP_TESTDIR}/ppp/test_pppos.c
+	${LWIP_TESTDIR}/slipif/test_slipif.c
+	${LWIP_TESTDIR}/snmp/test_snmp.c
+	${LWIP_TESTDIR}/snmp/test_snmpv3.c
 	${LWIP_TESTDIR}/tcp/tcp_helper.c
 	${LWIP_TESTDIR}/tcp/test_tcp_oos.c
 	${LWIP_TESTDIR}/tcp/test_tcp.c
+	${LWIP_TESTDIR}/tftp/test_tftp.c
 	${LWIP_TESTDIR}/udp/test_udp.c
 )
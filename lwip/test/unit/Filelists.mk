@@ -31,8 +31,12 @@
 
 TESTDIR=$(LWIPDIR)/../test/unit
 TESTFILES=$(TESTDIR)/lwip_unittests.c \
+	$(TESTDIR)/altcp_tls/test_altcp_tls.c \
+	$(TESTDIR)/altcp_tls/test_altcp_tls_mem.c \
 	$(TESTDIR)/api/test_sockets.c \
 	$(TESTDIR)/arch/sys_arch.c \
+	$(TESTDIR)/bridgeif/test_bridgeif.c \
+	$(TESTDIR)/bridgeif/test_bridgeif_fdb.c \
 	$(TESTDIR)/core/test_def.c \
 	$(TESTDIR)/core/test_mem.c \
 	$(TESTDIR)/core/test_netif.c \
@@ -42,10 +46,17 @@ TESTFILES=$(TESTDIR)/lwip_unittests.c \
 	$(TESTDIR)/etharp/test_etharp.c \
 	$(TESTDIR)/ip4/test_ip4.c \
 	$(TESTDIR)/ip6/test_ip6.c \
+	$(TESTDIR)/http/test_http_client.c \
+	$(TESTDIR)/http/test_httpd.c \
 	$(TESTDIR)/mdns/test_mdns.c \
 	$(TESTDIR)/mqtt/test_mqtt.c \
+	$(TESTDIR)/ppp/test_pppos.c \
+	$(TESTDIR)/slipif/test_slipif.c \
+	$(TESTDIR)/snmp/test_snmp.c \
+	$(TESTDIR)/snmp/test_snmpv3.c \
 	$(TESTDIR)/tcp/tcp_helper.c \
 	$(TESTDIR)/tcp/test_tcp_oos.c \
 	$(TESTDIR)/tcp/test_tcp.c \
+	$(TESTDIR)/tftp/test_tftp.c \
 	$(TESTDIR)/udp/test_udp.c
 
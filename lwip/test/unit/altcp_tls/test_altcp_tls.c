@@ -0,0 +1,400 @@
+#include "test_altcp_tls.h"
+
+#include "lwip/altcp.h"
+#include "lwip/altcp_tls.h"
+#include "lwip/apps/altcp_tls_mbedtls_opts.h"
+#include "lwip/priv/tcp_priv.h"
+#include "lwip/tcpip.h"
+#include "arch/sys_arch.h"
+
+#include <string.h>
+
+#if LWIP_ALTCP && LWIP_ALTCP_TLS && LWIP_ALTCP_TLS_MBEDTLS
+
+#if !ALTCP_MBEDTLS_USE_CLIENT_SESSION_CACHE || !ALTCP_MBEDTLS_USE_SESSION_CACHE
+#error "These tests need ALTCP_MBEDTLS_USE_CLIENT_SESSION_CACHE and ALTCP_MBEDTLS_USE_SESSION_CACHE"
+#endif
+
+#include "mbedtls/ssl.h"
+#include "mbedtls/certs.h"
+
+#define TEST_TLS_PORT 4433
+/* sys_now() advance while verifying the server certificate (full handshakes only) */
+#define TEST_TLS_VERIFY_MS 7
+
+static struct altcp_tls_config *test_srv_conf;
+static struct altcp_tls_config *test_cli_conf;
+static struct altcp_pcb *test_srv_listen;
+static struct altcp_pcb *test_srv_conn;
+static struct altcp_pcb *test_cli;
+static u8_t test_cli_connected;
+static u8_t test_srv_accepted;
+static u32_t test_srv_rx_len;
+static u8_t test_srv_rx_closed;
+
+/* Process everything queued on the loopback netif, including delayed ACKs */
+static void
+test_tls_pump(void)
+{
+  int i;
+  for (i = 0; i < 4; i++) {
+    while (tcpip_thread_poll_one());
+    LOCK_TCPIP_CORE();
+    tcp_fasttmr();
+    UNLOCK_TCPIP_CORE();
+  }
+}
+
+static int
+test_tls_verify(void *arg, mbedtls_x509_crt *crt, int depth, uint32_t *flags)
+{
+  LWIP_UNUSED_ARG(arg);
+  LWIP_UNUSED_ARG(crt);
+  LWIP_UNUSED_ARG(depth);
+  LWIP_UNUSED_ARG(flags);
+  lwip_sys_now += TEST_TLS_VERIFY_MS;
+  return 0;
+}
+
+static err_t
+test_tls_recv(void *arg, struct altcp_pcb *pcb, struct pbuf *p, err_t err)
+{
+  struct altcp_pcb **conn = (struct altcp_pcb **)arg;
+  LWIP_UNUSED_ARG(err);
+  if (p == NULL) {
+    if (conn == &test_srv_conn) {
+      test_srv_rx_closed = 1;
+    }
+    *conn = NULL;
+    altcp_arg(pcb, NULL);
+    altcp_recv(pcb, NULL);
+    altcp_err(pcb, NULL);
+    if (altcp_close(pcb) != ERR_OK) {
+      altcp_abort(pcb);
+      return ERR_ABRT;
+    }
+    return ERR_OK;
+  }
+  if (conn == &test_srv_conn) {
+    test_srv_rx_len += p->tot_len;
+  }
+  altcp_recved(pcb, p->tot_len);
+  pbuf_free(p);
+  return ERR_OK;
+}
+
+static void
+test_tls_err(void *arg, err_t err)
+{
+  struct altcp_pcb **conn = (struct altcp_pcb **)arg;
+  LWIP_UNUSED_ARG(err);
+  if (conn != NULL) {
+    *conn = NULL;
+  }
+}
+
+static err_t
+test_tls_accept(void *arg, struct altcp_pcb *pcb, err_t err)
+{
+  LWIP_UNUSED_ARG(arg);
+  fail_unless(err == ERR_OK);
+  fail_unless(test_srv_conn == NULL);
+  test_srv_conn = pcb;
+  test_srv_accepted++;
+  altcp_arg(pcb, &test_srv_conn);
+  altcp_recv(pcb, test_tls_recv);
+  altcp_err(pcb, test_tls_err);
+  return ERR_OK;
+}
+
+static err_t
+test_tls_connected(void *arg, struct altcp_pcb *pcb, err_t err)
+{
+  LWIP_UNUSED_ARG(arg);
+  LWIP_UNUSED_ARG(pcb);
+  fail_unless(err == ERR_OK);
+  test_cli_connected = 1;
+  return ERR_OK;
+}
+
+/* Connect to the server with a server name and wait for the handshake */
+static void
+test_tls_open(const char *host)
+{
+  ip_addr_t loop;
+  err_t err;
+
+  IP_ADDR4(&loop, 127, 0, 0, 1);
+  test_cli_connected = 0;
+  LOCK_TCPIP_CORE();
+  test_cli = altcp_tls_new(test_cli_conf, IPADDR_TYPE_V4);
+  fail_unless(test_cli != NULL);
+  fail_unless(mbedtls_ssl_set_hostname((mbedtls_ssl_context *)altcp_tls_context(test_cli), host) == 0);
+  mbedtls_ssl_set_verify((mbedtls_ssl_context *)altcp_tls_context(test_cli), test_tls_verify, NULL);
+  altcp_arg(test_cli, &test_cli);
+  altcp_recv(test_cli, test_tls_recv);
+  altcp_err(test_cli, test_tls_err);
+  err = altcp_connect(test_cli, &loop, TEST_TLS_PORT, test_tls_connected);
+  UNLOCK_TCPIP_CORE();
+  fail_unless(err == ERR_OK);
+  test_tls_pump();
+  fail_unless(test_cli_connected);
+  fail_unless(test_srv_conn != NULL);
+}
+
+/* Close the client connection and wait for the server to close, too */
+static void
+test_tls_close(void)
+{
+  err_t err;
+
+  LOCK_TCPIP_CORE();
+  altcp_arg(test_cli, NULL);
+  altcp_recv(test_cli, NULL);
+  altcp_err(test_cli, NULL);
+  err = altcp_close(test_cli);
+  UNLOCK_TCPIP_CORE();
+  fail_unless(err == ERR_OK);
+  test_cli = NULL;
+  test_tls_pump();
+  fail_unless(test_srv_conn == NULL);
+}
+
+/* Connect to the server with a server name, wait for the handshake and close again */
+static void
+test_tls_connect(const char *host)
+{
+  test_tls_open(host);
+  test_tls_close();
+}
+
+/* Number of bytes queued on the tcp pcb of the client */
+static u32_t
+test_tls_cli_tcp_queued(void)
+{
+  struct tcp_pcb *tpcb = (struct tcp_pcb *)test_cli->inner_conn->state;
+  return tpcb->snd_lbb;
+}
+
+static void
+test_tls_check_stats(u32_t full, u32_t resumed)
+{
+  struct altcp_tls_handshake_stats stats;
+  altcp_tls_get_handshake_stats(test_cli_conf, &stats);
+  fail_unless(stats.full == full);
+  fail_unless(stats.resumed == resumed);
+  /* only full handshakes verify the certificate */
+  fail_unless(stats.full_ms >= full * TEST_TLS_VERIFY_MS);
+  fail_unless(stats.resumed_ms < TEST_TLS_VERIFY_MS);
+}
+
+/* Setups/teardown functions */
+
+static void
+altcp_tls_setup(void)
+{
+  err_t err;
+  lwip_check_ensure_no_alloc(SKIP_POOL(MEMP_SYS_TIMEOUT));
+  test_srv_conn = NULL;
+  test_cli = NULL;
+  test_srv_accepted = 0;
+  test_srv_rx_len = 0;
+  test_srv_rx_closed = 0;
+  LOCK_TCPIP_CORE();
+  test_srv_conf = altcp_tls_create_config_server_privkey_cert(
+    (const u8_t *)mbedtls_test_srv_key, mbedtls_test_srv_key_len, NULL, 0,
+    (const u8_t *)mbedtls_test_srv_crt, mbedtls_test_srv_crt_len);
+  fail_unless(test_srv_conf != NULL);
+  test_cli_conf = altcp_tls_create_config_client(NULL, 0);
+  fail_unless(test_cli_conf != NULL);
+  test_srv_listen = altcp_tls_new(test_srv_conf, IPADDR_TYPE_ANY);
+  fail_unless(test_srv_listen != NULL);
+  err = altcp_bind(test_srv_listen, IP_ANY_TYPE, TEST_TLS_PORT);
+  fail_unless(err == ERR_OK);
+  test_srv_listen = altcp_listen(test_srv_listen);
+  fail_unless(test_srv_listen != NULL);
+  altcp_accept(test_srv_listen, test_tls_accept);
+  UNLOCK_TCPIP_CORE();
+}
+
+static void
+altcp_tls_teardown(void)
+{
+  LOCK_TCPIP_CORE();
+  if (test_cli != NULL) {
+    altcp_arg(test_cli, NULL);
+    altcp_abort(test_cli);
+    test_cli = NULL;
+  }
+  if (test_srv_conn != NULL) {
+    altcp_arg(test_srv_conn, NULL);
+    altcp_abort(test_srv_conn);
+    test_srv_conn = NULL;
+  }
+  altcp_close(test_srv_listen);
+  while (tcp_tw_pcbs != NULL) {
+    tcp_abort(tcp_tw_pcbs);
+  }
+  fail_unless(tcp_active_pcbs == NULL);
+  altcp_tls_free_config(test_cli_conf);
+  altcp_tls_free_config(test_srv_conf);
+  UNLOCK_TCPIP_CORE();
+  while (tcpip_thread_poll_one());
+  lwip_check_ensure_no_alloc(SKIP_POOL(MEMP_SYS_TIMEOUT));
+}
+
+/* Test functions */
+
+/** A saved session is restored for the same server name (in any case) */
+START_TEST(test_altcp_tls_session_resume)
+{
+  LWIP_UNUSED_ARG(_i);
+
+  test_tls_connect("Costarring");
+  test_tls_check_stats(1, 0);
+  test_tls_connect("costarring");
+  test_tls_check_stats(1, 1);
+  test_tls_connect("COSTARRING");
+  test_tls_check_stats(1, 2);
+  fail_unless(test_srv_accepted == 3);
+}
+END_TEST
+
+/** Server names with the same hash do not share a session */
+START_TEST(test_altcp_tls_session_hash_collision)
+{
+  LWIP_UNUSED_ARG(_i);
+
+  /* FNV-1a("costarring") == FNV-1a("liquid") */
+  test_tls_connect("costarring");
+  test_tls_check_stats(1, 0);
+  test_tls_connect("liquid");
+  test_tls_check_stats(2, 0);
+  /* both sessions are cached */
+  test_tls_connect("costarring");
+  test_tls_check_stats(2, 1);
+  test_tls_connect("liquid");
+  test_tls_check_stats(2, 2);
+}
+END_TEST
+
+/** Sessions of servers with names too long to be stored are not cached */
+START_TEST(test_altcp_tls_session_long_name)
+{
+  char host[ALTCP_MBEDTLS_CLIENT_SESSION_HOST_LEN + 2];
+  LWIP_UNUSED_ARG(_i);
+
+  memset(host, 'a', sizeof(host) - 1);
+  host[sizeof(host) - 1] = 0;
+  test_tls_connect(host);
+  test_tls_connect(host);
+  test_tls_check_stats(2, 0);
+
+  /* the maximum length is fine */
+  host[sizeof(host) - 2] = 0;
+  test_tls_connect(host);
+  test_tls_connect(host);
+  test_tls_check_stats(3, 1);
+}
+END_TEST
+
+/** Writes flagged with TCP_WRITE_FLAG_MORE are coalesced into one record */
+START_TEST(test_altcp_tls_tx_coalesce)
+{
+  static const char data[10] = "0123456789";
+  u32_t start;
+  int expansion;
+  int i;
+  err_t err;
+  LWIP_UNUSED_ARG(_i);
+
+  test_tls_open("coalesce");
+  LOCK_TCPIP_CORE();
+  expansion = mbedtls_ssl_get_record_expansion((mbedtls_ssl_context *)altcp_tls_context(test_cli));
+  fail_unless(expansion > 0);
+  start = test_tls_cli_tcp_queued();
+  for (i = 0; i < 10; i++) {
+    err = altcp_write(test_cli, data, sizeof(data), TCP_WRITE_FLAG_MORE);
+    fail_unless(err == ERR_OK);
+  }
+  /* nothing is encrypted yet */
+  fail_unless(test_tls_cli_tcp_queued() == start);
+  err = altcp_write(test_cli, data, sizeof(data), 0);
+  fail_unless(err == ERR_OK);
+  /* one record (the default AEAD cipher suites have a fixed expansion) */
+  fail_unless(test_tls_cli_tcp_queued() - start == 11 * sizeof(data) + (u32_t)expansion);
+  UNLOCK_TCPIP_CORE();
+  test_tls_pump();
+  fail_unless(test_srv_rx_len == 11 * sizeof(data));
+
+  /* altcp_output() sends coalesced data, too */
+  LOCK_TCPIP_CORE();
+  start = test_tls_cli_tcp_queued();
+  err = altcp_write(test_cli, data, sizeof(data), TCP_WRITE_FLAG_MORE);
+  fail_unless(err == ERR_OK);
+  err = altcp_output(test_cli);
+  fail_unless(err == ERR_OK);
+  fail_unless(test_tls_cli_tcp_queued() - start == sizeof(data) + (u32_t)expansion);
+  UNLOCK_TCPIP_CORE();
+  test_tls_pump();
+  fail_unless(test_srv_rx_len == 12 * sizeof(data));
+  test_tls_close();
+}
+END_TEST
+
+/** Closing a connection with data not sent yet sends the data before the FIN */
+START_TEST(test_altcp_tls_close_pending)
+{
+  static u8_t data[1000];
+  u32_t written = 0;
+  err_t err;
+  LWIP_UNUSED_ARG(_i);
+
+  memset(data, 'x', sizeof(data));
+  test_tls_open("close");
+  LOCK_TCPIP_CORE();
+  /* fill the tcp send buffer (nothing is ACKed without pumping) */
+  do {
+    err = altcp_write(test_cli, data, sizeof(data), 0);
+    if (err == ERR_OK) {
+      written += sizeof(data);
+    }
+  } while ((err == ERR_OK) && (written < 4 * TCP_SND_BUF));
+  fail_unless(err == ERR_MEM);
+  fail_unless(written > 0);
+  altcp_arg(test_cli, NULL);
+  altcp_recv(test_cli, NULL);
+  altcp_err(test_cli, NULL);
+  err = altcp_close(test_cli);
+  fail_unless(err == ERR_OK);
+  test_cli = NULL;
+  UNLOCK_TCPIP_CORE();
+
+  /* the rest is sent from the sent callback, then the connection is closed */
+  test_tls_pump();
+  test_tls_pump();
+  fail_unless(test_srv_rx_len == written);
+  fail_unless(test_srv_rx_closed);
+  fail_unless(test_srv_conn == NULL);
+}
+END_TEST
+
+#endif /* LWIP_ALTCP && LWIP_ALTCP_TLS && LWIP_ALTCP_TLS_MBEDTLS */
+
+/** Create the suite including all tests for this module */
+Suite *
+altcp_tls_suite(void)
+{
+#if LWIP_ALTCP && LWIP_ALTCP_TLS && LWIP_ALTCP_TLS_MBEDTLS
+  testfunc tests[] = {
+    TESTFUNC(test_altcp_tls_session_resume),
+    TESTFUNC(test_altcp_tls_session_hash_collision),
+    TESTFUNC(test_altcp_tls_session_long_name),
+    TESTFUNC(test_altcp_tls_tx_coalesce),
+    TESTFUNC(test_altcp_tls_close_pending)
+  };
+  return create_suite("ALTCP_TLS", tests, sizeof(tests)/sizeof(testfunc), altcp_tls_setup, altcp_tls_teardown);
+#else /* LWIP_ALTCP && LWIP_ALTCP_TLS && LWIP_ALTCP_TLS_MBEDTLS */
+  return create_suite("ALTCP_TLS", NULL, 0, NULL, NULL);
+#endif /* LWIP_ALTCP && LWIP_ALTCP_TLS && LWIP_ALTCP_TLS_MBEDTLS */
+}
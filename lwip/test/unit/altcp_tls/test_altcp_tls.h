@@ -0,0 +1,8 @@
+#ifndef LWIP_HDR_TEST_ALTCP_TLS_H
+#define LWIP_HDR_TEST_ALTCP_TLS_H
+
+#include "../lwip_check.h"
+
+Suite* altcp_tls_suite(void);
+
+#endif
@@ -0,0 +1,196 @@
+#include "test_altcp_tls_mem.h"
+
+#include "lwip/apps/altcp_tls_mbedtls_opts.h"
+#include "lwip/mem.h"
+#include "lwip/memp.h"
+#include "lwip/stats.h"
+
+#include <string.h>
+
+#if LWIP_ALTCP && LWIP_ALTCP_TLS && LWIP_ALTCP_TLS_MBEDTLS && ALTCP_MBEDTLS_MEM_POOLS
+
+#include "../../../src/apps/altcp_tls/altcp_tls_mbedtls_mem.h"
+#include "mbedtls/platform.h"
+
+#if !ALTCP_MBEDTLS_PLATFORM_ALLOC_STATS
+#error "These tests need ALTCP_MBEDTLS_PLATFORM_ALLOC_STATS"
+#endif
+
+/* indices of the size classes in altcp_mbedtls_malloc_stats */
+#define TEST_POOL_64      0
+#define TEST_POOL_256     1
+#define TEST_POOL_1K      2
+#define TEST_POOL_4K      3
+#define TEST_POOL_RECORD  4
+
+static u16_t
+test_pools_used(void)
+{
+  u16_t used = 0;
+  int i;
+  for (i = 0; i < ALTCP_MBEDTLS_NUM_POOLS; i++) {
+    used = (u16_t)(used + altcp_mbedtls_malloc_stats.poolUsed[i]);
+  }
+  return used;
+}
+
+/* Setups/teardown functions */
+
+static void
+altcp_tls_mem_setup(void)
+{
+  altcp_mbedtls_mem_init();
+  altcp_mbedtls_malloc_clear_stats = 1;
+  lwip_check_ensure_no_alloc(SKIP_POOL(MEMP_SYS_TIMEOUT));
+}
+
+static void
+altcp_tls_mem_teardown(void)
+{
+  fail_unless(test_pools_used() == 0);
+  fail_unless(altcp_mbedtls_malloc_stats.allocedBytes == 0);
+  lwip_check_ensure_no_alloc(SKIP_POOL(MEMP_SYS_TIMEOUT));
+}
+
+/* Test functions */
+
+/** Allocations are taken from the smallest size class they fit in */
+START_TEST(test_altcp_tls_mem_size_classes)
+{
+  static const size_t sizes[] = { 1, 64, 65, 256, 1024, 1025, 4096, 4097, ALTCP_MBEDTLS_MEM_POOL_RECORD_SIZE };
+  static const int pools[] = { TEST_POOL_64, TEST_POOL_64, TEST_POOL_256, TEST_POOL_256, TEST_POOL_1K,
+                               TEST_POOL_4K, TEST_POOL_4K, TEST_POOL_RECORD, TEST_POOL_RECORD };
+  void *p[LWIP_ARRAYSIZE(sizes)];
+  size_t i, j;
+  LWIP_UNUSED_ARG(_i);
+
+  for (i = 0; i < LWIP_ARRAYSIZE(sizes); i++) {
+    p[i] = mbedtls_calloc(1, sizes[i]);
+    fail_unless(p[i] != NULL);
+    fail_unless(altcp_mbedtls_malloc_stats.poolUsed[pools[i]] == 1);
+    fail_unless(test_pools_used() == 1);
+    /* memory from mbedtls_calloc() must be zeroed */
+    for (j = 0; j < sizes[i]; j++) {
+      fail_unless(((u8_t *)p[i])[j] == 0);
+    }
+    memset(p[i], 0xff, sizes[i]);
+    mbedtls_free(p[i]);
+    fail_unless(test_pools_used() == 0);
+  }
+  /* a second allocation gets the same (dirty) block, zeroed again */
+  p[0] = mbedtls_calloc(4, 16);
+  fail_unless(p[0] != NULL);
+  for (j = 0; j < 64; j++) {
+    fail_unless(((u8_t *)p[0])[j] == 0);
+  }
+  mbedtls_free(p[0]);
+
+  /* too big for every class */
+  fail_unless(mbedtls_calloc(1, ALTCP_MBEDTLS_MEM_POOL_RECORD_SIZE + 1) == NULL);
+  fail_unless(mbedtls_calloc(~(size_t)0, 2) == NULL);
+  fail_unless(altcp_mbedtls_malloc_stats.failCnt == 1);
+}
+END_TEST
+
+/** An exhausted size class overflows into the next larger one */
+START_TEST(test_altcp_tls_mem_overflow)
+{
+  void *p[ALTCP_MBEDTLS_MEM_POOL_64_NUM + 1];
+  int i;
+  LWIP_UNUSED_ARG(_i);
+
+  for (i = 0; i < ALTCP_MBEDTLS_MEM_POOL_64_NUM + 1; i++) {
+    p[i] = mbedtls_calloc(1, 16);
+    fail_unless(p[i] != NULL);
+  }
+  fail_unless(altcp_mbedtls_malloc_stats.poolUsed[TEST_POOL_64] == ALTCP_MBEDTLS_MEM_POOL_64_NUM);
+  fail_unless(altcp_mbedtls_malloc_stats.poolUsed[TEST_POOL_256] == 1);
+
+  /* a freed block is used again first */
+  mbedtls_free(p[0]);
+  p[0] = mbedtls_calloc(1, 16);
+  fail_unless(p[0] != NULL);
+  fail_unless(altcp_mbedtls_malloc_stats.poolUsed[TEST_POOL_256] == 1);
+
+  for (i = 0; i < ALTCP_MBEDTLS_MEM_POOL_64_NUM + 1; i++) {
+    mbedtls_free(p[i]);
+  }
+  fail_unless(altcp_mbedtls_malloc_stats.poolMax[TEST_POOL_64] == ALTCP_MBEDTLS_MEM_POOL_64_NUM);
+  fail_unless(altcp_mbedtls_malloc_stats.poolMax[TEST_POOL_256] == 1);
+}
+END_TEST
+
+/** Allocations for configurations go to the heap */
+START_TEST(test_altcp_tls_mem_config)
+{
+  void *conf, *conn;
+  mem_size_t heap_used = lwip_stats.mem.used;
+  LWIP_UNUSED_ARG(_i);
+
+  altcp_mbedtls_mem_config_begin();
+  altcp_mbedtls_mem_config_begin();
+  conf = mbedtls_calloc(1, 100);
+  altcp_mbedtls_mem_config_end();
+  fail_unless(conf != NULL);
+  fail_unless(test_pools_used() == 0);
+  fail_unless(lwip_stats.mem.used > heap_used);
+  altcp_mbedtls_mem_config_end();
+
+  /* connections use the pools again, also when freeing configuration memory */
+  conn = mbedtls_calloc(1, 100);
+  fail_unless(conn != NULL);
+  fail_unless(altcp_mbedtls_malloc_stats.poolUsed[TEST_POOL_256] == 1);
+  mbedtls_free(conf);
+  fail_unless(lwip_stats.mem.used == heap_used);
+  fail_unless(altcp_mbedtls_malloc_stats.poolUsed[TEST_POOL_256] == 1);
+  mbedtls_free(conn);
+}
+END_TEST
+
+/** Clearing the statistics keeps what is in use */
+START_TEST(test_altcp_tls_mem_clear_stats)
+{
+  void *p1, *p2;
+  LWIP_UNUSED_ARG(_i);
+
+  p1 = mbedtls_calloc(1, 32);
+  p2 = mbedtls_calloc(1, 32);
+  fail_unless((p1 != NULL) && (p2 != NULL));
+  fail_unless(altcp_mbedtls_malloc_stats.allocCnt == 2);
+
+  /* statistics are cleared with the next allocation, after a free */
+  altcp_mbedtls_malloc_clear_stats = 1;
+  mbedtls_free(p1);
+  p1 = mbedtls_calloc(1, 32);
+  fail_unless(p1 != NULL);
+  fail_unless(altcp_mbedtls_malloc_stats.allocCnt == 1);
+  fail_unless(altcp_mbedtls_malloc_stats.totalBytes == 32);
+  fail_unless(altcp_mbedtls_malloc_stats.poolUsed[TEST_POOL_64] == 2);
+  fail_unless(altcp_mbedtls_malloc_stats.poolMax[TEST_POOL_64] == 2);
+  fail_unless(altcp_mbedtls_malloc_stats.allocedBytes == 64);
+  fail_unless(altcp_mbedtls_malloc_stats.maxBytes == 64);
+
+  mbedtls_free(p1);
+  mbedtls_free(p2);
+  fail_unless(altcp_mbedtls_malloc_stats.poolUsed[TEST_POOL_64] == 0);
+}
+END_TEST
+
+#endif /* LWIP_ALTCP && LWIP_ALTCP_TLS && LWIP_ALTCP_TLS_MBEDTLS && ALTCP_MBEDTLS_MEM_POOLS */
+
+/** Create the suite including all tests for this module */
+Suite *
+altcp_tls_mem_suite(void)
+{
+#if LWIP_ALTCP && LWIP_ALTCP_TLS && LWIP_ALTCP_TLS_MBEDTLS && ALTCP_MBEDTLS_MEM_POOLS
+  testfunc tests[] = {
+    TESTFUNC(test_altcp_tls_mem_size_classes),
+    TESTFUNC(test_altcp_tls_mem_overflow),
+    TESTFUNC(test_altcp_tls_mem_config),
+    TESTFUNC(test_altcp_tls_mem_clear_stats)
+  };
+  return create_suite("ALTCP_TLS_MEM", tests, sizeof(tests)/sizeof(testfunc), altcp_tls_mem_setup, altcp_tls_mem_teardown);
+#else /* LWIP_ALTCP && LWIP_ALTCP_TLS && LWIP_ALTCP_TLS_MBEDTLS && ALTCP_MBEDTLS_MEM_POOLS */
+  return create_suite("ALTCP_TLS_MEM", NULL, 0, NULL, NULL);
+#endif /* LWIP_ALTCP && LWIP_ALTCP_TLS && LWIP_ALTCP_TLS_MBEDTLS && ALTCP_MBEDTLS_MEM_POOLS */
+}
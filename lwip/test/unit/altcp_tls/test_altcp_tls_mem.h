@@ -0,0 +1,8 @@
+#ifndef LWIP_HDR_TEST_ALTCP_TLS_MEM_H
+#define LWIP_HDR_TEST_ALTCP_TLS_MEM_H
+
+#include "../lwip_check.h"
+
+Suite* altcp_tls_mem_suite(void);
+
+#endif
@@ -0,0 +1,659 @@
+#include "test_bridgeif.h"
+
+#include "netif/bridgeif.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+#include "lwip/mem.h"
+#include "lwip/tcpip.h"
+#include "lwip/timeouts.h"
+#include "netif/ethernet.h"
+
+#define TEST_NUM_PORTS    3
+#define TEST_FRAME_LEN    60
+/* local experimental ethertype: dropped by ethernet_input on the cpu port */
+#define TEST_ETHTYPE      0x88B5
+#define TEST_MAX_OUT      32
+
+struct test_bridgeif_out {
+  struct netif *netif;
+  struct pbuf *p;
+  LWIP_PBUF_REF_T ref;
+  u8_t id;
+  /* VLAN tag or -1 if untagged */
+  s32_t tci;
+};
+
+static struct netif test_bridge;
+static struct netif test_ports[TEST_NUM_PORTS];
+static bridgeif_initdata_t test_bridge_data = BRIDGEIF_INITDATA1(TEST_NUM_PORTS, 16, 0, ETH_ADDR(0x02, 0x00, 0x00, 0x00, 0x00, 0xff));
+static sys_timeout_handler test_fdb_age_tmr;
+static void *test_bridge_fdb;
+
+static struct test_bridgeif_out test_out[TEST_MAX_OUT];
+static int test_out_count;
+
+/* stations: 02:00:00:00:01:n */
+static const struct eth_addr test_sta[] = {
+  {{0x02, 0x00, 0x00, 0x00, 0x01, 0x00}},
+  {{0x02, 0x00, 0x00, 0x00, 0x01, 0x01}},
+  {{0x02, 0x00, 0x00, 0x00, 0x01, 0x02}}
+};
+static const struct eth_addr test_unknown = {{0x02, 0x00, 0x00, 0x00, 0x99, 0x00}};
+
+/* Helper functions */
+
+static void
+test_record_frame(struct netif *netif, struct pbuf *p)
+{
+  struct eth_hdr *ethhdr = (struct eth_hdr *)p->payload;
+  fail_unless(test_out_count < TEST_MAX_OUT);
+  if (test_out_count < TEST_MAX_OUT) {
+    test_out[test_out_count].netif = netif;
+    test_out[test_out_count].p = p;
+    test_out[test_out_count].ref = p->ref;
+    test_out[test_out_count].id = pbuf_get_at(p, (u16_t)(p->tot_len - 1));
+    test_out[test_out_count].tci = -1;
+    if (ethhdr->type == PP_HTONS(ETHTYPE_VLAN)) {
+      struct eth_vlan_hdr *vlan = (struct eth_vlan_hdr *)(((u8_t *)p->payload) + SIZEOF_ETH_HDR);
+      test_out[test_out_count].tci = lwip_ntohs(vlan->prio_vid);
+    }
+    test_out_count++;
+  }
+}
+
+static err_t
+test_port_linkoutput(struct netif *netif, struct pbuf *p)
+{
+  test_record_frame(netif, p);
+  return ERR_OK;
+}
+
+static err_t
+test_port_init(struct netif *netif)
+{
+  netif->name[0] = 'p';
+  netif->name[1] = (char)('0' + (netif - test_ports));
+  netif->linkoutput = test_port_linkoutput;
+  netif->hwaddr_len = ETH_HWADDR_LEN;
+  netif->mtu = 1500;
+  netif->flags = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP | NETIF_FLAG_ETHERNET | NETIF_FLAG_LINK_UP;
+  return ERR_OK;
+}
+
+/* Fill in a frame, tagged with 'tci' if >= 0 */
+static void
+test_fill_frame(u8_t *buf, const struct eth_addr *dst, const struct eth_addr *src, s32_t tci, u8_t id)
+{
+  struct eth_hdr *ethhdr = (struct eth_hdr *)buf;
+  memset(buf, 0, TEST_FRAME_LEN);
+  SMEMCPY(&ethhdr->dest, dst, ETH_HWADDR_LEN);
+  SMEMCPY(&ethhdr->src, src, ETH_HWADDR_LEN);
+  if (tci >= 0) {
+    struct eth_vlan_hdr *vlan = (struct eth_vlan_hdr *)(buf + SIZEOF_ETH_HDR);
+    ethhdr->type = PP_HTONS(ETHTYPE_VLAN);
+    vlan->prio_vid = lwip_htons((u16_t)tci);
+    vlan->tpid = PP_HTONS(TEST_ETHTYPE);
+  } else {
+    ethhdr->type = PP_HTONS(TEST_ETHTYPE);
+  }
+  buf[TEST_FRAME_LEN - 1] = id;
+}
+
+/* PBUF_LINK frames have header space to push a VLAN tag in place */
+static struct pbuf *
+test_frame_ex(pbuf_layer layer, const struct eth_addr *dst, const struct eth_addr *src, s32_t tci, u8_t id)
+{
+  struct pbuf *p = pbuf_alloc(layer, TEST_FRAME_LEN, PBUF_RAM);
+  fail_unless(p != NULL);
+  test_fill_frame((u8_t *)p->payload, dst, src, tci, id);
+  return p;
+}
+
+static struct pbuf *
+test_frame(const struct eth_addr *dst, const struct eth_addr *src, u8_t id)
+{
+  return test_frame_ex(PBUF_RAW, dst, src, -1, id);
+}
+
+/* Pass a frame to a port as its driver would (queued to tcpip_thread) */
+static void
+test_port_input(int port, struct pbuf *p)
+{
+  fail_unless(test_ports[port].input(p, &test_ports[port]) == ERR_OK);
+}
+
+/* Number of frames sent on a port so far */
+static int
+test_port_out_count(int port)
+{
+  int i, count = 0;
+  for (i = 0; i < test_out_count; i++) {
+    if (test_out[i].netif == &test_ports[port]) {
+      count++;
+    }
+  }
+  return count;
+}
+
+/* Frame (0 = first) sent on a port */
+static struct test_bridgeif_out *
+test_port_out(int port, int n)
+{
+  int i;
+  for (i = 0; i < test_out_count; i++) {
+    if (test_out[i].netif == &test_ports[port]) {
+      if (n-- == 0) {
+        return &test_out[i];
+      }
+    }
+  }
+  fail("frame not sent");
+  return NULL;
+}
+
+static void
+test_learn(int port)
+{
+  test_port_input(port, test_frame(&ethbroadcast, &test_sta[port], 0));
+  while (tcpip_thread_poll_one());
+  test_out_count = 0;
+}
+
+/* Setups/teardown functions */
+
+static void
+bridgeif_setup(void)
+{
+  struct sys_timeo *t;
+  void *fdb;
+  int i;
+
+  lwip_check_ensure_no_alloc(SKIP_POOL(MEMP_SYS_TIMEOUT));
+  test_out_count = 0;
+
+  /* find the FDB aging timer handler to stop the bridge's timer in teardown */
+  fdb = bridgeif_fdb_init(1);
+  fail_unless(fdb != NULL);
+  for (t = *sys_timeouts_get_next_timeout(); t != NULL; t = t->next) {
+    if (t->arg == fdb) {
+      test_fdb_age_tmr = t->h;
+    }
+  }
+  fail_unless(test_fdb_age_tmr != NULL);
+  sys_untimeout(test_fdb_age_tmr, fdb);
+  mem_free(fdb);
+
+  memset(&test_bridge, 0, sizeof(test_bridge));
+  fail_unless(netif_add_noaddr(&test_bridge, &test_bridge_data, bridgeif_init, netif_input) == &test_bridge);
+  for (t = *sys_timeouts_get_next_timeout(); t != NULL; t = t->next) {
+    if (t->h == test_fdb_age_tmr) {
+      test_bridge_fdb = t->arg;
+    }
+  }
+  fail_unless(test_bridge_fdb != NULL);
+
+  for (i = 0; i < TEST_NUM_PORTS; i++) {
+    memset(&test_ports[i], 0, sizeof(test_ports[i]));
+    fail_unless(netif_add_noaddr(&test_ports[i], NULL, test_port_init, netif_input) == &test_ports[i]);
+    fail_unless(bridgeif_add_port(&test_bridge, &test_ports[i]) == ERR_OK);
+  }
+}
+
+static void
+bridgeif_teardown(void)
+{
+  int i;
+
+  while (tcpip_thread_poll_one());
+  for (i = 0; i < TEST_NUM_PORTS; i++) {
+    netif_remove(&test_ports[i]);
+  }
+  netif_remove(&test_bridge);
+  /* the bridge has no deinit: free its private data and FDB */
+  sys_untimeout(test_fdb_age_tmr, test_bridge_fdb);
+  mem_free(test_bridge_fdb);
+  test_bridge_fdb = NULL;
+  mem_free(test_bridge.state);
+  test_bridge.state = NULL;
+  lwip_check_ensure_no_alloc(SKIP_POOL(MEMP_SYS_TIMEOUT));
+}
+
+/* Test functions */
+
+/** Frames are forwarded to learned ports, unknown unicast is flooded, never back to the rx port */
+START_TEST(test_bridgeif_forward)
+{
+  LWIP_UNUSED_ARG(_i);
+
+  test_learn(1);
+  test_port_input(0, test_frame(&test_sta[1], &test_sta[0], 1));
+  test_port_input(1, test_frame(&test_unknown, &test_sta[1], 2));
+  while (tcpip_thread_poll_one());
+
+  fail_unless(test_out_count == 3);
+  fail_unless(test_port_out_count(0) == 1);
+  fail_unless(test_port_out_count(1) == 1);
+  fail_unless(test_port_out_count(2) == 1);
+  fail_unless(test_port_out(1, 0)->id == 1);
+  fail_unless(test_port_out(0, 0)->id == 2);
+  fail_unless(test_port_out(2, 0)->id == 2);
+}
+END_TEST
+
+#if BRIDGEIF_TX_BATCH_LEN && !BRIDGEIF_PORT_NETIFS_OUTPUT_DIRECT
+
+/** A flooded frame is queued by reference on all ports and sent by the flush callback */
+START_TEST(test_bridgeif_batch_flood)
+{
+  struct pbuf *p;
+  LWIP_UNUSED_ARG(_i);
+
+  p = test_frame(&test_unknown, &test_sta[0], 1);
+  test_port_input(0, p);
+  fail_unless(tcpip_thread_poll_one());
+  /* queued on ports 1 and 2, the input reference is released */
+  fail_unless(test_out_count == 0);
+  fail_unless(p->ref == 2);
+
+  /* the flush callback is pending in tcpip_thread */
+  fail_unless(tcpip_thread_poll_one());
+  fail_unless(test_out_count == 2);
+  fail_unless(test_port_out(1, 0)->p == p);
+  fail_unless(test_port_out(1, 0)->ref == 2);
+  fail_unless(test_port_out(2, 0)->p == p);
+  fail_unless(test_port_out(2, 0)->ref == 1);
+  fail_unless(!tcpip_thread_poll_one());
+}
+END_TEST
+
+/** Frames with volatile data are copied before being queued, once for all ports */
+START_TEST(test_bridgeif_batch_copy)
+{
+  static u8_t buf[TEST_FRAME_LEN];
+  struct pbuf *p;
+  LWIP_UNUSED_ARG(_i);
+
+  test_fill_frame(buf, &test_unknown, &test_sta[0], -1, 1);
+  p = pbuf_alloc(PBUF_RAW, TEST_FRAME_LEN, PBUF_REF);
+  fail_unless(p != NULL);
+  p->payload = buf;
+  fail_unless(PBUF_NEEDS_COPY(p));
+  test_port_input(0, p);
+  fail_unless(tcpip_thread_poll_one());
+  fail_unless(test_out_count == 0);
+  /* the driver reuses its buffer */
+  memset(buf, 0, sizeof(buf));
+
+  fail_unless(tcpip_thread_poll_one());
+  fail_unless(test_out_count == 2);
+  fail_unless(test_port_out(1, 0)->p == test_port_out(2, 0)->p);
+  fail_unless(test_port_out(1, 0)->ref == 2);
+  fail_unless(test_port_out(1, 0)->id == 1);
+  fail_unless(test_port_out(2, 0)->id == 1);
+}
+END_TEST
+
+/** A frame sent directly (here: a broadcast also passed to the cpu port) is sent after
+ * the frames already queued on the port */
+START_TEST(test_bridgeif_batch_order)
+{
+  int port;
+  LWIP_UNUSED_ARG(_i);
+
+  test_port_input(0, test_frame(&test_unknown, &test_sta[0], 1));
+  test_port_input(0, test_frame(&ethbroadcast, &test_sta[0], 2));
+  fail_unless(tcpip_thread_poll_one());
+  fail_unless(test_out_count == 0);
+  fail_unless(tcpip_thread_poll_one());
+  fail_unless(test_out_count == 4);
+  for (port = 1; port < TEST_NUM_PORTS; port++) {
+    fail_unless(test_port_out_count(port) == 2);
+    fail_unless(test_port_out(port, 0)->id == 1);
+    fail_unless(test_port_out(port, 1)->id == 2);
+  }
+
+  /* the flush callback finds nothing left to send */
+  fail_unless(tcpip_thread_poll_one());
+  fail_unless(test_out_count == 4);
+}
+END_TEST
+
+/** A full queue is sent out without waiting for the flush callback */
+START_TEST(test_bridgeif_batch_full)
+{
+  int i;
+  LWIP_UNUSED_ARG(_i);
+
+  test_learn(1);
+  for (i = 0; i <= BRIDGEIF_TX_BATCH_LEN; i++) {
+    test_port_input(0, test_frame(&test_sta[1], &test_sta[0], (u8_t)(i + 1)));
+  }
+  for (i = 0; i < BRIDGEIF_TX_BATCH_LEN - 1; i++) {
+    fail_unless(tcpip_thread_poll_one());
+  }
+  fail_unless(test_out_count == 0);
+  fail_unless(tcpip_thread_poll_one());
+  fail_unless(test_out_count == BRIDGEIF_TX_BATCH_LEN);
+  fail_unless(tcpip_thread_poll_one());
+  fail_unless(test_out_count == BRIDGEIF_TX_BATCH_LEN);
+
+  /* the last frame is sent by the flush callback */
+  fail_unless(tcpip_thread_poll_one());
+  fail_unless(test_out_count == BRIDGEIF_TX_BATCH_LEN + 1);
+  for (i = 0; i <= BRIDGEIF_TX_BATCH_LEN; i++) {
+    fail_unless(test_port_out(1, i)->id == i + 1);
+  }
+  fail_unless(!tcpip_thread_poll_one());
+}
+END_TEST
+
+/** One flush callback sends the frames queued on all ports */
+START_TEST(test_bridgeif_batch_flush_cb)
+{
+  LWIP_UNUSED_ARG(_i);
+
+  test_learn(1);
+  test_learn(2);
+  test_port_input(0, test_frame(&test_sta[1], &test_sta[0], 1));
+  test_port_input(1, test_frame(&test_sta[2], &test_sta[1], 2));
+  test_port_input(2, test_frame(&test_sta[1], &test_sta[2], 3));
+  fail_unless(tcpip_thread_poll_one());
+  fail_unless(tcpip_thread_poll_one());
+  fail_unless(tcpip_thread_poll_one());
+  fail_unless(test_out_count == 0);
+
+  fail_unless(tcpip_thread_poll_one());
+  fail_unless(!tcpip_thread_poll_one());
+  fail_unless(test_out_count == 3);
+  fail_unless(test_port_out_count(1) == 2);
+  fail_unless(test_port_out(1, 0)->id == 1);
+  fail_unless(test_port_out(1, 1)->id == 3);
+  fail_unless(test_port_out(2, 0)->id == 2);
+
+  /* bridgeif_flush() sends queued frames right away */
+  test_port_input(0, test_frame(&test_sta[1], &test_sta[0], 4));
+  fail_unless(tcpip_thread_poll_one());
+  fail_unless(test_out_count == 3);
+  bridgeif_flush(&test_bridge);
+  fail_unless(test_out_count == 4);
+  fail_unless(test_port_out(1, 2)->id == 4);
+}
+END_TEST
+
+#endif /* BRIDGEIF_TX_BATCH_LEN && !BRIDGEIF_PORT_NETIFS_OUTPUT_DIRECT */
+
+#if BRIDGEIF_VLAN
+
+#define TEST_PRIO(prio)     ((prio) << 13)
+
+/* Records the frames passed to the cpu port instead of the stack */
+static err_t
+test_cpu_input(struct pbuf *p, struct netif *netif)
+{
+  test_record_frame(netif, p);
+  pbuf_free(p);
+  return ERR_OK;
+}
+
+/* Ports 0 and 1 are untagged members of VLAN 1, port 2 is a tagged member of
+ * VLAN 1 (PVID 20). Ports 1 and 2 are tagged members of VLAN 10. */
+static void
+test_vlan_setup(void)
+{
+  test_bridge.input = test_cpu_input;
+  fail_unless(bridgeif_vlan_set_pvid(&test_bridge, &test_ports[2], 20) == ERR_OK);
+  fail_unless(bridgeif_vlan_add(&test_bridge, &test_ports[1], 10) == ERR_OK);
+  fail_unless(bridgeif_vlan_add(&test_bridge, &test_ports[2], 10) == ERR_OK);
+}
+
+/** Frames are only accepted from and forwarded to member ports of their VLAN */
+START_TEST(test_bridgeif_vlan_ingress)
+{
+  LWIP_UNUSED_ARG(_i);
+  test_vlan_setup();
+
+  /* port 0 is no member of VLAN 10 */
+  test_port_input(0, test_frame_ex(PBUF_RAW, &ethbroadcast, &test_sta[0], 10, 1));
+  while (tcpip_thread_poll_one());
+  fail_unless(test_out_count == 0);
+
+  /* VLAN 10 does not reach port 0 and the cpu port */
+  test_port_input(1, test_frame_ex(PBUF_RAW, &ethbroadcast, &test_sta[1], 10, 2));
+  while (tcpip_thread_poll_one());
+  fail_unless(test_out_count == 1);
+  fail_unless(test_port_out(2, 0)->id == 2);
+  fail_unless(test_port_out(2, 0)->tci == 10);
+
+  /* untagged frames belong to the PVID: VLAN 20 has no other member port... */
+  test_out_count = 0;
+  test_port_input(2, test_frame_ex(PBUF_RAW, &ethbroadcast, &test_sta[2], -1, 3));
+  while (tcpip_thread_poll_one());
+  fail_unless(test_out_count == 0);
+
+  /* ... but the cpu port can join it */
+  fail_unless(bridgeif_vlan_add(&test_bridge, &test_bridge, 20) == ERR_OK);
+  test_out_count = 0;
+  test_port_input(2, test_frame_ex(PBUF_RAW, &ethbroadcast, &test_sta[2], -1, 4));
+  while (tcpip_thread_poll_one());
+  fail_unless(test_out_count == 1);
+  fail_unless(test_out[0].netif == &test_bridge);
+  fail_unless(test_out[0].tci == 20);
+  fail_unless(test_out[0].id == 4);
+
+  /* a port removed from a VLAN drops it */
+  fail_unless(bridgeif_vlan_remove(&test_bridge, &test_ports[2], 10) == ERR_OK);
+  test_out_count = 0;
+  test_port_input(1, test_frame_ex(PBUF_RAW, &ethbroadcast, &test_sta[1], 10, 5));
+  test_port_input(2, test_frame_ex(PBUF_RAW, &ethbroadcast, &test_sta[2], 10, 6));
+  while (tcpip_thread_poll_one());
+  fail_unless(test_out_count == 0);
+}
+END_TEST
+
+/** Priority tagged frames are forwarded with the PVID and their priority */
+START_TEST(test_bridgeif_vlan_priority_tag)
+{
+  struct pbuf *p;
+  LWIP_UNUSED_ARG(_i);
+  test_vlan_setup();
+
+  test_port_input(0, test_frame_ex(PBUF_RAW, &test_unknown, &test_sta[0], TEST_PRIO(5), 1));
+  while (tcpip_thread_poll_one());
+  fail_unless(test_out_count == 2);
+  fail_unless(test_port_out(1, 0)->tci == -1);
+  fail_unless(test_port_out(2, 0)->tci == (TEST_PRIO(5) | 1));
+
+  /* the stack's frame is tagged on a copy */
+  test_out_count = 0;
+  p = test_frame_ex(PBUF_LINK, &ethbroadcast, &test_sta[0], TEST_PRIO(3), 2);
+  fail_unless(test_bridge.linkoutput(&test_bridge, p) == ERR_OK);
+  fail_unless(test_out_count == 3);
+  fail_unless(test_port_out(0, 0)->tci == -1);
+  fail_unless(test_port_out(1, 0)->tci == -1);
+  fail_unless(test_port_out(2, 0)->tci == (TEST_PRIO(3) | 1));
+  fail_unless(test_port_out(2, 0)->id == 2);
+  fail_unless(p->ref == 1);
+  fail_unless(p->tot_len == TEST_FRAME_LEN);
+  fail_unless(pbuf_get_at(p, SIZEOF_ETH_HDR) == (TEST_PRIO(3) >> 8));
+  fail_unless(pbuf_get_at(p, SIZEOF_ETH_HDR + 1) == 0);
+  pbuf_free(p);
+}
+END_TEST
+
+/** Received frames are retagged in place if they have header space, else on a copy */
+START_TEST(test_bridgeif_vlan_retag)
+{
+  struct pbuf *p;
+  LWIP_UNUSED_ARG(_i);
+  test_vlan_setup();
+
+  /* broadcasts are sent directly: after port 1, the tag is pushed for port 2
+     and popped again for the cpu port */
+  p = test_frame_ex(PBUF_LINK, &ethbroadcast, &test_sta[0], -1, 1);
+  test_port_input(0, p);
+  while (tcpip_thread_poll_one());
+  fail_unless(test_out_count == 3);
+  fail_unless(test_port_out(1, 0)->p == p);
+  fail_unless(test_port_out(1, 0)->tci == -1);
+  fail_unless(test_port_out(2, 0)->p == p);
+  fail_unless(test_port_out(2, 0)->tci == 1);
+  fail_unless(test_out[2].netif == &test_bridge);
+  fail_unless(test_out[2].p == p);
+  fail_unless(test_out[2].tci == -1);
+  fail_unless(test_out[2].id == 1);
+
+  /* no header space: the tag is pushed on a copy */
+  test_out_count = 0;
+  p = test_frame_ex(PBUF_RAW, &ethbroadcast, &test_sta[0], -1, 2);
+  test_port_input(0, p);
+  while (tcpip_thread_poll_one());
+  fail_unless(test_out_count == 3);
+  fail_unless(test_port_out(1, 0)->p == p);
+  fail_unless(test_port_out(2, 0)->p != p);
+  fail_unless(test_port_out(2, 0)->tci == 1);
+  fail_unless(test_port_out(2, 0)->id == 2);
+  fail_unless(test_out[2].p == p);
+  fail_unless(test_out[2].tci == -1);
+
+  /* the tag is popped in place */
+  test_out_count = 0;
+  p = test_frame_ex(PBUF_RAW, &ethbroadcast, &test_sta[2], 1, 3);
+  test_port_input(2, p);
+  while (tcpip_thread_poll_one());
+  fail_unless(test_out_count == 3);
+  fail_unless(test_port_out(0, 0)->p == p);
+  fail_unless(test_port_out(0, 0)->tci == -1);
+  fail_unless(test_port_out(1, 0)->p == p);
+  fail_unless(test_out[2].netif == &test_bridge);
+  fail_unless(test_out[2].tci == -1);
+  fail_unless(test_out[2].id == 3);
+}
+END_TEST
+
+/** Flooded frames are sent untagged and tagged, the queued ones on a copy */
+START_TEST(test_bridgeif_vlan_mixed_egress)
+{
+  LWIP_UNUSED_ARG(_i);
+  test_vlan_setup();
+
+  test_port_input(0, test_frame_ex(PBUF_LINK, &test_unknown, &test_sta[0], -1, 1));
+  test_port_input(2, test_frame_ex(PBUF_RAW, &test_unknown, &test_sta[2], 1, 2));
+  test_port_input(1, test_frame_ex(PBUF_RAW, &test_unknown, &test_sta[1], 10, 3));
+  while (tcpip_thread_poll_one());
+
+  fail_unless(test_out_count == 5);
+  fail_unless(test_port_out_count(0) == 1);
+  fail_unless(test_port_out_count(1) == 2);
+  fail_unless(test_port_out_count(2) == 2);
+  fail_unless(test_port_out(0, 0)->id == 2);
+  fail_unless(test_port_out(0, 0)->tci == -1);
+  fail_unless(test_port_out(1, 0)->id == 1);
+  fail_unless(test_port_out(1, 0)->tci == -1);
+  fail_unless(test_port_out(1, 1)->id == 2);
+  fail_unless(test_port_out(1, 1)->tci == -1);
+  fail_unless(test_port_out(2, 0)->id == 1);
+  fail_unless(test_port_out(2, 0)->tci == 1);
+  fail_unless(test_port_out(2, 1)->id == 3);
+  fail_unless(test_port_out(2, 1)->tci == 10);
+#if BRIDGEIF_TX_BATCH_LEN && !BRIDGEIF_PORT_NETIFS_OUTPUT_DIRECT
+  /* port 1 still referenced frame 1 when the tag was pushed for port 2 */
+  fail_unless(test_port_out(1, 0)->p != test_port_out(2, 0)->p);
+#endif
+}
+END_TEST
+
+/** The cpu port sends and receives frames according to its own VLAN config,
+ * the stack's frames are never changed */
+START_TEST(test_bridgeif_vlan_cpu)
+{
+  struct pbuf *p;
+  LWIP_UNUSED_ARG(_i);
+  test_vlan_setup();
+
+  /* untagged: VLAN 1 (the tag is pushed on a copy, even with header space) */
+  p = test_frame_ex(PBUF_LINK, &ethbroadcast, &test_sta[0], -1, 1);
+  fail_unless(test_bridge.linkoutput(&test_bridge, p) == ERR_OK);
+  fail_unless(test_out_count == 3);
+  fail_unless(test_port_out(0, 0)->p == p);
+  fail_unless(test_port_out(1, 0)->p == p);
+  fail_unless(test_port_out(2, 0)->p != p);
+  fail_unless(test_port_out(2, 0)->tci == 1);
+  fail_unless(p->ref == 1);
+  fail_unless(p->tot_len == TEST_FRAME_LEN);
+  fail_unless(pbuf_get_at(p, 12) == (TEST_ETHTYPE >> 8));
+  pbuf_free(p);
+
+  /* the cpu port is no member of VLAN 10 */
+  test_out_count = 0;
+  p = test_frame_ex(PBUF_LINK, &ethbroadcast, &test_sta[0], 10, 2);
+  fail_unless(test_bridge.linkoutput(&test_bridge, p) == ERR_VAL);
+  fail_unless(test_out_count == 0);
+  test_port_input(1, test_frame_ex(PBUF_RAW, &ethbroadcast, &test_sta[1], 10, 3));
+  while (tcpip_thread_poll_one());
+  fail_unless(test_out_count == 1);
+  fail_unless(test_port_out(2, 0)->id == 3);
+
+  /* ... but can join it: tagged frames */
+  fail_unless(bridgeif_vlan_add(&test_bridge, &test_bridge, 10) == ERR_OK);
+  test_out_count = 0;
+  fail_unless(test_bridge.linkoutput(&test_bridge, p) == ERR_OK);
+  fail_unless(test_out_count == 2);
+  fail_unless(test_port_out(1, 0)->p == p);
+  fail_unless(test_port_out(1, 0)->tci == 10);
+  fail_unless(test_port_out(2, 0)->p == p);
+  fail_unless(p->ref == 1);
+  fail_unless(p->tot_len == TEST_FRAME_LEN);
+  pbuf_free(p);
+  test_out_count = 0;
+  test_port_input(1, test_frame_ex(PBUF_RAW, &ethbroadcast, &test_sta[1], 10, 4));
+  while (tcpip_thread_poll_one());
+  fail_unless(test_out_count == 2);
+  fail_unless(test_out[1].netif == &test_bridge);
+  fail_unless(test_out[1].tci == 10);
+  fail_unless(test_out[1].id == 4);
+
+  /* with PVID 10, the cpu port sends and receives VLAN 10 untagged */
+  fail_unless(bridgeif_vlan_set_pvid(&test_bridge, &test_bridge, 10) == ERR_OK);
+  test_out_count = 0;
+  p = test_frame_ex(PBUF_LINK, &ethbroadcast, &test_sta[0], -1, 5);
+  fail_unless(test_bridge.linkoutput(&test_bridge, p) == ERR_OK);
+  fail_unless(test_out_count == 2);
+  fail_unless(test_port_out(1, 0)->tci == 10);
+  fail_unless(test_port_out(2, 0)->tci == 10);
+  fail_unless(p->tot_len == TEST_FRAME_LEN);
+  pbuf_free(p);
+  test_out_count = 0;
+  test_port_input(2, test_frame_ex(PBUF_RAW, &ethbroadcast, &test_sta[2], 10, 6));
+  while (tcpip_thread_poll_one());
+  fail_unless(test_out_count == 2);
+  fail_unless(test_out[1].netif == &test_bridge);
+  fail_unless(test_out[1].tci == -1);
+  fail_unless(test_out[1].id == 6);
+}
+END_TEST
+
+#endif /* BRIDGEIF_VLAN */
+
+/** Create the suite including all tests for this module */
+Suite *
+bridgeif_suite(void)
+{
+  testfunc tests[] = {
+    TESTFUNC(test_bridgeif_forward),
+#if BRIDGEIF_TX_BATCH_LEN && !BRIDGEIF_PORT_NETIFS_OUTPUT_DIRECT
+    TESTFUNC(test_bridgeif_batch_flood),
+    TESTFUNC(test_bridgeif_batch_copy),
+    TESTFUNC(test_bridgeif_batch_order),
+    TESTFUNC(test_bridgeif_batch_full),
+    TESTFUNC(test_bridgeif_batch_flush_cb),
+#endif /* BRIDGEIF_TX_BATCH_LEN && !BRIDGEIF_PORT_NETIFS_OUTPUT_DIRECT */
+#if BRIDGEIF_VLAN
+    TESTFUNC(test_bridgeif_vlan_ingress),
+    TESTFUNC(test_bridgeif_vlan_priority_tag),
+    TESTFUNC(test_bridgeif_vlan_retag),
+    TESTFUNC(test_bridgeif_vlan_mixed_egress),
+    TESTFUNC(test_bridgeif_vlan_cpu),
+#endif /* BRIDGEIF_VLAN */
+  };
+  return create_suite("BRIDGEIF", tests, sizeof(tests)/sizeof(testfunc), bridgeif_setup, bridgeif_teardown);
+}
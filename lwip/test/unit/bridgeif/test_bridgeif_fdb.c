@@ -0,0 +1,301 @@
+#include "test_bridgeif_fdb.h"
+
+#include "netif/bridgeif.h"
+#include "lwip/timeouts.h"
+#include "lwip/mem.h"
+#include "lwip/tcpip.h"
+#include "arch/sys_arch.h"
+
+/* same as in bridgeif_fdb.c */
+#define BR_FDB_TIMEOUT_SEC  (60*5)
+#define BR_FDB_AGE_WHEEL_SLOTS  32
+
+#define TEST_FDB_ENTRIES    16
+
+static void *test_fdb;
+/* run by test_bridgeif_fdb_locked() once while the FDB is locked */
+static void (*test_fdb_read_locked_fn)(void);
+static void (*test_fdb_write_locked_fn)(void);
+
+/* Called by BRIDGEIF_READ_PROTECT/BRIDGEIF_WRITE_PROTECT (see lwipopts.h) */
+void
+test_bridgeif_fdb_locked(int write)
+{
+  void (*fn)(void);
+  if (write) {
+    fn = test_fdb_write_locked_fn;
+    test_fdb_write_locked_fn = NULL;
+  } else {
+    fn = test_fdb_read_locked_fn;
+    test_fdb_read_locked_fn = NULL;
+  }
+  if (fn != NULL) {
+    fn();
+  }
+}
+
+/* 02:00:00:00:n:00 - some of 1..16 share hash buckets with 16 buckets */
+static void
+test_fdb_addr(struct eth_addr *addr, u8_t n)
+{
+  addr->addr[0] = 2;
+  addr->addr[1] = 0;
+  addr->addr[2] = 0;
+  addr->addr[3] = 0;
+  addr->addr[4] = n;
+  addr->addr[5] = 0;
+}
+
+static void
+test_fdb_learn(u8_t n, u8_t port)
+{
+  struct eth_addr addr;
+  test_fdb_addr(&addr, n);
+#if BRIDGEIF_VLAN
+  bridgeif_fdb_update_src(test_fdb, &addr, 1, port);
+#else
+  bridgeif_fdb_update_src(test_fdb, &addr, port);
+#endif
+}
+
+static bridgeif_portmask_t
+test_fdb_lookup(u8_t n)
+{
+  struct eth_addr addr;
+  test_fdb_addr(&addr, n);
+#if BRIDGEIF_VLAN
+  return bridgeif_fdb_get_dst_ports(test_fdb, &addr, 1);
+#else
+  return bridgeif_fdb_get_dst_ports(test_fdb, &addr);
+#endif
+}
+
+/* Advance time by some seconds, running the aging timer */
+static void
+test_fdb_tick(u32_t seconds)
+{
+  while (seconds--) {
+    lwip_sys_now += 1000;
+    sys_check_timeouts();
+  }
+  /* process frames sent by other timers on the loopback netif */
+  while (tcpip_thread_poll_one());
+}
+
+/* Setups/teardown functions */
+
+static void
+bridgeif_fdb_setup(void)
+{
+  lwip_check_ensure_no_alloc(SKIP_POOL(MEMP_SYS_TIMEOUT));
+  test_fdb_read_locked_fn = NULL;
+  test_fdb_write_locked_fn = NULL;
+  test_fdb = bridgeif_fdb_init(TEST_FDB_ENTRIES);
+  fail_unless(test_fdb != NULL);
+}
+
+static void
+bridgeif_fdb_teardown(void)
+{
+  struct sys_timeo *t;
+  /* stop the aging timer */
+  for (t = *sys_timeouts_get_next_timeout(); t != NULL; t = t->next) {
+    if (t->arg == test_fdb) {
+      sys_untimeout(t->h, test_fdb);
+      break;
+    }
+  }
+  mem_free(test_fdb);
+  test_fdb = NULL;
+  test_fdb_read_locked_fn = NULL;
+  test_fdb_write_locked_fn = NULL;
+  lwip_check_ensure_no_alloc(SKIP_POOL(MEMP_SYS_TIMEOUT));
+}
+
+/* Test functions */
+
+/** Learn source addresses, look them up and move them to another port */
+START_TEST(test_bridgeif_fdb_learn)
+{
+  LWIP_UNUSED_ARG(_i);
+
+  fail_unless(test_fdb_lookup(1) == BR_FLOOD);
+  test_fdb_learn(1, 1);
+  test_fdb_learn(2, 2);
+  fail_unless(test_fdb_lookup(1) == (1 << 1));
+  fail_unless(test_fdb_lookup(2) == (1 << 2));
+  fail_unless(test_fdb_lookup(3) == BR_FLOOD);
+
+  /* a station moving to another port is updated immediately */
+  test_fdb_learn(1, 3);
+  fail_unless(test_fdb_lookup(1) == (1 << 3));
+  test_fdb_tick(1);
+  test_fdb_learn(1, 0);
+  fail_unless(test_fdb_lookup(1) == (1 << 0));
+  fail_unless(test_fdb_lookup(2) == (1 << 2));
+}
+END_TEST
+
+/** Entries age out after BR_FDB_TIMEOUT_SEC, learning again refreshes them */
+START_TEST(test_bridgeif_fdb_age)
+{
+  LWIP_UNUSED_ARG(_i);
+
+  test_fdb_learn(1, 1);
+  test_fdb_learn(2, 2);
+  test_fdb_tick(10);
+  /* refreshed: expires 10 seconds later */
+  test_fdb_learn(2, 2);
+  /* seen again within BR_FDB_REFRESH_SEC: nothing is written, same expiry */
+  test_fdb_learn(2, 2);
+  test_fdb_tick(BR_FDB_TIMEOUT_SEC - 10 - 1);
+  fail_unless(test_fdb_lookup(1) == (1 << 1));
+  fail_unless(test_fdb_lookup(2) == (1 << 2));
+  test_fdb_tick(1);
+  fail_unless(test_fdb_lookup(1) == BR_FLOOD);
+  fail_unless(test_fdb_lookup(2) == (1 << 2));
+  test_fdb_tick(9);
+  fail_unless(test_fdb_lookup(2) == (1 << 2));
+  test_fdb_tick(1);
+  fail_unless(test_fdb_lookup(2) == BR_FLOOD);
+}
+END_TEST
+
+/** Every entry expires exactly BR_FDB_TIMEOUT_SEC after it has been learnt
+ * or refreshed, also when refreshed after exactly one aging wheel revolution */
+START_TEST(test_bridgeif_fdb_age_wheel)
+{
+  u32_t t;
+  u8_t n;
+  LWIP_UNUSED_ARG(_i);
+
+  for (t = 0; t < 40 + BR_FDB_TIMEOUT_SEC + 2; t++) {
+    /* n is learnt at (n - 1) * 5 (spanning more than one wheel revolution),
+       1 is refreshed at 40 and 2 at 5 + BR_FDB_AGE_WHEEL_SLOTS */
+    for (n = 1; n <= 8; n++) {
+      if (t == (u32_t)(n - 1) * 5) {
+        test_fdb_learn(n, (u8_t)(n & 3));
+      }
+    }
+    if (t == 40) {
+      test_fdb_learn(1, 1);
+    }
+    if (t == 5 + BR_FDB_AGE_WHEEL_SLOTS) {
+      test_fdb_learn(2, 2);
+    }
+    for (n = 1; n <= 8; n++) {
+      u32_t learnt = (u32_t)(n - 1) * 5;
+      u32_t refreshed = (n == 1) ? 40 : ((n == 2) ? 5 + BR_FDB_AGE_WHEEL_SLOTS : learnt);
+      bridgeif_portmask_t expected = BR_FLOOD;
+      if ((t >= learnt) && (t < refreshed + BR_FDB_TIMEOUT_SEC)) {
+        expected = (bridgeif_portmask_t)(1 << (n & 3));
+      }
+      fail_unless(test_fdb_lookup(n) == expected);
+    }
+    test_fdb_tick(1);
+  }
+}
+END_TEST
+
+/** Entries are chained in hash buckets and come from a free list */
+START_TEST(test_bridgeif_fdb_buckets)
+{
+  u8_t n;
+  LWIP_UNUSED_ARG(_i);
+
+  /* fill the FDB, 2 and 7 are learnt later */
+  for (n = 1; n <= TEST_FDB_ENTRIES; n++) {
+    if ((n != 2) && (n != 7)) {
+      test_fdb_learn(n, (u8_t)(n & 3));
+    }
+  }
+  test_fdb_tick(1);
+  test_fdb_learn(2, 2);
+  test_fdb_learn(7, 3);
+  for (n = 1; n <= TEST_FDB_ENTRIES; n++) {
+    fail_unless(test_fdb_lookup(n) == (bridgeif_portmask_t)(1 << (n & 3)));
+  }
+  /* full: not learnt */
+  test_fdb_learn(TEST_FDB_ENTRIES + 1, 1);
+  fail_unless(test_fdb_lookup(TEST_FDB_ENTRIES + 1) == BR_FLOOD);
+
+  /* all but 2 and 7 age out: the remaining entries of the buckets are still found */
+  test_fdb_tick(BR_FDB_TIMEOUT_SEC - 1);
+  fail_unless(test_fdb_lookup(1) == BR_FLOOD);
+  fail_unless(test_fdb_lookup(8) == BR_FLOOD);
+  fail_unless(test_fdb_lookup(2) == (1 << 2));
+  fail_unless(test_fdb_lookup(7) == (1 << 3));
+
+  /* the freed entries can be used again */
+  for (n = 0; n < TEST_FDB_ENTRIES - 2; n++) {
+    test_fdb_learn((u8_t)(100 + n), 1);
+  }
+  test_fdb_learn(200, 1);
+  for (n = 0; n < TEST_FDB_ENTRIES - 2; n++) {
+    fail_unless(test_fdb_lookup((u8_t)(100 + n)) == (1 << 1));
+  }
+  fail_unless(test_fdb_lookup(200) == BR_FLOOD);
+  fail_unless(test_fdb_lookup(2) == (1 << 2));
+  fail_unless(test_fdb_lookup(7) == (1 << 3));
+}
+END_TEST
+
+static void
+test_fdb_age_out_and_reuse(void)
+{
+  /* 1 ages out, its entry is reused for 3 */
+  test_fdb_tick(1);
+  test_fdb_learn(3, 3);
+}
+
+static void
+test_fdb_age_out(void)
+{
+  test_fdb_tick(1);
+}
+
+/** Entries age out while a lookup or update is in progress */
+START_TEST(test_bridgeif_fdb_remove_during_lookup)
+{
+  LWIP_UNUSED_ARG(_i);
+
+  /* 2 and 7 share a bucket (7 is in front as it is learnt later) */
+  test_fdb_learn(2, 2);
+  test_fdb_tick(1);
+  test_fdb_learn(1, 1);
+  test_fdb_tick(1);
+  test_fdb_learn(7, 3);
+  test_fdb_tick(BR_FDB_TIMEOUT_SEC - 3);
+  fail_unless(test_fdb_lookup(1) == (1 << 1));
+  fail_unless(test_fdb_lookup(2) == (1 << 2));
+  fail_unless(test_fdb_lookup(7) == (1 << 3));
+
+  /* 2 ages out during the lookup of 7 */
+  test_fdb_read_locked_fn = test_fdb_age_out;
+  fail_unless(test_fdb_lookup(7) == (1 << 3));
+  fail_unless(test_fdb_read_locked_fn == NULL);
+  fail_unless(test_fdb_lookup(2) == BR_FLOOD);
+
+  /* 1 moves to port 2 while it ages out and its entry is reused for 3 */
+  test_fdb_write_locked_fn = test_fdb_age_out_and_reuse;
+  test_fdb_learn(1, 2);
+  fail_unless(test_fdb_write_locked_fn == NULL);
+  fail_unless(test_fdb_lookup(3) == (1 << 3));
+  fail_unless(test_fdb_lookup(1) == (1 << 2));
+  fail_unless(test_fdb_lookup(7) == (1 << 3));
+}
+END_TEST
+
+/** Create the suite including all tests for this module */
+Suite *
+bridgeif_fdb_suite(void)
+{
+  testfunc tests[] = {
+    TESTFUNC(test_bridgeif_fdb_learn),
+    TESTFUNC(test_bridgeif_fdb_age),
+    TESTFUNC(test_bridgeif_fdb_age_wheel),
+    TESTFUNC(test_bridgeif_fdb_buckets),
+    TESTFUNC(test_bridgeif_fdb_remove_during_lookup)
+  };
+  return create_suite("BRIDGEIF_FDB", tests, sizeof(tests)/sizeof(testfunc), bridgeif_fdb_setup, bridgeif_fdb_teardown);
+}
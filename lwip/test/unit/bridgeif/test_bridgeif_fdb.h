@@ -0,0 +1,8 @@
+#ifndef LWIP_HDR_TEST_BRIDGEIF_FDB_H
+#define LWIP_HDR_TEST_BRIDGEIF_FDB_H
+
+#include "../lwip_check.h"
+
+Suite* bridgeif_fdb_suite(void);
+
+#endif
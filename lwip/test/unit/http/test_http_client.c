@@ -0,0 +1,468 @@
+#include "test_http_client.h"
+
+#include "lwip/apps/http_client.h"
+#include "lwip/tcp.h"
+#include "lwip/priv/tcp_priv.h"
+#include "lwip/tcpip.h"
+
+#include <string.h>
+
+#define TEST_HTTPC_PORT 8000
+
+/* One connection accepted by the fake server */
+struct test_httpc_srv_conn {
+  struct tcp_pcb *pcb;
+  u8_t closed;
+  char rx[1024];
+  u16_t rx_len;
+};
+
+/* State of one request, passed as callback_arg */
+struct test_httpc_req {
+  u8_t done;
+  httpc_result_t result;
+  u32_t rx_content_len;
+  u32_t srv_res;
+  /* number of recv_fn calls to refuse (return ERR_MEM) */
+  u8_t refuse;
+  char body[256];
+  u16_t body_len;
+};
+
+static struct tcp_pcb *test_srv_listen;
+static struct test_httpc_srv_conn test_srv[4];
+static u8_t test_srv_accepted;
+static httpc_connection_t test_settings;
+
+static const char test_resp_ok[] =
+  "HTTP/1.1 200 OK\r\n"
+  "Content-Length: 2\r\n"
+  "\r\n"
+  "ok";
+
+static err_t
+test_srv_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err)
+{
+  struct test_httpc_srv_conn *c = (struct test_httpc_srv_conn *)arg;
+  LWIP_UNUSED_ARG(err);
+  if (p == NULL) {
+    c->closed = 1;
+    return ERR_OK;
+  }
+  fail_unless(c->rx_len + p->tot_len <= sizeof(c->rx));
+  pbuf_copy_partial(p, &c->rx[c->rx_len], p->tot_len, 0);
+  c->rx_len = (u16_t)(c->rx_len + p->tot_len);
+  tcp_recved(pcb, p->tot_len);
+  pbuf_free(p);
+  return ERR_OK;
+}
+
+static void
+test_srv_err(void *arg, err_t err)
+{
+  struct test_httpc_srv_conn *c = (struct test_httpc_srv_conn *)arg;
+  LWIP_UNUSED_ARG(err);
+  c->pcb = NULL;
+  c->closed = 1;
+}
+
+static err_t
+test_srv_accept(void *arg, struct tcp_pcb *pcb, err_t err)
+{
+  struct test_httpc_srv_conn *c;
+  LWIP_UNUSED_ARG(arg);
+  fail_unless(err == ERR_OK);
+  fail_unless(test_srv_accepted < LWIP_ARRAYSIZE(test_srv));
+  c = &test_srv[test_srv_accepted++];
+  memset(c, 0, sizeof(*c));
+  c->pcb = pcb;
+  tcp_arg(pcb, c);
+  tcp_recv(pcb, test_srv_recv);
+  tcp_err(pcb, test_srv_err);
+  /* every tcp_write must go out as a segment of its own */
+  tcp_nagle_disable(pcb);
+  return ERR_OK;
+}
+
+/* Process everything queued on the loopback netif, including delayed ACKs
+ * and refused data */
+static void
+test_httpc_pump(void)
+{
+  int i;
+  for (i = 0; i < 4; i++) {
+    while (tcpip_thread_poll_one());
+    LOCK_TCPIP_CORE();
+    tcp_fasttmr();
+    UNLOCK_TCPIP_CORE();
+  }
+}
+
+static void
+test_srv_send(struct test_httpc_srv_conn *c, const char *data, u16_t len)
+{
+  err_t err;
+  fail_unless(c->pcb != NULL);
+  LOCK_TCPIP_CORE();
+  err = tcp_write(c->pcb, data, len, TCP_WRITE_FLAG_COPY);
+  fail_unless(err == ERR_OK);
+  err = tcp_output(c->pcb);
+  fail_unless(err == ERR_OK);
+  UNLOCK_TCPIP_CORE();
+  test_httpc_pump();
+}
+
+static void
+test_srv_close(struct test_httpc_srv_conn *c)
+{
+  fail_unless(c->pcb != NULL);
+  LOCK_TCPIP_CORE();
+  fail_unless(tcp_close(c->pcb) == ERR_OK);
+  UNLOCK_TCPIP_CORE();
+  c->pcb = NULL;
+  test_httpc_pump();
+}
+
+/* Check that 'c' received a GET request for 'uri' (at any position) */
+static int
+test_srv_got_request(const struct test_httpc_srv_conn *c, const char *uri)
+{
+  char line[32];
+  size_t len = (size_t)snprintf(line, sizeof(line), "GET %s HTTP/1.1\r\n", uri);
+  u16_t i;
+  for (i = 0; i + len <= c->rx_len; i++) {
+    if (!memcmp(&c->rx[i], line, len)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static err_t
+test_httpc_recv(void *arg, struct altcp_pcb *pcb, struct pbuf *p, err_t err)
+{
+  struct test_httpc_req *r = (struct test_httpc_req *)arg;
+  LWIP_UNUSED_ARG(err);
+  fail_unless(p != NULL);
+  if (r->refuse) {
+    r->refuse--;
+    return ERR_MEM;
+  }
+  fail_unless(r->body_len + p->tot_len <= sizeof(r->body));
+  pbuf_copy_partial(p, &r->body[r->body_len], p->tot_len, 0);
+  r->body_len = (u16_t)(r->body_len + p->tot_len);
+  altcp_recved(pcb, p->tot_len);
+  pbuf_free(p);
+  return ERR_OK;
+}
+
+static void
+test_httpc_result(void *arg, httpc_result_t httpc_result, u32_t rx_content_len, u32_t srv_res, err_t err)
+{
+  struct test_httpc_req *r = (struct test_httpc_req *)arg;
+  LWIP_UNUSED_ARG(err);
+  fail_unless(!r->done);
+  r->done = 1;
+  r->result = httpc_result;
+  r->rx_content_len = rx_content_len;
+  r->srv_res = srv_res;
+}
+
+static void
+test_httpc_get(const char *uri, struct test_httpc_req *r)
+{
+  ip_addr_t loop;
+  httpc_state_t *conn;
+  err_t err;
+
+  memset(r, 0, sizeof(*r));
+  IP_ADDR4(&loop, 127, 0, 0, 1);
+  LOCK_TCPIP_CORE();
+  err = httpc_get_file(&loop, TEST_HTTPC_PORT, uri, &test_settings, test_httpc_recv, r, &conn);
+  UNLOCK_TCPIP_CORE();
+  fail_unless(err == ERR_OK);
+}
+
+static void
+test_httpc_check(const struct test_httpc_req *r, const char *body)
+{
+  u16_t len = (u16_t)strlen(body);
+  fail_unless(r->done);
+  fail_unless(r->result == HTTPC_RESULT_OK);
+  fail_unless(r->srv_res == 200);
+  fail_unless(r->rx_content_len == len);
+  fail_unless(r->body_len == len);
+  fail_unless(!memcmp(r->body, body, len));
+}
+
+/* Setups/teardown functions */
+
+static void
+httpc_setup(void)
+{
+  lwip_check_ensure_no_alloc(SKIP_POOL(MEMP_SYS_TIMEOUT));
+  memset(test_srv, 0, sizeof(test_srv));
+  test_srv_accepted = 0;
+  memset(&test_settings, 0, sizeof(test_settings));
+  test_settings.result_fn = test_httpc_result;
+  LOCK_TCPIP_CORE();
+  test_srv_listen = tcp_new();
+  fail_unless(test_srv_listen != NULL);
+  fail_unless(tcp_bind(test_srv_listen, IP4_ADDR_ANY, TEST_HTTPC_PORT) == ERR_OK);
+  test_srv_listen = tcp_listen(test_srv_listen);
+  fail_unless(test_srv_listen != NULL);
+  tcp_accept(test_srv_listen, test_srv_accept);
+  UNLOCK_TCPIP_CORE();
+}
+
+static void
+httpc_teardown(void)
+{
+  u8_t i;
+  /* reset the server side: pooled client connections are released on error */
+  LOCK_TCPIP_CORE();
+  for (i = 0; i < test_srv_accepted; i++) {
+    if (test_srv[i].pcb != NULL) {
+      tcp_arg(test_srv[i].pcb, NULL);
+      tcp_recv(test_srv[i].pcb, NULL);
+      tcp_err(test_srv[i].pcb, NULL);
+      tcp_abort(test_srv[i].pcb);
+      test_srv[i].pcb = NULL;
+    }
+  }
+  UNLOCK_TCPIP_CORE();
+  test_httpc_pump();
+  LOCK_TCPIP_CORE();
+  fail_unless(tcp_active_pcbs == NULL);
+  while (tcp_tw_pcbs != NULL) {
+    tcp_abort(tcp_tw_pcbs);
+  }
+  tcp_close(test_srv_listen);
+  UNLOCK_TCPIP_CORE();
+  while (tcpip_thread_poll_one());
+  lwip_check_ensure_no_alloc(SKIP_POOL(MEMP_SYS_TIMEOUT));
+}
+
+/* Test functions */
+
+#if LWIP_HTTPC_KEEPALIVE
+
+/** A persistent connection is reused, 'Connection: close' starts a new one */
+START_TEST(test_httpc_pool_reuse)
+{
+  static const char resp_close[] =
+    "HTTP/1.1 200 OK\r\n"
+    "Content-Length: 3\r\n"
+    "Connection: close\r\n"
+    "\r\n"
+    "bye";
+  struct test_httpc_req r;
+  LWIP_UNUSED_ARG(_i);
+
+  test_httpc_get("/a", &r);
+  test_httpc_pump();
+  fail_unless(test_srv_accepted == 1);
+  fail_unless(test_srv_got_request(&test_srv[0], "/a"));
+  test_srv_send(&test_srv[0], test_resp_ok, sizeof(test_resp_ok) - 1);
+  /* the response is complete without the server closing the connection */
+  test_httpc_check(&r, "ok");
+  fail_unless(!test_srv[0].closed);
+
+  test_httpc_get("/b", &r);
+  test_httpc_pump();
+  fail_unless(test_srv_accepted == 1);
+  fail_unless(test_srv_got_request(&test_srv[0], "/b"));
+  test_srv_send(&test_srv[0], resp_close, sizeof(resp_close) - 1);
+  test_httpc_check(&r, "bye");
+  /* the client closes a connection the server does not keep open */
+  fail_unless(test_srv[0].closed);
+  test_srv_close(&test_srv[0]);
+
+  test_httpc_get("/c", &r);
+  test_httpc_pump();
+  fail_unless(test_srv_accepted == 2);
+  fail_unless(test_srv_got_request(&test_srv[1], "/c"));
+  test_srv_send(&test_srv[1], test_resp_ok, sizeof(test_resp_ok) - 1);
+  test_httpc_check(&r, "ok");
+}
+END_TEST
+
+/** Requests are only pipelined after the server kept the connection open
+ * once, the responses may arrive in one segment */
+START_TEST(test_httpc_pipelining)
+{
+  struct test_httpc_req r[3];
+  char resps[3 * sizeof(test_resp_ok)];
+  u16_t len = (u16_t)(sizeof(test_resp_ok) - 1);
+  LWIP_UNUSED_ARG(_i);
+
+  /* nothing known about the server yet: a second connection is opened */
+  test_httpc_get("/a", &r[0]);
+  test_httpc_get("/b", &r[1]);
+  test_httpc_pump();
+  fail_unless(test_srv_accepted == 2);
+  fail_unless(test_srv_got_request(&test_srv[0], "/a"));
+  fail_unless(test_srv_got_request(&test_srv[1], "/b"));
+  test_srv_send(&test_srv[0], test_resp_ok, len);
+  test_srv_send(&test_srv[1], test_resp_ok, len);
+  test_httpc_check(&r[0], "ok");
+  test_httpc_check(&r[1], "ok");
+
+  /* an idle connection closed by the server leaves the pool */
+  test_srv_close(&test_srv[1]);
+  fail_unless(test_srv[1].closed);
+
+  /* the remaining connection takes all requests */
+  test_srv[0].rx_len = 0;
+  test_httpc_get("/c", &r[0]);
+  test_httpc_get("/d", &r[1]);
+  test_httpc_get("/e", &r[2]);
+  test_httpc_pump();
+  fail_unless(test_srv_accepted == 2);
+  fail_unless(test_srv_got_request(&test_srv[0], "/c"));
+  fail_unless(test_srv_got_request(&test_srv[0], "/d"));
+  fail_unless(test_srv_got_request(&test_srv[0], "/e"));
+  fail_unless(!r[0].done);
+
+  MEMCPY(resps, test_resp_ok, len);
+  MEMCPY(&resps[len], test_resp_ok, len);
+  MEMCPY(&resps[2 * len], test_resp_ok, len);
+  test_srv_send(&test_srv[0], resps, (u16_t)(3 * len));
+  test_httpc_check(&r[0], "ok");
+  test_httpc_check(&r[1], "ok");
+  test_httpc_check(&r[2], "ok");
+  fail_unless(!test_srv[0].closed);
+}
+END_TEST
+
+/** A chunked response and a pipelined response behind it, split into two
+ * segments at every possible offset (inside chunk sizes, extensions, CRLFs
+ * and the trailer) */
+START_TEST(test_httpc_chunked_split)
+{
+  static const char resps[] =
+    "HTTP/1.1 200 OK\r\n"
+    "Transfer-Encoding: chunked\r\n"
+    "\r\n"
+    "5\r\n"
+    "hello\r\n"
+    "10;x=y\r\n"
+    "0123456789abcdef\r\n"
+    "0\r\n"
+    "T: v\r\n"
+    "\r\n"
+    "HTTP/1.1 200 OK\r\n"
+    "Content-Length: 2\r\n"
+    "\r\n"
+    "ok";
+  struct test_httpc_req r[2];
+  u16_t len = (u16_t)(sizeof(resps) - 1);
+  u16_t split;
+  LWIP_UNUSED_ARG(_i);
+
+  /* a completed response allows pipelining */
+  test_httpc_get("/a", &r[0]);
+  test_httpc_pump();
+  test_srv_send(&test_srv[0], test_resp_ok, sizeof(test_resp_ok) - 1);
+  test_httpc_check(&r[0], "ok");
+
+  for (split = 1; split < len; split++) {
+    test_srv[0].rx_len = 0;
+    test_httpc_get("/chunked", &r[0]);
+    test_httpc_get("/b", &r[1]);
+    test_httpc_pump();
+    fail_unless(test_srv_got_request(&test_srv[0], "/b"));
+    test_srv_send(&test_srv[0], resps, split);
+    test_srv_send(&test_srv[0], &resps[split], (u16_t)(len - split));
+    test_httpc_check(&r[0], "hello0123456789abcdef");
+    test_httpc_check(&r[1], "ok");
+  }
+  fail_unless(test_srv_accepted == 1);
+}
+END_TEST
+
+/** Chunked encoding received byte by byte */
+START_TEST(test_httpc_chunked_bytewise)
+{
+  static const char resp[] =
+    "HTTP/1.1 200 OK\r\n"
+    "Transfer-Encoding: chunked\r\n"
+    "\r\n"
+    "1a\r\n"
+    "abcdefghijklmnopqrstuvwxyz\r\n"
+    "0\r\n"
+    "\r\n";
+  struct test_httpc_req r;
+  u16_t i;
+  LWIP_UNUSED_ARG(_i);
+
+  test_httpc_get("/chunked", &r);
+  test_httpc_pump();
+  for (i = 0; i < sizeof(resp) - 1; i++) {
+    fail_unless(!r.done);
+    test_srv_send(&test_srv[0], &resp[i], 1);
+  }
+  test_httpc_check(&r, "abcdefghijklmnopqrstuvwxyz");
+  fail_unless(!test_srv[0].closed);
+}
+END_TEST
+
+/** Body data cannot be refused with a persistent connection */
+START_TEST(test_httpc_recv_error)
+{
+  struct test_httpc_req r;
+  LWIP_UNUSED_ARG(_i);
+
+  test_httpc_get("/a", &r);
+  r.refuse = 1;
+  test_httpc_pump();
+  test_srv_send(&test_srv[0], test_resp_ok, sizeof(test_resp_ok) - 1);
+  fail_unless(r.done);
+  fail_unless(r.result == HTTPC_RESULT_LOCAL_ABORT);
+  fail_unless(r.body_len == 0);
+}
+END_TEST
+
+#else /* LWIP_HTTPC_KEEPALIVE */
+
+/** Without keep-alive, data refused by recv_fn is passed again by TCP and
+ * the response ends when the server closes the connection */
+START_TEST(test_httpc_recv_refused)
+{
+  struct test_httpc_req r;
+  LWIP_UNUSED_ARG(_i);
+
+  test_httpc_get("/a", &r);
+  r.refuse = 1;
+  test_httpc_pump();
+  fail_unless(test_srv_accepted == 1);
+  fail_unless(test_srv_got_request(&test_srv[0], "/a"));
+  test_srv_send(&test_srv[0], test_resp_ok, sizeof(test_resp_ok) - 1);
+  fail_unless(r.refuse == 0);
+  fail_unless(!r.done);
+  fail_unless(r.body_len == 2);
+  fail_unless(!memcmp(r.body, "ok", 2));
+  test_srv_close(&test_srv[0]);
+  test_httpc_check(&r, "ok");
+}
+END_TEST
+
+#endif /* LWIP_HTTPC_KEEPALIVE */
+
+/** Create the suite including all tests for this module */
+Suite *
+http_client_suite(void)
+{
+  testfunc tests[] = {
+#if LWIP_HTTPC_KEEPALIVE
+    TESTFUNC(test_httpc_pool_reuse),
+    TESTFUNC(test_httpc_pipelining),
+    TESTFUNC(test_httpc_chunked_split),
+    TESTFUNC(test_httpc_chunked_bytewise),
+    TESTFUNC(test_httpc_recv_error)
+#else /* LWIP_HTTPC_KEEPALIVE */
+    TESTFUNC(test_httpc_recv_refused)
+#endif /* LWIP_HTTPC_KEEPALIVE */
+  };
+  return create_suite("HTTP_CLIENT", tests, sizeof(tests)/sizeof(testfunc), httpc_setup, httpc_teardown);
+}
@@ -0,0 +1,8 @@
+#ifndef LWIP_HDR_TEST_HTTP_CLIENT_H
+#define LWIP_HDR_TEST_HTTP_CLIENT_H
+
+#include "../lwip_check.h"
+
+Suite* http_client_suite(void);
+
+#endif
@@ -0,0 +1,834 @@
+#include "test_httpd.h"
+
+#include "lwip/apps/httpd.h"
+#include "lwip/apps/httpd_ws.h"
+#include "lwip/apps/fs.h"
+#include "lwip/altcp.h"
+#include "lwip/tcp.h"
+#include "lwip/priv/tcp_priv.h"
+#include "lwip/tcpip.h"
+
+#include <string.h>
+
+#if !LWIP_HTTPD_STREAMING_PARSER || !LWIP_HTTPD_HEADER_CALLBACK
+#error "This tests needs LWIP_HTTPD_STREAMING_PARSER and LWIP_HTTPD_HEADER_CALLBACK"
+#endif
+
+#if !LWIP_HTTPD_CUSTOM_FILES || !LWIP_HTTPD_SSI_ASYNC || !LWIP_HTTPD_CGI_ASYNC
+#error "This tests needs LWIP_HTTPD_CUSTOM_FILES, LWIP_HTTPD_SSI_ASYNC and LWIP_HTTPD_CGI_ASYNC"
+#endif
+
+/* A raw TCP client connected to httpd over the loopback netif */
+struct test_httpd_client {
+  struct tcp_pcb *pcb;
+  u8_t connected;
+  u8_t closed;
+  char rx[4096];
+  u16_t rx_len;
+};
+
+static struct test_httpd_client test_client;
+#if LWIP_HTTPD_WEBSOCKET
+static struct test_httpd_client test_client2;
+#endif /* LWIP_HTTPD_WEBSOCKET */
+
+/* Request URI expected by httpd_header_received() */
+static const char *test_hdr_uri;
+/* Values of the "host" header passed to httpd_header_received() */
+static char test_hdr_host[32];
+static u16_t test_hdr_host_len;
+static int test_hdr_complete;
+
+void
+httpd_header_received(void *connection, const char *uri, const char *name,
+                      const char *value, u16_t value_len, u8_t value_complete)
+{
+  LWIP_UNUSED_ARG(connection);
+  fail_unless(strcmp(uri, test_hdr_uri) == 0);
+  if (value_complete) {
+    test_hdr_complete++;
+  }
+  if (!lwip_stricmp(name, "host")) {
+    fail_unless(test_hdr_host_len + value_len < sizeof(test_hdr_host));
+    MEMCPY(&test_hdr_host[test_hdr_host_len], value, value_len);
+    test_hdr_host_len = (u16_t)(test_hdr_host_len + value_len);
+  }
+}
+
+static err_t
+test_httpd_client_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err)
+{
+  struct test_httpd_client *c = (struct test_httpd_client *)arg;
+  LWIP_UNUSED_ARG(err);
+  if (p == NULL) {
+    c->closed = 1;
+    return ERR_OK;
+  }
+  fail_unless(c->rx_len + p->tot_len <= sizeof(c->rx));
+  pbuf_copy_partial(p, &c->rx[c->rx_len], p->tot_len, 0);
+  c->rx_len = (u16_t)(c->rx_len + p->tot_len);
+  tcp_recved(pcb, p->tot_len);
+  pbuf_free(p);
+  return ERR_OK;
+}
+
+static err_t
+test_httpd_client_connected(void *arg, struct tcp_pcb *pcb, err_t err)
+{
+  struct test_httpd_client *c = (struct test_httpd_client *)arg;
+  LWIP_UNUSED_ARG(pcb);
+  fail_unless(err == ERR_OK);
+  c->connected = 1;
+  return ERR_OK;
+}
+
+static void
+test_httpd_client_err(void *arg, err_t err)
+{
+  struct test_httpd_client *c = (struct test_httpd_client *)arg;
+  LWIP_UNUSED_ARG(err);
+  c->pcb = NULL;
+  c->closed = 1;
+}
+
+/* Process everything queued on the loopback netif, including delayed ACKs */
+static void
+test_httpd_pump(void)
+{
+  int i;
+  for (i = 0; i < 4; i++) {
+    while (tcpip_thread_poll_one());
+    LOCK_TCPIP_CORE();
+    tcp_fasttmr();
+    UNLOCK_TCPIP_CORE();
+  }
+}
+
+static void
+test_httpd_connect(struct test_httpd_client *c)
+{
+  ip_addr_t loop;
+  err_t err;
+
+  memset(c, 0, sizeof(*c));
+  IP_ADDR4(&loop, 127, 0, 0, 1);
+  LOCK_TCPIP_CORE();
+  c->pcb = tcp_new();
+  fail_unless(c->pcb != NULL);
+  tcp_arg(c->pcb, c);
+  tcp_recv(c->pcb, test_httpd_client_recv);
+  tcp_err(c->pcb, test_httpd_client_err);
+  /* every tcp_write must go out as a segment of its own */
+  tcp_nagle_disable(c->pcb);
+  err = tcp_connect(c->pcb, &loop, HTTPD_SERVER_PORT, test_httpd_client_connected);
+  UNLOCK_TCPIP_CORE();
+  fail_unless(err == ERR_OK);
+  test_httpd_pump();
+  fail_unless(c->connected);
+}
+
+static void
+test_httpd_send(struct test_httpd_client *c, const char *data, u16_t len)
+{
+  err_t err;
+  LOCK_TCPIP_CORE();
+  err = tcp_write(c->pcb, data, len, TCP_WRITE_FLAG_COPY);
+  fail_unless(err == ERR_OK);
+  err = tcp_output(c->pcb);
+  fail_unless(err == ERR_OK);
+  UNLOCK_TCPIP_CORE();
+  test_httpd_pump();
+}
+
+static void
+test_httpd_close(struct test_httpd_client *c)
+{
+  if (c->pcb != NULL) {
+    LOCK_TCPIP_CORE();
+    tcp_arg(c->pcb, NULL);
+    tcp_recv(c->pcb, NULL);
+    tcp_err(c->pcb, NULL);
+    tcp_abort(c->pcb);
+    UNLOCK_TCPIP_CORE();
+    c->pcb = NULL;
+  }
+  test_httpd_pump();
+}
+
+/* Check the response to a GET request for /index.html of the default fsdata */
+static void
+test_httpd_check_index(struct test_httpd_client *c)
+{
+  static const char status[] = "HTTP/1.0 200 OK\r\n";
+  fail_unless(c->closed);
+  fail_unless(c->rx_len > sizeof(status) - 1);
+  fail_unless(!memcmp(c->rx, status, sizeof(status) - 1));
+  fail_unless(test_hdr_host_len == 12);
+  fail_unless(!memcmp(test_hdr_host, "lwip.example", 12));
+  fail_unless(test_hdr_complete == 2);
+}
+
+/* SSI test file, served in addition to the default fsdata */
+#define TEST_SSI_HDR "HTTP/1.0 200 OK\r\n\r\n"
+#define TEST_SSI_HDR_LEN 19
+static const char test_ssi_file[] = TEST_SSI_HDR "A<!--#t-->B";
+
+/* called by fs.c, which does not export the prototypes */
+int fs_open_custom(struct fs_file *file, const char *name);
+void fs_close_custom(struct fs_file *file);
+
+int
+fs_open_custom(struct fs_file *file, const char *name)
+{
+  if (strcmp(name, "/t.shtml") != 0) {
+    return 0;
+  }
+  memset(file, 0, sizeof(*file));
+  file->data = test_ssi_file;
+  file->len = (int)(sizeof(test_ssi_file) - 1);
+  file->index = file->len;
+  file->flags = FS_FILE_FLAGS_HEADER_INCLUDED;
+  return 1;
+}
+
+void
+fs_close_custom(struct fs_file *file)
+{
+  LWIP_UNUSED_ARG(file);
+}
+
+/* SSI handler state: the handler returns HTTPD_SSI_TAG_PENDING while
+ * test_ssi_pending is set */
+static const char *test_ssi_tags[] = {"t"};
+static void *test_ssi_conn;
+static int test_ssi_calls;
+static u8_t test_ssi_pending;
+static u8_t test_ssi_continue_in_handler;
+
+static u16_t
+test_ssi_handler(int iIndex, char *pcInsert, int iInsertLen, void *connection)
+{
+  fail_unless(iIndex == 0);
+  fail_unless(iInsertLen >= 3);
+  test_ssi_calls++;
+  test_ssi_conn = connection;
+  if (test_ssi_pending) {
+    if (test_ssi_continue_in_handler) {
+      /* data became available while the handler was running */
+      test_ssi_pending = 0;
+      httpd_ssi_continue(connection);
+    }
+    return HTTPD_SSI_TAG_PENDING;
+  }
+  MEMCPY(pcInsert, "xyz", 3);
+  return 3;
+}
+
+/* CGI handler state: the handler always defers its response */
+static void *test_cgi_conn;
+static int test_cgi_calls;
+
+static const char *
+test_cgi_handler(int iIndex, int iNumParams, char *pcParam[], char *pcValue[], void *connection)
+{
+  fail_unless(iIndex == 0);
+  fail_unless(iNumParams == 1);
+  fail_unless(strcmp(pcParam[0], "a") == 0);
+  fail_unless(strcmp(pcValue[0], "1") == 0);
+  test_cgi_calls++;
+  test_cgi_conn = connection;
+  return HTTPD_CGI_PENDING;
+}
+
+static const tCGI test_cgis[] = {
+  {"/cgi", test_cgi_handler}
+};
+
+/* Setups/teardown functions */
+
+static void
+httpd_setup(void)
+{
+  lwip_check_ensure_no_alloc(SKIP_POOL(MEMP_SYS_TIMEOUT));
+  LOCK_TCPIP_CORE();
+  httpd_init();
+  UNLOCK_TCPIP_CORE();
+  test_hdr_uri = "/index.html";
+  test_hdr_host_len = 0;
+  test_hdr_complete = 0;
+  http_set_ssi_handler(test_ssi_handler, test_ssi_tags, LWIP_ARRAYSIZE(test_ssi_tags));
+  http_set_cgi_handlers(test_cgis, LWIP_ARRAYSIZE(test_cgis));
+  test_ssi_conn = NULL;
+  test_ssi_calls = 0;
+  test_ssi_pending = 0;
+  test_ssi_continue_in_handler = 0;
+  test_cgi_conn = NULL;
+  test_cgi_calls = 0;
+}
+
+static void
+httpd_teardown(void)
+{
+  test_httpd_close(&test_client);
+#if LWIP_HTTPD_WEBSOCKET
+  test_httpd_close(&test_client2);
+#endif /* LWIP_HTTPD_WEBSOCKET */
+  LOCK_TCPIP_CORE();
+  while (tcp_active_pcbs != NULL) {
+    tcp_abort(tcp_active_pcbs);
+  }
+  while (tcp_tw_pcbs != NULL) {
+    tcp_abort(tcp_tw_pcbs);
+  }
+  /* the httpd listener is the only one */
+  fail_unless(tcp_listen_pcbs.listen_pcbs != NULL);
+#if LWIP_ALTCP
+  altcp_close((struct altcp_pcb *)tcp_listen_pcbs.listen_pcbs->callback_arg);
+#else
+  tcp_close((struct tcp_pcb *)tcp_listen_pcbs.listen_pcbs);
+#endif
+  fail_unless(tcp_listen_pcbs.listen_pcbs == NULL);
+  UNLOCK_TCPIP_CORE();
+  while (tcpip_thread_poll_one());
+  lwip_check_ensure_no_alloc(SKIP_POOL(MEMP_SYS_TIMEOUT));
+}
+
+/* Test functions */
+
+static const char test_request[] =
+  "GET /index.html HTTP/1.0\r\n"
+  "Host: lwip.example\r\n"
+  "User-Agent: check\r\n"
+  "\r\n";
+
+/** The request split into two segments at every possible offset */
+START_TEST(test_httpd_request_split)
+{
+  u16_t len = (u16_t)(sizeof(test_request) - 1);
+  u16_t split;
+  LWIP_UNUSED_ARG(_i);
+
+  for (split = 1; split < len; split++) {
+    test_hdr_host_len = 0;
+    test_hdr_complete = 0;
+    test_httpd_connect(&test_client);
+    test_httpd_send(&test_client, test_request, split);
+    fail_unless(test_client.rx_len == 0);
+    test_httpd_send(&test_client, &test_request[split], (u16_t)(len - split));
+    test_httpd_check_index(&test_client);
+    test_httpd_close(&test_client);
+  }
+}
+END_TEST
+
+/** The request sent one byte per segment */
+START_TEST(test_httpd_request_bytewise)
+{
+  u16_t len = (u16_t)(sizeof(test_request) - 1);
+  u16_t i;
+  LWIP_UNUSED_ARG(_i);
+
+  test_httpd_connect(&test_client);
+  for (i = 0; i < len; i++) {
+    fail_unless(test_client.rx_len == 0);
+    test_httpd_send(&test_client, &test_request[i], 1);
+  }
+  test_httpd_check_index(&test_client);
+}
+END_TEST
+
+static const char test_ssi_request[] = "GET /t.shtml HTTP/1.0\r\n\r\n";
+
+/** A synchronous SSI handler, for reference */
+START_TEST(test_httpd_ssi_sync)
+{
+  LWIP_UNUSED_ARG(_i);
+
+  test_hdr_uri = "/t.shtml";
+  test_httpd_connect(&test_client);
+  test_httpd_send(&test_client, test_ssi_request, (u16_t)(sizeof(test_ssi_request) - 1));
+  fail_unless(test_ssi_calls == 1);
+  fail_unless(test_client.closed);
+  fail_unless(test_client.rx_len == TEST_SSI_HDR_LEN + 14);
+  fail_unless(!memcmp(test_client.rx, TEST_SSI_HDR "A<!--#t-->xyzB", TEST_SSI_HDR_LEN + 14));
+}
+END_TEST
+
+/** HTTPD_SSI_TAG_PENDING suspends sending until httpd_ssi_continue() */
+START_TEST(test_httpd_ssi_pending)
+{
+  LWIP_UNUSED_ARG(_i);
+
+  test_hdr_uri = "/t.shtml";
+  test_ssi_pending = 1;
+  test_httpd_connect(&test_client);
+  test_httpd_send(&test_client, test_ssi_request, (u16_t)(sizeof(test_ssi_request) - 1));
+  fail_unless(test_ssi_calls == 1);
+  fail_unless(test_ssi_conn != NULL);
+  /* the file up to the tag is sent, the connection stays open */
+  fail_unless(test_client.rx_len == TEST_SSI_HDR_LEN + 10);
+  fail_unless(!memcmp(test_client.rx, TEST_SSI_HDR "A<!--#t-->", TEST_SSI_HDR_LEN + 10));
+  fail_unless(!test_client.closed);
+
+  test_ssi_pending = 0;
+  LOCK_TCPIP_CORE();
+  httpd_ssi_continue(test_ssi_conn);
+  UNLOCK_TCPIP_CORE();
+  test_httpd_pump();
+  fail_unless(test_ssi_calls == 2);
+  fail_unless(test_client.closed);
+  fail_unless(test_client.rx_len == TEST_SSI_HDR_LEN + 14);
+  fail_unless(!memcmp(test_client.rx, TEST_SSI_HDR "A<!--#t-->xyzB", TEST_SSI_HDR_LEN + 14));
+
+  /* a second call does nothing */
+  LOCK_TCPIP_CORE();
+  httpd_ssi_continue(test_ssi_conn);
+  UNLOCK_TCPIP_CORE();
+  fail_unless(test_ssi_calls == 2);
+}
+END_TEST
+
+/** httpd_ssi_continue() called from within the SSI handler */
+START_TEST(test_httpd_ssi_continue_in_handler)
+{
+  LWIP_UNUSED_ARG(_i);
+
+  test_hdr_uri = "/t.shtml";
+  test_ssi_pending = 1;
+  test_ssi_continue_in_handler = 1;
+  test_httpd_connect(&test_client);
+  test_httpd_send(&test_client, test_ssi_request, (u16_t)(sizeof(test_ssi_request) - 1));
+  /* called again right away */
+  fail_unless(test_ssi_calls == 2);
+  fail_unless(test_client.closed);
+  fail_unless(test_client.rx_len == TEST_SSI_HDR_LEN + 14);
+  fail_unless(!memcmp(test_client.rx, TEST_SSI_HDR "A<!--#t-->xyzB", TEST_SSI_HDR_LEN + 14));
+}
+END_TEST
+
+/** httpd_ssi_continue() after the client has closed the connection is ignored */
+START_TEST(test_httpd_ssi_continue_closed)
+{
+  LWIP_UNUSED_ARG(_i);
+
+  test_hdr_uri = "/t.shtml";
+  test_ssi_pending = 1;
+  test_httpd_connect(&test_client);
+  test_httpd_send(&test_client, test_ssi_request, (u16_t)(sizeof(test_ssi_request) - 1));
+  fail_unless(test_ssi_calls == 1);
+  test_httpd_close(&test_client);
+
+  test_ssi_pending = 0;
+  LOCK_TCPIP_CORE();
+  httpd_ssi_continue(test_ssi_conn);
+  UNLOCK_TCPIP_CORE();
+  test_httpd_pump();
+  fail_unless(test_ssi_calls == 1);
+}
+END_TEST
+
+static const char test_cgi_request[] = "GET /cgi?a=1 HTTP/1.0\r\n\r\n";
+
+/** HTTPD_CGI_PENDING: nothing is sent until httpd_cgi_continue() */
+START_TEST(test_httpd_cgi_pending)
+{
+  static const char status[] = "HTTP/1.0 200 OK\r\n";
+  LWIP_UNUSED_ARG(_i);
+
+  test_hdr_uri = "/cgi?a=1";
+  test_httpd_connect(&test_client);
+  test_httpd_send(&test_client, test_cgi_request, (u16_t)(sizeof(test_cgi_request) - 1));
+  fail_unless(test_cgi_calls == 1);
+  fail_unless(test_cgi_conn != NULL);
+  fail_unless(test_client.rx_len == 0);
+  fail_unless(!test_client.closed);
+
+  LOCK_TCPIP_CORE();
+  httpd_cgi_continue(test_cgi_conn, "/index.html");
+  UNLOCK_TCPIP_CORE();
+  test_httpd_pump();
+  fail_unless(test_client.closed);
+  fail_unless(test_client.rx_len > sizeof(status) - 1);
+  fail_unless(!memcmp(test_client.rx, status, sizeof(status) - 1));
+
+  /* unknown files are answered with 404 */
+  test_httpd_close(&test_client);
+  test_httpd_connect(&test_client);
+  test_httpd_send(&test_client, test_cgi_request, (u16_t)(sizeof(test_cgi_request) - 1));
+  fail_unless(test_cgi_calls == 2);
+  LOCK_TCPIP_CORE();
+  httpd_cgi_continue(test_cgi_conn, "/nothere.html");
+  UNLOCK_TCPIP_CORE();
+  test_httpd_pump();
+  fail_unless(test_client.closed);
+  fail_unless(test_client.rx_len > 12);
+  fail_unless(!memcmp(test_client.rx, "HTTP/1.0 404", 12));
+}
+END_TEST
+
+/** httpd_cgi_continue() after the client has closed the connection is ignored */
+START_TEST(test_httpd_cgi_continue_closed)
+{
+  LWIP_UNUSED_ARG(_i);
+
+  test_hdr_uri = "/cgi?a=1";
+  test_httpd_connect(&test_client);
+  test_httpd_send(&test_client, test_cgi_request, (u16_t)(sizeof(test_cgi_request) - 1));
+  fail_unless(test_cgi_calls == 1);
+  test_httpd_close(&test_client);
+
+  LOCK_TCPIP_CORE();
+  httpd_cgi_continue(test_cgi_conn, "/index.html");
+  UNLOCK_TCPIP_CORE();
+  test_httpd_pump();
+  /* a new connection may get the same memory: it must not be confused */
+  test_httpd_connect(&test_client);
+  LOCK_TCPIP_CORE();
+  httpd_cgi_continue(test_cgi_conn, "/index.html");
+  UNLOCK_TCPIP_CORE();
+  test_httpd_pump();
+  fail_unless(test_client.rx_len == 0);
+  fail_unless(!test_client.closed);
+}
+END_TEST
+
+#if LWIP_HTTPD_WEBSOCKET
+
+/* Events reported to the WebSocket handler */
+static struct httpd_ws_conn *test_ws_conn[2];
+static int test_ws_connected;
+static char test_ws_msg[256];
+static u16_t test_ws_msg_len;
+static u8_t test_ws_opcode;
+static u8_t test_ws_flags[8];
+static int test_ws_recv_calls;
+static int test_ws_closed;
+static u16_t test_ws_close_status;
+
+static err_t
+test_ws_connected_fn(struct httpd_ws_conn *conn, const char *request_uri)
+{
+  fail_unless(strcmp(request_uri, "/ws?x=1") == 0);
+  fail_unless(test_ws_connected < 2);
+  test_ws_conn[test_ws_connected++] = conn;
+  return ERR_OK;
+}
+
+static void
+test_ws_recv_fn(struct httpd_ws_conn *conn, u8_t opcode, const u8_t *data, u16_t len, u8_t flags)
+{
+  LWIP_UNUSED_ARG(conn);
+  fail_unless(test_ws_msg_len + len <= sizeof(test_ws_msg));
+  MEMCPY(&test_ws_msg[test_ws_msg_len], data, len);
+  test_ws_msg_len = (u16_t)(test_ws_msg_len + len);
+  test_ws_opcode = opcode;
+  if (test_ws_recv_calls < (int)sizeof(test_ws_flags)) {
+    test_ws_flags[test_ws_recv_calls] = flags;
+  }
+  test_ws_recv_calls++;
+}
+
+static void
+test_ws_closed_fn(struct httpd_ws_conn *conn, u16_t status)
+{
+  LWIP_UNUSED_ARG(conn);
+  test_ws_closed++;
+  test_ws_close_status = status;
+}
+
+static const struct httpd_ws_handler test_ws_handlers[] = {
+  {"/ws", test_ws_connected_fn, test_ws_recv_fn, test_ws_closed_fn}
+};
+
+/* Handshake example of RFC 6455 section 1.3 */
+static const char test_ws_request[] =
+  "GET /ws?x=1 HTTP/1.1\r\n"
+  "Host: lwip.example\r\n"
+  "Upgrade: websocket\r\n"
+  "Connection: keep-alive, Upgrade\r\n"
+  "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+  "Sec-WebSocket-Version: 13\r\n"
+  "\r\n";
+static const char test_ws_response[] =
+  "HTTP/1.1 101 Switching Protocols\r\n"
+  "Upgrade: websocket\r\n"
+  "Connection: Upgrade\r\n"
+  "Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n"
+  "\r\n";
+/* Masked "Hello" of RFC 6455 section 5.7 */
+static const u8_t test_ws_hello[] = {0x81, 0x85, 0x37, 0xfa, 0x21, 0x3d, 0x7f, 0x9f, 0x4d, 0x51, 0x58};
+
+static void
+test_ws_reset_events(void)
+{
+  test_ws_msg_len = 0;
+  test_ws_recv_calls = 0;
+  test_ws_opcode = 0;
+  memset(test_ws_flags, 0, sizeof(test_ws_flags));
+}
+
+/** Build a masked client frame */
+static u16_t
+test_ws_frame(u8_t *buf, u8_t b0, const char *payload, u8_t len)
+{
+  static const u8_t mask[4] = {0x12, 0x34, 0x56, 0x78};
+  u8_t i;
+  buf[0] = b0;
+  buf[1] = (u8_t)(0x80 | len);
+  MEMCPY(&buf[2], mask, 4);
+  for (i = 0; i < len; i++) {
+    buf[6 + i] = (u8_t)(payload[i] ^ mask[i & 3]);
+  }
+  return (u16_t)(6 + len);
+}
+
+/** Connect and check the handshake response */
+static void
+test_ws_connect(struct test_httpd_client *c)
+{
+  test_httpd_connect(c);
+  test_httpd_send(c, test_ws_request, (u16_t)(sizeof(test_ws_request) - 1));
+  fail_unless(c->rx_len == sizeof(test_ws_response) - 1);
+  fail_unless(!memcmp(c->rx, test_ws_response, sizeof(test_ws_response) - 1));
+  fail_unless(!c->closed);
+  c->rx_len = 0;
+}
+
+static void
+ws_setup(void)
+{
+  httpd_setup();
+  httpd_ws_set_handlers(test_ws_handlers, LWIP_ARRAYSIZE(test_ws_handlers));
+  test_hdr_uri = "/ws?x=1";
+  memset(test_ws_conn, 0, sizeof(test_ws_conn));
+  test_ws_connected = 0;
+  test_ws_closed = 0;
+  test_ws_close_status = 0;
+  test_ws_reset_events();
+}
+
+/** Handshake and a masked message from RFC 6455 */
+START_TEST(test_httpd_ws_handshake)
+{
+  LWIP_UNUSED_ARG(_i);
+
+  test_ws_connect(&test_client);
+  fail_unless(test_ws_connected == 1);
+  fail_unless(test_hdr_host_len == 12);
+
+  test_httpd_send(&test_client, (const char *)test_ws_hello, sizeof(test_ws_hello));
+  fail_unless(test_ws_recv_calls == 1);
+  fail_unless(test_ws_msg_len == 5);
+  fail_unless(!memcmp(test_ws_msg, "Hello", 5));
+  fail_unless(test_ws_opcode == HTTPD_WS_OPCODE_TEXT);
+  fail_unless(test_ws_flags[0] == (HTTPD_WS_FLAG_FIRST | HTTPD_WS_FLAG_LAST));
+
+  /* the same frame again, one byte per segment */
+  {
+    u16_t i;
+    test_ws_reset_events();
+    for (i = 0; i < sizeof(test_ws_hello); i++) {
+      test_httpd_send(&test_client, (const char *)&test_ws_hello[i], 1);
+    }
+    fail_unless(test_ws_msg_len == 5);
+    fail_unless(!memcmp(test_ws_msg, "Hello", 5));
+  }
+  fail_unless(test_ws_closed == 0);
+}
+END_TEST
+
+/** Frames sent in the same segment as the upgrade request must not be lost */
+START_TEST(test_httpd_ws_frames_behind_request)
+{
+  char buf[sizeof(test_ws_request) - 1 + 2 * sizeof(test_ws_hello)];
+  u16_t len = (u16_t)(sizeof(test_ws_request) - 1);
+  LWIP_UNUSED_ARG(_i);
+
+  MEMCPY(buf, test_ws_request, len);
+  MEMCPY(&buf[len], test_ws_hello, sizeof(test_ws_hello));
+  len = (u16_t)(len + sizeof(test_ws_hello));
+  MEMCPY(&buf[len], test_ws_hello, sizeof(test_ws_hello));
+  len = (u16_t)(len + sizeof(test_ws_hello));
+
+  test_httpd_connect(&test_client);
+  test_httpd_send(&test_client, buf, len);
+  fail_unless(test_client.rx_len == sizeof(test_ws_response) - 1);
+  fail_unless(test_ws_connected == 1);
+  fail_unless(test_ws_recv_calls == 2);
+  fail_unless(test_ws_msg_len == 10);
+  fail_unless(!memcmp(test_ws_msg, "HelloHello", 10));
+}
+END_TEST
+
+/** A fragmented message is passed with FIRST/LAST flags and the message opcode,
+ * a ping in between is answered */
+START_TEST(test_httpd_ws_fragments)
+{
+  u8_t buf[64];
+  u16_t len;
+  static const u8_t pong[] = {0x8a, 0x02, 'p', 'i'};
+  LWIP_UNUSED_ARG(_i);
+
+  test_ws_connect(&test_client);
+
+  len = test_ws_frame(buf, HTTPD_WS_OPCODE_BINARY, "Hel", 3);
+  len = (u16_t)(len + test_ws_frame(&buf[len], 0x80 | HTTPD_WS_OPCODE_PING, "pi", 2));
+  len = (u16_t)(len + test_ws_frame(&buf[len], HTTPD_WS_OPCODE_CONTINUATION, "", 0));
+  len = (u16_t)(len + test_ws_frame(&buf[len], 0x80 | HTTPD_WS_OPCODE_CONTINUATION, "lo", 2));
+  test_httpd_send(&test_client, (const char *)buf, len);
+
+  fail_unless(test_ws_msg_len == 5);
+  fail_unless(!memcmp(test_ws_msg, "Hello", 5));
+  fail_unless(test_ws_opcode == HTTPD_WS_OPCODE_BINARY);
+  /* the empty continuation frame is not passed on */
+  fail_unless(test_ws_recv_calls == 2);
+  fail_unless(test_ws_flags[0] == HTTPD_WS_FLAG_FIRST);
+  fail_unless(test_ws_flags[1] == HTTPD_WS_FLAG_LAST);
+  fail_unless(test_client.rx_len == sizeof(pong));
+  fail_unless(!memcmp(test_client.rx, pong, sizeof(pong)));
+
+  /* a continuation without a message in progress is a protocol error */
+  test_client.rx_len = 0;
+  len = test_ws_frame(buf, 0x80 | HTTPD_WS_OPCODE_CONTINUATION, "x", 1);
+  test_httpd_send(&test_client, (const char *)buf, len);
+  fail_unless(test_client.rx_len == 4);
+  fail_unless(!memcmp(test_client.rx, "\x88\x02\x03\xea", 4));
+}
+END_TEST
+
+/** Unmasked client frames fail the connection */
+START_TEST(test_httpd_ws_unmasked)
+{
+  static const u8_t unmasked[] = {0x81, 0x02, 'h', 'i'};
+  LWIP_UNUSED_ARG(_i);
+
+  test_ws_connect(&test_client);
+  test_httpd_send(&test_client, (const char *)unmasked, sizeof(unmasked));
+  fail_unless(test_ws_recv_calls == 0);
+  /* close frame with status 1002, then the server closes the connection */
+  fail_unless(test_client.rx_len == 4);
+  fail_unless(!memcmp(test_client.rx, "\x88\x02\x03\xea", 4));
+  fail_unless(test_client.closed);
+  fail_unless(test_ws_closed == 1);
+  fail_unless(test_ws_close_status == HTTPD_WS_CLOSE_PROTOCOL_ERROR);
+}
+END_TEST
+
+/** Close handshake started by the client and by the server */
+START_TEST(test_httpd_ws_close)
+{
+  u8_t buf[16];
+  u16_t len;
+  err_t err;
+  LWIP_UNUSED_ARG(_i);
+
+  /* client closes: the status is echoed and the server closes TCP */
+  test_ws_connect(&test_client);
+  len = test_ws_frame(buf, 0x80 | HTTPD_WS_OPCODE_CLOSE, "\x03\xe8", 2);
+  test_httpd_send(&test_client, (const char *)buf, len);
+  fail_unless(test_client.rx_len == 4);
+  fail_unless(!memcmp(test_client.rx, "\x88\x02\x03\xe8", 4));
+  fail_unless(test_client.closed);
+  fail_unless(test_ws_closed == 1);
+  fail_unless(test_ws_close_status == HTTPD_WS_CLOSE_NORMAL);
+  test_httpd_close(&test_client);
+
+  /* server closes: nothing is sent after the close frame */
+  test_ws_connected = 0;
+  test_ws_connect(&test_client);
+  LOCK_TCPIP_CORE();
+  err = httpd_ws_close(test_ws_conn[0], HTTPD_WS_CLOSE_GOING_AWAY);
+  fail_unless(err == ERR_OK);
+  fail_unless(httpd_ws_send(test_ws_conn[0], HTTPD_WS_OPCODE_TEXT, "x", 1) == ERR_CLSD);
+  UNLOCK_TCPIP_CORE();
+  test_httpd_pump();
+  fail_unless(test_client.rx_len == 4);
+  fail_unless(!memcmp(test_client.rx, "\x88\x02\x03\xe9", 4));
+  fail_unless(!test_client.closed);
+  fail_unless(test_ws_closed == 1);
+  len = test_ws_frame(buf, 0x80 | HTTPD_WS_OPCODE_CLOSE, "\x03\xe9", 2);
+  test_httpd_send(&test_client, (const char *)buf, len);
+  fail_unless(test_client.closed);
+  fail_unless(test_ws_closed == 2);
+  fail_unless(test_ws_close_status == HTTPD_WS_CLOSE_GOING_AWAY);
+}
+END_TEST
+
+/** A broadcast frame is passed to TCP by reference, not copied per connection,
+ * and freed when both clients have acknowledged it */
+START_TEST(test_httpd_ws_broadcast)
+{
+  u16_t count;
+  mem_size_t pbufs;
+  static const u8_t frame[] = {0x81, 0x02, 'h', 'i'};
+  LWIP_UNUSED_ARG(_i);
+
+  test_ws_connect(&test_client);
+  test_ws_connect(&test_client2);
+  fail_unless(test_ws_connected == 2);
+
+  pbufs = MEMP_STATS_GET(used, MEMP_PBUF);
+  LOCK_TCPIP_CORE();
+  count = httpd_ws_broadcast(NULL, HTTPD_WS_OPCODE_TEXT, "hi", 2);
+  UNLOCK_TCPIP_CORE();
+  fail_unless(count == 2);
+  /* one PBUF_ROM per connection references the shared frame */
+  fail_unless(MEMP_STATS_GET(used, MEMP_PBUF) == pbufs + 2);
+
+  test_httpd_pump();
+  fail_unless(test_client.rx_len == sizeof(frame));
+  fail_unless(!memcmp(test_client.rx, frame, sizeof(frame)));
+  fail_unless(test_client2.rx_len == sizeof(frame));
+  fail_unless(!memcmp(test_client2.rx, frame, sizeof(frame)));
+  fail_unless(MEMP_STATS_GET(used, MEMP_PBUF) == pbufs);
+
+  /* a closed connection does not get broadcasts any more */
+  test_httpd_close(&test_client2);
+  fail_unless(test_ws_closed == 1);
+  test_client.rx_len = 0;
+  LOCK_TCPIP_CORE();
+  count = httpd_ws_broadcast(&test_ws_handlers[0], HTTPD_WS_OPCODE_TEXT, "hi", 2);
+  UNLOCK_TCPIP_CORE();
+  fail_unless(count == 1);
+  test_httpd_pump();
+  fail_unless(test_client.rx_len == sizeof(frame));
+}
+END_TEST
+
+#endif /* LWIP_HTTPD_WEBSOCKET */
+
+/** Create the suite including all tests for this module */
+Suite *
+httpd_suite(void)
+{
+  testfunc tests[] = {
+    TESTFUNC(test_httpd_request_split),
+    TESTFUNC(test_httpd_request_bytewise),
+    TESTFUNC(test_httpd_ssi_sync),
+    TESTFUNC(test_httpd_ssi_pending),
+    TESTFUNC(test_httpd_ssi_continue_in_handler),
+    TESTFUNC(test_httpd_ssi_continue_closed),
+    TESTFUNC(test_httpd_cgi_pending),
+    TESTFUNC(test_httpd_cgi_continue_closed)
+  };
+  return create_suite("HTTPD", tests, sizeof(tests)/sizeof(testfunc), httpd_setup, httpd_teardown);
+}
+
+/** Create the suite including all WebSocket tests */
+Suite *
+httpd_ws_suite(void)
+{
+#if LWIP_HTTPD_WEBSOCKET
+  testfunc tests[] = {
+    TESTFUNC(test_httpd_ws_handshake),
+    TESTFUNC(test_httpd_ws_frames_behind_request),
+    TESTFUNC(test_httpd_ws_fragments),
+    TESTFUNC(test_httpd_ws_unmasked),
+    TESTFUNC(test_httpd_ws_close),
+    TESTFUNC(test_httpd_ws_broadcast)
+  };
+  return create_suite("HTTPD_WS", tests, sizeof(tests)/sizeof(testfunc), ws_setup, httpd_teardown);
+#else /* LWIP_HTTPD_WEBSOCKET */
+  return create_suite("HTTPD_WS", NULL, 0, NULL, NULL);
+#endif /* LWIP_HTTPD_WEBSOCKET */
+}
@@ -1,5 +1,9 @@
 #include "lwip_check.h"
 
+#include "altcp_tls/test_altcp_tls.h"
+#include "altcp_tls/test_altcp_tls_mem.h"
+#include "bridgeif/test_bridgeif.h"
+#include "bridgeif/test_bridgeif_fdb.h"
 #include "ip4/test_ip4.h"
 #include "ip6/test_ip6.h"
 #include "udp/test_udp.h"
@@ -12,8 +16,15 @@
 #include "core/test_timers.h"
 #include "etharp/test_etharp.h"
 #include "dhcp/test_dhcp.h"
+#include "http/test_http_client.h"
+#include "http/test_httpd.h"
 #include "mdns/test_mdns.h"
 #include "mqtt/test_mqtt.h"
+#include "ppp/test_pppos.h"
+#include "slipif/test_slipif.h"
+#include "snmp/test_snmp.h"
+#include "snmp/test_snmpv3.h"
+#include "tftp/test_tftp.h"
 #include "api/test_sockets.h"
 
 #include "lwip/init.h"
@@ -73,9 +84,21 @@ int main(void)
     pbuf_suite,
     timers_suite,
     etharp_suite,
+    bridgeif_suite,
+    bridgeif_fdb_suite,
     dhcp_suite,
+    altcp_tls_suite,
+    altcp_tls_mem_suite,
+    http_client_suite,
+    httpd_suite,
+    httpd_ws_suite,
     mdns_suite,
     mqtt_suite,
+    pppos_suite,
+    slipif_suite,
+    snmp_suite,
+    snmpv3_suite,
+    tftp_suite,
     sockets_suite
   };
   size_t num = sizeof(suites)/sizeof(void*);
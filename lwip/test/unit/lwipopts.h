@@ -35,6 +35,8 @@
 #define LWIP_TESTMODE                   1
 
 #define LWIP_IPV6                       1
+/* Required on 64-bit hosts, asserted by ip6_reass_tmr() */
+#define IPV6_FRAG_COPYHEADER            1
 
 #define LWIP_CHECKSUM_ON_COPY           1
 #define TCP_CHECKSUM_ON_COPY_SANITY_CHECK 1
@@ -53,8 +55,52 @@
 /* Enable DHCP to test it, disable UDP checksum to easier inject packets */
 #define LWIP_DHCP                       1
 
+/* altcp_tls tests need mbedTLS and are built separately with
+ * TESTFLAGS=-DLWIP_UNITTESTS_ALTCP_TLS=1 (the apps use altcp then) */
+#if defined(LWIP_UNITTESTS_ALTCP_TLS) && LWIP_UNITTESTS_ALTCP_TLS
+#define LWIP_ALTCP                      1
+#define LWIP_ALTCP_TLS                  1
+#define LWIP_ALTCP_TLS_MBEDTLS          1
+#define ALTCP_MBEDTLS_USE_SESSION_CACHE 1
+#define ALTCP_MBEDTLS_USE_CLIENT_SESSION_CACHE 1
+#define ALTCP_MBEDTLS_TX_COALESCE_LEN   TCP_MSS
+/* TLS pcb and inner tcp pcb for the listener, server and client */
+#define MEMP_NUM_ALTCP_PCB              8
+/* with -DLWIP_UNITTESTS_ALTCP_TLS_MEM_POOLS=1 in addition, mbedTLS memory is
+ * taken from size-class pools (needs MBEDTLS_PLATFORM_MEMORY) */
+#if defined(LWIP_UNITTESTS_ALTCP_TLS_MEM_POOLS) && LWIP_UNITTESTS_ALTCP_TLS_MEM_POOLS
+#define ALTCP_MBEDTLS_MEM_POOLS         1
+#define ALTCP_MBEDTLS_PLATFORM_ALLOC_STATS 1
+/* handshakes of the server and the client at the same time */
+#define ALTCP_MBEDTLS_MEM_POOL_1K_NUM   24
+#define ALTCP_MBEDTLS_MEM_POOL_4K_NUM   8
+#define ALTCP_MBEDTLS_MEM_POOL_RECORD_NUM 6
+#endif
+#endif
+
+/* SNMPv3 tests need mbedTLS and are built separately with
+ * TESTFLAGS=-DLWIP_UNITTESTS_SNMPV3=1 */
+#if defined(LWIP_UNITTESTS_SNMPV3) && LWIP_UNITTESTS_SNMPV3
+#define LWIP_SNMP_V3                    1
+#endif
+
+/* bridgeif FDB tests run code while the FDB is locked (see test_bridgeif_fdb.c) */
+void test_bridgeif_fdb_locked(int write);
+#define BRIDGEIF_DECL_PROTECT(lev)
+#define BRIDGEIF_READ_PROTECT(lev)      test_bridgeif_fdb_locked(0)
+#define BRIDGEIF_READ_UNPROTECT(lev)
+#define BRIDGEIF_WRITE_PROTECT(lev)     test_bridgeif_fdb_locked(1)
+#define BRIDGEIF_WRITE_UNPROTECT(lev)
+/* bridgeif tests check forwarding through per-port TX queues */
+#define BRIDGEIF_TX_BATCH_LEN           4
+
 /* Minimal changes to opt.h required for tcp unit tests: */
+#if defined(LWIP_UNITTESTS_ALTCP_TLS) && LWIP_UNITTESTS_ALTCP_TLS
+/* two TLS connections with 16 KByte record buffers per direction */
+#define MEM_SIZE                        160000
+#else
 #define MEM_SIZE                        16000
+#endif
 #define TCP_SND_QUEUELEN                40
 #define MEMP_NUM_TCP_SEG                TCP_SND_QUEUELEN
 #define TCP_SND_BUF                     (12 * TCP_MSS)
@@ -66,7 +112,9 @@
 /* Enable IGMP and MDNS for MDNS tests */
 #define LWIP_IGMP                       1
 #define LWIP_MDNS_RESPONDER             1
-#define LWIP_NUM_NETIF_CLIENT_DATA      (LWIP_MDNS_RESPONDER)
+#define LWIP_NUM_NETIF_CLIENT_DATA      (LWIP_MDNS_RESPONDER + 1) /* + bridgeif */
+#define MDNS_DOMAIN_CACHE               1
+#define LWIP_MDNS_QUERIER               1
 
 /* Minimal changes to opt.h required for etharp unit tests: */
 #define ETHARP_SUPPORT_STATIC_ENTRIES   1
@@ -76,6 +124,37 @@
 /* MIB2 stats are required to check IPv4 reassembly results */
 #define MIB2_STATS                      1
 
+/* Enable SNMP with MIB2 table indices for SNMP tests */
+#define LWIP_SNMP                       1
+#define SNMP_LWIP_MIB2_TABLE_INDEX_SIZE 8
+#define SNMP_LWIP_MIB_INDEX_SIZE        256
+
+/* Enable PPPoS with multilink for PPP tests: two bundles of three links */
+#define PPP_SUPPORT                     1
+#define PPPOS_SUPPORT                   1
+#define PPP_SERVER                      1
+#define PPP_MULTILINK_SUPPORT           1
+#define MEMP_NUM_PPP_PCB                6
+/* slice-by-8 FCS, checked against a bitwise FCS */
+#define PPP_FCS_TABLE                   2
+
+/* slipif tests pass the serial line to the RX decoder, see test_slipif.c */
+#define SLIP_RX_FROM_ISR                1
+#define SLIP_USE_RX_THREAD              0
+
+/* httpd tests feed requests to the streaming parser over the loopback netif */
+#define LWIP_HTTPD_STREAMING_PARSER     1
+#define LWIP_HTTPD_HEADER_CALLBACK      1
+#define LWIP_HTTPD_WEBSOCKET            1
+/* ... with deferred SSI inserts and CGI responses on a custom file */
+#define LWIP_HTTPD_SSI                  1
+#define LWIP_HTTPD_SSI_ASYNC            1
+#define LWIP_HTTPD_CGI                  1
+#define LWIP_HTTPD_CGI_ASYNC            1
+#define LWIP_HTTPD_CUSTOM_FILES         1
+/* http client tests talk to a fake server over the loopback netif */
+#define LWIP_HTTPC_KEEPALIVE            1
+
 /* netif tests want to test this, so enable: */
 #define LWIP_NETIF_EXT_STATUS_CALLBACK  1
 
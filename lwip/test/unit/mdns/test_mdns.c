@@ -33,9 +33,15 @@
 #include "test_mdns.h"
 
 #include "lwip/pbuf.h"
+#include "lwip/netif.h"
+#include "lwip/udp.h"
 #include "lwip/apps/mdns.h"
 #include "lwip/apps/mdns_domain.h"
 #include "lwip/apps/mdns_priv.h"
+#include "lwip/prot/dns.h"
+#include "arch/sys_arch.h"
+
+#include <string.h>
 
 START_TEST(readname_basic)
 {
@@ -876,6 +882,287 @@ START_TEST(compress_long_match)
 }
 END_TEST
 
+START_TEST(domain_cache_rename)
+{
+  static struct mdns_host host;
+  static struct mdns_service service;
+  struct mdns_domain buf, expected;
+  struct mdns_domain *domain;
+  err_t res;
+  LWIP_UNUSED_ARG(_i);
+
+  memset(&host, 0, sizeof(host));
+  strcpy(host.name, "hostname");
+  domain = mdns_host_domain(&host, &buf);
+  fail_if(domain == NULL);
+  res = mdns_build_host_domain(&expected, &host);
+  fail_unless(res == ERR_OK);
+  fail_unless(mdns_domain_eq(domain, &expected));
+
+  strcpy(host.name, "other");
+  mdns_host_domain_changed(&host);
+  domain = mdns_host_domain(&host, &buf);
+  fail_if(domain == NULL);
+  res = mdns_build_host_domain(&expected, &host);
+  fail_unless(res == ERR_OK);
+  fail_unless(mdns_domain_eq(domain, &expected));
+
+  memset(&service, 0, sizeof(service));
+  strcpy(service.name, "myweb");
+  strcpy(service.service, "_http");
+  service.proto = DNSSD_PROTO_TCP;
+  domain = mdns_service_domain(&service, 1, &buf);
+  fail_if(domain == NULL);
+  res = mdns_build_service_domain(&expected, &service, 1);
+  fail_unless(res == ERR_OK);
+  fail_unless(mdns_domain_eq(domain, &expected));
+
+  strcpy(service.name, "myweb (2)");
+  mdns_service_domain_changed(&service);
+  domain = mdns_service_domain(&service, 1, &buf);
+  fail_if(domain == NULL);
+  res = mdns_build_service_domain(&expected, &service, 1);
+  fail_unless(res == ERR_OK);
+  fail_unless(mdns_domain_eq(domain, &expected));
+  domain = mdns_service_domain(&service, 0, &buf);
+  fail_if(domain == NULL);
+  res = mdns_build_service_domain(&expected, &service, 0);
+  fail_unless(res == ERR_OK);
+  fail_unless(mdns_domain_eq(domain, &expected));
+}
+END_TEST
+
+#if LWIP_IPV4
+START_TEST(domain_cache_reverse_v4)
+{
+  static struct mdns_host host;
+  struct mdns_domain buf, expected;
+  struct mdns_domain *domain;
+  ip4_addr_t addr;
+  err_t res;
+  LWIP_UNUSED_ARG(_i);
+
+  memset(&host, 0, sizeof(host));
+  IP4_ADDR(&addr, 192, 168, 1, 10);
+  domain = mdns_reverse_v4_domain(&host, &addr, &buf);
+  fail_if(domain == NULL);
+  res = mdns_build_reverse_v4_domain(&expected, &addr);
+  fail_unless(res == ERR_OK);
+  fail_unless(mdns_domain_eq(domain, &expected));
+
+  /* address change is detected without invalidation */
+  IP4_ADDR(&addr, 10, 0, 0, 1);
+  domain = mdns_reverse_v4_domain(&host, &addr, &buf);
+  fail_if(domain == NULL);
+  res = mdns_build_reverse_v4_domain(&expected, &addr);
+  fail_unless(res == ERR_OK);
+  fail_unless(mdns_domain_eq(domain, &expected));
+}
+END_TEST
+#endif
+
+#if LWIP_MDNS_QUERIER && LWIP_IPV4
+static void
+cache_answer(struct netif *netif, struct mdns_domain *name, u16_t type, u16_t cache_flush,
+             u32_t ttl, const u8_t *rdata, u16_t rdata_len)
+{
+  struct pbuf *p = pbuf_alloc(PBUF_RAW, rdata_len, PBUF_RAM);
+  fail_if(p == NULL);
+  pbuf_take(p, rdata, rdata_len);
+  mdns_query_cache_answer(netif, name, type, cache_flush, ttl, p, 0, rdata_len);
+  pbuf_free(p);
+}
+
+START_TEST(query_cache_ttl_flush)
+{
+  static const u8_t rdata_a1[] = { 192, 168, 1, 5 };
+  static const u8_t rdata_a2[] = { 192, 168, 1, 6 };
+  static const u8_t rdata_srv[] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x50,
+                                    0x07, 'p', 'r', 'i', 'n', 't', 'e', 'r',
+                                    0x05, 'l', 'o', 'c', 'a', 'l', 0x00 };
+  struct netif netif;
+  struct mdns_domain host, instance;
+  ip_addr_t addr;
+  ip4_addr_t expected;
+  char hostname[20];
+  u16_t port;
+  err_t res;
+  LWIP_UNUSED_ARG(_i);
+
+  memset(&netif, 0, sizeof(netif));
+  lwip_sys_now = 1000;
+  res = mdns_build_name_domain(&host, "printer.local.", 14);
+  fail_unless(res == ERR_OK);
+  res = mdns_build_named_service_domain(&instance, "myprinter", "_ipp", DNSSD_PROTO_TCP);
+  fail_unless(res == ERR_OK);
+
+  res = mdns_query_lookup("printer.local", 13, &addr, 0);
+  fail_unless(res == ERR_ARG);
+
+  cache_answer(&netif, &host, DNS_RRTYPE_A, 1, 120, rdata_a1, sizeof(rdata_a1));
+  res = mdns_query_lookup("printer.local", 13, &addr, 0);
+  fail_unless(res == ERR_OK);
+  IP4_ADDR(&expected, 192, 168, 1, 5);
+  fail_unless(ip4_addr_cmp(ip_2_ip4(&addr), &expected));
+  res = mdns_query_lookup("PRINTER.local", 13, &addr, 0);
+  fail_unless(res == ERR_OK);
+  res = mdns_query_lookup("other.local", 11, &addr, 0);
+  fail_unless(res == ERR_ARG);
+
+  /* new address with cache-flush bit: old one is dropped one second later */
+  lwip_sys_now += 5000;
+  cache_answer(&netif, &host, DNS_RRTYPE_A, 1, 120, rdata_a2, sizeof(rdata_a2));
+  lwip_sys_now += 1001;
+  res = mdns_query_lookup("printer.local", 13, &addr, 0);
+  fail_unless(res == ERR_OK);
+  IP4_ADDR(&expected, 192, 168, 1, 6);
+  fail_unless(ip4_addr_cmp(ip_2_ip4(&addr), &expected));
+
+  /* goodbye record */
+  cache_answer(&netif, &host, DNS_RRTYPE_A, 1, 0, rdata_a2, sizeof(rdata_a2));
+  res = mdns_query_lookup("printer.local", 13, &addr, 0);
+  fail_unless(res == ERR_OK);
+  lwip_sys_now += 1001;
+  res = mdns_query_lookup("printer.local", 13, &addr, 0);
+  fail_unless(res == ERR_ARG);
+
+  /* TTL expiry */
+  cache_answer(&netif, &host, DNS_RRTYPE_A, 0, 2, rdata_a1, sizeof(rdata_a1));
+  lwip_sys_now += 1999;
+  res = mdns_query_lookup("printer.local", 13, &addr, 0);
+  fail_unless(res == ERR_OK);
+  lwip_sys_now += 1;
+  res = mdns_query_lookup("printer.local", 13, &addr, 0);
+  fail_unless(res == ERR_ARG);
+
+  /* service instance */
+  cache_answer(&netif, &instance, DNS_RRTYPE_SRV, 1, 120, rdata_srv, sizeof(rdata_srv));
+  res = mdns_query_lookup_service(&netif, "myprinter", "_ipp", DNSSD_PROTO_TCP, hostname, sizeof(hostname), &port);
+  fail_unless(res == ERR_OK);
+  fail_unless(strcmp(hostname, "printer.local") == 0);
+  fail_unless(port == 80);
+  res = mdns_query_lookup_service(&netif, "myprinter", "_ipp", DNSSD_PROTO_TCP, hostname, 13, &port);
+  fail_unless(res == ERR_MEM);
+  res = mdns_query_lookup_service(&netif, "myprinter", "_http", DNSSD_PROTO_TCP, hostname, sizeof(hostname), &port);
+  fail_unless(res == ERR_ARG);
+
+  cache_answer(&netif, &instance, DNS_RRTYPE_SRV, 1, 0, rdata_srv, sizeof(rdata_srv));
+  lwip_sys_now += 1001;
+  res = mdns_query_lookup_service(&netif, "myprinter", "_ipp", DNSSD_PROTO_TCP, hostname, sizeof(hostname), &port);
+  fail_unless(res == ERR_ARG);
+}
+END_TEST
+
+static u8_t query_tx_buf[256];
+static u16_t query_tx_len;
+static int query_tx_count;
+
+static err_t
+query_netif_output(struct netif *netif, struct pbuf *p, const ip4_addr_t *ipaddr)
+{
+  ip4_addr_t group;
+  LWIP_UNUSED_ARG(netif);
+
+  IP4_ADDR(&group, 224, 0, 0, 251);
+  if (ip4_addr_cmp(ipaddr, &group)) {
+    query_tx_count++;
+    query_tx_len = pbuf_copy_partial(p, query_tx_buf, sizeof(query_tx_buf), 0);
+  }
+  return ERR_OK;
+}
+
+#if LWIP_IPV6
+static err_t
+query_netif_output_ip6(struct netif *netif, struct pbuf *p, const ip6_addr_t *ipaddr)
+{
+  LWIP_UNUSED_ARG(netif);
+  LWIP_UNUSED_ARG(p);
+  LWIP_UNUSED_ARG(ipaddr);
+  return ERR_OK;
+}
+#endif
+
+static err_t
+query_netif_init(struct netif *netif)
+{
+  netif->output = query_netif_output;
+#if LWIP_IPV6
+  netif->output_ip6 = query_netif_output_ip6;
+#endif
+  netif->mtu = 1500;
+  netif->flags = NETIF_FLAG_LINK_UP | NETIF_FLAG_IGMP;
+  return ERR_OK;
+}
+
+START_TEST(query_host_lookup)
+{
+  /* DNS header with two questions: printer.local. A IN, (compressed) AAAA IN */
+  static const u8_t question[] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00,
+                                   0x00, 0x00, 0x00, 0x00,
+                                   0x07, 'p', 'r', 'i', 'n', 't', 'e', 'r',
+                                   0x05, 'l', 'o', 'c', 'a', 'l', 0x00,
+                                   0x00, 0x01, 0x00, 0x01,
+                                   0xc0, 0x0c, 0x00, 0x1c, 0x00, 0x01 };
+  static const u8_t rdata_a[] = { 192, 168, 1, 5 };
+  struct netif netif;
+  ip4_addr_t ipaddr, netmask, gw;
+  struct mdns_domain host;
+  ip_addr_t addr;
+  err_t res;
+  LWIP_UNUSED_ARG(_i);
+
+  /* mdns_resp_init() allocates a netif client data id, so this test can only
+   * run once per process. Its pcb is removed at the end to leave no allocations
+   * behind for the following suites. */
+  mdns_resp_init();
+  memset(&netif, 0, sizeof(netif));
+  IP4_ADDR(&ipaddr, 192, 168, 1, 2);
+  IP4_ADDR(&netmask, 255, 255, 255, 0);
+  IP4_ADDR(&gw, 192, 168, 1, 1);
+  netif_add(&netif, &ipaddr, &netmask, &gw, NULL, query_netif_init, NULL);
+  netif_set_up(&netif);
+  res = mdns_resp_add_netif(&netif, "lwip");
+  fail_unless(res == ERR_OK);
+  query_tx_count = 0;
+  lwip_sys_now = 100000;
+
+  /* cache miss: one A/AAAA query is multicast (IPv4 first), repeated lookups are rate limited */
+  res = mdns_query_lookup("printer.local", 13, &addr, 0);
+  fail_unless(res == ERR_INPROGRESS);
+  fail_unless(query_tx_count == 1);
+  fail_unless(query_tx_len == 20 + 8 + sizeof(question));
+  fail_unless(memcmp(&query_tx_buf[20 + 8 + 2], &question[2], sizeof(question) - 2) == 0);
+  res = mdns_query_lookup("printer.local", 13, &addr, 0);
+  fail_unless(res == ERR_INPROGRESS);
+  fail_unless(query_tx_count == 1);
+  lwip_sys_now += 1000;
+  res = mdns_query_lookup("printer.local", 13, &addr, 0);
+  fail_unless(res == ERR_INPROGRESS);
+  fail_unless(query_tx_count == 2);
+
+  /* names outside .local are not queried */
+  res = mdns_query_lookup("www.example.com", 15, &addr, 0);
+  fail_unless(res == ERR_ARG);
+  fail_unless(query_tx_count == 2);
+
+  /* the answer is cached, the next lookup resolves without a query */
+  res = mdns_build_name_domain(&host, "printer.local", 13);
+  fail_unless(res == ERR_OK);
+  cache_answer(&netif, &host, DNS_RRTYPE_A, 1, 120, rdata_a, sizeof(rdata_a));
+  res = mdns_query_lookup("printer.local", 13, &addr, 0);
+  fail_unless(res == ERR_OK);
+  fail_unless(ip4_addr_get_u32(ip_2_ip4(&addr)) == PP_HTONL(LWIP_MAKEU32(192, 168, 1, 5)));
+  fail_unless(query_tx_count == 2);
+
+  cache_answer(&netif, &host, DNS_RRTYPE_A, 1, 0, rdata_a, sizeof(rdata_a));
+  lwip_sys_now += 1001;
+  mdns_resp_remove_netif(&netif);
+  netif_remove(&netif);
+  udp_remove(get_mdns_pcb());
+}
+END_TEST
+#endif /* LWIP_MDNS_QUERIER && LWIP_IPV4 */
+
 Suite* mdns_suite(void)
 {
   testfunc tests[] = {
@@ -911,6 +1198,15 @@ Suite* mdns_suite(void)
     TESTFUNC(compress_2nd_label_short),
     TESTFUNC(compress_jump_to_jump),
     TESTFUNC(compress_long_match),
+
+    TESTFUNC(domain_cache_rename),
+#if LWIP_IPV4
+    TESTFUNC(domain_cache_reverse_v4),
+#endif
+#if LWIP_MDNS_QUERIER && LWIP_IPV4
+    TESTFUNC(query_cache_ttl_flush),
+    TESTFUNC(query_host_lookup),
+#endif
   };
   return create_suite("MDNS", tests, sizeof(tests)/sizeof(testfunc), NULL, NULL);
 }
@@ -5,6 +5,9 @@
 #include "lwip/apps/mqtt_priv.h"
 #include "lwip/netif.h"
 
+/* The tests call the callbacks of the client's tcp pcb directly */
+#if !LWIP_ALTCP
+
 const ip_addr_t test_mqtt_local_ip = IPADDR4_INIT_BYTES(192, 168, 1, 1);
 const ip_addr_t test_mqtt_remote_ip = IPADDR4_INIT_BYTES(192, 168, 1, 2);
 const ip_addr_t test_mqtt_netmask = IPADDR4_INIT_BYTES(255, 255, 255, 0);
@@ -106,10 +109,530 @@ START_TEST(basic_connect)
 }
 END_TEST
 
+START_TEST(publish_large_payload)
+{
+  mqtt_client_t* client;
+  struct netif netif;
+  err_t err;
+  struct mqtt_connect_client_info_t client_info = {
+    "dumm",
+    NULL, NULL,
+    10,
+    NULL, NULL, 0, 0
+  };
+  struct pbuf *p;
+  unsigned char rxbuf[] = {0x20, 0x02, 0x00, 0x00};
+  static u8_t payload[MQTT_OUTPUT_RINGBUF_SIZE * 2];
+  LWIP_UNUSED_ARG(_i);
+
+  test_mqtt_init_netif(&netif, &test_mqtt_local_ip, &test_mqtt_netmask);
+
+  client = mqtt_client_new();
+  fail_unless(client != NULL);
+  err = mqtt_client_connect(client, &test_mqtt_remote_ip, 1234, test_mqtt_connection_cb, NULL, &client_info);
+  fail_unless(err == ERR_OK);
+
+  client->conn->connected(client->conn->callback_arg, client->conn, ERR_OK);
+  p = pbuf_alloc(PBUF_RAW, sizeof(rxbuf), PBUF_REF);
+  fail_unless(p != NULL);
+  p->payload = rxbuf;
+  client->conn->rcv_wnd -= p->tot_len;
+  if (client->conn->recv(client->conn->callback_arg, client->conn, p, ERR_OK) != ERR_OK) {
+    pbuf_free(p);
+  }
+  fail_unless(mqtt_client_is_connected(client));
+
+  /* payload larger than the output ring buffer is copied into a pbuf */
+  memset(payload, 'x', sizeof(payload));
+  err = mqtt_publish(client, "topic", payload, sizeof(payload), 0, 0, NULL, NULL);
+  fail_unless(err == ERR_OK);
+  fail_unless(client->out_pbuf_len == 1);
+
+  /* pbuf payload is sent by reference and kept until acknowledged */
+  p = pbuf_alloc(PBUF_RAW, sizeof(payload), PBUF_RAM);
+  fail_unless(p != NULL);
+  err = mqtt_publish_pbuf(client, "topic", p, 1, 0, NULL, NULL);
+  fail_unless(err == ERR_OK);
+  fail_unless(client->out_pbuf_len == 2);
+  fail_unless(p->ref == 2);
+
+  /* acknowledging all written data releases the payloads */
+  client->conn->sent(client->conn->callback_arg, client->conn, (u16_t)client->tx_written);
+  fail_unless(client->out_pbuf_len == 0);
+  fail_unless(p->ref == 1);
+
+  mqtt_disconnect(client);
+  pbuf_free(p);
+  mem_free(client);
+}
+END_TEST
+
+START_TEST(close_referenced_payload)
+{
+  mqtt_client_t* client;
+  struct netif netif;
+  err_t err;
+  struct mqtt_connect_client_info_t client_info = {
+    "dumm",
+    NULL, NULL,
+    10,
+    NULL, NULL, 0, 0
+  };
+  struct pbuf *p;
+  struct tcp_pcb *pcb;
+  unsigned char rxbuf[] = {0x20, 0x02, 0x00, 0x00};
+  LWIP_UNUSED_ARG(_i);
+
+  test_mqtt_init_netif(&netif, &test_mqtt_local_ip, &test_mqtt_netmask);
+
+  client = mqtt_client_new();
+  fail_unless(client != NULL);
+  err = mqtt_client_connect(client, &test_mqtt_remote_ip, 1234, test_mqtt_connection_cb, NULL, &client_info);
+  fail_unless(err == ERR_OK);
+
+  pcb = client->conn;
+  pcb->state = ESTABLISHED;
+  pcb->connected(pcb->callback_arg, pcb, ERR_OK);
+  p = pbuf_alloc(PBUF_RAW, sizeof(rxbuf), PBUF_REF);
+  fail_unless(p != NULL);
+  p->payload = rxbuf;
+  pcb->rcv_wnd -= p->tot_len;
+  if (pcb->recv(pcb->callback_arg, pcb, p, ERR_OK) != ERR_OK) {
+    pbuf_free(p);
+  }
+  fail_unless(mqtt_client_is_connected(client));
+
+  p = pbuf_alloc(PBUF_RAW, 100, PBUF_RAM);
+  fail_unless(p != NULL);
+  err = mqtt_publish_pbuf(client, "topic", p, 0, 0, NULL, NULL);
+  fail_unless(err == ERR_OK);
+  fail_unless(client->out_pbuf_unacked == 1);
+  fail_unless(p->ref == 2);
+
+  /* disconnecting shuts the connection down gracefully and keeps the payload */
+  mqtt_disconnect(client);
+  fail_unless(client->conn == NULL);
+  fail_unless(client->closing_conn == pcb);
+  fail_unless(pcb->state == FIN_WAIT_1);
+  fail_unless(p->ref == 2);
+
+  /* acknowledging the payload releases it and closes the connection */
+  pcb->sent(pcb->callback_arg, pcb, (u16_t)client->tx_written);
+  fail_unless(client->closing_conn == NULL);
+  fail_unless(p->ref == 1);
+
+  /* the FIN is not acknowledged in this test */
+  tcp_abort(pcb);
+  pbuf_free(p);
+  mqtt_client_free(client);
+}
+END_TEST
+
+static void
+test_mqtt_recv(mqtt_client_t *client, u8_t *data, u16_t len)
+{
+  struct pbuf *p = pbuf_alloc(PBUF_RAW, len, PBUF_REF);
+  fail_unless(p != NULL);
+  p->payload = data;
+  client->conn->rcv_wnd -= p->tot_len;
+  if (client->conn->recv(client->conn->callback_arg, client->conn, p, ERR_OK) != ERR_OK) {
+    pbuf_free(p);
+  }
+}
+
+START_TEST(session_resume)
+{
+  mqtt_client_t* client;
+  struct netif netif;
+  err_t err;
+  int i;
+  struct mqtt_connect_client_info_t client_info = {
+    "dumm",
+    NULL, NULL,
+    10,
+    NULL, NULL, 0, 0
+  };
+  u8_t connack[] = {0x20, 0x02, 0x00, 0x00};
+  u8_t connack_session[] = {0x20, 0x02, 0x01, 0x00};
+  u8_t puback[] = {0x40, 0x02, 0x00, 0x01};
+  LWIP_UNUSED_ARG(_i);
+
+  test_mqtt_init_netif(&netif, &test_mqtt_local_ip, &test_mqtt_netmask);
+
+  client = mqtt_client_new();
+  fail_unless(client != NULL);
+  err = mqtt_client_set_session(client, 8, 1);
+  fail_unless(err == ERR_OK);
+  err = mqtt_client_connect(client, &test_mqtt_remote_ip, 1234, test_mqtt_connection_cb, NULL, &client_info);
+  fail_unless(err == ERR_OK);
+  client->conn->connected(client->conn->callback_arg, client->conn, ERR_OK);
+  test_mqtt_recv(client, connack, sizeof(connack));
+  fail_unless(mqtt_client_is_connected(client));
+
+  /* more QoS 1 publishes in flight than the default window */
+  for (i = 0; i < 6; i++) {
+    err = mqtt_publish(client, "topic", "data", 4, 1, 0, NULL, NULL);
+    fail_unless(err == ERR_OK);
+    /* data acknowledged by TCP, packets are kept until PUBACK */
+    client->conn->sent(client->conn->callback_arg, client->conn, (u16_t)(client->tx_written - client->tx_acked));
+  }
+  fail_unless(client->out_pbuf_len == 0);
+  test_mqtt_recv(client, puback, sizeof(puback));
+
+  /* session state is kept across connections */
+  mqtt_disconnect(client);
+  fail_unless(client->pend_req_queue != NULL);
+  err = mqtt_client_connect(client, &test_mqtt_remote_ip, 1234, test_mqtt_connection_cb, NULL, &client_info);
+  fail_unless(err == ERR_OK);
+  client->conn->connected(client->conn->callback_arg, client->conn, ERR_OK);
+  test_mqtt_recv(client, connack_session, sizeof(connack_session));
+  fail_unless(mqtt_client_is_connected(client));
+
+  /* unacknowledged publishes are resent as far as the output queue allows */
+  fail_unless(client->out_pbuf_len == MQTT_OUTPUT_PBUF_QUEUE_LEN);
+  fail_unless(client->session_resume != 0);
+  client->conn->sent(client->conn->callback_arg, client->conn, (u16_t)(client->tx_written - client->tx_acked));
+  fail_unless(client->out_pbuf_len == 5 - MQTT_OUTPUT_PBUF_QUEUE_LEN);
+  fail_unless(client->session_resume == 0);
+
+  mqtt_disconnect(client);
+  mqtt_client_free(client);
+}
+END_TEST
+
+#if LWIP_MQTT_V5
+#define STREAM_PROPS_LEN 3
+#else
+#define STREAM_PROPS_LEN 0
+#endif
+
+static char stream_topic[300];
+static u16_t stream_topic_len;
+static u8_t stream_data[400];
+static u16_t stream_data_len;
+static u32_t stream_tot_len;
+static int stream_done;
+
+static void
+test_mqtt_topic_cb(void *arg, const u8_t *topic, u16_t len, u32_t tot_len, u8_t flags)
+{
+  LWIP_UNUSED_ARG(arg);
+  LWIP_UNUSED_ARG(flags);
+  fail_unless(stream_topic_len + len <= sizeof(stream_topic));
+  memcpy(&stream_topic[stream_topic_len], topic, len);
+  stream_topic_len = (u16_t)(stream_topic_len + len);
+  stream_tot_len = tot_len;
+}
+
+static void
+test_mqtt_pbuf_cb(void *arg, struct pbuf *p, u8_t flags)
+{
+  LWIP_UNUSED_ARG(arg);
+  fail_unless(stream_data_len + p->tot_len <= sizeof(stream_data));
+  pbuf_copy_partial(p, &stream_data[stream_data_len], p->tot_len, 0);
+  stream_data_len = (u16_t)(stream_data_len + p->tot_len);
+  if (flags & MQTT_DATA_FLAG_LAST) {
+    stream_done++;
+  }
+  pbuf_free(p);
+}
+
+START_TEST(stream_publish)
+{
+  mqtt_client_t* client;
+  struct netif netif;
+  err_t err;
+  u16_t i, len, split;
+  struct mqtt_connect_client_info_t client_info = {
+    "dumm",
+    NULL, NULL,
+    10,
+    NULL, NULL, 0, 0
+  };
+  u8_t connack[] = {0x20, 0x02, 0x00, 0x00};
+  /* QoS 1 publish with topic and payload longer than the receive buffer, followed by PINGRESP */
+  static u8_t msg[3 + 2 + 200 + 2 + STREAM_PROPS_LEN + 300 + 2];
+  u16_t payload_idx;
+  LWIP_UNUSED_ARG(_i);
+
+  len = 0;
+  msg[len++] = 0x32;
+  msg[len++] = (u8_t)(((2 + 200 + 2 + STREAM_PROPS_LEN + 300) & 0x7f) | 0x80);
+  msg[len++] = (u8_t)((2 + 200 + 2 + STREAM_PROPS_LEN + 300) >> 7);
+  msg[len++] = 0;
+  msg[len++] = 200;
+  for (i = 0; i < 200; i++) {
+    msg[len++] = (u8_t)('a' + (i % 26));
+  }
+  msg[len++] = 0x12;
+  msg[len++] = 0x34;
+#if LWIP_MQTT_V5
+  /* payload format indicator */
+  msg[len++] = STREAM_PROPS_LEN - 1;
+  msg[len++] = 0x01;
+  msg[len++] = 0x01;
+#endif
+  payload_idx = len;
+  for (i = 0; i < 300; i++) {
+    msg[len++] = (u8_t)i;
+  }
+  msg[len++] = 0xd0;
+  msg[len++] = 0x00;
+
+  test_mqtt_init_netif(&netif, &test_mqtt_local_ip, &test_mqtt_netmask);
+
+  client = mqtt_client_new();
+  fail_unless(client != NULL);
+  err = mqtt_client_connect(client, &test_mqtt_remote_ip, 1234, test_mqtt_connection_cb, NULL, &client_info);
+  fail_unless(err == ERR_OK);
+  client->conn->connected(client->conn->callback_arg, client->conn, ERR_OK);
+  test_mqtt_recv(client, connack, sizeof(connack));
+  mqtt_set_inpub_stream_callback(client, test_mqtt_topic_cb, test_mqtt_pbuf_cb, NULL);
+
+  /* feed the message split at every position, in two segments and as a pbuf chain */
+  for (split = 1; split < 2 * len; split++) {
+    stream_topic_len = 0;
+    stream_data_len = 0;
+    stream_done = 0;
+    if (split < len) {
+      test_mqtt_recv(client, msg, split);
+      test_mqtt_recv(client, &msg[split], (u16_t)(len - split));
+    } else {
+      struct pbuf *p1 = pbuf_alloc(PBUF_RAW, (u16_t)(split - len + 1), PBUF_REF);
+      struct pbuf *p2 = pbuf_alloc(PBUF_RAW, (u16_t)(2 * len - split - 1), PBUF_REF);
+      fail_unless((p1 != NULL) && (p2 != NULL));
+      p1->payload = msg;
+      p2->payload = &msg[split - len + 1];
+      pbuf_cat(p1, p2);
+      client->conn->rcv_wnd -= p1->tot_len;
+      if (client->conn->recv(client->conn->callback_arg, client->conn, p1, ERR_OK) != ERR_OK) {
+        pbuf_free(p1);
+      }
+    }
+    fail_unless(mqtt_client_is_connected(client));
+    fail_unless(stream_done == 1);
+    fail_unless(stream_topic_len == 200);
+    fail_unless(memcmp(stream_topic, &msg[5], 200) == 0);
+    fail_unless(stream_tot_len == 300);
+    fail_unless(stream_data_len == 300);
+    fail_unless(memcmp(stream_data, &msg[payload_idx], 300) == 0);
+    fail_unless(client->inpub_pkt_id == 0x1234);
+    fail_unless(client->msg_idx == 0);
+  }
+
+  mqtt_disconnect(client);
+  mqtt_client_free(client);
+}
+END_TEST
+
+#if LWIP_MQTT_V5
+static char v5_topic[32];
+static int v5_msgs;
+static err_t v5_pub_err;
+static int v5_pub_done;
+
+static void
+test_mqtt_v5_pub_cb(void *arg, const char *topic, u32_t tot_len)
+{
+  LWIP_UNUSED_ARG(arg);
+  LWIP_UNUSED_ARG(tot_len);
+  fail_unless(strlen(topic) < sizeof(v5_topic));
+  strcpy(v5_topic, topic);
+  v5_msgs++;
+}
+
+static void
+test_mqtt_v5_data_cb(void *arg, const u8_t *data, u16_t len, u8_t flags)
+{
+  LWIP_UNUSED_ARG(arg);
+  LWIP_UNUSED_ARG(data);
+  LWIP_UNUSED_ARG(len);
+  LWIP_UNUSED_ARG(flags);
+}
+
+static void
+test_mqtt_v5_request_cb(void *arg, err_t err)
+{
+  LWIP_UNUSED_ARG(arg);
+  v5_pub_err = err;
+  v5_pub_done++;
+}
+
+START_TEST(v5_topic_alias)
+{
+  mqtt_client_t* client;
+  struct netif netif;
+  err_t err;
+  u32_t written, first_len;
+  struct mqtt_connect_client_info_t client_info = {
+    "dumm",
+    NULL, NULL,
+    10,
+    NULL, NULL, 0, 0
+  };
+  /* receive maximum 2, topic alias maximum 4 */
+  u8_t connack[] = {0x20, 0x09, 0x00, 0x00, 0x06, 0x21, 0x00, 0x02, 0x22, 0x00, 0x04};
+  u8_t puback_fail[] = {0x40, 0x03, 0x00, 0x01, 0x87};
+  u8_t puback[] = {0x40, 0x02, 0x00, 0x02};
+  /* publish establishing inbound alias 1, then publish using it */
+  u8_t publish_alias[] = {0x30, 0x0a, 0x00, 0x03, 'a', 'b', 'c', 0x03, 0x23, 0x00, 0x01, 'x'};
+  u8_t publish_empty[] = {0x30, 0x07, 0x00, 0x00, 0x03, 0x23, 0x00, 0x01, 'y'};
+  u8_t publish_unknown[] = {0x30, 0x07, 0x00, 0x00, 0x03, 0x23, 0x00, 0x02, 'z'};
+  LWIP_UNUSED_ARG(_i);
+
+  test_mqtt_init_netif(&netif, &test_mqtt_local_ip, &test_mqtt_netmask);
+
+  client = mqtt_client_new();
+  fail_unless(client != NULL);
+  err = mqtt_client_connect(client, &test_mqtt_remote_ip, 1234, test_mqtt_connection_cb, NULL, &client_info);
+  fail_unless(err == ERR_OK);
+  /* protocol level */
+  fail_unless(client->output.buf[8] == 5);
+  client->conn->connected(client->conn->callback_arg, client->conn, ERR_OK);
+  test_mqtt_recv(client, connack, sizeof(connack));
+  fail_unless(mqtt_client_is_connected(client));
+  fail_unless(client->server_receive_max == 2);
+  mqtt_set_inpub_callback(client, test_mqtt_v5_pub_cb, test_mqtt_v5_data_cb, NULL);
+
+  /* the topic is replaced by its alias after the first publish */
+  written = client->tx_written;
+  err = mqtt_publish(client, "sensors/room1/temperature", "21.5", 4, 0, 0, NULL, NULL);
+  fail_unless(err == ERR_OK);
+  first_len = client->tx_written - written;
+  written = client->tx_written;
+  err = mqtt_publish(client, "sensors/room1/temperature", "21.6", 4, 0, 0, NULL, NULL);
+  fail_unless(err == ERR_OK);
+  fail_unless(client->tx_written - written == first_len - 25);
+  client->conn->sent(client->conn->callback_arg, client->conn, (u16_t)(client->tx_written - client->tx_acked));
+
+  /* no more QoS 1 publishes than the server's receive maximum */
+  err = mqtt_publish(client, "a", "1", 1, 1, 0, test_mqtt_v5_request_cb, NULL);
+  fail_unless(err == ERR_OK);
+  err = mqtt_publish(client, "a", "2", 1, 1, 0, test_mqtt_v5_request_cb, NULL);
+  fail_unless(err == ERR_OK);
+  err = mqtt_publish(client, "a", "3", 1, 1, 0, test_mqtt_v5_request_cb, NULL);
+  fail_unless(err == ERR_MEM);
+
+  /* failure reason code completes the request with an error */
+  test_mqtt_recv(client, puback_fail, sizeof(puback_fail));
+  fail_unless(v5_pub_done == 1);
+  fail_unless(v5_pub_err == ERR_ABRT);
+  test_mqtt_recv(client, puback, sizeof(puback));
+  fail_unless(v5_pub_done == 2);
+  fail_unless(v5_pub_err == ERR_OK);
+  fail_unless(client->qos_pub_inflight == 0);
+  err = mqtt_publish(client, "a", "3", 1, 1, 0, NULL, NULL);
+  fail_unless(err == ERR_OK);
+
+  /* inbound topic alias */
+  test_mqtt_recv(client, publish_alias, sizeof(publish_alias));
+  fail_unless(v5_msgs == 1);
+  fail_unless(strcmp(v5_topic, "abc") == 0);
+  v5_topic[0] = 0;
+  test_mqtt_recv(client, publish_empty, sizeof(publish_empty));
+  fail_unless(v5_msgs == 2);
+  fail_unless(strcmp(v5_topic, "abc") == 0);
+  fail_unless(mqtt_client_is_connected(client));
+  /* unknown alias is a protocol error */
+  test_mqtt_recv(client, publish_unknown, sizeof(publish_unknown));
+  fail_unless(v5_msgs == 2);
+  fail_unless(!mqtt_client_is_connected(client));
+
+  mqtt_client_free(client);
+}
+END_TEST
+
+static void
+test_mqtt_v5_recv_split(mqtt_client_t *client, u8_t *msg, u16_t len, u16_t split)
+{
+  stream_topic_len = 0;
+  stream_data_len = 0;
+  stream_done = 0;
+  test_mqtt_recv(client, msg, split);
+  test_mqtt_recv(client, &msg[split], (u16_t)(len - split));
+}
+
+START_TEST(v5_stream_topic_alias)
+{
+  mqtt_client_t* client;
+  struct netif netif;
+  err_t err;
+  u16_t split;
+  struct mqtt_connect_client_info_t client_info = {
+    "dumm",
+    NULL, NULL,
+    10,
+    NULL, NULL, 0, 0
+  };
+  u8_t connack[] = {0x20, 0x03, 0x00, 0x00, 0x00};
+  /* publish establishing inbound alias 1 with a user property, then publish using it */
+  u8_t publish_alias[] = {0x30, 0x12, 0x00, 0x03, 'a', 'b', 'c', 0x0a, 0x26, 0x00, 0x01, 'k', 0x00, 0x01, 'v',
+                          0x23, 0x00, 0x01, 'x', 'x'};
+  u8_t publish_empty[] = {0x30, 0x07, 0x00, 0x00, 0x03, 0x23, 0x00, 0x01, 'y'};
+  u8_t publish_unknown[] = {0x30, 0x07, 0x00, 0x00, 0x03, 0x23, 0x00, 0x02, 'z'};
+  LWIP_UNUSED_ARG(_i);
+
+  test_mqtt_init_netif(&netif, &test_mqtt_local_ip, &test_mqtt_netmask);
+
+  client = mqtt_client_new();
+  fail_unless(client != NULL);
+  err = mqtt_client_connect(client, &test_mqtt_remote_ip, 1234, test_mqtt_connection_cb, NULL, &client_info);
+  fail_unless(err == ERR_OK);
+  client->conn->connected(client->conn->callback_arg, client->conn, ERR_OK);
+  test_mqtt_recv(client, connack, sizeof(connack));
+  fail_unless(mqtt_client_is_connected(client));
+  mqtt_set_inpub_stream_callback(client, test_mqtt_topic_cb, test_mqtt_pbuf_cb, NULL);
+
+  /* the topic is passed once the properties are known, tot_len is the payload length */
+  for (split = 1; split < sizeof(publish_alias); split++) {
+    test_mqtt_v5_recv_split(client, publish_alias, sizeof(publish_alias), split);
+    fail_unless(stream_done == 1);
+    fail_unless(stream_topic_len == 3);
+    fail_unless(memcmp(stream_topic, "abc", 3) == 0);
+    fail_unless(stream_tot_len == 2);
+    fail_unless(stream_data_len == 2);
+    fail_unless(client->inpub_hdr == NULL);
+  }
+  for (split = 1; split < sizeof(publish_empty); split++) {
+    test_mqtt_v5_recv_split(client, publish_empty, sizeof(publish_empty), split);
+    fail_unless(stream_done == 1);
+    fail_unless(stream_topic_len == 3);
+    fail_unless(memcmp(stream_topic, "abc", 3) == 0);
+    fail_unless(stream_tot_len == 1);
+    fail_unless(stream_data[0] == 'y');
+  }
+  fail_unless(mqtt_client_is_connected(client));
+
+  /* unknown alias is a protocol error */
+  test_mqtt_v5_recv_split(client, publish_unknown, sizeof(publish_unknown), 5);
+  fail_unless(stream_topic_len == 0);
+  fail_unless(stream_done == 0);
+  fail_unless(!mqtt_client_is_connected(client));
+  fail_unless(client->inpub_hdr == NULL);
+
+  mqtt_client_free(client);
+}
+END_TEST
+#endif /* LWIP_MQTT_V5 */
+
+#endif /* !LWIP_ALTCP */
+
 Suite* mqtt_suite(void)
 {
+#if !LWIP_ALTCP
   testfunc tests[] = {
     TESTFUNC(basic_connect),
+    TESTFUNC(publish_large_payload),
+    TESTFUNC(close_referenced_payload),
+    TESTFUNC(session_resume),
+    TESTFUNC(stream_publish),
+#if LWIP_MQTT_V5
+    TESTFUNC(v5_topic_alias),
+    TESTFUNC(v5_stream_topic_alias),
+#endif
   };
   return create_suite("MQTT", tests, sizeof(tests)/sizeof(testfunc), mqtt_setup, mqtt_teardown);
+#else /* !LWIP_ALTCP */
+  return create_suite("MQTT", NULL, 0, NULL, NULL);
+#endif /* !LWIP_ALTCP */
 }
@@ -0,0 +1,488 @@
+#include "test_pppos.h"
+
+#include "lwip/udp.h"
+#include "lwip/timeouts.h"
+#include "lwip/tcpip.h"
+#include "netif/ppp/pppos.h"
+#include "netif/ppp/ppp_impl.h"
+
+#include <string.h>
+
+#if !PPP_SUPPORT || !PPPOS_SUPPORT || !PPP_SERVER || !PPP_MULTILINK_SUPPORT || !LWIP_IPV4
+#error "This tests needs PPPoS with server and multilink support and IPv4 enabled"
+#endif
+
+#if PPP_MP_MAX_LINKS < 3 || MEMP_NUM_PPP_PCB < 6
+#error "This tests needs 3 links per bundle and 6 PPP pcbs"
+#endif
+
+#define TEST_PPP_LINKS     3
+#define TEST_PPP_QUEUE     8192
+#define TEST_PPP_PKT_LEN   1400
+#define TEST_PPP_PORT      7
+
+/* bytes one side sent on one link, delivered to the other side by test_pppos_pump() */
+struct test_pppos_queue {
+  u8_t data[TEST_PPP_QUEUE];
+  u32_t len;
+  int drop; /* number of output calls to drop */
+};
+
+/* [0][] is the client, [1][] the server, [][0] the bundle link */
+static struct test_pppos_queue test_queue[2][TEST_PPP_LINKS];
+static ppp_pcb *test_pcb[2][TEST_PPP_LINKS];
+static struct netif test_netif[2][TEST_PPP_LINKS];
+static int test_status[2][TEST_PPP_LINKS]; /* last PPPERR_* reported, -1 if none */
+static u8_t test_pkt[TEST_PPP_PKT_LEN];
+static u16_t test_pkt_len;
+static u32_t test_asyncmap; /* asyncmap both sides ask for, 0 for the default */
+static int test_chunked; /* deliver the queued bytes in small odd-sized chunks */
+static struct udp_pcb *test_udp_tx, *test_udp_rx;
+static int rx_ok, rx_bad;
+
+/* Helper functions */
+static u32_t
+test_pppos_output(ppp_pcb *pcb, u8_t *data, u32_t len, void *ctx)
+{
+  struct test_pppos_queue *q = (struct test_pppos_queue *)ctx;
+  LWIP_UNUSED_ARG(pcb);
+  if (q->drop > 0) {
+    q->drop--;
+    return len;
+  }
+  fail_unless(q->len + len <= sizeof(q->data));
+  if (q->len + len <= sizeof(q->data)) {
+    memcpy(&q->data[q->len], data, len);
+    q->len += len;
+  }
+  return len;
+}
+
+static void
+test_pppos_status(ppp_pcb *pcb, int err_code, void *ctx)
+{
+  int side, link;
+  LWIP_UNUSED_ARG(ctx);
+  for (side = 0; side < 2; side++) {
+    for (link = 0; link < TEST_PPP_LINKS; link++) {
+      if (test_pcb[side][link] == pcb) {
+        test_status[side][link] = err_code;
+      }
+    }
+  }
+}
+
+/* deliver the queued bytes of all links, order rotates and reverses the link order */
+static void
+test_pppos_pump(int order)
+{
+  u8_t buf[TEST_PPP_QUEUE];
+  int i, side;
+
+  for (i = 0; i < TEST_PPP_LINKS; i++) {
+    int link = (order + ((order & 4) ? (TEST_PPP_LINKS - 1 - i) : i)) % TEST_PPP_LINKS;
+    for (side = 0; side < 2; side++) {
+      struct test_pppos_queue *q = &test_queue[side][link];
+      u32_t len = q->len;
+      if (len > 0) {
+        /* the receiver may answer on the same link */
+        memcpy(buf, q->data, len);
+        q->len = 0;
+        if (test_chunked) {
+          u32_t off, n, k;
+          for (off = 0, k = 0; off < len; off += n, k++) {
+            n = LWIP_MIN(len - off, 1 + (k * 5) % 17);
+            pppos_input(test_pcb[!side][link], &buf[off], (int)n);
+          }
+        } else {
+          pppos_input(test_pcb[!side][link], buf, (int)len);
+        }
+      }
+    }
+  }
+}
+
+static void
+test_pppos_run(u32_t msecs)
+{
+  u32_t t;
+  for (t = 0; t < msecs; t += 10) {
+    test_pppos_pump((int)(t / 10));
+    lwip_sys_now += 10;
+    sys_check_timeouts();
+    /* deliver packets looped back to ourselves (e.g. IPv6 multicast) */
+    while (tcpip_thread_poll_one());
+  }
+}
+
+static void
+test_pppos_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port)
+{
+  LWIP_UNUSED_ARG(arg);
+  LWIP_UNUSED_ARG(pcb);
+  LWIP_UNUSED_ARG(addr);
+  LWIP_UNUSED_ARG(port);
+  if ((p->tot_len == test_pkt_len) && (pbuf_memcmp(p, 0, test_pkt, test_pkt_len) == 0)) {
+    rx_ok++;
+  } else {
+    rx_bad++;
+  }
+  pbuf_free(p);
+}
+
+/* send one packet from the client bundle to the server, it is split across the links */
+static void
+test_pppos_send(void)
+{
+  struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, test_pkt_len, PBUF_RAM);
+  fail_unless(p != NULL);
+  pbuf_take(p, test_pkt, test_pkt_len);
+  fail_unless(udp_sendto_if(test_udp_tx, p, netif_ip_addr4(&test_netif[1][0]), TEST_PPP_PORT,
+                            &test_netif[0][0]) == ERR_OK);
+  pbuf_free(p);
+}
+
+/* create two bundles of TEST_PPP_LINKS links and bring them up */
+static void
+test_pppos_mp_up(void)
+{
+  ip4_addr_t client_ip, server_ip;
+  int side, link;
+
+  for (side = 0; side < 2; side++) {
+    for (link = 0; link < TEST_PPP_LINKS; link++) {
+      test_pcb[side][link] = pppos_create(&test_netif[side][link], test_pppos_output,
+                                          test_pppos_status, &test_queue[side][link]);
+      fail_unless(test_pcb[side][link] != NULL);
+      if (test_asyncmap != 0) {
+        ppp_set_asyncmap(test_pcb[side][link], test_asyncmap);
+      }
+    }
+    for (link = 1; link < TEST_PPP_LINKS; link++) {
+      fail_unless(ppp_mp_add_link(test_pcb[side][0], test_pcb[side][link]) == ERR_OK);
+    }
+  }
+  /* a faster third link gets larger fragments */
+  fail_unless(ppp_mp_set_link_speed(test_pcb[0][2], 3000000) == ERR_OK);
+
+  IP4_ADDR(&client_ip, 10, 0, 0, 1);
+  IP4_ADDR(&server_ip, 10, 0, 0, 2);
+  ppp_set_ipcp_ouraddr(test_pcb[1][0], &server_ip);
+  ppp_set_ipcp_hisaddr(test_pcb[1][0], &client_ip);
+
+  /* member links first, they wait for the bundle link to join */
+  for (link = TEST_PPP_LINKS - 1; link >= 0; link--) {
+    fail_unless(ppp_listen(test_pcb[1][link]) == ERR_OK);
+    fail_unless(ppp_connect(test_pcb[0][link], 0) == ERR_OK);
+    test_pppos_run(200);
+  }
+  test_pppos_run(5000);
+
+  for (side = 0; side < 2; side++) {
+    fail_unless(test_pcb[side][0]->mp.active);
+    fail_unless(netif_is_up(&test_netif[side][0]));
+    for (link = 0; link < TEST_PPP_LINKS; link++) {
+      fail_unless(test_status[side][link] == PPPERR_NONE);
+      fail_unless(test_pcb[side][link]->phase == PPP_PHASE_RUNNING);
+      fail_unless(test_pcb[side][0]->mp.links[link].joined);
+    }
+  }
+
+  test_udp_tx = udp_new();
+  test_udp_rx = udp_new();
+  fail_unless((test_udp_tx != NULL) && (test_udp_rx != NULL));
+  fail_unless(udp_bind(test_udp_rx, IP4_ADDR_ANY, TEST_PPP_PORT) == ERR_OK);
+  udp_recv(test_udp_rx, test_pppos_recv, NULL);
+  rx_ok = rx_bad = 0;
+}
+
+/* close the client bundle (and with it all member links) and free everything */
+static void
+test_pppos_mp_down(void)
+{
+  int side, link;
+
+  udp_remove(test_udp_tx);
+  udp_remove(test_udp_rx);
+
+  fail_unless(ppp_close(test_pcb[0][0], 0) == ERR_OK);
+  test_pppos_run(20000);
+  for (side = 0; side < 2; side++) {
+    for (link = TEST_PPP_LINKS - 1; link >= 0; link--) {
+      fail_unless(test_pcb[side][link]->phase == PPP_PHASE_DEAD);
+      fail_unless(ppp_free(test_pcb[side][link]) == ERR_OK);
+      test_pcb[side][link] = NULL;
+    }
+  }
+}
+
+/* Reference HDLC-like framing (RFC 1662) of one frame, one bit and one byte at a time */
+static u16_t
+test_pppos_fcs_bitwise(u16_t fcs, u8_t c)
+{
+  int i;
+  fcs ^= c;
+  for (i = 0; i < 8; i++) {
+    fcs = (u16_t)((fcs & 1) ? ((fcs >> 1) ^ 0x8408) : (fcs >> 1));
+  }
+  return fcs;
+}
+
+static u32_t
+test_pppos_put(u8_t *out, u32_t n, u8_t c, u32_t accm)
+{
+  if (((c < 0x20) && (accm & (1UL << c))) || (c == 0x7e) || (c == 0x7d)) {
+    out[n++] = 0x7d;
+    out[n++] = c ^ 0x20;
+  } else {
+    out[n++] = c;
+  }
+  return n;
+}
+
+static u32_t
+test_pppos_frame(u8_t *out, const u8_t *s, u16_t len, u32_t accm)
+{
+  u32_t n = 0;
+  u16_t fcs = 0xffff;
+  u16_t i;
+
+  out[n++] = 0x7e;
+  for (i = 0; i < len; i++) {
+    fcs = test_pppos_fcs_bitwise(fcs, s[i]);
+    n = test_pppos_put(out, n, s[i], accm);
+  }
+  fcs ^= 0xffff;
+  n = test_pppos_put(out, n, (u8_t)(fcs & 0xff), accm);
+  n = test_pppos_put(out, n, (u8_t)(fcs >> 8), accm);
+  out[n++] = 0x7e;
+  return n;
+}
+
+
+/* Setups/teardown functions */
+
+static void
+pppos_setup(void)
+{
+  size_t i;
+  memset(test_queue, 0, sizeof(test_queue));
+  memset(test_status, 0xff, sizeof(test_status));
+  for (i = 0; i < sizeof(test_pkt); i++) {
+    test_pkt[i] = (u8_t)(i * 7 + 3);
+  }
+  test_pkt_len = sizeof(test_pkt);
+  test_asyncmap = 0;
+  test_chunked = 0;
+  lwip_check_ensure_no_alloc(SKIP_POOL(MEMP_SYS_TIMEOUT));
+}
+
+static void
+pppos_teardown(void)
+{
+  lwip_check_ensure_no_alloc(SKIP_POOL(MEMP_SYS_TIMEOUT));
+}
+
+
+/* Test functions */
+
+START_TEST(test_pppos_mp_bundle)
+{
+  int i;
+  LWIP_UNUSED_ARG(_i);
+
+  test_pppos_mp_up();
+  fail_unless(test_netif[0][0].mtu == PPP_MP_MRRU);
+
+  for (i = 0; i < 50; i++) {
+    test_pppos_send();
+    test_pppos_pump(0);
+  }
+  test_pppos_run(100);
+  fail_unless(rx_ok == 50);
+  fail_unless(rx_bad == 0);
+  /* every link carried fragments */
+  for (i = 0; i < TEST_PPP_LINKS; i++) {
+    fail_unless(test_pcb[1][0]->mp.links[i].seq_valid);
+  }
+
+  test_pppos_mp_down();
+}
+END_TEST
+
+START_TEST(test_pppos_mp_reorder)
+{
+  int i;
+  LWIP_UNUSED_ARG(_i);
+
+  test_pppos_mp_up();
+
+  /* fragments of two packets arrive with the links delivered in changing order */
+  for (i = 0; i < 50; i++) {
+    test_pppos_send();
+    test_pppos_send();
+    test_pppos_pump(i % 8);
+  }
+  test_pppos_run(100);
+  fail_unless(rx_ok == 100);
+  fail_unless(rx_bad == 0);
+
+  test_pppos_mp_down();
+}
+END_TEST
+
+START_TEST(test_pppos_mp_loss)
+{
+  int i;
+  LWIP_UNUSED_ARG(_i);
+
+  test_pppos_mp_up();
+
+  /* lose one fragment of every 10th packet, the others must be reassembled */
+  for (i = 0; i < 50; i++) {
+    if ((i % 10) == 3) {
+      test_queue[0][i % TEST_PPP_LINKS].drop = 1;
+    }
+    test_pppos_send();
+    test_pppos_pump(i % 8);
+    test_pppos_run(10);
+  }
+  test_pppos_run(2 * PPP_MP_REASM_TIMEOUT);
+  fail_unless(rx_ok >= 45);
+  fail_unless(rx_ok < 50);
+  fail_unless(rx_bad == 0);
+  fail_unless(test_pcb[1][0]->mp.rx_count == 0);
+
+  /* the bundle recovered */
+  rx_ok = 0;
+  for (i = 0; i < 10; i++) {
+    test_pppos_send();
+    test_pppos_pump(i);
+  }
+  test_pppos_run(100);
+  fail_unless(rx_ok == 10);
+  fail_unless(rx_bad == 0);
+
+  test_pppos_mp_down();
+}
+END_TEST
+
+START_TEST(test_pppos_mp_member_close)
+{
+  int i;
+  LWIP_UNUSED_ARG(_i);
+
+  test_pppos_mp_up();
+
+  /* a member link goes down, the bundle keeps running on the others */
+  fail_unless(ppp_close(test_pcb[0][1], 0) == ERR_OK);
+  test_pppos_run(3000);
+  fail_unless(test_status[0][1] == PPPERR_USER);
+  fail_unless(!test_pcb[0][0]->mp.links[1].joined);
+  fail_unless(netif_is_up(&test_netif[0][0]));
+
+  for (i = 0; i < 20; i++) {
+    test_pppos_send();
+    test_pppos_pump(i);
+  }
+  test_pppos_run(100);
+  fail_unless(rx_ok == 20);
+  fail_unless(rx_bad == 0);
+
+  test_pppos_mp_down();
+}
+END_TEST
+
+START_TEST(test_pppos_tx_framing)
+{
+  static const u32_t accms[] = { 0, 0xffffffffUL, 0x000a0000UL, 0x80000001UL };
+  static const u16_t lens[] = { 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 33, 63, 64, 65, 255, 257, 1023, 1499, 1500 };
+  static const u8_t special[] = { 0x7e, 0x7d, 0x11, 0x13, 0x00, 0x1f, 0x20, 0x5d, 0x5e, 0x61 };
+  static u8_t data[1500 + 8];
+  static u8_t expect[2 * (1500 + 2) + 2];
+  ppp_pcb *pcb;
+  pppos_pcb *pppos;
+  u8_t saved_accm[sizeof(pppos->out_accm)];
+  size_t a, l, pattern;
+  u16_t off;
+  LWIP_UNUSED_ARG(_i);
+
+  test_pppos_mp_up();
+  /* write raw frames on a member link, nothing is delivered to the server */
+  pcb = test_pcb[0][1];
+  pppos = (pppos_pcb *)pcb->link_ctx_cb;
+  MEMCPY(saved_accm, pppos->out_accm, sizeof(saved_accm));
+
+  for (pattern = 0; pattern < 2; pattern++) {
+    size_t i;
+    for (i = 0; i < sizeof(data); i++) {
+      /* all byte values, or dense runs of characters to escape */
+      data[i] = pattern ? special[(i * 3) % sizeof(special)] : (u8_t)(i * 7 + 3);
+    }
+    for (a = 0; a < LWIP_ARRAYSIZE(accms); a++) {
+      pcb->link_cb->send_config(pcb, pcb->link_ctx_cb, accms[a], 0, 0);
+      for (l = 0; l < LWIP_ARRAYSIZE(lens); l++) {
+        for (off = 0; off < 8; off++) {
+          struct pbuf *p = pbuf_alloc(PBUF_RAW, lens[l], PBUF_REF);
+          u32_t n;
+          fail_unless(p != NULL);
+          p->payload = &data[off];
+          /* idle link: every frame starts with a flag */
+          lwip_sys_now += PPP_MAXIDLEFLAG;
+          test_queue[0][1].len = 0;
+          fail_unless(pcb->link_cb->write(pcb, pcb->link_ctx_cb, p) == ERR_OK);
+          n = test_pppos_frame(expect, &data[off], lens[l], accms[a]);
+          fail_unless(test_queue[0][1].len == n);
+          fail_unless(memcmp(test_queue[0][1].data, expect, n) == 0);
+        }
+      }
+    }
+  }
+
+  test_queue[0][1].len = 0;
+  MEMCPY(pppos->out_accm, saved_accm, sizeof(saved_accm));
+  test_pppos_mp_down();
+}
+END_TEST
+
+START_TEST(test_pppos_rx_framing)
+{
+  static const u16_t lens[] = { 1, 2, 3, 7, 8, 9, 15, 17, 63, 65, 255, 257, 1023, 1399, 1400 };
+  size_t i;
+  LWIP_UNUSED_ARG(_i);
+
+  /* every control character escaped, received in odd-sized chunks at odd offsets */
+  test_asyncmap = 0xffffffffUL;
+  test_chunked = 1;
+  test_pppos_mp_up();
+  fail_unless(((pppos_pcb *)test_pcb[1][0]->link_ctx_cb)->in_accm[0] == 0xff);
+
+  for (i = 0; i < LWIP_ARRAYSIZE(lens); i++) {
+    test_pkt_len = lens[i];
+    rx_ok = 0;
+    test_pppos_send();
+    test_pppos_run(10);
+    fail_unless(rx_ok == 1);
+    fail_unless(rx_bad == 0);
+  }
+
+  test_pkt_len = sizeof(test_pkt);
+  test_pppos_mp_down();
+}
+END_TEST
+
+
+/** Create the suite including all tests for this module */
+Suite *
+pppos_suite(void)
+{
+  testfunc tests[] = {
+    TESTFUNC(test_pppos_mp_bundle),
+    TESTFUNC(test_pppos_mp_reorder),
+    TESTFUNC(test_pppos_mp_loss),
+    TESTFUNC(test_pppos_mp_member_close),
+    TESTFUNC(test_pppos_tx_framing),
+    TESTFUNC(test_pppos_rx_framing)
+  };
+  return create_suite("PPPOS", tests, sizeof(tests)/sizeof(testfunc), pppos_setup, pppos_teardown);
+}
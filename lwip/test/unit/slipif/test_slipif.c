@@ -0,0 +1,223 @@
+#include "test_slipif.h"
+
+#include "netif/slipif.h"
+#include "lwip/sio.h"
+
+#include <string.h>
+
+#if !SLIP_RX_FROM_ISR || !SLIP_RX_QUEUE || SLIP_USE_RX_THREAD
+#error "This tests needs SLIP_RX_FROM_ISR and SLIP_RX_QUEUE without the RX thread"
+#endif
+
+#define SLIP_END     0xC0
+#define SLIP_ESC     0xDB
+#define SLIP_ESC_END 0xDC
+#define SLIP_ESC_ESC 0xDD
+
+#define TEST_SLIP_PKTS     3
+#define TEST_SLIP_STREAM   (2 * 3 * 1500 + 16)
+
+static struct netif test_netif;
+/* packets encoded into test_stream and the lengths of them */
+static u8_t test_pkt[TEST_SLIP_PKTS][1500];
+static const u16_t test_pkt_len[TEST_SLIP_PKTS] = { 1500, 7, 600 };
+static u8_t test_stream[TEST_SLIP_STREAM];
+static u16_t test_stream_len;
+/* serial line read by sio_tryread() */
+static const u8_t *test_sio_data;
+static u32_t test_sio_len;
+static u32_t test_sio_chunk;
+/* packets passed to netif->input */
+static int rx_pkts, rx_bad;
+static int rx_chained;
+
+/* Serial layer used by slipif */
+sio_fd_t
+sio_open(u8_t devnum)
+{
+  LWIP_UNUSED_ARG(devnum);
+  /* never dereferenced, only checked for != NULL */
+  return (sio_fd_t)(void *)&test_sio_len;
+}
+
+void
+sio_send(u8_t c, sio_fd_t fd)
+{
+  LWIP_UNUSED_ARG(c);
+  LWIP_UNUSED_ARG(fd);
+}
+
+u32_t
+sio_tryread(sio_fd_t fd, u8_t *data, u32_t len)
+{
+  LWIP_UNUSED_ARG(fd);
+  len = LWIP_MIN(len, LWIP_MIN(test_sio_len, test_sio_chunk));
+  memcpy(data, test_sio_data, len);
+  test_sio_data += len;
+  test_sio_len -= len;
+  return len;
+}
+
+/* Helper functions */
+static err_t
+test_slipif_input(struct pbuf *p, struct netif *netif)
+{
+  int i = rx_pkts % TEST_SLIP_PKTS;
+  LWIP_UNUSED_ARG(netif);
+
+  if ((p->tot_len == test_pkt_len[i]) && (pbuf_memcmp(p, 0, test_pkt[i], test_pkt_len[i]) == 0)) {
+    rx_pkts++;
+  } else {
+    rx_bad++;
+  }
+  if (p->next != NULL) {
+    rx_chained++;
+  }
+  pbuf_free(p);
+  return ERR_OK;
+}
+
+/* encode all packets, every packet starts and ends with SLIP_END */
+static void
+test_slipif_encode(void)
+{
+  int i;
+  u16_t j, n = 0;
+
+  for (i = 0; i < TEST_SLIP_PKTS; i++) {
+    test_stream[n++] = SLIP_END;
+    for (j = 0; j < test_pkt_len[i]; j++) {
+      u8_t c = test_pkt[i][j];
+      if (c == SLIP_END) {
+        test_stream[n++] = SLIP_ESC;
+        test_stream[n++] = SLIP_ESC_END;
+      } else if (c == SLIP_ESC) {
+        test_stream[n++] = SLIP_ESC;
+        test_stream[n++] = SLIP_ESC_ESC;
+      } else {
+        test_stream[n++] = c;
+      }
+    }
+    test_stream[n++] = SLIP_END;
+  }
+  test_stream_len = n;
+}
+
+/* Setups/teardown functions */
+
+static void
+slipif_setup(void)
+{
+  int i;
+  u16_t j;
+
+  for (i = 0; i < TEST_SLIP_PKTS; i++) {
+    for (j = 0; j < sizeof(test_pkt[i]); j++) {
+      /* runs of plain bytes between END and ESC at all word offsets */
+      switch ((j * 5 + (u16_t)i) % 11) {
+        case 0:
+          test_pkt[i][j] = SLIP_END;
+          break;
+        case 3:
+          test_pkt[i][j] = SLIP_ESC;
+          break;
+        default:
+          test_pkt[i][j] = (u8_t)(j * 7 + 3);
+          break;
+      }
+    }
+  }
+  test_slipif_encode();
+  rx_pkts = rx_bad = rx_chained = 0;
+  test_sio_len = 0;
+
+  lwip_check_ensure_no_alloc(SKIP_POOL(MEMP_SYS_TIMEOUT));
+  fail_unless(netif_add_noaddr(&test_netif, NULL, slipif_init, test_slipif_input) == &test_netif);
+}
+
+static void
+slipif_teardown(void)
+{
+  netif_remove(&test_netif);
+  mem_free(test_netif.state);
+  lwip_check_ensure_no_alloc(SKIP_POOL(MEMP_SYS_TIMEOUT));
+}
+
+
+/* Test functions */
+
+START_TEST(test_slipif_poll_chunks)
+{
+  u32_t chunk;
+  LWIP_UNUSED_ARG(_i);
+
+  /* the serial line returns the stream in blocks of every size up to
+     SLIP_RX_BLOCK_SIZE, so END and ESC fall on all block boundaries */
+  for (chunk = 1; chunk <= SLIP_RX_BLOCK_SIZE; chunk++) {
+    test_sio_data = test_stream;
+    test_sio_len = test_stream_len;
+    test_sio_chunk = chunk;
+    slipif_poll(&test_netif);
+    fail_unless(test_sio_len == 0);
+    fail_unless(rx_pkts == (int)(chunk * TEST_SLIP_PKTS));
+    fail_unless(rx_bad == 0);
+  }
+  /* a 1500 byte packet does not fit one PBUF_POOL pbuf */
+  fail_unless(rx_chained > 0);
+}
+END_TEST
+
+START_TEST(test_slipif_split)
+{
+  u16_t split;
+  LWIP_UNUSED_ARG(_i);
+
+  /* the stream split in two at every offset, e.g. right after SLIP_ESC */
+  for (split = 0; split <= test_stream_len; split++) {
+    slipif_received_bytes(&test_netif, test_stream, split);
+    slipif_received_bytes(&test_netif, &test_stream[split], (u16_t)(test_stream_len - split));
+    slipif_process_rxqueue(&test_netif);
+    fail_unless(rx_pkts == (int)((split + 1) * TEST_SLIP_PKTS));
+    fail_unless(rx_bad == 0);
+  }
+}
+END_TEST
+
+START_TEST(test_slipif_rx_queue)
+{
+  u16_t i;
+  LWIP_UNUSED_ARG(_i);
+
+  /* all packets are queued before the main loop takes them, in order */
+  slipif_received_bytes(&test_netif, test_stream, test_stream_len);
+  fail_unless(rx_pkts == 0);
+  slipif_process_rxqueue(&test_netif);
+  fail_unless(rx_pkts == TEST_SLIP_PKTS);
+  fail_unless(rx_bad == 0);
+  fail_unless(rx_chained > 0);
+
+  /* same for the byte-at-a-time API, queued twice */
+  for (i = 0; i < test_stream_len; i++) {
+    slipif_received_byte(&test_netif, test_stream[i]);
+  }
+  for (i = 0; i < test_stream_len; i++) {
+    slipif_received_byte(&test_netif, test_stream[i]);
+  }
+  slipif_process_rxqueue(&test_netif);
+  fail_unless(rx_pkts == 3 * TEST_SLIP_PKTS);
+  fail_unless(rx_bad == 0);
+}
+END_TEST
+
+
+/** Create the suite including all tests for this module */
+Suite *
+slipif_suite(void)
+{
+  testfunc tests[] = {
+    TESTFUNC(test_slipif_poll_chunks),
+    TESTFUNC(test_slipif_split),
+    TESTFUNC(test_slipif_rx_queue)
+  };
+  return create_suite("SLIPIF", tests, sizeof(tests)/sizeof(testfunc), slipif_setup, slipif_teardown);
+}
@@ -0,0 +1,8 @@
+#ifndef LWIP_HDR_TEST_SLIPIF_H
+#define LWIP_HDR_TEST_SLIPIF_H
+
+#include "../lwip_check.h"
+
+Suite* slipif_suite(void);
+
+#endif
@@ -0,0 +1,564 @@
+#include "test_snmp.h"
+
+#include "lwip/apps/snmp.h"
+#include "lwip/apps/snmp_core.h"
+#include "lwip/apps/snmp_mib2.h"
+#include "lwip/udp.h"
+#include "lwip/tcp.h"
+#include "lwip/priv/tcp_priv.h"
+#include "../../../src/apps/snmp/snmp_core_priv.h"
+
+#if !LWIP_SNMP
+#error "This tests needs LWIP_SNMP enabled"
+#endif
+
+#define TEST_ROWS     24
+#define TEST_OID_LEN  3
+/* sub-identifiers are taken from 0..TEST_OID_MAX to get duplicate and prefix OIDs */
+#define TEST_OID_MAX  3
+
+struct test_row {
+  u32_t oid[TEST_OID_LEN];
+  u8_t len;
+};
+
+static struct test_row test_rows[TEST_ROWS];
+
+static u8_t
+test_row_oid(const void *row, u32_t *oid)
+{
+  const struct test_row *r = (const struct test_row *)row;
+  memcpy(oid, r->oid, r->len * sizeof(u32_t));
+  return r->len;
+}
+
+static void
+test_rows_init(void)
+{
+  u32_t seed = 12345;
+  int i, j;
+
+  for (i = 0; i < TEST_ROWS; i++) {
+    seed = seed * 1103515245 + 12345;
+    test_rows[i].len = (u8_t)(1 + ((seed >> 16) % TEST_OID_LEN));
+    for (j = 0; j < test_rows[i].len; j++) {
+      seed = seed * 1103515245 + 12345;
+      test_rows[i].oid[j] = (seed >> 16) % (TEST_OID_MAX + 1);
+    }
+  }
+}
+
+/* Test MIB: .1 and .2 both have a leaf .3, so the leaf OIDs only differ in the
+ * sub-identifier before the last one. The deep MIB has a leaf below .1.2.3.4.5.6, deeper
+ * than the MIB index and the cursors hold with the default SNMP_LWIP_MIB_INDEX_DEPTH. */
+struct test_leaf {
+  struct snmp_leaf_node leaf;
+  /* instances are .1 to .count */
+  u32_t count;
+};
+
+static snmp_err_t test_leaf_get_instance(const u32_t *root_oid, u8_t root_oid_len, struct snmp_node_instance *instance);
+static snmp_err_t test_leaf_get_next_instance(const u32_t *root_oid, u8_t root_oid_len, struct snmp_node_instance *instance);
+
+#define TEST_LEAF(oid, count) {{{ SNMP_NODE_SCALAR, (oid) }, test_leaf_get_instance, test_leaf_get_next_instance }, (count) }
+
+static const struct test_leaf test_leaf_1_1 = TEST_LEAF(1, 1);
+static const struct test_leaf test_leaf_1_3 = TEST_LEAF(3, 3);
+static const struct test_leaf test_leaf_2_3 = TEST_LEAF(3, 2);
+static const struct test_leaf test_leaf_2_5 = TEST_LEAF(5, 4);
+static const struct test_leaf test_leaf_deep = TEST_LEAF(1, 2);
+
+static const struct snmp_node *const test_1_nodes[] = { &test_leaf_1_1.leaf.node, &test_leaf_1_3.leaf.node };
+static const struct snmp_tree_node test_1_node = SNMP_CREATE_TREE_NODE(1, test_1_nodes);
+static const struct snmp_node *const test_2_nodes[] = { &test_leaf_2_3.leaf.node, &test_leaf_2_5.leaf.node };
+static const struct snmp_tree_node test_2_node = SNMP_CREATE_TREE_NODE(2, test_2_nodes);
+static const struct snmp_tree_node test_3_node = SNMP_CREATE_EMPTY_TREE_NODE(3);
+
+static const struct snmp_node *const test_root_nodes[] = { &test_1_node.node, &test_2_node.node, &test_3_node.node };
+static const struct snmp_tree_node test_root_node = SNMP_CREATE_TREE_NODE(99, test_root_nodes);
+static const u32_t test_base_oid[] = { 1, 3, 6, 1, 4, 1, 26381, 99 };
+static const struct snmp_mib test_mib = SNMP_MIB_CREATE(test_base_oid, &test_root_node.node);
+
+static const struct snmp_node *const test_deep_6_nodes[] = { &test_leaf_deep.leaf.node };
+static const struct snmp_tree_node test_deep_6_node = SNMP_CREATE_TREE_NODE(6, test_deep_6_nodes);
+static const struct snmp_node *const test_deep_5_nodes[] = { &test_deep_6_node.node };
+static const struct snmp_tree_node test_deep_5_node = SNMP_CREATE_TREE_NODE(5, test_deep_5_nodes);
+static const struct snmp_node *const test_deep_4_nodes[] = { &test_deep_5_node.node };
+static const struct snmp_tree_node test_deep_4_node = SNMP_CREATE_TREE_NODE(4, test_deep_4_nodes);
+static const struct snmp_node *const test_deep_3_nodes[] = { &test_deep_4_node.node };
+static const struct snmp_tree_node test_deep_3_node = SNMP_CREATE_TREE_NODE(3, test_deep_3_nodes);
+static const struct snmp_node *const test_deep_2_nodes[] = { &test_deep_3_node.node };
+static const struct snmp_tree_node test_deep_2_node = SNMP_CREATE_TREE_NODE(2, test_deep_2_nodes);
+static const struct snmp_node *const test_deep_1_nodes[] = { &test_deep_2_node.node };
+static const struct snmp_tree_node test_deep_1_node = SNMP_CREATE_TREE_NODE(1, test_deep_1_nodes);
+static const struct snmp_node *const test_deep_nodes[] = { &test_deep_1_node.node };
+static const struct snmp_tree_node test_deep_root_node = SNMP_CREATE_TREE_NODE(100, test_deep_nodes);
+static const u32_t test_deep_base_oid[] = { 1, 3, 6, 1, 4, 1, 26381, 100 };
+static const struct snmp_mib test_deep_mib = SNMP_MIB_CREATE(test_deep_base_oid, &test_deep_root_node.node);
+
+static const struct snmp_mib *test_mibs[] = { &mib2, &test_mib };
+static const struct snmp_mib *test_mibs_deep[] = { &mib2, &test_mib, &test_deep_mib };
+static const struct snmp_mib *test_mibs_default[] = { &mib2 };
+
+static s16_t
+test_leaf_get_value(struct snmp_node_instance *instance, void *value)
+{
+  *(s32_t *)value = (s32_t)instance->instance_oid.id[0];
+  return sizeof(s32_t);
+}
+
+static snmp_err_t
+test_leaf_get_instance(const u32_t *root_oid, u8_t root_oid_len, struct snmp_node_instance *instance)
+{
+  const struct test_leaf *leaf = (const struct test_leaf *)(const void *)instance->node;
+  LWIP_UNUSED_ARG(root_oid);
+  LWIP_UNUSED_ARG(root_oid_len);
+
+  if ((instance->instance_oid.len != 1) || (instance->instance_oid.id[0] == 0) ||
+      (instance->instance_oid.id[0] > leaf->count)) {
+    return SNMP_ERR_NOSUCHINSTANCE;
+  }
+  instance->asn1_type = SNMP_ASN1_TYPE_INTEGER;
+  instance->access    = SNMP_NODE_INSTANCE_READ_ONLY;
+  instance->get_value = test_leaf_get_value;
+  return SNMP_ERR_NOERROR;
+}
+
+static snmp_err_t
+test_leaf_get_next_instance(const u32_t *root_oid, u8_t root_oid_len, struct snmp_node_instance *instance)
+{
+  const struct test_leaf *leaf = (const struct test_leaf *)(const void *)instance->node;
+  u32_t next = 1;
+  LWIP_UNUSED_ARG(root_oid);
+  LWIP_UNUSED_ARG(root_oid_len);
+
+  if (instance->instance_oid.len > 0) {
+    next = instance->instance_oid.id[0] + 1;
+  }
+  if (next > leaf->count) {
+    return SNMP_ERR_NOSUCHINSTANCE;
+  }
+  instance->instance_oid.id[0] = next;
+  instance->instance_oid.len   = 1;
+  instance->asn1_type = SNMP_ASN1_TYPE_INTEGER;
+  instance->access    = SNMP_NODE_INSTANCE_READ_ONLY;
+  instance->get_value = test_leaf_get_value;
+  return SNMP_ERR_NOERROR;
+}
+
+/* leaf nodes of the MIBs in OID order, collected by walking the trees */
+#define TEST_MAX_LEAVES 512
+
+struct test_mib_leaf {
+  const struct snmp_mib *mib;
+  const struct snmp_node *node;
+  struct snmp_obj_id oid;
+};
+
+static struct test_mib_leaf test_leaves[TEST_MAX_LEAVES];
+static int test_num_leaves;
+
+static void
+test_collect_leaves(const struct snmp_mib *mib, const struct snmp_node *node, struct snmp_obj_id *oid)
+{
+  if (node->node_type == SNMP_NODE_TREE) {
+    const struct snmp_tree_node *tree = (const struct snmp_tree_node *)(const void *)node;
+    u16_t i;
+
+    for (i = 0; i < tree->subnode_count; i++) {
+      oid->id[oid->len++] = tree->subnodes[i]->oid;
+      test_collect_leaves(mib, tree->subnodes[i], oid);
+      oid->len--;
+    }
+  } else {
+    fail_unless(test_num_leaves < TEST_MAX_LEAVES);
+    test_leaves[test_num_leaves].mib  = mib;
+    test_leaves[test_num_leaves].node = node;
+    snmp_oid_assign(&test_leaves[test_num_leaves].oid, oid->id, oid->len);
+    test_num_leaves++;
+  }
+}
+
+static void
+test_set_mibs(const struct snmp_mib **mibs, u8_t num_mibs)
+{
+  struct snmp_obj_id oid;
+  u8_t i;
+
+  snmp_set_mibs(mibs, num_mibs);
+  test_num_leaves = 0;
+  for (i = 0; i < num_mibs; i++) {
+    snmp_oid_assign(&oid, mibs[i]->base_oid, mibs[i]->base_oid_len);
+    test_collect_leaves(mibs[i], mibs[i]->root_node, &oid);
+  }
+}
+
+/** resolve oid of a MIB with the index and compare it to the collected leaves */
+static void
+test_check_resolve(const struct snmp_mib *mib, const u32_t *oid, u8_t oid_len)
+{
+  const struct test_mib_leaf *exact = NULL;
+  const struct test_mib_leaf *next = NULL;
+  const struct snmp_node *node;
+  struct snmp_obj_id next_oid;
+  u8_t instance_len = 0;
+  int i;
+
+  for (i = 0; i < test_num_leaves; i++) {
+    const struct test_mib_leaf *l = &test_leaves[i];
+    if (l->mib != mib) {
+      continue;
+    }
+    if ((l->oid.len <= oid_len) && snmp_oid_equal(l->oid.id, l->oid.len, oid, l->oid.len)) {
+      exact = l;
+    }
+    if ((next == NULL) && (snmp_oid_compare(l->oid.id, l->oid.len, oid, oid_len) > 0)) {
+      next = l;
+    }
+  }
+
+  node = snmp_mib_tree_resolve_exact(mib, oid, oid_len, &instance_len);
+  if (exact == NULL) {
+    fail_unless(node == NULL);
+  } else {
+    fail_unless(node == exact->node);
+    fail_unless(instance_len == oid_len - exact->oid.len);
+  }
+
+  node = snmp_mib_tree_resolve_next(mib, oid, oid_len, &next_oid);
+  if (next == NULL) {
+    fail_unless(node == NULL);
+  } else {
+    fail_unless(node == next->node);
+    fail_unless(snmp_oid_equal(next_oid.id, next_oid.len, next->oid.id, next->oid.len));
+  }
+}
+
+/** resolve OIDs around all leaf nodes */
+static int
+test_check_resolve_all(void)
+{
+  int checked = 0;
+  int i, v;
+
+  for (i = 0; i < test_num_leaves; i++) {
+    const struct test_mib_leaf *l = &test_leaves[i];
+    const struct snmp_mib *mib = l->mib;
+    struct snmp_obj_id oid;
+
+    for (v = 0; v < 7; v++) {
+      snmp_oid_assign(&oid, l->oid.id, l->oid.len);
+      switch (v) {
+        case 1: /* scalar instance */
+          oid.id[oid.len++] = 0;
+          break;
+        case 2: /* table instance */
+          oid.id[oid.len++] = 5;
+          oid.id[oid.len++] = 7;
+          break;
+        case 3: /* preceding sibling */
+          if (oid.id[oid.len - 1] == 0) {
+            continue;
+          }
+          oid.id[oid.len - 1]--;
+          break;
+        case 4: /* following sibling */
+          oid.id[oid.len - 1]++;
+          break;
+        case 5: /* parent */
+          oid.len--;
+          break;
+        case 6: /* parent's following sibling */
+          oid.len--;
+          oid.id[oid.len - 1]++;
+          break;
+        default: /* leaf itself */
+          break;
+      }
+      if ((oid.len < mib->base_oid_len) ||
+          !snmp_oid_equal(oid.id, mib->base_oid_len, mib->base_oid, mib->base_oid_len)) {
+        continue;
+      }
+      test_check_resolve(mib, oid.id, oid.len);
+      checked++;
+    }
+  }
+  return checked;
+}
+
+/** GetNext from oid with and without a cursor must give the same result */
+static u8_t
+test_next_with_cursor(const u32_t *oid, u8_t oid_len, struct snmp_next_cursor *cursor, struct snmp_obj_id *result)
+{
+  struct snmp_node_instance instance, instance_ref;
+  struct snmp_obj_id result_ref;
+  u8_t err, err_ref;
+
+  memset(&instance_ref, 0, sizeof(instance_ref));
+  err_ref = snmp_get_next_node_instance_from_oid(oid, oid_len, NULL, NULL, &result_ref, &instance_ref, NULL);
+  if (instance_ref.release_instance != NULL) {
+    instance_ref.release_instance(&instance_ref);
+  }
+
+  memset(&instance, 0, sizeof(instance));
+  err = snmp_get_next_node_instance_from_oid(oid, oid_len, NULL, NULL, result, &instance, cursor);
+  if (instance.release_instance != NULL) {
+    instance.release_instance(&instance);
+  }
+
+  fail_unless(err == err_ref);
+  if (err == SNMP_ERR_NOERROR) {
+    fail_unless(instance.node == instance_ref.node);
+    fail_unless(snmp_oid_equal(result->id, result->len, result_ref.id, result_ref.len));
+  }
+  return err;
+}
+
+/* Setups/teardown functions */
+
+static void
+snmp_setup(void)
+{
+  lwip_check_ensure_no_alloc(SKIP_POOL(MEMP_SYS_TIMEOUT));
+}
+
+static void
+snmp_teardown(void)
+{
+  snmp_set_mibs(test_mibs_default, LWIP_ARRAYSIZE(test_mibs_default));
+  lwip_check_ensure_no_alloc(SKIP_POOL(MEMP_SYS_TIMEOUT));
+}
+
+/* Test functions */
+
+/** a row index must return the same rows as checking all rows with snmp_next_oid_check() */
+START_TEST(test_snmp_row_index_next)
+{
+  const void *rows[TEST_ROWS];
+  struct snmp_row_index index = SNMP_ROW_INDEX_CREATE(rows, test_row_oid);
+  u32_t start[TEST_OID_LEN + 1];
+  u8_t start_len;
+  int i, checked = 0;
+  LWIP_UNUSED_ARG(_i);
+
+  test_rows_init();
+
+  fail_unless(snmp_row_index_update(&index, 1) == 1);
+  for (i = 0; i < TEST_ROWS; i++) {
+    fail_unless(snmp_row_index_add(&index, &test_rows[i]) == 1);
+  }
+  fail_unless(index.num_rows == TEST_ROWS);
+  /* same generation: no rebuild */
+  fail_unless(snmp_row_index_update(&index, 1) == 0);
+
+  /* all start OIDs up to TEST_OID_LEN + 1 sub-identifiers of 0..TEST_OID_MAX + 1 */
+  for (start_len = 0; start_len <= TEST_OID_LEN + 1; start_len++) {
+    u32_t combinations = 1;
+    u32_t n;
+    for (i = 0; i < start_len; i++) {
+      combinations *= TEST_OID_MAX + 2;
+    }
+    for (n = 0; n < combinations; n++) {
+      struct snmp_next_oid_state state;
+      u32_t next_oid[TEST_OID_LEN];
+      struct snmp_obj_id row_oid;
+      const void *row;
+      u32_t v = n;
+
+      for (i = 0; i < start_len; i++) {
+        start[i] = v % (TEST_OID_MAX + 2);
+        v /= TEST_OID_MAX + 2;
+      }
+
+      /* current implementation: check all rows */
+      snmp_next_oid_init(&state, start, start_len, next_oid, TEST_OID_LEN);
+      for (i = 0; i < TEST_ROWS; i++) {
+        snmp_next_oid_check(&state, test_rows[i].oid, test_rows[i].len, &test_rows[i]);
+      }
+
+      snmp_oid_assign(&row_oid, start, start_len);
+      fail_unless(snmp_row_index_next(&index, &row_oid, &row) == 1);
+      if (state.status == SNMP_NEXT_OID_STATUS_SUCCESS) {
+        fail_unless(row == state.reference);
+        fail_unless(snmp_oid_equal(row_oid.id, row_oid.len, state.next_oid, state.next_oid_len));
+      } else {
+        fail_unless(state.status == SNMP_NEXT_OID_STATUS_NO_MATCH);
+        fail_unless(row == NULL);
+      }
+      checked++;
+    }
+  }
+  fail_unless(checked > 0);
+}
+END_TEST
+
+/** an index too small for all rows must not be used, a new generation resets it */
+START_TEST(test_snmp_row_index_overflow)
+{
+  const void *rows[4];
+  struct snmp_row_index index = SNMP_ROW_INDEX_CREATE(rows, test_row_oid);
+  struct snmp_obj_id row_oid;
+  const void *row;
+  int i;
+  LWIP_UNUSED_ARG(_i);
+
+  test_rows_init();
+
+  fail_unless(snmp_row_index_update(&index, 7) == 1);
+  for (i = 0; i < 4; i++) {
+    fail_unless(snmp_row_index_add(&index, &test_rows[i]) == 1);
+  }
+  fail_unless(snmp_row_index_add(&index, &test_rows[4]) == 0);
+  /* overflowed index is not rebuilt for the same generation and can not be used */
+  fail_unless(snmp_row_index_update(&index, 7) == 0);
+  row_oid.len = 0;
+  fail_unless(snmp_row_index_next(&index, &row_oid, &row) == 0);
+
+  fail_unless(snmp_row_index_update(&index, 8) == 1);
+  fail_unless(snmp_row_index_add(&index, &test_rows[0]) == 1);
+  row_oid.len = 0;
+  fail_unless(snmp_row_index_next(&index, &row_oid, &row) == 1);
+  fail_unless(row == &test_rows[0]);
+  fail_unless(snmp_oid_equal(row_oid.id, row_oid.len, test_rows[0].oid, test_rows[0].len));
+}
+END_TEST
+
+/** PCB list generations used to invalidate the MIB2 TCP and UDP table indices */
+START_TEST(test_snmp_pcb_generation)
+{
+  struct udp_pcb *upcb;
+  struct tcp_pcb *tpcb;
+  u32_t gen;
+  err_t err;
+  LWIP_UNUSED_ARG(_i);
+
+  upcb = udp_new();
+  fail_unless(upcb != NULL);
+  gen = udp_pcbs_generation;
+  err = udp_bind(upcb, IP4_ADDR_ANY, 1161);
+  fail_unless(err == ERR_OK);
+  fail_unless(udp_pcbs_generation != gen);
+  gen = udp_pcbs_generation;
+  err = udp_connect(upcb, IP4_ADDR_ANY, 162);
+  fail_unless(err == ERR_OK);
+  fail_unless(udp_pcbs_generation != gen);
+  gen = udp_pcbs_generation;
+  udp_disconnect(upcb);
+  fail_unless(udp_pcbs_generation != gen);
+  gen = udp_pcbs_generation;
+  udp_remove(upcb);
+  fail_unless(udp_pcbs_generation != gen);
+
+  tpcb = tcp_new();
+  fail_unless(tpcb != NULL);
+  gen = tcp_pcb_lists_generation;
+  err = tcp_bind(tpcb, IP4_ADDR_ANY, 1234);
+  fail_unless(err == ERR_OK);
+  fail_unless(tcp_pcb_lists_generation != gen);
+  gen = tcp_pcb_lists_generation;
+  tpcb = tcp_listen(tpcb);
+  fail_unless(tpcb != NULL);
+  fail_unless(tcp_pcb_lists_generation != gen);
+  gen = tcp_pcb_lists_generation;
+  err = tcp_close(tpcb);
+  fail_unless(err == ERR_OK);
+  fail_unless(tcp_pcb_lists_generation != gen);
+}
+END_TEST
+
+/** MIB index lookups must return the nodes found by walking the MIB trees */
+START_TEST(test_snmp_mib_index_resolve)
+{
+  int checked;
+  LWIP_UNUSED_ARG(_i);
+
+  /* all leaf nodes fit into the index */
+  test_set_mibs(test_mibs, LWIP_ARRAYSIZE(test_mibs));
+#if SNMP_LWIP_MIB_INDEX_SIZE > 0
+  fail_unless(test_num_leaves <= SNMP_LWIP_MIB_INDEX_SIZE);
+#endif
+  checked = test_check_resolve_all();
+  fail_unless(checked > test_num_leaves);
+
+  /* a leaf node too deep for the index: all MIB trees are walked */
+  test_set_mibs(test_mibs_deep, LWIP_ARRAYSIZE(test_mibs_deep));
+  fail_unless(test_leaves[test_num_leaves - 1].oid.len - LWIP_ARRAYSIZE(test_deep_base_oid) > SNMP_LWIP_MIB_INDEX_DEPTH);
+  checked = test_check_resolve_all();
+  fail_unless(checked > test_num_leaves);
+}
+END_TEST
+
+/** GetNext walks continuing at the cursor node must return the same OIDs as resolving from the MIB root */
+START_TEST(test_snmp_getbulk_cursor)
+{
+  static const u32_t start_1_3[] = { 1, 3, 6, 1, 4, 1, 26381, 99, 1, 3 };
+  static const u32_t start_2_3[] = { 1, 3, 6, 1, 4, 1, 26381, 99, 2, 3 };
+  static const u32_t start_deep[] = { 1, 3, 6, 1, 4, 1, 26381, 100 };
+  static const u32_t start_root[] = { 1 };
+  struct snmp_next_cursor cursor, cursor_1, cursor_2;
+  struct snmp_obj_id oid, oid_1, oid_2;
+  int steps;
+  LWIP_UNUSED_ARG(_i);
+
+  test_set_mibs(test_mibs_deep, LWIP_ARRAYSIZE(test_mibs_deep));
+
+  /* walk all MIBs with one cursor, like a GetBulk request with one repeater */
+  memset(&cursor, 0, sizeof(cursor));
+  snmp_oid_assign(&oid, start_root, LWIP_ARRAYSIZE(start_root));
+  for (steps = 0; steps < 10000; steps++) {
+    if (test_next_with_cursor(oid.id, oid.len, &cursor, &oid) != SNMP_ERR_NOERROR) {
+      break;
+    }
+  }
+  fail_unless(steps > 20);
+  fail_unless(steps < 10000);
+  fail_unless(cursor.node == NULL);
+
+  /* two repeaters in lock step: the columns .1.3 and .2.3 have leaf OIDs of equal length
+   * and equal last sub-identifier */
+  memset(&cursor_1, 0, sizeof(cursor_1));
+  memset(&cursor_2, 0, sizeof(cursor_2));
+  snmp_oid_assign(&oid_1, start_1_3, LWIP_ARRAYSIZE(start_1_3));
+  snmp_oid_assign(&oid_2, start_2_3, LWIP_ARRAYSIZE(start_2_3));
+  for (steps = 0; steps < 4; steps++) {
+    fail_unless(test_next_with_cursor(oid_1.id, oid_1.len, &cursor_1, &oid_1) == SNMP_ERR_NOERROR);
+    fail_unless(test_next_with_cursor(oid_2.id, oid_2.len, &cursor_2, &oid_2) == SNMP_ERR_NOERROR);
+  }
+  fail_unless(cursor_1.node == &test_leaf_2_3.leaf.node);
+  fail_unless(cursor_2.node == &test_leaf_2_5.leaf.node);
+
+  /* a cursor used for an OID in another node must not resume at its own node */
+  snmp_oid_assign(&oid_1, start_1_3, LWIP_ARRAYSIZE(start_1_3));
+  oid_1.id[oid_1.len++] = 1;
+  fail_unless(test_next_with_cursor(oid_1.id, oid_1.len, &cursor_2, &oid) == SNMP_ERR_NOERROR);
+  fail_unless(cursor_2.node == &test_leaf_1_3.leaf.node);
+  snmp_oid_assign(&oid_2, start_2_3, LWIP_ARRAYSIZE(start_2_3));
+  oid_2.id[oid_2.len++] = 1;
+  fail_unless(test_next_with_cursor(oid_2.id, oid_2.len, &cursor_2, &oid) == SNMP_ERR_NOERROR);
+  fail_unless(oid.id[oid.len - 2] == 3);
+  fail_unless(oid.id[oid.len - 1] == 2);
+  fail_unless(cursor_2.node == &test_leaf_2_3.leaf.node);
+
+  /* nodes deeper than the cursor holds are resolved from the MIB root */
+  memset(&cursor, 0, sizeof(cursor));
+  snmp_oid_assign(&oid, start_deep, LWIP_ARRAYSIZE(start_deep));
+  fail_unless(test_next_with_cursor(oid.id, oid.len, &cursor, &oid) == SNMP_ERR_NOERROR);
+  fail_unless(cursor.node == NULL);
+  fail_unless(test_next_with_cursor(oid.id, oid.len, &cursor, &oid) == SNMP_ERR_NOERROR);
+  fail_unless(oid.id[oid.len - 1] == 2);
+}
+END_TEST
+
+/** Create the suite including all tests for this module */
+Suite *
+snmp_suite(void)
+{
+  testfunc tests[] = {
+    TESTFUNC(test_snmp_row_index_next),
+    TESTFUNC(test_snmp_row_index_overflow),
+    TESTFUNC(test_snmp_pcb_generation),
+    TESTFUNC(test_snmp_mib_index_resolve),
+    TESTFUNC(test_snmp_getbulk_cursor)
+  };
+  return create_suite("SNMP", tests, sizeof(tests)/sizeof(testfunc), snmp_setup, snmp_teardown);
+}
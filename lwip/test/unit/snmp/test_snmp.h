@@ -0,0 +1,8 @@
+#ifndef LWIP_HDR_TEST_SNMP_H
+#define LWIP_HDR_TEST_SNMP_H
+
+#include "../lwip_check.h"
+
+Suite* snmp_suite(void);
+
+#endif
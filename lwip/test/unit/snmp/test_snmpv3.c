@@ -0,0 +1,292 @@
+#include "test_snmpv3.h"
+
+#include "lwip/apps/snmpv3.h"
+#include "lwip/pbuf.h"
+#include "lwip/memp.h"
+
+#if LWIP_SNMP && LWIP_SNMP_V3 && LWIP_SNMP_V3_MBEDTLS
+
+#include "../../../src/apps/snmp/snmpv3_priv.h"
+
+#define TEST_DATA_LEN 50
+
+/* RFC 3414 A.3 */
+static const u8_t test_password[] = "maplesyrup";
+static const u8_t test_engine_id[] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2 };
+static const u8_t test_master_md5[] = {
+  0x9f, 0xaf, 0x32, 0x83, 0x88, 0x4e, 0x92, 0x83, 0x4e, 0xbc, 0x98, 0x47, 0xd8, 0xed, 0xd9, 0x63
+};
+static const u8_t test_key_md5[] = {
+  0x52, 0x6f, 0x5e, 0xed, 0x9f, 0xcc, 0xe2, 0x6f, 0x89, 0x64, 0xc2, 0x93, 0x07, 0x87, 0xd8, 0x2b
+};
+static const u8_t test_master_sha[] = {
+  0x9f, 0xb5, 0xcc, 0x03, 0x81, 0x49, 0x7b, 0x37, 0x93, 0x52,
+  0x89, 0x39, 0xff, 0x78, 0x8d, 0x5d, 0x79, 0x14, 0x52, 0x11
+};
+static const u8_t test_key_sha[] = {
+  0x66, 0x95, 0xfe, 0xbc, 0x92, 0x88, 0xe3, 0x62, 0x82, 0x23,
+  0x5f, 0xc7, 0x15, 0x1f, 0x12, 0x84, 0x97, 0xb3, 0x8f, 0x3f
+};
+
+/* RFC 2202 test case 3: key 0xaa..., data 50 * 0xdd */
+static const u8_t test_hmac_md5[] = {
+  0x56, 0xbe, 0x34, 0x52, 0x1d, 0x14, 0x4c, 0x88, 0xdb, 0xb8, 0xc7, 0x33, 0xf0, 0xe8, 0xb3, 0xf6
+};
+static const u8_t test_hmac_sha[] = {
+  0x12, 0x5d, 0x73, 0x42, 0xb9, 0xac, 0x11, 0xcd, 0x91, 0xa3,
+  0x9a, 0xf4, 0x8a, 0xa1, 0x7b, 0x4f, 0x63, 0xf1, 0x75, 0xd3
+};
+
+/* The agent's engine and user store, required by the SNMPv3 agent */
+static u32_t test_engine_boots;
+
+void
+snmpv3_get_engine_id(const char **id, u8_t *len)
+{
+  *id = (const char *)test_engine_id;
+  *len = (u8_t)sizeof(test_engine_id);
+}
+
+err_t
+snmpv3_set_engine_id(const char *id, u8_t len)
+{
+  LWIP_UNUSED_ARG(id);
+  LWIP_UNUSED_ARG(len);
+  return ERR_VAL;
+}
+
+u32_t
+snmpv3_get_engine_boots(void)
+{
+  return test_engine_boots;
+}
+
+void
+snmpv3_set_engine_boots(u32_t boots)
+{
+  test_engine_boots = boots;
+}
+
+u32_t
+snmpv3_get_engine_time(void)
+{
+  return 0;
+}
+
+void
+snmpv3_reset_engine_time(void)
+{
+}
+
+err_t
+snmpv3_get_user(const char *username, snmpv3_auth_algo_t *auth_algo, u8_t *auth_key, snmpv3_priv_algo_t *priv_algo, u8_t *priv_key)
+{
+  LWIP_UNUSED_ARG(username);
+  LWIP_UNUSED_ARG(auth_algo);
+  LWIP_UNUSED_ARG(auth_key);
+  LWIP_UNUSED_ARG(priv_algo);
+  LWIP_UNUSED_ARG(priv_key);
+  return ERR_VAL;
+}
+
+u8_t
+snmpv3_get_amount_of_users(void)
+{
+  return 0;
+}
+
+err_t
+snmpv3_get_user_storagetype(const char *username, snmpv3_user_storagetype_t *storagetype)
+{
+  LWIP_UNUSED_ARG(username);
+  LWIP_UNUSED_ARG(storagetype);
+  return ERR_VAL;
+}
+
+err_t
+snmpv3_get_username(char *username, u8_t index)
+{
+  LWIP_UNUSED_ARG(username);
+  LWIP_UNUSED_ARG(index);
+  return ERR_VAL;
+}
+
+/* Helper functions */
+
+/* A chain of pbufs of 'first' bytes and the rest */
+static struct pbuf *
+test_chain(const u8_t *data, u16_t len, u16_t first)
+{
+  struct pbuf *p = pbuf_alloc(PBUF_RAW, first, PBUF_RAM);
+  struct pbuf *q = pbuf_alloc(PBUF_RAW, (u16_t)(len - first), PBUF_RAM);
+  fail_unless((p != NULL) && (q != NULL));
+  pbuf_cat(p, q);
+  fail_unless(pbuf_take(p, data, len) == ERR_OK);
+  return p;
+}
+
+static err_t
+test_auth(struct pbuf *p, const u8_t *key, snmpv3_auth_algo_t algo, u8_t *hmac)
+{
+  struct snmp_pbuf_stream stream;
+  fail_unless(snmp_pbuf_stream_init(&stream, p, 0, p->tot_len) == ERR_OK);
+  return snmpv3_auth(&stream, p->tot_len, key, algo, hmac);
+}
+
+static err_t
+test_crypt(struct pbuf *p, const u8_t *key, snmpv3_priv_algo_t algo, snmpv3_priv_mode_t mode)
+{
+  static const u8_t priv_param[SNMP_V3_MAX_PRIV_PARAM_LENGTH] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+  struct snmp_pbuf_stream stream;
+  fail_unless(snmp_pbuf_stream_init(&stream, p, 0, p->tot_len) == ERR_OK);
+  return snmpv3_crypt(&stream, p->tot_len, key, priv_param, 1, 2, algo, mode);
+}
+
+/* Setups/teardown functions */
+
+static void
+snmpv3_setup(void)
+{
+  lwip_check_ensure_no_alloc(SKIP_POOL(MEMP_SYS_TIMEOUT));
+}
+
+static void
+snmpv3_teardown(void)
+{
+  snmpv3_engine_id_changed();
+  lwip_check_ensure_no_alloc(SKIP_POOL(MEMP_SYS_TIMEOUT));
+}
+
+/* Test functions */
+
+/** Password to key conversion and key localization: RFC 3414 A.3 */
+START_TEST(test_snmpv3_password_to_key)
+{
+  u8_t key[SNMP_V3_SHA_LEN];
+  LWIP_UNUSED_ARG(_i);
+
+  snmpv3_password_to_key_md5(test_password, sizeof(test_password) - 1, test_engine_id, sizeof(test_engine_id), key);
+  fail_unless(memcmp(key, test_key_md5, sizeof(test_key_md5)) == 0);
+  snmpv3_password_to_master_key_md5(test_password, sizeof(test_password) - 1, key);
+  fail_unless(memcmp(key, test_master_md5, sizeof(test_master_md5)) == 0);
+  snmpv3_localize_key_md5(key, test_engine_id, sizeof(test_engine_id), key);
+  fail_unless(memcmp(key, test_key_md5, sizeof(test_key_md5)) == 0);
+
+  snmpv3_password_to_key_sha(test_password, sizeof(test_password) - 1, test_engine_id, sizeof(test_engine_id), key);
+  fail_unless(memcmp(key, test_key_sha, sizeof(test_key_sha)) == 0);
+  snmpv3_password_to_master_key_sha(test_password, sizeof(test_password) - 1, key);
+  fail_unless(memcmp(key, test_master_sha, sizeof(test_master_sha)) == 0);
+  snmpv3_localize_key_sha(key, test_engine_id, sizeof(test_engine_id), key);
+  fail_unless(memcmp(key, test_key_sha, sizeof(test_key_sha)) == 0);
+}
+END_TEST
+
+/** HMAC over pbuf chains, with more keys than cached contexts */
+START_TEST(test_snmpv3_auth)
+{
+  u8_t data[TEST_DATA_LEN];
+  u8_t key[SNMP_V3_SHA_LEN];
+  u8_t hmac[SNMP_V3_SHA_LEN];
+  u8_t hmac_other[SNMP_V3_SHA_LEN];
+  struct pbuf *p;
+  int i;
+  LWIP_UNUSED_ARG(_i);
+
+  memset(data, 0xdd, sizeof(data));
+  memset(key, 0xaa, sizeof(key));
+  p = test_chain(data, sizeof(data), 7);
+
+  fail_unless(test_auth(p, key, SNMP_V3_AUTH_ALGO_MD5, hmac) == ERR_OK);
+  fail_unless(memcmp(hmac, test_hmac_md5, sizeof(test_hmac_md5)) == 0);
+  fail_unless(test_auth(p, key, SNMP_V3_AUTH_ALGO_SHA, hmac) == ERR_OK);
+  fail_unless(memcmp(hmac, test_hmac_sha, sizeof(test_hmac_sha)) == 0);
+
+  /* evict the cached contexts and use them again */
+  for (i = 0; i < LWIP_SNMP_V3_CRYPTO_CTX_CACHE_SIZE + 1; i++) {
+    key[0] = (u8_t)i;
+    fail_unless(test_auth(p, key, SNMP_V3_AUTH_ALGO_SHA, hmac_other) == ERR_OK);
+    fail_unless(memcmp(hmac, hmac_other, sizeof(hmac)) != 0);
+  }
+  key[0] = 0xaa;
+  for (i = 0; i < 2; i++) {
+    fail_unless(test_auth(p, key, SNMP_V3_AUTH_ALGO_MD5, hmac) == ERR_OK);
+    fail_unless(memcmp(hmac, test_hmac_md5, sizeof(test_hmac_md5)) == 0);
+    fail_unless(test_auth(p, key, SNMP_V3_AUTH_ALGO_SHA, hmac) == ERR_OK);
+    fail_unless(memcmp(hmac, test_hmac_sha, sizeof(test_hmac_sha)) == 0);
+    /* the engine ID changed: drops all cached contexts */
+    snmpv3_engine_id_changed();
+  }
+
+  fail_unless(test_auth(p, key, SNMP_V3_AUTH_ALGO_INVAL, hmac) == ERR_ARG);
+  pbuf_free(p);
+}
+END_TEST
+
+#if LWIP_SNMP_V3_CRYPTO
+/** Encryption of pbuf chains is the same as of a single pbuf, decryption restores the data */
+START_TEST(test_snmpv3_crypt)
+{
+  static const snmpv3_priv_algo_t algos[] = { SNMP_V3_PRIV_ALGO_DES, SNMP_V3_PRIV_ALGO_AES };
+  u8_t data[TEST_DATA_LEN - 2];
+  u8_t single[TEST_DATA_LEN - 2];
+  u8_t key[16];
+  struct pbuf *p, *q;
+  int a;
+  int i;
+  LWIP_UNUSED_ARG(_i);
+
+  for (i = 0; i < (int)sizeof(data); i++) {
+    data[i] = (u8_t)i;
+  }
+  for (i = 0; i < (int)sizeof(key); i++) {
+    key[i] = (u8_t)(0x10 + i);
+  }
+
+  for (a = 0; a < (int)(sizeof(algos)/sizeof(algos[0])); a++) {
+    /* single pbuf */
+    q = pbuf_alloc(PBUF_RAW, sizeof(data), PBUF_RAM);
+    fail_unless(q != NULL);
+    fail_unless(pbuf_take(q, data, sizeof(data)) == ERR_OK);
+    fail_unless(test_crypt(q, key, algos[a], SNMP_V3_PRIV_MODE_ENCRYPT) == ERR_OK);
+    fail_unless(pbuf_copy_partial(q, single, sizeof(single), 0) == sizeof(single));
+    fail_unless(memcmp(single, data, sizeof(data)) != 0);
+    pbuf_free(q);
+
+    /* chains, split inside and at cipher blocks */
+    for (i = 3; i <= 16; i += 13) {
+      p = test_chain(data, sizeof(data), (u16_t)i);
+      fail_unless(test_crypt(p, key, algos[a], SNMP_V3_PRIV_MODE_ENCRYPT) == ERR_OK);
+      fail_unless(pbuf_memcmp(p, 0, single, sizeof(single)) == 0);
+      fail_unless(test_crypt(p, key, algos[a], SNMP_V3_PRIV_MODE_DECRYPT) == ERR_OK);
+      fail_unless(pbuf_memcmp(p, 0, data, sizeof(data)) == 0);
+      pbuf_free(p);
+    }
+  }
+
+  /* DES needs padded data */
+  p = test_chain(data, sizeof(data) - 1, 8);
+  fail_unless(test_crypt(p, key, SNMP_V3_PRIV_ALGO_DES, SNMP_V3_PRIV_MODE_ENCRYPT) == ERR_ARG);
+  pbuf_free(p);
+}
+END_TEST
+#endif /* LWIP_SNMP_V3_CRYPTO */
+
+#endif /* LWIP_SNMP && LWIP_SNMP_V3 && LWIP_SNMP_V3_MBEDTLS */
+
+/** Create the suite including all tests for this module */
+Suite *
+snmpv3_suite(void)
+{
+#if LWIP_SNMP && LWIP_SNMP_V3 && LWIP_SNMP_V3_MBEDTLS
+  testfunc tests[] = {
+    TESTFUNC(test_snmpv3_password_to_key),
+    TESTFUNC(test_snmpv3_auth),
+#if LWIP_SNMP_V3_CRYPTO
+    TESTFUNC(test_snmpv3_crypt),
+#endif /* LWIP_SNMP_V3_CRYPTO */
+  };
+  return create_suite("SNMPV3", tests, sizeof(tests)/sizeof(testfunc), snmpv3_setup, snmpv3_teardown);
+#else /* LWIP_SNMP && LWIP_SNMP_V3 && LWIP_SNMP_V3_MBEDTLS */
+  return create_suite("SNMPV3", NULL, 0, NULL, NULL);
+#endif /* LWIP_SNMP && LWIP_SNMP_V3 && LWIP_SNMP_V3_MBEDTLS */
+}
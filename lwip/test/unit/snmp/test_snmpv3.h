@@ -0,0 +1,8 @@
+#ifndef LWIP_HDR_TEST_SNMPV3_H
+#define LWIP_HDR_TEST_SNMPV3_H
+
+#include "../lwip_check.h"
+
+Suite* snmpv3_suite(void);
+
+#endif
@@ -0,0 +1,579 @@
+#include "test_tftp.h"
+
+#include "lwip/apps/tftp_server.h"
+#include "lwip/apps/tftp_client.h"
+#include "lwip/udp.h"
+#include "lwip/netif.h"
+#include "lwip/prot/ip4.h"
+#include "lwip/prot/udp.h"
+
+#include <string.h>
+
+#if !LWIP_UDP || !LWIP_IPV4
+#error "This tests needs UDP and IPv4 enabled"
+#endif
+
+#define TEST_TFTP_RRQ   1
+#define TEST_TFTP_WRQ   2
+#define TEST_TFTP_DATA  3
+#define TEST_TFTP_ACK   4
+#define TEST_TFTP_ERROR 5
+#define TEST_TFTP_OACK  6
+
+#define TEST_TFTP_PEER_PORT 1234
+#define TEST_TFTP_MAX_TX    8
+
+/* packets sent by tftp (UDP payload only) */
+struct test_tftp_tx {
+  u16_t len;
+  u16_t dst_port;
+  u8_t data[TFTP_MAX_BLKSIZE + 4];
+};
+
+/* in-memory file: contents are generated from the offset */
+struct test_tftp_file {
+  u32_t size;
+  u32_t pos;
+  int closed;
+  int errors;
+  int write_errors;
+};
+
+static struct netif test_netif;
+static ip4_addr_t test_ipaddr, test_netmask, test_gw;
+static ip_addr_t test_peer;
+static struct test_tftp_tx test_tx[TEST_TFTP_MAX_TX];
+static int test_tx_cnt;
+static struct test_tftp_file test_file;
+
+/* Helper functions */
+static u8_t
+test_tftp_file_byte(u32_t offset)
+{
+  return (u8_t)(offset + (offset >> 8) + (offset >> 16));
+}
+
+static void *
+test_tftp_open(const char *fname, const char *mode, u8_t write)
+{
+  LWIP_UNUSED_ARG(mode);
+  LWIP_UNUSED_ARG(write);
+  if (strcmp(fname, "file") != 0) {
+    return NULL;
+  }
+  test_file.pos = 0;
+  return &test_file;
+}
+
+static void
+test_tftp_close(void *handle)
+{
+  fail_unless(handle == &test_file);
+  test_file.closed++;
+}
+
+static int
+test_tftp_read(void *handle, void *buf, int bytes)
+{
+  int i;
+  u8_t *dst = (u8_t *)buf;
+  fail_unless(handle == &test_file);
+  for (i = 0; (i < bytes) && (test_file.pos < test_file.size); i++) {
+    dst[i] = test_tftp_file_byte(test_file.pos++);
+  }
+  return i;
+}
+
+static int
+test_tftp_write(void *handle, struct pbuf *p)
+{
+  u16_t i;
+  fail_unless(handle == &test_file);
+  for (i = 0; i < p->tot_len; i++) {
+    if (pbuf_get_at(p, i) != test_tftp_file_byte(test_file.pos + i)) {
+      test_file.write_errors++;
+      break;
+    }
+  }
+  test_file.pos += p->tot_len;
+  return 0;
+}
+
+static void
+test_tftp_error(void *handle, int err, const char *msg, int size)
+{
+  LWIP_UNUSED_ARG(handle);
+  LWIP_UNUSED_ARG(err);
+  LWIP_UNUSED_ARG(msg);
+  LWIP_UNUSED_ARG(size);
+  test_file.errors++;
+}
+
+static int
+test_tftp_size(void *handle)
+{
+  fail_unless(handle == &test_file);
+  return (int)test_file.size;
+}
+
+static const struct tftp_context test_tftp_ctx = {
+  test_tftp_open,
+  test_tftp_close,
+  test_tftp_read,
+  test_tftp_write,
+  test_tftp_error,
+  test_tftp_size
+};
+
+static err_t
+test_tftp_netif_output(struct netif *netif, struct pbuf *p, const ip4_addr_t *ipaddr)
+{
+  struct test_tftp_tx *tx;
+  struct udp_hdr udphdr;
+  LWIP_UNUSED_ARG(netif);
+  LWIP_UNUSED_ARG(ipaddr);
+
+  fail_unless(test_tx_cnt < TEST_TFTP_MAX_TX);
+  if (test_tx_cnt >= TEST_TFTP_MAX_TX) {
+    return ERR_OK;
+  }
+  tx = &test_tx[test_tx_cnt++];
+  pbuf_copy_partial(p, &udphdr, UDP_HLEN, IP_HLEN);
+  tx->dst_port = lwip_ntohs(udphdr.dest);
+  tx->len = (u16_t)(p->tot_len - IP_HLEN - UDP_HLEN);
+  fail_unless(tx->len <= sizeof(tx->data));
+  pbuf_copy_partial(p, tx->data, tx->len, IP_HLEN + UDP_HLEN);
+  return ERR_OK;
+}
+
+static err_t
+test_tftp_netif_init(struct netif *netif)
+{
+  netif->output = test_tftp_netif_output;
+  netif->mtu = 1500;
+  netif->flags = NETIF_FLAG_LINK_UP;
+  return ERR_OK;
+}
+
+/** Pass a packet from the peer to the tftp pcb */
+static void
+test_tftp_input(u16_t port, const void *data, u16_t len)
+{
+  struct udp_pcb *pcb;
+  struct pbuf *p;
+
+  for (pcb = udp_pcbs; pcb != NULL; pcb = pcb->next) {
+    if (pcb->local_port == TFTP_PORT) {
+      break;
+    }
+  }
+  fail_unless(pcb != NULL);
+  p = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
+  fail_unless(p != NULL);
+  pbuf_take(p, data, len);
+  pcb->recv(pcb->recv_arg, pcb, p, &test_peer, port);
+}
+
+static void
+test_tftp_input_ack(u16_t blknum)
+{
+  u8_t ack[4];
+  ack[0] = 0;
+  ack[1] = TEST_TFTP_ACK;
+  ack[2] = (u8_t)(blknum >> 8);
+  ack[3] = (u8_t)blknum;
+  test_tftp_input(TEST_TFTP_PEER_PORT, ack, sizeof(ack));
+}
+
+/** Send a data block of the test file (blocks are 'blksize' long, starting at 1) */
+static void
+test_tftp_input_data(u32_t block, u16_t blksize)
+{
+  static u8_t data[TFTP_MAX_BLKSIZE + 4];
+  u32_t offset = (block - 1) * blksize;
+  u16_t len = (u16_t)LWIP_MIN(blksize, test_file.size - offset);
+  u16_t i;
+
+  data[0] = 0;
+  data[1] = TEST_TFTP_DATA;
+  data[2] = (u8_t)(block >> 8);
+  data[3] = (u8_t)block;
+  for (i = 0; i < len; i++) {
+    data[4 + i] = test_tftp_file_byte(offset + i);
+  }
+  test_tftp_input(TEST_TFTP_PEER_PORT, data, (u16_t)(len + 4));
+}
+
+static u16_t
+test_tftp_opcode(const struct test_tftp_tx *tx)
+{
+  return (u16_t)((tx->data[0] << 8) | tx->data[1]);
+}
+
+static u16_t
+test_tftp_blknum(const struct test_tftp_tx *tx)
+{
+  return (u16_t)((tx->data[2] << 8) | tx->data[3]);
+}
+
+static void
+test_tftp_check_ack(int idx, u16_t blknum)
+{
+  fail_unless(test_tftp_opcode(&test_tx[idx]) == TEST_TFTP_ACK);
+  fail_unless(test_tftp_blknum(&test_tx[idx]) == blknum);
+}
+
+/** Check a sent data block of the test file */
+static void
+test_tftp_check_data(int idx, u32_t block, u16_t blksize)
+{
+  const struct test_tftp_tx *tx = &test_tx[idx];
+  u32_t offset = (block - 1) * blksize;
+  u16_t len = (u16_t)LWIP_MIN(blksize, test_file.size - offset);
+  u16_t i;
+
+  fail_unless(test_tftp_opcode(tx) == TEST_TFTP_DATA);
+  fail_unless(test_tftp_blknum(tx) == (u16_t)block);
+  fail_unless(tx->len == len + 4);
+  for (i = 0; i < len; i++) {
+    if (tx->data[4 + i] != test_tftp_file_byte(offset + i)) {
+      break;
+    }
+  }
+  fail_unless(i == len);
+}
+
+/** Check an OACK (or request options) against a list of "name\0value\0" pairs */
+static void
+test_tftp_check_options(int idx, u16_t offset, const char *options, u16_t options_len)
+{
+  const struct test_tftp_tx *tx = &test_tx[idx];
+  fail_unless(tx->len == offset + options_len);
+  fail_unless(memcmp(&tx->data[offset], options, options_len) == 0);
+}
+
+/** Build and send a RRQ/WRQ for "file" with the given options */
+static void
+test_tftp_input_request(u8_t opcode, const char *options, u16_t options_len)
+{
+  static const char req[] = "\0\0file\0octet";
+  u8_t buf[sizeof(req) + 64];
+
+  fail_unless(options_len <= 64);
+  memcpy(buf, req, sizeof(req));
+  buf[1] = opcode;
+  memcpy(&buf[sizeof(req)], options, options_len);
+  test_tftp_input(TEST_TFTP_PEER_PORT, buf, (u16_t)(sizeof(req) + options_len));
+}
+
+/* Setups/teardown functions */
+static struct netif *old_netif_list;
+static struct netif *old_netif_default;
+
+static void
+tftp_setup(void)
+{
+  old_netif_list = netif_list;
+  old_netif_default = netif_default;
+  netif_list = NULL;
+  netif_default = NULL;
+
+  IP4_ADDR(&test_ipaddr, 192, 168, 1, 1);
+  IP4_ADDR(&test_netmask, 255, 255, 255, 0);
+  IP4_ADDR(&test_gw, 192, 168, 1, 254);
+  IP_ADDR4(&test_peer, 192, 168, 1, 2);
+  netif_add(&test_netif, &test_ipaddr, &test_netmask, &test_gw, NULL, test_tftp_netif_init, NULL);
+  netif_set_up(&test_netif);
+
+  memset(&test_file, 0, sizeof(test_file));
+  test_tx_cnt = 0;
+  lwip_check_ensure_no_alloc(SKIP_POOL(MEMP_SYS_TIMEOUT));
+}
+
+static void
+tftp_teardown(void)
+{
+  tftp_cleanup();
+  netif_remove(&test_netif);
+  netif_list = old_netif_list;
+  netif_default = old_netif_default;
+  lwip_check_ensure_no_alloc(SKIP_POOL(MEMP_SYS_TIMEOUT));
+}
+
+/* Test functions */
+START_TEST(test_tftp_oack_read)
+{
+  static const char options[] = "blksize\0" "1024\0" "windowsize\0" "8\0" "tsize\0" "0";
+  static const char oack[] = "blksize\0" "1024\0" "windowsize\0" "4\0" "tsize\0" "5000";
+  int i;
+  LWIP_UNUSED_ARG(_i);
+
+  fail_unless(tftp_init_server(&test_tftp_ctx) == ERR_OK);
+  test_file.size = 5000;
+
+  /* blksize is accepted, windowsize is capped, tsize is answered with the file size */
+  test_tftp_input_request(TEST_TFTP_RRQ, options, sizeof(options));
+  fail_unless(test_tx_cnt == 1);
+  fail_unless(test_tx[0].dst_port == TEST_TFTP_PEER_PORT);
+  fail_unless(test_tftp_opcode(&test_tx[0]) == TEST_TFTP_OACK);
+  test_tftp_check_options(0, 2, oack, sizeof(oack));
+
+  /* ACK 0 answers the OACK: a whole window is sent */
+  test_tx_cnt = 0;
+  test_tftp_input_ack(0);
+  fail_unless(test_tx_cnt == 4);
+  for (i = 0; i < 4; i++) {
+    test_tftp_check_data(i, (u32_t)i + 1, 1024);
+  }
+
+  test_tx_cnt = 0;
+  test_tftp_input_ack(4);
+  fail_unless(test_tx_cnt == 1);
+  test_tftp_check_data(0, 5, 1024);
+
+  test_tx_cnt = 0;
+  test_tftp_input_ack(5);
+  fail_unless(test_tx_cnt == 0);
+  fail_unless(test_file.closed == 1);
+}
+END_TEST
+
+START_TEST(test_tftp_oack_write)
+{
+  static const char options[] = "blksize\0" "65464\0" "tsize\0" "3000";
+  /* blksize is capped by the netif MTU: 1500 - 20 - 8 - 4 */
+  static const char oack[] = "blksize\0" "1468\0" "tsize\0" "3000";
+  LWIP_UNUSED_ARG(_i);
+
+  fail_unless(tftp_init_server(&test_tftp_ctx) == ERR_OK);
+  test_file.size = 3000;
+
+  test_tftp_input_request(TEST_TFTP_WRQ, options, sizeof(options));
+  fail_unless(test_tx_cnt == 1);
+  fail_unless(test_tftp_opcode(&test_tx[0]) == TEST_TFTP_OACK);
+  test_tftp_check_options(0, 2, oack, sizeof(oack));
+
+  /* no windowsize option: every block is acknowledged */
+  test_tx_cnt = 0;
+  test_tftp_input_data(1, 1468);
+  test_tftp_input_data(2, 1468);
+  test_tftp_input_data(3, 1468);
+  fail_unless(test_tx_cnt == 3);
+  test_tftp_check_ack(0, 1);
+  test_tftp_check_ack(1, 2);
+  test_tftp_check_ack(2, 3);
+  fail_unless(test_file.pos == 3000);
+  fail_unless(test_file.write_errors == 0);
+  fail_unless(test_file.closed == 1);
+}
+END_TEST
+
+START_TEST(test_tftp_oack_client)
+{
+  static const char request[] = "\0\1file\0octet\0" "blksize\0" "1468\0" "windowsize\0" "4";
+  static const char oack[] = "\0\6blksize\0" "600\0" "windowsize\0" "2";
+  static const char oack_invalid[] = "\0\6blksize\0" "9000";
+  LWIP_UNUSED_ARG(_i);
+
+  fail_unless(tftp_init_client(&test_tftp_ctx) == ERR_OK);
+  test_file.size = 1210;
+
+  fail_unless(tftp_get(&test_file, &test_peer, TFTP_PORT, "file", TFTP_MODE_OCTET) == ERR_OK);
+  fail_unless(test_tx_cnt == 1);
+  fail_unless(test_tx[0].dst_port == TFTP_PORT);
+  test_tftp_check_options(0, 0, request, sizeof(request));
+
+  /* the server answers from its transfer port */
+  test_tx_cnt = 0;
+  test_tftp_input(TEST_TFTP_PEER_PORT, oack, sizeof(oack));
+  fail_unless(test_tx_cnt == 1);
+  fail_unless(test_tx[0].dst_port == TEST_TFTP_PEER_PORT);
+  test_tftp_check_ack(0, 0);
+
+  /* window of 2 blocks of 600 bytes */
+  test_tx_cnt = 0;
+  test_tftp_input_data(1, 600);
+  fail_unless(test_tx_cnt == 0);
+  test_tftp_input_data(2, 600);
+  fail_unless(test_tx_cnt == 1);
+  test_tftp_check_ack(0, 2);
+  test_tftp_input_data(3, 600);
+  fail_unless(test_tx_cnt == 2);
+  test_tftp_check_ack(1, 3);
+  fail_unless(test_file.pos == 1210);
+  fail_unless(test_file.write_errors == 0);
+  fail_unless(test_file.closed == 1);
+
+  /* options that were not requested like this are refused */
+  test_file.closed = 0;
+  fail_unless(tftp_get(&test_file, &test_peer, TFTP_PORT, "file", TFTP_MODE_OCTET) == ERR_OK);
+  test_tx_cnt = 0;
+  test_tftp_input(TEST_TFTP_PEER_PORT, oack_invalid, sizeof(oack_invalid));
+  fail_unless(test_tx_cnt == 1);
+  fail_unless(test_tftp_opcode(&test_tx[0]) == TEST_TFTP_ERROR);
+  fail_unless(test_tftp_blknum(&test_tx[0]) == 8);
+  fail_unless(test_file.closed == 1);
+}
+END_TEST
+
+START_TEST(test_tftp_window_loss_send)
+{
+  static const char options[] = "windowsize\0" "4";
+  LWIP_UNUSED_ARG(_i);
+
+  fail_unless(tftp_init_server(&test_tftp_ctx) == ERR_OK);
+  /* 7 blocks of 512 bytes, the last one short */
+  test_file.size = 6 * 512 + 100;
+
+  test_tftp_input_request(TEST_TFTP_RRQ, options, sizeof(options));
+  fail_unless(test_tx_cnt == 1);
+  test_tx_cnt = 0;
+  test_tftp_input_ack(0);
+  fail_unless(test_tx_cnt == 4);
+
+  /* block 2 got lost: the blocks after the one acknowledged are sent again,
+     then the window is filled up */
+  test_tx_cnt = 0;
+  test_tftp_input_ack(1);
+  fail_unless(test_tx_cnt == 4);
+  test_tftp_check_data(0, 2, 512);
+  test_tftp_check_data(1, 3, 512);
+  test_tftp_check_data(2, 4, 512);
+  test_tftp_check_data(3, 5, 512);
+
+  test_tx_cnt = 0;
+  test_tftp_input_ack(5);
+  fail_unless(test_tx_cnt == 2);
+  test_tftp_check_data(0, 6, 512);
+  test_tftp_check_data(1, 7, 512);
+
+  /* first block of the window got lost: the receiver acknowledges block 5 again */
+  test_tx_cnt = 0;
+  test_tftp_input_ack(5);
+  fail_unless(test_tx_cnt == 2);
+  test_tftp_check_data(0, 6, 512);
+  test_tftp_check_data(1, 7, 512);
+
+  /* an old duplicate ACK is ignored */
+  test_tx_cnt = 0;
+  test_tftp_input_ack(3);
+  fail_unless(test_tx_cnt == 0);
+
+  test_tftp_input_ack(7);
+  fail_unless(test_tx_cnt == 0);
+  fail_unless(test_file.closed == 1);
+}
+END_TEST
+
+START_TEST(test_tftp_window_loss_recv)
+{
+  static const char options[] = "windowsize\0" "4";
+  LWIP_UNUSED_ARG(_i);
+
+  fail_unless(tftp_init_server(&test_tftp_ctx) == ERR_OK);
+  test_file.size = 5 * 512 + 10;
+
+  test_tftp_input_request(TEST_TFTP_WRQ, options, sizeof(options));
+  fail_unless(test_tx_cnt == 1);
+  fail_unless(test_tftp_opcode(&test_tx[0]) == TEST_TFTP_OACK);
+
+  /* block 2 is lost: the last block received in order is acknowledged once */
+  test_tx_cnt = 0;
+  test_tftp_input_data(1, 512);
+  fail_unless(test_tx_cnt == 0);
+  test_tftp_input_data(3, 512);
+  fail_unless(test_tx_cnt == 1);
+  test_tftp_check_ack(0, 1);
+  test_tftp_input_data(4, 512);
+  fail_unless(test_tx_cnt == 1);
+
+  /* the sender restarts from block 2, a full window is acknowledged */
+  test_tftp_input_data(2, 512);
+  test_tftp_input_data(3, 512);
+  test_tftp_input_data(4, 512);
+  fail_unless(test_tx_cnt == 1);
+  test_tftp_input_data(5, 512);
+  fail_unless(test_tx_cnt == 2);
+  test_tftp_check_ack(1, 5);
+
+  /* the short block ends the transfer */
+  test_tftp_input_data(6, 512);
+  fail_unless(test_tx_cnt == 3);
+  test_tftp_check_ack(2, 6);
+  fail_unless(test_file.pos == test_file.size);
+  fail_unless(test_file.write_errors == 0);
+  fail_unless(test_file.closed == 1);
+}
+END_TEST
+
+START_TEST(test_tftp_blknum_wrap_send)
+{
+  static const char options[] = "blksize\0" "8\0" "windowsize\0" "4";
+  u32_t block = 1;
+  LWIP_UNUSED_ARG(_i);
+
+  fail_unless(tftp_init_server(&test_tftp_ctx) == ERR_OK);
+  /* more than 65535 blocks of 8 bytes */
+  test_file.size = 8 * 65540UL + 3;
+
+  test_tftp_input_request(TEST_TFTP_RRQ, options, sizeof(options));
+  fail_unless(test_tx_cnt == 1);
+  test_tx_cnt = 0;
+  test_tftp_input_ack(0);
+  while (test_tx_cnt > 0) {
+    int i;
+    int cnt = test_tx_cnt;
+    for (i = 0; i < cnt; i++) {
+      test_tftp_check_data(i, block + (u32_t)i, 8);
+    }
+    block += (u32_t)cnt;
+    test_tx_cnt = 0;
+    test_tftp_input_ack((u16_t)(block - 1));
+  }
+  fail_unless(block == 65542);
+  fail_unless(test_file.closed == 1);
+}
+END_TEST
+
+START_TEST(test_tftp_blknum_wrap_recv)
+{
+  static const char options[] = "blksize\0" "8\0" "windowsize\0" "4";
+  u32_t block;
+  LWIP_UNUSED_ARG(_i);
+
+  fail_unless(tftp_init_server(&test_tftp_ctx) == ERR_OK);
+  test_file.size = 8 * 65540UL + 3;
+
+  test_tftp_input_request(TEST_TFTP_WRQ, options, sizeof(options));
+  fail_unless(test_tx_cnt == 1);
+  for (block = 1; block <= 65541; block++) {
+    test_tx_cnt = 0;
+    test_tftp_input_data(block, 8);
+    if (((block % 4) == 0) || (block == 65541)) {
+      fail_unless(test_tx_cnt == 1);
+      test_tftp_check_ack(0, (u16_t)block);
+    } else {
+      fail_unless(test_tx_cnt == 0);
+    }
+  }
+  fail_unless(test_file.pos == test_file.size);
+  fail_unless(test_file.write_errors == 0);
+  fail_unless(test_file.closed == 1);
+}
+END_TEST
+
+/** Create the suite including all tests for this module */
+Suite *
+tftp_suite(void)
+{
+  testfunc tests[] = {
+    TESTFUNC(test_tftp_oack_read),
+    TESTFUNC(test_tftp_oack_write),
+    TESTFUNC(test_tftp_oack_client),
+    TESTFUNC(test_tftp_window_loss_send),
+    TESTFUNC(test_tftp_window_loss_recv),
+    TESTFUNC(test_tftp_blknum_wrap_send),
+    TESTFUNC(test_tftp_blknum_wrap_recv)
+  };
+  return create_suite("TFTP", tests, sizeof(tests)/sizeof(testfunc), tftp_setup, tftp_teardown);
+}
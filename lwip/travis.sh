@@ -11,6 +11,47 @@ fi
 # Build test using make, this tests the Makefile toolchain
 make check -j 4
 
+# bridgeif VLAN tests
+make clean check -j 4 TESTFLAGS=-DBRIDGEIF_VLAN=1
+ERR=$?
+if [ $ERR != 0 ]; then
+       echo "bridgeif VLAN unittests failed"
+       exit 33
+fi
+
+# MQTT 5 tests
+make clean check -j 4 TESTFLAGS=-DLWIP_MQTT_V5=1
+ERR=$?
+if [ $ERR != 0 ]; then
+       echo "MQTT 5 unittests failed"
+       exit 33
+fi
+
+# altcp_tls and snmpv3 tests need mbedTLS (at the default MBEDTLSDIR)
+if ls ../../../../../mbedtls/include/mbedtls/*.h > /dev/null 2>&1; then
+       make clean check -j 4 TESTFLAGS=-DLWIP_UNITTESTS_ALTCP_TLS=1
+       ERR=$?
+       if [ $ERR != 0 ]; then
+              echo "altcp_tls unittests failed"
+              exit 33
+       fi
+       make clean check -j 4 TESTFLAGS=-DLWIP_UNITTESTS_SNMPV3=1
+       ERR=$?
+       if [ $ERR != 0 ]; then
+              echo "snmpv3 unittests failed"
+              exit 33
+       fi
+       # ALTCP_MBEDTLS_MEM_POOLS needs MBEDTLS_PLATFORM_MEMORY in the mbedTLS config
+       if grep -qs "^#define MBEDTLS_PLATFORM_MEMORY" ../../../../../mbedtls/include/mbedtls/*config.h; then
+              make clean check -j 4 TESTFLAGS="-DLWIP_UNITTESTS_ALTCP_TLS=1 -DLWIP_UNITTESTS_ALTCP_TLS_MEM_POOLS=1"
+              ERR=$?
+              if [ $ERR != 0 ]; then
+                     echo "altcp_tls mem pools unittests failed"
+                     exit 33
+              fi
+       fi
+fi
+
 
 # Build example_app using cmake, this tests the CMake toolchain
 cd ../../../../